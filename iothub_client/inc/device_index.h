@@ -0,0 +1,87 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file	device_index.h
+*	@brief	A hash index of the devices registered on a transport, keyed by device id.
+*
+*	@details	Adding, finding and removing a device take constant time on average whatever the number of devices,
+*				so registering thousands of devices on one transport does not become quadratic. The items are also
+*				linked in the order they were added so the transport can visit all its devices.
+*/
+
+#ifndef DEVICE_INDEX_H
+#define DEVICE_INDEX_H
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#include <cstddef>
+#else
+#include <stddef.h>
+#endif
+
+typedef struct DEVICE_INDEX_TAG* DEVICE_INDEX_HANDLE;
+typedef struct DEVICE_INDEX_ITEM_TAG* DEVICE_INDEX_ITEM_HANDLE;
+
+/**
+* @brief	Creates an empty index.
+*
+* @returns	A non-NULL @c DEVICE_INDEX_HANDLE value that is used when invoking other API functions.
+*/
+MOCKABLE_FUNCTION(, DEVICE_INDEX_HANDLE, device_index_create);
+
+/**
+* @brief	Releases the index and all its items. The values stored in the items are not released.
+*/
+MOCKABLE_FUNCTION(, void, device_index_destroy, DEVICE_INDEX_HANDLE, device_index);
+
+/**
+* @brief	Adds @c value under @c device_id, at the end of the index. @c device_id is copied.
+*
+* @returns	The item holding @c value, or NULL if @c device_id is already in the index or the item cannot be created.
+*/
+MOCKABLE_FUNCTION(, DEVICE_INDEX_ITEM_HANDLE, device_index_add, DEVICE_INDEX_HANDLE, device_index, const char*, device_id, const void*, value);
+
+/**
+* @brief	Removes @c item from the index and releases it.
+*
+* @returns	Zero on success, non-zero if any argument is NULL.
+*/
+MOCKABLE_FUNCTION(, int, device_index_remove, DEVICE_INDEX_HANDLE, device_index, DEVICE_INDEX_ITEM_HANDLE, item);
+
+/**
+* @brief	Looks up the item added under @c device_id.
+*
+* @returns	The item, or NULL if no item has that device id.
+*/
+MOCKABLE_FUNCTION(, DEVICE_INDEX_ITEM_HANDLE, device_index_find, DEVICE_INDEX_HANDLE, device_index, const char*, device_id);
+
+/**
+* @brief	Gets the value stored in @c item.
+*/
+MOCKABLE_FUNCTION(, const void*, device_index_item_get_value, DEVICE_INDEX_ITEM_HANDLE, item);
+
+/**
+* @brief	Gets the item that was added first, or NULL if the index is empty.
+*/
+MOCKABLE_FUNCTION(, DEVICE_INDEX_ITEM_HANDLE, device_index_get_head_item, DEVICE_INDEX_HANDLE, device_index);
+
+/**
+* @brief	Gets the item that was added after @c item, or NULL if @c item is the last one.
+*
+* @remarks	The item after @c item shall be obtained before @c item is removed.
+*/
+MOCKABLE_FUNCTION(, DEVICE_INDEX_ITEM_HANDLE, device_index_get_next_item, DEVICE_INDEX_ITEM_HANDLE, item);
+
+/**
+* @brief	Gets the number of items in the index.
+*/
+MOCKABLE_FUNCTION(, size_t, device_index_get_count, DEVICE_INDEX_HANDLE, device_index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*DEVICE_INDEX_H*/
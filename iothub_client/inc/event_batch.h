@@ -0,0 +1,56 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file	event_batch.h
+*	@brief	Serializes the messages of an HTTP event batch straight into the request body.
+*
+*	@details	The size of the JSON item of a message is computed first, so the transport can size the whole batch,
+*				allocate its body once and have every item written in place, base64 encoding included, without
+*				any intermediate string.
+*/
+
+#ifndef EVENT_BATCH_H
+#define EVENT_BATCH_H
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "iothub_message.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#include <cstddef>
+#else
+#include <stddef.h>
+#endif
+
+/**
+* @brief	Computes the size of the JSON item of a message, which is
+*			{"body":"<base64 of the content>"[,"properties":{...}]} for byte array messages and
+*			{"body":<JSON string>,"base64Encoded":false[,"properties":{...}]} for string messages.
+*
+* @param	messageHandle	The message.
+* @param	itemSize		Receives the number of bytes of the JSON item.
+* @param	messageSize		Receives what the message counts for towards the size limit of a batch: the size of its
+*							content + 384, plus the length of the name and value + 16 for each property.
+*
+* @returns	Zero on success, non-zero if the message cannot be serialized.
+*/
+MOCKABLE_FUNCTION(, int, event_batch_get_item_size, IOTHUB_MESSAGE_HANDLE, messageHandle, size_t*, itemSize, size_t*, messageSize);
+
+/**
+* @brief	Writes the JSON item of a message at @c destination.
+*
+* @param	messageHandle	The message.
+* @param	destination		Where to write the item. No terminating '\0' is written.
+* @param	destinationSize	The number of bytes available at @c destination.
+* @param	itemSize		Receives the number of bytes written, which is the size returned by @c event_batch_get_item_size.
+*
+* @returns	Zero on success, non-zero if the message cannot be serialized or its item is longer than @c destinationSize.
+*/
+MOCKABLE_FUNCTION(, int, event_batch_write_item, IOTHUB_MESSAGE_HANDLE, messageHandle, unsigned char*, destination, size_t, destinationSize, size_t*, itemSize);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*EVENT_BATCH_H*/
@@ -0,0 +1,59 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file	http_compression.h
+*	@brief	Compresses the body of an HTTP request with gzip.
+*
+*	@details	The compressor keeps its deflate state from one request to the next and deflates straight into
+*				the destination buffer, so the compressed body is never copied. Compression is only available
+*				when the SDK is built with use_http_compression (which requires zlib).
+*/
+
+#ifndef HTTP_COMPRESSION_H
+#define HTTP_COMPRESSION_H
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "azure_c_shared_utility/buffer_.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** @brief	The value of the Content-Encoding header of a compressed body. */
+#define HTTP_COMPRESSION_CONTENT_ENCODING "gzip"
+
+typedef struct HTTP_COMPRESSION_TAG* HTTP_COMPRESSION_HANDLE;
+
+/**
+* @brief	Creates a gzip compressor.
+*
+* @param	level	The zlib compression level, from 1 (fastest) to 9 (smallest).
+*
+* @returns	A handle to the compressor, or NULL if @c level is invalid, the SDK was built without
+*			compression or the compressor cannot be allocated.
+*/
+MOCKABLE_FUNCTION(, HTTP_COMPRESSION_HANDLE, http_compression_create, int, level);
+
+/**
+* @brief	Frees the compressor.
+*/
+MOCKABLE_FUNCTION(, void, http_compression_destroy, HTTP_COMPRESSION_HANDLE, compression);
+
+/**
+* @brief	Compresses @c source into @c destination.
+*
+* @param	compression	The compressor.
+* @param	source		The body to compress.
+* @param	destination	Receives the gzip stream of @c source.
+*
+* @returns	Zero if @c destination holds the compressed body, non-zero if compression failed or the
+*			compressed body would not be smaller than @c source, in which case @c source should be sent as is.
+*/
+MOCKABLE_FUNCTION(, int, http_compression_compress, HTTP_COMPRESSION_HANDLE, compression, BUFFER_HANDLE, source, BUFFER_HANDLE, destination);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*HTTP_COMPRESSION_H*/
@@ -0,0 +1,67 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file	ingress_queue.h
+*	@brief	A bounded, lock-free queue of pointers with many producers and a single consumer.
+*
+*	@details	Any number of threads may push items concurrently without taking a lock. Items are popped
+*				by one consumer at a time (the caller serializes the consumers, for instance by holding a
+*				lock while popping). Items pushed by one thread are popped in the order that thread pushed them.
+*/
+
+#ifndef INGRESS_QUEUE_H
+#define INGRESS_QUEUE_H
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#include <cstddef>
+#else
+#include <stddef.h>
+#include <stdbool.h>
+#endif
+
+typedef struct INGRESS_QUEUE_TAG* INGRESS_QUEUE_HANDLE;
+
+/**
+* @brief	Creates a queue that holds at most @c capacity items, rounded up to a power of two.
+*
+* @remarks	Fails if the platform provides no atomic operations the queue can use.
+*
+* @returns	A non-NULL @c INGRESS_QUEUE_HANDLE value that is used when invoking other API functions.
+*/
+MOCKABLE_FUNCTION(, INGRESS_QUEUE_HANDLE, ingress_queue_create, size_t, capacity);
+
+/**
+* @brief	Releases the queue. Items still in the queue are not released.
+*/
+MOCKABLE_FUNCTION(, void, ingress_queue_destroy, INGRESS_QUEUE_HANDLE, ingress_queue);
+
+/**
+* @brief	Adds @c item at the end of the queue. Can be called from any thread.
+*
+* @returns	Zero if @c item was added, non-zero if the queue is full or any argument is NULL.
+*/
+MOCKABLE_FUNCTION(, int, ingress_queue_push, INGRESS_QUEUE_HANDLE, ingress_queue, void*, item);
+
+/**
+* @brief	Removes the item at the head of the queue. Only one thread at a time shall call it.
+*
+* @returns	The item, or NULL if the queue is empty.
+*/
+MOCKABLE_FUNCTION(, void*, ingress_queue_pop, INGRESS_QUEUE_HANDLE, ingress_queue);
+
+/**
+* @brief	Informs if the queue has no item ready to be popped.
+*
+* @remarks	The answer can be out of date as soon as it is returned if producers are pushing concurrently.
+*/
+MOCKABLE_FUNCTION(, bool, ingress_queue_is_empty, INGRESS_QUEUE_HANDLE, ingress_queue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*INGRESS_QUEUE_H*/
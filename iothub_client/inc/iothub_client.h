@@ -25,6 +25,8 @@ typedef struct IOTHUB_CLIENT_INSTANCE_TAG* IOTHUB_CLIENT_HANDLE;
 #include <stdint.h>
 
 #include "iothub_client_ll.h"
+#include "iothub_client_reactor.h"
+#include "iothub_client_callback_executor.h"
 #include "azure_c_shared_utility/umock_c_prod.h"
 
 #ifdef __cplusplus
@@ -122,6 +124,29 @@ extern "C"
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_SendEventAsync, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
 
+    /**
+    * @brief	Same as ::IoTHubClient_SendEventAsync, except that the message is not
+    *			copied: the client takes ownership of @p eventMessageHandle and
+    *			destroys it once the message was sent, timed out or dropped.
+    *
+    *			@b NOTE: On success the caller shall not use or destroy
+    *			@p eventMessageHandle anymore. On failure the message still
+    *			belongs to the caller.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_SendEventAsyncTakeOwnership, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
+
+    /**
+    * @brief	Same as ::IoTHubClient_SendEventAsync for the @p messageCount messages
+    *			in @p eventMessageHandles, queued as one group under a single lock.
+    *			@p eventConfirmationCallback is called once for each of the messages
+    *			with @p userContextCallback. See ::IoTHubClient_LL_SendEventBatchAsync.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_SendEventBatchAsync, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, const IOTHUB_MESSAGE_HANDLE*, eventMessageHandles, size_t, messageCount, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
+
     /**
     * @brief	This function returns the current sending status for IoTHubClient.
     *
@@ -170,6 +195,24 @@ extern "C"
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_SetConnectionStatusCallback, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK, connectionStatusCallback, void*, userContextCallback);
 
+    /**
+    * @brief	Sets up the callback invoked when the send queue fills up to its high
+    * watermark or drains down to its low watermark, as set by the OPTION_SEND_QUEUE_LIMITS
+    * option. This is a blocking call.
+    *
+    * @param	iotHubClientHandle		   	        The handle created by a call to the create function.
+    * @param	sendQueueCallback     	   	        The callback specified by the device for receiving
+    * 										        the send queue watermark notifications. This can be @c NULL.
+    * @param	userContextCallback			        User specified context that will be provided to the
+    * 										        callback. This can be @c NULL.
+    *
+    *			@b NOTE: The application behavior is undefined if the user calls
+    *			the ::IoTHubClient_Destroy function from within any callback.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_SetSendQueueCallback, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_SEND_QUEUE_CALLBACK, sendQueueCallback, void*, userContextCallback);
+
     /**
     * @brief	Sets up the connection status callback to be invoked representing the status of
     * the connection to IOT Hub. This is a blocking call.
@@ -268,6 +311,45 @@ extern "C"
     */
     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_SetOption, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, const char*, optionName, const void*, value);
 
+    /**
+    * @brief	Makes a reactor drive the client instead of a worker thread
+    *			owned by the client.
+    *
+    * @param	iotHubClientHandle	The handle created by a call to the create function.
+    * @param	reactorHandle		The handle created by a call to IoTHubClientReactor_Create.
+    *
+    *			Shall be called before any function that starts the worker
+    *			thread (sending events, setting callbacks, ...) and is not
+    *			available on a shared transport. User callbacks are invoked
+    *			from the reactor thread the client is assigned to. The reactor
+    *			runs the client when work is queued for it and at the deadline
+    *			of IoTHubClient_LL_GetNextWorkDeadline, capped by
+    *			@c do_work_freq_ms when that option is set. The reactor shall
+    *			outlive the client.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_SetReactor, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_REACTOR_HANDLE, reactorHandle);
+
+    /**
+    * @brief	Makes a callback executor run the user callbacks of the client
+    *			instead of the thread that runs IoTHubClient_LL_DoWork.
+    *
+    * @param	iotHubClientHandle	The handle created by a call to the create function.
+    * @param	executorHandle		The handle created by a call to IoTHubClientCallbackExecutor_Create.
+    *
+    *			Can be called at any time, also on a shared transport. The
+    *			callbacks queued by one call to IoTHubClient_LL_DoWork are
+    *			posted as one task, so a slow callback no longer delays the
+    *			transport. Unless the executor was created with per client
+    *			ordering, callbacks of the client may run concurrently and
+    *			out of order. IoTHubClient_Destroy shall not be called from
+    *			a callback. The executor shall outlive the client.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_SetCallbackExecutor, IOTHUB_CLIENT_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_CALLBACK_EXECUTOR_HANDLE, executorHandle);
+
     /**
     * @brief	This API specifies a call back to be used when the device receives a state update.
     *
@@ -0,0 +1,82 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file iothub_client_callback_executor.h
+*	@brief Runs the user callbacks of IoTHubClient instances on a pool of threads.
+*
+*	@details By default an IoTHubClient invokes the user callbacks (event
+*			 confirmations, C2D messages, method calls, twin updates, ...) on
+*			 the thread that runs IoTHubClient_LL_DoWork, so a slow callback
+*			 delays all the traffic of the client and, on a shared transport,
+*			 of every client on the connection. A callback executor owns
+*			 @c threadCount threads instead and each client attached to it
+*			 (see IoTHubClient_SetCallbackExecutor) posts its callbacks there.
+*			 With @c perClientOrdering the tasks of one client run one at a
+*			 time and in the order they were posted, tasks of different
+*			 clients run in parallel.
+*/
+
+#ifndef IOTHUB_CLIENT_CALLBACK_EXECUTOR_H
+#define IOTHUB_CLIENT_CALLBACK_EXECUTOR_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+typedef struct IOTHUB_CLIENT_CALLBACK_EXECUTOR_TAG* IOTHUB_CLIENT_CALLBACK_EXECUTOR_HANDLE;
+typedef struct IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT_TAG* IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT_HANDLE;
+
+/* a unit of work posted by a client */
+typedef void(*IOTHUB_CLIENT_CALLBACK_EXECUTOR_TASK)(void* context);
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+    * @brief	Creates a callback executor and starts its threads.
+    *
+    * @param	threadCount			Number of threads running the tasks.
+    * @param	perClientOrdering	When true the tasks of a client run one at a
+    *								time, in the order they were posted.
+    *
+    * @return	A non-NULL @c IOTHUB_CLIENT_CALLBACK_EXECUTOR_HANDLE value on success, @c NULL on failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_CALLBACK_EXECUTOR_HANDLE, IoTHubClientCallbackExecutor_Create, size_t, threadCount, bool, perClientOrdering);
+
+    /**
+    * @brief	Stops the threads and frees the executor. All clients shall
+    *			have been destroyed before calling this function.
+    *
+    * @param	executorHandle	The handle created by a call to IoTHubClientCallbackExecutor_Create.
+    */
+    MOCKABLE_FUNCTION(, void, IoTHubClientCallbackExecutor_Destroy, IOTHUB_CLIENT_CALLBACK_EXECUTOR_HANDLE, executorHandle);
+
+    /**
+    * @brief	Creates the task queue of a client.
+    *
+    * @return	A non-NULL @c IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT_HANDLE value on success, @c NULL on failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT_HANDLE, IoTHubClientCallbackExecutor_AddClient, IOTHUB_CLIENT_CALLBACK_EXECUTOR_HANDLE, executorHandle);
+
+    /**
+    * @brief	Removes a client, waiting for its running tasks to return. The
+    *			tasks that did not start yet run on the calling thread before
+    *			this function returns. Shall not be called from a task.
+    */
+    MOCKABLE_FUNCTION(, void, IoTHubClientCallbackExecutor_RemoveClient, IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT_HANDLE, clientHandle);
+
+    /**
+    * @brief	Queues @p task to run on one of the executor threads.
+    *
+    * @return	0 on success, a non-zero value when the task was not queued.
+    */
+    MOCKABLE_FUNCTION(, int, IoTHubClientCallbackExecutor_Post, IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT_HANDLE, clientHandle, IOTHUB_CLIENT_CALLBACK_EXECUTOR_TASK, task, void*, context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_CALLBACK_EXECUTOR_H */
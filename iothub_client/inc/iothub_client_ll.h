@@ -38,7 +38,8 @@
     IOTHUB_CLIENT_INVALID_ARG,            \
     IOTHUB_CLIENT_ERROR,                  \
     IOTHUB_CLIENT_INVALID_SIZE,           \
-    IOTHUB_CLIENT_INDEFINITE_TIME
+    IOTHUB_CLIENT_INDEFINITE_TIME,        \
+    IOTHUB_CLIENT_QUEUE_FULL
 
 /** @brief Enumeration specifying the status of calls to various APIs in this module.
 */
@@ -106,6 +107,9 @@ DEFINE_ENUM(IOTHUBMESSAGE_DISPOSITION_RESULT, IOTHUBMESSAGE_DISPOSITION_RESULT_V
 #include <stddef.h>
 #include <stdint.h>
 
+/* Value reported by IoTHubClient_LL_GetNextWorkDeadline when no timer is pending. */
+#define IOTHUB_CLIENT_LL_NO_WORK_DEADLINE UINT64_MAX
+
 #define IOTHUB_CLIENT_IOTHUB_METHOD_STATUS_VALUES \
     IOTHUB_CLIENT_IOTHUB_METHOD_STATUS_SUCCESS,   \
     IOTHUB_CLIENT_IOTHUB_METHOD_STATUS_ERROR      \
@@ -123,7 +127,8 @@ extern "C"
     IOTHUB_CLIENT_CONFIRMATION_OK,                   \
     IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY,      \
     IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT,      \
-    IOTHUB_CLIENT_CONFIRMATION_ERROR                 \
+    IOTHUB_CLIENT_CONFIRMATION_ERROR,                \
+    IOTHUB_CLIENT_CONFIRMATION_QUEUE_FULL            \
 
     /** @brief Enumeration passed in by the IoT Hub when the event confirmation
     *		   callback is invoked to indicate status of the event processing in
@@ -169,8 +174,65 @@ extern "C"
 
     DEFINE_ENUM(DEVICE_TWIN_UPDATE_STATE, DEVICE_TWIN_UPDATE_STATE_VALUES);
 
+#define IOTHUB_CLIENT_SEND_QUEUE_POLICY_VALUES \
+    IOTHUB_CLIENT_SEND_QUEUE_REJECT_NEW,       \
+    IOTHUB_CLIENT_SEND_QUEUE_DROP_OLDEST,      \
+    IOTHUB_CLIENT_SEND_QUEUE_DROP_LOWEST_PRIORITY
+
+    /** @brief Enumeration specifying what happens to a new event when the send queue
+    *		   is at one of its limits. IOTHUB_CLIENT_SEND_QUEUE_REJECT_NEW fails the send
+    *		   with IOTHUB_CLIENT_QUEUE_FULL, IOTHUB_CLIENT_SEND_QUEUE_DROP_OLDEST completes
+    *		   the oldest events not yet handed to the transport with
+    *		   IOTHUB_CLIENT_CONFIRMATION_QUEUE_FULL to make room.
+    *		   IOTHUB_CLIENT_SEND_QUEUE_DROP_LOWEST_PRIORITY does the same, starting with the
+    *		   lowest priority, but never drops an event of a higher priority than the new one.
+    */
+    DEFINE_ENUM(IOTHUB_CLIENT_SEND_QUEUE_POLICY, IOTHUB_CLIENT_SEND_QUEUE_POLICY_VALUES);
+
+#define IOTHUB_CLIENT_SEND_QUEUE_STATE_VALUES   \
+    IOTHUB_CLIENT_SEND_QUEUE_HIGH_WATERMARK,    \
+    IOTHUB_CLIENT_SEND_QUEUE_LOW_WATERMARK
+
+    /** @brief Enumeration passed to the send queue callback when the send queue
+    *		   fills up to its high watermark or drains down to its low watermark.
+    */
+    DEFINE_ENUM(IOTHUB_CLIENT_SEND_QUEUE_STATE, IOTHUB_CLIENT_SEND_QUEUE_STATE_VALUES);
+
+    /** @brief Limits of the send queue, set with the OPTION_SEND_QUEUE_LIMITS option.
+    *		   The send queue holds every event accepted by SendEventAsync whose
+    *		   confirmation callback has not been called yet.
+    */
+    typedef struct IOTHUB_CLIENT_SEND_QUEUE_LIMITS_TAG
+    {
+        size_t maxMessageCount; /*0 means no limit*/
+        size_t maxBytes; /*limit of the sum of the message bodies, 0 means no limit*/
+        unsigned int highWatermarkPercentage; /*of the limits, 0 disables the send queue callback*/
+        unsigned int lowWatermarkPercentage; /*of the limits, shall not be greater than highWatermarkPercentage*/
+        IOTHUB_CLIENT_SEND_QUEUE_POLICY policy;
+    } IOTHUB_CLIENT_SEND_QUEUE_LIMITS;
+
+    /** @brief Share of the events handed to the transport for each message priority, set with
+    *		   the OPTION_PRIORITY_WEIGHTS option. While events of several priorities are waiting,
+    *		   a priority with twice the weight of another gets twice as many events sent.
+    */
+    typedef struct IOTHUB_CLIENT_PRIORITY_WEIGHTS_TAG
+    {
+        unsigned int high; /*1 to 65536, 16 by default*/
+        unsigned int normal; /*1 to 65536, 4 by default*/
+        unsigned int low; /*1 to 65536, 1 by default*/
+    } IOTHUB_CLIENT_PRIORITY_WEIGHTS;
+
+    typedef struct IOTHUB_CLIENT_MESSAGE_STORE_CONFIG_TAG
+    {
+        const char* directory; /*existing directory, used only by this client, that keeps the events between runs*/
+        size_t maxSegmentSize; /*bytes per segment file, 0 selects 1 MB*/
+        size_t maxStoreSize; /*limit of the bytes stored and not yet confirmed, 0 means no limit*/
+        size_t maxInFlightMessages; /*stored events loaded in memory and handed to the transport at a time, 0 selects 100*/
+    } IOTHUB_CLIENT_MESSAGE_STORE_CONFIG;
+
     typedef void(*IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK)(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* userContextCallback);
     typedef void(*IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK)(IOTHUB_CLIENT_CONNECTION_STATUS result, IOTHUB_CLIENT_CONNECTION_STATUS_REASON reason, void* userContextCallback);
+    typedef void(*IOTHUB_CLIENT_SEND_QUEUE_CALLBACK)(IOTHUB_CLIENT_SEND_QUEUE_STATE state, void* userContextCallback);
     typedef IOTHUBMESSAGE_DISPOSITION_RESULT (*IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC)(IOTHUB_MESSAGE_HANDLE message, void* userContextCallback);
     typedef const TRANSPORT_PROVIDER*(*IOTHUB_CLIENT_TRANSPORT_PROVIDER)(void);
 
@@ -343,6 +405,45 @@ extern "C"
     */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SendEventAsync, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
 
+    /**
+    * @brief	Same as ::IoTHubClient_LL_SendEventAsync, except that the message is not
+    *			copied: the client takes ownership of @p eventMessageHandle and
+    *			destroys it once the message was sent, timed out or dropped.
+    *
+    *			@b NOTE: On success the caller shall not use or destroy
+    *			@p eventMessageHandle anymore. On failure the message still
+    *			belongs to the caller.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SendEventAsyncTakeOwnership, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_MESSAGE_HANDLE, eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
+
+    /**
+    * @brief	Asynchronous call to send the @p messageCount messages in
+    *			@p eventMessageHandles as one group. The messages are copied and
+    *			queued together, next to each other, at the cost of a single
+    *			allocation, and @p eventConfirmationCallback is called once for
+    *			each of them with @p userContextCallback.
+    *
+    *			Either all the messages are queued or none of them is, except
+    *			with the "message_store" option, where they are appended to the
+    *			store one by one and the ones before a failing message stay queued.
+    *			The group is ordered in the send queue as one event of the
+    *			highest priority of its messages.
+    *
+    * @param	iotHubClientHandle		   	The handle created by a call to the create function.
+    * @param	eventMessageHandles		   	The array of handles to the IoT Hub messages.
+    * @param	messageCount			   	The number of messages in @p eventMessageHandles.
+    * @param	eventConfirmationCallback  	The callback called for each message of the group.
+    *										The user can specify a @c NULL value here to
+    * 										indicate that no callback is required.
+    * @param	userContextCallback			User specified context that will be provided to the
+    * 										callback. This can be @c NULL.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SendEventBatchAsync, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, const IOTHUB_MESSAGE_HANDLE*, eventMessageHandles, size_t, messageCount, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK, eventConfirmationCallback, void*, userContextCallback);
+
     /**
     * @brief	This function returns the current sending status for IoTHubClient.
     *
@@ -391,6 +492,25 @@ extern "C"
     */
      MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SetConnectionStatusCallback, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK, connectionStatusCallback, void*, userContextCallback);
 
+    /**
+    * @brief	Sets up the callback invoked when the send queue fills up to its high
+    * watermark or drains down to its low watermark, as set by the OPTION_SEND_QUEUE_LIMITS
+    * option. Producers can use it to throttle before IoTHubClient_LL_SendEventAsync
+    * starts returning IOTHUB_CLIENT_QUEUE_FULL.
+    *
+    * @param	iotHubClientHandle		   	        The handle created by a call to the create function.
+    * @param	sendQueueCallback     	   	        The callback specified by the device for receiving
+    * 										        the send queue watermark notifications. This can be @c NULL.
+    * @param	userContextCallback			        User specified context that will be provided to the
+    * 										        callback. This can be @c NULL.
+    *
+    *			@b NOTE: The application behavior is undefined if the user calls
+    *			the ::IoTHubClient_LL_Destroy function from within any callback.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_SetSendQueueCallback, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, IOTHUB_CLIENT_SEND_QUEUE_CALLBACK, sendQueueCallback, void*, userContextCallback);
+
     /**
     * @brief	Sets up the connection status callback to be invoked representing the status of
     * the connection to IOT Hub. This is a blocking call.
@@ -450,6 +570,29 @@ extern "C"
     */
      MOCKABLE_FUNCTION(, void, IoTHubClient_LL_DoWork, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle);
 
+    /**
+    * @brief	This function returns in the out parameter @p msToNextWork the
+    * 			number of milliseconds until the earliest deadline the client
+    * 			and its transport are tracking, i.e. the latest moment by which
+    * 			::IoTHubClient_LL_DoWork should be called again.
+    *
+    * @param	iotHubClientHandle	The handle created by a call to the create function.
+    * @param	msToNextWork		Out parameter; 0 means ::IoTHubClient_LL_DoWork
+    * 								should be called right away and
+    * 								IOTHUB_CLIENT_LL_NO_WORK_DEADLINE means no timer
+    * 								is pending.
+    *
+    *			The deadline covers message timeouts, pending outgoing items,
+    *			keep-alives, token refreshes, HTTP polling and reconnection
+    *			retries. It does not cover data arriving from the network: the
+    *			sockets are owned by the TLS/xio layer and are not exposed, so
+    *			hosts that want to receive messages promptly should cap the
+    *			value with their own receive latency.
+    *
+    * @return	IOTHUB_CLIENT_OK upon success or an error code upon failure.
+    */
+     MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, IoTHubClient_LL_GetNextWorkDeadline, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, uint64_t*, msToNextWork);
+
     /**
     * @brief	This API sets a runtime option identified by parameter @p optionName
     * 			to a value pointed to by @p value. @p optionName and the data type
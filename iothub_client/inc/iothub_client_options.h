@@ -33,6 +33,36 @@ extern "C"
     static const char* OPTION_MIN_POLLING_TIME = "MinimumPollingTime";
     static const char* OPTION_BATCHING = "Batching";
 
+    /*
+    * @brief HTTP only. zlib level (1 to 9, value is a pointer to an int) used to gzip the body of batched events; 0, the default, sends them uncompressed.
+    *        Requires the SDK to be built with use_http_compression. A batch is sent uncompressed when compressing it does not make it smaller.
+    */
+    static const char* OPTION_HTTP_COMPRESSION_LEVEL = "http_compression_level";
+    /*
+    * @brief HTTP only. Batches smaller than this many bytes (value is a pointer to a size_t) are sent uncompressed. The default is 1024.
+    */
+    static const char* OPTION_HTTP_COMPRESSION_MIN_SIZE = "http_compression_min_size";
+    /*
+    * @brief HTTP only. Adapts the polling for cloud-to-device messages to the traffic. Value is a pointer to an IOTHUB_CLIENT_HTTP_ADAPTIVE_POLLING.
+    *        While adaptive polling is on, MinimumPollingTime is not used.
+    */
+    static const char* OPTION_HTTP_ADAPTIVE_POLLING = "http_adaptive_polling";
+    /*
+    * @brief MQTT only. Maximum number of telemetry messages published and waiting for their PUBACK (value is a pointer to a size_t); the others
+    *        stay queued until acks come back. 0 means no limit, which is the default.
+    */
+    static const char* OPTION_MQTT_MAX_IN_FLIGHT = "mqtt_max_in_flight";
+    /*
+    * @brief MQTT only. Time, in milliseconds, a telemetry message waits for its PUBACK before it is published again (value is a pointer to a size_t).
+    *        A message still not acknowledged after two resends fails with IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT. The default is 60000.
+    */
+    static const char* OPTION_MQTT_RESEND_INTERVAL_MS = "mqtt_resend_interval_ms";
+    /*
+    * @brief MQTT only. Publishes telemetry with QoS 0 (value is a pointer to a bool): messages are not tracked for a PUBACK nor resent, and are
+    *        confirmed with IOTHUB_CLIENT_CONFIRMATION_OK once handed to the connection. IoTHubMessage_SetDelivery overrides it per message. The default is false.
+    */
+    static const char* OPTION_MQTT_TELEMETRY_AT_MOST_ONCE = "mqtt_telemetry_at_most_once";
+
     static const char* OPTION_MESSAGE_TIMEOUT = "messageTimeout";
     static const char* OPTION_PRODUCT_INFO = "product_info";
     /*
@@ -58,6 +88,43 @@ extern "C"
     //diagnostic sampling percentage value, [0-100]
     static const char* OPTION_DIAGNOSTIC_SAMPLING_PERCENTAGE = "diag_sampling_percentage";
 
+    /*
+    * @brief Maximum time, in milliseconds, the IoTHubClient worker thread stays idle between two calls to IoTHubClient_LL_DoWork.
+    *        The worker thread is woken up immediately when new outgoing work is queued and otherwise sleeps until the deadline
+    *        returned by IoTHubClient_LL_GetNextWorkDeadline, so this value is only an upper bound on top of that deadline.
+    *        It is not set by default; the value must be greater than 0.
+    *        Only applies to clients that own their worker thread (i.e. not created with IoTHubClient_CreateWithTransport).
+    */
+    static const char* OPTION_DO_WORK_FREQUENCY_IN_MS = "do_work_freq_ms";
+
+    /*
+    * @brief Bounds the events accepted by SendEventAsync and not yet confirmed. Value is a pointer to an IOTHUB_CLIENT_SEND_QUEUE_LIMITS.
+    *        When a limit would be exceeded the policy either fails the send with IOTHUB_CLIENT_QUEUE_FULL or drops the oldest events
+    *        not yet handed to the transport. By default the send queue is unbounded.
+    */
+    static const char* OPTION_SEND_QUEUE_LIMITS = "send_queue_limits";
+
+    /*
+    * @brief Keeps the events sent with SendEventAsync in an append-only log on disk instead of memory, so they survive
+    *        connection losses and restarts. Value is a pointer to an IOTHUB_CLIENT_MESSAGE_STORE_CONFIG. Events left in the
+    *        log by a previous run are sent first. Can only be set once per client.
+    */
+    static const char* OPTION_MESSAGE_STORE = "message_store";
+
+    /*
+    * @brief Sets how the events waiting to be sent are shared between message priorities (see IoTHubMessage_SetPriority).
+    *        Value is a pointer to an IOTHUB_CLIENT_PRIORITY_WEIGHTS. Applies to the events sent after it is set.
+    */
+    static const char* OPTION_PRIORITY_WEIGHTS = "priority_weights";
+
+    /*
+    * @brief Lets IoTHubClient_SendEventAsync queue events without taking the client lock: they are pushed to a lock-free queue
+    *        of this many events (a size_t, rounded up to a power of two) and moved to the send queue by the worker thread.
+    *        Errors of the send queue (e.g. IOTHUB_CLIENT_QUEUE_FULL) are then only reported to the event confirmation callback.
+    *        When the queue is full events are sent through the lock. Can only be set once, before the first event is sent, and not on a shared transport.
+    */
+    static const char* OPTION_INGRESS_QUEUE_SIZE = "ingress_queue_size";
+
 #ifdef __cplusplus
 }
 #endif
@@ -51,6 +51,13 @@ typedef struct IOTHUB_MESSAGE_LIST_TAG
     void* context; 
     DLIST_ENTRY entry;
     tickcounter_ms_t ms_timesOutAfter; /* a value of "0" means "no timeout", if the IOTHUBCLIENT_LL's handle tickcounter > msTimesOutAfer then the message shall timeout*/
+    size_t queuedBytes; /*body size accounted against the send queue byte limit, 0 when no byte limit was set at the time the message was queued*/
+    bool isStored; /*true when the message was loaded from the message store*/
+    uint64_t storeSequenceNumber;
+    IOTHUB_MESSAGE_PRIORITY priority;
+    uint64_t sendOrder; /*waitingToSend is sorted by sendOrder*/
+    struct IOTHUB_MESSAGE_LIST_TAG* batchBlock; /*first entry of the block allocated for a batch of events, NULL for an event allocated by itself; the entries of a batch are next to each other in waitingToSend*/
+    size_t batchPending; /*in the first entry of a batch block only, the number of entries of the block not freed yet*/
 }IOTHUB_MESSAGE_LIST;
 
 typedef struct IOTHUB_DEVICE_TWIN_TAG
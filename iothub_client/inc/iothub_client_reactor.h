@@ -0,0 +1,76 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file iothub_client_reactor.h
+*	@brief Drives many IoTHubClient instances from a small, fixed set of threads.
+*
+*	@details By default every IoTHubClient owns a worker thread. A reactor
+*			 owns @c loopCount worker threads instead and each client attached
+*			 to it (see IoTHubClient_SetReactor) is assigned to the least
+*			 loaded one. A loop only runs a client when work was queued for it
+*			 or when the deadline reported by the client expired, so idle
+*			 clients cost no CPU time between deadlines.
+*/
+
+#ifndef IOTHUB_CLIENT_REACTOR_H
+#define IOTHUB_CLIENT_REACTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+typedef struct IOTHUB_CLIENT_REACTOR_TAG* IOTHUB_CLIENT_REACTOR_HANDLE;
+typedef struct IOTHUB_CLIENT_REACTOR_CLIENT_TAG* IOTHUB_CLIENT_REACTOR_CLIENT_HANDLE;
+
+/* runs one round of work for a client and returns the number of milliseconds until it needs to run again */
+typedef uint64_t(*IOTHUB_CLIENT_REACTOR_DO_WORK)(void* context);
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+    * @brief	Creates a reactor and starts its worker threads.
+    *
+    * @param	loopCount	Number of worker threads (loops), typically the
+    *						number of cores available to the process.
+    *
+    * @return	A non-NULL @c IOTHUB_CLIENT_REACTOR_HANDLE value on success, @c NULL on failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_REACTOR_HANDLE, IoTHubClientReactor_Create, size_t, loopCount);
+
+    /**
+    * @brief	Stops the worker threads and frees the reactor. All clients
+    *			shall have been destroyed before calling this function.
+    *
+    * @param	reactorHandle	The handle created by a call to IoTHubClientReactor_Create.
+    */
+    MOCKABLE_FUNCTION(, void, IoTHubClientReactor_Destroy, IOTHUB_CLIENT_REACTOR_HANDLE, reactorHandle);
+
+    /**
+    * @brief	Assigns a client to the least loaded loop. @p doWork runs on
+    *			that loop right away and then whenever the deadline it returned
+    *			expired or IoTHubClientReactor_WakeClient was called.
+    *
+    * @return	A non-NULL @c IOTHUB_CLIENT_REACTOR_CLIENT_HANDLE value on success, @c NULL on failure.
+    */
+    MOCKABLE_FUNCTION(, IOTHUB_CLIENT_REACTOR_CLIENT_HANDLE, IoTHubClientReactor_AddClient, IOTHUB_CLIENT_REACTOR_HANDLE, reactorHandle, IOTHUB_CLIENT_REACTOR_DO_WORK, doWork, void*, context);
+
+    /**
+    * @brief	Removes a client from its loop, waiting for a running @c doWork
+    *			to return first. Shall not be called from the client's own @c doWork.
+    */
+    MOCKABLE_FUNCTION(, void, IoTHubClientReactor_RemoveClient, IOTHUB_CLIENT_REACTOR_CLIENT_HANDLE, clientHandle);
+
+    /**
+    * @brief	Makes the loop run the client's @c doWork as soon as possible.
+    */
+    MOCKABLE_FUNCTION(, void, IoTHubClientReactor_WakeClient, IOTHUB_CLIENT_REACTOR_CLIENT_HANDLE, clientHandle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_CLIENT_REACTOR_H */
@@ -42,6 +42,26 @@ IOTHUBMESSAGE_UNKNOWN \
 */
 DEFINE_ENUM(IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_CONTENT_TYPE_VALUES);
 
+#define IOTHUB_MESSAGE_PRIORITY_VALUES \
+IOTHUB_MESSAGE_PRIORITY_LOW, \
+IOTHUB_MESSAGE_PRIORITY_NORMAL, \
+IOTHUB_MESSAGE_PRIORITY_HIGH \
+
+/** @brief Enumeration specifying how urgently a device-to-cloud message is sent.
+*  Messages are created with IOTHUB_MESSAGE_PRIORITY_NORMAL.
+*/
+DEFINE_ENUM(IOTHUB_MESSAGE_PRIORITY, IOTHUB_MESSAGE_PRIORITY_VALUES);
+
+#define IOTHUB_MESSAGE_DELIVERY_VALUES \
+IOTHUB_MESSAGE_DELIVERY_DEFAULT, \
+IOTHUB_MESSAGE_DELIVERY_AT_LEAST_ONCE, \
+IOTHUB_MESSAGE_DELIVERY_AT_MOST_ONCE \
+
+/** @brief Enumeration specifying the delivery guarantee of a device-to-cloud message.
+*  Messages are created with IOTHUB_MESSAGE_DELIVERY_DEFAULT, which leaves the choice to the transport.
+*/
+DEFINE_ENUM(IOTHUB_MESSAGE_DELIVERY, IOTHUB_MESSAGE_DELIVERY_VALUES);
+
 typedef struct IOTHUB_MESSAGE_HANDLE_DATA_TAG* IOTHUB_MESSAGE_HANDLE;
 
 /** @brief diagnostic related data*/
@@ -53,6 +73,19 @@ typedef struct IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA_TAG
 
 static const char DIAG_CREATION_TIME_UTC_PROPERTY_NAME[] = "diag_creation_time_utc";
 
+/** @brief One contiguous piece of a message body. */
+typedef struct IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT_TAG
+{
+    const unsigned char* buffer;
+    size_t size;
+}IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT;
+
+/** @brief Signature of the function called when the SDK no longer needs a
+*          byte array passed to IoTHubMessage_CreateFromExternalByteArray or
+*          IoTHubMessage_CreateFromByteArraySegments.
+*/
+typedef void(*IOTHUB_MESSAGE_BYTE_ARRAY_RELEASE_CALLBACK)(const unsigned char* byteArray, size_t size, void* userContextCallback);
+
 /**
 * @brief   Creates a new IoT hub message from a byte array. The type of the
 *          message will be set to @c IOTHUBMESSAGE_BYTEARRAY.
@@ -65,6 +98,52 @@ static const char DIAG_CREATION_TIME_UTC_PROPERTY_NAME[] = "diag_creation_time_u
 */
 MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_HANDLE, IoTHubMessage_CreateFromByteArray, const unsigned char*, byteArray, size_t, size);
 
+/**
+* @brief   Creates a new IoT hub message that refers to a byte array owned by
+*          the caller instead of copying it. The type of the message will be
+*          set to @c IOTHUBMESSAGE_BYTEARRAY.
+*
+* @param   byteArray           The byte array holding the message body. It
+*                              shall stay valid and unchanged until
+*                              @p releaseCallback is called.
+* @param   size                The size of the byte array.
+* @param   releaseCallback     Called exactly once, when the message and all its
+*                              clones have been destroyed. For a message that
+*                              was sent this happens after the transport is done
+*                              with it, which may be on the client's worker thread.
+*                              The callback shall not call into the IoT hub client.
+* @param   userContextCallback User specified context passed to @p releaseCallback.
+*
+* @return  A valid @c IOTHUB_MESSAGE_HANDLE if the message was successfully
+*          created or @c NULL in case an error occurs. On failure
+*          @p releaseCallback is not called and the caller keeps ownership of
+*          @p byteArray.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_HANDLE, IoTHubMessage_CreateFromExternalByteArray, const unsigned char*, byteArray, size_t, size, IOTHUB_MESSAGE_BYTE_ARRAY_RELEASE_CALLBACK, releaseCallback, void*, userContextCallback);
+
+/**
+* @brief   Creates a new IoT hub message whose body is the concatenation of
+*          @p segmentCount byte arrays owned by the caller. The byte arrays
+*          are not copied; transports that understand segments write them
+*          out one after the other. The type of the message will be set to
+*          @c IOTHUBMESSAGE_BYTEARRAY.
+*
+* @param   segments            The segments making up the body. The array itself
+*                              is copied, the buffers it points to shall stay
+*                              valid and unchanged until @p releaseCallback is
+*                              called for them.
+* @param   segmentCount        The number of segments, at least 1.
+* @param   releaseCallback     Called once for every segment when the SDK no
+*                              longer needs it, under the same rules as for
+*                              IoTHubMessage_CreateFromExternalByteArray.
+* @param   userContextCallback User specified context passed to @p releaseCallback.
+*
+* @return  A valid @c IOTHUB_MESSAGE_HANDLE if the message was successfully
+*          created or @c NULL in case an error occurs. On failure
+*          @p releaseCallback is not called.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_HANDLE, IoTHubMessage_CreateFromByteArraySegments, const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT*, segments, size_t, segmentCount, IOTHUB_MESSAGE_BYTE_ARRAY_RELEASE_CALLBACK, releaseCallback, void*, userContextCallback);
+
 /**
 * @brief   Creates a new IoT hub message from a null terminated string.  The
 *          type of the message will be set to @c IOTHUBMESSAGE_STRING.
@@ -105,6 +184,26 @@ MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_HANDLE, IoTHubMessage_Clone, IOTHUB_MESSAGE_H
 */
 MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_RESULT, IoTHubMessage_GetByteArray, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle, const unsigned char**, buffer, size_t*, size);
 
+/**
+* @brief   Fetches the segments making up the body of a message of type
+*          @c IOTHUBMESSAGE_BYTEARRAY without gathering them. A message that
+*          was not created by IoTHubMessage_CreateFromByteArraySegments has
+*          exactly one segment.
+*
+* @param   iotHubMessageHandle Handle to the message.
+* @param   segments            Receives a pointer to the segments. It stays valid
+*                              until the message is modified, destroyed or
+*                              passed to IoTHubMessage_GetByteArray.
+* @param   segmentCount        Receives the number of segments.
+*
+* @remarks IoTHubMessage_GetByteArray still works on a message made of several
+*          segments: it gathers them once in a buffer owned by the message.
+*
+* @return  Returns IOTHUB_MESSAGE_OK if the segments were fetched successfully
+*          or an error code otherwise.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_RESULT, IoTHubMessage_GetByteArraySegments, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle, const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT**, segments, size_t*, segmentCount);
+
 /**
 * @brief   Returns the null terminated string stored in the message.
 *          If the content type of the message is not @c IOTHUBMESSAGE_STRING
@@ -178,6 +277,18 @@ MOCKABLE_FUNCTION(, const char*, IoTHubMessage_GetContentEncodingSystemProperty,
 */
 MOCKABLE_FUNCTION(, MAP_HANDLE, IoTHubMessage_Properties, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle);
 
+/**
+* @brief   Gets a handle to the message's properties map for reading only.
+*
+*          Unlike @c IoTHubMessage_Properties, the map is never copied when the message
+*          shares its content with a clone, so it must not be modified.
+*
+* @param   iotHubMessageHandle Handle to the message.
+*
+* @return  A @c MAP_HANDLE pointing to the properties map for this message.
+*/
+MOCKABLE_FUNCTION(, MAP_HANDLE, IoTHubMessage_GetReadOnlyProperties, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle);
+
 /**
 * @brief   Gets the MessageId from the IOTHUB_MESSAGE_HANDLE.
 *
@@ -218,6 +329,53 @@ MOCKABLE_FUNCTION(, const char*, IoTHubMessage_GetCorrelationId, IOTHUB_MESSAGE_
 */
 MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_RESULT, IoTHubMessage_SetCorrelationId, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle, const char*, correlationId);
 
+/**
+* @brief   Sets the priority of the message.
+*
+* @param   iotHubMessageHandle Handle to the message.
+* @param   priority The priority of the message.
+*
+* @remarks IoTHubClient_LL_SendEventAsync hands messages of a higher priority to the transport first,
+*          while still sending a share of the lower priority messages (see OPTION_PRIORITY_WEIGHTS).
+*
+* @return  Returns IOTHUB_MESSAGE_OK if the priority was set successfully
+*          or an error code otherwise.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_RESULT, IoTHubMessage_SetPriority, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle, IOTHUB_MESSAGE_PRIORITY, priority);
+
+/**
+* @brief   Gets the priority of the message.
+*
+* @param   iotHubMessageHandle Handle to the message.
+*
+* @return  The priority of the message, IOTHUB_MESSAGE_PRIORITY_NORMAL if @c iotHubMessageHandle is NULL.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_PRIORITY, IoTHubMessage_GetPriority, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle);
+
+/**
+* @brief   Sets the delivery guarantee of the message.
+*
+* @param   iotHubMessageHandle Handle to the message.
+* @param   delivery The delivery guarantee of the message.
+*
+* @remarks Only the MQTT transports honor it: an IOTHUB_MESSAGE_DELIVERY_AT_MOST_ONCE message is published with QoS 0,
+*          is not tracked for an acknowledgement or resent, and is confirmed as soon as it is handed to the connection.
+*          IOTHUB_MESSAGE_DELIVERY_DEFAULT follows OPTION_MQTT_TELEMETRY_AT_MOST_ONCE.
+*
+* @return  Returns IOTHUB_MESSAGE_OK if the delivery guarantee was set successfully
+*          or an error code otherwise.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_RESULT, IoTHubMessage_SetDelivery, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle, IOTHUB_MESSAGE_DELIVERY, delivery);
+
+/**
+* @brief   Gets the delivery guarantee of the message.
+*
+* @param   iotHubMessageHandle Handle to the message.
+*
+* @return  The delivery guarantee of the message, IOTHUB_MESSAGE_DELIVERY_DEFAULT if @c iotHubMessageHandle is NULL.
+*/
+MOCKABLE_FUNCTION(, IOTHUB_MESSAGE_DELIVERY, IoTHubMessage_GetDelivery, IOTHUB_MESSAGE_HANDLE, iotHubMessageHandle);
+
 /**
 * @brief   Gets the DiagnosticData from the IOTHUB_MESSAGE_HANDLE. CAUTION: SDK user should not call it directly, it is for internal use only.
 *
@@ -9,10 +9,40 @@
 #ifdef __cplusplus
 extern "C"
 {
+#include <cstddef>
+#else
+#include <stddef.h>
 #endif
 
+	/** @brief	Bounds of the adaptive polling for cloud-to-device messages, set with the OPTION_HTTP_ADAPTIVE_POLLING option.
+	*			Devices poll again right away after receiving a message, wait minimumIntervalInSeconds after the first
+	*			empty response and double the wait after every further one, up to maximumIntervalInSeconds. Sending
+	*			telemetry brings the wait back to minimumIntervalInSeconds.
+	*/
+	typedef struct IOTHUB_CLIENT_HTTP_ADAPTIVE_POLLING_TAG
+	{
+		unsigned int minimumIntervalInSeconds; /*at least 1*/
+		unsigned int maximumIntervalInSeconds; /*0 turns adaptive polling off and brings back the fixed MinimumPollingTime*/
+	} IOTHUB_CLIENT_HTTP_ADAPTIVE_POLLING;
+
+	/** @brief	Polling counters of all the devices of a transport, filled in by IoTHubTransportHttp_GetPollingStatistics.
+	*/
+	typedef struct IOTHUB_CLIENT_HTTP_POLLING_STATISTICS_TAG
+	{
+		size_t pollCount; /*GET requests that got an answer from the service*/
+		size_t emptyPollCount; /*answered with 204, no message*/
+		size_t messagePollCount; /*answered with 200, a message*/
+		size_t failedPollCount; /*GET requests that could not be made or were answered with any other status*/
+		unsigned int currentIntervalInSeconds; /*the shortest wait before the next GET among the subscribed devices*/
+	} IOTHUB_CLIENT_HTTP_POLLING_STATISTICS;
+
 	extern const TRANSPORT_PROVIDER* HTTP_Protocol(void);
 
+	/** @brief	Reads the polling counters of an HTTP transport. The handle of a shared transport is returned by
+	*			IoTHubTransport_GetLLTransport; hold the lock returned by IoTHubTransport_GetLock while reading it.
+	*/
+	extern IOTHUB_CLIENT_RESULT IoTHubTransportHttp_GetPollingStatistics(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_HTTP_POLLING_STATISTICS* pollingStatistics);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,124 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file	message_store.h
+*	@brief	A persistent, append-only log of IoT Hub messages.
+*
+*	@details	Messages are appended to segment files in a directory and read back in the order they
+*				were appended. A message stays in the log until it is acknowledged; acknowledgements are
+*				recorded in a checkpoint file, so after a restart reading resumes at the oldest message
+*				that was not acknowledged. Segments whose messages were all acknowledged are deleted.
+*/
+
+#ifndef MESSAGE_STORE_H
+#define MESSAGE_STORE_H
+
+#include "azure_c_shared_utility/macro_utils.h"
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "iothub_message.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#include <cstddef>
+#include <cstdint>
+#else
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#endif
+
+typedef struct MESSAGE_STORE_TAG* MESSAGE_STORE_HANDLE;
+
+#define MESSAGE_STORE_RESULT_VALUES \
+    MESSAGE_STORE_OK,               \
+    MESSAGE_STORE_ERROR,            \
+    MESSAGE_STORE_FULL,             \
+    MESSAGE_STORE_EMPTY
+
+DEFINE_ENUM(MESSAGE_STORE_RESULT, MESSAGE_STORE_RESULT_VALUES);
+
+typedef struct MESSAGE_STORE_CONFIG_TAG
+{
+    /**
+    * @brief	Existing directory that holds the segment and checkpoint files. It shall not be shared with another store.
+    */
+    const char* directory;
+    /**
+    * @brief	A new segment file is started once appending a message would make the current one larger than this. Zero selects 1 MB.
+    */
+    size_t max_segment_size;
+    /**
+    * @brief	Maximum number of bytes of messages not yet acknowledged. Zero means no limit.
+    */
+    size_t max_store_size;
+} MESSAGE_STORE_CONFIG;
+
+/**
+* @brief	Opens the store in @c config->directory, creating it if the directory is empty.
+*
+* @remarks	Messages appended and not acknowledged before the store was last destroyed (or before the process stopped) are read again first.
+*			A message that was only partially written is ignored.
+*
+* @returns	A non-NULL @c MESSAGE_STORE_HANDLE value that is used when invoking other API functions.
+*/
+MOCKABLE_FUNCTION(, MESSAGE_STORE_HANDLE, message_store_create, const MESSAGE_STORE_CONFIG*, config);
+
+/**
+* @brief	Flushes the store and releases all the resources it uses. The files are kept.
+*/
+MOCKABLE_FUNCTION(, void, message_store_destroy, MESSAGE_STORE_HANDLE, message_store);
+
+/**
+* @brief	Appends a copy of @c message to the store.
+*
+* @remarks	The content, message id, correlation id, content type, content encoding and properties of the message are stored.
+*			The message is only guaranteed to be on the disk after the next call to @c message_store_flush.
+*
+* @param	sequence_number	Set to the number that identifies the message in the store. Numbers increase by one for each message.
+*
+* @returns	@c MESSAGE_STORE_OK on success, @c MESSAGE_STORE_FULL if the message does not fit within @c max_store_size, @c MESSAGE_STORE_ERROR otherwise.
+*/
+MOCKABLE_FUNCTION(, MESSAGE_STORE_RESULT, message_store_append, MESSAGE_STORE_HANDLE, message_store, IOTHUB_MESSAGE_HANDLE, message, uint64_t*, sequence_number);
+
+/**
+* @brief	Reads the next message, in the order they were appended.
+*
+* @param	message	Set to a new message that the caller shall destroy.
+* @param	sequence_number	Set to the number the message got when it was appended.
+*
+* @returns	@c MESSAGE_STORE_OK on success, @c MESSAGE_STORE_EMPTY if every message has already been read, @c MESSAGE_STORE_ERROR otherwise.
+*/
+MOCKABLE_FUNCTION(, MESSAGE_STORE_RESULT, message_store_read_next, MESSAGE_STORE_HANDLE, message_store, IOTHUB_MESSAGE_HANDLE*, message, uint64_t*, sequence_number);
+
+/**
+* @brief	Informs if every message appended has already been read.
+*
+* @returns	Zero if no errors occur, non-zero otherwise.
+*/
+MOCKABLE_FUNCTION(, int, message_store_is_empty, MESSAGE_STORE_HANDLE, message_store, bool*, is_empty);
+
+/**
+* @brief	Removes a message that was read from the store.
+*
+* @remarks	Messages can be acknowledged in any order; the checkpoint moves past a message once it and all the older messages are acknowledged.
+*			Messages read and not acknowledged are read again after the store is re-opened.
+*
+* @returns	Zero if no errors occur, non-zero otherwise (including when @c sequence_number was not read or was already acknowledged).
+*/
+MOCKABLE_FUNCTION(, int, message_store_acknowledge, MESSAGE_STORE_HANDLE, message_store, uint64_t, sequence_number);
+
+/**
+* @brief	Commits the messages appended and the checkpoint to the disk, and deletes the segments that only hold acknowledged messages.
+*
+* @remarks	Meant to be called periodically, so that many appends and acknowledgements are written out together.
+*
+* @returns	Zero if no errors occur, non-zero otherwise.
+*/
+MOCKABLE_FUNCTION(, int, message_store_flush, MESSAGE_STORE_HANDLE, message_store);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*MESSAGE_STORE_H*/
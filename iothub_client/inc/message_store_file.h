@@ -0,0 +1,91 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file	message_store_file.h
+*	@brief	Minimal file access used by the message store.
+*
+*	@details	Files are accessed sequentially through large buffers, so appends and replays
+*				turn into a few big writes and reads instead of one per message.
+*/
+
+#ifndef MESSAGE_STORE_FILE_H
+#define MESSAGE_STORE_FILE_H
+
+#include "azure_c_shared_utility/macro_utils.h"
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#include <cstddef>
+#else
+#include <stddef.h>
+#endif
+
+typedef struct MESSAGE_STORE_FILE_TAG* MESSAGE_STORE_FILE_HANDLE;
+
+#define MESSAGE_STORE_FILE_MODE_VALUES  \
+    MESSAGE_STORE_FILE_READ,            \
+    MESSAGE_STORE_FILE_APPEND,          \
+    MESSAGE_STORE_FILE_WRITE
+
+DEFINE_ENUM(MESSAGE_STORE_FILE_MODE, MESSAGE_STORE_FILE_MODE_VALUES);
+
+/**
+* @brief	Opens a file.
+*
+* @param	path	Path of the file.
+* @param	mode	@c MESSAGE_STORE_FILE_READ opens an existing file for reading, @c MESSAGE_STORE_FILE_APPEND
+*					opens or creates a file and writes at its end, @c MESSAGE_STORE_FILE_WRITE creates or truncates a file.
+*
+* @returns	A non-NULL handle if the file could be opened, NULL otherwise (including when a file opened for reading does not exist).
+*/
+MOCKABLE_FUNCTION(, MESSAGE_STORE_FILE_HANDLE, message_store_file_open, const char*, path, MESSAGE_STORE_FILE_MODE, mode);
+
+/**
+* @brief	Closes a file, writing out anything still buffered.
+*/
+MOCKABLE_FUNCTION(, void, message_store_file_close, MESSAGE_STORE_FILE_HANDLE, file);
+
+/**
+* @brief	Writes @c size bytes to the file. The bytes may stay buffered until @c message_store_file_flush is called.
+*
+* @returns	Zero if all bytes were written, non-zero otherwise.
+*/
+MOCKABLE_FUNCTION(, int, message_store_file_write, MESSAGE_STORE_FILE_HANDLE, file, const unsigned char*, buffer, size_t, size);
+
+/**
+* @brief	Reads up to @c size bytes from the current position of the file.
+*
+* @remarks	Reaching the end of the file is not sticky: bytes appended (and flushed) through another handle are returned by the next read.
+*
+* @returns	The number of bytes read, less than @c size only at the end of the file or on error.
+*/
+MOCKABLE_FUNCTION(, size_t, message_store_file_read, MESSAGE_STORE_FILE_HANDLE, file, unsigned char*, buffer, size_t, size);
+
+/**
+* @brief	Writes out the buffered bytes and asks the operating system to commit them to the disk, where the platform allows it.
+*
+* @returns	Zero if no errors occur, non-zero otherwise.
+*/
+MOCKABLE_FUNCTION(, int, message_store_file_flush, MESSAGE_STORE_FILE_HANDLE, file);
+
+/**
+* @brief	Deletes a file.
+*
+* @returns	Zero if no errors occur, non-zero otherwise.
+*/
+MOCKABLE_FUNCTION(, int, message_store_file_remove, const char*, path);
+
+/**
+* @brief	Replaces @c destination with @c source, which stops existing under its old name.
+*
+* @returns	Zero if no errors occur, non-zero otherwise.
+*/
+MOCKABLE_FUNCTION(, int, message_store_file_replace, const char*, source, const char*, destination);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*MESSAGE_STORE_FILE_H*/
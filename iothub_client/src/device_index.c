@@ -0,0 +1,301 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "device_index.h"
+
+/*the buckets are chains of items with the same hash modulo the bucket count; the table doubles when there
+  are more items than buckets, so a chain holds one item on average. Independently of the buckets the items
+  form a doubly linked list in the order they were added, which gives constant time removal and iteration*/
+#define INITIAL_BUCKET_COUNT 16
+
+typedef struct DEVICE_INDEX_ITEM_TAG
+{
+    const void* value;
+    const char* device_id;
+    size_t hash;
+    struct DEVICE_INDEX_ITEM_TAG* next_in_bucket;
+    struct DEVICE_INDEX_ITEM_TAG* previous;
+    struct DEVICE_INDEX_ITEM_TAG* next;
+} DEVICE_INDEX_ITEM;
+
+typedef struct DEVICE_INDEX_TAG
+{
+    DEVICE_INDEX_ITEM** buckets;
+    size_t bucket_count;
+    size_t count;
+    DEVICE_INDEX_ITEM* head;
+    DEVICE_INDEX_ITEM* tail;
+} DEVICE_INDEX;
+
+/*FNV-1a*/
+static size_t hash_device_id(const char* device_id)
+{
+    uint32_t hash = 2166136261u;
+    while (*device_id != '\0')
+    {
+        hash ^= (uint8_t)*device_id;
+        hash *= 16777619u;
+        device_id++;
+    }
+    return (size_t)hash;
+}
+
+static DEVICE_INDEX_ITEM* find_item(DEVICE_INDEX* device_index, const char* device_id, size_t hash)
+{
+    DEVICE_INDEX_ITEM* item = device_index->buckets[hash & (device_index->bucket_count - 1)];
+    while (item != NULL && (item->hash != hash || strcmp(item->device_id, device_id) != 0))
+    {
+        item = item->next_in_bucket;
+    }
+    return item;
+}
+
+/*when the larger table cannot be allocated the index keeps working with longer chains*/
+static void grow_buckets(DEVICE_INDEX* device_index)
+{
+    size_t new_bucket_count = device_index->bucket_count * 2;
+    DEVICE_INDEX_ITEM** new_buckets;
+
+    if (new_bucket_count < device_index->bucket_count ||
+        new_bucket_count > SIZE_MAX / sizeof(DEVICE_INDEX_ITEM*) ||
+        (new_buckets = (DEVICE_INDEX_ITEM**)malloc(new_bucket_count * sizeof(DEVICE_INDEX_ITEM*))) == NULL)
+    {
+        LogError("unable to grow the device index beyond %lu buckets", (unsigned long)device_index->bucket_count);
+    }
+    else
+    {
+        DEVICE_INDEX_ITEM* item;
+
+        memset(new_buckets, 0, new_bucket_count * sizeof(DEVICE_INDEX_ITEM*));
+        for (item = device_index->head; item != NULL; item = item->next)
+        {
+            size_t bucket = item->hash & (new_bucket_count - 1);
+            item->next_in_bucket = new_buckets[bucket];
+            new_buckets[bucket] = item;
+        }
+
+        free(device_index->buckets);
+        device_index->buckets = new_buckets;
+        device_index->bucket_count = new_bucket_count;
+    }
+}
+
+DEVICE_INDEX_HANDLE device_index_create(void)
+{
+    DEVICE_INDEX* result;
+
+    if ((result = (DEVICE_INDEX*)malloc(sizeof(DEVICE_INDEX))) == NULL)
+    {
+        /*Codes_SRS_DEVICE_INDEX_10_002: [If any failure occurs, device_index_create shall fail and return NULL]*/
+        LogError("unable to malloc");
+    }
+    /*Codes_SRS_DEVICE_INDEX_10_001: [device_index_create shall allocate an empty index with 16 buckets]*/
+    else if ((result->buckets = (DEVICE_INDEX_ITEM**)malloc(INITIAL_BUCKET_COUNT * sizeof(DEVICE_INDEX_ITEM*))) == NULL)
+    {
+        /*Codes_SRS_DEVICE_INDEX_10_002: [If any failure occurs, device_index_create shall fail and return NULL]*/
+        LogError("unable to malloc");
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        memset(result->buckets, 0, INITIAL_BUCKET_COUNT * sizeof(DEVICE_INDEX_ITEM*));
+        result->bucket_count = INITIAL_BUCKET_COUNT;
+        result->count = 0;
+        result->head = NULL;
+        result->tail = NULL;
+    }
+
+    return result;
+}
+
+void device_index_destroy(DEVICE_INDEX_HANDLE device_index)
+{
+    /*Codes_SRS_DEVICE_INDEX_10_003: [If `device_index` is NULL, device_index_destroy shall return]*/
+    if (device_index != NULL)
+    {
+        /*Codes_SRS_DEVICE_INDEX_10_004: [device_index_destroy shall free all the items and the index, but not the values stored in the items]*/
+        DEVICE_INDEX_ITEM* item = device_index->head;
+        while (item != NULL)
+        {
+            DEVICE_INDEX_ITEM* next = item->next;
+            free(item);
+            item = next;
+        }
+
+        free(device_index->buckets);
+        free(device_index);
+    }
+}
+
+DEVICE_INDEX_ITEM_HANDLE device_index_add(DEVICE_INDEX_HANDLE device_index, const char* device_id, const void* value)
+{
+    DEVICE_INDEX_ITEM* result;
+
+    /*Codes_SRS_DEVICE_INDEX_10_005: [If `device_index` or `device_id` is NULL, device_index_add shall fail and return NULL]*/
+    if (device_index == NULL || device_id == NULL)
+    {
+        LogError("invalid argument DEVICE_INDEX_HANDLE device_index=%p, const char* device_id=%p", device_index, device_id);
+        result = NULL;
+    }
+    else
+    {
+        size_t hash = hash_device_id(device_id);
+        size_t device_id_length = strlen(device_id);
+
+        /*Codes_SRS_DEVICE_INDEX_10_006: [If an item with the same `device_id` is already in the index, device_index_add shall fail and return NULL]*/
+        if (find_item(device_index, device_id, hash) != NULL)
+        {
+            LogError("device '%s' is already in the index", device_id);
+            result = NULL;
+        }
+        /*Codes_SRS_DEVICE_INDEX_10_007: [device_index_add shall allocate an item holding `value` and a copy of `device_id`]*/
+        else if ((result = (DEVICE_INDEX_ITEM*)malloc(sizeof(DEVICE_INDEX_ITEM) + device_id_length + 1)) == NULL)
+        {
+            /*Codes_SRS_DEVICE_INDEX_10_009: [If allocating the item fails, device_index_add shall fail and return NULL]*/
+            LogError("unable to malloc");
+        }
+        else
+        {
+            size_t bucket;
+
+            /*Codes_SRS_DEVICE_INDEX_10_010: [When the index holds more items than buckets, device_index_add shall double the number of buckets]*/
+            if (device_index->count >= device_index->bucket_count)
+            {
+                grow_buckets(device_index);
+            }
+
+            (void)memcpy(result + 1, device_id, device_id_length + 1);
+            result->device_id = (const char*)(result + 1);
+            result->value = value;
+            result->hash = hash;
+
+            /*Codes_SRS_DEVICE_INDEX_10_008: [device_index_add shall link the item in the bucket of the hash of `device_id` and at the end of the index, and return it]*/
+            bucket = hash & (device_index->bucket_count - 1);
+            result->next_in_bucket = device_index->buckets[bucket];
+            device_index->buckets[bucket] = result;
+
+            result->next = NULL;
+            result->previous = device_index->tail;
+            if (device_index->tail == NULL)
+            {
+                device_index->head = result;
+            }
+            else
+            {
+                device_index->tail->next = result;
+            }
+            device_index->tail = result;
+            device_index->count++;
+        }
+    }
+
+    return result;
+}
+
+int device_index_remove(DEVICE_INDEX_HANDLE device_index, DEVICE_INDEX_ITEM_HANDLE item)
+{
+    int result;
+
+    /*Codes_SRS_DEVICE_INDEX_10_011: [If `device_index` or `item` is NULL, device_index_remove shall fail and return a non-zero value]*/
+    if (device_index == NULL || item == NULL)
+    {
+        LogError("invalid argument DEVICE_INDEX_HANDLE device_index=%p, DEVICE_INDEX_ITEM_HANDLE item=%p", device_index, item);
+        result = __FAILURE__;
+    }
+    else
+    {
+        /*Codes_SRS_DEVICE_INDEX_10_012: [device_index_remove shall unlink `item` from its bucket and from the index, free it and return 0]*/
+        DEVICE_INDEX_ITEM** link = &device_index->buckets[item->hash & (device_index->bucket_count - 1)];
+        while (*link != NULL && *link != item)
+        {
+            link = &(*link)->next_in_bucket;
+        }
+
+        if (*link == NULL)
+        {
+            /*Codes_SRS_DEVICE_INDEX_10_013: [If `item` is not in the index, device_index_remove shall fail and return a non-zero value]*/
+            LogError("item is not in the index");
+            result = __FAILURE__;
+        }
+        else
+        {
+            *link = item->next_in_bucket;
+
+            if (item->previous == NULL)
+            {
+                device_index->head = item->next;
+            }
+            else
+            {
+                item->previous->next = item->next;
+            }
+
+            if (item->next == NULL)
+            {
+                device_index->tail = item->previous;
+            }
+            else
+            {
+                item->next->previous = item->previous;
+            }
+
+            device_index->count--;
+            free(item);
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+DEVICE_INDEX_ITEM_HANDLE device_index_find(DEVICE_INDEX_HANDLE device_index, const char* device_id)
+{
+    DEVICE_INDEX_ITEM* result;
+
+    /*Codes_SRS_DEVICE_INDEX_10_014: [If `device_index` or `device_id` is NULL, device_index_find shall return NULL]*/
+    if (device_index == NULL || device_id == NULL)
+    {
+        LogError("invalid argument DEVICE_INDEX_HANDLE device_index=%p, const char* device_id=%p", device_index, device_id);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_DEVICE_INDEX_10_015: [device_index_find shall return the item whose device id is equal to `device_id`, or NULL if there is none]*/
+        result = find_item(device_index, device_id, hash_device_id(device_id));
+    }
+
+    return result;
+}
+
+const void* device_index_item_get_value(DEVICE_INDEX_ITEM_HANDLE item)
+{
+    /*Codes_SRS_DEVICE_INDEX_10_016: [device_index_item_get_value shall return the value stored in `item`, or NULL if `item` is NULL]*/
+    return (item == NULL) ? NULL : item->value;
+}
+
+DEVICE_INDEX_ITEM_HANDLE device_index_get_head_item(DEVICE_INDEX_HANDLE device_index)
+{
+    /*Codes_SRS_DEVICE_INDEX_10_017: [device_index_get_head_item shall return the item that was added first, or NULL if `device_index` is NULL or empty]*/
+    return (device_index == NULL) ? NULL : device_index->head;
+}
+
+DEVICE_INDEX_ITEM_HANDLE device_index_get_next_item(DEVICE_INDEX_ITEM_HANDLE item)
+{
+    /*Codes_SRS_DEVICE_INDEX_10_018: [device_index_get_next_item shall return the item that was added after `item`, or NULL if `item` is NULL or the last item]*/
+    return (item == NULL) ? NULL : item->next;
+}
+
+size_t device_index_get_count(DEVICE_INDEX_HANDLE device_index)
+{
+    /*Codes_SRS_DEVICE_INDEX_10_019: [device_index_get_count shall return the number of items in the index, or 0 if `device_index` is NULL]*/
+    return (device_index == NULL) ? 0 : device_index->count;
+}
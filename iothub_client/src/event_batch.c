@@ -0,0 +1,416 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/map.h"
+
+#include "event_batch.h"
+
+#define MAXIMUM_PAYLOAD_OVERHEAD 384
+#define MAXIMUM_PROPERTY_OVERHEAD 16
+
+#define IOTHUB_APP_PREFIX "iothub-app-"
+
+#define BYTEARRAY_BODY_BEGIN "{\"body\":\""
+#define BYTEARRAY_BODY_END "\""
+#define STRING_BODY_BEGIN "{\"body\":"
+#define STRING_BODY_END ",\"base64Encoded\":false"
+#define PROPERTIES_BEGIN ",\"properties\":{"
+#define PROPERTY_NAME_BEGIN "\"" IOTHUB_APP_PREFIX
+#define PROPERTY_NAME_END "\":\""
+#define PROPERTY_VALUE_END "\""
+#define PROPERTIES_END "}"
+#define ITEM_END "}"
+
+#define LITERAL_LENGTH(literal) (sizeof(literal) - 1)
+
+static const char base64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char hexDigits[] = "0123456789ABCDEF";
+
+/*what is needed to write the item of a message, as read from the message*/
+typedef struct EVENT_BATCH_ITEM_TAG
+{
+    IOTHUBMESSAGE_CONTENT_TYPE contentType;
+    const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT* segments;
+    size_t segmentCount;
+    const char* string;
+    const char*const* keys;
+    const char*const* values;
+    size_t propertyCount;
+    size_t itemSize;
+    size_t messageSize;
+} EVENT_BATCH_ITEM;
+
+/*the size of the JSON encoding of source, quotes included, as STRING_new_JSON produces it*/
+static int get_json_string_size(const char* source, size_t* jsonSize, size_t* length)
+{
+    int result;
+    size_t size = 2;
+    const char* current;
+
+    for (current = source; *current != '\0'; current++)
+    {
+        unsigned char c = (unsigned char)*current;
+        if (c >= 128)
+        {
+            break;
+        }
+        else if (c < 0x20)
+        {
+            size += LITERAL_LENGTH("\\u00XX");
+        }
+        else if ((c == '"') || (c == '\\') || (c == '/'))
+        {
+            size += 2;
+        }
+        else
+        {
+            size++;
+        }
+    }
+
+    if (*current != '\0')
+    {
+        /*Codes_SRS_EVENT_BATCH_10_004: [ If the string of a message has a character outside [1..127], event_batch_get_item_size and event_batch_write_item shall fail and return a non-zero value. ]*/
+        LogError("invalid character in the string of the message");
+        result = __FAILURE__;
+    }
+    else
+    {
+        *jsonSize = size;
+        *length = (size_t)(current - source);
+        result = 0;
+    }
+    return result;
+}
+
+static int read_item(IOTHUB_MESSAGE_HANDLE messageHandle, EVENT_BATCH_ITEM* item)
+{
+    int result;
+    size_t contentSize;
+    size_t bodySize;
+
+    item->contentType = IoTHubMessage_GetContentType(messageHandle);
+    if (item->contentType == IOTHUBMESSAGE_BYTEARRAY)
+    {
+        if (IoTHubMessage_GetByteArraySegments(messageHandle, &item->segments, &item->segmentCount) != IOTHUB_MESSAGE_OK)
+        {
+            /*Codes_SRS_EVENT_BATCH_10_007: [ If the content type of the message is unknown, or its content or properties cannot be obtained, event_batch_get_item_size and event_batch_write_item shall fail and return a non-zero value. ]*/
+            LogError("unable to get the data for the message.");
+            result = __FAILURE__;
+        }
+        else
+        {
+            size_t index;
+            contentSize = 0;
+            for (index = 0; index < item->segmentCount; index++)
+            {
+                contentSize += item->segments[index].size;
+            }
+            /*Codes_SRS_EVENT_BATCH_10_002: [ The item of a message of type IOTHUBMESSAGE_BYTEARRAY shall be {"body":"base64 encoding of the content"}, with a base64 encoding 4 characters long for every 3 bytes of content, or fraction thereof. ]*/
+            bodySize = LITERAL_LENGTH(BYTEARRAY_BODY_BEGIN) + ((contentSize + 2) / 3) * 4 + LITERAL_LENGTH(BYTEARRAY_BODY_END);
+            result = 0;
+        }
+    }
+    else if (item->contentType == IOTHUBMESSAGE_STRING)
+    {
+        size_t jsonSize;
+        if ((item->string = IoTHubMessage_GetString(messageHandle)) == NULL)
+        {
+            /*Codes_SRS_EVENT_BATCH_10_007: [ If the content type of the message is unknown, or its content or properties cannot be obtained, event_batch_get_item_size and event_batch_write_item shall fail and return a non-zero value. ]*/
+            LogError("unable to IoTHubMessage_GetString");
+            result = __FAILURE__;
+        }
+        else if (get_json_string_size(item->string, &jsonSize, &contentSize) != 0)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            /*Codes_SRS_EVENT_BATCH_10_003: [ The item of a message of type IOTHUBMESSAGE_STRING shall be {"body":"JSON encoding of the string","base64Encoded":false}, where '"', '\' and '/' are escaped with a '\' and the characters below 0x20 are written \u00xx. ]*/
+            bodySize = LITERAL_LENGTH(STRING_BODY_BEGIN) + jsonSize + LITERAL_LENGTH(STRING_BODY_END);
+            result = 0;
+        }
+    }
+    else
+    {
+        /*Codes_SRS_EVENT_BATCH_10_007: [ If the content type of the message is unknown, or its content or properties cannot be obtained, event_batch_get_item_size and event_batch_write_item shall fail and return a non-zero value. ]*/
+        LogError("an unknown message type was encountered (%d)", item->contentType);
+        result = __FAILURE__;
+    }
+
+    if (result == 0)
+    {
+        if (Map_GetInternals(IoTHubMessage_GetReadOnlyProperties(messageHandle), &item->keys, &item->values, &item->propertyCount) != MAP_OK)
+        {
+            /*Codes_SRS_EVENT_BATCH_10_007: [ If the content type of the message is unknown, or its content or properties cannot be obtained, event_batch_get_item_size and event_batch_write_item shall fail and return a non-zero value. ]*/
+            LogError("error while Map_GetInternals");
+            result = __FAILURE__;
+        }
+        else
+        {
+            size_t i;
+
+            /*Codes_SRS_EVENT_BATCH_10_006: [ The message size shall be the size of the content + 384, plus the length of the name + the length of the value + 16 for every property. ]*/
+            item->itemSize = bodySize + LITERAL_LENGTH(ITEM_END);
+            item->messageSize = contentSize + MAXIMUM_PAYLOAD_OVERHEAD;
+
+            /*Codes_SRS_EVENT_BATCH_10_005: [ If the message has properties, they shall be serialized after the body as ,"properties":{"iothub-app-name1":"value1","iothub-app-name2":"value2"}, otherwise "properties" shall be missing from the item. ]*/
+            if (item->propertyCount > 0)
+            {
+                item->itemSize += LITERAL_LENGTH(PROPERTIES_BEGIN) + (item->propertyCount - 1) + LITERAL_LENGTH(PROPERTIES_END);
+            }
+            for (i = 0; i < item->propertyCount; i++)
+            {
+                size_t nameAndValueSize = strlen(item->keys[i]) + strlen(item->values[i]);
+                item->itemSize += LITERAL_LENGTH(PROPERTY_NAME_BEGIN) + LITERAL_LENGTH(PROPERTY_NAME_END) + LITERAL_LENGTH(PROPERTY_VALUE_END) + nameAndValueSize;
+                item->messageSize += nameAndValueSize + MAXIMUM_PROPERTY_OVERHEAD;
+            }
+        }
+    }
+
+    return result;
+}
+
+static unsigned char* write_literal(unsigned char* destination, const char* literal, size_t length)
+{
+    (void)memcpy(destination, literal, length);
+    return destination + length;
+}
+
+/*encodes whole groups of 3 bytes, 4 groups (12 bytes into 16 characters) per iteration*/
+static unsigned char* write_base64_groups(unsigned char* destination, const unsigned char* source, size_t groupCount)
+{
+    while (groupCount >= 4)
+    {
+        uint32_t group0 = ((uint32_t)source[0] << 16) | ((uint32_t)source[1] << 8) | source[2];
+        uint32_t group1 = ((uint32_t)source[3] << 16) | ((uint32_t)source[4] << 8) | source[5];
+        uint32_t group2 = ((uint32_t)source[6] << 16) | ((uint32_t)source[7] << 8) | source[8];
+        uint32_t group3 = ((uint32_t)source[9] << 16) | ((uint32_t)source[10] << 8) | source[11];
+
+        destination[0] = (unsigned char)base64Alphabet[group0 >> 18];
+        destination[1] = (unsigned char)base64Alphabet[(group0 >> 12) & 0x3F];
+        destination[2] = (unsigned char)base64Alphabet[(group0 >> 6) & 0x3F];
+        destination[3] = (unsigned char)base64Alphabet[group0 & 0x3F];
+        destination[4] = (unsigned char)base64Alphabet[group1 >> 18];
+        destination[5] = (unsigned char)base64Alphabet[(group1 >> 12) & 0x3F];
+        destination[6] = (unsigned char)base64Alphabet[(group1 >> 6) & 0x3F];
+        destination[7] = (unsigned char)base64Alphabet[group1 & 0x3F];
+        destination[8] = (unsigned char)base64Alphabet[group2 >> 18];
+        destination[9] = (unsigned char)base64Alphabet[(group2 >> 12) & 0x3F];
+        destination[10] = (unsigned char)base64Alphabet[(group2 >> 6) & 0x3F];
+        destination[11] = (unsigned char)base64Alphabet[group2 & 0x3F];
+        destination[12] = (unsigned char)base64Alphabet[group3 >> 18];
+        destination[13] = (unsigned char)base64Alphabet[(group3 >> 12) & 0x3F];
+        destination[14] = (unsigned char)base64Alphabet[(group3 >> 6) & 0x3F];
+        destination[15] = (unsigned char)base64Alphabet[group3 & 0x3F];
+
+        source += 12;
+        destination += 16;
+        groupCount -= 4;
+    }
+
+    while (groupCount > 0)
+    {
+        uint32_t group = ((uint32_t)source[0] << 16) | ((uint32_t)source[1] << 8) | source[2];
+        destination[0] = (unsigned char)base64Alphabet[group >> 18];
+        destination[1] = (unsigned char)base64Alphabet[(group >> 12) & 0x3F];
+        destination[2] = (unsigned char)base64Alphabet[(group >> 6) & 0x3F];
+        destination[3] = (unsigned char)base64Alphabet[group & 0x3F];
+        source += 3;
+        destination += 4;
+        groupCount--;
+    }
+
+    return destination;
+}
+
+/*encodes the last 1 or 2 bytes, padded with '='*/
+static unsigned char* write_base64_tail(unsigned char* destination, const unsigned char* source, size_t size)
+{
+    if (size == 1)
+    {
+        destination[0] = (unsigned char)base64Alphabet[source[0] >> 2];
+        destination[1] = (unsigned char)base64Alphabet[(source[0] & 0x03) << 4];
+        destination[2] = '=';
+        destination[3] = '=';
+        destination += 4;
+    }
+    else if (size == 2)
+    {
+        destination[0] = (unsigned char)base64Alphabet[source[0] >> 2];
+        destination[1] = (unsigned char)base64Alphabet[((source[0] & 0x03) << 4) | (source[1] >> 4)];
+        destination[2] = (unsigned char)base64Alphabet[(source[1] & 0x0F) << 2];
+        destination[3] = '=';
+        destination += 4;
+    }
+    return destination;
+}
+
+/*Codes_SRS_EVENT_BATCH_10_010: [ The segments of a message of type IOTHUBMESSAGE_BYTEARRAY shall be base64 encoded one after the other as if they were one byte array, without being gathered first. ]*/
+static unsigned char* write_base64_segments(unsigned char* destination, const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT* segments, size_t segmentCount)
+{
+    unsigned char carry[3];
+    size_t carrySize = 0;
+    size_t index;
+
+    for (index = 0; index < segmentCount; index++)
+    {
+        const unsigned char* source = segments[index].buffer;
+        size_t size = segments[index].size;
+
+        /*the bytes that did not fill a group at the end of the previous segment are completed with the first bytes of this one*/
+        while ((carrySize > 0) && (carrySize < sizeof(carry)) && (size > 0))
+        {
+            carry[carrySize++] = *source++;
+            size--;
+        }
+        if (carrySize == sizeof(carry))
+        {
+            destination = write_base64_groups(destination, carry, 1);
+            carrySize = 0;
+        }
+
+        destination = write_base64_groups(destination, source, size / 3);
+        source += size - (size % 3);
+        for (size %= 3; size > 0; size--)
+        {
+            carry[carrySize++] = *source++;
+        }
+    }
+
+    return write_base64_tail(destination, carry, carrySize);
+}
+
+static unsigned char* write_json_string(unsigned char* destination, const char* source)
+{
+    *destination++ = '"';
+    for (; *source != '\0'; source++)
+    {
+        unsigned char c = (unsigned char)*source;
+        if (c < 0x20)
+        {
+            destination[0] = '\\';
+            destination[1] = 'u';
+            destination[2] = '0';
+            destination[3] = '0';
+            destination[4] = (unsigned char)hexDigits[c >> 4];
+            destination[5] = (unsigned char)hexDigits[c & 0x0F];
+            destination += 6;
+        }
+        else if ((c == '"') || (c == '\\') || (c == '/'))
+        {
+            destination[0] = '\\';
+            destination[1] = c;
+            destination += 2;
+        }
+        else
+        {
+            *destination++ = c;
+        }
+    }
+    *destination++ = '"';
+    return destination;
+}
+
+int event_batch_get_item_size(IOTHUB_MESSAGE_HANDLE messageHandle, size_t* itemSize, size_t* messageSize)
+{
+    int result;
+
+    /*Codes_SRS_EVENT_BATCH_10_001: [ If messageHandle, itemSize or messageSize is NULL, event_batch_get_item_size shall fail and return a non-zero value. ]*/
+    if (messageHandle == NULL || itemSize == NULL || messageSize == NULL)
+    {
+        LogError("invalid argument IOTHUB_MESSAGE_HANDLE messageHandle=%p, size_t* itemSize=%p, size_t* messageSize=%p", messageHandle, itemSize, messageSize);
+        result = __FAILURE__;
+    }
+    else
+    {
+        EVENT_BATCH_ITEM item;
+        if (read_item(messageHandle, &item) != 0)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            *itemSize = item.itemSize;
+            *messageSize = item.messageSize;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+int event_batch_write_item(IOTHUB_MESSAGE_HANDLE messageHandle, unsigned char* destination, size_t destinationSize, size_t* itemSize)
+{
+    int result;
+
+    /*Codes_SRS_EVENT_BATCH_10_008: [ If messageHandle, destination or itemSize is NULL, event_batch_write_item shall fail and return a non-zero value. ]*/
+    if (messageHandle == NULL || destination == NULL || itemSize == NULL)
+    {
+        LogError("invalid argument IOTHUB_MESSAGE_HANDLE messageHandle=%p, unsigned char* destination=%p, size_t* itemSize=%p", messageHandle, destination, itemSize);
+        result = __FAILURE__;
+    }
+    else
+    {
+        EVENT_BATCH_ITEM item;
+        if (read_item(messageHandle, &item) != 0)
+        {
+            /*Codes_SRS_EVENT_BATCH_10_007: [ If the content type of the message is unknown, or its content or properties cannot be obtained, event_batch_get_item_size and event_batch_write_item shall fail and return a non-zero value. ]*/
+            result = __FAILURE__;
+        }
+        else if (item.itemSize > destinationSize)
+        {
+            /*Codes_SRS_EVENT_BATCH_10_011: [ If the item of the message is longer than destinationSize, event_batch_write_item shall fail and return a non-zero value without writing anything. ]*/
+            LogError("the item of the message is %lu bytes long, only %lu bytes are available", (unsigned long)item.itemSize, (unsigned long)destinationSize);
+            result = __FAILURE__;
+        }
+        else
+        {
+            /*Codes_SRS_EVENT_BATCH_10_009: [ event_batch_write_item shall write the item of the message at destination, set itemSize to its size and return 0. ]*/
+            size_t i;
+            if (item.contentType == IOTHUBMESSAGE_BYTEARRAY)
+            {
+                destination = write_literal(destination, BYTEARRAY_BODY_BEGIN, LITERAL_LENGTH(BYTEARRAY_BODY_BEGIN));
+                destination = write_base64_segments(destination, item.segments, item.segmentCount);
+                destination = write_literal(destination, BYTEARRAY_BODY_END, LITERAL_LENGTH(BYTEARRAY_BODY_END));
+            }
+            else
+            {
+                destination = write_literal(destination, STRING_BODY_BEGIN, LITERAL_LENGTH(STRING_BODY_BEGIN));
+                destination = write_json_string(destination, item.string);
+                destination = write_literal(destination, STRING_BODY_END, LITERAL_LENGTH(STRING_BODY_END));
+            }
+
+            if (item.propertyCount > 0)
+            {
+                destination = write_literal(destination, PROPERTIES_BEGIN, LITERAL_LENGTH(PROPERTIES_BEGIN));
+                for (i = 0; i < item.propertyCount; i++)
+                {
+                    if (i > 0)
+                    {
+                        *destination++ = ',';
+                    }
+                    destination = write_literal(destination, PROPERTY_NAME_BEGIN, LITERAL_LENGTH(PROPERTY_NAME_BEGIN));
+                    destination = write_literal(destination, item.keys[i], strlen(item.keys[i]));
+                    destination = write_literal(destination, PROPERTY_NAME_END, LITERAL_LENGTH(PROPERTY_NAME_END));
+                    destination = write_literal(destination, item.values[i], strlen(item.values[i]));
+                    destination = write_literal(destination, PROPERTY_VALUE_END, LITERAL_LENGTH(PROPERTY_VALUE_END));
+                }
+                destination = write_literal(destination, PROPERTIES_END, LITERAL_LENGTH(PROPERTIES_END));
+            }
+
+            (void)write_literal(destination, ITEM_END, LITERAL_LENGTH(ITEM_END));
+            *itemSize = item.itemSize;
+            result = 0;
+        }
+    }
+
+    return result;
+}
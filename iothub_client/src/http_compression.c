@@ -0,0 +1,166 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <limits.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/buffer_.h"
+
+#include "http_compression.h"
+
+#ifdef USE_HTTP_COMPRESSION
+
+#include "zlib.h"
+
+/*15 bits of window + 16 makes deflate write a gzip header and trailer; with memLevel 8 the state of deflate
+  is about 256KB whatever the size of the bodies, the compressed body is written straight into the destination*/
+#define GZIP_WINDOW_BITS (15 + 16)
+#define DEFLATE_MEMORY_LEVEL 8
+
+typedef struct HTTP_COMPRESSION_TAG
+{
+    z_stream stream;
+} HTTP_COMPRESSION;
+
+HTTP_COMPRESSION_HANDLE http_compression_create(int level)
+{
+    HTTP_COMPRESSION* result;
+
+    /*Codes_SRS_HTTP_COMPRESSION_10_001: [ If level is not between 1 and 9, http_compression_create shall fail and return NULL. ]*/
+    if (level < 1 || level > 9)
+    {
+        LogError("invalid argument int level=%d", level);
+        result = NULL;
+    }
+    else if ((result = (HTTP_COMPRESSION*)malloc(sizeof(HTTP_COMPRESSION))) == NULL)
+    {
+        /*Codes_SRS_HTTP_COMPRESSION_10_003: [ If any failure occurs, http_compression_create shall fail and return NULL. ]*/
+        LogError("unable to malloc");
+    }
+    else
+    {
+        result->stream.zalloc = Z_NULL;
+        result->stream.zfree = Z_NULL;
+        result->stream.opaque = Z_NULL;
+
+        /*Codes_SRS_HTTP_COMPRESSION_10_002: [ http_compression_create shall initialize a gzip deflate stream with the given level. ]*/
+        if (deflateInit2(&result->stream, level, Z_DEFLATED, GZIP_WINDOW_BITS, DEFLATE_MEMORY_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            /*Codes_SRS_HTTP_COMPRESSION_10_003: [ If any failure occurs, http_compression_create shall fail and return NULL. ]*/
+            LogError("unable to deflateInit2");
+            free(result);
+            result = NULL;
+        }
+    }
+
+    return result;
+}
+
+void http_compression_destroy(HTTP_COMPRESSION_HANDLE compression)
+{
+    /*Codes_SRS_HTTP_COMPRESSION_10_004: [ If compression is NULL, http_compression_destroy shall return. ]*/
+    if (compression != NULL)
+    {
+        /*Codes_SRS_HTTP_COMPRESSION_10_005: [ http_compression_destroy shall end the deflate stream and free the compressor. ]*/
+        (void)deflateEnd(&compression->stream);
+        free(compression);
+    }
+}
+
+int http_compression_compress(HTTP_COMPRESSION_HANDLE compression, BUFFER_HANDLE source, BUFFER_HANDLE destination)
+{
+    int result;
+
+    /*Codes_SRS_HTTP_COMPRESSION_10_006: [ If compression, source or destination is NULL, http_compression_compress shall fail and return a non-zero value. ]*/
+    if (compression == NULL || source == NULL || destination == NULL)
+    {
+        LogError("invalid argument HTTP_COMPRESSION_HANDLE compression=%p, BUFFER_HANDLE source=%p, BUFFER_HANDLE destination=%p", compression, source, destination);
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t sourceSize = BUFFER_length(source);
+        size_t destinationSize = BUFFER_length(destination);
+        /*a compressed body is only worth sending when it is smaller than the body, so the output never needs more room than that*/
+        size_t outputSize = (sourceSize == 0) ? 0 : sourceSize - 1;
+
+        if (sourceSize > UINT_MAX)
+        {
+            LogError("the body is too large to be compressed (%lu bytes)", (unsigned long)sourceSize);
+            result = __FAILURE__;
+        }
+        else if (outputSize == 0)
+        {
+            /*Codes_SRS_HTTP_COMPRESSION_10_009: [ If the compressed body does not fit in source - 1 bytes, http_compression_compress shall fail and return a non-zero value. ]*/
+            result = __FAILURE__;
+        }
+        /*Codes_SRS_HTTP_COMPRESSION_10_007: [ Unless destination already holds source - 1 bytes, http_compression_compress shall size it to source - 1 bytes with BUFFER_unbuild and BUFFER_pre_build. ]*/
+        else if ((destinationSize != outputSize) &&
+            (((destinationSize != 0) && (BUFFER_unbuild(destination) != 0)) || (BUFFER_pre_build(destination, outputSize) != 0)))
+        {
+            /*Codes_SRS_HTTP_COMPRESSION_10_010: [ If any failure occurs, http_compression_compress shall fail and return a non-zero value. ]*/
+            LogError("unable to size the destination to %lu bytes", (unsigned long)outputSize);
+            result = __FAILURE__;
+        }
+        else
+        {
+            int deflateResult;
+
+            /*Codes_SRS_HTTP_COMPRESSION_10_008: [ http_compression_compress shall reset the deflate stream and deflate source straight into destination with Z_FINISH. ]*/
+            (void)deflateReset(&compression->stream);
+            compression->stream.next_in = BUFFER_u_char(source);
+            compression->stream.avail_in = (uInt)sourceSize;
+            compression->stream.next_out = BUFFER_u_char(destination);
+            compression->stream.avail_out = (uInt)outputSize;
+            deflateResult = deflate(&compression->stream, Z_FINISH);
+
+            if (deflateResult != Z_STREAM_END)
+            {
+                /*Codes_SRS_HTTP_COMPRESSION_10_009: [ If the compressed body does not fit in source - 1 bytes, http_compression_compress shall fail and return a non-zero value. ]*/
+                result = __FAILURE__;
+            }
+            /*Codes_SRS_HTTP_COMPRESSION_10_011: [ http_compression_compress shall shrink destination to the length of the compressed body with BUFFER_shrink and return 0. ]*/
+            else if ((compression->stream.avail_out != 0) && (BUFFER_shrink(destination, compression->stream.avail_out, true) != 0))
+            {
+                /*Codes_SRS_HTTP_COMPRESSION_10_010: [ If any failure occurs, http_compression_compress shall fail and return a non-zero value. ]*/
+                LogError("unable to BUFFER_shrink");
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = 0;
+            }
+        }
+    }
+
+    return result;
+}
+
+#else /*USE_HTTP_COMPRESSION*/
+
+HTTP_COMPRESSION_HANDLE http_compression_create(int level)
+{
+    /*Codes_SRS_HTTP_COMPRESSION_10_012: [ If the SDK was built without use_http_compression, http_compression_create shall fail and return NULL. ]*/
+    LogError("cannot compress with level %d, the SDK was built without use_http_compression", level);
+    return NULL;
+}
+
+void http_compression_destroy(HTTP_COMPRESSION_HANDLE compression)
+{
+    (void)compression;
+}
+
+int http_compression_compress(HTTP_COMPRESSION_HANDLE compression, BUFFER_HANDLE source, BUFFER_HANDLE destination)
+{
+    (void)compression;
+    (void)source;
+    (void)destination;
+    LogError("the SDK was built without use_http_compression");
+    return __FAILURE__;
+}
+
+#endif /*USE_HTTP_COMPRESSION*/
@@ -0,0 +1,231 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "ingress_queue.h"
+
+/*bounded ring of cells, each with a sequence number telling whose turn it is to use the cell:
+  sequence == position       the cell is free for the producer that claims position
+  sequence == position + 1   the cell holds the item pushed at position, ready for the consumer
+  producers claim a position with a compare and swap on enqueue_position, the consumer owns dequeue_position*/
+#if defined(_WIN32)
+#include <windows.h>
+#define INGRESS_QUEUE_HAS_ATOMICS 1
+#define ATOMIC_LOAD_ACQUIRE(x) ((size_t)InterlockedCompareExchangePointer((PVOID volatile*)&(x), NULL, NULL))
+#define ATOMIC_STORE_RELEASE(x, value) ((void)InterlockedExchangePointer((PVOID volatile*)&(x), (PVOID)(value)))
+#define ATOMIC_COMPARE_EXCHANGE(x, expected, desired) (InterlockedCompareExchangePointer((PVOID volatile*)&(x), (PVOID)(desired), (PVOID)(expected)) == (PVOID)(expected))
+#elif defined(__GNUC__) && defined(__ATOMIC_ACQUIRE)
+#define INGRESS_QUEUE_HAS_ATOMICS 1
+#define ATOMIC_LOAD_ACQUIRE(x) __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define ATOMIC_STORE_RELEASE(x, value) __atomic_store_n(&(x), (value), __ATOMIC_RELEASE)
+#define ATOMIC_COMPARE_EXCHANGE(x, expected, desired) __atomic_compare_exchange_n(&(x), &(expected), (desired), false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)
+#else
+#define INGRESS_QUEUE_HAS_ATOMICS 0
+#endif
+
+#define MIN_CAPACITY 2
+#define MAX_CAPACITY ((size_t)1 << (sizeof(size_t) * 8 - 2))
+#define CACHE_LINE_SIZE 64
+
+typedef struct INGRESS_QUEUE_CELL_TAG
+{
+    volatile size_t sequence;
+    void* item;
+} INGRESS_QUEUE_CELL;
+
+typedef struct INGRESS_QUEUE_TAG
+{
+    INGRESS_QUEUE_CELL* cells;
+    size_t mask;
+    /*producers and the consumer update these from different threads, keep them apart*/
+    char pad0[CACHE_LINE_SIZE];
+    volatile size_t enqueue_position;
+    char pad1[CACHE_LINE_SIZE];
+    volatile size_t dequeue_position;
+    char pad2[CACHE_LINE_SIZE];
+} INGRESS_QUEUE;
+
+INGRESS_QUEUE_HANDLE ingress_queue_create(size_t capacity)
+{
+    INGRESS_QUEUE* result;
+
+#if !INGRESS_QUEUE_HAS_ATOMICS
+    (void)capacity;
+    /*Codes_SRS_INGRESS_QUEUE_10_002: [If the platform provides no atomic operations, ingress_queue_create shall fail and return NULL]*/
+    LogError("ingress_queue is not supported on this platform");
+    result = NULL;
+#else
+    /*Codes_SRS_INGRESS_QUEUE_10_001: [If `capacity` is 0 or larger than half of the largest size_t, ingress_queue_create shall fail and return NULL]*/
+    if (capacity == 0 || capacity > MAX_CAPACITY)
+    {
+        LogError("invalid capacity %lu", (unsigned long)capacity);
+        result = NULL;
+    }
+    else if ((result = (INGRESS_QUEUE*)malloc(sizeof(INGRESS_QUEUE))) == NULL)
+    {
+        /*Codes_SRS_INGRESS_QUEUE_10_004: [If any failure occurs, ingress_queue_create shall fail and return NULL]*/
+        LogError("unable to malloc");
+    }
+    else
+    {
+        /*Codes_SRS_INGRESS_QUEUE_10_003: [ingress_queue_create shall allocate a ring of `capacity` cells, rounded up to a power of two and to at least 2, each free for the position equal to its index]*/
+        size_t cell_count = MIN_CAPACITY;
+        while (cell_count < capacity)
+        {
+            cell_count <<= 1;
+        }
+
+        if ((result->cells = (INGRESS_QUEUE_CELL*)malloc(cell_count * sizeof(INGRESS_QUEUE_CELL))) == NULL)
+        {
+            /*Codes_SRS_INGRESS_QUEUE_10_004: [If any failure occurs, ingress_queue_create shall fail and return NULL]*/
+            LogError("unable to malloc cells");
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            size_t i;
+            for (i = 0; i < cell_count; i++)
+            {
+                result->cells[i].sequence = i;
+                result->cells[i].item = NULL;
+            }
+            result->mask = cell_count - 1;
+            result->enqueue_position = 0;
+            result->dequeue_position = 0;
+        }
+    }
+#endif
+
+    return result;
+}
+
+void ingress_queue_destroy(INGRESS_QUEUE_HANDLE ingress_queue)
+{
+    /*Codes_SRS_INGRESS_QUEUE_10_005: [If `ingress_queue` is NULL, ingress_queue_destroy shall return]*/
+    if (ingress_queue != NULL)
+    {
+        /*Codes_SRS_INGRESS_QUEUE_10_006: [ingress_queue_destroy shall release the ring and the queue, and not the items still in it]*/
+        free(ingress_queue->cells);
+        free(ingress_queue);
+    }
+}
+
+int ingress_queue_push(INGRESS_QUEUE_HANDLE ingress_queue, void* item)
+{
+    int result;
+
+    /*Codes_SRS_INGRESS_QUEUE_10_007: [If `ingress_queue` or `item` are NULL, ingress_queue_push shall fail and return non-zero]*/
+    if (ingress_queue == NULL || item == NULL)
+    {
+        LogError("invalid argument ingress_queue=%p item=%p", ingress_queue, item);
+        result = __FAILURE__;
+    }
+    else
+    {
+#if !INGRESS_QUEUE_HAS_ATOMICS
+        result = __FAILURE__;
+#else
+        size_t position = ATOMIC_LOAD_ACQUIRE(ingress_queue->enqueue_position);
+        result = __FAILURE__;
+
+        for (;;)
+        {
+            INGRESS_QUEUE_CELL* cell = &ingress_queue->cells[position & ingress_queue->mask];
+            size_t sequence = ATOMIC_LOAD_ACQUIRE(cell->sequence);
+            ptrdiff_t difference = (ptrdiff_t)(sequence - position);
+
+            if (difference == 0)
+            {
+                /*Codes_SRS_INGRESS_QUEUE_10_008: [ingress_queue_push shall claim the next position with a compare and swap, without taking a lock, retrying when another producer claimed it first]*/
+                if (ATOMIC_COMPARE_EXCHANGE(ingress_queue->enqueue_position, position, position + 1))
+                {
+                    /*Codes_SRS_INGRESS_QUEUE_10_009: [ingress_queue_push shall store `item` in the cell of the claimed position and then publish it to the consumer, and return 0]*/
+                    cell->item = item;
+                    ATOMIC_STORE_RELEASE(cell->sequence, position + 1);
+                    result = 0;
+                    break;
+                }
+                position = ATOMIC_LOAD_ACQUIRE(ingress_queue->enqueue_position);
+            }
+            else if (difference < 0)
+            {
+                /*Codes_SRS_INGRESS_QUEUE_10_010: [If the cell of the next position still holds an item that was not popped, ingress_queue_push shall fail and return non-zero]*/
+                break;
+            }
+            else
+            {
+                position = ATOMIC_LOAD_ACQUIRE(ingress_queue->enqueue_position);
+            }
+        }
+#endif
+    }
+
+    return result;
+}
+
+void* ingress_queue_pop(INGRESS_QUEUE_HANDLE ingress_queue)
+{
+    void* result;
+
+    /*Codes_SRS_INGRESS_QUEUE_10_011: [If `ingress_queue` is NULL, ingress_queue_pop shall return NULL]*/
+    if (ingress_queue == NULL)
+    {
+        LogError("invalid argument ingress_queue=NULL");
+        result = NULL;
+    }
+    else
+    {
+#if !INGRESS_QUEUE_HAS_ATOMICS
+        result = NULL;
+#else
+        size_t position = ingress_queue->dequeue_position;
+        INGRESS_QUEUE_CELL* cell = &ingress_queue->cells[position & ingress_queue->mask];
+
+        if (ATOMIC_LOAD_ACQUIRE(cell->sequence) != position + 1)
+        {
+            /*Codes_SRS_INGRESS_QUEUE_10_012: [If the item at the head of the queue was not published yet, ingress_queue_pop shall return NULL]*/
+            result = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_INGRESS_QUEUE_10_013: [ingress_queue_pop shall take the item at the head of the queue, free its cell for the position one lap ahead and return the item]*/
+            result = cell->item;
+            cell->item = NULL;
+            ingress_queue->dequeue_position = position + 1;
+            ATOMIC_STORE_RELEASE(cell->sequence, position + ingress_queue->mask + 1);
+        }
+#endif
+    }
+
+    return result;
+}
+
+bool ingress_queue_is_empty(INGRESS_QUEUE_HANDLE ingress_queue)
+{
+    bool result;
+
+    /*Codes_SRS_INGRESS_QUEUE_10_014: [If `ingress_queue` is NULL, ingress_queue_is_empty shall return true]*/
+    if (ingress_queue == NULL)
+    {
+        result = true;
+    }
+    else
+    {
+#if !INGRESS_QUEUE_HAS_ATOMICS
+        result = true;
+#else
+        /*Codes_SRS_INGRESS_QUEUE_10_015: [ingress_queue_is_empty shall return false if the item at the head of the queue was published, true otherwise]*/
+        size_t position = ingress_queue->dequeue_position;
+        result = (ATOMIC_LOAD_ACQUIRE(ingress_queue->cells[position & ingress_queue->mask].sequence) != position + 1);
+#endif
+    }
+
+    return result;
+}
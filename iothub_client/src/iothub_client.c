@@ -7,14 +7,20 @@
 
 #include <signal.h>
 #include <stddef.h>
+#include <string.h>
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "iothub_client.h"
 #include "iothub_client_ll.h"
 #include "iothub_client_private.h"
+#include "iothub_client_options.h"
 #include "iothubtransport.h"
+#include "iothub_client_reactor.h"
+#include "iothub_client_callback_executor.h"
+#include "ingress_queue.h"
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
 #include "azure_c_shared_utility/vector.h"
@@ -24,12 +30,26 @@
 
 struct IOTHUB_QUEUE_CONTEXT_TAG;
 
+/*0 leaves OPTION_DO_WORK_FREQUENCY_IN_MS unset, the worker thread then only waits for IoTHubClient_LL_GetNextWorkDeadline*/
+#define DEFAULT_DO_WORK_FREQUENCY_IN_MS 0
+/*how soon the work is retried when the lock or the next work deadline cannot be had*/
+#define RETRY_DO_WORK_FREQUENCY_IN_MS 100
+/*Condition_Wait takes an int, an idle worker thread wakes up at least this often*/
+#define MAX_WAIT_FOR_WORK_IN_MS 60000
+
 typedef struct IOTHUB_CLIENT_INSTANCE_TAG
 {
     IOTHUB_CLIENT_LL_HANDLE IoTHubClientLLHandle;
     TRANSPORT_HANDLE TransportHandle;
     THREAD_HANDLE ThreadHandle;
+    IOTHUB_CLIENT_REACTOR_HANDLE ReactorHandle; /*when set, the client is driven by the reactor instead of its own worker thread*/
+    IOTHUB_CLIENT_REACTOR_CLIENT_HANDLE ReactorClientHandle;
+    IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT_HANDLE CallbackExecutorClientHandle; /*when set, the user callbacks run on the executor instead of the thread calling IoTHubClient_LL_DoWork*/
     LOCK_HANDLE LockHandle;
+    COND_HANDLE WorkCondition; /*signaled (under LockHandle) when new work is queued for the worker thread, NULL for shared transports*/
+    int WorkPending;
+    unsigned int DoWorkFrequencyInMs;
+    INGRESS_QUEUE_HANDLE IngressQueue; /*when set, SendEventAsync pushes here without the lock and the worker moves the events to IoTHubClient_LL, only set before the worker starts*/
     sig_atomic_t StopThread;
 #ifndef DONT_USE_UPLOADTOBLOB
     SINGLYLINKEDLIST_HANDLE savedDataToBeCleaned; /*list containing UPLOADTOBLOB_SAVED_DATA*/
@@ -40,11 +60,13 @@ typedef struct IOTHUB_CLIENT_INSTANCE_TAG
     IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK event_confirm_callback;
     IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reported_state_callback;
     IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK connection_status_callback;
+    IOTHUB_CLIENT_SEND_QUEUE_CALLBACK send_queue_callback;
     IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC device_method_callback;
     IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK inbound_device_method_callback;
     IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC message_callback;
     struct IOTHUB_QUEUE_CONTEXT_TAG* devicetwin_user_context;
     struct IOTHUB_QUEUE_CONTEXT_TAG* connection_status_user_context;
+    struct IOTHUB_QUEUE_CONTEXT_TAG* send_queue_user_context;
     struct IOTHUB_QUEUE_CONTEXT_TAG* message_user_context;
     struct IOTHUB_QUEUE_CONTEXT_TAG* method_user_context;
 } IOTHUB_CLIENT_INSTANCE;
@@ -82,6 +104,7 @@ typedef struct UPLOADTOBLOB_THREAD_INFO_TAG
     CALLBACK_TYPE_EVENT_CONFIRM,        \
     CALLBACK_TYPE_REPORTED_STATE,       \
     CALLBACK_TYPE_CONNECTION_STATUS,    \
+    CALLBACK_TYPE_SEND_QUEUE_STATE,     \
     CALLBACK_TYPE_DEVICE_METHOD,        \
     CALLBACK_TYPE_INBOUD_DEVICE_METHOD, \
     CALLBACK_TYPE_MESSAGE
@@ -112,6 +135,11 @@ typedef struct CONNECTION_STATUS_CALLBACK_INFO_TAG
     IOTHUB_CLIENT_CONNECTION_STATUS_REASON status_reason;
 } CONNECTION_STATUS_CALLBACK_INFO;
 
+typedef struct SEND_QUEUE_CALLBACK_INFO_TAG
+{
+    IOTHUB_CLIENT_SEND_QUEUE_STATE send_queue_state;
+} SEND_QUEUE_CALLBACK_INFO;
+
 typedef struct METHOD_CALLBACK_INFO_TAG
 {
     STRING_HANDLE method_name;
@@ -129,6 +157,7 @@ typedef struct USER_CALLBACK_INFO_TAG
         EVENT_CONFIRM_CALLBACK_INFO event_confirm_cb_info;
         REPORTED_STATE_CALLBACK_INFO reported_state_cb_info;
         CONNECTION_STATUS_CALLBACK_INFO connection_status_cb_info;
+        SEND_QUEUE_CALLBACK_INFO send_queue_cb_info;
         METHOD_CALLBACK_INFO method_cb_info;
         MESSAGE_CALLBACK_INFO* message_cb_info;
     } iothub_callback;
@@ -138,8 +167,16 @@ typedef struct IOTHUB_QUEUE_CONTEXT_TAG
 {
     IOTHUB_CLIENT_INSTANCE* iotHubClientHandle;
     void* userContextCallback;
+    size_t pendingEventConfirmations; /*only used by the event confirmation callback, a batch of events shares one context*/
 } IOTHUB_QUEUE_CONTEXT;
 
+typedef struct IOTHUB_INGRESS_EVENT_TAG
+{
+    IOTHUB_QUEUE_CONTEXT queue_context; /*first member, iothub_ll_event_confirm_callback frees the whole event*/
+    IOTHUB_MESSAGE_HANDLE messageHandle;
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback;
+} IOTHUB_INGRESS_EVENT;
+
 /*used by unittests only*/
 const size_t IoTHubClient_ThreadTerminationOffset = offsetof(IOTHUB_CLIENT_INSTANCE, StopThread);
 
@@ -334,6 +371,22 @@ static void iothub_ll_connection_status_callback(IOTHUB_CLIENT_CONNECTION_STATUS
     }
 }
 
+static void iothub_ll_send_queue_callback(IOTHUB_CLIENT_SEND_QUEUE_STATE state, void* userContextCallback)
+{
+    IOTHUB_QUEUE_CONTEXT* queue_context = (IOTHUB_QUEUE_CONTEXT*)userContextCallback;
+    if (queue_context != NULL)
+    {
+        USER_CALLBACK_INFO queue_cb_info;
+        queue_cb_info.type = CALLBACK_TYPE_SEND_QUEUE_STATE;
+        queue_cb_info.userContextCallback = queue_context->userContextCallback;
+        queue_cb_info.iothub_callback.send_queue_cb_info.send_queue_state = state;
+        if (VECTOR_push_back(queue_context->iotHubClientHandle->saved_user_callback_list, &queue_cb_info, 1) != 0)
+        {
+            LogError("send queue callback vector push failed.");
+        }
+    }
+}
+
 static void iothub_ll_event_confirm_callback(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* userContextCallback)
 {
     IOTHUB_QUEUE_CONTEXT* queue_context = (IOTHUB_QUEUE_CONTEXT*)userContextCallback;
@@ -347,7 +400,12 @@ static void iothub_ll_event_confirm_callback(IOTHUB_CLIENT_CONFIRMATION_RESULT r
         {
             LogError("event confirm callback vector push failed.");
         }
-        free(queue_context);
+        /*Codes_SRS_IOTHUBCLIENT_10_028: [ The context allocated for a batch of events shall be freed after the confirmation of the last of them. ]*/
+        queue_context->pendingEventConfirmations--;
+        if (queue_context->pendingEventConfirmations == 0)
+        {
+            free(queue_context);
+        }
     }
 }
 
@@ -428,6 +486,7 @@ static void dispatch_user_callbacks(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance
     IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK event_confirm_callback = NULL;
     IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reported_state_callback = NULL;
     IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK connection_status_callback = NULL;
+    IOTHUB_CLIENT_SEND_QUEUE_CALLBACK send_queue_callback = NULL;
     IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC device_method_callback = NULL;
     IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK inbound_device_method_callback = NULL;
     IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC message_callback = NULL;
@@ -445,6 +504,7 @@ static void dispatch_user_callbacks(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance
         event_confirm_callback = iotHubClientInstance->event_confirm_callback;
         reported_state_callback = iotHubClientInstance->reported_state_callback;
         connection_status_callback = iotHubClientInstance->connection_status_callback;
+        send_queue_callback = iotHubClientInstance->send_queue_callback;
         device_method_callback = iotHubClientInstance->device_method_callback;
         inbound_device_method_callback = iotHubClientInstance->inbound_device_method_callback;
         message_callback = iotHubClientInstance->message_callback;
@@ -503,6 +563,12 @@ static void dispatch_user_callbacks(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance
                         connection_status_callback(queued_cb->iothub_callback.connection_status_cb_info.connection_status, queued_cb->iothub_callback.connection_status_cb_info.status_reason, queued_cb->userContextCallback);
                     }
                     break;
+                case CALLBACK_TYPE_SEND_QUEUE_STATE:
+                    if (send_queue_callback)
+                    {
+                        send_queue_callback(queued_cb->iothub_callback.send_queue_cb_info.send_queue_state, queued_cb->userContextCallback);
+                    }
+                    break;
                 case CALLBACK_TYPE_DEVICE_METHOD:
                     if (device_method_callback)
                     {
@@ -574,6 +640,157 @@ static void dispatch_user_callbacks(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance
     VECTOR_destroy(call_backs);
 }
 
+typedef struct USER_CALLBACK_BATCH_TAG
+{
+    IOTHUB_CLIENT_INSTANCE* iotHubClientInstance;
+    VECTOR_HANDLE call_backs;
+} USER_CALLBACK_BATCH;
+
+static void dispatch_user_callback_batch(void* context)
+{
+    USER_CALLBACK_BATCH* batch = (USER_CALLBACK_BATCH*)context;
+    dispatch_user_callbacks(batch->iotHubClientInstance, batch->call_backs);
+    free(batch);
+}
+
+/*executorClientHandle is read under LockHandle by the caller, the call_backs are the ones moved out of saved_user_callback_list*/
+static void run_user_callbacks(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT_HANDLE executorClientHandle, VECTOR_HANDLE call_backs)
+{
+    USER_CALLBACK_BATCH* batch;
+
+    if (executorClientHandle == NULL)
+    {
+        dispatch_user_callbacks(iotHubClientInstance, call_backs);
+    }
+    else if (VECTOR_size(call_backs) == 0)
+    {
+        VECTOR_destroy(call_backs);
+    }
+    else if ((batch = (USER_CALLBACK_BATCH*)malloc(sizeof(USER_CALLBACK_BATCH))) == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_10_040: [ If the callbacks cannot be posted, they shall be dispatched on the calling thread. ]*/
+        LogError("failed allocating the user callback batch, dispatching on the calling thread");
+        dispatch_user_callbacks(iotHubClientInstance, call_backs);
+    }
+    else
+    {
+        batch->iotHubClientInstance = iotHubClientInstance;
+        batch->call_backs = call_backs;
+
+        /*Codes_SRS_IOTHUBCLIENT_10_039: [ When a callback executor was set, the user callbacks queued during a call to IoTHubClient_LL_DoWork shall be posted as one task by calling IoTHubClientCallbackExecutor_Post instead of being dispatched on the thread that called IoTHubClient_LL_DoWork. ]*/
+        if (IoTHubClientCallbackExecutor_Post(executorClientHandle, dispatch_user_callback_batch, batch) != 0)
+        {
+            LogError("IoTHubClientCallbackExecutor_Post failed, dispatching on the calling thread");
+            free(batch);
+            dispatch_user_callbacks(iotHubClientInstance, call_backs);
+        }
+    }
+}
+
+/*shall be called with LockHandle taken*/
+static void signal_worker_thread(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    iotHubClientInstance->WorkPending = 1;
+    if ((iotHubClientInstance->WorkCondition != NULL) &&
+        (Condition_Post(iotHubClientInstance->WorkCondition) != COND_OK))
+    {
+        LogError("Condition_Post failed");
+    }
+    if (iotHubClientInstance->ReactorClientHandle != NULL)
+    {
+        IoTHubClientReactor_WakeClient(iotHubClientInstance->ReactorClientHandle);
+    }
+}
+
+static unsigned int get_ms_to_retry_work(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    return ((iotHubClientInstance->DoWorkFrequencyInMs != 0) && (iotHubClientInstance->DoWorkFrequencyInMs < RETRY_DO_WORK_FREQUENCY_IN_MS)) ?
+        iotHubClientInstance->DoWorkFrequencyInMs :
+        RETRY_DO_WORK_FREQUENCY_IN_MS;
+}
+
+/*shall be called with LockHandle taken*/
+static uint64_t get_ms_to_next_work(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    uint64_t result;
+
+    /* Codes_SRS_IOTHUBCLIENT_01_049: [ The thread shall not wait longer than the deadline returned by IoTHubClient_LL_GetNextWorkDeadline, or 100 ms if IoTHubClient_LL_GetNextWorkDeadline fails. ]*/
+    if (IoTHubClient_LL_GetNextWorkDeadline(iotHubClientInstance->IoTHubClientLLHandle, &result) != IOTHUB_CLIENT_OK)
+    {
+        LogError("unable to get the next work deadline");
+        result = RETRY_DO_WORK_FREQUENCY_IN_MS;
+    }
+
+    /* Codes_SRS_IOTHUBCLIENT_01_043: [ The thread shall call IoTHubClient_LL_DoWork as soon as new work is queued, and, if the OPTION_DO_WORK_FREQUENCY_IN_MS option was set, at the latest after that interval elapsed. ]*/
+    if ((iotHubClientInstance->DoWorkFrequencyInMs != 0) && (iotHubClientInstance->DoWorkFrequencyInMs < result))
+    {
+        result = iotHubClientInstance->DoWorkFrequencyInMs;
+    }
+
+    return result;
+}
+
+/*shall be called with LockHandle taken, which makes the caller the only consumer of the ingress queue*/
+static void drain_ingress_queue(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    IOTHUB_INGRESS_EVENT* ingress_event;
+
+    while ((iotHubClientInstance->IngressQueue != NULL) &&
+        ((ingress_event = (IOTHUB_INGRESS_EVENT*)ingress_queue_pop(iotHubClientInstance->IngressQueue)) != NULL))
+    {
+        IOTHUB_CLIENT_RESULT sendResult;
+
+        /*Codes_SRS_IOTHUBCLIENT_10_033: [ The events in the ingress queue shall be moved, in the order they were pushed, to IoTHubClient_LL by calling IoTHubClient_LL_SendEventAsyncTakeOwnership under the lock before each call to IoTHubClient_LL_DoWork, before any event sent through the lock and when the client is destroyed. ]*/
+        iotHubClientInstance->event_confirm_callback = ingress_event->eventConfirmationCallback;
+        if (ingress_event->eventConfirmationCallback == NULL)
+        {
+            sendResult = IoTHubClient_LL_SendEventAsyncTakeOwnership(iotHubClientInstance->IoTHubClientLLHandle, ingress_event->messageHandle, NULL, NULL);
+            if (sendResult != IOTHUB_CLIENT_OK)
+            {
+                LogError("moving an event from the ingress queue failed (%d)", (int)sendResult);
+                IoTHubMessage_Destroy(ingress_event->messageHandle);
+            }
+            free(ingress_event);
+        }
+        else
+        {
+            sendResult = IoTHubClient_LL_SendEventAsyncTakeOwnership(iotHubClientInstance->IoTHubClientLLHandle, ingress_event->messageHandle, iothub_ll_event_confirm_callback, &ingress_event->queue_context);
+            if (sendResult != IOTHUB_CLIENT_OK)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_10_034: [ If IoTHubClient_LL_SendEventAsyncTakeOwnership fails, the message shall be destroyed and the event confirmation callback shall be called with IOTHUB_CLIENT_CONFIRMATION_QUEUE_FULL if the send queue was full, IOTHUB_CLIENT_CONFIRMATION_ERROR otherwise. ]*/
+                LogError("moving an event from the ingress queue failed (%d)", (int)sendResult);
+                IoTHubMessage_Destroy(ingress_event->messageHandle);
+                iothub_ll_event_confirm_callback((sendResult == IOTHUB_CLIENT_QUEUE_FULL) ? IOTHUB_CLIENT_CONFIRMATION_QUEUE_FULL : IOTHUB_CLIENT_CONFIRMATION_ERROR, &ingress_event->queue_context);
+            }
+        }
+    }
+}
+
+static void wait_for_work(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+    {
+        LogError("failed locking while waiting for work");
+        (void)ThreadAPI_Sleep(get_ms_to_retry_work(iotHubClientInstance));
+    }
+    else
+    {
+        /*work queued after the last IoTHubClient_LL_DoWork (e.g. from a user callback) is not waited for*/
+        if ((iotHubClientInstance->StopThread == 0) && (iotHubClientInstance->WorkPending == 0) &&
+            ((iotHubClientInstance->IngressQueue == NULL) || ingress_queue_is_empty(iotHubClientInstance->IngressQueue)))
+        {
+            uint64_t waitMs = get_ms_to_next_work(iotHubClientInstance);
+
+            if (waitMs != 0)
+            {
+                /*COND_TIMEOUT is the idle case, the loop runs IoTHubClient_LL_DoWork either way*/
+                (void)Condition_Wait(iotHubClientInstance->WorkCondition, iotHubClientInstance->LockHandle, (waitMs < MAX_WAIT_FOR_WORK_IN_MS) ? (int)waitMs : MAX_WAIT_FOR_WORK_IN_MS);
+            }
+        }
+        (void)Unlock(iotHubClientInstance->LockHandle);
+    }
+}
+
 static void ScheduleWork_Thread_ForMultiplexing(void* iotHubClientHandle)
 {
     IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle;
@@ -584,6 +801,7 @@ static void ScheduleWork_Thread_ForMultiplexing(void* iotHubClientHandle)
     if (Lock(iotHubClientInstance->LockHandle) == LOCK_OK)
     {
         VECTOR_HANDLE call_backs = VECTOR_move(iotHubClientInstance->saved_user_callback_list);
+        IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT_HANDLE executorClientHandle = iotHubClientInstance->CallbackExecutorClientHandle;
         (void)Unlock(iotHubClientInstance->LockHandle);
 
         if (call_backs == NULL)
@@ -592,7 +810,7 @@ static void ScheduleWork_Thread_ForMultiplexing(void* iotHubClientHandle)
         }
         else
         {
-            dispatch_user_callbacks(iotHubClientInstance, call_backs);
+            run_user_callbacks(iotHubClientInstance, executorClientHandle, call_backs);
         }
     }
     else
@@ -601,6 +819,45 @@ static void ScheduleWork_Thread_ForMultiplexing(void* iotHubClientHandle)
     }
 }
 
+static uint64_t ScheduleWork_Reactor(void* context)
+{
+    IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)context;
+    uint64_t result;
+
+    if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_01_053: [ If acquiring the lock fails, IoTHubClient_LL_DoWork shall not be called and the client shall be run again after 100 ms, or after the OPTION_DO_WORK_FREQUENCY_IN_MS interval if it is shorter. ]*/
+        LogError("failed locking for ScheduleWork_Reactor");
+        result = get_ms_to_retry_work(iotHubClientInstance);
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_01_052: [ When run by the reactor, the client shall call IoTHubClient_LL_DoWork under its lock, dispatch the queued user callbacks after releasing it and report the time until its next work as in SRS_IOTHUBCLIENT_01_049. ]*/
+        iotHubClientInstance->WorkPending = 0;
+        drain_ingress_queue(iotHubClientInstance);
+        IoTHubClient_LL_DoWork(iotHubClientInstance->IoTHubClientLLHandle);
+
+#ifndef DONT_USE_UPLOADTOBLOB
+        garbageCollectorImpl(iotHubClientInstance);
+#endif
+        result = (iotHubClientInstance->WorkPending != 0) ? 0 : get_ms_to_next_work(iotHubClientInstance);
+
+        VECTOR_HANDLE call_backs = VECTOR_move(iotHubClientInstance->saved_user_callback_list);
+        IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT_HANDLE executorClientHandle = iotHubClientInstance->CallbackExecutorClientHandle;
+        (void)Unlock(iotHubClientInstance->LockHandle);
+        if (call_backs == NULL)
+        {
+            LogError("VECTOR_move failed");
+        }
+        else
+        {
+            run_user_callbacks(iotHubClientInstance, executorClientHandle, call_backs);
+        }
+    }
+
+    return result;
+}
+
 static int ScheduleWork_Thread(void* threadArgument)
 {
     IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)threadArgument;
@@ -617,14 +874,17 @@ static int ScheduleWork_Thread(void* threadArgument)
             }
             else
             {
-                /* Codes_SRS_IOTHUBCLIENT_01_037: [The thread created by IoTHubClient_SendEvent or IoTHubClient_SetMessageCallback shall call IoTHubClient_LL_DoWork every 1 ms.] */
+                /* Codes_SRS_IOTHUBCLIENT_01_037: [ The thread created by IoTHubClient_SendEvent or IoTHubClient_SetMessageCallback shall call IoTHubClient_LL_DoWork and then wait until new work is queued or its next work deadline is reached. ]*/
                 /* Codes_SRS_IOTHUBCLIENT_01_039: [All calls to IoTHubClient_LL_DoWork shall be protected by the lock created in IotHubClient_Create.] */
+                iotHubClientInstance->WorkPending = 0;
+                drain_ingress_queue(iotHubClientInstance);
                 IoTHubClient_LL_DoWork(iotHubClientInstance->IoTHubClientLLHandle);
 
 #ifndef DONT_USE_UPLOADTOBLOB
                 garbageCollectorImpl(iotHubClientInstance);
 #endif
                 VECTOR_HANDLE call_backs = VECTOR_move(iotHubClientInstance->saved_user_callback_list);
+                IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT_HANDLE executorClientHandle = iotHubClientInstance->CallbackExecutorClientHandle;
                 (void)Unlock(iotHubClientInstance->LockHandle);
                 if (call_backs == NULL)
                 {
@@ -632,7 +892,7 @@ static int ScheduleWork_Thread(void* threadArgument)
                 }
                 else
                 {
-                    dispatch_user_callbacks(iotHubClientInstance, call_backs);
+                    run_user_callbacks(iotHubClientInstance, executorClientHandle, call_backs);
                 }
             }
         }
@@ -641,7 +901,7 @@ static int ScheduleWork_Thread(void* threadArgument)
             /*Codes_SRS_IOTHUBCLIENT_01_040: [If acquiring the lock fails, IoTHubClient_LL_DoWork shall not be called.]*/
             /*no code, shall retry*/
         }
-        (void)ThreadAPI_Sleep(1);
+        wait_for_work(iotHubClientInstance);
     }
 
     ThreadAPI_Exit(0);
@@ -653,7 +913,27 @@ static IOTHUB_CLIENT_RESULT StartWorkerThreadIfNeeded(IOTHUB_CLIENT_INSTANCE* io
     IOTHUB_CLIENT_RESULT result;
     if (iotHubClientInstance->TransportHandle == NULL)
     {
-        if (iotHubClientInstance->ThreadHandle == NULL)
+        if (iotHubClientInstance->ReactorHandle != NULL)
+        {
+            if (iotHubClientInstance->ReactorClientHandle == NULL)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_01_054: [ If a reactor was set, the client shall be added to the reactor by calling IoTHubClientReactor_AddClient instead of starting a worker thread. ]*/
+                if ((iotHubClientInstance->ReactorClientHandle = IoTHubClientReactor_AddClient(iotHubClientInstance->ReactorHandle, ScheduleWork_Reactor, iotHubClientInstance)) == NULL)
+                {
+                    LogError("IoTHubClientReactor_AddClient failed");
+                    result = IOTHUB_CLIENT_ERROR;
+                }
+                else
+                {
+                    result = IOTHUB_CLIENT_OK;
+                }
+            }
+            else
+            {
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (iotHubClientInstance->ThreadHandle == NULL)
         {
             iotHubClientInstance->StopThread = 0;
             if (ThreadAPI_Create(&iotHubClientInstance->ThreadHandle, ScheduleWork_Thread, iotHubClientInstance) != THREADAPI_OK)
@@ -718,9 +998,15 @@ static IOTHUB_CLIENT_INSTANCE* create_iothub_instance(const IOTHUB_CLIENT_CONFIG
                 {
                     if (transportHandle != NULL)
                     {
+                        /*Codes_SRS_IOTHUBCLIENT_10_042: [ IoTHubClient_CreateWithTransport shall call IoTHubTransport_AssignShard to get the shard of transportHandle (connection, lock and worker thread) serving the new client, and use that shard for all the following transport calls. ]*/
+                        result->TransportHandle = IoTHubTransport_AssignShard(transportHandle);
+                        if (result->TransportHandle == NULL)
+                        {
+                            LogError("unable to IoTHubTransport_AssignShard");
+                            result->IoTHubClientLLHandle = NULL;
+                        }
                         /*Codes_SRS_IOTHUBCLIENT_17_005: [ IoTHubClient_CreateWithTransport shall call IoTHubTransport_GetLock to get the transport lock to be used later for serializing IoTHubClient calls. ]*/
-                        result->LockHandle = IoTHubTransport_GetLock(transportHandle);
-                        if (result->LockHandle == NULL)
+                        else if ((result->LockHandle = IoTHubTransport_GetLock(result->TransportHandle)) == NULL)
                         {
                             LogError("unable to IoTHubTransport_GetLock");
                             result->IoTHubClientLLHandle = NULL;
@@ -734,7 +1020,7 @@ static IOTHUB_CLIENT_INSTANCE* create_iothub_instance(const IOTHUB_CLIENT_CONFIG
                             deviceConfig.deviceSasToken = config->deviceSasToken;
 
                             /*Codes_SRS_IOTHUBCLIENT_17_003: [ IoTHubClient_CreateWithTransport shall call IoTHubTransport_GetLLTransport on transportHandle to get lower layer transport. ]*/
-                            deviceConfig.transportHandle = IoTHubTransport_GetLLTransport(transportHandle);
+                            deviceConfig.transportHandle = IoTHubTransport_GetLLTransport(result->TransportHandle);
                             if (deviceConfig.transportHandle == NULL)
                             {
                                 LogError("unable to IoTHubTransport_GetLLTransport");
@@ -817,6 +1103,22 @@ static IOTHUB_CLIENT_INSTANCE* create_iothub_instance(const IOTHUB_CLIENT_CONFIG
                     }
                 }
 
+                if ((result->IoTHubClientLLHandle != NULL) && (transportHandle == NULL))
+                {
+                    /* Codes_SRS_IOTHUBCLIENT_01_044: [ IoTHubClient_Create shall create a condition object used to wake up the worker thread when new work is queued. ]*/
+                    if ((result->WorkCondition = Condition_Init()) == NULL)
+                    {
+                        /* Codes_SRS_IOTHUBCLIENT_01_045: [ If creating the condition fails, then IoTHubClient_Create shall return NULL. ]*/
+                        LogError("Failure creating Condition object");
+                        IoTHubClient_LL_Destroy(result->IoTHubClientLLHandle);
+                        result->IoTHubClientLLHandle = NULL;
+                    }
+                }
+                else
+                {
+                    result->WorkCondition = NULL;
+                }
+
                 if (result->IoTHubClientLLHandle == NULL)
                 {
                     /* Codes_SRS_IOTHUBCLIENT_01_003: [If IoTHubClient_LL_Create fails, then IoTHubClient_Create shall return NULL.] */
@@ -826,6 +1128,11 @@ static IOTHUB_CLIENT_INSTANCE* create_iothub_instance(const IOTHUB_CLIENT_CONFIG
                     {
                         Lock_Deinit(result->LockHandle);
                     }
+                    else
+                    {
+                        /*Codes_SRS_IOTHUBCLIENT_10_043: [ If IoTHubClient_CreateWithTransport fails after the shard was assigned, it shall call IoTHubTransport_ReleaseShard. ]*/
+                        IoTHubTransport_ReleaseShard(result->TransportHandle);
+                    }
 #ifndef DONT_USE_UPLOADTOBLOB
                     singlylinkedlist_destroy(result->savedDataToBeCleaned);
 #endif
@@ -837,12 +1144,20 @@ static IOTHUB_CLIENT_INSTANCE* create_iothub_instance(const IOTHUB_CLIENT_CONFIG
                 else
                 {
                     result->ThreadHandle = NULL;
+                    result->ReactorHandle = NULL;
+                    result->ReactorClientHandle = NULL;
+                    result->CallbackExecutorClientHandle = NULL;
+                    result->WorkPending = 0;
+                    result->DoWorkFrequencyInMs = DEFAULT_DO_WORK_FREQUENCY_IN_MS;
+                    result->IngressQueue = NULL;
                     result->desired_state_callback = NULL;
                     result->event_confirm_callback = NULL;
                     result->reported_state_callback = NULL;
                     result->devicetwin_user_context = NULL;
                     result->connection_status_callback = NULL;
                     result->connection_status_user_context = NULL;
+                    result->send_queue_callback = NULL;
+                    result->send_queue_user_context = NULL;
                     result->message_callback = NULL;
                     result->message_user_context = NULL;
                     result->method_user_context = NULL;
@@ -948,6 +1263,8 @@ void IoTHubClient_Destroy(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
     {
         bool joinClientThread;
         bool joinTransportThread;
+        IOTHUB_CLIENT_REACTOR_CLIENT_HANDLE reactorClientHandle;
+        IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT_HANDLE executorClientHandle;
         size_t vector_size;
 
         IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle;
@@ -971,6 +1288,7 @@ void IoTHubClient_Destroy(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
         if (iotHubClientInstance->ThreadHandle != NULL)
         {
             iotHubClientInstance->StopThread = 1;
+            signal_worker_thread(iotHubClientInstance);
             joinClientThread = true;
         }
         else
@@ -978,6 +1296,14 @@ void IoTHubClient_Destroy(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
             joinClientThread = false;
         }
 
+        /*the reactor is not woken up for this client anymore once the handle is cleared*/
+        reactorClientHandle = iotHubClientInstance->ReactorClientHandle;
+        iotHubClientInstance->ReactorClientHandle = NULL;
+
+        /*a worker that is still running dispatches the callbacks it moves out from now on itself*/
+        executorClientHandle = iotHubClientInstance->CallbackExecutorClientHandle;
+        iotHubClientInstance->CallbackExecutorClientHandle = NULL;
+
         /*Codes_SRS_IOTHUBCLIENT_02_045: [ IoTHubClient_Destroy shall unlock the serializing lock. ]*/
         if (Unlock(iotHubClientInstance->LockHandle) != LOCK_OK)
         {
@@ -1000,6 +1326,18 @@ void IoTHubClient_Destroy(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
             IoTHubTransport_JoinWorkerThread(iotHubClientInstance->TransportHandle, iotHubClientHandle);
         }
 
+        if (reactorClientHandle != NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_01_055: [ If the client was added to a reactor, IoTHubClient_Destroy shall remove it by calling IoTHubClientReactor_RemoveClient before destroying the IoTHubClient_LL instance. ]*/
+            IoTHubClientReactor_RemoveClient(reactorClientHandle);
+        }
+
+        if (executorClientHandle != NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_10_041: [ If a callback executor was set, IoTHubClient_Destroy shall call IoTHubClientCallbackExecutor_RemoveClient, which runs the callbacks posted earlier, after the worker thread stopped and before destroying the IoTHubClient_LL instance. ]*/
+            IoTHubClientCallbackExecutor_RemoveClient(executorClientHandle);
+        }
+
         if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
         {
             LogError("unable to Lock - - will still proceed to try to end the thread without locking");
@@ -1019,6 +1357,9 @@ void IoTHubClient_Destroy(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
         }
 #endif
 
+        /*events still in the ingress queue are completed by IoTHubClient_LL_Destroy like the others*/
+        drain_ingress_queue(iotHubClientInstance);
+
         /* Codes_SRS_IOTHUBCLIENT_01_006: [That includes destroying the IoTHubClient_LL instance by calling IoTHubClient_LL_Destroy.] */
         IoTHubClient_LL_Destroy(iotHubClientInstance->IoTHubClientLLHandle);
 
@@ -1062,6 +1403,16 @@ void IoTHubClient_Destroy(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
         {
             /* Codes_SRS_IOTHUBCLIENT_01_032: [If the lock was allocated in IoTHubClient_Create, it shall be also freed..] */
             Lock_Deinit(iotHubClientInstance->LockHandle);
+            Condition_Deinit(iotHubClientInstance->WorkCondition);
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_10_044: [ If the client was created with a transport, IoTHubClient_Destroy shall call IoTHubTransport_ReleaseShard so the shard can be assigned to the next client. ]*/
+            IoTHubTransport_ReleaseShard(iotHubClientInstance->TransportHandle);
+        }
+        if (iotHubClientInstance->IngressQueue != NULL)
+        {
+            ingress_queue_destroy(iotHubClientInstance->IngressQueue);
         }
         if (iotHubClientInstance->devicetwin_user_context != NULL)
         {
@@ -1071,6 +1422,10 @@ void IoTHubClient_Destroy(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
         {
             free(iotHubClientInstance->connection_status_user_context);
         }
+        if (iotHubClientInstance->send_queue_user_context != NULL)
+        {
+            free(iotHubClientInstance->send_queue_user_context);
+        }
         if (iotHubClientInstance->message_user_context != NULL)
         {
             free(iotHubClientInstance->message_user_context);
@@ -1083,7 +1438,21 @@ void IoTHubClient_Destroy(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
     }
 }
 
-IOTHUB_CLIENT_RESULT IoTHubClient_SendEventAsync(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+typedef IOTHUB_CLIENT_RESULT(*LL_SEND_EVENT_ASYNC)(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, const IOTHUB_MESSAGE_HANDLE* eventMessageHandles, size_t messageCount, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback);
+
+static IOTHUB_CLIENT_RESULT ll_send_event_async(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, const IOTHUB_MESSAGE_HANDLE* eventMessageHandles, size_t messageCount, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    (void)messageCount;
+    return IoTHubClient_LL_SendEventAsync(iotHubClientHandle, eventMessageHandles[0], eventConfirmationCallback, userContextCallback);
+}
+
+static IOTHUB_CLIENT_RESULT ll_send_event_async_take_ownership(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, const IOTHUB_MESSAGE_HANDLE* eventMessageHandles, size_t messageCount, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    (void)messageCount;
+    return IoTHubClient_LL_SendEventAsyncTakeOwnership(iotHubClientHandle, eventMessageHandles[0], eventConfirmationCallback, userContextCallback);
+}
+
+static IOTHUB_CLIENT_RESULT send_event_async(IOTHUB_CLIENT_HANDLE iotHubClientHandle, LL_SEND_EVENT_ASYNC llSendEventAsync, const IOTHUB_MESSAGE_HANDLE* eventMessageHandles, size_t messageCount, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
 {
     IOTHUB_CLIENT_RESULT result;
 
@@ -1115,6 +1484,9 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SendEventAsync(IOTHUB_CLIENT_HANDLE iotHubClie
             }
             else
             {
+                /*Codes_SRS_IOTHUBCLIENT_10_035: [ Events sent through the lock shall be queued after the events already in the ingress queue. ]*/
+                drain_ingress_queue(iotHubClientInstance);
+
                 if (iotHubClientInstance->created_with_transport_handle == 0)
                 {
                     iotHubClientInstance->event_confirm_callback = eventConfirmationCallback;
@@ -1122,7 +1494,7 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SendEventAsync(IOTHUB_CLIENT_HANDLE iotHubClie
 
                 if (iotHubClientInstance->created_with_transport_handle != 0 || eventConfirmationCallback == NULL)
                 {
-                    result = IoTHubClient_LL_SendEventAsync(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandle, eventConfirmationCallback, userContextCallback);
+                    result = llSendEventAsync(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandles, messageCount, eventConfirmationCallback, userContextCallback);
                 }
                 else
                 {
@@ -1137,17 +1509,24 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SendEventAsync(IOTHUB_CLIENT_HANDLE iotHubClie
                     {
                         queue_context->iotHubClientHandle = iotHubClientInstance;
                         queue_context->userContextCallback = userContextCallback;
+                        queue_context->pendingEventConfirmations = messageCount;
                         /* Codes_SRS_IOTHUBCLIENT_01_012: [IoTHubClient_SendEventAsync shall call IoTHubClient_LL_SendEventAsync, while passing the IoTHubClient_LL handle created by IoTHubClient_Create and the parameters eventMessageHandle, eventConfirmationCallback and userContextCallback.] */
                         /* Codes_SRS_IOTHUBCLIENT_01_013: [When IoTHubClient_LL_SendEventAsync is called, IoTHubClient_SendEventAsync shall return the result of IoTHubClient_LL_SendEventAsync.] */
-                        result = IoTHubClient_LL_SendEventAsync(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandle, iothub_ll_event_confirm_callback, queue_context);
+                        result = llSendEventAsync(iotHubClientInstance->IoTHubClientLLHandle, eventMessageHandles, messageCount, iothub_ll_event_confirm_callback, queue_context);
                         if (result != IOTHUB_CLIENT_OK)
                         {
-                            LogError("IoTHubClient_LL_SendEventAsync failed");
+                            LogError("queueing the event in IoTHubClient_LL failed");
                             free(queue_context);
                         }
                     }
                 }
 
+                if (result == IOTHUB_CLIENT_OK)
+                {
+                    /* Codes_SRS_IOTHUBCLIENT_01_046: [ When the event was queued, IoTHubClient_SendEventAsync shall wake up the worker thread. ]*/
+                    signal_worker_thread(iotHubClientInstance);
+                }
+
                 /* Codes_SRS_IOTHUBCLIENT_01_025: [IoTHubClient_SendEventAsync shall be made thread-safe by using the lock created in IoTHubClient_Create.] */
                 (void)Unlock(iotHubClientInstance->LockHandle);
             }
@@ -1157,6 +1536,101 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SendEventAsync(IOTHUB_CLIENT_HANDLE iotHubClie
     return result;
 }
 
+/*does not take the lock, returns non-zero if the event shall be sent through the lock instead*/
+static int push_ingress_event(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, IOTHUB_MESSAGE_HANDLE eventMessageHandle, bool takeOwnership, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    int result;
+    IOTHUB_INGRESS_EVENT* ingress_event;
+
+    if (StartWorkerThreadIfNeeded(iotHubClientInstance) != IOTHUB_CLIENT_OK)
+    {
+        LogError("Could not start worker thread");
+        result = __FAILURE__;
+    }
+    else if ((ingress_event = (IOTHUB_INGRESS_EVENT*)malloc(sizeof(IOTHUB_INGRESS_EVENT))) == NULL)
+    {
+        LogError("Failed allocating IOTHUB_INGRESS_EVENT");
+        result = __FAILURE__;
+    }
+    else if ((ingress_event->messageHandle = (takeOwnership ? eventMessageHandle : IoTHubMessage_Clone(eventMessageHandle))) == NULL)
+    {
+        LogError("IoTHubMessage_Clone failed");
+        free(ingress_event);
+        result = __FAILURE__;
+    }
+    else
+    {
+        ingress_event->queue_context.iotHubClientHandle = iotHubClientInstance;
+        ingress_event->queue_context.userContextCallback = userContextCallback;
+        ingress_event->queue_context.pendingEventConfirmations = 1;
+        ingress_event->eventConfirmationCallback = eventConfirmationCallback;
+
+        if (ingress_queue_push(iotHubClientInstance->IngressQueue, ingress_event) != 0)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_10_032: [ If the ingress queue is full or pushing fails for any other reason, the event shall be sent through the lock as if OPTION_INGRESS_QUEUE_SIZE was not set. ]*/
+            if (!takeOwnership)
+            {
+                IoTHubMessage_Destroy(ingress_event->messageHandle);
+            }
+            free(ingress_event);
+            result = __FAILURE__;
+        }
+        else
+        {
+            /*the worker may miss a wake up posted between its check of the queue and its wait, it then moves the event when the wait times out*/
+            if (Condition_Post(iotHubClientInstance->WorkCondition) != COND_OK)
+            {
+                LogError("Condition_Post failed");
+            }
+            if (iotHubClientInstance->ReactorClientHandle != NULL)
+            {
+                IoTHubClientReactor_WakeClient(iotHubClientInstance->ReactorClientHandle);
+            }
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static IOTHUB_CLIENT_RESULT send_single_event_async(IOTHUB_CLIENT_HANDLE iotHubClientHandle, bool takeOwnership, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+    IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle;
+
+    /*Codes_SRS_IOTHUBCLIENT_10_031: [ If OPTION_INGRESS_QUEUE_SIZE was set and eventMessageHandle is not NULL, IoTHubClient_SendEventAsync shall start the worker thread if needed, clone the message, push it to the ingress queue without taking the lock, wake up the worker and return IOTHUB_CLIENT_OK. ]*/
+    if ((iotHubClientInstance != NULL) &&
+        (iotHubClientInstance->IngressQueue != NULL) &&
+        (eventMessageHandle != NULL) &&
+        (push_ingress_event(iotHubClientInstance, eventMessageHandle, takeOwnership, eventConfirmationCallback, userContextCallback) == 0))
+    {
+        result = IOTHUB_CLIENT_OK;
+    }
+    else
+    {
+        result = send_event_async(iotHubClientHandle, takeOwnership ? ll_send_event_async_take_ownership : ll_send_event_async, &eventMessageHandle, 1, eventConfirmationCallback, userContextCallback);
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_SendEventAsync(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    return send_single_event_async(iotHubClientHandle, false, eventMessageHandle, eventConfirmationCallback, userContextCallback);
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_SendEventAsyncTakeOwnership(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    /* Codes_SRS_IOTHUBCLIENT_01_058: [ IoTHubClient_SendEventAsyncTakeOwnership shall behave like IoTHubClient_SendEventAsync, except that it shall call IoTHubClient_LL_SendEventAsyncTakeOwnership instead of IoTHubClient_LL_SendEventAsync. ]*/
+    return send_single_event_async(iotHubClientHandle, true, eventMessageHandle, eventConfirmationCallback, userContextCallback);
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_SendEventBatchAsync(IOTHUB_CLIENT_HANDLE iotHubClientHandle, const IOTHUB_MESSAGE_HANDLE* eventMessageHandles, size_t messageCount, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    /* Codes_SRS_IOTHUBCLIENT_10_027: [ IoTHubClient_SendEventBatchAsync shall behave like IoTHubClient_SendEventAsync, taking the lock once for all the messages, except that it shall call IoTHubClient_LL_SendEventBatchAsync instead of IoTHubClient_LL_SendEventAsync. ]*/
+    return send_event_async(iotHubClientHandle, IoTHubClient_LL_SendEventBatchAsync, eventMessageHandles, messageCount, eventConfirmationCallback, userContextCallback);
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClient_GetSendStatus(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_CLIENT_STATUS *iotHubClientStatus)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1266,6 +1740,12 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SetMessageCallback(IOTHUB_CLIENT_HANDLE iotHub
                     }
                 }
 
+                /*Codes_SRS_IOTHUBCLIENT_01_059: [ When the callback was set, the worker thread shall be woken up so that the transport updates its subscription without waiting for the next work deadline. ]*/
+                if (result == IOTHUB_CLIENT_OK)
+                {
+                    signal_worker_thread(iotHubClientInstance);
+                }
+
                 /* Codes_SRS_IOTHUBCLIENT_01_027: [IoTHubClient_SetMessageCallback shall be made thread-safe by using the lock created in IoTHubClient_Create.] */
                 (void)Unlock(iotHubClientInstance->LockHandle);
             }
@@ -1351,6 +1831,77 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SetConnectionStatusCallback(IOTHUB_CLIENT_HAND
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClient_SetSendQueueCallback(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_CLIENT_SEND_QUEUE_CALLBACK sendQueueCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (iotHubClientHandle == NULL)
+    {
+        /* Codes_SRS_IOTHUBCLIENT_10_023: [ If `iotHubClientHandle` is `NULL`, `IoTHubClient_SetSendQueueCallback` shall return `IOTHUB_CLIENT_INVALID_ARG`. ]*/
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("NULL iothubClientHandle");
+    }
+    else
+    {
+        IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle;
+
+        /* Codes_SRS_IOTHUBCLIENT_10_024: [ `IoTHubClient_SetSendQueueCallback` shall start the worker thread if it was not previously started, and return `IOTHUB_CLIENT_ERROR` if that fails. ]*/
+        if ((result = StartWorkerThreadIfNeeded(iotHubClientInstance)) != IOTHUB_CLIENT_OK)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not start worker thread");
+        }
+        /* Codes_SRS_IOTHUBCLIENT_10_025: [ `IoTHubClient_SetSendQueueCallback` shall be made thread-safe by using the lock created in `IoTHubClient_Create`, and return `IOTHUB_CLIENT_ERROR` if acquiring the lock fails. ]*/
+        else if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not acquire lock");
+        }
+        else
+        {
+            if (iotHubClientInstance->created_with_transport_handle == 0)
+            {
+                iotHubClientInstance->send_queue_callback = sendQueueCallback;
+            }
+
+            if (iotHubClientInstance->created_with_transport_handle != 0 || sendQueueCallback == NULL)
+            {
+                /* Codes_SRS_IOTHUBCLIENT_10_026: [ `IoTHubClient_SetSendQueueCallback` shall call `IoTHubClient_LL_SetSendQueueCallback`, so that the send queue callback is invoked from the thread that dispatches the other user callbacks. ]*/
+                result = IoTHubClient_LL_SetSendQueueCallback(iotHubClientInstance->IoTHubClientLLHandle, sendQueueCallback, userContextCallback);
+            }
+            else
+            {
+                if (iotHubClientInstance->send_queue_user_context != NULL)
+                {
+                    free(iotHubClientInstance->send_queue_user_context);
+                }
+                iotHubClientInstance->send_queue_user_context = (IOTHUB_QUEUE_CONTEXT*)malloc(sizeof(IOTHUB_QUEUE_CONTEXT));
+                if (iotHubClientInstance->send_queue_user_context == NULL)
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("Failed allocating QUEUE_CONTEXT");
+                }
+                else
+                {
+                    iotHubClientInstance->send_queue_user_context->iotHubClientHandle = iotHubClientInstance;
+                    iotHubClientInstance->send_queue_user_context->userContextCallback = userContextCallback;
+
+                    /* Codes_SRS_IOTHUBCLIENT_10_026: [ `IoTHubClient_SetSendQueueCallback` shall call `IoTHubClient_LL_SetSendQueueCallback`, so that the send queue callback is invoked from the thread that dispatches the other user callbacks. ]*/
+                    result = IoTHubClient_LL_SetSendQueueCallback(iotHubClientInstance->IoTHubClientLLHandle, iothub_ll_send_queue_callback, iotHubClientInstance->send_queue_user_context);
+                    if (result != IOTHUB_CLIENT_OK)
+                    {
+                        LogError("IoTHubClient_LL_SetSendQueueCallback failed");
+                        free(iotHubClientInstance->send_queue_user_context);
+                        iotHubClientInstance->send_queue_user_context = NULL;
+                    }
+                }
+            }
+            (void)Unlock(iotHubClientInstance->LockHandle);
+        }
+    }
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClient_SetRetryPolicy(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_CLIENT_RETRY_POLICY retryPolicy, size_t retryTimeoutLimitInSeconds)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1471,6 +2022,96 @@ IOTHUB_CLIENT_RESULT IoTHubClient_GetLastMessageReceiveTime(IOTHUB_CLIENT_HANDLE
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClient_SetReactor(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_CLIENT_REACTOR_HANDLE reactorHandle)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if ((iotHubClientHandle == NULL) || (reactorHandle == NULL))
+    {
+        /*Codes_SRS_IOTHUBCLIENT_01_050: [ If iotHubClientHandle or reactorHandle are NULL, IoTHubClient_SetReactor shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("invalid arg (iotHubClientHandle=%p, reactorHandle=%p)", iotHubClientHandle, reactorHandle);
+    }
+    else
+    {
+        IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle;
+
+        if (iotHubClientInstance->TransportHandle != NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_01_051: [ If the client uses a shared transport, IoTHubClient_SetReactor shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+            result = IOTHUB_CLIENT_INVALID_ARG;
+            LogError("a reactor cannot be set on a shared transport");
+        }
+        else if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not acquire lock");
+        }
+        else
+        {
+            if ((iotHubClientInstance->ThreadHandle != NULL) || (iotHubClientInstance->ReactorHandle != NULL))
+            {
+                /*Codes_SRS_IOTHUBCLIENT_01_056: [ If the worker thread was already started or a reactor was already set, IoTHubClient_SetReactor shall return IOTHUB_CLIENT_ERROR. ]*/
+                result = IOTHUB_CLIENT_ERROR;
+                LogError("the client is already scheduled");
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBCLIENT_01_057: [ IoTHubClient_SetReactor shall store reactorHandle. The reactor then runs the client when work is queued for it and at the deadline reported by its previous run. ]*/
+                iotHubClientInstance->ReactorHandle = reactorHandle;
+                result = IOTHUB_CLIENT_OK;
+            }
+            (void)Unlock(iotHubClientInstance->LockHandle);
+        }
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_SetCallbackExecutor(IOTHUB_CLIENT_HANDLE iotHubClientHandle, IOTHUB_CLIENT_CALLBACK_EXECUTOR_HANDLE executorHandle)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if ((iotHubClientHandle == NULL) || (executorHandle == NULL))
+    {
+        /*Codes_SRS_IOTHUBCLIENT_10_036: [ If iotHubClientHandle or executorHandle are NULL, IoTHubClient_SetCallbackExecutor shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("invalid arg (iotHubClientHandle=%p, executorHandle=%p)", iotHubClientHandle, executorHandle);
+    }
+    else
+    {
+        IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)iotHubClientHandle;
+
+        if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_10_037: [ If acquiring the lock fails or a callback executor was already set, IoTHubClient_SetCallbackExecutor shall return IOTHUB_CLIENT_ERROR. ]*/
+            result = IOTHUB_CLIENT_ERROR;
+            LogError("Could not acquire lock");
+        }
+        else
+        {
+            if (iotHubClientInstance->CallbackExecutorClientHandle != NULL)
+            {
+                result = IOTHUB_CLIENT_ERROR;
+                LogError("a callback executor was already set");
+            }
+            /*Codes_SRS_IOTHUBCLIENT_10_038: [ IoTHubClient_SetCallbackExecutor shall add the client to the executor by calling IoTHubClientCallbackExecutor_AddClient and return IOTHUB_CLIENT_ERROR if that fails. ]*/
+            else if ((iotHubClientInstance->CallbackExecutorClientHandle = IoTHubClientCallbackExecutor_AddClient(executorHandle)) == NULL)
+            {
+                result = IOTHUB_CLIENT_ERROR;
+                LogError("IoTHubClientCallbackExecutor_AddClient failed");
+            }
+            else
+            {
+                result = IOTHUB_CLIENT_OK;
+            }
+            (void)Unlock(iotHubClientInstance->LockHandle);
+        }
+    }
+
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClient_SetOption(IOTHUB_CLIENT_HANDLE iotHubClientHandle, const char* optionName, const void* value)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1499,11 +2140,58 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SetOption(IOTHUB_CLIENT_HANDLE iotHubClientHan
         }
         else
         {
-            /*Codes_SRS_IOTHUBCLIENT_02_038: [If optionName doesn't match one of the options handled by this module then IoTHubClient_SetOption shall call IoTHubClient_LL_SetOption passing the same parameters and return what IoTHubClient_LL_SetOption returns.] */
-            result = IoTHubClient_LL_SetOption(iotHubClientInstance->IoTHubClientLLHandle, optionName, value);
-            if (result != IOTHUB_CLIENT_OK)
+            if (strcmp(optionName, OPTION_DO_WORK_FREQUENCY_IN_MS) == 0)
+            {
+                if (iotHubClientInstance->WorkCondition == NULL)
+                {
+                    /*Codes_SRS_IOTHUBCLIENT_01_048: [ If the client does not own its worker thread, setting OPTION_DO_WORK_FREQUENCY_IN_MS shall fail and return IOTHUB_CLIENT_INVALID_ARG. ]*/
+                    result = IOTHUB_CLIENT_INVALID_ARG;
+                    LogError("option %s is not supported on a shared transport", optionName);
+                }
+                else if (*(const unsigned int*)value == 0)
+                {
+                    result = IOTHUB_CLIENT_INVALID_ARG;
+                    LogError("option %s shall be greater than 0", optionName);
+                }
+                else
+                {
+                    /*Codes_SRS_IOTHUBCLIENT_01_047: [ If optionName is OPTION_DO_WORK_FREQUENCY_IN_MS then IoTHubClient_SetOption shall set the maximum idle time of the worker thread to the value pointed to by value (an unsigned int). The option is not set by default. ]*/
+                    iotHubClientInstance->DoWorkFrequencyInMs = *(const unsigned int*)value;
+                    signal_worker_thread(iotHubClientInstance);
+                    result = IOTHUB_CLIENT_OK;
+                }
+            }
+            else if (strcmp(optionName, OPTION_INGRESS_QUEUE_SIZE) == 0)
+            {
+                if ((iotHubClientInstance->WorkCondition == NULL) ||
+                    (iotHubClientInstance->ThreadHandle != NULL) ||
+                    (iotHubClientInstance->ReactorClientHandle != NULL) ||
+                    (*(const size_t*)value == 0) ||
+                    (iotHubClientInstance->IngressQueue != NULL))
+                {
+                    /*Codes_SRS_IOTHUBCLIENT_10_029: [ If optionName is OPTION_INGRESS_QUEUE_SIZE, IoTHubClient_SetOption shall fail and return IOTHUB_CLIENT_INVALID_ARG if the client does not own its worker thread, its worker thread or reactor client was already started, the value is 0 or the option was already set. ]*/
+                    result = IOTHUB_CLIENT_INVALID_ARG;
+                    LogError("option %s can only be set once, to a value greater than 0, before the first event is sent, on a client that does not share its transport", optionName);
+                }
+                else if ((iotHubClientInstance->IngressQueue = ingress_queue_create(*(const size_t*)value)) == NULL)
+                {
+                    /*Codes_SRS_IOTHUBCLIENT_10_030: [ IoTHubClient_SetOption shall create an ingress queue of the size pointed to by value (a size_t) by calling ingress_queue_create, and return IOTHUB_CLIENT_ERROR if that fails. ]*/
+                    result = IOTHUB_CLIENT_ERROR;
+                    LogError("ingress_queue_create failed");
+                }
+                else
+                {
+                    result = IOTHUB_CLIENT_OK;
+                }
+            }
+            else
             {
-                LogError("IoTHubClient_LL_SetOption failed");
+                /*Codes_SRS_IOTHUBCLIENT_02_038: [If optionName doesn't match one of the options handled by this module then IoTHubClient_SetOption shall call IoTHubClient_LL_SetOption passing the same parameters and return what IoTHubClient_LL_SetOption returns.] */
+                result = IoTHubClient_LL_SetOption(iotHubClientInstance->IoTHubClientLLHandle, optionName, value);
+                if (result != IOTHUB_CLIENT_OK)
+                {
+                    LogError("IoTHubClient_LL_SetOption failed");
+                }
             }
 
             (void)Unlock(iotHubClientInstance->LockHandle);
@@ -1583,6 +2271,12 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SetDeviceTwinCallback(IOTHUB_CLIENT_HANDLE iot
                     }
                 }
 
+                /*Codes_SRS_IOTHUBCLIENT_01_059: [ When the callback was set, the worker thread shall be woken up so that the transport updates its subscription without waiting for the next work deadline. ]*/
+                if (result == IOTHUB_CLIENT_OK)
+                {
+                    signal_worker_thread(iotHubClientInstance);
+                }
+
                 (void)Unlock(iotHubClientInstance->LockHandle);
             }
         }
@@ -1657,6 +2351,12 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SendReportedState(IOTHUB_CLIENT_HANDLE iotHubC
                     }
                 }
 
+                if (result == IOTHUB_CLIENT_OK)
+                {
+                    /*Codes_SRS_IOTHUBCLIENT_10_022: [ When the reported state was queued, IoTHubClient_SendReportedState shall wake up the worker thread. ]*/
+                    signal_worker_thread(iotHubClientInstance);
+                }
+
                 (void)Unlock(iotHubClientInstance->LockHandle);
             }
         }
@@ -1739,6 +2439,12 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SetDeviceMethodCallback(IOTHUB_CLIENT_HANDLE i
                     }
                 }
 
+                /*Codes_SRS_IOTHUBCLIENT_01_059: [ When the callback was set, the worker thread shall be woken up so that the transport updates its subscription without waiting for the next work deadline. ]*/
+                if (result == IOTHUB_CLIENT_OK)
+                {
+                    signal_worker_thread(iotHubClientInstance);
+                }
+
                 (void)Unlock(iotHubClientInstance->LockHandle);
             }
 
@@ -1823,6 +2529,12 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SetDeviceMethodCallback_Ex(IOTHUB_CLIENT_HANDL
                     }
                 }
 
+                /*Codes_SRS_IOTHUBCLIENT_01_059: [ When the callback was set, the worker thread shall be woken up so that the transport updates its subscription without waiting for the next work deadline. ]*/
+                if (result == IOTHUB_CLIENT_OK)
+                {
+                    signal_worker_thread(iotHubClientInstance);
+                }
+
                 (void)Unlock(iotHubClientInstance->LockHandle);
             }
         }
@@ -1858,6 +2570,10 @@ IOTHUB_CLIENT_RESULT IoTHubClient_DeviceMethodResponse(IOTHUB_CLIENT_HANDLE iotH
             {
                 LogError("IoTHubClient_LL_DeviceMethodResponse failed");
             }
+            else
+            {
+                signal_worker_thread(iotHubClientInstance);
+            }
             (void)Unlock(iotHubClientInstance->LockHandle);
         }
     }
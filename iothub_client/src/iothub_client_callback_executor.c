@@ -0,0 +1,423 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include <signal.h>
+#include <stddef.h>
+#include <string.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "iothub_client_callback_executor.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/singlylinkedlist.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+/*bounds a single Condition_Wait, an idle thread goes back to sleep if no client is ready*/
+#define MAX_WAIT_MS 60000
+/*RemoveClient rechecks the client state at this interval in case the signal went to another remover*/
+#define REMOVE_RECHECK_MS 100
+
+typedef struct IOTHUB_CLIENT_CALLBACK_EXECUTOR_TAG
+{
+    LOCK_HANDLE lockHandle;
+    COND_HANDLE workCondition; /*signaled (under lockHandle) when a client became ready or the threads shall stop*/
+    COND_HANDLE idleCondition; /*signaled (under lockHandle) when a task of a client that is being removed returned*/
+    SINGLYLINKEDLIST_HANDLE readyClients; /*list containing IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT with a task that may start now, oldest first*/
+    THREAD_HANDLE* threadHandles;
+    size_t threadCount;
+    bool perClientOrdering;
+    sig_atomic_t stopThreads;
+} IOTHUB_CLIENT_CALLBACK_EXECUTOR;
+
+typedef struct IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT_TAG
+{
+    IOTHUB_CLIENT_CALLBACK_EXECUTOR* executor;
+    SINGLYLINKEDLIST_HANDLE tasks; /*list containing EXECUTOR_TASK, oldest first*/
+    LIST_ITEM_HANDLE readyItem; /*the entry in readyClients, NULL when the client is not in there*/
+    size_t runningCount;
+    int removePending;
+} IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT;
+
+typedef struct EXECUTOR_TASK_TAG
+{
+    IOTHUB_CLIENT_CALLBACK_EXECUTOR_TASK task;
+    void* context;
+} EXECUTOR_TASK;
+
+/*shall be called with executor->lockHandle taken and a task queued for the client*/
+static void make_client_ready(IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT* client)
+{
+    IOTHUB_CLIENT_CALLBACK_EXECUTOR* executor = client->executor;
+
+    /*Codes_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_015: [ With perClientOrdering, a task shall not start while another task of the same client is running. ]*/
+    if ((client->readyItem == NULL) &&
+        (client->removePending == 0) &&
+        ((executor->perClientOrdering == false) || (client->runningCount == 0)))
+    {
+        if ((client->readyItem = singlylinkedlist_add(executor->readyClients, client)) == NULL)
+        {
+            /*the task is not lost, RemoveClient runs what is left*/
+            LogError("failed adding the client to the ready list");
+        }
+        else if (Condition_Post(executor->workCondition) != COND_OK)
+        {
+            LogError("Condition_Post failed");
+        }
+    }
+}
+
+/*shall be called with executor->lockHandle taken*/
+static void run_next_task(IOTHUB_CLIENT_CALLBACK_EXECUTOR* executor, LIST_ITEM_HANDLE readyItem)
+{
+    IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT* client = (IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT*)singlylinkedlist_item_get_value(readyItem);
+    LIST_ITEM_HANDLE taskItem;
+
+    if (singlylinkedlist_remove(executor->readyClients, readyItem) != 0)
+    {
+        LogError("failed removing the client from the ready list");
+    }
+    client->readyItem = NULL;
+
+    if ((taskItem = singlylinkedlist_get_head_item(client->tasks)) == NULL)
+    {
+        LogError("a ready client has no task");
+    }
+    else
+    {
+        EXECUTOR_TASK* task = (EXECUTOR_TASK*)singlylinkedlist_item_get_value(taskItem);
+        (void)singlylinkedlist_remove(client->tasks, taskItem);
+        client->runningCount++;
+
+        /*Codes_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_016: [ Without perClientOrdering, the next task of the client shall be allowed to start on another thread while the current one runs. ]*/
+        if (singlylinkedlist_get_head_item(client->tasks) != NULL)
+        {
+            make_client_ready(client);
+        }
+
+        /*Codes_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_014: [ A thread shall run the oldest task of the client that became ready first, without holding the executor lock. ]*/
+        (void)Unlock(executor->lockHandle);
+        task->task(task->context);
+        free(task);
+        if (Lock(executor->lockHandle) != LOCK_OK)
+        {
+            LogError("failed locking the callback executor after running a task");
+        }
+
+        client->runningCount--;
+        /*the client goes to the back of the ready list so that a busy client does not starve the others*/
+        if (singlylinkedlist_get_head_item(client->tasks) != NULL)
+        {
+            make_client_ready(client);
+        }
+
+        if ((client->removePending != 0) &&
+            (Condition_Post(executor->idleCondition) != COND_OK))
+        {
+            LogError("Condition_Post failed");
+        }
+    }
+}
+
+static int executor_thread(void* threadArgument)
+{
+    IOTHUB_CLIENT_CALLBACK_EXECUTOR* executor = (IOTHUB_CLIENT_CALLBACK_EXECUTOR*)threadArgument;
+
+    if (Lock(executor->lockHandle) != LOCK_OK)
+    {
+        LogError("failed locking the callback executor, the thread will not run");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_017: [ The threads shall exit when IoTHubClientCallbackExecutor_Destroy is called. ]*/
+        while (executor->stopThreads == 0)
+        {
+            LIST_ITEM_HANDLE readyItem = singlylinkedlist_get_head_item(executor->readyClients);
+
+            if (readyItem != NULL)
+            {
+                run_next_task(executor, readyItem);
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_018: [ When no client is ready a thread shall wait on the executor condition. ]*/
+                (void)Condition_Wait(executor->workCondition, executor->lockHandle, MAX_WAIT_MS);
+            }
+        }
+
+        (void)Unlock(executor->lockHandle);
+    }
+
+    ThreadAPI_Exit(0);
+    return 0;
+}
+
+static void destroy_executor_resources(IOTHUB_CLIENT_CALLBACK_EXECUTOR* executor)
+{
+    if (executor->readyClients != NULL)
+    {
+        if (singlylinkedlist_get_head_item(executor->readyClients) != NULL)
+        {
+            LogError("callback executor destroyed while a client is still attached");
+        }
+        singlylinkedlist_destroy(executor->readyClients);
+    }
+    if (executor->idleCondition != NULL)
+    {
+        Condition_Deinit(executor->idleCondition);
+    }
+    if (executor->workCondition != NULL)
+    {
+        Condition_Deinit(executor->workCondition);
+    }
+    if (executor->lockHandle != NULL)
+    {
+        Lock_Deinit(executor->lockHandle);
+    }
+    free(executor->threadHandles);
+    free(executor);
+}
+
+static void stop_threads(IOTHUB_CLIENT_CALLBACK_EXECUTOR* executor)
+{
+    size_t index;
+
+    if (Lock(executor->lockHandle) != LOCK_OK)
+    {
+        LogError("unable to Lock - will still proceed to try to end the threads without locking");
+        executor->stopThreads = 1;
+    }
+    else
+    {
+        executor->stopThreads = 1;
+        /*a thread that is not waiting rechecks stopThreads before it waits again, so one post per thread wakes them all*/
+        for (index = 0; index < executor->threadCount; index++)
+        {
+            if (Condition_Post(executor->workCondition) != COND_OK)
+            {
+                LogError("Condition_Post failed");
+            }
+        }
+        (void)Unlock(executor->lockHandle);
+    }
+
+    for (index = 0; index < executor->threadCount; index++)
+    {
+        int res;
+        if (ThreadAPI_Join(executor->threadHandles[index], &res) != THREADAPI_OK)
+        {
+            LogError("ThreadAPI_Join failed");
+        }
+    }
+}
+
+IOTHUB_CLIENT_CALLBACK_EXECUTOR_HANDLE IoTHubClientCallbackExecutor_Create(size_t threadCount, bool perClientOrdering)
+{
+    IOTHUB_CLIENT_CALLBACK_EXECUTOR* result;
+
+    if (threadCount == 0)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_001: [ If threadCount is 0, IoTHubClientCallbackExecutor_Create shall return NULL. ]*/
+        LogError("invalid argument threadCount = 0");
+        result = NULL;
+    }
+    else if ((result = (IOTHUB_CLIENT_CALLBACK_EXECUTOR*)malloc(sizeof(IOTHUB_CLIENT_CALLBACK_EXECUTOR))) == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_003: [ If any resource cannot be created, IoTHubClientCallbackExecutor_Create shall free everything it created and return NULL. ]*/
+        LogError("failed allocating the callback executor");
+    }
+    else
+    {
+        memset(result, 0, sizeof(IOTHUB_CLIENT_CALLBACK_EXECUTOR));
+        result->perClientOrdering = perClientOrdering;
+
+        if ((result->threadHandles = (THREAD_HANDLE*)malloc(threadCount * sizeof(THREAD_HANDLE))) == NULL)
+        {
+            LogError("failed allocating %lu thread handles", (unsigned long)threadCount);
+            destroy_executor_resources(result);
+            result = NULL;
+        }
+        else if ((result->lockHandle = Lock_Init()) == NULL)
+        {
+            LogError("failed creating the callback executor lock");
+            destroy_executor_resources(result);
+            result = NULL;
+        }
+        else if (((result->workCondition = Condition_Init()) == NULL) ||
+            ((result->idleCondition = Condition_Init()) == NULL))
+        {
+            LogError("failed creating the callback executor conditions");
+            destroy_executor_resources(result);
+            result = NULL;
+        }
+        else if ((result->readyClients = singlylinkedlist_create()) == NULL)
+        {
+            LogError("failed creating the ready client list");
+            destroy_executor_resources(result);
+            result = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_002: [ IoTHubClientCallbackExecutor_Create shall create a lock, two conditions, a ready client list and threadCount threads. ]*/
+            for (result->threadCount = 0; result->threadCount < threadCount; result->threadCount++)
+            {
+                if (ThreadAPI_Create(&result->threadHandles[result->threadCount], executor_thread, result) != THREADAPI_OK)
+                {
+                    LogError("failed starting callback executor thread %lu", (unsigned long)result->threadCount);
+                    break;
+                }
+            }
+
+            if (result->threadCount != threadCount)
+            {
+                IoTHubClientCallbackExecutor_Destroy(result);
+                result = NULL;
+            }
+        }
+    }
+
+    return result;
+}
+
+void IoTHubClientCallbackExecutor_Destroy(IOTHUB_CLIENT_CALLBACK_EXECUTOR_HANDLE executorHandle)
+{
+    /*Codes_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_004: [ If executorHandle is NULL, IoTHubClientCallbackExecutor_Destroy shall do nothing. ]*/
+    if (executorHandle != NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_005: [ IoTHubClientCallbackExecutor_Destroy shall signal the threads to stop, join them and free all resources. ]*/
+        stop_threads(executorHandle);
+        destroy_executor_resources(executorHandle);
+    }
+}
+
+IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT_HANDLE IoTHubClientCallbackExecutor_AddClient(IOTHUB_CLIENT_CALLBACK_EXECUTOR_HANDLE executorHandle)
+{
+    IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT* result;
+
+    if (executorHandle == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_006: [ If executorHandle is NULL, IoTHubClientCallbackExecutor_AddClient shall return NULL. ]*/
+        LogError("invalid argument executorHandle = NULL");
+        result = NULL;
+    }
+    else if ((result = (IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT*)malloc(sizeof(IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT))) == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_008: [ If allocating fails, IoTHubClientCallbackExecutor_AddClient shall return NULL. ]*/
+        LogError("failed allocating the callback executor client");
+    }
+    else if ((result->tasks = singlylinkedlist_create()) == NULL)
+    {
+        LogError("failed creating the task list");
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_007: [ IoTHubClientCallbackExecutor_AddClient shall create an empty task list for the client. ]*/
+        result->executor = executorHandle;
+        result->readyItem = NULL;
+        result->runningCount = 0;
+        result->removePending = 0;
+    }
+
+    return result;
+}
+
+void IoTHubClientCallbackExecutor_RemoveClient(IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT_HANDLE clientHandle)
+{
+    /*Codes_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_009: [ If clientHandle is NULL, IoTHubClientCallbackExecutor_RemoveClient shall do nothing. ]*/
+    if (clientHandle != NULL)
+    {
+        IOTHUB_CLIENT_CALLBACK_EXECUTOR* executor = clientHandle->executor;
+        LIST_ITEM_HANDLE taskItem;
+
+        if (Lock(executor->lockHandle) != LOCK_OK)
+        {
+            LogError("failed locking the callback executor, the client is not removed");
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_010: [ IoTHubClientCallbackExecutor_RemoveClient shall stop the threads from starting tasks of the client and wait for its running tasks to return. ]*/
+            clientHandle->removePending = 1;
+            if (clientHandle->readyItem != NULL)
+            {
+                if (singlylinkedlist_remove(executor->readyClients, clientHandle->readyItem) != 0)
+                {
+                    LogError("failed removing the client from the ready list");
+                }
+                clientHandle->readyItem = NULL;
+            }
+            while (clientHandle->runningCount != 0)
+            {
+                (void)Condition_Wait(executor->idleCondition, executor->lockHandle, REMOVE_RECHECK_MS);
+            }
+            (void)Unlock(executor->lockHandle);
+
+            /*Codes_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_011: [ IoTHubClientCallbackExecutor_RemoveClient shall run the tasks of the client that did not start yet on the calling thread, in the order they were posted, and free the client. ]*/
+            while ((taskItem = singlylinkedlist_get_head_item(clientHandle->tasks)) != NULL)
+            {
+                EXECUTOR_TASK* task = (EXECUTOR_TASK*)singlylinkedlist_item_get_value(taskItem);
+                (void)singlylinkedlist_remove(clientHandle->tasks, taskItem);
+                task->task(task->context);
+                free(task);
+            }
+
+            singlylinkedlist_destroy(clientHandle->tasks);
+            free(clientHandle);
+        }
+    }
+}
+
+int IoTHubClientCallbackExecutor_Post(IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT_HANDLE clientHandle, IOTHUB_CLIENT_CALLBACK_EXECUTOR_TASK task, void* context)
+{
+    int result;
+    EXECUTOR_TASK* executorTask;
+
+    if ((clientHandle == NULL) || (task == NULL))
+    {
+        /*Codes_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_012: [ If clientHandle or task are NULL, IoTHubClientCallbackExecutor_Post shall fail and return a non-zero value. ]*/
+        LogError("invalid argument (clientHandle=%p, task=%p)", clientHandle, task);
+        result = __FAILURE__;
+    }
+    else if ((executorTask = (EXECUTOR_TASK*)malloc(sizeof(EXECUTOR_TASK))) == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_019: [ If allocating, locking or queuing fails, or the client is being removed, IoTHubClientCallbackExecutor_Post shall fail and return a non-zero value. ]*/
+        LogError("failed allocating the task");
+        result = __FAILURE__;
+    }
+    else if (Lock(clientHandle->executor->lockHandle) != LOCK_OK)
+    {
+        LogError("failed locking the callback executor");
+        free(executorTask);
+        result = __FAILURE__;
+    }
+    else
+    {
+        executorTask->task = task;
+        executorTask->context = context;
+
+        if (clientHandle->removePending != 0)
+        {
+            LogError("the client is being removed");
+            free(executorTask);
+            result = __FAILURE__;
+        }
+        else if (singlylinkedlist_add(clientHandle->tasks, executorTask) == NULL)
+        {
+            LogError("failed queuing the task");
+            free(executorTask);
+            result = __FAILURE__;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_013: [ IoTHubClientCallbackExecutor_Post shall append the task to the client's task list, mark the client as ready and signal the threads. ]*/
+            make_client_ready(clientHandle);
+            result = 0;
+        }
+
+        (void)Unlock(clientHandle->executor->lockHandle);
+    }
+
+    return result;
+}
@@ -19,6 +19,7 @@
 #include "iothub_client_options.h"
 #include "iothub_client_version.h"
 #include "iothub_client_diagnostic.h"
+#include "message_store.h"
 #include <stdint.h>
 
 #ifdef USE_PROV_MODULE
@@ -31,6 +32,17 @@
 
 #define LOG_ERROR_RESULT LogError("result = %s", ENUM_TO_STRING(IOTHUB_CLIENT_RESULT, result));
 #define INDEFINITE_TIME ((time_t)(-1))
+#define DEFAULT_MESSAGE_STORE_MAX_IN_FLIGHT 100
+
+#define DEFAULT_PRIORITY_WEIGHT_HIGH 16
+#define DEFAULT_PRIORITY_WEIGHT_NORMAL 4
+#define DEFAULT_PRIORITY_WEIGHT_LOW 1
+#define MAX_PRIORITY_WEIGHT 65536
+/*consecutive events of a priority are MAX_PRIORITY_WEIGHT / weight apart in send order*/
+#define SEND_ORDER_SCALE ((uint64_t)MAX_PRIORITY_WEIGHT)
+/*transports read what the hub sends only in _DoWork, so it has to be polled while something is expected*/
+#define CONFIRMATION_POLL_INTERVAL_MS 10
+#define RECEIVE_POLL_INTERVAL_MS 100
 
 DEFINE_ENUM_STRINGS(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_RESULT_VALUES);
 DEFINE_ENUM_STRINGS(IOTHUB_CLIENT_CONFIRMATION_RESULT, IOTHUB_CLIENT_CONFIRMATION_RESULT_VALUES);
@@ -59,6 +71,15 @@ typedef struct IOTHUB_MESSAGE_CALLBACK_DATA_TAG
     void* userContextCallback;
 }IOTHUB_MESSAGE_CALLBACK_DATA;
 
+/*confirmation callback of an event that is in the message store and not yet loaded in waitingToSend*/
+typedef struct IOTHUB_STORED_MESSAGE_CALLBACK_TAG
+{
+    uint64_t sequenceNumber;
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK callback;
+    void* context;
+    DLIST_ENTRY entry;
+}IOTHUB_STORED_MESSAGE_CALLBACK;
+
 typedef struct IOTHUB_CLIENT_LL_HANDLE_DATA_TAG
 {
     DLIST_ENTRY waitingToSend;
@@ -72,10 +93,25 @@ typedef struct IOTHUB_CLIENT_LL_HANDLE_DATA_TAG
     IOTHUB_METHOD_CALLBACK_DATA methodCallback;
     IOTHUB_CLIENT_CONNECTION_STATUS_CALLBACK conStatusCallback;
     void* conStatusUserContextCallback;
+    IOTHUB_CLIENT_SEND_QUEUE_LIMITS sendQueueLimits;
+    size_t sendQueueMessageCount; /*messages accepted by SendEventAsync and not yet completed, wherever they are (waitingToSend or the transport)*/
+    size_t sendQueueBytes;
+    bool isSendQueueAboveHighWatermark;
+    IOTHUB_CLIENT_SEND_QUEUE_CALLBACK sendQueueCallback;
+    void* sendQueueUserContextCallback;
+    MESSAGE_STORE_HANDLE messageStore; /*NULL unless the message_store option was set*/
+    size_t messageStoreMaxInFlight;
+    DLIST_ENTRY storedMessageCallbacks; /*IOTHUB_STORED_MESSAGE_CALLBACK items, in sequence number order*/
+    IOTHUB_CLIENT_PRIORITY_WEIGHTS priorityWeights;
+    uint64_t lastSendOrder[IOTHUB_MESSAGE_PRIORITY_HIGH + 1]; /*send order of the last event queued, per priority*/
+    uint64_t maxSendOrder; /*largest send order given so far*/
     time_t lastMessageReceiveTime;
     TICK_COUNTER_HANDLE tickCounter; /*shared tickcounter used to track message timeouts in waitingToSend list*/
     tickcounter_ms_t currentMessageTimeout;
+    tickcounter_ms_t lastMessageTimesOutAfter[IOTHUB_MESSAGE_PRIORITY_HIGH + 1]; /*per priority, no message of that priority in waitingToSend times out after this*/
+    bool isPrioritySortedByTimeout[IOTHUB_MESSAGE_PRIORITY_HIGH + 1]; /*per priority, true when the messages of that priority with a timeout in waitingToSend are in ms_timesOutAfter order*/
     uint64_t current_device_twin_timeout;
+    bool isItemProcessingDeferred; /*true when the transport declined the head of iot_msg_queue in the last DoWork*/
     IOTHUB_CLIENT_DEVICE_TWIN_CALLBACK deviceTwinCallback;
     void* deviceTwinContextCallback;
     IOTHUB_CLIENT_RETRY_POLICY retryPolicy;
@@ -114,6 +150,7 @@ static void setTransportProtocol(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, TRANS
     handleData->IoTHubTransport_DoWork = protocol->IoTHubTransport_DoWork;
     handleData->IoTHubTransport_SetRetryPolicy = protocol->IoTHubTransport_SetRetryPolicy;
     handleData->IoTHubTransport_GetSendStatus = protocol->IoTHubTransport_GetSendStatus;
+    handleData->IoTHubTransport_GetNextWorkDeadline = protocol->IoTHubTransport_GetNextWorkDeadline;
     handleData->IoTHubTransport_ProcessItem = protocol->IoTHubTransport_ProcessItem;
     handleData->IoTHubTransport_Subscribe_DeviceTwin = protocol->IoTHubTransport_Subscribe_DeviceTwin;
     handleData->IoTHubTransport_Unsubscribe_DeviceTwin = protocol->IoTHubTransport_Unsubscribe_DeviceTwin;
@@ -423,9 +460,19 @@ static IOTHUB_CLIENT_LL_HANDLE_DATA* initialize_iothub_client(const IOTHUB_CLIEN
                         }
                         else
                         {
+                            int priority;
                             /*Codes_SRS_IOTHUBCLIENT_LL_02_042: [ By default, messages shall not timeout. ]*/
                             result->currentMessageTimeout = 0;
+                            for (priority = IOTHUB_MESSAGE_PRIORITY_LOW; priority <= IOTHUB_MESSAGE_PRIORITY_HIGH; priority++)
+                            {
+                                result->lastMessageTimesOutAfter[priority] = 0;
+                                result->isPrioritySortedByTimeout[priority] = true;
+                            }
                             result->current_device_twin_timeout = 0;
+                            result->isItemProcessingDeferred = false;
+                            result->priorityWeights.high = DEFAULT_PRIORITY_WEIGHT_HIGH;
+                            result->priorityWeights.normal = DEFAULT_PRIORITY_WEIGHT_NORMAL;
+                            result->priorityWeights.low = DEFAULT_PRIORITY_WEIGHT_LOW;
 
                             result->diagnostic_setting.currentMessageNumber = 0;
                             result->diagnostic_setting.diagSamplingPercentage = 0;
@@ -943,6 +990,202 @@ IOTHUB_CLIENT_LL_HANDLE IoTHubClient_LL_CreateWithTransport(const IOTHUB_CLIENT_
     return result;
 }
 
+/*returns true when newMessageCount messages of newBytes bytes in total do not fit in a send queue holding messageCount messages of bytes bytes*/
+static bool is_send_queue_full(const IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, size_t messageCount, size_t bytes, size_t newMessageCount, size_t messageSize)
+{
+    return
+        ((handleData->sendQueueLimits.maxMessageCount != 0) && (messageCount + newMessageCount > handleData->sendQueueLimits.maxMessageCount)) ||
+        ((handleData->sendQueueLimits.maxBytes != 0) && (bytes + messageSize > handleData->sendQueueLimits.maxBytes));
+}
+
+static size_t get_send_queue_threshold(size_t limit, unsigned int percentage)
+{
+    return (size_t)(((uint64_t)limit * percentage) / 100);
+}
+
+/*shall be called every time the send queue grows or shrinks, except from IoTHubClient_LL_Destroy*/
+static void update_send_queue_state(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    const IOTHUB_CLIENT_SEND_QUEUE_LIMITS* limits = &handleData->sendQueueLimits;
+    if (limits->highWatermarkPercentage != 0)
+    {
+        if (!handleData->isSendQueueAboveHighWatermark)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_10_051: [ When the number of messages or bytes in the send queue reaches highWatermarkPercentage of its limit, the send queue callback shall be called with IOTHUB_CLIENT_SEND_QUEUE_HIGH_WATERMARK. ]*/
+            if (((limits->maxMessageCount != 0) && (handleData->sendQueueMessageCount >= get_send_queue_threshold(limits->maxMessageCount, limits->highWatermarkPercentage))) ||
+                ((limits->maxBytes != 0) && (handleData->sendQueueBytes >= get_send_queue_threshold(limits->maxBytes, limits->highWatermarkPercentage))))
+            {
+                handleData->isSendQueueAboveHighWatermark = true;
+                if (handleData->sendQueueCallback != NULL)
+                {
+                    handleData->sendQueueCallback(IOTHUB_CLIENT_SEND_QUEUE_HIGH_WATERMARK, handleData->sendQueueUserContextCallback);
+                }
+            }
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_10_052: [ After the high watermark was reported, when both the number of messages and bytes in the send queue are at or below lowWatermarkPercentage of their limits, the send queue callback shall be called with IOTHUB_CLIENT_SEND_QUEUE_LOW_WATERMARK. ]*/
+            if (((limits->maxMessageCount == 0) || (handleData->sendQueueMessageCount <= get_send_queue_threshold(limits->maxMessageCount, limits->lowWatermarkPercentage))) &&
+                ((limits->maxBytes == 0) || (handleData->sendQueueBytes <= get_send_queue_threshold(limits->maxBytes, limits->lowWatermarkPercentage))))
+            {
+                handleData->isSendQueueAboveHighWatermark = false;
+                if (handleData->sendQueueCallback != NULL)
+                {
+                    handleData->sendQueueCallback(IOTHUB_CLIENT_SEND_QUEUE_LOW_WATERMARK, handleData->sendQueueUserContextCallback);
+                }
+            }
+        }
+    }
+}
+
+static void remove_from_send_queue(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, const IOTHUB_MESSAGE_LIST* message)
+{
+    handleData->sendQueueMessageCount--;
+    handleData->sendQueueBytes -= message->queuedBytes;
+}
+
+/*Codes_SRS_IOTHUBCLIENT_LL_10_061: [ When an event loaded from the message store is confirmed with any result other than IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, it shall be acknowledged in the message store so that it is not sent again. ]*/
+static void acknowledge_stored_message(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, const IOTHUB_MESSAGE_LIST* message)
+{
+    if ((handleData->messageStore != NULL) && message->isStored)
+    {
+        if (message_store_acknowledge(handleData->messageStore, message->storeSequenceNumber) != 0)
+        {
+            LogError("unable to message_store_acknowledge");
+        }
+    }
+}
+
+/*returns 0 and sets messageSize to the size of the body of the message, returns any other value on failure*/
+static int get_message_body_size(IOTHUB_MESSAGE_HANDLE messageHandle, size_t* messageSize)
+{
+    int result;
+    IOTHUBMESSAGE_CONTENT_TYPE contentType = IoTHubMessage_GetContentType(messageHandle);
+    if (contentType == IOTHUBMESSAGE_BYTEARRAY)
+    {
+        const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT* segments;
+        size_t segmentCount;
+        if (IoTHubMessage_GetByteArraySegments(messageHandle, &segments, &segmentCount) != IOTHUB_MESSAGE_OK)
+        {
+            LogError("unable to IoTHubMessage_GetByteArraySegments");
+            result = __FAILURE__;
+        }
+        else
+        {
+            size_t index;
+            *messageSize = 0;
+            for (index = 0; index < segmentCount; index++)
+            {
+                *messageSize += segments[index].size;
+            }
+            result = 0;
+        }
+    }
+    else if (contentType == IOTHUBMESSAGE_STRING)
+    {
+        const char* body = IoTHubMessage_GetString(messageHandle);
+        if (body == NULL)
+        {
+            LogError("unable to IoTHubMessage_GetString");
+            result = __FAILURE__;
+        }
+        else
+        {
+            *messageSize = strlen(body);
+            result = 0;
+        }
+    }
+    else
+    {
+        LogError("unknown message content type");
+        result = __FAILURE__;
+    }
+    return result;
+}
+
+static void free_message_list_entry(IOTHUB_MESSAGE_LIST* message)
+{
+    if (message->batchBlock == NULL)
+    {
+        free(message);
+    }
+    else
+    {
+        /*the entries of a batch share one allocation, freed with the last of them*/
+        message->batchBlock->batchPending--;
+        if (message->batchBlock->batchPending == 0)
+        {
+            free(message->batchBlock);
+        }
+    }
+}
+
+/*drops the oldest messages in waitingToSend (only the ones of the given priority unless anyPriority is true) until newMessageCount messages of messageSize bytes in total fit*/
+/*messageCount and bytes are updated as if the messages were dropped, but nothing is dropped unless dropMessages is true*/
+static void drop_oldest_messages(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, size_t newMessageCount, size_t messageSize, bool anyPriority, IOTHUB_MESSAGE_PRIORITY priority, size_t* messageCount, size_t* bytes, bool dropMessages)
+{
+    PDLIST_ENTRY oldest = handleData->waitingToSend.Flink;
+
+    while (is_send_queue_full(handleData, *messageCount, *bytes, newMessageCount, messageSize) &&
+        (oldest != &(handleData->waitingToSend)))
+    {
+        IOTHUB_MESSAGE_LIST* oldestEntry = containingRecord(oldest, IOTHUB_MESSAGE_LIST, entry);
+        PDLIST_ENTRY next = oldest->Flink; /*need to save the next item, because the below operations are destructive*/
+        if (anyPriority || (oldestEntry->priority == priority))
+        {
+            (*messageCount)--;
+            *bytes -= oldestEntry->queuedBytes;
+            if (dropMessages)
+            {
+                DList_RemoveEntryList(oldest);
+                remove_from_send_queue(handleData, oldestEntry);
+                acknowledge_stored_message(handleData, oldestEntry);
+                if (oldestEntry->callback != NULL)
+                {
+                    oldestEntry->callback(IOTHUB_CLIENT_CONFIRMATION_QUEUE_FULL, oldestEntry->context);
+                }
+                IoTHubMessage_Destroy(oldestEntry->messageHandle);
+                free_message_list_entry(oldestEntry);
+            }
+        }
+        oldest = next;
+    }
+}
+
+/*returns 0 when newMessageCount messages of messageSize bytes in total and the given priority fit in the send queue once messages still in waitingToSend are dropped (if the policy allows it), any other value otherwise*/
+/*nothing is dropped unless dropMessages is true*/
+static int make_room_in_send_queue(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, size_t newMessageCount, size_t messageSize, IOTHUB_MESSAGE_PRIORITY priority, bool dropMessages)
+{
+    int result;
+    size_t messageCount = handleData->sendQueueMessageCount;
+    size_t bytes = handleData->sendQueueBytes;
+
+    if (handleData->sendQueueLimits.policy == IOTHUB_CLIENT_SEND_QUEUE_DROP_OLDEST)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_049: [ If the policy is IOTHUB_CLIENT_SEND_QUEUE_DROP_OLDEST, IoTHubClient_LL_SendEventAsync shall complete the oldest messages in waitingToSend with IOTHUB_CLIENT_CONFIRMATION_QUEUE_FULL until the new message fits, and fail with IOTHUB_CLIENT_QUEUE_FULL if it does not fit even after all of them are dropped. ]*/
+        drop_oldest_messages(handleData, newMessageCount, messageSize, true, priority, &messageCount, &bytes, dropMessages);
+    }
+    else if (handleData->sendQueueLimits.policy == IOTHUB_CLIENT_SEND_QUEUE_DROP_LOWEST_PRIORITY)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_070: [ If the policy is IOTHUB_CLIENT_SEND_QUEUE_DROP_LOWEST_PRIORITY, IoTHubClient_LL_SendEventAsync shall complete the messages in waitingToSend with IOTHUB_CLIENT_CONFIRMATION_QUEUE_FULL, lowest priority first and oldest first within a priority, until the new message fits, never dropping a message of a higher priority than the new one, and fail with IOTHUB_CLIENT_QUEUE_FULL if it does not fit. ]*/
+        int lane;
+        for (lane = IOTHUB_MESSAGE_PRIORITY_LOW; lane <= (int)priority; lane++)
+        {
+            drop_oldest_messages(handleData, newMessageCount, messageSize, false, (IOTHUB_MESSAGE_PRIORITY)lane, &messageCount, &bytes, dropMessages);
+        }
+    }
+
+    if (is_send_queue_full(handleData, messageCount, bytes, newMessageCount, messageSize))
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+
 void IoTHubClient_LL_Destroy(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
 {
     /*Codes_SRS_IOTHUBCLIENT_LL_02_009: [IoTHubClient_LL_Destroy shall do nothing if parameter iotHubClientHandle is NULL.]*/
@@ -961,13 +1204,26 @@ void IoTHubClient_LL_Destroy(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
         while ((unsend = DList_RemoveHeadList(&(handleData->waitingToSend))) != &(handleData->waitingToSend))
         {
             IOTHUB_MESSAGE_LIST* temp = containingRecord(unsend, IOTHUB_MESSAGE_LIST, entry);
+            remove_from_send_queue(handleData, temp);
             /*Codes_SRS_IOTHUBCLIENT_LL_02_033: [Otherwise, IoTHubClient_LL_Destroy shall complete all the event message callbacks that are in the waitingToSend list with the result IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY.] */
             if (temp->callback != NULL)
             {
                 temp->callback(IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, temp->context);
             }
             IoTHubMessage_Destroy(temp->messageHandle);
-            free(temp);
+            free_message_list_entry(temp);
+        }
+
+        if (handleData->messageStore != NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_10_064: [ IoTHubClient_LL_Destroy shall call the confirmation callbacks of the events still only in the message store with IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, leave the events in the store and destroy the store. ]*/
+            while ((unsend = DList_RemoveHeadList(&(handleData->storedMessageCallbacks))) != &(handleData->storedMessageCallbacks))
+            {
+                IOTHUB_STORED_MESSAGE_CALLBACK* temp = containingRecord(unsend, IOTHUB_STORED_MESSAGE_CALLBACK, entry);
+                temp->callback(IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, temp->context);
+                free(temp);
+            }
+            message_store_destroy(handleData->messageStore);
         }
 
         /* Codes_SRS_IOTHUBCLIENT_LL_07_007: [ IoTHubClient_LL_Destroy shall iterate the device twin queues and destroy any remaining items. ] */
@@ -1021,7 +1277,158 @@ static int attach_ms_timesOutAfter(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOT
     return result;
 }
 
-IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventAsync(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+/*a message always goes after the messages of its priority in waitingToSend and transports keep the order of the ones they leave in there, so the messages of a priority stay sorted by timeout as long as messageTimeout does not decrease*/
+static void track_message_timeout_order(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, const IOTHUB_MESSAGE_LIST* newEntry)
+{
+    if (newEntry->ms_timesOutAfter != 0)
+    {
+        if (newEntry->ms_timesOutAfter < handleData->lastMessageTimesOutAfter[newEntry->priority])
+        {
+            handleData->isPrioritySortedByTimeout[newEntry->priority] = false;
+        }
+        else
+        {
+            handleData->lastMessageTimesOutAfter[newEntry->priority] = newEntry->ms_timesOutAfter;
+        }
+    }
+}
+
+/*a priority needs no checking when none of its messages in waitingToSend has a timeout*/
+static void start_timeout_check(const IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, bool* isPriorityChecked)
+{
+    int priority;
+    for (priority = IOTHUB_MESSAGE_PRIORITY_LOW; priority <= IOTHUB_MESSAGE_PRIORITY_HIGH; priority++)
+    {
+        isPriorityChecked[priority] = handleData->isPrioritySortedByTimeout[priority] && (handleData->lastMessageTimesOutAfter[priority] == 0);
+    }
+}
+
+/*returns true when no message of a priority that still needs checking is left in waitingToSend from entry on*/
+/*waitingToSend is in send order and no message of a priority has a send order above lastSendOrder of that priority*/
+static bool is_timeout_check_done(const IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, const bool* isPriorityChecked, const IOTHUB_MESSAGE_LIST* entry)
+{
+    bool result = true;
+    int priority;
+    for (priority = IOTHUB_MESSAGE_PRIORITY_LOW; priority <= IOTHUB_MESSAGE_PRIORITY_HIGH; priority++)
+    {
+        if (!isPriorityChecked[priority] && (entry->sendOrder <= handleData->lastSendOrder[priority]))
+        {
+            result = false;
+            break;
+        }
+    }
+    return result;
+}
+
+static unsigned int get_priority_weight(const IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_PRIORITY priority)
+{
+    unsigned int result;
+    switch (priority)
+    {
+    case IOTHUB_MESSAGE_PRIORITY_HIGH:
+        result = handleData->priorityWeights.high;
+        break;
+    case IOTHUB_MESSAGE_PRIORITY_LOW:
+        result = handleData->priorityWeights.low;
+        break;
+    default:
+        result = handleData->priorityWeights.normal;
+        break;
+    }
+    return result;
+}
+
+/*this is self-clocked fair queuing: an event goes after the previous event of its priority, and no earlier than the event to be sent next, by a step inversely proportional to its weight*/
+/*a batch of messageCount events shares the send order of its first event, and the next event of its priority goes after all of them*/
+static uint64_t get_next_send_order(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_PRIORITY priority, size_t messageCount)
+{
+    uint64_t result;
+    PDLIST_ENTRY first = handleData->waitingToSend.Flink;
+    uint64_t* lastSendOrder = &(handleData->lastSendOrder[priority]);
+    uint64_t virtualTime = (first != &(handleData->waitingToSend)) ? containingRecord(first, IOTHUB_MESSAGE_LIST, entry)->sendOrder : handleData->maxSendOrder;
+    uint64_t step = SEND_ORDER_SCALE / get_priority_weight(handleData, priority);
+
+    result = ((*lastSendOrder > virtualTime) ? *lastSendOrder : virtualTime) + step;
+    *lastSendOrder = result + (step * (messageCount - 1));
+    if (result > handleData->maxSendOrder)
+    {
+        handleData->maxSendOrder = result;
+    }
+    return result;
+}
+
+/*Codes_SRS_IOTHUBCLIENT_LL_10_067: [ Events shall be inserted in waitingToSend so that transports, which send from its head, get events of a higher priority first while each priority gets a share of the events sent proportional to its weight; events of the same priority keep the order they were sent in. ]*/
+/*newEntry->sendOrder comes from get_next_send_order, events of the same send order keep the order they were inserted in*/
+static void insert_in_send_order(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_LIST* newEntry)
+{
+    PDLIST_ENTRY listHead = &(handleData->waitingToSend);
+    PDLIST_ENTRY fromHead = listHead->Flink;
+    PDLIST_ENTRY fromTail = listHead->Blink;
+    PDLIST_ENTRY insertBefore = NULL;
+
+    /*search from both ends: bulk events mostly land near the tail (with a single priority, always at it), urgent ones near the head*/
+    while (insertBefore == NULL)
+    {
+        if ((fromTail == listHead) || (containingRecord(fromTail, IOTHUB_MESSAGE_LIST, entry)->sendOrder <= newEntry->sendOrder))
+        {
+            insertBefore = fromTail->Flink;
+        }
+        else if (containingRecord(fromHead, IOTHUB_MESSAGE_LIST, entry)->sendOrder > newEntry->sendOrder)
+        {
+            insertBefore = fromHead;
+        }
+        else
+        {
+            fromTail = fromTail->Blink;
+            fromHead = fromHead->Flink;
+        }
+    }
+
+    DList_InsertTailList(insertBefore, &(newEntry->entry));
+}
+
+static IOTHUB_CLIENT_RESULT store_event_async(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, IOTHUB_MESSAGE_HANDLE eventMessageHandle, bool takeOwnership, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+    IOTHUB_STORED_MESSAGE_CALLBACK* storedCallback = NULL;
+    MESSAGE_STORE_RESULT storeResult;
+    uint64_t sequenceNumber;
+
+    if ((eventConfirmationCallback != NULL) &&
+        ((storedCallback = (IOTHUB_STORED_MESSAGE_CALLBACK*)malloc(sizeof(IOTHUB_STORED_MESSAGE_CALLBACK))) == NULL))
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LOG_ERROR_RESULT;
+    }
+    else if ((storeResult = message_store_append(handleData->messageStore, eventMessageHandle, &sequenceNumber)) != MESSAGE_STORE_OK)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_058: [ If appending the event to the message store fails, IoTHubClient_LL_SendEventAsync shall return IOTHUB_CLIENT_QUEUE_FULL when the store is full and IOTHUB_CLIENT_ERROR otherwise. ]*/
+        result = (storeResult == MESSAGE_STORE_FULL) ? IOTHUB_CLIENT_QUEUE_FULL : IOTHUB_CLIENT_ERROR;
+        free(storedCallback);
+        LOG_ERROR_RESULT;
+    }
+    else
+    {
+        if (storedCallback != NULL)
+        {
+            storedCallback->sequenceNumber = sequenceNumber;
+            storedCallback->callback = eventConfirmationCallback;
+            storedCallback->context = userContextCallback;
+            DList_InsertTailList(&(handleData->storedMessageCallbacks), &(storedCallback->entry));
+        }
+
+        if (takeOwnership)
+        {
+            /*the event now lives in the store*/
+            IoTHubMessage_Destroy(eventMessageHandle);
+        }
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    return result;
+}
+
+static IOTHUB_CLIENT_RESULT send_event_async(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, bool takeOwnership, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
 {
     IOTHUB_CLIENT_RESULT result;
     /*Codes_SRS_IOTHUBCLIENT_LL_02_011: [IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if parameter iotHubClientHandle or eventMessageHandle is NULL.]*/
@@ -1035,18 +1442,38 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventAsync(IOTHUB_CLIENT_LL_HANDLE iotH
         result = IOTHUB_CLIENT_INVALID_ARG;
         LOG_ERROR_RESULT;
     }
+    else if (iotHubClientHandle->messageStore != NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_057: [ If the message store is set, IoTHubClient_LL_SendEventAsync shall append eventMessageHandle to the store instead of adding it to waitingToSend, keep eventConfirmationCallback and userContextCallback in memory and return IOTHUB_CLIENT_OK; IoTHubClient_LL_SendEventAsyncTakeOwnership shall then destroy eventMessageHandle. ]*/
+        result = store_event_async(iotHubClientHandle, eventMessageHandle, takeOwnership, eventConfirmationCallback, userContextCallback);
+    }
     else
     {
-        IOTHUB_MESSAGE_LIST *newEntry = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST));
-        if (newEntry == NULL)
+        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
+        IOTHUB_MESSAGE_LIST *newEntry;
+        size_t messageSize = 0;
+        IOTHUB_MESSAGE_PRIORITY priority = IoTHubMessage_GetPriority(eventMessageHandle);
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_047: [ If a byte limit is set for the send queue, IoTHubClient_LL_SendEventAsync shall get the size of the body of eventMessageHandle, and fail with IOTHUB_CLIENT_ERROR if that fails. ]*/
+        if ((handleData->sendQueueLimits.maxBytes != 0) &&
+            (get_message_body_size(eventMessageHandle, &messageSize) != 0))
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            LOG_ERROR_RESULT;
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_048: [ If the policy is IOTHUB_CLIENT_SEND_QUEUE_REJECT_NEW and adding the message would exceed maxMessageCount or maxBytes, IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_QUEUE_FULL. ]*/
+        else if (make_room_in_send_queue(handleData, 1, messageSize, priority, false) != 0)
+        {
+            result = IOTHUB_CLIENT_QUEUE_FULL;
+            LogError("send queue is full (%zu messages, %zu bytes)", handleData->sendQueueMessageCount, handleData->sendQueueBytes);
+        }
+        else if ((newEntry = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST))) == NULL)
         {
             result = IOTHUB_CLIENT_ERROR;
             LOG_ERROR_RESULT;
         }
         else
         {
-            IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
-
             if (attach_ms_timesOutAfter(handleData, newEntry) != 0)
             {
                 result = IOTHUB_CLIENT_ERROR;
@@ -1055,8 +1482,18 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventAsync(IOTHUB_CLIENT_LL_HANDLE iotH
             }
             else
             {
-                /*Codes_SRS_IOTHUBCLIENT_LL_02_013: [IoTHubClient_LL_SendEventAsync shall add the DLIST waitingToSend a new record cloning the information from eventMessageHandle, eventConfirmationCallback, userContextCallback.]*/
-                if ((newEntry->messageHandle = IoTHubMessage_Clone(eventMessageHandle)) == NULL)
+                if (takeOwnership)
+                {
+                    /*Codes_SRS_IOTHUBCLIENT_LL_10_045: [ IoTHubClient_LL_SendEventAsyncTakeOwnership shall add eventMessageHandle itself to waitingToSend instead of a clone. ]*/
+                    newEntry->messageHandle = eventMessageHandle;
+                }
+                else
+                {
+                    /*Codes_SRS_IOTHUBCLIENT_LL_02_013: [IoTHubClient_LL_SendEventAsync shall add the DLIST waitingToSend a new record cloning the information from eventMessageHandle, eventConfirmationCallback, userContextCallback.]*/
+                    newEntry->messageHandle = IoTHubMessage_Clone(eventMessageHandle);
+                }
+
+                if (newEntry->messageHandle == NULL)
                 {
                     result = IOTHUB_CLIENT_ERROR;
                     free(newEntry);
@@ -1066,7 +1503,10 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventAsync(IOTHUB_CLIENT_LL_HANDLE iotH
                 {
                     /*Codes_SRS_IOTHUBCLIENT_LL_02_014: [If cloning and/or adding the information/diagnostic fails for any reason, IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_ERROR.] */
                     result = IOTHUB_CLIENT_ERROR;
-                    IoTHubMessage_Destroy(newEntry->messageHandle);
+                    if (!takeOwnership)
+                    {
+                        IoTHubMessage_Destroy(newEntry->messageHandle);
+                    }
                     free(newEntry);
                     LOG_ERROR_RESULT;
                 }
@@ -1075,7 +1515,19 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventAsync(IOTHUB_CLIENT_LL_HANDLE iotH
                     /*Codes_SRS_IOTHUBCLIENT_LL_02_013: [IoTHubClient_LL_SendEventAsync shall add the DLIST waitingToSend a new record cloning the information from eventMessageHandle, eventConfirmationCallback, userContextCallback.]*/
                     newEntry->callback = eventConfirmationCallback;
                     newEntry->context = userContextCallback;
-                    DList_InsertTailList(&(iotHubClientHandle->waitingToSend), &(newEntry->entry));
+                    newEntry->queuedBytes = messageSize;
+                    newEntry->isStored = false;
+                    newEntry->priority = priority;
+                    newEntry->batchBlock = NULL;
+                    /*the room was checked above, this only drops messages if the policy asks for it*/
+                    (void)make_room_in_send_queue(handleData, 1, messageSize, priority, true);
+                    newEntry->sendOrder = get_next_send_order(handleData, priority, 1);
+                    track_message_timeout_order(handleData, newEntry);
+                    insert_in_send_order(handleData, newEntry);
+                    /*Codes_SRS_IOTHUBCLIENT_LL_10_050: [ The send queue shall count every message accepted by IoTHubClient_LL_SendEventAsync until its confirmation callback is called, including messages already handed to the transport. ]*/
+                    handleData->sendQueueMessageCount++;
+                    handleData->sendQueueBytes += messageSize;
+                    update_send_queue_state(handleData);
                     /*Codes_SRS_IOTHUBCLIENT_LL_02_015: [Otherwise IoTHubClient_LL_SendEventAsync shall succeed and return IOTHUB_CLIENT_OK.] */
                     result = IOTHUB_CLIENT_OK;
                 }
@@ -1085,6 +1537,181 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventAsync(IOTHUB_CLIENT_LL_HANDLE iotH
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventAsync(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    return send_event_async(iotHubClientHandle, eventMessageHandle, false, eventConfirmationCallback, userContextCallback);
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventAsyncTakeOwnership(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_MESSAGE_HANDLE eventMessageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_046: [ If IoTHubClient_LL_SendEventAsyncTakeOwnership fails, eventMessageHandle shall still be owned by the caller. ]*/
+    return send_event_async(iotHubClientHandle, eventMessageHandle, true, eventConfirmationCallback, userContextCallback);
+}
+
+static bool has_null_message(const IOTHUB_MESSAGE_HANDLE* eventMessageHandles, size_t messageCount)
+{
+    size_t index;
+    for (index = 0; (index < messageCount) && (eventMessageHandles[index] != NULL); index++)
+    {
+    }
+    return (index < messageCount);
+}
+
+static IOTHUB_CLIENT_RESULT send_event_batch_async(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, const IOTHUB_MESSAGE_HANDLE* eventMessageHandles, size_t messageCount, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+    IOTHUB_MESSAGE_LIST* batch;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_073: [ IoTHubClient_LL_SendEventBatchAsync shall allocate the entries of all the messages in one block, and fail with IOTHUB_CLIENT_ERROR if that fails. ]*/
+    if ((messageCount > SIZE_MAX / sizeof(IOTHUB_MESSAGE_LIST)) ||
+        ((batch = (IOTHUB_MESSAGE_LIST*)malloc(messageCount * sizeof(IOTHUB_MESSAGE_LIST))) == NULL))
+    {
+        result = IOTHUB_CLIENT_ERROR;
+        LOG_ERROR_RESULT;
+    }
+    else
+    {
+        IOTHUB_MESSAGE_PRIORITY priority = IOTHUB_MESSAGE_PRIORITY_LOW;
+        size_t batchSize = 0;
+        size_t index = 0;
+
+        result = IOTHUB_CLIENT_OK;
+        while ((index < messageCount) && (result == IOTHUB_CLIENT_OK))
+        {
+            IOTHUB_MESSAGE_PRIORITY messagePriority = IoTHubMessage_GetPriority(eventMessageHandles[index]);
+            if (messagePriority > priority)
+            {
+                priority = messagePriority;
+            }
+
+            batch[index].queuedBytes = 0;
+            /*Codes_SRS_IOTHUBCLIENT_LL_10_074: [ If a byte limit is set for the send queue, IoTHubClient_LL_SendEventBatchAsync shall get the size of the body of every message, and fail with IOTHUB_CLIENT_ERROR if that fails. ]*/
+            if ((handleData->sendQueueLimits.maxBytes != 0) &&
+                (get_message_body_size(eventMessageHandles[index], &batch[index].queuedBytes) != 0))
+            {
+                result = IOTHUB_CLIENT_ERROR;
+                LOG_ERROR_RESULT;
+            }
+            else
+            {
+                batchSize += batch[index].queuedBytes;
+                index++;
+            }
+        }
+
+        if (result != IOTHUB_CLIENT_OK)
+        {
+            free(batch);
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_075: [ IoTHubClient_LL_SendEventBatchAsync shall apply the send queue limits and policy to all the messages at once, and fail with IOTHUB_CLIENT_QUEUE_FULL if they do not all fit. ]*/
+        else if (make_room_in_send_queue(handleData, messageCount, batchSize, priority, false) != 0)
+        {
+            result = IOTHUB_CLIENT_QUEUE_FULL;
+            free(batch);
+            LogError("send queue is full (%zu messages, %zu bytes)", handleData->sendQueueMessageCount, handleData->sendQueueBytes);
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_076: [ IoTHubClient_LL_SendEventBatchAsync shall read the tick counter once for all the messages. ]*/
+        else if (attach_ms_timesOutAfter(handleData, &batch[0]) != 0)
+        {
+            result = IOTHUB_CLIENT_ERROR;
+            free(batch);
+            LOG_ERROR_RESULT;
+        }
+        else
+        {
+            index = 0;
+            while ((index < messageCount) && (result == IOTHUB_CLIENT_OK))
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_10_077: [ IoTHubClient_LL_SendEventBatchAsync shall clone every message and add the diagnostic information to it, and if any of that fails, destroy the clones made so far and fail with IOTHUB_CLIENT_ERROR. ]*/
+                if ((batch[index].messageHandle = IoTHubMessage_Clone(eventMessageHandles[index])) == NULL)
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    LOG_ERROR_RESULT;
+                }
+                else if (IoTHubClient_Diagnostic_AddIfNecessary(&handleData->diagnostic_setting, batch[index].messageHandle) != 0)
+                {
+                    result = IOTHUB_CLIENT_ERROR;
+                    IoTHubMessage_Destroy(batch[index].messageHandle);
+                    LOG_ERROR_RESULT;
+                }
+                else
+                {
+                    index++;
+                }
+            }
+
+            if (result != IOTHUB_CLIENT_OK)
+            {
+                while (index > 0)
+                {
+                    index--;
+                    IoTHubMessage_Destroy(batch[index].messageHandle);
+                }
+                free(batch);
+            }
+            else
+            {
+                uint64_t sendOrder;
+
+                /*the room was checked above, this only drops messages if the policy asks for it*/
+                (void)make_room_in_send_queue(handleData, messageCount, batchSize, priority, true);
+                sendOrder = get_next_send_order(handleData, priority, messageCount);
+                batch[0].batchPending = messageCount;
+                /*Codes_SRS_IOTHUBCLIENT_LL_10_078: [ IoTHubClient_LL_SendEventBatchAsync shall add the messages to waitingToSend next to each other and in the order of eventMessageHandles, as one event of the highest priority of the messages, each with eventConfirmationCallback and userContextCallback, and return IOTHUB_CLIENT_OK. ]*/
+                for (index = 0; index < messageCount; index++)
+                {
+                    batch[index].callback = eventConfirmationCallback;
+                    batch[index].context = userContextCallback;
+                    batch[index].ms_timesOutAfter = batch[0].ms_timesOutAfter;
+                    batch[index].isStored = false;
+                    batch[index].priority = priority;
+                    batch[index].sendOrder = sendOrder;
+                    batch[index].batchBlock = batch;
+                    track_message_timeout_order(handleData, &batch[index]);
+                    insert_in_send_order(handleData, &batch[index]);
+                }
+                handleData->sendQueueMessageCount += messageCount;
+                handleData->sendQueueBytes += batchSize;
+                update_send_queue_state(handleData);
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+    }
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendEventBatchAsync(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, const IOTHUB_MESSAGE_HANDLE* eventMessageHandles, size_t messageCount, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_071: [ IoTHubClient_LL_SendEventBatchAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if iotHubClientHandle or eventMessageHandles is NULL, messageCount is 0, any of the messages is NULL, or eventConfirmationCallback is NULL and userContextCallback is not NULL. ]*/
+    if (
+        (iotHubClientHandle == NULL) ||
+        (eventMessageHandles == NULL) ||
+        (messageCount == 0) ||
+        has_null_message(eventMessageHandles, messageCount) ||
+        ((eventConfirmationCallback == NULL) && (userContextCallback != NULL))
+        )
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LOG_ERROR_RESULT;
+    }
+    else if (iotHubClientHandle->messageStore != NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_072: [ If the message store is set, IoTHubClient_LL_SendEventBatchAsync shall append the messages to the store in order, as IoTHubClient_LL_SendEventAsync does, and stop at the first one that fails and return its result; the messages before it stay queued. ]*/
+        size_t index;
+        result = IOTHUB_CLIENT_OK;
+        for (index = 0; (index < messageCount) && (result == IOTHUB_CLIENT_OK); index++)
+        {
+            result = store_event_async(iotHubClientHandle, eventMessageHandles[index], false, eventConfirmationCallback, userContextCallback);
+        }
+    }
+    else
+    {
+        result = send_event_batch_async((IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle, eventMessageHandles, messageCount, eventConfirmationCallback, userContextCallback);
+    }
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetMessageCallback(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_MESSAGE_CALLBACK_ASYNC messageCallback, void* userContextCallback)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1254,8 +1881,14 @@ static void DoTimeouts(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
     }
     else
     {
+        bool isPriorityChecked[IOTHUB_MESSAGE_PRIORITY_HIGH + 1];
+        bool isSortedByTimeout[IOTHUB_MESSAGE_PRIORITY_HIGH + 1] = { true, true, true };
+        tickcounter_ms_t previousTimesOutAfter[IOTHUB_MESSAGE_PRIORITY_HIGH + 1] = { 0, 0, 0 };
+        int priority;
         DLIST_ENTRY* currentItemInWaitingToSend = handleData->waitingToSend.Flink;
-        while (currentItemInWaitingToSend != &(handleData->waitingToSend)) /*while we are not at the end of the list*/
+        start_timeout_check(handleData, isPriorityChecked);
+        while ((currentItemInWaitingToSend != &(handleData->waitingToSend)) && /*while we are not at the end of the list*/
+            !is_timeout_check_done(handleData, isPriorityChecked, containingRecord(currentItemInWaitingToSend, IOTHUB_MESSAGE_LIST, entry)))
         {
             IOTHUB_MESSAGE_LIST* fullEntry = containingRecord(currentItemInWaitingToSend, IOTHUB_MESSAGE_LIST, entry);
             /*Codes_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
@@ -1263,20 +1896,158 @@ static void DoTimeouts(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
             {
                 PDLIST_ENTRY theNext = currentItemInWaitingToSend->Flink; /*need to save the next item, because the below operations are destructive*/
                 DList_RemoveEntryList(currentItemInWaitingToSend);
+                remove_from_send_queue(handleData, fullEntry);
+                acknowledge_stored_message(handleData, fullEntry);
                 if (fullEntry->callback != NULL)
                 {
                     fullEntry->callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, fullEntry->context);
                 }
                 IoTHubMessage_Destroy(fullEntry->messageHandle); /*because it has been cloned*/
-                free(fullEntry);
+                free_message_list_entry(fullEntry);
                 currentItemInWaitingToSend = theNext;
             }
             else
             {
+                if ((fullEntry->ms_timesOutAfter != 0) && !isPriorityChecked[fullEntry->priority])
+                {
+                    if (handleData->isPrioritySortedByTimeout[fullEntry->priority])
+                    {
+                        /*Codes_SRS_IOTHUBCLIENT_LL_10_043: [ While the messages of a priority in waitingToSend that have a timeout are ordered by their timeout, checking for timed out messages of that priority shall stop at the first one that has not timed out, and checking waitingToSend shall stop once every priority is checked. ]*/
+                        isPriorityChecked[fullEntry->priority] = true;
+                    }
+                    else
+                    {
+                        if (fullEntry->ms_timesOutAfter < previousTimesOutAfter[fullEntry->priority])
+                        {
+                            isSortedByTimeout[fullEntry->priority] = false;
+                        }
+                        previousTimesOutAfter[fullEntry->priority] = fullEntry->ms_timesOutAfter;
+                    }
+                }
                 currentItemInWaitingToSend = currentItemInWaitingToSend->Flink;
             }
         }
+
+        for (priority = IOTHUB_MESSAGE_PRIORITY_LOW; priority <= IOTHUB_MESSAGE_PRIORITY_HIGH; priority++)
+        {
+            if (!handleData->isPrioritySortedByTimeout[priority])
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_10_044: [ If messageTimeout is decreased so that a newer message times out before an older one of the same priority, the next check shall look at every message of that priority in waitingToSend and time out each message whose timeout has passed. ]*/
+                handleData->isPrioritySortedByTimeout[priority] = isSortedByTimeout[priority];
+                if (isSortedByTimeout[priority])
+                {
+                    handleData->lastMessageTimesOutAfter[priority] = previousTimesOutAfter[priority];
+                }
+            }
+        }
+
+        update_send_queue_state(handleData);
+    }
+}
+
+static bool has_room_for_stored_messages(const IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    return
+        (handleData->sendQueueMessageCount < handleData->messageStoreMaxInFlight) &&
+        !is_send_queue_full(handleData, handleData->sendQueueMessageCount, handleData->sendQueueBytes, 1, 0);
+}
+
+/*returns the confirmation callback kept for the stored event sequenceNumber, if any*/
+static void take_stored_message_callback(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, uint64_t sequenceNumber, IOTHUB_MESSAGE_LIST* newEntry)
+{
+    PDLIST_ENTRY oldest;
+
+    newEntry->callback = NULL;
+    newEntry->context = NULL;
+    while ((oldest = handleData->storedMessageCallbacks.Flink) != &(handleData->storedMessageCallbacks))
+    {
+        IOTHUB_STORED_MESSAGE_CALLBACK* storedCallback = containingRecord(oldest, IOTHUB_STORED_MESSAGE_CALLBACK, entry);
+        if (storedCallback->sequenceNumber > sequenceNumber)
+        {
+            break;
+        }
+        else
+        {
+            DList_RemoveEntryList(oldest);
+            if (storedCallback->sequenceNumber == sequenceNumber)
+            {
+                newEntry->callback = storedCallback->callback;
+                newEntry->context = storedCallback->context;
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_10_060: [ If the message store skipped events because they could not be read back, their confirmation callbacks shall be called with IOTHUB_CLIENT_CONFIRMATION_ERROR. ]*/
+                LogError("stored event %lu could not be read back", (unsigned long)storedCallback->sequenceNumber);
+                storedCallback->callback(IOTHUB_CLIENT_CONFIRMATION_ERROR, storedCallback->context);
+            }
+            free(storedCallback);
+        }
+    }
+}
+
+/*Codes_SRS_IOTHUBCLIENT_LL_10_059: [ IoTHubClient_LL_DoWork shall move events from the message store to waitingToSend, in the order they were stored and with the confirmation callback they were sent with, while fewer than maxInFlightMessages events are waiting for a confirmation and the send queue limits are not reached. ]*/
+static void load_stored_messages(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    bool canLoadMore = true;
+
+    while (canLoadMore && has_room_for_stored_messages(handleData))
+    {
+        IOTHUB_MESSAGE_LIST* newEntry;
+        IOTHUB_MESSAGE_HANDLE messageHandle;
+        uint64_t sequenceNumber;
+        MESSAGE_STORE_RESULT storeResult;
+
+        if ((newEntry = (IOTHUB_MESSAGE_LIST*)malloc(sizeof(IOTHUB_MESSAGE_LIST))) == NULL)
+        {
+            LogError("unable to malloc");
+            canLoadMore = false;
+        }
+        else if ((storeResult = message_store_read_next(handleData->messageStore, &messageHandle, &sequenceNumber)) != MESSAGE_STORE_OK)
+        {
+            if (storeResult != MESSAGE_STORE_EMPTY)
+            {
+                LogError("unable to message_store_read_next");
+            }
+            free(newEntry);
+            canLoadMore = false;
+        }
+        else
+        {
+            size_t messageSize = 0;
+
+            if (attach_ms_timesOutAfter(handleData, newEntry) != 0)
+            {
+                LogError("stored event %lu will not time out", (unsigned long)sequenceNumber);
+                newEntry->ms_timesOutAfter = 0;
+            }
+
+            if (IoTHubClient_Diagnostic_AddIfNecessary(&handleData->diagnostic_setting, messageHandle) != 0)
+            {
+                LogError("unable to IoTHubClient_Diagnostic_AddIfNecessary");
+            }
+
+            if ((handleData->sendQueueLimits.maxBytes != 0) &&
+                (get_message_body_size(messageHandle, &messageSize) != 0))
+            {
+                messageSize = 0;
+            }
+
+            newEntry->messageHandle = messageHandle;
+            newEntry->queuedBytes = messageSize;
+            newEntry->isStored = true;
+            newEntry->storeSequenceNumber = sequenceNumber;
+            newEntry->priority = IoTHubMessage_GetPriority(messageHandle);
+            newEntry->batchBlock = NULL;
+            newEntry->sendOrder = get_next_send_order(handleData, newEntry->priority, 1);
+            take_stored_message_callback(handleData, sequenceNumber, newEntry);
+            track_message_timeout_order(handleData, newEntry);
+            insert_in_send_order(handleData, newEntry);
+            handleData->sendQueueMessageCount++;
+            handleData->sendQueueBytes += messageSize;
+        }
     }
+
+    update_send_queue_state(handleData);
 }
 
 void IoTHubClient_LL_DoWork(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
@@ -1287,8 +2058,14 @@ void IoTHubClient_LL_DoWork(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
         IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
         DoTimeouts(handleData);
 
+        if (handleData->messageStore != NULL)
+        {
+            load_stored_messages(handleData);
+        }
+
         /*Codes_SRS_IOTHUBCLIENT_LL_07_008: [ IoTHubClient_LL_DoWork shall iterate the message queue and execute the underlying transports IoTHubTransport_ProcessItem function for each item. ] */
         DLIST_ENTRY* client_item = handleData->iot_msg_queue.Flink;
+        handleData->isItemProcessingDeferred = false;
         while (client_item != &(handleData->iot_msg_queue)) /*while we are not at the end of the list*/
         {
             PDLIST_ENTRY next_item = client_item->Flink;
@@ -1300,6 +2077,7 @@ void IoTHubClient_LL_DoWork(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
             if (process_results == IOTHUB_PROCESS_CONTINUE || process_results == IOTHUB_PROCESS_NOT_CONNECTED)
             {
                 /*Codes_SRS_IOTHUBCLIENT_LL_07_010: [ If 'IoTHubTransport_ProcessItem' returns IOTHUB_PROCESS_CONTINUE or IOTHUB_PROCESS_NOT_CONNECTED IoTHubClient_LL_DoWork shall continue on to call the underlaying layer's _DoWork function. ]*/
+                handleData->isItemProcessingDeferred = true;
                 break;
             }
             else 
@@ -1323,7 +2101,135 @@ void IoTHubClient_LL_DoWork(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
 
         /*Codes_SRS_IOTHUBCLIENT_LL_02_021: [Otherwise, IoTHubClient_LL_DoWork shall invoke the underlaying layer's _DoWork function.]*/
         handleData->IoTHubTransport_DoWork(handleData->transportHandle, iotHubClientHandle);
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_062: [ After the underlying layer's _DoWork, IoTHubClient_LL_DoWork shall flush the message store, committing the events stored and acknowledged since the previous call. ]*/
+        if ((handleData->messageStore != NULL) &&
+            (message_store_flush(handleData->messageStore) != 0))
+        {
+            LogError("unable to message_store_flush");
+        }
+    }
+}
+
+static uint64_t get_ms_to_next_message_timeout(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    uint64_t result = IOTHUB_CLIENT_LL_NO_WORK_DEADLINE;
+
+    if (handleData->currentMessageTimeout != 0)
+    {
+        tickcounter_ms_t nowTick;
+        if (tickcounter_get_current_ms(handleData->tickCounter, &nowTick) != 0)
+        {
+            LogError("unable to get the current ms, assuming timeouts are due");
+            result = 0;
+        }
+        else
+        {
+            bool isPriorityChecked[IOTHUB_MESSAGE_PRIORITY_HIGH + 1];
+            DLIST_ENTRY* currentItemInWaitingToSend = handleData->waitingToSend.Flink;
+            start_timeout_check(handleData, isPriorityChecked);
+            while ((currentItemInWaitingToSend != &(handleData->waitingToSend)) &&
+                !is_timeout_check_done(handleData, isPriorityChecked, containingRecord(currentItemInWaitingToSend, IOTHUB_MESSAGE_LIST, entry)))
+            {
+                IOTHUB_MESSAGE_LIST* fullEntry = containingRecord(currentItemInWaitingToSend, IOTHUB_MESSAGE_LIST, entry);
+                if ((fullEntry->ms_timesOutAfter != 0) && !isPriorityChecked[fullEntry->priority])
+                {
+                    /*DoTimeouts only expires messages strictly older than ms_timesOutAfter*/
+                    uint64_t msToTimeout = (fullEntry->ms_timesOutAfter < nowTick) ? 0 : (uint64_t)(fullEntry->ms_timesOutAfter - nowTick) + 1;
+                    if (msToTimeout < result)
+                    {
+                        result = msToTimeout;
+                    }
+                    /*no later message of this priority times out earlier*/
+                    isPriorityChecked[fullEntry->priority] = handleData->isPrioritySortedByTimeout[fullEntry->priority];
+                }
+                currentItemInWaitingToSend = currentItemInWaitingToSend->Flink;
+            }
+        }
+    }
+
+    return result;
+}
+
+static uint64_t get_ms_to_next_receive_poll(const IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    uint64_t result;
+
+    if (handleData->sendQueueMessageCount != 0)
+    {
+        result = CONFIRMATION_POLL_INTERVAL_MS;
+    }
+    else if ((handleData->messageCallback.type != CALLBACK_TYPE_NONE) ||
+        (handleData->methodCallback.type != CALLBACK_TYPE_NONE) ||
+        (handleData->deviceTwinCallback != NULL))
+    {
+        result = RECEIVE_POLL_INTERVAL_MS;
+    }
+    else
+    {
+        result = IOTHUB_CLIENT_LL_NO_WORK_DEADLINE;
+    }
+
+    return result;
+}
+
+static bool has_stored_messages_to_load(const IOTHUB_CLIENT_LL_HANDLE_DATA* handleData)
+{
+    bool isStoreEmpty;
+    return
+        (handleData->messageStore != NULL) &&
+        has_room_for_stored_messages(handleData) &&
+        (message_store_is_empty(handleData->messageStore, &isStoreEmpty) == 0) &&
+        !isStoreEmpty;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_GetNextWorkDeadline(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, uint64_t* msToNextWork)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_038: [ If iotHubClientHandle or msToNextWork are NULL, IoTHubClient_LL_GetNextWorkDeadline shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if (iotHubClientHandle == NULL || msToNextWork == NULL)
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LOG_ERROR_RESULT;
+    }
+    else
+    {
+        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
+        uint64_t transportMsToNextWork;
+
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_039: [ IoTHubClient_LL_GetNextWorkDeadline shall call the underlying layer's _GetNextWorkDeadline function. ]*/
+        if ((result = handleData->IoTHubTransport_GetNextWorkDeadline(handleData->transportHandle, &transportMsToNextWork)) != IOTHUB_CLIENT_OK)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_10_040: [ If the underlying layer's _GetNextWorkDeadline fails, IoTHubClient_LL_GetNextWorkDeadline shall return its result. ]*/
+            LOG_ERROR_RESULT;
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_041: [ If iot_msg_queue has items the transport has not yet been offered, msToNextWork shall be set to 0. ]*/
+        else if (!DList_IsListEmpty(&(handleData->iot_msg_queue)) && !handleData->isItemProcessingDeferred)
+        {
+            *msToNextWork = 0;
+        }
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_063: [ If the message store has events that were not loaded yet and there is room to load them, msToNextWork shall be set to 0. ]*/
+        else if (has_stored_messages_to_load(handleData))
+        {
+            *msToNextWork = 0;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_10_042: [ Otherwise msToNextWork shall be set to the smaller of the transport deadline and the time until the first message in waitingToSend times out. ]*/
+            uint64_t timeoutMsToNextWork = get_ms_to_next_message_timeout(handleData);
+            uint64_t receiveMsToNextWork = get_ms_to_next_receive_poll(handleData);
+            *msToNextWork = (timeoutMsToNextWork < transportMsToNextWork) ? timeoutMsToNextWork : transportMsToNextWork;
+
+            /*Codes_SRS_IOTHUBCLIENT_LL_10_079: [ msToNextWork shall be no later than 10 ms while events wait for their confirmation, and no later than 100 ms while a message, method or device twin callback is set. ]*/
+            if (receiveMsToNextWork < *msToNextWork)
+            {
+                *msToNextWork = receiveMsToNextWork;
+            }
+        }
     }
+
+    return result;
 }
 
 IOTHUB_CLIENT_RESULT IoTHubClient_LL_GetSendStatus(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_STATUS *iotHubClientStatus)
@@ -1363,18 +2269,25 @@ void IoTHubClient_LL_SendComplete(IOTHUB_CLIENT_LL_HANDLE handle, PDLIST_ENTRY c
     {
         /*Codes_SRS_IOTHUBCLIENT_LL_02_027: [If parameter result is IOTHUB_CLIENT_CONFIRMATION_ERROR then IoTHubClient_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_ERROR and the context set to the context passed originally in the SendEventAsync call.] */
         /*Codes_SRS_IOTHUBCLIENT_LL_02_025: [If parameter result is IOTHUB_CLIENT_CONFIRMATION_OK then IoTHubClient_LL_SendComplete shall call all the non-NULL callbacks with the result parameter set to IOTHUB_CLIENT_CONFIRMATION_OK and the context set to the context passed originally in the SendEventAsync call.]*/
+        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)handle;
         PDLIST_ENTRY oldest;
         while ((oldest = DList_RemoveHeadList(completed)) != completed)
         {
             IOTHUB_MESSAGE_LIST* messageList = (IOTHUB_MESSAGE_LIST*)containingRecord(oldest, IOTHUB_MESSAGE_LIST, entry);
+            remove_from_send_queue(handleData, messageList);
+            if (result != IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY)
+            {
+                acknowledge_stored_message(handleData, messageList);
+            }
             /*Codes_SRS_IOTHUBCLIENT_LL_02_026: [If any callback is NULL then there shall not be a callback call.]*/
             if (messageList->callback != NULL)
             {
                 messageList->callback(result, messageList->context);
             }
             IoTHubMessage_Destroy(messageList->messageHandle);
-            free(messageList);
+            free_message_list_entry(messageList);
         }
+        update_send_queue_state(handleData);
     }
 }
 
@@ -1592,6 +2505,27 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetConnectionStatusCallback(IOTHUB_CLIENT_L
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetSendQueueCallback(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_SEND_QUEUE_CALLBACK sendQueueCallback, void* userContextCallback)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_IOTHUBCLIENT_LL_10_053: [ IoTHubClient_LL_SetSendQueueCallback shall return IOTHUB_CLIENT_INVALID_ARG if called with NULL parameter iotHubClientHandle. ]*/
+    if (iotHubClientHandle == NULL)
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LOG_ERROR_RESULT;
+    }
+    else
+    {
+        IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
+        /*Codes_SRS_IOTHUBCLIENT_LL_10_054: [ IoTHubClient_LL_SetSendQueueCallback shall save sendQueueCallback and userContextCallback and return IOTHUB_CLIENT_OK. ]*/
+        handleData->sendQueueCallback = sendQueueCallback;
+        handleData->sendQueueUserContextCallback = userContextCallback;
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetRetryPolicy(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, IOTHUB_CLIENT_RETRY_POLICY retryPolicy, size_t retryTimeoutLimitInSeconds)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -1749,6 +2683,70 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetOption(IOTHUB_CLIENT_LL_HANDLE iotHubCli
                 result = IOTHUB_CLIENT_OK;
             }
         }
+        else if (strcmp(optionName, OPTION_SEND_QUEUE_LIMITS) == 0)
+        {
+            const IOTHUB_CLIENT_SEND_QUEUE_LIMITS* limits = (const IOTHUB_CLIENT_SEND_QUEUE_LIMITS*)value;
+            if ((limits->highWatermarkPercentage > 100) ||
+                (limits->lowWatermarkPercentage > limits->highWatermarkPercentage) ||
+                ((limits->policy != IOTHUB_CLIENT_SEND_QUEUE_REJECT_NEW) && (limits->policy != IOTHUB_CLIENT_SEND_QUEUE_DROP_OLDEST) && (limits->policy != IOTHUB_CLIENT_SEND_QUEUE_DROP_LOWEST_PRIORITY)))
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_10_055: [ Calling IoTHubClient_LL_SetOption with "send_queue_limits" shall return IOTHUB_CLIENT_ERROR if highWatermarkPercentage is greater than 100, lowWatermarkPercentage is greater than highWatermarkPercentage or policy is not a known value. ]*/
+                LogError("invalid send queue limits: watermarks %u/%u, policy %d", limits->highWatermarkPercentage, limits->lowWatermarkPercentage, (int)limits->policy);
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_10_056: [ Otherwise, "send_queue_limits" shall replace the send queue limits and apply them to all new messages; messages already queued are kept. ]*/
+                handleData->sendQueueLimits = *limits;
+                update_send_queue_state(handleData);
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (strcmp(optionName, OPTION_PRIORITY_WEIGHTS) == 0)
+        {
+            const IOTHUB_CLIENT_PRIORITY_WEIGHTS* weights = (const IOTHUB_CLIENT_PRIORITY_WEIGHTS*)value;
+            if ((weights->high == 0) || (weights->high > MAX_PRIORITY_WEIGHT) ||
+                (weights->normal == 0) || (weights->normal > MAX_PRIORITY_WEIGHT) ||
+                (weights->low == 0) || (weights->low > MAX_PRIORITY_WEIGHT))
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_10_068: [ Calling IoTHubClient_LL_SetOption with "priority_weights" shall return IOTHUB_CLIENT_ERROR if any weight is 0 or greater than 65536. ]*/
+                LogError("invalid priority weights %u/%u/%u", weights->high, weights->normal, weights->low);
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_10_069: [ Otherwise, "priority_weights" shall replace the weights of the message priorities for the events sent afterwards. ]*/
+                handleData->priorityWeights = *weights;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        else if (strcmp(optionName, OPTION_MESSAGE_STORE) == 0)
+        {
+            const IOTHUB_CLIENT_MESSAGE_STORE_CONFIG* storeConfig = (const IOTHUB_CLIENT_MESSAGE_STORE_CONFIG*)value;
+            MESSAGE_STORE_CONFIG config;
+            config.directory = storeConfig->directory;
+            config.max_segment_size = storeConfig->maxSegmentSize;
+            config.max_store_size = storeConfig->maxStoreSize;
+
+            if (handleData->messageStore != NULL)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_10_066: [ Calling IoTHubClient_LL_SetOption with "message_store" when the message store is already set shall return IOTHUB_CLIENT_ERROR. ]*/
+                LogError("the message store is already set");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            /*Codes_SRS_IOTHUBCLIENT_LL_10_065: [ Calling IoTHubClient_LL_SetOption with "message_store" shall open the message store in directory by calling message_store_create, and return IOTHUB_CLIENT_ERROR if that fails. ]*/
+            else if ((handleData->messageStore = message_store_create(&config)) == NULL)
+            {
+                LogError("unable to message_store_create");
+                result = IOTHUB_CLIENT_ERROR;
+            }
+            else
+            {
+                DList_InitializeListHead(&(handleData->storedMessageCallbacks));
+                handleData->messageStoreMaxInFlight = (storeConfig->maxInFlightMessages == 0) ? DEFAULT_MESSAGE_STORE_MAX_IN_FLIGHT : storeConfig->maxInFlightMessages;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
         else
         {
 
@@ -0,0 +1,489 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "iothub_client_reactor.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#define NO_DEADLINE UINT64_MAX
+/*bounds a single Condition_Wait, the loop goes back to sleep if nothing is due*/
+#define MAX_WAIT_MS 60000
+/*RemoveClient rechecks the client state at this interval in case the signal went to another remover*/
+#define REMOVE_RECHECK_MS 100
+/*how long a loop backs off when the tick counter fails*/
+#define TIME_ERROR_RETRY_MS 100
+
+typedef struct REACTOR_LOOP_TAG
+{
+    THREAD_HANDLE threadHandle;
+    LOCK_HANDLE lockHandle;
+    COND_HANDLE workCondition; /*signaled (under lockHandle) when a client is added, woken up or the loop shall stop*/
+    COND_HANDLE idleCondition; /*signaled (under lockHandle) when a client that is being removed returned from doWork*/
+    TICK_COUNTER_HANDLE tickCounter;
+    DLIST_ENTRY clients; /*IOTHUB_CLIENT_REACTOR_CLIENT items in dueTime order, a client is taken out of it while its doWork runs*/
+    size_t clientCount; /*protected by the reactor lock*/
+    int wakePending;
+    sig_atomic_t stopThread;
+} REACTOR_LOOP;
+
+typedef struct IOTHUB_CLIENT_REACTOR_TAG
+{
+    LOCK_HANDLE lockHandle;
+    REACTOR_LOOP* loops;
+    size_t loopCount;
+} IOTHUB_CLIENT_REACTOR;
+
+typedef struct IOTHUB_CLIENT_REACTOR_CLIENT_TAG
+{
+    IOTHUB_CLIENT_REACTOR* reactor;
+    REACTOR_LOOP* loop;
+    DLIST_ENTRY entry;
+    IOTHUB_CLIENT_REACTOR_DO_WORK doWork;
+    void* context;
+    tickcounter_ms_t dueTime;
+    int wakePending;
+    int isRunning;
+    int removePending;
+} IOTHUB_CLIENT_REACTOR_CLIENT;
+
+/*used by unittests only*/
+const size_t IoTHubClientReactor_ThreadTerminationOffset = offsetof(REACTOR_LOOP, stopThread);
+
+/*shall be called with loop->lockHandle taken*/
+static void insert_client(REACTOR_LOOP* loop, IOTHUB_CLIENT_REACTOR_CLIENT* client)
+{
+    PDLIST_ENTRY next = loop->clients.Flink;
+
+    /*clients with the same dueTime run in the order they were queued*/
+    while ((next != &(loop->clients)) &&
+        (containingRecord(next, IOTHUB_CLIENT_REACTOR_CLIENT, entry)->dueTime <= client->dueTime))
+    {
+        next = next->Flink;
+    }
+
+    /*inserting at the tail of the list that starts at next puts the client right before next*/
+    DList_InsertTailList(next, &(client->entry));
+}
+
+/*shall be called with loop->lockHandle taken, returns the number of ms until the next client is due*/
+static uint64_t run_due_clients(REACTOR_LOOP* loop)
+{
+    uint64_t result;
+    tickcounter_ms_t passTime;
+    tickcounter_ms_t now;
+
+    loop->wakePending = 0;
+
+    if (tickcounter_get_current_ms(loop->tickCounter, &passTime) != 0)
+    {
+        LogError("failed getting the current time");
+        result = TIME_ERROR_RETRY_MS;
+    }
+    else
+    {
+        result = NO_DEADLINE;
+        now = passTime;
+
+        /*Codes_SRS_IOTHUBCLIENT_REACTOR_10_016: [ A loop shall keep its clients ordered by deadline and only visit the clients that are due. ]*/
+        while ((loop->stopThread == 0) && (loop->clients.Flink != &(loop->clients)))
+        {
+            IOTHUB_CLIENT_REACTOR_CLIENT* client = containingRecord(loop->clients.Flink, IOTHUB_CLIENT_REACTOR_CLIENT, entry);
+
+            /*Codes_SRS_IOTHUBCLIENT_REACTOR_10_011: [ A loop shall call doWork for a client when it was woken up or when the deadline returned by its previous doWork expired. ]*/
+            if (client->dueTime > passTime)
+            {
+                /*clients that became due while this pass ran are picked up by the next one*/
+                result = (client->dueTime > now) ? client->dueTime - now : 0;
+                break;
+            }
+            else
+            {
+                uint64_t msToNextWork;
+
+                (void)DList_RemoveEntryList(&(client->entry));
+                client->wakePending = 0;
+                client->isRunning = 1;
+
+                /*Codes_SRS_IOTHUBCLIENT_REACTOR_10_012: [ doWork shall be called without holding the loop lock. ]*/
+                (void)Unlock(loop->lockHandle);
+                msToNextWork = client->doWork(client->context);
+                if (Lock(loop->lockHandle) != LOCK_OK)
+                {
+                    LogError("failed locking the reactor loop after doWork");
+                }
+
+                client->isRunning = 0;
+                if (tickcounter_get_current_ms(loop->tickCounter, &now) != 0)
+                {
+                    LogError("failed getting the current time");
+                }
+
+                if (client->removePending != 0)
+                {
+                    /*the client is not queued again, RemoveClient frees it*/
+                    if (Condition_Post(loop->idleCondition) != COND_OK)
+                    {
+                        LogError("Condition_Post failed");
+                    }
+                }
+                else
+                {
+                    /*a client woken up while its doWork was running is due right away, behind the clients already due*/
+                    client->dueTime = (client->wakePending != 0) ? now :
+                        (msToNextWork > NO_DEADLINE - now) ? NO_DEADLINE : now + msToNextWork;
+                    client->wakePending = 0;
+                    insert_client(loop, client);
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+static int reactor_loop_thread(void* threadArgument)
+{
+    REACTOR_LOOP* loop = (REACTOR_LOOP*)threadArgument;
+
+    if (Lock(loop->lockHandle) != LOCK_OK)
+    {
+        LogError("failed locking the reactor loop, the loop will not run");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_REACTOR_10_013: [ The loop shall exit when IoTHubClientReactor_Destroy is called. ]*/
+        while (loop->stopThread == 0)
+        {
+            uint64_t waitMs = run_due_clients(loop);
+
+            /*Codes_SRS_IOTHUBCLIENT_REACTOR_10_014: [ When no client is due the loop shall wait on its condition until the earliest client deadline, a wake up or a stop request. ]*/
+            if ((loop->stopThread == 0) && (loop->wakePending == 0) && (waitMs != 0))
+            {
+                /*COND_TIMEOUT is the idle case, the loop rechecks the deadlines either way*/
+                (void)Condition_Wait(loop->workCondition, loop->lockHandle, (waitMs > MAX_WAIT_MS) ? MAX_WAIT_MS : (int)waitMs);
+            }
+        }
+
+        (void)Unlock(loop->lockHandle);
+    }
+
+    ThreadAPI_Exit(0);
+    return 0;
+}
+
+/*shall be called with loop->lockHandle taken*/
+static void signal_loop(REACTOR_LOOP* loop)
+{
+    loop->wakePending = 1;
+    if (Condition_Post(loop->workCondition) != COND_OK)
+    {
+        LogError("Condition_Post failed");
+    }
+}
+
+static void destroy_loop_resources(REACTOR_LOOP* loop)
+{
+    PDLIST_ENTRY clientEntry;
+
+    while ((clientEntry = DList_RemoveHeadList(&(loop->clients))) != &(loop->clients))
+    {
+        LogError("reactor destroyed while a client is still attached");
+        free(containingRecord(clientEntry, IOTHUB_CLIENT_REACTOR_CLIENT, entry));
+    }
+    if (loop->tickCounter != NULL)
+    {
+        tickcounter_destroy(loop->tickCounter);
+    }
+    if (loop->idleCondition != NULL)
+    {
+        Condition_Deinit(loop->idleCondition);
+    }
+    if (loop->workCondition != NULL)
+    {
+        Condition_Deinit(loop->workCondition);
+    }
+    if (loop->lockHandle != NULL)
+    {
+        Lock_Deinit(loop->lockHandle);
+    }
+}
+
+static int start_loop(REACTOR_LOOP* loop)
+{
+    int result;
+
+    memset(loop, 0, sizeof(REACTOR_LOOP));
+    DList_InitializeListHead(&(loop->clients));
+
+    if ((loop->lockHandle = Lock_Init()) == NULL)
+    {
+        LogError("failed creating the loop lock");
+        result = __FAILURE__;
+    }
+    else if (((loop->workCondition = Condition_Init()) == NULL) ||
+        ((loop->idleCondition = Condition_Init()) == NULL))
+    {
+        LogError("failed creating the loop conditions");
+        destroy_loop_resources(loop);
+        result = __FAILURE__;
+    }
+    else if ((loop->tickCounter = tickcounter_create()) == NULL)
+    {
+        LogError("failed creating the loop tick counter");
+        destroy_loop_resources(loop);
+        result = __FAILURE__;
+    }
+    else if (ThreadAPI_Create(&loop->threadHandle, reactor_loop_thread, loop) != THREADAPI_OK)
+    {
+        LogError("ThreadAPI_Create failed");
+        loop->threadHandle = NULL;
+        destroy_loop_resources(loop);
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+static void stop_loop(REACTOR_LOOP* loop)
+{
+    int res;
+
+    if (Lock(loop->lockHandle) != LOCK_OK)
+    {
+        LogError("unable to Lock - will still proceed to try to end the thread without locking");
+        loop->stopThread = 1;
+    }
+    else
+    {
+        loop->stopThread = 1;
+        signal_loop(loop);
+        (void)Unlock(loop->lockHandle);
+    }
+
+    if (ThreadAPI_Join(loop->threadHandle, &res) != THREADAPI_OK)
+    {
+        LogError("ThreadAPI_Join failed");
+    }
+
+    destroy_loop_resources(loop);
+}
+
+IOTHUB_CLIENT_REACTOR_HANDLE IoTHubClientReactor_Create(size_t loopCount)
+{
+    IOTHUB_CLIENT_REACTOR* result;
+
+    if (loopCount == 0)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_REACTOR_10_001: [ If loopCount is 0, IoTHubClientReactor_Create shall return NULL. ]*/
+        LogError("invalid argument loopCount = 0");
+        result = NULL;
+    }
+    else if ((result = (IOTHUB_CLIENT_REACTOR*)malloc(sizeof(IOTHUB_CLIENT_REACTOR))) == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_REACTOR_10_003: [ If any resource cannot be created, IoTHubClientReactor_Create shall free everything it created and return NULL. ]*/
+        LogError("failed allocating the reactor");
+    }
+    else if ((result->loops = (REACTOR_LOOP*)malloc(loopCount * sizeof(REACTOR_LOOP))) == NULL)
+    {
+        LogError("failed allocating %lu reactor loops", (unsigned long)loopCount);
+        free(result);
+        result = NULL;
+    }
+    else if ((result->lockHandle = Lock_Init()) == NULL)
+    {
+        LogError("failed creating the reactor lock");
+        free(result->loops);
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_REACTOR_10_002: [ IoTHubClientReactor_Create shall create loopCount loops, each with its own lock, condition, client list and worker thread. ]*/
+        for (result->loopCount = 0; result->loopCount < loopCount; result->loopCount++)
+        {
+            if (start_loop(&result->loops[result->loopCount]) != 0)
+            {
+                LogError("failed starting reactor loop %lu", (unsigned long)result->loopCount);
+                break;
+            }
+        }
+
+        if (result->loopCount != loopCount)
+        {
+            IoTHubClientReactor_Destroy(result);
+            result = NULL;
+        }
+    }
+
+    return result;
+}
+
+void IoTHubClientReactor_Destroy(IOTHUB_CLIENT_REACTOR_HANDLE reactorHandle)
+{
+    /*Codes_SRS_IOTHUBCLIENT_REACTOR_10_004: [ If reactorHandle is NULL, IoTHubClientReactor_Destroy shall do nothing. ]*/
+    if (reactorHandle != NULL)
+    {
+        size_t index;
+
+        /*Codes_SRS_IOTHUBCLIENT_REACTOR_10_005: [ IoTHubClientReactor_Destroy shall signal every loop to stop, join its thread and free all resources. ]*/
+        for (index = 0; index < reactorHandle->loopCount; index++)
+        {
+            stop_loop(&reactorHandle->loops[index]);
+        }
+
+        Lock_Deinit(reactorHandle->lockHandle);
+        free(reactorHandle->loops);
+        free(reactorHandle);
+    }
+}
+
+IOTHUB_CLIENT_REACTOR_CLIENT_HANDLE IoTHubClientReactor_AddClient(IOTHUB_CLIENT_REACTOR_HANDLE reactorHandle, IOTHUB_CLIENT_REACTOR_DO_WORK doWork, void* context)
+{
+    IOTHUB_CLIENT_REACTOR_CLIENT* result;
+
+    if ((reactorHandle == NULL) || (doWork == NULL))
+    {
+        /*Codes_SRS_IOTHUBCLIENT_REACTOR_10_006: [ If reactorHandle or doWork are NULL, IoTHubClientReactor_AddClient shall return NULL. ]*/
+        LogError("invalid argument (reactorHandle=%p, doWork=%p)", reactorHandle, doWork);
+        result = NULL;
+    }
+    else if ((result = (IOTHUB_CLIENT_REACTOR_CLIENT*)malloc(sizeof(IOTHUB_CLIENT_REACTOR_CLIENT))) == NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_REACTOR_10_008: [ If allocating or locking fails, IoTHubClientReactor_AddClient shall return NULL. ]*/
+        LogError("failed allocating the reactor client");
+    }
+    else if (Lock(reactorHandle->lockHandle) != LOCK_OK)
+    {
+        LogError("failed locking the reactor");
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        size_t index;
+        REACTOR_LOOP* loop = &reactorHandle->loops[0];
+
+        /*Codes_SRS_IOTHUBCLIENT_REACTOR_10_007: [ IoTHubClientReactor_AddClient shall add the client to the loop with the fewest clients and wake that loop up so doWork runs right away. ]*/
+        for (index = 1; index < reactorHandle->loopCount; index++)
+        {
+            if (reactorHandle->loops[index].clientCount < loop->clientCount)
+            {
+                loop = &reactorHandle->loops[index];
+            }
+        }
+
+        result->reactor = reactorHandle;
+        result->loop = loop;
+        result->doWork = doWork;
+        result->context = context;
+        result->dueTime = 0;
+        result->wakePending = 0;
+        result->isRunning = 0;
+        result->removePending = 0;
+
+        if (Lock(loop->lockHandle) != LOCK_OK)
+        {
+            LogError("failed locking the reactor loop");
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            insert_client(loop, result);
+            loop->clientCount++;
+            signal_loop(loop);
+            (void)Unlock(loop->lockHandle);
+        }
+
+        (void)Unlock(reactorHandle->lockHandle);
+    }
+
+    return result;
+}
+
+void IoTHubClientReactor_RemoveClient(IOTHUB_CLIENT_REACTOR_CLIENT_HANDLE clientHandle)
+{
+    /*Codes_SRS_IOTHUBCLIENT_REACTOR_10_009: [ If clientHandle is NULL, IoTHubClientReactor_RemoveClient shall do nothing. ]*/
+    if (clientHandle != NULL)
+    {
+        REACTOR_LOOP* loop = clientHandle->loop;
+
+        if (Lock(loop->lockHandle) != LOCK_OK)
+        {
+            LogError("failed locking the reactor loop, the client is not removed");
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBCLIENT_REACTOR_10_010: [ IoTHubClientReactor_RemoveClient shall wait for a running doWork of the client to return, remove the client from its loop and free it. ]*/
+            clientHandle->removePending = 1;
+            if (clientHandle->isRunning == 0)
+            {
+                (void)DList_RemoveEntryList(&(clientHandle->entry));
+            }
+            else
+            {
+                /*the loop took the client out of its list to run it and does not queue it again*/
+                do
+                {
+                    (void)Condition_Wait(loop->idleCondition, loop->lockHandle, REMOVE_RECHECK_MS);
+                } while (clientHandle->isRunning != 0);
+            }
+            (void)Unlock(loop->lockHandle);
+
+            if (Lock(clientHandle->reactor->lockHandle) != LOCK_OK)
+            {
+                LogError("failed locking the reactor, client count is not updated");
+            }
+            else
+            {
+                loop->clientCount--;
+                (void)Unlock(clientHandle->reactor->lockHandle);
+            }
+
+            free(clientHandle);
+        }
+    }
+}
+
+void IoTHubClientReactor_WakeClient(IOTHUB_CLIENT_REACTOR_CLIENT_HANDLE clientHandle)
+{
+    if (clientHandle == NULL)
+    {
+        LogError("invalid argument clientHandle = NULL");
+    }
+    else if (Lock(clientHandle->loop->lockHandle) != LOCK_OK)
+    {
+        LogError("failed locking the reactor loop");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBCLIENT_REACTOR_10_015: [ IoTHubClientReactor_WakeClient shall mark the client as due and signal its loop. ]*/
+        if (clientHandle->isRunning != 0)
+        {
+            clientHandle->wakePending = 1;
+        }
+        else
+        {
+            (void)DList_RemoveEntryList(&(clientHandle->entry));
+            clientHandle->dueTime = 0;
+            insert_client(clientHandle->loop, clientHandle);
+        }
+        signal_loop(clientHandle->loop);
+        (void)Unlock(clientHandle->loop->lockHandle);
+    }
+}
@@ -2,20 +2,37 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/buffer_.h"
+#include "azure_c_shared_utility/refcount.h"
 
 #include "iothub_message.h"
 
 DEFINE_ENUM_STRINGS(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_RESULT_VALUES);
 DEFINE_ENUM_STRINGS(IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_CONTENT_TYPE_VALUES);
+DEFINE_ENUM_STRINGS(IOTHUB_MESSAGE_PRIORITY, IOTHUB_MESSAGE_PRIORITY_VALUES);
+DEFINE_ENUM_STRINGS(IOTHUB_MESSAGE_DELIVERY, IOTHUB_MESSAGE_DELIVERY_VALUES);
+
+/*reads a reference count with the same atomic operations INC_REF and DEC_REF use*/
+#if defined(REFCOUNT_USE_STD_ATOMIC)
+#define READ_REF(type, var) atomic_load(&(((REFCOUNT_TYPE(type)*)var)->count))
+#elif defined(WIN32)
+#define READ_REF(type, var) InterlockedCompareExchange(&(((REFCOUNT_TYPE(type)*)var)->count), 0, 0)
+#elif defined(__GNUC__)
+#define READ_REF(type, var) __sync_add_and_fetch(&(((REFCOUNT_TYPE(type)*)var)->count), 0)
+#else
+#define READ_REF(type, var) (((REFCOUNT_TYPE(type)*)var)->count)
+#endif
 
 #define LOG_IOTHUB_MESSAGE_ERROR() \
     LogError("(result = %s)", ENUM_TO_STRING(IOTHUB_MESSAGE_RESULT, result));
 
-typedef struct IOTHUB_MESSAGE_HANDLE_DATA_TAG
+/*the body of a message; it is never modified once the message is created, so clones keep sharing it*/
+typedef struct IOTHUB_MESSAGE_BODY_TAG
 {
     IOTHUBMESSAGE_CONTENT_TYPE contentType;
     union
@@ -23,12 +40,40 @@ typedef struct IOTHUB_MESSAGE_HANDLE_DATA_TAG
         BUFFER_HANDLE byteArray;
         STRING_HANDLE string;
     } value;
+    /*set instead of value.byteArray when the body is owned by the application*/
+    IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT* externalSegments;
+    size_t externalSegmentCount;
+    IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT externalByteArray;
+    IOTHUB_MESSAGE_BYTE_ARRAY_RELEASE_CALLBACK releaseCallback;
+    void* releaseCallbackContext;
+}IOTHUB_MESSAGE_BODY;
+
+DEFINE_REFCOUNT_TYPE(IOTHUB_MESSAGE_BODY);
+
+/*the properties of a message, copied when a message sharing them is modified*/
+typedef struct IOTHUB_MESSAGE_CONTENT_TAG
+{
+    IOTHUB_MESSAGE_PRIORITY priority;
+    IOTHUB_MESSAGE_DELIVERY delivery;
     MAP_HANDLE properties;
     char* messageId;
     char* correlationId;
     char* userDefinedContentType;
     char* contentEncoding;
     IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA_HANDLE diagnosticData;
+    /*set once IoTHubMessage_Properties returned the map: the application may change it at any time, so it cannot be shared anymore*/
+    bool isPropertiesMapHandedOut;
+}IOTHUB_MESSAGE_CONTENT;
+
+DEFINE_REFCOUNT_TYPE(IOTHUB_MESSAGE_CONTENT);
+
+/*clones of a message share the same reference counted body for their whole life, and the same reference counted content until one of them modifies it*/
+typedef struct IOTHUB_MESSAGE_HANDLE_DATA_TAG
+{
+    IOTHUB_MESSAGE_BODY* body;
+    IOTHUB_MESSAGE_CONTENT* content;
+    /*describes a body held in value.byteArray for IoTHubMessage_GetByteArraySegments*/
+    IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT bodySegment;
 }IOTHUB_MESSAGE_HANDLE_DATA;
 
 static bool ContainsOnlyUsAscii(const char* asciiValue)
@@ -73,28 +118,201 @@ static void DestroyDiagnosticPropertyData(IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DAT
     free(diagnosticHandle);
 }
 
-static void DestroyMessageData(IOTHUB_MESSAGE_HANDLE_DATA* handleData)
+static void ReleaseExternalSegments(IOTHUB_MESSAGE_BODY* body)
+{
+    size_t index;
+    for (index = 0; index < body->externalSegmentCount; index++)
+    {
+        body->releaseCallback(body->externalSegments[index].buffer, body->externalSegments[index].size, body->releaseCallbackContext);
+    }
+
+    if (body->externalSegments != &body->externalByteArray)
+    {
+        free(body->externalSegments);
+    }
+    body->externalSegments = NULL;
+    body->externalSegmentCount = 0;
+    body->releaseCallback = NULL;
+    body->releaseCallbackContext = NULL;
+}
+
+/*gathers the segments in a new buffer owned by the message*/
+static BUFFER_HANDLE CreateBufferFromSegments(const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT* segments, size_t segmentCount)
+{
+    BUFFER_HANDLE result;
+    if (segmentCount == 1)
+    {
+        result = BUFFER_create(segments[0].buffer, segments[0].size);
+    }
+    else
+    {
+        size_t totalSize = 0;
+        size_t index;
+        for (index = 0; index < segmentCount; index++)
+        {
+            if (segments[index].size > SIZE_MAX - totalSize)
+            {
+                break;
+            }
+            totalSize += segments[index].size;
+        }
+
+        if (index < segmentCount)
+        {
+            LogError("the segments of the message are too large");
+            result = NULL;
+        }
+        else if ((result = BUFFER_new()) == NULL)
+        {
+            LogError("BUFFER_new failed");
+        }
+        else if ((totalSize > 0) && (BUFFER_pre_build(result, totalSize) != 0))
+        {
+            LogError("BUFFER_pre_build failed");
+            BUFFER_delete(result);
+            result = NULL;
+        }
+        else if (totalSize > 0)
+        {
+            unsigned char* destination = BUFFER_u_char(result);
+            for (index = 0; index < segmentCount; index++)
+            {
+                (void)memcpy(destination, segments[index].buffer, segments[index].size);
+                destination += segments[index].size;
+            }
+        }
+    }
+    return result;
+}
+
+static void DestroyMessageBody(IOTHUB_MESSAGE_BODY* body)
 {
-    if (handleData->contentType == IOTHUBMESSAGE_BYTEARRAY)
+    if (body->contentType == IOTHUBMESSAGE_BYTEARRAY)
     {
-        BUFFER_delete(handleData->value.byteArray);
+        if (body->releaseCallback != NULL)
+        {
+            /*Codes_SRS_IOTHUBMESSAGE_10_016: [When the last message referring to an external byte array is destroyed, releaseCallback shall be called with byteArray, size and userContextCallback.]*/
+            /*Codes_SRS_IOTHUBMESSAGE_10_022: [When the last message referring to external segments is destroyed, releaseCallback shall be called once for every segment with the buffer and size of the segment and userContextCallback.]*/
+            ReleaseExternalSegments(body);
+        }
+        else
+        {
+            BUFFER_delete(body->value.byteArray);
+        }
     }
-    else if (handleData->contentType == IOTHUBMESSAGE_STRING)
+    else if (body->contentType == IOTHUBMESSAGE_STRING)
     {
-        STRING_delete(handleData->value.string);
+        STRING_delete(body->value.string);
     }
+    free(body);
+}
 
-    Map_Destroy(handleData->properties);
-    free(handleData->messageId);
-    handleData->messageId = NULL;
-    free(handleData->correlationId);
-    handleData->correlationId = NULL;
-    free(handleData->userDefinedContentType);
-    free(handleData->contentEncoding);
-    DestroyDiagnosticPropertyData(handleData->diagnosticData);
+static void ReleaseMessageBody(IOTHUB_MESSAGE_BODY* body)
+{
+    if (DEC_REF(IOTHUB_MESSAGE_BODY, body) == DEC_RETURN_ZERO)
+    {
+        DestroyMessageBody(body);
+    }
+}
+
+static void DestroyMessageContent(IOTHUB_MESSAGE_CONTENT* content)
+{
+    Map_Destroy(content->properties);
+    free(content->messageId);
+    content->messageId = NULL;
+    free(content->correlationId);
+    content->correlationId = NULL;
+    free(content->userDefinedContentType);
+    free(content->contentEncoding);
+    DestroyDiagnosticPropertyData(content->diagnosticData);
+    free(content);
+}
+
+/*replaces the external segments of the body of a message by a buffer owned by the message*/
+static int FlattenExternalSegments(IOTHUB_MESSAGE_HANDLE_DATA* handleData)
+{
+    int result;
+    IOTHUB_MESSAGE_BODY* body = handleData->body;
+    BUFFER_HANDLE byteArray = CreateBufferFromSegments(body->externalSegments, body->externalSegmentCount);
+    if (byteArray == NULL)
+    {
+        LogError("unable to gather the segments of the message");
+        result = __FAILURE__;
+    }
+    /*a count of 1 cannot change under us: no other handle refers to this body*/
+    else if (READ_REF(IOTHUB_MESSAGE_BODY, body) == 1)
+    {
+        ReleaseExternalSegments(body);
+        body->value.byteArray = byteArray;
+        result = 0;
+    }
+    /*Codes_SRS_IOTHUBMESSAGE_10_023: [If IoTHubMessage_GetByteArray gathers external segments shared with a clone, the message shall get a body of its own and the clone shall keep the segments.]*/
+    else if ((body = REFCOUNT_TYPE_CREATE(IOTHUB_MESSAGE_BODY)) == NULL)
+    {
+        LogError("unable to malloc message body");
+        BUFFER_delete(byteArray);
+        result = __FAILURE__;
+    }
+    else
+    {
+        memset(body, 0, sizeof(IOTHUB_MESSAGE_BODY));
+        body->contentType = IOTHUBMESSAGE_BYTEARRAY;
+        body->value.byteArray = byteArray;
+        ReleaseMessageBody(handleData->body);
+        handleData->body = body;
+        result = 0;
+    }
+    return result;
+}
+
+static void ReleaseMessageContent(IOTHUB_MESSAGE_CONTENT* content)
+{
+    if (DEC_REF(IOTHUB_MESSAGE_CONTENT, content) == DEC_RETURN_ZERO)
+    {
+        DestroyMessageContent(content);
+    }
+}
+
+static void DestroyMessageData(IOTHUB_MESSAGE_HANDLE_DATA* handleData)
+{
+    ReleaseMessageBody(handleData->body);
+    ReleaseMessageContent(handleData->content);
     free(handleData);
 }
 
+static IOTHUB_MESSAGE_HANDLE_DATA* CreateMessageData(IOTHUBMESSAGE_CONTENT_TYPE contentType)
+{
+    IOTHUB_MESSAGE_HANDLE_DATA* result = (IOTHUB_MESSAGE_HANDLE_DATA*)malloc(sizeof(IOTHUB_MESSAGE_HANDLE_DATA));
+    if (result == NULL)
+    {
+        LogError("unable to malloc");
+    }
+    else if ((result->body = REFCOUNT_TYPE_CREATE(IOTHUB_MESSAGE_BODY)) == NULL)
+    {
+        LogError("unable to malloc message body");
+        free(result);
+        result = NULL;
+    }
+    else if ((result->content = REFCOUNT_TYPE_CREATE(IOTHUB_MESSAGE_CONTENT)) == NULL)
+    {
+        LogError("unable to malloc message content");
+        free(result->body);
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        memset(result->body, 0, sizeof(IOTHUB_MESSAGE_BODY));
+        result->body->contentType = contentType;
+        memset(result->content, 0, sizeof(IOTHUB_MESSAGE_CONTENT));
+        /*Codes_SRS_IOTHUBMESSAGE_10_029: [Messages shall be created with the priority IOTHUB_MESSAGE_PRIORITY_NORMAL.]*/
+        result->content->priority = IOTHUB_MESSAGE_PRIORITY_NORMAL;
+        /*Codes_SRS_IOTHUBMESSAGE_10_034: [Messages shall be created with the delivery IOTHUB_MESSAGE_DELIVERY_DEFAULT.]*/
+        result->content->delivery = IOTHUB_MESSAGE_DELIVERY_DEFAULT;
+    }
+    return result;
+}
+
 static IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA_HANDLE CloneDiagnosticPropertyData(const IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA* source)
 {
     IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA_HANDLE result = NULL;
@@ -141,10 +359,11 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromByteArray(const unsigned char* byt
     }
     else
     {
-        result = (IOTHUB_MESSAGE_HANDLE_DATA*)malloc(sizeof(IOTHUB_MESSAGE_HANDLE_DATA));
+        /*Codes_SRS_IOTHUBMESSAGE_02_026: [The type of the new message shall be IOTHUBMESSAGE_BYTEARRAY.] */
+        result = CreateMessageData(IOTHUBMESSAGE_BYTEARRAY);
         if (result == NULL)
         {
-            LogError("unable to malloc");
+            LogError("unable to create message data");
             /*Codes_SRS_IOTHUBMESSAGE_02_024: [If there are any errors then IoTHubMessage_CreateFromByteArray shall return NULL.] */
             /*let it go through*/
         }
@@ -153,10 +372,6 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromByteArray(const unsigned char* byt
             const unsigned char* source;
             unsigned char temp = 0x00;
 
-            memset(result, 0, sizeof(*result));
-            /*Codes_SRS_IOTHUBMESSAGE_02_026: [The type of the new message shall be IOTHUBMESSAGE_BYTEARRAY.] */
-            result->contentType = IOTHUBMESSAGE_BYTEARRAY;
-
             if (size != 0)
             {
                 /*Codes_SRS_IOTHUBMESSAGE_06_002: [If size is NOT zero then byteArray MUST NOT be NULL*/
@@ -180,7 +395,7 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromByteArray(const unsigned char* byt
             if (result != NULL)
             {
                 /*Codes_SRS_IOTHUBMESSAGE_02_022: [IoTHubMessage_CreateFromByteArray shall call BUFFER_create passing byteArray and size as parameters.] */
-                if ((result->value.byteArray = BUFFER_create(source, size)) == NULL)
+                if ((result->body->value.byteArray = BUFFER_create(source, size)) == NULL)
                 {
                     LogError("BUFFER_create failed");
                     /*Codes_SRS_IOTHUBMESSAGE_02_024: [If there are any errors then IoTHubMessage_CreateFromByteArray shall return NULL.] */
@@ -188,7 +403,7 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromByteArray(const unsigned char* byt
                     result = NULL;
                 }
                 /*Codes_SRS_IOTHUBMESSAGE_02_023: [IoTHubMessage_CreateFromByteArray shall call Map_Create to create the message properties.] */
-                else if ((result->properties = Map_Create(ValidateAsciiCharactersFilter)) == NULL)
+                else if ((result->content->properties = Map_Create(ValidateAsciiCharactersFilter)) == NULL)
                 {
                     LogError("Map_Create for properties failed");
                     /*Codes_SRS_IOTHUBMESSAGE_02_024: [If there are any errors then IoTHubMessage_CreateFromByteArray shall return NULL.] */
@@ -202,6 +417,98 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromByteArray(const unsigned char* byt
     return result;
 }
 
+IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromExternalByteArray(const unsigned char* byteArray, size_t size, IOTHUB_MESSAGE_BYTE_ARRAY_RELEASE_CALLBACK releaseCallback, void* userContextCallback)
+{
+    IOTHUB_MESSAGE_HANDLE_DATA* result;
+    /*Codes_SRS_IOTHUBMESSAGE_10_011: [If byteArray or releaseCallback is NULL, IoTHubMessage_CreateFromExternalByteArray shall return NULL.]*/
+    if ((byteArray == NULL) || (releaseCallback == NULL))
+    {
+        LogError("invalid arg byteArray=%p, releaseCallback=%p", byteArray, releaseCallback);
+        result = NULL;
+    }
+    /*Codes_SRS_IOTHUBMESSAGE_10_012: [The type of the new message shall be IOTHUBMESSAGE_BYTEARRAY.]*/
+    else if ((result = CreateMessageData(IOTHUBMESSAGE_BYTEARRAY)) == NULL)
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_10_014: [If there are any errors then IoTHubMessage_CreateFromExternalByteArray shall return NULL and shall not call releaseCallback.]*/
+        LogError("unable to create message data");
+    }
+    /*Codes_SRS_IOTHUBMESSAGE_10_013: [IoTHubMessage_CreateFromExternalByteArray shall call Map_Create to create the message properties and shall keep a reference to byteArray without copying it.]*/
+    else if ((result->content->properties = Map_Create(ValidateAsciiCharactersFilter)) == NULL)
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_10_014: [If there are any errors then IoTHubMessage_CreateFromExternalByteArray shall return NULL and shall not call releaseCallback.]*/
+        LogError("Map_Create failed");
+        DestroyMessageData(result);
+        result = NULL;
+    }
+    else
+    {
+        /*the release callback is only set once nothing can fail anymore, so a failed create leaves the byte array with the caller*/
+        result->body->externalByteArray.buffer = byteArray;
+        result->body->externalByteArray.size = size;
+        result->body->externalSegments = &result->body->externalByteArray;
+        result->body->externalSegmentCount = 1;
+        result->body->releaseCallback = releaseCallback;
+        result->body->releaseCallbackContext = userContextCallback;
+    }
+    return result;
+}
+
+IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromByteArraySegments(const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT* segments, size_t segmentCount, IOTHUB_MESSAGE_BYTE_ARRAY_RELEASE_CALLBACK releaseCallback, void* userContextCallback)
+{
+    IOTHUB_MESSAGE_HANDLE_DATA* result;
+    size_t index = 0;
+
+    if ((segments != NULL) && (segmentCount <= SIZE_MAX / sizeof(IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT)))
+    {
+        while ((index < segmentCount) && (segments[index].buffer != NULL))
+        {
+            index++;
+        }
+    }
+
+    /*Codes_SRS_IOTHUBMESSAGE_10_018: [If segments is NULL, segmentCount is 0, the buffer of any segment is NULL or releaseCallback is NULL, IoTHubMessage_CreateFromByteArraySegments shall return NULL.]*/
+    if ((segments == NULL) || (segmentCount == 0) || (index < segmentCount) || (releaseCallback == NULL))
+    {
+        LogError("invalid arg segments=%p, segmentCount=%lu, releaseCallback=%p", segments, (unsigned long)segmentCount, releaseCallback);
+        result = NULL;
+    }
+    /*Codes_SRS_IOTHUBMESSAGE_10_019: [The type of the new message shall be IOTHUBMESSAGE_BYTEARRAY.]*/
+    else if ((result = CreateMessageData(IOTHUBMESSAGE_BYTEARRAY)) == NULL)
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_10_021: [If there are any errors then IoTHubMessage_CreateFromByteArraySegments shall return NULL and shall not call releaseCallback.]*/
+        LogError("unable to create message data");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_10_020: [IoTHubMessage_CreateFromByteArraySegments shall copy the array of segments, shall keep a reference to the buffers of the segments without copying them and shall call Map_Create to create the message properties.]*/
+        IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT* externalSegments = (IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT*)malloc(segmentCount * sizeof(IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT));
+        if (externalSegments == NULL)
+        {
+            /*Codes_SRS_IOTHUBMESSAGE_10_021: [If there are any errors then IoTHubMessage_CreateFromByteArraySegments shall return NULL and shall not call releaseCallback.]*/
+            LogError("unable to malloc the segments");
+            DestroyMessageData(result);
+            result = NULL;
+        }
+        else if ((result->content->properties = Map_Create(ValidateAsciiCharactersFilter)) == NULL)
+        {
+            /*Codes_SRS_IOTHUBMESSAGE_10_021: [If there are any errors then IoTHubMessage_CreateFromByteArraySegments shall return NULL and shall not call releaseCallback.]*/
+            LogError("Map_Create failed");
+            free(externalSegments);
+            DestroyMessageData(result);
+            result = NULL;
+        }
+        else
+        {
+            (void)memcpy(externalSegments, segments, segmentCount * sizeof(IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT));
+            result->body->externalSegments = externalSegments;
+            result->body->externalSegmentCount = segmentCount;
+            result->body->releaseCallback = releaseCallback;
+            result->body->releaseCallbackContext = userContextCallback;
+        }
+    }
+    return result;
+}
+
 IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromString(const char* source)
 {
     IOTHUB_MESSAGE_HANDLE_DATA* result;
@@ -212,21 +519,18 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromString(const char* source)
     }
     else
     {
-        result = (IOTHUB_MESSAGE_HANDLE_DATA*)malloc(sizeof(IOTHUB_MESSAGE_HANDLE_DATA));
+        /*Codes_SRS_IOTHUBMESSAGE_02_032: [The type of the new message shall be IOTHUBMESSAGE_STRING.] */
+        result = CreateMessageData(IOTHUBMESSAGE_STRING);
         if (result == NULL)
         {
-            LogError("malloc failed");
+            LogError("unable to create message data");
             /*Codes_SRS_IOTHUBMESSAGE_02_029: [If there are any encountered in the execution of IoTHubMessage_CreateFromString then IoTHubMessage_CreateFromString shall return NULL.] */
             /*let it go through*/
         }
         else
         {
-            memset(result, 0, sizeof(*result));
-            /*Codes_SRS_IOTHUBMESSAGE_02_032: [The type of the new message shall be IOTHUBMESSAGE_STRING.] */
-            result->contentType = IOTHUBMESSAGE_STRING;
-            
             /*Codes_SRS_IOTHUBMESSAGE_02_027: [IoTHubMessage_CreateFromString shall call STRING_construct passing source as parameter.] */
-            if ((result->value.string = STRING_construct(source)) == NULL)
+            if ((result->body->value.string = STRING_construct(source)) == NULL)
             {
                 LogError("STRING_construct failed");
                 /*Codes_SRS_IOTHUBMESSAGE_02_029: [If there are any encountered in the execution of IoTHubMessage_CreateFromString then IoTHubMessage_CreateFromString shall return NULL.] */
@@ -234,7 +538,7 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromString(const char* source)
                 result = NULL;
             }
             /*Codes_SRS_IOTHUBMESSAGE_02_028: [IoTHubMessage_CreateFromString shall call Map_Create to create the message properties.] */
-            else if ((result->properties = Map_Create(ValidateAsciiCharactersFilter)) == NULL)
+            else if ((result->content->properties = Map_Create(ValidateAsciiCharactersFilter)) == NULL)
             {
                 LogError("Map_Create for properties failed");
                 /*Codes_SRS_IOTHUBMESSAGE_02_029: [If there are any encountered in the execution of IoTHubMessage_CreateFromString then IoTHubMessage_CreateFromString shall return NULL.] */
@@ -247,6 +551,82 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_CreateFromString(const char* source)
     return result;
 }
 
+static IOTHUB_MESSAGE_CONTENT* CloneMessageContent(const IOTHUB_MESSAGE_CONTENT* source)
+{
+    IOTHUB_MESSAGE_CONTENT* result = REFCOUNT_TYPE_CREATE(IOTHUB_MESSAGE_CONTENT);
+    if (result == NULL)
+    {
+        LogError("unable to malloc message content");
+    }
+    else
+    {
+        memset(result, 0, sizeof(IOTHUB_MESSAGE_CONTENT));
+        result->priority = source->priority;
+        result->delivery = source->delivery;
+
+        if (source->messageId != NULL && mallocAndStrcpy_s(&result->messageId, source->messageId) != 0)
+        {
+            LogError("unable to Copy messageId");
+            DestroyMessageContent(result);
+            result = NULL;
+        }
+        else if (source->correlationId != NULL && mallocAndStrcpy_s(&result->correlationId, source->correlationId) != 0)
+        {
+            LogError("unable to Copy correlationId");
+            DestroyMessageContent(result);
+            result = NULL;
+        }
+        else if (source->userDefinedContentType != NULL && mallocAndStrcpy_s(&result->userDefinedContentType, source->userDefinedContentType) != 0)
+        {
+            LogError("unable to copy contentType");
+            DestroyMessageContent(result);
+            result = NULL;
+        }
+        else if (source->contentEncoding != NULL && mallocAndStrcpy_s(&result->contentEncoding, source->contentEncoding) != 0)
+        {
+            LogError("unable to copy contentEncoding");
+            DestroyMessageContent(result);
+            result = NULL;
+        }
+        else if (source->diagnosticData != NULL && (result->diagnosticData = CloneDiagnosticPropertyData(source->diagnosticData)) == NULL)
+        {
+            LogError("unable to CloneDiagnosticPropertyData");
+            DestroyMessageContent(result);
+            result = NULL;
+        }
+        else if ((result->properties = Map_Clone(source->properties)) == NULL)
+        {
+            LogError("unable to Map_Clone");
+            DestroyMessageContent(result);
+            result = NULL;
+        }
+    }
+    return result;
+}
+
+/*returns the content of the message after making sure no other clone sees the changes made to it*/
+static IOTHUB_MESSAGE_CONTENT* GetWritableContent(IOTHUB_MESSAGE_HANDLE_DATA* handleData)
+{
+    IOTHUB_MESSAGE_CONTENT* result;
+    /*a count of 1 cannot change under us: no other handle refers to this content*/
+    if (READ_REF(IOTHUB_MESSAGE_CONTENT, handleData->content) == 1)
+    {
+        result = handleData->content;
+    }
+    /*Codes_SRS_IOTHUBMESSAGE_10_008: [Before a message that shares its content with a clone is modified, its content shall be copied. Copying the content shall clone the properties map by a call to Map_Clone and shall keep sharing the body.]*/
+    else if ((result = CloneMessageContent(handleData->content)) == NULL)
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_10_009: [If copying the content fails, the function modifying the message shall fail.]*/
+        LogError("unable to copy the shared message content");
+    }
+    else
+    {
+        ReleaseMessageContent(handleData->content);
+        handleData->content = result;
+    }
+    return result;
+}
+
 /*Codes_SRS_IOTHUBMESSAGE_03_001: [IoTHubMessage_Clone shall create a new IoT hub message with data content identical to that of the iotHubMessageHandle parameter.]*/
 IOTHUB_MESSAGE_HANDLE IoTHubMessage_Clone(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
 {
@@ -270,78 +650,32 @@ IOTHUB_MESSAGE_HANDLE IoTHubMessage_Clone(IOTHUB_MESSAGE_HANDLE iotHubMessageHan
         }
         else
         {
-            memset(result, 0, sizeof(*result));
-            result->contentType = source->contentType;
-
-            if (source->messageId != NULL && mallocAndStrcpy_s(&result->messageId, source->messageId) != 0)
-            {
-                LogError("unable to Copy messageId");
-                DestroyMessageData(result);
-                result = NULL;
-            }
-            else if (source->correlationId != NULL && mallocAndStrcpy_s(&result->correlationId, source->correlationId) != 0)
+            if (source->content->isPropertiesMapHandedOut)
             {
-                LogError("unable to Copy correlationId");
-                DestroyMessageData(result);
-                result = NULL;
-            }
-            else if (source->userDefinedContentType != NULL && mallocAndStrcpy_s(&result->userDefinedContentType, source->userDefinedContentType) != 0)
-            {
-                LogError("unable to copy contentType");
-                DestroyMessageData(result);
-                result = NULL;
+                /*Codes_SRS_IOTHUBMESSAGE_10_041: [If the properties map of iotHubMessageHandle was returned by IoTHubMessage_Properties, IoTHubMessage_Clone shall give the new message a copy of the content, and shall fail if copying it fails.]*/
+                result->content = CloneMessageContent(source->content);
             }
-            else if (source->contentEncoding != NULL && mallocAndStrcpy_s(&result->contentEncoding, source->contentEncoding) != 0)
+            else
             {
-                LogError("unable to copy contentEncoding");
-                DestroyMessageData(result);
-                result = NULL;
+                /*Codes_SRS_IOTHUBMESSAGE_10_007: [Otherwise, IoTHubMessage_Clone shall share the content of iotHubMessageHandle with the new message by incrementing its reference count.]*/
+                INC_REF(IOTHUB_MESSAGE_CONTENT, source->content);
+                result->content = source->content;
             }
-            else if (source->diagnosticData != NULL && (result->diagnosticData = CloneDiagnosticPropertyData(source->diagnosticData)) == NULL)
+
+            if (result->content == NULL)
             {
-                LogError("unable to CloneDiagnosticPropertyData");
-                DestroyMessageData(result);
+                /*Codes_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
+                LogError("unable to copy the content of the message");
+                free(result);
                 result = NULL;
             }
-            else if (source->contentType == IOTHUBMESSAGE_BYTEARRAY)
+            else
             {
-                /*Codes_SRS_IOTHUBMESSAGE_02_006: [IoTHubMessage_Clone shall clone to content by a call to BUFFER_clone] */
-                if ((result->value.byteArray = BUFFER_clone(source->value.byteArray)) == NULL)
-                {
-                    /*Codes_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
-                    LogError("unable to BUFFER_clone");
-                    DestroyMessageData(result);
-                    result = NULL;
-                }
-                /*Codes_SRS_IOTHUBMESSAGE_02_005: [IoTHubMessage_Clone shall clone the properties map by using Map_Clone.] */
-                else if ((result->properties = Map_Clone(source->properties)) == NULL)
-                {
-                    /*Codes_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
-                    LogError("unable to Map_Clone");
-                    DestroyMessageData(result);
-                    result = NULL;
-                }
+                /*Codes_SRS_IOTHUBMESSAGE_10_017: [The body of a message shall be shared by all its clones for their whole life, so releaseCallback is only called once the last of them is destroyed.]*/
+                INC_REF(IOTHUB_MESSAGE_BODY, source->body);
+                result->body = source->body;
                 /*Codes_SRS_IOTHUBMESSAGE_03_002: [IoTHubMessage_Clone shall return upon success a non-NULL handle to the newly created IoT hub message.]*/
             }
-            else /*can only be STRING*/
-            {
-                /*Codes_SRS_IOTHUBMESSAGE_02_006: [IoTHubMessage_Clone shall clone the content by a call to BUFFER_clone or STRING_clone] */
-                if ((result->value.string = STRING_clone(source->value.string)) == NULL)
-                {
-                    /*Codes_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
-                    LogError("failed to STRING_clone");
-                    DestroyMessageData(result);
-                    result = NULL;
-                }
-                /*Codes_SRS_IOTHUBMESSAGE_02_005: [IoTHubMessage_Clone shall clone the properties map by using Map_Clone.] */
-                else if ((result->properties = Map_Clone(source->properties)) == NULL)
-                {
-                    /*Codes_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
-                    LogError("unable to Map_Clone");
-                    DestroyMessageData(result);
-                    result = NULL;
-                }
-            }
         }
     }
     return result;
@@ -363,18 +697,82 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_GetByteArray(IOTHUB_MESSAGE_HANDLE iotHubMes
     else
     {
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
-        if (handleData->contentType != IOTHUBMESSAGE_BYTEARRAY)
+        if (handleData->body->contentType != IOTHUBMESSAGE_BYTEARRAY)
         {
             /*Codes_SRS_IOTHUBMESSAGE_02_021: [If iotHubMessageHandle is not a iothubmessage containing BYTEARRAY data, then IoTHubMessage_GetData shall write in *buffer NULL and shall set *size to 0.] */
             result = IOTHUB_MESSAGE_INVALID_ARG;
-            LogError("invalid type of message %s", ENUM_TO_STRING(IOTHUBMESSAGE_CONTENT_TYPE, handleData->contentType));
+            LogError("invalid type of message %s", ENUM_TO_STRING(IOTHUBMESSAGE_CONTENT_TYPE, handleData->body->contentType));
+        }
+        else
+        {
+            IOTHUB_MESSAGE_BODY* body = handleData->body;
+            if (body->externalSegmentCount > 1)
+            {
+                /*Codes_SRS_IOTHUBMESSAGE_10_024: [If the message was created from several external segments, IoTHubMessage_GetByteArray shall gather them once in a buffer owned by the message and shall call releaseCallback for every segment.]*/
+                body = (FlattenExternalSegments(handleData) != 0) ? NULL : handleData->body;
+            }
+
+            if (body == NULL)
+            {
+                LogError("unable to gather the segments of the message");
+                result = IOTHUB_MESSAGE_ERROR;
+            }
+            else if (body->releaseCallback != NULL)
+            {
+                /*Codes_SRS_IOTHUBMESSAGE_10_015: [If the message was created from an external byte array, IoTHubMessage_GetByteArray shall return that byte array and its size.]*/
+                *buffer = body->externalSegments[0].buffer;
+                *size = body->externalSegments[0].size;
+                result = IOTHUB_MESSAGE_OK;
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBMESSAGE_01_011: [The pointer shall be obtained by using BUFFER_u_char and it shall be copied in the buffer argument.]*/
+                *buffer = BUFFER_u_char(body->value.byteArray);
+                /*Codes_SRS_IOTHUBMESSAGE_01_012: [The size of the associated data shall be obtained by using BUFFER_length and it shall be copied to the size argument.]*/
+                *size = BUFFER_length(body->value.byteArray);
+                result = IOTHUB_MESSAGE_OK;
+            }
+        }
+    }
+    return result;
+}
+
+IOTHUB_MESSAGE_RESULT IoTHubMessage_GetByteArraySegments(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT** segments, size_t* segmentCount)
+{
+    IOTHUB_MESSAGE_RESULT result;
+    if (
+        (iotHubMessageHandle == NULL) ||
+        (segments == NULL) ||
+        (segmentCount == NULL)
+        )
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_10_025: [If any of the arguments passed to IoTHubMessage_GetByteArraySegments is NULL IoTHubMessage_GetByteArraySegments shall return IOTHUB_MESSAGE_INVALID_ARG.]*/
+        LogError("invalid parameter (NULL) to IoTHubMessage_GetByteArraySegments IOTHUB_MESSAGE_HANDLE iotHubMessageHandle=%p, const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT** segments=%p, size_t* segmentCount=%p", iotHubMessageHandle, segments, segmentCount);
+        result = IOTHUB_MESSAGE_INVALID_ARG;
+    }
+    else
+    {
+        IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
+        if (handleData->body->contentType != IOTHUBMESSAGE_BYTEARRAY)
+        {
+            /*Codes_SRS_IOTHUBMESSAGE_10_026: [If iotHubMessageHandle is not a iothubmessage containing BYTEARRAY data, IoTHubMessage_GetByteArraySegments shall return IOTHUB_MESSAGE_INVALID_ARG.]*/
+            LogError("invalid type of message %s", ENUM_TO_STRING(IOTHUBMESSAGE_CONTENT_TYPE, handleData->body->contentType));
+            result = IOTHUB_MESSAGE_INVALID_ARG;
+        }
+        else if (handleData->body->releaseCallback != NULL)
+        {
+            /*Codes_SRS_IOTHUBMESSAGE_10_027: [If the body of the message is external, IoTHubMessage_GetByteArraySegments shall return its segments without copying them.]*/
+            *segments = handleData->body->externalSegments;
+            *segmentCount = handleData->body->externalSegmentCount;
+            result = IOTHUB_MESSAGE_OK;
         }
         else
         {
-            /*Codes_SRS_IOTHUBMESSAGE_01_011: [The pointer shall be obtained by using BUFFER_u_char and it shall be copied in the buffer argument.]*/
-            *buffer = BUFFER_u_char(handleData->value.byteArray);
-            /*Codes_SRS_IOTHUBMESSAGE_01_012: [The size of the associated data shall be obtained by using BUFFER_length and it shall be copied to the size argument.]*/
-            *size = BUFFER_length(handleData->value.byteArray);
+            /*Codes_SRS_IOTHUBMESSAGE_10_028: [Otherwise IoTHubMessage_GetByteArraySegments shall return one segment made of BUFFER_u_char and BUFFER_length of the body.]*/
+            handleData->bodySegment.buffer = BUFFER_u_char(handleData->body->value.byteArray);
+            handleData->bodySegment.size = BUFFER_length(handleData->body->value.byteArray);
+            *segments = &handleData->bodySegment;
+            *segmentCount = 1;
             result = IOTHUB_MESSAGE_OK;
         }
     }
@@ -392,7 +790,7 @@ const char* IoTHubMessage_GetString(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
     else
     {
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
-        if (handleData->contentType != IOTHUBMESSAGE_STRING)
+        if (handleData->body->contentType != IOTHUBMESSAGE_STRING)
         {
             /*Codes_SRS_IOTHUBMESSAGE_02_017: [IoTHubMessage_GetString shall return NULL if the iotHubMessageHandle does not refer to a IOTHUBMESSAGE of type STRING.] */
             result = NULL;
@@ -400,7 +798,7 @@ const char* IoTHubMessage_GetString(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
         else
         {
             /*Codes_SRS_IOTHUBMESSAGE_02_018: [IoTHubMessage_GetStringData shall return the currently stored null terminated string.] */
-            result = STRING_c_str(handleData->value.string);
+            result = STRING_c_str(handleData->body->value.string);
         }
     }
     return result;
@@ -418,7 +816,7 @@ IOTHUBMESSAGE_CONTENT_TYPE IoTHubMessage_GetContentType(IOTHUB_MESSAGE_HANDLE io
     {
         /*Codes_SRS_IOTHUBMESSAGE_02_009: [Otherwise IoTHubMessage_GetContentType shall return the type of the message.] */
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
-        result = handleData->contentType;
+        result = handleData->body->contentType;
     }
     return result;
 }
@@ -434,9 +832,38 @@ MAP_HANDLE IoTHubMessage_Properties(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
     }
     else
     {
-        /*Codes_SRS_IOTHUBMESSAGE_02_002: [Otherwise, for any non-NULL iotHubMessageHandle it shall return a non-NULL MAP_HANDLE.]*/
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = (IOTHUB_MESSAGE_HANDLE_DATA*)iotHubMessageHandle;
-        result = handleData->properties;
+        /*the map is handed out for writing, so a message sharing its content gets its own copy first*/
+        IOTHUB_MESSAGE_CONTENT* content = GetWritableContent(handleData);
+        if (content == NULL)
+        {
+            /*Codes_SRS_IOTHUBMESSAGE_10_010: [If the content of iotHubMessageHandle is shared and copying it fails, IoTHubMessage_Properties shall return NULL.]*/
+            LogError("unable to get the properties of the message");
+            result = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBMESSAGE_02_002: [Otherwise, for any non-NULL iotHubMessageHandle it shall return a non-NULL MAP_HANDLE.]*/
+            content->isPropertiesMapHandedOut = true;
+            result = content->properties;
+        }
+    }
+    return result;
+}
+
+MAP_HANDLE IoTHubMessage_GetReadOnlyProperties(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    MAP_HANDLE result;
+    /*Codes_SRS_IOTHUBMESSAGE_10_039: [If iotHubMessageHandle is NULL then IoTHubMessage_GetReadOnlyProperties shall return NULL.]*/
+    if (iotHubMessageHandle == NULL)
+    {
+        LogError("invalid arg (NULL) passed to IoTHubMessage_GetReadOnlyProperties");
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_10_040: [Otherwise IoTHubMessage_GetReadOnlyProperties shall return the properties map of the message without copying it, even when the content of the message is shared.]*/
+        result = iotHubMessageHandle->content->properties;
     }
     return result;
 }
@@ -454,7 +881,7 @@ const char* IoTHubMessage_GetCorrelationId(IOTHUB_MESSAGE_HANDLE iotHubMessageHa
     {
         /* Codes_SRS_IOTHUBMESSAGE_07_017: [IoTHubMessage_GetCorrelationId shall return the correlationId as a const char*.] */
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
-        result = handleData->correlationId;
+        result = handleData->content->correlationId;
     }
     return result;
 }
@@ -471,27 +898,140 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_SetCorrelationId(IOTHUB_MESSAGE_HANDLE iotHu
     else
     {
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
-        /* Codes_SRS_IOTHUBMESSAGE_07_019: [If the IOTHUB_MESSAGE_HANDLE correlationId is not NULL, then the IOTHUB_MESSAGE_HANDLE correlationId will be deallocated.] */
-        if (handleData->correlationId != NULL)
+        IOTHUB_MESSAGE_CONTENT* content;
+        if ((content = GetWritableContent(handleData)) == NULL)
+        {
+            LogError("unable to modify the content of the message");
+            result = IOTHUB_MESSAGE_ERROR;
+        }
+        else
+        {
+            /* Codes_SRS_IOTHUBMESSAGE_07_019: [If the IOTHUB_MESSAGE_HANDLE correlationId is not NULL, then the IOTHUB_MESSAGE_HANDLE correlationId will be deallocated.] */
+            if (content->correlationId != NULL)
+            {
+                free(content->correlationId);
+                content->correlationId = NULL;
+            }
+
+            if (mallocAndStrcpy_s(&content->correlationId, correlationId) != 0)
+            {
+                /* Codes_SRS_IOTHUBMESSAGE_07_020: [If the allocation or the copying of the correlationId fails, then IoTHubMessage_SetCorrelationId shall return IOTHUB_MESSAGE_ERROR.] */
+                result = IOTHUB_MESSAGE_ERROR;
+            }
+            else
+            {
+                /* Codes_SRS_IOTHUBMESSAGE_07_021: [IoTHubMessage_SetCorrelationId finishes successfully it shall return IOTHUB_MESSAGE_OK.] */
+                result = IOTHUB_MESSAGE_OK;
+            }
+        }
+    }
+    return result;
+}
+
+IOTHUB_MESSAGE_RESULT IoTHubMessage_SetPriority(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, IOTHUB_MESSAGE_PRIORITY priority)
+{
+    IOTHUB_MESSAGE_RESULT result;
+    /*Codes_SRS_IOTHUBMESSAGE_10_030: [If iotHubMessageHandle is NULL or priority is not a known value, IoTHubMessage_SetPriority shall return IOTHUB_MESSAGE_INVALID_ARG.]*/
+    if (iotHubMessageHandle == NULL ||
+        (priority != IOTHUB_MESSAGE_PRIORITY_LOW && priority != IOTHUB_MESSAGE_PRIORITY_NORMAL && priority != IOTHUB_MESSAGE_PRIORITY_HIGH))
+    {
+        LogError("invalid arg (iotHubMessageHandle=%p, priority=%d) passed to IoTHubMessage_SetPriority", iotHubMessageHandle, (int)priority);
+        result = IOTHUB_MESSAGE_INVALID_ARG;
+    }
+    else
+    {
+        IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
+        IOTHUB_MESSAGE_CONTENT* content;
+        if (handleData->content->priority == priority)
         {
-            free(handleData->correlationId);
-            handleData->correlationId = NULL;
+            /*nothing changes, no need to unshare the content*/
+            result = IOTHUB_MESSAGE_OK;
+        }
+        else if ((content = GetWritableContent(handleData)) == NULL)
+        {
+            LogError("unable to modify the content of the message");
+            result = IOTHUB_MESSAGE_ERROR;
+        }
+        else
+        {
+            /*Codes_SRS_IOTHUBMESSAGE_10_031: [IoTHubMessage_SetPriority shall save priority and return IOTHUB_MESSAGE_OK.]*/
+            content->priority = priority;
+            result = IOTHUB_MESSAGE_OK;
         }
+    }
+    return result;
+}
 
-        if (mallocAndStrcpy_s(&handleData->correlationId, correlationId) != 0)
+IOTHUB_MESSAGE_PRIORITY IoTHubMessage_GetPriority(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    IOTHUB_MESSAGE_PRIORITY result;
+    /*Codes_SRS_IOTHUBMESSAGE_10_032: [If iotHubMessageHandle is NULL, IoTHubMessage_GetPriority shall return IOTHUB_MESSAGE_PRIORITY_NORMAL.]*/
+    if (iotHubMessageHandle == NULL)
+    {
+        LogError("invalid arg (NULL) passed to IoTHubMessage_GetPriority");
+        result = IOTHUB_MESSAGE_PRIORITY_NORMAL;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_10_033: [IoTHubMessage_GetPriority shall return the priority of the message.]*/
+        IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
+        result = handleData->content->priority;
+    }
+    return result;
+}
+
+IOTHUB_MESSAGE_RESULT IoTHubMessage_SetDelivery(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, IOTHUB_MESSAGE_DELIVERY delivery)
+{
+    IOTHUB_MESSAGE_RESULT result;
+    /*Codes_SRS_IOTHUBMESSAGE_10_035: [If iotHubMessageHandle is NULL or delivery is not a known value, IoTHubMessage_SetDelivery shall return IOTHUB_MESSAGE_INVALID_ARG.]*/
+    if (iotHubMessageHandle == NULL ||
+        (delivery != IOTHUB_MESSAGE_DELIVERY_DEFAULT && delivery != IOTHUB_MESSAGE_DELIVERY_AT_LEAST_ONCE && delivery != IOTHUB_MESSAGE_DELIVERY_AT_MOST_ONCE))
+    {
+        LogError("invalid arg (iotHubMessageHandle=%p, delivery=%d) passed to IoTHubMessage_SetDelivery", iotHubMessageHandle, (int)delivery);
+        result = IOTHUB_MESSAGE_INVALID_ARG;
+    }
+    else
+    {
+        IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
+        IOTHUB_MESSAGE_CONTENT* content;
+        if (handleData->content->delivery == delivery)
+        {
+            /*nothing changes, no need to unshare the content*/
+            result = IOTHUB_MESSAGE_OK;
+        }
+        else if ((content = GetWritableContent(handleData)) == NULL)
         {
-            /* Codes_SRS_IOTHUBMESSAGE_07_020: [If the allocation or the copying of the correlationId fails, then IoTHubMessage_SetCorrelationId shall return IOTHUB_MESSAGE_ERROR.] */
+            LogError("unable to modify the content of the message");
             result = IOTHUB_MESSAGE_ERROR;
         }
         else
         {
-            /* Codes_SRS_IOTHUBMESSAGE_07_021: [IoTHubMessage_SetCorrelationId finishes successfully it shall return IOTHUB_MESSAGE_OK.] */
+            /*Codes_SRS_IOTHUBMESSAGE_10_036: [IoTHubMessage_SetDelivery shall save delivery and return IOTHUB_MESSAGE_OK.]*/
+            content->delivery = delivery;
             result = IOTHUB_MESSAGE_OK;
         }
     }
     return result;
 }
 
+IOTHUB_MESSAGE_DELIVERY IoTHubMessage_GetDelivery(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    IOTHUB_MESSAGE_DELIVERY result;
+    /*Codes_SRS_IOTHUBMESSAGE_10_037: [If iotHubMessageHandle is NULL, IoTHubMessage_GetDelivery shall return IOTHUB_MESSAGE_DELIVERY_DEFAULT.]*/
+    if (iotHubMessageHandle == NULL)
+    {
+        LogError("invalid arg (NULL) passed to IoTHubMessage_GetDelivery");
+        result = IOTHUB_MESSAGE_DELIVERY_DEFAULT;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBMESSAGE_10_038: [IoTHubMessage_GetDelivery shall return the delivery of the message.]*/
+        IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
+        result = handleData->content->delivery;
+    }
+    return result;
+}
+
 IOTHUB_MESSAGE_RESULT IoTHubMessage_SetMessageId(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const char* messageId)
 {
     IOTHUB_MESSAGE_RESULT result;
@@ -504,21 +1044,30 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_SetMessageId(IOTHUB_MESSAGE_HANDLE iotHubMes
     else
     {
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
-        /* Codes_SRS_IOTHUBMESSAGE_07_013: [If the IOTHUB_MESSAGE_HANDLE messageId is not NULL, then the IOTHUB_MESSAGE_HANDLE messageId will be freed] */
-        if (handleData->messageId != NULL)
-        {
-            free(handleData->messageId);
-            handleData->messageId = NULL;
-        }
-
-        /* Codes_SRS_IOTHUBMESSAGE_07_014: [If the allocation or the copying of the messageId fails, then IoTHubMessage_SetMessageId shall return IOTHUB_MESSAGE_ERROR.] */
-        if (mallocAndStrcpy_s(&handleData->messageId, messageId) != 0)
+        IOTHUB_MESSAGE_CONTENT* content;
+        if ((content = GetWritableContent(handleData)) == NULL)
         {
+            LogError("unable to modify the content of the message");
             result = IOTHUB_MESSAGE_ERROR;
         }
         else
         {
-            result = IOTHUB_MESSAGE_OK;
+            /* Codes_SRS_IOTHUBMESSAGE_07_013: [If the IOTHUB_MESSAGE_HANDLE messageId is not NULL, then the IOTHUB_MESSAGE_HANDLE messageId will be freed] */
+            if (content->messageId != NULL)
+            {
+                free(content->messageId);
+                content->messageId = NULL;
+            }
+
+            /* Codes_SRS_IOTHUBMESSAGE_07_014: [If the allocation or the copying of the messageId fails, then IoTHubMessage_SetMessageId shall return IOTHUB_MESSAGE_ERROR.] */
+            if (mallocAndStrcpy_s(&content->messageId, messageId) != 0)
+            {
+                result = IOTHUB_MESSAGE_ERROR;
+            }
+            else
+            {
+                result = IOTHUB_MESSAGE_OK;
+            }
         }
     }
     return result;
@@ -537,7 +1086,7 @@ const char* IoTHubMessage_GetMessageId(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle
     {
         /* Codes_SRS_IOTHUBMESSAGE_07_011: [IoTHubMessage_MessageId shall return the messageId as a const char*.] */
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
-        result = handleData->messageId;
+        result = handleData->content->messageId;
     }
     return result;
 }
@@ -556,23 +1105,32 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_SetContentTypeSystemProperty(IOTHUB_MESSAGE_
     {
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = (IOTHUB_MESSAGE_HANDLE_DATA*)iotHubMessageHandle;
 
-        // Codes_SRS_IOTHUBMESSAGE_09_002: [If the IOTHUB_MESSAGE_HANDLE `contentType` is not NULL it shall be deallocated.] 
-        if (handleData->userDefinedContentType != NULL)
+        IOTHUB_MESSAGE_CONTENT* content;
+        if ((content = GetWritableContent(handleData)) == NULL)
         {
-            free(handleData->userDefinedContentType);
-            handleData->userDefinedContentType = NULL;
-        }
-
-        if (mallocAndStrcpy_s(&handleData->userDefinedContentType, contentType) != 0)
-        {
-            LogError("Failed saving a copy of contentType");
-            // Codes_SRS_IOTHUBMESSAGE_09_003: [If the allocation or the copying of `contentType` fails, then IoTHubMessage_SetContentTypeSystemProperty shall return IOTHUB_MESSAGE_ERROR.] 
+            LogError("unable to modify the content of the message");
             result = IOTHUB_MESSAGE_ERROR;
         }
         else
         {
-            // Codes_SRS_IOTHUBMESSAGE_09_004: [If IoTHubMessage_SetContentTypeSystemProperty finishes successfully it shall return IOTHUB_MESSAGE_OK.]
-            result = IOTHUB_MESSAGE_OK;
+            // Codes_SRS_IOTHUBMESSAGE_09_002: [If the IOTHUB_MESSAGE_HANDLE `contentType` is not NULL it shall be deallocated.] 
+            if (content->userDefinedContentType != NULL)
+            {
+                free(content->userDefinedContentType);
+                content->userDefinedContentType = NULL;
+            }
+
+            if (mallocAndStrcpy_s(&content->userDefinedContentType, contentType) != 0)
+            {
+                LogError("Failed saving a copy of contentType");
+                // Codes_SRS_IOTHUBMESSAGE_09_003: [If the allocation or the copying of `contentType` fails, then IoTHubMessage_SetContentTypeSystemProperty shall return IOTHUB_MESSAGE_ERROR.] 
+                result = IOTHUB_MESSAGE_ERROR;
+            }
+            else
+            {
+                // Codes_SRS_IOTHUBMESSAGE_09_004: [If IoTHubMessage_SetContentTypeSystemProperty finishes successfully it shall return IOTHUB_MESSAGE_OK.]
+                result = IOTHUB_MESSAGE_OK;
+            }
         }
     }
 
@@ -594,7 +1152,7 @@ const char* IoTHubMessage_GetContentTypeSystemProperty(IOTHUB_MESSAGE_HANDLE iot
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
 
         // Codes_SRS_IOTHUBMESSAGE_09_006: [IoTHubMessage_GetContentTypeSystemProperty shall return the `contentType` as a const char* ] 
-        result = (const char*)handleData->userDefinedContentType;
+        result = (const char*)handleData->content->userDefinedContentType;
     }
 
     return result;
@@ -614,23 +1172,32 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_SetContentEncodingSystemProperty(IOTHUB_MESS
     {
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = (IOTHUB_MESSAGE_HANDLE_DATA*)iotHubMessageHandle;
 
-        // Codes_SRS_IOTHUBMESSAGE_09_007: [If the IOTHUB_MESSAGE_HANDLE `contentEncoding` is not NULL it shall be deallocated.] 
-        if (handleData->contentEncoding != NULL)
+        IOTHUB_MESSAGE_CONTENT* content;
+        if ((content = GetWritableContent(handleData)) == NULL)
         {
-            free(handleData->contentEncoding);
-            handleData->contentEncoding = NULL;
-        }
-
-        if (mallocAndStrcpy_s(&handleData->contentEncoding, contentEncoding) != 0)
-        {
-            LogError("Failed saving a copy of contentEncoding");
-            // Codes_SRS_IOTHUBMESSAGE_09_008: [If the allocation or the copying of `contentEncoding` fails, then IoTHubMessage_SetContentEncodingSystemProperty shall return IOTHUB_MESSAGE_ERROR.]
+            LogError("unable to modify the content of the message");
             result = IOTHUB_MESSAGE_ERROR;
         }
         else
         {
-            // Codes_SRS_IOTHUBMESSAGE_09_009: [If IoTHubMessage_SetContentEncodingSystemProperty finishes successfully it shall return IOTHUB_MESSAGE_OK.]
-            result = IOTHUB_MESSAGE_OK;
+            // Codes_SRS_IOTHUBMESSAGE_09_007: [If the IOTHUB_MESSAGE_HANDLE `contentEncoding` is not NULL it shall be deallocated.] 
+            if (content->contentEncoding != NULL)
+            {
+                free(content->contentEncoding);
+                content->contentEncoding = NULL;
+            }
+
+            if (mallocAndStrcpy_s(&content->contentEncoding, contentEncoding) != 0)
+            {
+                LogError("Failed saving a copy of contentEncoding");
+                // Codes_SRS_IOTHUBMESSAGE_09_008: [If the allocation or the copying of `contentEncoding` fails, then IoTHubMessage_SetContentEncodingSystemProperty shall return IOTHUB_MESSAGE_ERROR.]
+                result = IOTHUB_MESSAGE_ERROR;
+            }
+            else
+            {
+                // Codes_SRS_IOTHUBMESSAGE_09_009: [If IoTHubMessage_SetContentEncodingSystemProperty finishes successfully it shall return IOTHUB_MESSAGE_OK.]
+                result = IOTHUB_MESSAGE_OK;
+            }
         }
     }
 
@@ -652,7 +1219,7 @@ const char* IoTHubMessage_GetContentEncodingSystemProperty(IOTHUB_MESSAGE_HANDLE
         IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
 
         // Codes_SRS_IOTHUBMESSAGE_09_011: [IoTHubMessage_GetContentEncodingSystemProperty shall return the `contentEncoding` as a const char* ] 
-        result = (const char*)handleData->contentEncoding;
+        result = (const char*)handleData->content->contentEncoding;
     }
 
     return result;
@@ -670,7 +1237,7 @@ const IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA* IoTHubMessage_GetDiagnosticProper
     else
     {
         /* Codes_SRS_IOTHUBMESSAGE_10_002: [IoTHubMessage_GetDiagnosticPropertyData shall return the diagnosticData as a const IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA*.] */
-        result = iotHubMessageHandle->diagnosticData;
+        result = iotHubMessageHandle->content->diagnosticData;
     }
     return result;
 }
@@ -692,23 +1259,33 @@ IOTHUB_MESSAGE_RESULT IoTHubMessage_SetDiagnosticPropertyData(IOTHUB_MESSAGE_HAN
     }
     else
     {
-        // Codes_SRS_IOTHUBMESSAGE_10_004: [If the IOTHUB_MESSAGE_HANDLE `diagnosticData` is not NULL it shall be deallocated.] 
-        if (iotHubMessageHandle->diagnosticData != NULL)
-        {
-            DestroyDiagnosticPropertyData(iotHubMessageHandle->diagnosticData);
-            iotHubMessageHandle->diagnosticData = NULL;
-        }
-
-        // Codes_SRS_IOTHUBMESSAGE_10_005: [If the allocation or the copying of `diagnosticData` fails, then IoTHubMessage_SetDiagnosticPropertyData shall return IOTHUB_MESSAGE_ERROR.]
-        if ((iotHubMessageHandle->diagnosticData = CloneDiagnosticPropertyData(diagnosticData)) == NULL)
+        IOTHUB_MESSAGE_HANDLE_DATA* handleData = iotHubMessageHandle;
+        IOTHUB_MESSAGE_CONTENT* content;
+        if ((content = GetWritableContent(handleData)) == NULL)
         {
-            LogError("Failed saving a copy of diagnosticData");
+            LogError("unable to modify the content of the message");
             result = IOTHUB_MESSAGE_ERROR;
         }
         else
         {
-            // Codes_SRS_IOTHUBMESSAGE_10_006: [If IoTHubMessage_SetDiagnosticPropertyData finishes successfully it shall return IOTHUB_MESSAGE_OK.]
-            result = IOTHUB_MESSAGE_OK;
+            // Codes_SRS_IOTHUBMESSAGE_10_004: [If the IOTHUB_MESSAGE_HANDLE `diagnosticData` is not NULL it shall be deallocated.] 
+            if (content->diagnosticData != NULL)
+            {
+                DestroyDiagnosticPropertyData(content->diagnosticData);
+                content->diagnosticData = NULL;
+            }
+
+            // Codes_SRS_IOTHUBMESSAGE_10_005: [If the allocation or the copying of `diagnosticData` fails, then IoTHubMessage_SetDiagnosticPropertyData shall return IOTHUB_MESSAGE_ERROR.]
+            if ((content->diagnosticData = CloneDiagnosticPropertyData(diagnosticData)) == NULL)
+            {
+                LogError("Failed saving a copy of diagnosticData");
+                result = IOTHUB_MESSAGE_ERROR;
+            }
+            else
+            {
+                // Codes_SRS_IOTHUBMESSAGE_10_006: [If IoTHubMessage_SetDiagnosticPropertyData finishes successfully it shall return IOTHUB_MESSAGE_OK.]
+                result = IOTHUB_MESSAGE_OK;
+            }
         }
     }
     return result;
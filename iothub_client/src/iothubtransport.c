@@ -24,72 +24,88 @@ typedef struct TRANSPORT_HANDLE_DATA_TAG
     VECTOR_HANDLE clients;
     LOCK_HANDLE clientsLockHandle;
     IOTHUB_CLIENT_MULTIPLEXED_DO_WORK clientDoWork;
+    /* sharding: the handle returned by IoTHubTransport_CreateSharded is shard 0 and owns the others */
+    struct TRANSPORT_HANDLE_DATA_TAG* owner;
+    struct TRANSPORT_HANDLE_DATA_TAG** shards;
+    size_t shardCount;
+    size_t assignedClients;
+    LOCK_HANDLE shardsLockHandle;
+    /* pooling: shards are opened when the others are full and closed when they become empty */
+    size_t devicesPerShard;
+    IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol;
+    char* iotHubName;
+    char* iotHubSuffix;
 } TRANSPORT_HANDLE_DATA;
 
 /* Used for Unit test */
 const size_t IoTHubTransport_ThreadTerminationOffset = offsetof(TRANSPORT_HANDLE_DATA, stopThread);
 
-TRANSPORT_HANDLE  IoTHubTransport_Create(IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol, const char* iotHubName, const char* iotHubSuffix)
+static TRANSPORT_HANDLE_DATA* create_transport_data(IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol, const char* iotHubName, const char* iotHubSuffix)
 {
     TRANSPORT_HANDLE_DATA *result;
 
-    if (protocol == NULL || iotHubName == NULL || iotHubSuffix == NULL)
+    /*Codes_SRS_IOTHUBTRANSPORT_17_032: [ IoTHubTransport_Create shall allocate memory for the transport data. ]*/
+    result = (TRANSPORT_HANDLE_DATA*)malloc(sizeof(TRANSPORT_HANDLE_DATA));
+    if (result == NULL)
     {
-        /*Codes_SRS_IOTHUBTRANSPORT_17_002: [ If protocol is NULL, this function shall return NULL. ]*/
-        /*Codes_SRS_IOTHUBTRANSPORT_17_003: [ If iotHubName is NULL, this function shall return NULL. ]*/
-        /*Codes_SRS_IOTHUBTRANSPORT_17_004: [ If iotHubSuffix is NULL, this function shall return NULL. ]*/
-        LogError("Invalid NULL argument, protocol [%p], name [%p], suffix [%p].", protocol, iotHubName, iotHubSuffix);
-        result = NULL;
+        /*Codes_SRS_IOTHUBTRANSPORT_17_040: [ If memory allocation fails, IoTHubTransport_Create shall return NULL. ]*/
+        LogError("Transport handle was not allocated.");
     }
     else
     {
-        /*Codes_SRS_IOTHUBTRANSPORT_17_032: [ IoTHubTransport_Create shall allocate memory for the transport data. ]*/
-        result = (TRANSPORT_HANDLE_DATA*)malloc(sizeof(TRANSPORT_HANDLE_DATA));
-        if (result == NULL)
+        TRANSPORT_PROVIDER * transportProtocol = (TRANSPORT_PROVIDER*)(protocol());
+        IOTHUB_CLIENT_CONFIG upperConfig;
+        upperConfig.deviceId = NULL;
+        upperConfig.deviceKey = NULL;
+        upperConfig.iotHubName = iotHubName;
+        upperConfig.iotHubSuffix = iotHubSuffix;
+        upperConfig.protocol = protocol;
+        upperConfig.protocolGatewayHostName = NULL;
+
+        IOTHUBTRANSPORT_CONFIG transportLLConfig;
+        memset(&transportLLConfig, 0, sizeof(IOTHUBTRANSPORT_CONFIG));
+        transportLLConfig.upperConfig = &upperConfig;
+        transportLLConfig.waitingToSend = NULL;
+
+        /*Codes_SRS_IOTHUBTRANSPORT_17_005: [ IoTHubTransport_Create shall create the lower layer transport by calling the protocol's IoTHubTransport_Create function. ]*/
+        result->transportLLHandle = transportProtocol->IoTHubTransport_Create(&transportLLConfig);
+        if (result->transportLLHandle == NULL)
         {
-            /*Codes_SRS_IOTHUBTRANSPORT_17_040: [ If memory allocation fails, IoTHubTransport_Create shall return NULL. ]*/
-            LogError("Transport handle was not allocated.");
+            /*Codes_SRS_IOTHUBTRANSPORT_17_006: [ If the creation of the transport fails, IoTHubTransport_Create shall return NULL. ]*/
+            LogError("Lower Layer transport not created.");
+            free(result);
+            result = NULL;
         }
         else
         {
-            TRANSPORT_PROVIDER * transportProtocol = (TRANSPORT_PROVIDER*)(protocol());
-            IOTHUB_CLIENT_CONFIG upperConfig;
-            upperConfig.deviceId = NULL;
-            upperConfig.deviceKey = NULL;
-            upperConfig.iotHubName = iotHubName;
-            upperConfig.iotHubSuffix = iotHubSuffix;
-            upperConfig.protocol = protocol;
-            upperConfig.protocolGatewayHostName = NULL;
-
-            IOTHUBTRANSPORT_CONFIG transportLLConfig;
-            memset(&transportLLConfig, 0, sizeof(IOTHUBTRANSPORT_CONFIG));
-            transportLLConfig.upperConfig = &upperConfig;
-            transportLLConfig.waitingToSend = NULL;
-
-            /*Codes_SRS_IOTHUBTRANSPORT_17_005: [ IoTHubTransport_Create shall create the lower layer transport by calling the protocol's IoTHubTransport_Create function. ]*/
-            result->transportLLHandle = transportProtocol->IoTHubTransport_Create(&transportLLConfig);
-            if (result->transportLLHandle == NULL)
+            /*Codes_SRS_IOTHUBTRANSPORT_17_007: [ IoTHubTransport_Create shall create the transport lock by Calling Lock_Init. ]*/
+            result->lockHandle = Lock_Init();
+            if (result->lockHandle == NULL)
             {
-                /*Codes_SRS_IOTHUBTRANSPORT_17_006: [ If the creation of the transport fails, IoTHubTransport_Create shall return NULL. ]*/
-                LogError("Lower Layer transport not created.");
+                /*Codes_SRS_IOTHUBTRANSPORT_17_008: [ If the lock creation fails, IoTHubTransport_Create shall return NULL. ]*/
+                LogError("transport Lock not created.");
+                transportProtocol->IoTHubTransport_Destroy(result->transportLLHandle);
+                free(result);
+                result = NULL;
+            }
+            else if ((result->clientsLockHandle = Lock_Init()) == NULL)
+            {
+                LogError("clients Lock not created.");
+                Lock_Deinit(result->lockHandle);
+                transportProtocol->IoTHubTransport_Destroy(result->transportLLHandle);
                 free(result);
                 result = NULL;
             }
             else
             {
-                /*Codes_SRS_IOTHUBTRANSPORT_17_007: [ IoTHubTransport_Create shall create the transport lock by Calling Lock_Init. ]*/
-                result->lockHandle = Lock_Init();
-                if (result->lockHandle == NULL)
+                /*Codes_SRS_IOTHUBTRANSPORT_17_038: [ IoTHubTransport_Create shall call VECTOR_Create to make a list of IOTHUB_CLIENT_HANDLE using this transport. ]*/
+                result->clients = VECTOR_create(sizeof(IOTHUB_CLIENT_HANDLE));
+                if (result->clients == NULL)
                 {
-                    /*Codes_SRS_IOTHUBTRANSPORT_17_008: [ If the lock creation fails, IoTHubTransport_Create shall return NULL. ]*/
-                    LogError("transport Lock not created.");
-                    transportProtocol->IoTHubTransport_Destroy(result->transportLLHandle);
-                    free(result);
-                    result = NULL;
-                }
-                else if ((result->clientsLockHandle = Lock_Init()) == NULL)
-                {
-                    LogError("clients Lock not created.");
+                    /*Codes_SRS_IOTHUBTRANSPORT_17_039: [ If the Vector creation fails, IoTHubTransport_Create shall return NULL. ]*/
+                    /*Codes_SRS_IOTHUBTRANSPORT_17_009: [ IoTHubTransport_Create shall clean up any resources it creates if the function does not succeed. ]*/
+                    LogError("clients list not created.");
+                    Lock_Deinit(result->clientsLockHandle);
                     Lock_Deinit(result->lockHandle);
                     transportProtocol->IoTHubTransport_Destroy(result->transportLLHandle);
                     free(result);
@@ -97,37 +113,31 @@ TRANSPORT_HANDLE  IoTHubTransport_Create(IOTHUB_CLIENT_TRANSPORT_PROVIDER protoc
                 }
                 else
                 {
-                    /*Codes_SRS_IOTHUBTRANSPORT_17_038: [ IoTHubTransport_Create shall call VECTOR_Create to make a list of IOTHUB_CLIENT_HANDLE using this transport. ]*/
-                    result->clients = VECTOR_create(sizeof(IOTHUB_CLIENT_HANDLE));
-                    if (result->clients == NULL)
-                    {
-                        /*Codes_SRS_IOTHUBTRANSPORT_17_039: [ If the Vector creation fails, IoTHubTransport_Create shall return NULL. ]*/
-                        /*Codes_SRS_IOTHUBTRANSPORT_17_009: [ IoTHubTransport_Create shall clean up any resources it creates if the function does not succeed. ]*/
-                        LogError("clients list not created.");
-                        Lock_Deinit(result->clientsLockHandle);
-                        Lock_Deinit(result->lockHandle);
-                        transportProtocol->IoTHubTransport_Destroy(result->transportLLHandle);
-                        free(result);
-                        result = NULL;
-                    }
-                    else
-                    {
-                        /*Codes_SRS_IOTHUBTRANSPORT_17_001: [ IoTHubTransport_Create shall return a non-NULL handle on success.]*/
-                        result->stopThread = 1;
-                        result->clientDoWork = NULL;
-                        result->workerThreadHandle = NULL; /* create thread when work needs to be done */
-                        result->IoTHubTransport_GetHostname = transportProtocol->IoTHubTransport_GetHostname;
-                        result->IoTHubTransport_SetOption = transportProtocol->IoTHubTransport_SetOption;
-                        result->IoTHubTransport_Create = transportProtocol->IoTHubTransport_Create;
-                        result->IoTHubTransport_Destroy = transportProtocol->IoTHubTransport_Destroy;
-                        result->IoTHubTransport_Register = transportProtocol->IoTHubTransport_Register;
-                        result->IoTHubTransport_Unregister = transportProtocol->IoTHubTransport_Unregister;
-                        result->IoTHubTransport_Subscribe = transportProtocol->IoTHubTransport_Subscribe;
-                        result->IoTHubTransport_Unsubscribe = transportProtocol->IoTHubTransport_Unsubscribe;
-                        result->IoTHubTransport_DoWork = transportProtocol->IoTHubTransport_DoWork;
-                        result->IoTHubTransport_SetRetryPolicy = transportProtocol->IoTHubTransport_SetRetryPolicy;
-                        result->IoTHubTransport_GetSendStatus = transportProtocol->IoTHubTransport_GetSendStatus;
-                    }
+                    /*Codes_SRS_IOTHUBTRANSPORT_17_001: [ IoTHubTransport_Create shall return a non-NULL handle on success.]*/
+                    result->stopThread = 1;
+                    result->clientDoWork = NULL;
+                    result->workerThreadHandle = NULL; /* create thread when work needs to be done */
+                    result->IoTHubTransport_GetHostname = transportProtocol->IoTHubTransport_GetHostname;
+                    result->IoTHubTransport_SetOption = transportProtocol->IoTHubTransport_SetOption;
+                    result->IoTHubTransport_Create = transportProtocol->IoTHubTransport_Create;
+                    result->IoTHubTransport_Destroy = transportProtocol->IoTHubTransport_Destroy;
+                    result->IoTHubTransport_Register = transportProtocol->IoTHubTransport_Register;
+                    result->IoTHubTransport_Unregister = transportProtocol->IoTHubTransport_Unregister;
+                    result->IoTHubTransport_Subscribe = transportProtocol->IoTHubTransport_Subscribe;
+                    result->IoTHubTransport_Unsubscribe = transportProtocol->IoTHubTransport_Unsubscribe;
+                    result->IoTHubTransport_DoWork = transportProtocol->IoTHubTransport_DoWork;
+                    result->IoTHubTransport_SetRetryPolicy = transportProtocol->IoTHubTransport_SetRetryPolicy;
+                    result->IoTHubTransport_GetSendStatus = transportProtocol->IoTHubTransport_GetSendStatus;
+                    result->IoTHubTransport_GetNextWorkDeadline = transportProtocol->IoTHubTransport_GetNextWorkDeadline;
+                    result->owner = result;
+                    result->shards = NULL;
+                    result->shardCount = 1;
+                    result->assignedClients = 0;
+                    result->shardsLockHandle = NULL;
+                    result->devicesPerShard = 0;
+                    result->protocol = protocol;
+                    result->iotHubName = NULL;
+                    result->iotHubSuffix = NULL;
                 }
             }
         }
@@ -136,6 +146,137 @@ TRANSPORT_HANDLE  IoTHubTransport_Create(IOTHUB_CLIENT_TRANSPORT_PROVIDER protoc
     return result;
 }
 
+static void destroy_transport_data(TRANSPORT_HANDLE_DATA* transportData);
+
+TRANSPORT_HANDLE IoTHubTransport_CreateSharded(IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol, const char* iotHubName, const char* iotHubSuffix, size_t shardCount)
+{
+    TRANSPORT_HANDLE_DATA *result;
+
+    if (protocol == NULL || iotHubName == NULL || iotHubSuffix == NULL || shardCount == 0)
+    {
+        /*Codes_SRS_IOTHUBTRANSPORT_17_002: [ If protocol is NULL, this function shall return NULL. ]*/
+        /*Codes_SRS_IOTHUBTRANSPORT_17_003: [ If iotHubName is NULL, this function shall return NULL. ]*/
+        /*Codes_SRS_IOTHUBTRANSPORT_17_004: [ If iotHubSuffix is NULL, this function shall return NULL. ]*/
+        /*Codes_SRS_IOTHUBTRANSPORT_10_001: [ If shardCount is 0, IoTHubTransport_CreateSharded shall return NULL. ]*/
+        LogError("Invalid argument, protocol [%p], name [%p], suffix [%p], shardCount [%lu].", protocol, iotHubName, iotHubSuffix, (unsigned long)shardCount);
+        result = NULL;
+    }
+    /*Codes_SRS_IOTHUBTRANSPORT_10_002: [ IoTHubTransport_CreateSharded shall create the first shard exactly like IoTHubTransport_Create and return it as the transport handle. ]*/
+    else if ((result = create_transport_data(protocol, iotHubName, iotHubSuffix)) == NULL)
+    {
+        LogError("first shard not created.");
+    }
+    else if (shardCount > 1)
+    {
+        /*Codes_SRS_IOTHUBTRANSPORT_10_003: [ If shardCount is greater than 1, IoTHubTransport_CreateSharded shall allocate the shard table, create the shard lock by calling Lock_Init and create shardCount - 1 more shards, each with its own lower layer transport, lock, client list and worker thread. ]*/
+        if ((result->shards = (TRANSPORT_HANDLE_DATA**)malloc(shardCount * sizeof(TRANSPORT_HANDLE_DATA*))) == NULL)
+        {
+            /*Codes_SRS_IOTHUBTRANSPORT_10_004: [ If any allocation or creation fails, IoTHubTransport_CreateSharded shall destroy the shards created so far and return NULL. ]*/
+            LogError("shard table not allocated.");
+            destroy_transport_data(result);
+            result = NULL;
+        }
+        else if ((result->shardsLockHandle = Lock_Init()) == NULL)
+        {
+            LogError("shard Lock not created.");
+            free(result->shards);
+            result->shards = NULL;
+            destroy_transport_data(result);
+            result = NULL;
+        }
+        else
+        {
+            size_t index;
+
+            result->shards[0] = result;
+            for (index = 1; index < shardCount; index++)
+            {
+                if ((result->shards[index] = create_transport_data(protocol, iotHubName, iotHubSuffix)) == NULL)
+                {
+                    LogError("shard %lu not created.", (unsigned long)index);
+                    break;
+                }
+                else
+                {
+                    result->shards[index]->owner = result;
+                }
+            }
+
+            result->shardCount = index;
+            if (index < shardCount)
+            {
+                IoTHubTransport_Destroy(result);
+                result = NULL;
+            }
+        }
+    }
+
+    return result;
+}
+
+TRANSPORT_HANDLE IoTHubTransport_CreatePooled(IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol, const char* iotHubName, const char* iotHubSuffix, size_t maxConnections, size_t devicesPerConnection)
+{
+    TRANSPORT_HANDLE_DATA *result;
+
+    if (protocol == NULL || iotHubName == NULL || iotHubSuffix == NULL || maxConnections == 0 || devicesPerConnection == 0)
+    {
+        /*Codes_SRS_IOTHUBTRANSPORT_10_013: [ If protocol, iotHubName or iotHubSuffix is NULL, or maxConnections or devicesPerConnection is 0, IoTHubTransport_CreatePooled shall return NULL. ]*/
+        LogError("Invalid argument, protocol [%p], name [%p], suffix [%p], maxConnections [%lu], devicesPerConnection [%lu].", protocol, iotHubName, iotHubSuffix, (unsigned long)maxConnections, (unsigned long)devicesPerConnection);
+        result = NULL;
+    }
+    /*Codes_SRS_IOTHUBTRANSPORT_10_014: [ IoTHubTransport_CreatePooled shall open the first connection like IoTHubTransport_Create and return it as the transport handle. ]*/
+    else if ((result = create_transport_data(protocol, iotHubName, iotHubSuffix)) == NULL)
+    {
+        LogError("first connection not created.");
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBTRANSPORT_10_015: [ IoTHubTransport_CreatePooled shall keep a copy of iotHubName and iotHubSuffix, allocate a table of maxConnections shards and create the shard lock by calling Lock_Init. ]*/
+        if (mallocAndStrcpy_s(&result->iotHubName, iotHubName) != 0)
+        {
+            /*Codes_SRS_IOTHUBTRANSPORT_10_016: [ If any allocation or creation fails, IoTHubTransport_CreatePooled shall free everything it created and return NULL. ]*/
+            LogError("failed copying iotHubName.");
+            IoTHubTransport_Destroy(result);
+            result = NULL;
+        }
+        else if (mallocAndStrcpy_s(&result->iotHubSuffix, iotHubSuffix) != 0)
+        {
+            LogError("failed copying iotHubSuffix.");
+            IoTHubTransport_Destroy(result);
+            result = NULL;
+        }
+        else if ((result->shards = (TRANSPORT_HANDLE_DATA**)malloc(maxConnections * sizeof(TRANSPORT_HANDLE_DATA*))) == NULL)
+        {
+            LogError("connection table not allocated.");
+            IoTHubTransport_Destroy(result);
+            result = NULL;
+        }
+        else if ((result->shardsLockHandle = Lock_Init()) == NULL)
+        {
+            LogError("connection table Lock not created.");
+            free(result->shards);
+            result->shards = NULL;
+            IoTHubTransport_Destroy(result);
+            result = NULL;
+        }
+        else
+        {
+            memset(result->shards, 0, maxConnections * sizeof(TRANSPORT_HANDLE_DATA*));
+            result->shards[0] = result;
+            result->shardCount = maxConnections;
+            result->devicesPerShard = devicesPerConnection;
+        }
+    }
+
+    return result;
+}
+
+TRANSPORT_HANDLE  IoTHubTransport_Create(IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol, const char* iotHubName, const char* iotHubSuffix)
+{
+    /*Codes_SRS_IOTHUBTRANSPORT_10_005: [ IoTHubTransport_Create shall behave as IoTHubTransport_CreateSharded with a shardCount of 1. ]*/
+    return IoTHubTransport_CreateSharded(protocol, iotHubName, iotHubSuffix, 1);
+}
+
 static void multiplexed_client_do_work(TRANSPORT_HANDLE_DATA* transportData)
 {
     if (Lock(transportData->clientsLockHandle) != LOCK_OK)
@@ -328,30 +469,175 @@ static bool signal_end_worker_thread(TRANSPORT_HANDLE_DATA * transportData, IOTH
     return okToJoin;
 }
 
+static void destroy_transport_data(TRANSPORT_HANDLE_DATA* transportData)
+{
+    /*Codes_SRS_IOTHUBTRANSPORT_17_033: [ IoTHubTransport_Destroy shall lock the transport lock. ]*/
+    if (Lock(transportData->lockHandle) != LOCK_OK)
+    {
+        LogError("Unable to lock - will still attempt to end thread without thread safety");
+        stop_worker_thread(transportData);
+    }
+    else
+    {
+        stop_worker_thread(transportData);
+        (void)Unlock(transportData->lockHandle);
+    }
+    wait_worker_thread(transportData);
+    /*Codes_SRS_IOTHUBTRANSPORT_17_010: [ IoTHubTransport_Destroy shall free all resources. ]*/
+    Lock_Deinit(transportData->lockHandle);
+    (transportData->IoTHubTransport_Destroy)(transportData->transportLLHandle);
+    VECTOR_destroy(transportData->clients);
+    Lock_Deinit(transportData->clientsLockHandle);
+    free(transportData);
+}
+
 void IoTHubTransport_Destroy(TRANSPORT_HANDLE transportHandle)
 {
     /*Codes_SRS_IOTHUBTRANSPORT_17_011: [ IoTHubTransport_Destroy shall do nothing if transportHandle is NULL. ]*/
     if (transportHandle != NULL)
     {
         TRANSPORT_HANDLE_DATA * transportData = (TRANSPORT_HANDLE_DATA*)transportHandle;
-        /*Codes_SRS_IOTHUBTRANSPORT_17_033: [ IoTHubTransport_Destroy shall lock the transport lock. ]*/
-        if (Lock(transportData->lockHandle) != LOCK_OK)
+        if (transportData->shards != NULL)
         {
-            LogError("Unable to lock - will still attempt to end thread without thread safety");
-            stop_worker_thread(transportData);
+            size_t index;
+
+            /*Codes_SRS_IOTHUBTRANSPORT_10_006: [ IoTHubTransport_Destroy shall stop and destroy every other shard of a sharded transport, then free the shard table and the shard lock. ]*/
+            for (index = 1; index < transportData->shardCount; index++)
+            {
+                if (transportData->shards[index] != NULL)
+                {
+                    destroy_transport_data(transportData->shards[index]);
+                }
+            }
+            free(transportData->shards);
+            Lock_Deinit(transportData->shardsLockHandle);
+        }
+        free(transportData->iotHubName);
+        free(transportData->iotHubSuffix);
+        destroy_transport_data(transportData);
+    }
+}
+
+TRANSPORT_HANDLE IoTHubTransport_AssignShard(TRANSPORT_HANDLE transportHandle)
+{
+    TRANSPORT_HANDLE_DATA* result;
+    if (transportHandle == NULL)
+    {
+        /*Codes_SRS_IOTHUBTRANSPORT_10_007: [ If transportHandle is NULL, IoTHubTransport_AssignShard shall return NULL. ]*/
+        LogError("Invalid NULL transportHandle.");
+        result = NULL;
+    }
+    else
+    {
+        TRANSPORT_HANDLE_DATA * transportData = (TRANSPORT_HANDLE_DATA*)transportHandle;
+        if (transportData->shards == NULL)
+        {
+            /*Codes_SRS_IOTHUBTRANSPORT_10_008: [ If the transport has a single shard, IoTHubTransport_AssignShard shall return transportHandle. ]*/
+            result = transportData;
+        }
+        else if (Lock(transportData->shardsLockHandle) != LOCK_OK)
+        {
+            /*Codes_SRS_IOTHUBTRANSPORT_10_010: [ If acquiring the shard lock fails, IoTHubTransport_AssignShard shall return NULL. ]*/
+            LogError("failed to lock for IoTHubTransport_AssignShard");
+            result = NULL;
         }
         else
         {
-            stop_worker_thread(transportData);
-            (void)Unlock(transportData->lockHandle);
+            size_t index;
+            size_t freeSlot = transportData->shardCount;
+
+            /*Codes_SRS_IOTHUBTRANSPORT_10_009: [ Otherwise IoTHubTransport_AssignShard shall, under the shard lock, return the shard with the fewest assigned clients and count the new client on it. ]*/
+            /*Codes_SRS_IOTHUBTRANSPORT_10_017: [ For a pooled transport, IoTHubTransport_AssignShard shall only consider the open connections that serve fewer than devicesPerConnection clients. ]*/
+            result = NULL;
+            for (index = 0; index < transportData->shardCount; index++)
+            {
+                TRANSPORT_HANDLE_DATA* shard = transportData->shards[index];
+                if (shard == NULL)
+                {
+                    if (freeSlot == transportData->shardCount)
+                    {
+                        freeSlot = index;
+                    }
+                }
+                else if (((transportData->devicesPerShard == 0) || (shard->assignedClients < transportData->devicesPerShard)) &&
+                    ((result == NULL) || (shard->assignedClients < result->assignedClients)))
+                {
+                    result = shard;
+                }
+            }
+
+            if ((result == NULL) && (freeSlot < transportData->shardCount))
+            {
+                /*Codes_SRS_IOTHUBTRANSPORT_10_018: [ If all open connections are full and fewer than maxConnections are open, IoTHubTransport_AssignShard shall open a new connection and return it. ]*/
+                if ((result = create_transport_data(transportData->protocol, transportData->iotHubName, transportData->iotHubSuffix)) == NULL)
+                {
+                    LogError("failed opening connection %lu of the pool", (unsigned long)freeSlot);
+                }
+                else
+                {
+                    result->owner = transportData;
+                    transportData->shards[freeSlot] = result;
+                }
+            }
+
+            if (result == NULL)
+            {
+                /*Codes_SRS_IOTHUBTRANSPORT_10_019: [ If no connection can take the client, IoTHubTransport_AssignShard shall return NULL. ]*/
+                LogError("no connection of the transport can take another client");
+            }
+            else
+            {
+                result->assignedClients++;
+            }
+
+            (void)Unlock(transportData->shardsLockHandle);
+        }
+    }
+    return result;
+}
+
+void IoTHubTransport_ReleaseShard(TRANSPORT_HANDLE shardHandle)
+{
+    /*Codes_SRS_IOTHUBTRANSPORT_10_011: [ If shardHandle is NULL or belongs to a transport with a single shard, IoTHubTransport_ReleaseShard shall do nothing. ]*/
+    if ((shardHandle != NULL) && (((TRANSPORT_HANDLE_DATA*)shardHandle)->owner->shards != NULL))
+    {
+        TRANSPORT_HANDLE_DATA * shardData = (TRANSPORT_HANDLE_DATA*)shardHandle;
+        TRANSPORT_HANDLE_DATA * owner = shardData->owner;
+        if (Lock(owner->shardsLockHandle) != LOCK_OK)
+        {
+            LogError("failed to lock for IoTHubTransport_ReleaseShard");
+        }
+        else
+        {
+            bool closeShard = false;
+
+            /*Codes_SRS_IOTHUBTRANSPORT_10_012: [ IoTHubTransport_ReleaseShard shall, under the shard lock, remove one client from the count of the shard. ]*/
+            if (shardData->assignedClients > 0)
+            {
+                shardData->assignedClients--;
+            }
+
+            if ((owner->devicesPerShard > 0) && (shardData->assignedClients == 0) && (shardData != owner))
+            {
+                size_t index;
+                for (index = 1; index < owner->shardCount; index++)
+                {
+                    if (owner->shards[index] == shardData)
+                    {
+                        owner->shards[index] = NULL;
+                        closeShard = true;
+                        break;
+                    }
+                }
+            }
+            (void)Unlock(owner->shardsLockHandle);
+
+            if (closeShard)
+            {
+                /*Codes_SRS_IOTHUBTRANSPORT_10_020: [ When the last client of a pooled connection other than the first one is released, IoTHubTransport_ReleaseShard shall remove the connection from the pool and destroy it outside the shard lock. ]*/
+                destroy_transport_data(shardData);
+            }
         }
-        wait_worker_thread(transportData);
-        /*Codes_SRS_IOTHUBTRANSPORT_17_010: [ IoTHubTransport_Destroy shall free all resources. ]*/
-        Lock_Deinit(transportData->lockHandle);
-        (transportData->IoTHubTransport_Destroy)(transportData->transportLLHandle);
-        VECTOR_destroy(transportData->clients);
-        Lock_Deinit(transportData->clientsLockHandle);
-        free(transportHandle);
     }
 }
 
@@ -10,7 +10,6 @@
 #include "azure_c_shared_utility/agenttime.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/crt_abstractions.h"
-#include "azure_c_shared_utility/singlylinkedlist.h"
 #include "azure_c_shared_utility/doublylinkedlist.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/platform.h"
@@ -32,6 +31,7 @@
 #include "iothub_client_private.h"
 #include "iothubtransportamqp_methods.h"
 #include "iothub_client_retry_control.h"
+#include "device_index.h"
 #include "iothubtransport_amqp_common.h"
 #include "iothubtransport_amqp_connection.h"
 #include "iothubtransport_amqp_device.h"
@@ -51,6 +51,7 @@
 // DEFAULT_MAX_RETRY_TIME_IN_SECS = 0 means infinite retry.
 #define DEFAULT_MAX_RETRY_TIME_IN_SECS            0
 #define MAX_SERVICE_KEEP_ALIVE_RATIO              0.9
+#define RETRY_CHECK_INTERVAL_MS                   1000
 
 // ---------- Data Definitions ---------- //
 
@@ -102,7 +103,7 @@ typedef struct AMQP_TRANSPORT_INSTANCE_TAG
     AMQP_CONNECTION_HANDLE amqp_connection;                             // Base amqp connection with service.
     AMQP_CONNECTION_STATE amqp_connection_state;                        // Current state of the amqp_connection.
     AMQP_TRANSPORT_AUTHENTICATION_MODE preferred_authentication_mode;   // Used to avoid registered devices using different authentication modes.
-    SINGLYLINKEDLIST_HANDLE registered_devices;                         // List of devices currently registered in this transport.
+    DEVICE_INDEX_HANDLE registered_devices;                             // Devices currently registered in this transport, indexed by device id.
     bool is_trace_on;                                                   // Turns logging on and off.
     OPTIONHANDLER_HANDLE saved_tls_options;                             // Here are the options from the xio layer if any is saved.
     AMQP_TRANSPORT_STATE state;                                         // Current state of the transport.
@@ -252,15 +253,21 @@ static DEVICE_AUTH_MODE get_authentication_mode(const IOTHUB_DEVICE_CONFIG* devi
     return result;
 }
 
-static void raise_connection_status_callback_retry_expired(const void* item, const void* action_context, bool* continue_processing)
+static void raise_connection_status_callback_retry_expired(AMQP_TRANSPORT_INSTANCE* transport_instance)
 {
-    (void)action_context;
+    DEVICE_INDEX_ITEM_HANDLE list_item = device_index_get_head_item(transport_instance->registered_devices);
 
-    AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device = (AMQP_TRANSPORT_DEVICE_INSTANCE*)item;
+    while (list_item != NULL)
+    {
+        AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device = (AMQP_TRANSPORT_DEVICE_INSTANCE*)device_index_item_get_value(list_item);
 
-    IoTHubClient_LL_ConnectionStatusCallBack(registered_device->iothub_client_handle, IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED, IOTHUB_CLIENT_CONNECTION_RETRY_EXPIRED);
+        if (registered_device != NULL)
+        {
+            IoTHubClient_LL_ConnectionStatusCallBack(registered_device->iothub_client_handle, IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED, IOTHUB_CLIENT_CONNECTION_RETRY_EXPIRED);
+        }
 
-    *continue_processing = true;
+        list_item = device_index_get_next_item(list_item);
+    }
 }
 
 // @brief
@@ -312,65 +319,26 @@ static void on_device_state_changed_callback(void* context, DEVICE_STATE previou
     }
 }
 
-// @brief    Auxiliary function to be used to find a device in the registered_devices list.
-// @returns  true if the device ids match, false otherwise.
-static bool find_device_by_id_callback(LIST_ITEM_HANDLE list_item, const void* match_context)
+// @brief       Verifies if a device is already registered within the transport that owns the index of registered devices.
+// @remarks     Returns the correspoding DEVICE_INDEX_ITEM_HANDLE in registered_devices, if found. The lookup does not depend on the number of registered devices.
+// @returns     true if the device is already in the index, false otherwise.
+static bool is_device_registered_ex(DEVICE_INDEX_HANDLE registered_devices, const char* device_id, DEVICE_INDEX_ITEM_HANDLE *list_item)
 {
-    bool result;
-
-    if (match_context == NULL)
-    {
-        result = false;
-    }
-    else
-    {
-        AMQP_TRANSPORT_DEVICE_INSTANCE* device_instance = (AMQP_TRANSPORT_DEVICE_INSTANCE*)singlylinkedlist_item_get_value(list_item);
-
-        if (device_instance == NULL || 
-            device_instance->device_id == NULL || 
-            STRING_c_str(device_instance->device_id) != match_context)
-        {
-            result = false;
-        }
-        else
-        {
-            result = true;
-        }
-    }
-
-    return result;
-}
-
-// @brief       Verifies if a device is already registered within the transport that owns the list of registered devices.
-// @remarks     Returns the correspoding LIST_ITEM_HANDLE in registered_devices, if found.
-// @returns     true if the device is already in the list, false otherwise.
-static bool is_device_registered_ex(SINGLYLINKEDLIST_HANDLE registered_devices, const char* device_id, LIST_ITEM_HANDLE *list_item)
-{
-    return ((*list_item = singlylinkedlist_find(registered_devices, find_device_by_id_callback, device_id)) != NULL ? 1 : 0);
+    return ((*list_item = device_index_find(registered_devices, device_id)) != NULL ? 1 : 0);
 }
 
-// @brief       Verifies if a device is already registered within the transport that owns the list of registered devices.
-// @returns     true if the device is already in the list, false otherwise.
+// @brief       Verifies if a device is already registered within the transport that owns the index of registered devices.
+// @returns     true if the device is already in the index, false otherwise.
 static bool is_device_registered(AMQP_TRANSPORT_DEVICE_INSTANCE* amqp_device_instance)
 {
-    LIST_ITEM_HANDLE list_item;
+    DEVICE_INDEX_ITEM_HANDLE list_item;
     const char* device_id = STRING_c_str(amqp_device_instance->device_id);
     return is_device_registered_ex(amqp_device_instance->transport_instance->registered_devices, device_id, &list_item);
 }
 
 static size_t get_number_of_registered_devices(AMQP_TRANSPORT_INSTANCE* transport)
 {
-    size_t result = 0;
-
-    LIST_ITEM_HANDLE list_item = singlylinkedlist_get_head_item(transport->registered_devices);
-
-    while (list_item != NULL)
-    {
-        result++;
-        list_item = singlylinkedlist_get_next_item(list_item);
-    }
-
-    return result;
+    return device_index_get_count(transport->registered_devices);
 }
 
 
@@ -879,22 +847,22 @@ static void prepare_for_connection_retry(AMQP_TRANSPORT_INSTANCE* transport_inst
         LogError("Failed saving TLS I/O options while preparing for connection retry; failure will be ignored");
     }
 
-    LIST_ITEM_HANDLE list_item = singlylinkedlist_get_head_item(transport_instance->registered_devices);
+    DEVICE_INDEX_ITEM_HANDLE list_item = device_index_get_head_item(transport_instance->registered_devices);
 
     while (list_item != NULL)
     {
-        AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device = (AMQP_TRANSPORT_DEVICE_INSTANCE*)singlylinkedlist_item_get_value(list_item);
+        AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device = (AMQP_TRANSPORT_DEVICE_INSTANCE*)device_index_item_get_value(list_item);
 
         if (registered_device == NULL)
         {
-            LogError("Failed preparing device for connection retry (singlylinkedlist_item_get_value failed)");
+            LogError("Failed preparing device for connection retry (device_index_item_get_value failed)");
         }
         else
         {
             prepare_device_for_connection_retry(registered_device);
         }
 
-        list_item = singlylinkedlist_get_next_item(list_item);
+        list_item = device_index_get_next_item(list_item);
     }
 
     // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_033: [`instance->connection` shall be destroyed using amqp_connection_destroy()]
@@ -1009,24 +977,20 @@ static void on_event_send_complete(IOTHUB_MESSAGE_LIST* message, D2C_EVENT_SEND_
         registered_device->number_of_send_event_complete_failures = 0;
     }
 
-    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_056: [If `message->callback` is not NULL, it shall invoked with the `iothub_send_result`]
-    if (message->callback != NULL)
-    {
-        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_050: [If result is D2C_EVENT_SEND_COMPLETE_RESULT_OK, `iothub_send_result` shall be set using IOTHUB_CLIENT_CONFIRMATION_OK]
-        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_051: [If result is D2C_EVENT_SEND_COMPLETE_RESULT_ERROR_CANNOT_PARSE, `iothub_send_result` shall be set using IOTHUB_CLIENT_CONFIRMATION_ERROR]
-        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_052: [If result is D2C_EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING, `iothub_send_result` shall be set using IOTHUB_CLIENT_CONFIRMATION_ERROR]
-        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_053: [If result is D2C_EVENT_SEND_COMPLETE_RESULT_ERROR_TIMEOUT, `iothub_send_result` shall be set using IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT]
-        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_054: [If result is D2C_EVENT_SEND_COMPLETE_RESULT_DEVICE_DESTROYED, `iothub_send_result` shall be set using IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY]
-        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_055: [If result is D2C_EVENT_SEND_COMPLETE_RESULT_ERROR_UNKNOWN, `iothub_send_result` shall be set using IOTHUB_CLIENT_CONFIRMATION_ERROR]
-        IOTHUB_CLIENT_CONFIRMATION_RESULT iothub_send_result = get_iothub_client_confirmation_result_from(result);
-
-        message->callback(iothub_send_result, message->context);
-    }
-
-    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_057: [`message->messageHandle` shall be destroyed using IoTHubMessage_Destroy]
-    IoTHubMessage_Destroy(message->messageHandle);
-    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_058: [`message` shall be destroyed using free]
-    free(message);
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_050: [If result is D2C_EVENT_SEND_COMPLETE_RESULT_OK, `iothub_send_result` shall be set using IOTHUB_CLIENT_CONFIRMATION_OK]
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_051: [If result is D2C_EVENT_SEND_COMPLETE_RESULT_ERROR_CANNOT_PARSE, `iothub_send_result` shall be set using IOTHUB_CLIENT_CONFIRMATION_ERROR]
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_052: [If result is D2C_EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING, `iothub_send_result` shall be set using IOTHUB_CLIENT_CONFIRMATION_ERROR]
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_053: [If result is D2C_EVENT_SEND_COMPLETE_RESULT_ERROR_TIMEOUT, `iothub_send_result` shall be set using IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT]
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_054: [If result is D2C_EVENT_SEND_COMPLETE_RESULT_DEVICE_DESTROYED, `iothub_send_result` shall be set using IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY]
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_055: [If result is D2C_EVENT_SEND_COMPLETE_RESULT_ERROR_UNKNOWN, `iothub_send_result` shall be set using IOTHUB_CLIENT_CONFIRMATION_ERROR]
+    IOTHUB_CLIENT_CONFIRMATION_RESULT iothub_send_result = get_iothub_client_confirmation_result_from(result);
+    DLIST_ENTRY completed;
+
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_10_010: [`message` shall be placed alone in a list and passed to IoTHubClient_LL_SendComplete with the `iothub_send_result`, which invokes the callback, destroys the message and releases the entry]
+    // The entry may be part of a block allocated by IoTHubClient_LL_SendEventBatchAsync, so only the client may release it.
+    DList_InitializeListHead(&completed);
+    DList_InsertTailList(&completed, &(message->entry));
+    IoTHubClient_LL_SendComplete(registered_device->iothub_client_handle, &completed, iothub_send_result);
 }
 
 // @brief
@@ -1287,15 +1251,15 @@ static int IoTHubTransport_AMQP_Common_Device_SetOption(TRANSPORT_LL_HANDLE hand
         AMQP_TRANSPORT_INSTANCE* instance = (AMQP_TRANSPORT_INSTANCE*)handle;
         result = RESULT_OK;
 
-        LIST_ITEM_HANDLE list_item = singlylinkedlist_get_head_item(instance->registered_devices);
+        DEVICE_INDEX_ITEM_HANDLE list_item = device_index_get_head_item(instance->registered_devices);
 
         while (list_item != NULL)
         {
             AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device;
 
-            if ((registered_device = (AMQP_TRANSPORT_DEVICE_INSTANCE*)singlylinkedlist_item_get_value(list_item)) == NULL)
+            if ((registered_device = (AMQP_TRANSPORT_DEVICE_INSTANCE*)device_index_item_get_value(list_item)) == NULL)
             {
-                LogError("failed setting option '%s' to registered device (singlylinkedlist_item_get_value failed)", option);
+                LogError("failed setting option '%s' to registered device (device_index_item_get_value failed)", option);
                 result = __FAILURE__;
                 break;
             }
@@ -1307,7 +1271,7 @@ static int IoTHubTransport_AMQP_Common_Device_SetOption(TRANSPORT_LL_HANDLE hand
                 break;
             }
 
-            list_item = singlylinkedlist_get_next_item(list_item);
+            list_item = device_index_get_next_item(list_item);
         }
     }
 
@@ -1322,16 +1286,16 @@ static void internal_destroy_instance(AMQP_TRANSPORT_INSTANCE* instance)
 
         if (instance->registered_devices != NULL)
         {
-            LIST_ITEM_HANDLE list_item = singlylinkedlist_get_head_item(instance->registered_devices);
+            DEVICE_INDEX_ITEM_HANDLE list_item = device_index_get_head_item(instance->registered_devices);
 
             while (list_item != NULL)
             {
-                AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device = (AMQP_TRANSPORT_DEVICE_INSTANCE*)singlylinkedlist_item_get_value(list_item);
-                list_item = singlylinkedlist_get_next_item(list_item);
+                AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device = (AMQP_TRANSPORT_DEVICE_INSTANCE*)device_index_item_get_value(list_item);
+                list_item = device_index_get_next_item(list_item);
                 IoTHubTransport_AMQP_Common_Unregister(registered_device);
             }
 
-            singlylinkedlist_destroy(instance->registered_devices);
+            device_index_destroy(instance->registered_devices);
         }
 
         if (instance->amqp_connection != NULL)
@@ -1436,11 +1400,11 @@ TRANSPORT_LL_HANDLE IoTHubTransport_AMQP_Common_Create(const IOTHUBTRANSPORT_CON
                 LogError("Failed to obtain the iothub target fqdn.");
                 result = NULL;
             }
-            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_008: [`instance->registered_devices` shall be set using singlylinkedlist_create()]
-            else if ((instance->registered_devices = singlylinkedlist_create()) == NULL)
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_008: [`instance->registered_devices` shall be set using device_index_create()]
+            else if ((instance->registered_devices = device_index_create()) == NULL)
             {
-                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_009: [If singlylinkedlist_create() fails, IoTHubTransport_AMQP_Common_Create shall fail and return NULL]
-                LogError("Failed to initialize the internal list of registered devices (singlylinkedlist_create failed)");
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_009: [If device_index_create() fails, IoTHubTransport_AMQP_Common_Create shall fail and return NULL]
+                LogError("Failed to initialize the internal index of registered devices (device_index_create failed)");
                 result = NULL;
             }
             else
@@ -1541,7 +1505,7 @@ void IoTHubTransport_AMQP_Common_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIEN
     else
     {
         AMQP_TRANSPORT_INSTANCE* transport_instance = (AMQP_TRANSPORT_INSTANCE*)handle;
-        LIST_ITEM_HANDLE list_item;
+        DEVICE_INDEX_ITEM_HANDLE list_item;
 
         if (transport_instance->state == AMQP_TRANSPORT_STATE_NOT_CONNECTED_NO_MORE_RETRIES)
         {
@@ -1567,13 +1531,13 @@ void IoTHubTransport_AMQP_Common_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIEN
             {
                 update_state(transport_instance, AMQP_TRANSPORT_STATE_NOT_CONNECTED_NO_MORE_RETRIES);
 
-                (void)singlylinkedlist_foreach(transport_instance->registered_devices, raise_connection_status_callback_retry_expired, NULL);
+                raise_connection_status_callback_retry_expired(transport_instance);
             }
         }
         else
         {
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_018: [If there are no devices registered on the transport, IoTHubTransport_AMQP_Common_DoWork shall skip do_work for devices]
-            if ((list_item = singlylinkedlist_get_head_item(transport_instance->registered_devices)) != NULL)
+            if ((list_item = device_index_get_head_item(transport_instance->registered_devices)) != NULL)
             {
                 // We need to check if there are devices, otherwise the amqp_connection won't be able to be created since
                 // there is not a preferred authentication mode set yet on the transport.
@@ -1593,7 +1557,7 @@ void IoTHubTransport_AMQP_Common_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIEN
                     {
                         AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device;
 
-                        if ((registered_device = (AMQP_TRANSPORT_DEVICE_INSTANCE*)singlylinkedlist_item_get_value(list_item)) == NULL)
+                        if ((registered_device = (AMQP_TRANSPORT_DEVICE_INSTANCE*)device_index_item_get_value(list_item)) == NULL)
                         {
                             LogError("Transport had an unexpected failure during DoWork (failed to fetch a registered_devices list item value)");
                         }
@@ -1614,7 +1578,7 @@ void IoTHubTransport_AMQP_Common_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIEN
                             }
                         }
 
-                        list_item = singlylinkedlist_get_next_item(list_item);
+                        list_item = device_index_get_next_item(list_item);
                     }
                 }
             }
@@ -1628,6 +1592,140 @@ void IoTHubTransport_AMQP_Common_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIEN
     }
 }
 
+// @brief
+//     Milliseconds left until `timeout_secs` have passed since `start_time` (0 if they already have).
+static uint64_t get_ms_until_timeout(time_t start_time, size_t timeout_secs, time_t current_time)
+{
+    uint64_t result;
+    double elapsed_secs = get_difftime(current_time, start_time);
+
+    if (elapsed_secs >= (double)timeout_secs)
+    {
+        result = 0;
+    }
+    else
+    {
+        result = (uint64_t)(((double)timeout_secs - elapsed_secs) * 1000);
+    }
+
+    return result;
+}
+
+static uint64_t get_device_ms_to_next_work(AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device, time_t current_time)
+{
+    uint64_t result;
+
+    if (registered_device->device_state == DEVICE_STATE_STARTING ||
+        registered_device->device_state == DEVICE_STATE_STOPPING)
+    {
+        result = get_ms_until_timeout(registered_device->time_of_last_state_change, registered_device->max_state_change_timeout_secs, current_time);
+    }
+    // DEVICE_STATE_STOPPED and the error states are acted upon by the very next DoWork.
+    else if (registered_device->device_state != DEVICE_STATE_STARTED)
+    {
+        result = 0;
+    }
+    else if ((registered_device->subscribe_methods_needed && !registered_device->subscribed_for_methods) ||
+        !DList_IsListEmpty(registered_device->waiting_to_send))
+    {
+        result = 0;
+    }
+    else if (registered_device->transport_instance->preferred_authentication_mode == AMQP_TRANSPORT_AUTHENTICATION_MODE_CBS &&
+        registered_device->transport_instance->option_sas_token_refresh_time_secs != 0)
+    {
+        // The CBS token is put again every `option_sas_token_refresh_time_secs` counting from when the device got authenticated.
+        size_t refresh_time_secs = registered_device->transport_instance->option_sas_token_refresh_time_secs;
+        double elapsed_secs = get_difftime(current_time, registered_device->time_of_last_state_change);
+        size_t elapsed_in_period_secs = (elapsed_secs < 0) ? 0 : (size_t)elapsed_secs % refresh_time_secs;
+
+        result = (uint64_t)(refresh_time_secs - elapsed_in_period_secs) * 1000;
+    }
+    else
+    {
+        result = IOTHUB_CLIENT_LL_NO_WORK_DEADLINE;
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubTransport_AMQP_Common_GetNextWorkDeadline(TRANSPORT_LL_HANDLE handle, uint64_t* msToNextWork)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_10_005: [If `handle` or `msToNextWork` are NULL, IoTHubTransport_AMQP_Common_GetNextWorkDeadline shall return IOTHUB_CLIENT_INVALID_ARG]
+    if (handle == NULL || msToNextWork == NULL)
+    {
+        LogError("Failed getting next work deadline (handle=%p, msToNextWork=%p)", handle, msToNextWork);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        AMQP_TRANSPORT_INSTANCE* transport_instance = (AMQP_TRANSPORT_INSTANCE*)handle;
+        DEVICE_INDEX_ITEM_HANDLE list_item;
+
+        result = IOTHUB_CLIENT_OK;
+
+        if (transport_instance->state == AMQP_TRANSPORT_STATE_NOT_CONNECTED_NO_MORE_RETRIES ||
+            transport_instance->state == AMQP_TRANSPORT_STATE_BEING_DESTROYED)
+        {
+            *msToNextWork = IOTHUB_CLIENT_LL_NO_WORK_DEADLINE;
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_10_006: [If `instance->state` is `RECONNECTION_REQUIRED`, `msToNextWork` shall be set to the interval the connection retry policy is checked at]
+        else if (transport_instance->state == AMQP_TRANSPORT_STATE_RECONNECTION_REQUIRED)
+        {
+            *msToNextWork = RETRY_CHECK_INTERVAL_MS;
+        }
+        else if ((list_item = device_index_get_head_item(transport_instance->registered_devices)) == NULL)
+        {
+            *msToNextWork = IOTHUB_CLIENT_LL_NO_WORK_DEADLINE;
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_10_007: [If `instance->amqp_connection` is NULL, `msToNextWork` shall be set to 0]
+        else if (transport_instance->amqp_connection == NULL)
+        {
+            *msToNextWork = 0;
+        }
+        else
+        {
+            // uamqp sends empty frames on the connection at a fraction of the idle timeout; this is approximated using the local settings.
+            uint64_t keep_alive_ms = (uint64_t)(transport_instance->svc2cl_keep_alive_timeout_secs * transport_instance->cl2svc_keep_alive_send_ratio * 1000);
+            *msToNextWork = (keep_alive_ms == 0) ? IOTHUB_CLIENT_LL_NO_WORK_DEADLINE : keep_alive_ms;
+
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_10_008: [If the amqp_connection is OPENED, `msToNextWork` shall be the earliest of the keep-alive, device state change timeouts, CBS token refreshes, or 0 if any registered device has pending events or method subscriptions]
+            if (transport_instance->amqp_connection_state == AMQP_CONNECTION_STATE_OPENED)
+            {
+                time_t current_time;
+
+                if ((current_time = get_time(NULL)) == INDEFINITE_TIME)
+                {
+                    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_10_009: [If get_time() fails, IoTHubTransport_AMQP_Common_GetNextWorkDeadline shall return IOTHUB_CLIENT_ERROR]
+                    LogError("Failed getting next work deadline (get_time failed)");
+                    result = IOTHUB_CLIENT_ERROR;
+                }
+                else
+                {
+                    while (list_item != NULL)
+                    {
+                        AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device;
+
+                        if ((registered_device = (AMQP_TRANSPORT_DEVICE_INSTANCE*)device_index_item_get_value(list_item)) != NULL)
+                        {
+                            uint64_t device_ms_to_next_work = get_device_ms_to_next_work(registered_device, current_time);
+                            if (device_ms_to_next_work < *msToNextWork)
+                            {
+                                *msToNextWork = device_ms_to_next_work;
+                            }
+                        }
+
+                        list_item = device_index_get_next_item(list_item);
+                    }
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
 int IoTHubTransport_AMQP_Common_Subscribe(IOTHUB_DEVICE_HANDLE handle)
 {
     int result;
@@ -1710,7 +1808,7 @@ int IoTHubTransport_AMQP_Common_Subscribe_DeviceTwin(IOTHUB_DEVICE_HANDLE handle
         }
         else
         {
-            LIST_ITEM_HANDLE list_item = singlylinkedlist_get_head_item(transport->registered_devices);
+            DEVICE_INDEX_ITEM_HANDLE list_item = device_index_get_head_item(transport->registered_devices);
 
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_136: [If no errors occur, `IoTHubTransport_AMQP_Common_Subscribe_DeviceTwin` shall return zero.]
             result = RESULT_OK;
@@ -1719,7 +1817,7 @@ int IoTHubTransport_AMQP_Common_Subscribe_DeviceTwin(IOTHUB_DEVICE_HANDLE handle
             {
                 AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device;
 
-                if ((registered_device = (AMQP_TRANSPORT_DEVICE_INSTANCE*)singlylinkedlist_item_get_value(list_item)) == NULL)
+                if ((registered_device = (AMQP_TRANSPORT_DEVICE_INSTANCE*)device_index_item_get_value(list_item)) == NULL)
                 {
                     LogError("Failed retrieving registered device information");
                     result = __FAILURE__;
@@ -1734,7 +1832,7 @@ int IoTHubTransport_AMQP_Common_Subscribe_DeviceTwin(IOTHUB_DEVICE_HANDLE handle
                     break;
                 }
 
-                list_item = singlylinkedlist_get_next_item(list_item);
+                list_item = device_index_get_next_item(list_item);
             }
         }
     }
@@ -1759,13 +1857,13 @@ void IoTHubTransport_AMQP_Common_Unsubscribe_DeviceTwin(IOTHUB_DEVICE_HANDLE han
         }
         else
         {
-            LIST_ITEM_HANDLE list_item = singlylinkedlist_get_head_item(transport->registered_devices);
+            DEVICE_INDEX_ITEM_HANDLE list_item = device_index_get_head_item(transport->registered_devices);
 
             while (list_item != NULL)
             {
                 AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device;
 
-                if ((registered_device = (AMQP_TRANSPORT_DEVICE_INSTANCE*)singlylinkedlist_item_get_value(list_item)) == NULL)
+                if ((registered_device = (AMQP_TRANSPORT_DEVICE_INSTANCE*)device_index_item_get_value(list_item)) == NULL)
                 {
                     LogError("Failed retrieving registered device information");
                     break;
@@ -1778,7 +1876,7 @@ void IoTHubTransport_AMQP_Common_Unsubscribe_DeviceTwin(IOTHUB_DEVICE_HANDLE han
                     break;
                 }
 
-                list_item = singlylinkedlist_get_next_item(list_item);
+                list_item = device_index_get_next_item(list_item);
             }
         }
     }
@@ -2145,7 +2243,7 @@ IOTHUB_DEVICE_HANDLE IoTHubTransport_AMQP_Common_Register(TRANSPORT_LL_HANDLE ha
     }
     else
     {
-        LIST_ITEM_HANDLE list_item;
+        DEVICE_INDEX_ITEM_HANDLE list_item;
         AMQP_TRANSPORT_INSTANCE* transport_instance = (AMQP_TRANSPORT_INSTANCE*)handle;
 
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_064: [If the device is already registered, IoTHubTransport_AMQP_Common_Register shall fail and return NULL.]
@@ -2224,7 +2322,7 @@ IOTHUB_DEVICE_HANDLE IoTHubTransport_AMQP_Common_Register(TRANSPORT_LL_HANDLE ha
                     }
                     else
                     {
-                        bool is_first_device_being_registered = (singlylinkedlist_get_head_item(transport_instance->registered_devices) == NULL);
+                        bool is_first_device_being_registered = (device_index_get_head_item(transport_instance->registered_devices) == NULL);
 
                         /* Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_01_010: [ `IoTHubTransport_AMQP_Common_Create` shall create a new iothubtransportamqp_methods instance by calling `iothubtransportamqp_methods_create` while passing to it the the fully qualified domain name and the device Id. ]*/
                         amqp_device_instance->methods_handle = iothubtransportamqp_methods_create(STRING_c_str(transport_instance->iothub_host_fqdn), device->deviceId);
@@ -2241,11 +2339,11 @@ IOTHUB_DEVICE_HANDLE IoTHubTransport_AMQP_Common_Register(TRANSPORT_LL_HANDLE ha
                                 LogError("Transport failed to register device '%s' (failed to replicate options)", device->deviceId);
                                 result = NULL;
                             }
-                            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_074: [IoTHubTransport_AMQP_Common_Register shall add the `amqp_device_instance` to `instance->registered_devices`]
-                            else if (singlylinkedlist_add(transport_instance->registered_devices, amqp_device_instance) == NULL)
+                            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_074: [IoTHubTransport_AMQP_Common_Register shall add the `amqp_device_instance` to `instance->registered_devices` under `device->deviceId`]
+                            else if (device_index_add(transport_instance->registered_devices, device->deviceId, amqp_device_instance) == NULL)
                             {
                                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_075: [If it fails to add `amqp_device_instance`, IoTHubTransport_AMQP_Common_Register shall fail and return NULL]
-                                LogError("Transport failed to register device '%s' (singlylinkedlist_add failed)", device->deviceId);
+                                LogError("Transport failed to register device '%s' (device_index_add failed)", device->deviceId);
                                 result = NULL;
                             }
                             else
@@ -2295,7 +2393,7 @@ void IoTHubTransport_AMQP_Common_Unregister(IOTHUB_DEVICE_HANDLE deviceHandle)
     {
         AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device = (AMQP_TRANSPORT_DEVICE_INSTANCE*)deviceHandle;
         const char* device_id;
-        LIST_ITEM_HANDLE list_item;
+        DEVICE_INDEX_ITEM_HANDLE list_item;
 
         if ((device_id = STRING_c_str(registered_device->device_id)) == NULL)
         {
@@ -2314,9 +2412,9 @@ void IoTHubTransport_AMQP_Common_Unregister(IOTHUB_DEVICE_HANDLE deviceHandle)
         else
         {
             // Removing it first so the race hazzard is reduced between this function and DoWork. Best would be to use locks.
-            if (singlylinkedlist_remove(registered_device->transport_instance->registered_devices, list_item) != RESULT_OK)
+            if (device_index_remove(registered_device->transport_instance->registered_devices, list_item) != RESULT_OK)
             {
-                LogError("Failed to unregister device '%s' (singlylinkedlist_remove failed).", device_id);
+                LogError("Failed to unregister device '%s' (device_index_remove failed).", device_id);
             }
             else
             {
@@ -21,7 +21,6 @@
 #include "azure_c_shared_utility/tlsio.h"
 #include "azure_c_shared_utility/platform.h"
 
-#include "azure_c_shared_utility/string_tokenizer.h"
 #include "azure_c_shared_utility/shared_util_options.h"
 #include "azure_c_shared_utility/urlencode.h"
 #include "iothub_client_version.h"
@@ -42,7 +41,7 @@
 #define DEFAULT_CONNACK_TIMEOUT             30 // 30 seconds
 #define BUILD_CONFIG_USERNAME               24
 #define SAS_TOKEN_DEFAULT_LEN               10
-#define RESEND_TIMEOUT_VALUE_MIN            1*60
+#define DEFAULT_RESEND_TIMEOUT_MS           (60 * 1000)
 #define MAX_SEND_RECOUNT_LIMIT              2
 #define DEFAULT_CONNECTION_INTERVAL         30
 #define FAILED_CONN_BACKOFF_VALUE           5
@@ -51,6 +50,14 @@
 
 #define DEFAULT_RETRY_POLICY                IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER
 #define DEFAULT_RETRY_TIMEOUT_IN_SECONDS    0
+#define RETRY_CHECK_INTERVAL_MS             1000 // retry_control works in whole seconds
+#define DEFAULT_MAX_IN_FLIGHT               0 // no limit until mqtt_max_in_flight is set
+#define INITIAL_ACK_INDEX_SIZE              16 // must be a power of 2
+#define INITIAL_TOPIC_PROPERTIES_SIZE       128
+#define SYSTEM_PROPERTY_COUNT               6
+#define TOPIC_SEGMENT_COUNT                 5 // $iothub/methods/POST/{method name}/?$rid={request id}
+#define TELEMETRY_TOPIC_SEPARATOR_COUNT     4 // devices/{device id}/messages/devicebound/{property bag}
+#define TOPIC_PROPERTIES_STACK_SIZE         512
 
 static const char TOPIC_DEVICE_TWIN_PREFIX[] = "$iothub/twin";
 static const char TOPIC_DEVICE_METHOD_PREFIX[] = "$iothub/methods";
@@ -66,11 +73,13 @@ static const char* TOPIC_DEVICE_METHOD_SUBSCRIBE = "$iothub/methods/POST/#";
 static const char* IOTHUB_API_VERSION = "2016-11-14";
 
 static const char* PROPERTY_SEPARATOR = "&";
+static const char* SYSTEM_PROPERTY_PREFIX = "%24.";
 static const char* REPORTED_PROPERTIES_TOPIC = "$iothub/twin/PATCH/properties/reported/?$rid=%"PRIu16;
 static const char* GET_PROPERTIES_TOPIC = "$iothub/twin/GET/?$rid=%"PRIu16;
 static const char* DEVICE_METHOD_RESPONSE_TOPIC = "$iothub/methods/res/%d/?$rid=%s";
 
 static const char* REQUEST_ID_PROPERTY = "?$rid=";
+static const char* TWIN_PATCH_SEGMENT = "PATCH";
 
 static const char* MESSAGE_ID_PROPERTY = "mid";
 static const char* CORRELATION_ID_PROPERTY = "cid";
@@ -105,11 +114,37 @@ static SYSTEM_PROPERTY_INFO sysPropList[] = {
     { "%24.cid", 7 },
     { "%24.ct", 6 },
     { "%24.ce", 6 },
-    { "devices/", 8 },
     { "iothub-operation", 16 },
     { "iothub-ack", 10 }
 };
 
+typedef struct TOPIC_PREFIX_INFO_TAG
+{
+    const char* prefix;
+    size_t prefixLength;
+    IOTHUB_IDENTITY_TYPE type;
+} TOPIC_PREFIX_INFO;
+
+static const TOPIC_PREFIX_INFO topicPrefixList[] = {
+    { TOPIC_DEVICE_TWIN_PREFIX, sizeof(TOPIC_DEVICE_TWIN_PREFIX) - 1, IOTHUB_TYPE_DEVICE_TWIN },
+    { TOPIC_DEVICE_METHOD_PREFIX, sizeof(TOPIC_DEVICE_METHOD_PREFIX) - 1, IOTHUB_TYPE_DEVICE_METHODS }
+};
+
+typedef struct TOPIC_SPAN_TAG
+{
+    const char* start;
+    size_t length;
+} TOPIC_SPAN;
+
+typedef struct PARSED_TOPIC_TAG
+{
+    IOTHUB_IDENTITY_TYPE type;
+    TOPIC_SPAN segments[TOPIC_SEGMENT_COUNT];
+    size_t segment_count;
+    TOPIC_SPAN request_id;
+    TOPIC_SPAN properties;
+} PARSED_TOPIC;
+
 typedef enum DEVICE_TWIN_MSG_TYPE_TAG
 {
     REPORTED_STATE,
@@ -135,7 +170,10 @@ typedef enum MQTT_CLIENT_STATUS_TAG
 typedef struct MQTTTRANSPORT_HANDLE_DATA_TAG
 {
     // Topic control
-    STRING_HANDLE topic_MqttEvent;
+    // devices/{id}/messages/events/ is rendered once; the properties of each telemetry message are written after it
+    char* topic_MqttEvent;
+    size_t topic_MqttEventPrefixLength;
+    size_t topic_MqttEventSize;
     STRING_HANDLE topic_MqttMessage;
     STRING_HANDLE topic_GetState;
     STRING_HANDLE topic_NotifyState;
@@ -196,6 +234,15 @@ typedef struct MQTTTRANSPORT_HANDLE_DATA_TAG
 
     // Telemetry specific
     DLIST_ENTRY telemetry_waitingForAck;
+    // The messages of telemetry_waitingForAck chained in buckets by packet_id, so a PUBACK finds its message in constant time.
+    // The index doubles when there are more messages than buckets; until then it uses the buckets embedded below.
+    struct MQTT_MESSAGE_DETAILS_LIST_TAG** telemetry_ackIndex;
+    size_t telemetry_ackIndexSize;
+    size_t telemetry_inFlightCount;
+    struct MQTT_MESSAGE_DETAILS_LIST_TAG* telemetry_initialAckIndex[INITIAL_ACK_INDEX_SIZE];
+    size_t max_in_flight; // 0 means no limit
+    tickcounter_ms_t resend_timeout_ms;
+    bool telemetry_at_most_once; // delivery of the messages left to IOTHUB_MESSAGE_DELIVERY_DEFAULT
 
     // Controls frequency of reconnection logic.
     RETRY_CONTROL_HANDLE retry_control_handle;
@@ -231,11 +278,12 @@ typedef struct MQTT_MESSAGE_DETAILS_LIST_TAG
     void* context;
     uint16_t packet_id;
     DLIST_ENTRY entry;
+    struct MQTT_MESSAGE_DETAILS_LIST_TAG* next_in_bucket;
 } MQTT_MESSAGE_DETAILS_LIST, *PMQTT_MESSAGE_DETAILS_LIST;
 
 typedef struct DEVICE_METHOD_INFO_TAG
 {
-    STRING_HANDLE request_id;
+    char* request_id; // lives in the same allocation, right after the structure
 } DEVICE_METHOD_INFO;
 
 static void free_proxy_data(MQTTTRANSPORT_HANDLE_DATA* mqtt_transport_instance)
@@ -287,7 +335,6 @@ static void free_transport_handle_data(MQTTTRANSPORT_HANDLE_DATA* transport_data
     free_proxy_data(transport_data);
 
     STRING_delete(transport_data->devicesPath);
-    STRING_delete(transport_data->topic_MqttEvent);
     STRING_delete(transport_data->topic_MqttMessage);
     STRING_delete(transport_data->device_id);
     STRING_delete(transport_data->hostAddress);
@@ -295,6 +342,13 @@ static void free_transport_handle_data(MQTTTRANSPORT_HANDLE_DATA* transport_data
     STRING_delete(transport_data->topic_GetState);
     STRING_delete(transport_data->topic_NotifyState);
     STRING_delete(transport_data->topic_DeviceMethods);
+
+    if (transport_data->telemetry_ackIndex != NULL && transport_data->telemetry_ackIndex != transport_data->telemetry_initialAckIndex)
+    {
+        free(transport_data->telemetry_ackIndex);
+    }
+
+    free(transport_data->topic_MqttEvent);
     
     free(transport_data);
 }
@@ -349,6 +403,84 @@ static uint16_t get_next_packet_id(PMQTTTRANSPORT_HANDLE_DATA transport_data)
     return transport_data->packetId;
 }
 
+/*when the larger index cannot be allocated the messages stay in longer chains*/
+static void grow_ack_index(PMQTTTRANSPORT_HANDLE_DATA transport_data)
+{
+    size_t new_size = transport_data->telemetry_ackIndexSize * 2;
+    MQTT_MESSAGE_DETAILS_LIST** new_index;
+
+    if (new_size < transport_data->telemetry_ackIndexSize ||
+        new_size > SIZE_MAX / sizeof(MQTT_MESSAGE_DETAILS_LIST*) ||
+        (new_index = (MQTT_MESSAGE_DETAILS_LIST**)malloc(new_size * sizeof(MQTT_MESSAGE_DETAILS_LIST*))) == NULL)
+    {
+        LogError("unable to grow the PUBACK index beyond %lu buckets", (unsigned long)transport_data->telemetry_ackIndexSize);
+    }
+    else
+    {
+        size_t i;
+        memset(new_index, 0, new_size * sizeof(MQTT_MESSAGE_DETAILS_LIST*));
+        for (i = 0; i < transport_data->telemetry_ackIndexSize; i++)
+        {
+            MQTT_MESSAGE_DETAILS_LIST* msg_entry = transport_data->telemetry_ackIndex[i];
+            while (msg_entry != NULL)
+            {
+                MQTT_MESSAGE_DETAILS_LIST* next_entry = msg_entry->next_in_bucket;
+                MQTT_MESSAGE_DETAILS_LIST** bucket = &new_index[msg_entry->packet_id & (new_size - 1)];
+                msg_entry->next_in_bucket = *bucket;
+                *bucket = msg_entry;
+                msg_entry = next_entry;
+            }
+        }
+
+        if (transport_data->telemetry_ackIndex != transport_data->telemetry_initialAckIndex)
+        {
+            free(transport_data->telemetry_ackIndex);
+        }
+        transport_data->telemetry_ackIndex = new_index;
+        transport_data->telemetry_ackIndexSize = new_size;
+    }
+}
+
+static void add_to_ack_index(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_MESSAGE_DETAILS_LIST* msg_entry)
+{
+    MQTT_MESSAGE_DETAILS_LIST** bucket;
+
+    if (transport_data->telemetry_inFlightCount >= transport_data->telemetry_ackIndexSize)
+    {
+        grow_ack_index(transport_data);
+    }
+
+    bucket = &transport_data->telemetry_ackIndex[msg_entry->packet_id & (transport_data->telemetry_ackIndexSize - 1)];
+    msg_entry->next_in_bucket = *bucket;
+    *bucket = msg_entry;
+    transport_data->telemetry_inFlightCount++;
+}
+
+/*removes msg_entry, or the first message with packet_id when msg_entry is NULL, from the index and returns it*/
+static MQTT_MESSAGE_DETAILS_LIST* remove_from_ack_index(PMQTTTRANSPORT_HANDLE_DATA transport_data, uint16_t packet_id, MQTT_MESSAGE_DETAILS_LIST* msg_entry)
+{
+    MQTT_MESSAGE_DETAILS_LIST* result;
+    MQTT_MESSAGE_DETAILS_LIST** link = &transport_data->telemetry_ackIndex[packet_id & (transport_data->telemetry_ackIndexSize - 1)];
+    while (*link != NULL && (msg_entry != NULL ? *link != msg_entry : (*link)->packet_id != packet_id))
+    {
+        link = &(*link)->next_in_bucket;
+    }
+
+    result = *link;
+    if (result != NULL)
+    {
+        *link = result->next_in_bucket;
+        result->next_in_bucket = NULL;
+        transport_data->telemetry_inFlightCount--;
+    }
+    return result;
+}
+
+static bool is_in_flight_window_full(PMQTTTRANSPORT_HANDLE_DATA transport_data)
+{
+    return transport_data->max_in_flight != 0 && transport_data->telemetry_inFlightCount >= transport_data->max_in_flight;
+}
+
 static const char* retrieve_mqtt_return_codes(CONNECT_RETURN_CODE rtn_code)
 {
     switch (rtn_code)
@@ -371,387 +503,320 @@ static const char* retrieve_mqtt_return_codes(CONNECT_RETURN_CODE rtn_code)
     }
 }
 
-static int retrieve_device_method_rid_info(const char* resp_topic, STRING_HANDLE method_name, STRING_HANDLE request_id)
+/* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_10_016: [ The topic of an incoming message shall be classified against the twin and methods prefixes and split into its segments, request id and property bag in a single pass, without copying any of it. ] */
+static void parse_topic(const char* topic, PARSED_TOPIC* parsed_topic)
 {
-    int result;
-    STRING_TOKENIZER_HANDLE token_handle = STRING_TOKENIZER_create_from_char(resp_topic);
-    if (token_handle == NULL)
-    {
-        LogError("Failed creating token from device twin topic.");
-        result = __FAILURE__;
-    }
-    else
+    size_t request_id_length = strlen(REQUEST_ID_PROPERTY);
+    const char* segment_start = topic;
+    const char* iterator;
+    size_t separator_count = 0;
+    size_t index;
+
+    parsed_topic->type = IOTHUB_TYPE_TELEMETRY;
+    for (index = 0; index < sizeof(topicPrefixList) / sizeof(topicPrefixList[0]); index++)
     {
-        STRING_HANDLE token_value;
-        if ((token_value = STRING_new()) == NULL)
+        size_t char_index = 0;
+        while (char_index < topicPrefixList[index].prefixLength && TOUPPER(topicPrefixList[index].prefix[char_index]) == TOUPPER(topic[char_index]))
         {
-            LogError("Failed allocating new string .");
-            result = __FAILURE__;
+            char_index++;
         }
-        else
+        if (char_index == topicPrefixList[index].prefixLength)
         {
-            size_t token_index = 0;
-            size_t request_id_length = strlen(REQUEST_ID_PROPERTY);
-            result = __FAILURE__;
-            while (STRING_TOKENIZER_get_next_token(token_handle, token_value, "/") == 0)
+            parsed_topic->type = topicPrefixList[index].type;
+            break;
+        }
+    }
+
+    parsed_topic->segment_count = 0;
+    parsed_topic->request_id.start = NULL;
+    parsed_topic->request_id.length = 0;
+    parsed_topic->properties.start = NULL;
+
+    for (iterator = topic; ; iterator++)
+    {
+        if (*iterator == '/' || *iterator == '\0')
+        {
+            // Empty segments are skipped, the way the string tokenizer did
+            if (iterator != segment_start && parsed_topic->segment_count < TOPIC_SEGMENT_COUNT)
             {
-                if (token_index == 3)
-                {
-                    if (STRING_concat_with_STRING(method_name, token_value) != 0)
-                    {
-                        LogError("Failed STRING_concat_with_STRING.");
-                        result = __FAILURE__;
-                        break;
-                    }
-                }
-                else if (token_index == 4)
+                TOPIC_SPAN* segment = &parsed_topic->segments[parsed_topic->segment_count++];
+                segment->start = segment_start;
+                segment->length = iterator - segment_start;
+                if (segment->length >= request_id_length && memcmp(segment->start, REQUEST_ID_PROPERTY, request_id_length) == 0)
                 {
-                    if (STRING_length(token_value) >= request_id_length)
+                    parsed_topic->request_id.start = segment->start + request_id_length;
+                    while (parsed_topic->request_id.start + parsed_topic->request_id.length < iterator &&
+                        parsed_topic->request_id.start[parsed_topic->request_id.length] != '&')
                     {
-                        const char* request_id_value = STRING_c_str(token_value);
-                        if (memcmp(request_id_value, REQUEST_ID_PROPERTY, request_id_length) == 0)
-                        {
-                            if (STRING_concat(request_id, request_id_value+request_id_length) != 0)
-                            {
-                                LogError("Failed STRING_concat failed.");
-                                result = __FAILURE__;
-                            }
-                            else
-                            {
-                                result = 0;
-                            }
-                            break;
-                        }
+                        parsed_topic->request_id.length++;
                     }
                 }
-                token_index++;
             }
-            STRING_delete(token_value);
+            if (*iterator == '\0')
+            {
+                break;
+            }
+            segment_start = iterator + 1;
+            /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_10_020: [ The property bag of a telemetry topic shall start after its devices/{device id}/messages/devicebound/ segments, so an '=' in the device id is not taken for a property. ] */
+            // Device ids cannot hold '/', but they may hold '=' and property values may hold '/'
+            if (++separator_count == TELEMETRY_TOPIC_SEPARATOR_COUNT)
+            {
+                parsed_topic->properties.start = segment_start;
+            }
         }
-        STRING_TOKENIZER_destroy(token_handle);
     }
-    return result;
+    if (parsed_topic->properties.start == NULL)
+    {
+        parsed_topic->properties.start = iterator;
+    }
+    parsed_topic->properties.length = iterator - parsed_topic->properties.start;
 }
 
-static int parse_device_twin_topic_info(const char* resp_topic, bool* patch_msg, size_t* request_id, int* status_code)
+static int parse_device_twin_topic_info(const PARSED_TOPIC* parsed_topic, bool* patch_msg, size_t* request_id, int* status_code)
 {
     int result;
-    STRING_TOKENIZER_HANDLE token_handle = STRING_TOKENIZER_create_from_char(resp_topic);
-    if (token_handle == NULL)
+    size_t patch_length = strlen(TWIN_PATCH_SEGMENT);
+    if (parsed_topic->segment_count > 2 && parsed_topic->segments[2].length == patch_length && memcmp(parsed_topic->segments[2].start, TWIN_PATCH_SEGMENT, patch_length) == 0)
     {
-        LogError("Failed creating token from device twin topic.");
-        result = __FAILURE__;
+        *patch_msg = true;
         *status_code = 0;
         *request_id = 0;
+        result = 0;
+    }
+    else if (parsed_topic->segment_count > 3)
+    {
+        // atol stops at the '/' ending the segment
         *patch_msg = false;
+        *status_code = (int)atol(parsed_topic->segments[3].start);
+        *request_id = (parsed_topic->request_id.start == NULL) ? 0 : (size_t)atol(parsed_topic->request_id.start);
+        result = 0;
     }
     else
     {
-        STRING_HANDLE token_value;
-        if ((token_value = STRING_new()) == NULL)
+        LogError("Failure: device twin topic has no status code");
+        *patch_msg = false;
+        *status_code = 0;
+        *request_id = 0;
+        result = __FAILURE__;
+    }
+    return result;
+}
+
+/* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_10_017: [ For a device method the method name and request id shall be copied from the topic into the single allocation holding the DEVICE_METHOD_INFO. ] */
+static DEVICE_METHOD_INFO* create_device_method_info(const PARSED_TOPIC* parsed_topic, const char** method_name)
+{
+    DEVICE_METHOD_INFO* result;
+    if (parsed_topic->segment_count < TOPIC_SEGMENT_COUNT || parsed_topic->request_id.start == NULL)
+    {
+        LogError("Failure: device method topic has no method name or request id");
+        result = NULL;
+    }
+    else
+    {
+        const TOPIC_SPAN* name = &parsed_topic->segments[3];
+        const TOPIC_SPAN* request_id = &parsed_topic->request_id;
+        if ((result = (DEVICE_METHOD_INFO*)malloc(sizeof(DEVICE_METHOD_INFO) + request_id->length + 1 + name->length + 1)) == NULL)
         {
-            LogError("Failed allocating new string .");
-            result = __FAILURE__;
-            *status_code = 0;
-            *request_id = 0;
-            *patch_msg = false;
+            LogError("Failure: allocating DEVICE_METHOD_INFO object");
         }
         else
         {
-            result = __FAILURE__;
-            size_t token_count = 0;
-            while (STRING_TOKENIZER_get_next_token(token_handle, token_value, "/") == 0)
-            {
-                if (token_count == 2)
-                {
-                    if (strcmp(STRING_c_str(token_value), "PATCH") == 0)
-                    {
-                        *patch_msg = true;
-                        *status_code = 0;
-                        *request_id = 0;
-                        result = 0;
-                        break;
-                    }
-                    else
-                    {
-                        *patch_msg = false;
-                    }
-                }
-                else if (token_count == 3)
-                {
-                    *status_code = (int)atol(STRING_c_str(token_value));
-                    if (STRING_TOKENIZER_get_next_token(token_handle, token_value, "/?$rid=") == 0)
-                    {
-                        *request_id = (size_t)atol(STRING_c_str(token_value));
-                    }
-                    *patch_msg = false;
-                    result = 0;
-                    break;
-                }
-                token_count++;
-            }
-            STRING_delete(token_value);
+            char* name_copy;
+            result->request_id = (char*)(result + 1);
+            (void)memcpy(result->request_id, request_id->start, request_id->length);
+            result->request_id[request_id->length] = '\0';
+
+            name_copy = result->request_id + request_id->length + 1;
+            (void)memcpy(name_copy, name->start, name->length);
+            name_copy[name->length] = '\0';
+            *method_name = name_copy;
         }
-        STRING_TOKENIZER_destroy(token_handle);
     }
     return result;
 }
 
-static IOTHUB_IDENTITY_TYPE retrieve_topic_type(const char* topic_resp)
+static void sendMsgComplete(IOTHUB_MESSAGE_LIST* iothubMsgList, PMQTTTRANSPORT_HANDLE_DATA transport_data, IOTHUB_CLIENT_CONFIRMATION_RESULT confirmResult)
+{
+    DLIST_ENTRY messageCompleted;
+    DList_InitializeListHead(&messageCompleted);
+    DList_InsertTailList(&messageCompleted, &(iothubMsgList->entry));
+    IoTHubClient_LL_SendComplete(transport_data->llClientHandle, &messageCompleted, confirmResult);
+}
+
+static char* write_topic_string(char* destination, const char* value)
 {
-    IOTHUB_IDENTITY_TYPE type;
-    size_t dev_twin_topic_len = sizeof(TOPIC_DEVICE_TWIN_PREFIX)-1;
-    size_t dev_method_topic_len = sizeof(TOPIC_DEVICE_METHOD_PREFIX)-1;
-    size_t topic_len = strlen(topic_resp);
-    size_t len_to_use = (dev_twin_topic_len > dev_method_topic_len) ? dev_twin_topic_len : dev_method_topic_len;
+    size_t length = strlen(value);
+    (void)memcpy(destination, value, length);
+    return destination + length;
+}
+
+/*on success the diagnostic values are returned in system_property_values; diag_context and encoded_diag_context must be released by the caller*/
+static int get_system_property_values(IOTHUB_MESSAGE_HANDLE iothub_message_handle, const char* system_property_values[SYSTEM_PROPERTY_COUNT], STRING_HANDLE* diag_context, STRING_HANDLE* encoded_diag_context)
+{
+    int result;
+    const IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA* diagnosticData;
 
-    bool search_device_twin = true;
-    bool search_device_method = true;
-    if (topic_len < len_to_use)
+    /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_07_052: [ IoTHubTransport_MQTT_Common_DoWork shall check for the CorrelationId property and if found add the value as a system property in the format of $.cid=<id> ] */
+    system_property_values[0] = IoTHubMessage_GetCorrelationId(iothub_message_handle);
+    /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_07_053: [ IoTHubTransport_MQTT_Common_DoWork shall check for the MessageId property and if found add the value as a system property in the format of $.mid=<id> ] */
+    system_property_values[1] = IoTHubMessage_GetMessageId(iothub_message_handle);
+    // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_010: [ `IoTHubTransport_MQTT_Common_DoWork` shall check for the ContentType property and if found add the `value` as a system property in the format of `$.ct=<value>` ]
+    system_property_values[2] = IoTHubMessage_GetContentTypeSystemProperty(iothub_message_handle);
+    // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_011: [ `IoTHubTransport_MQTT_Common_DoWork` shall check for the ContentEncoding property and if found add the `value` as a system property in the format of `$.ce=<value>` ]
+    system_property_values[3] = IoTHubMessage_GetContentEncodingSystemProperty(iothub_message_handle);
+    system_property_values[4] = NULL;
+    system_property_values[5] = NULL;
+
+    // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_014: [ `IoTHubTransport_MQTT_Common_DoWork` shall check for the diagnostic properties including diagid and diagCreationTimeUtc and if found both add them as system property in the format of `$.diagid` and `$.diagctx` respectively]
+    diagnosticData = IoTHubMessage_GetDiagnosticPropertyData(iothub_message_handle);
+    if (diagnosticData == NULL || (diagnosticData->diagnosticId == NULL && diagnosticData->diagnosticCreationTimeUtc == NULL))
     {
-        search_device_twin = false;
-        search_device_method = false;
+        result = 0;
     }
-    else
+    else if (diagnosticData->diagnosticId == NULL || diagnosticData->diagnosticCreationTimeUtc == NULL)
     {
-        size_t index = 0;
-        for (index = 0; index < len_to_use && (search_device_twin || search_device_method); index++)
-        {
-            if (search_device_twin)
-            {
-                if (index > dev_twin_topic_len)
-                {
-                    search_device_twin = false;
-                }
-                else
-                {
-                    if (index == dev_twin_topic_len)
-                    {
-                        break;
-                    }
-                    else if (TOUPPER(TOPIC_DEVICE_TWIN_PREFIX[index]) != TOUPPER(topic_resp[index]))
-                    {
-                        search_device_twin = false;
-                    }
-                }
-            }
-            if (search_device_method)
-            {
-                if (index > dev_method_topic_len)
-                {
-                    search_device_method = false;
-                }
-                else
-                {
-                    if (index == dev_method_topic_len)
-                    {
-                        break;
-                    }
-                    else if (TOUPPER(TOPIC_DEVICE_METHOD_PREFIX[index]) != TOUPPER(topic_resp[index]))
-                    {
-                        search_device_method = false;
-                    }
-                }
-            }
-        }
+        // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_015: [ `IoTHubTransport_MQTT_Common_DoWork` shall check whether diagid and diagCreationTimeUtc be present simultaneously, treat as error if not]
+        LogError("diagid and diagcreationtimeutc must be present simultaneously.");
+        result = __FAILURE__;
     }
-    if (search_device_twin)
+    //construct diagnostic context, it should be urlencode(key1=value1,key2=value2)
+    else if ((*diag_context = STRING_construct_sprintf("%s=%s", DIAGNOSTIC_CONTEXT_CREATION_TIME_UTC_PROPERTY, diagnosticData->diagnosticCreationTimeUtc)) == NULL)
     {
-        type = IOTHUB_TYPE_DEVICE_TWIN;
+        LogError("Failed constructing diagnostic context");
+        result = __FAILURE__;
     }
-    else if (search_device_method)
+    //Add other diagnostic context properties here if have more
+    else if ((*encoded_diag_context = URL_Encode(*diag_context)) == NULL ||
+        (system_property_values[5] = STRING_c_str(*encoded_diag_context)) == NULL)
     {
-        type = IOTHUB_TYPE_DEVICE_METHODS;
+        LogError("Failed encoding diagnostic context value");
+        result = __FAILURE__;
     }
     else
     {
-        type = IOTHUB_TYPE_TELEMETRY;
+        system_property_values[4] = diagnosticData->diagnosticId;
+        result = 0;
     }
-    return type;
-}
 
-static void sendMsgComplete(IOTHUB_MESSAGE_LIST* iothubMsgList, PMQTTTRANSPORT_HANDLE_DATA transport_data, IOTHUB_CLIENT_CONFIRMATION_RESULT confirmResult)
-{
-    DLIST_ENTRY messageCompleted;
-    DList_InitializeListHead(&messageCompleted);
-    DList_InsertTailList(&messageCompleted, &(iothubMsgList->entry));
-    IoTHubClient_LL_SendComplete(transport_data->llClientHandle, &messageCompleted, confirmResult);
+    return result;
 }
 
-static STRING_HANDLE addPropertiesTouMqttMessage(IOTHUB_MESSAGE_HANDLE iothub_message_handle, const char* eventTopic)
+/*returns the publish topic of a telemetry message, written in the topic buffer of the transport, which is only valid until the next call*/
+static const char* build_telemetry_topic(PMQTTTRANSPORT_HANDLE_DATA transport_data, IOTHUB_MESSAGE_HANDLE iothub_message_handle)
 {
-    STRING_HANDLE result = STRING_construct(eventTopic);
-    const char* const* propertyKeys;
-    const char* const* propertyValues;
-    size_t propertyCount;
-    size_t index = 0;
+    const char* result;
+    const char* const* propertyKeys = NULL;
+    const char* const* propertyValues = NULL;
+    size_t propertyCount = 0;
+    const char* system_property_values[SYSTEM_PROPERTY_COUNT];
+    const char* system_property_names[SYSTEM_PROPERTY_COUNT] = { CORRELATION_ID_PROPERTY, MESSAGE_ID_PROPERTY, CONTENT_TYPE_PROPERTY, CONTENT_ENCODING_PROPERTY, DIAGNOSTIC_ID_PROPERTY, DIAGNOSTIC_CONTEXT_PROPERTY };
+    STRING_HANDLE diag_context = NULL;
+    STRING_HANDLE encoded_diag_context = NULL;
 
     // Construct Properties
-    MAP_HANDLE properties_map = IoTHubMessage_Properties(iothub_message_handle);
-    if (properties_map != NULL)
+    MAP_HANDLE properties_map = IoTHubMessage_GetReadOnlyProperties(iothub_message_handle);
+    if (properties_map == NULL)
     {
-        if (Map_GetInternals(properties_map, &propertyKeys, &propertyValues, &propertyCount) != MAP_OK)
-        {
-            LogError("Failed to get the internals of the property map.");
-            STRING_delete(result);
-            result = NULL;
-        }
-        else
-        {
-            if (propertyCount != 0)
-            {
-                for (index = 0; index < propertyCount && result != NULL; index++)
-                {
-                    if (STRING_sprintf(result, "%s=%s%s", propertyKeys[index], propertyValues[index], propertyCount - 1 == index ? "" : PROPERTY_SEPARATOR) != 0)
-                    {
-                        LogError("Failed construting property string.");
-                        STRING_delete(result);
-                        result = NULL;
-                    }
-                }
-            }
-        }
+        /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_10_019: [ If the properties of a telemetry message cannot be obtained, IoTHubTransport_MQTT_Common_DoWork shall fail to publish it instead of publishing it without its properties. ] */
+        LogError("Failed to get the property map of the message.");
+        result = NULL;
     }
-
-    /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_07_052: [ IoTHubTransport_MQTT_Common_DoWork shall check for the CorrelationId property and if found add the value as a system property in the format of $.cid=<id> ] */
-    if (result != NULL)
+    else if (Map_GetInternals(properties_map, &propertyKeys, &propertyValues, &propertyCount) != MAP_OK)
     {
-        const char* correlation_id = IoTHubMessage_GetCorrelationId(iothub_message_handle);
-        if (correlation_id != NULL)
-        {
-            if (STRING_sprintf(result, "%s%%24.cid=%s", index == 0 ? "" : PROPERTY_SEPARATOR, correlation_id) != 0)
-            {
-                LogError("Failed setting correlation id.");
-                STRING_delete(result);
-                result = NULL;
-            }
-            index++;
-        }
+        LogError("Failed to get the internals of the property map.");
+        result = NULL;
     }
-
-    /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_07_053: [ IoTHubTransport_MQTT_Common_DoWork shall check for the MessageId property and if found add the value as a system property in the format of $.mid=<id> ] */
-    if (result != NULL)
+    else if (get_system_property_values(iothub_message_handle, system_property_values, &diag_context, &encoded_diag_context) != 0)
     {
-        const char* msg_id = IoTHubMessage_GetMessageId(iothub_message_handle);
-        if (msg_id != NULL)
-        {
-            if (STRING_sprintf(result, "%s%%24.mid=%s", index == 0 ? "" : PROPERTY_SEPARATOR, msg_id) != 0)
-            {
-                LogError("Failed setting message id.");
-                STRING_delete(result);
-                result = NULL;
-            }
-            index++;
-        }
+        LogError("Failed getting the system properties of the message.");
+        result = NULL;
     }
-
-    // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_010: [ `IoTHubTransport_MQTT_Common_DoWork` shall check for the ContentType property and if found add the `value` as a system property in the format of `$.ct=<value>` ]
-    if (result != NULL)
+    else
     {
-        const char* content_type = IoTHubMessage_GetContentTypeSystemProperty(iothub_message_handle);
-        if (content_type != NULL)
+        /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_10_013: [ IoTHubTransport_MQTT_Common_DoWork shall compute the length of the topic of a telemetry message first, and write the properties after the topic prefix rendered when the transport was created, growing the topic buffer only when it is too small. ] */
+        size_t topic_length = transport_data->topic_MqttEventPrefixLength;
+        size_t written_properties = 0;
+        size_t index;
+
+        for (index = 0; index < propertyCount; index++)
         {
-            if (STRING_sprintf(result, "%s%%24.%s=%s", index == 0 ? "" : PROPERTY_SEPARATOR, CONTENT_TYPE_PROPERTY, content_type) != 0)
+            topic_length += (written_properties++ == 0 ? 0 : 1) + strlen(propertyKeys[index]) + 1 + strlen(propertyValues[index]);
+        }
+        for (index = 0; index < SYSTEM_PROPERTY_COUNT; index++)
+        {
+            if (system_property_values[index] != NULL)
             {
-                LogError("Failed setting content type.");
-                STRING_delete(result);
-                result = NULL;
+                topic_length += (written_properties++ == 0 ? 0 : 1) + strlen(SYSTEM_PROPERTY_PREFIX) + strlen(system_property_names[index]) + 1 + strlen(system_property_values[index]);
             }
-            index++;
         }
-    }
 
-    // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_011: [ `IoTHubTransport_MQTT_Common_DoWork` shall check for the ContentEncoding property and if found add the `value` as a system property in the format of `$.ce=<value>` ]
-    if (result != NULL)
-    {
-        const char* content_encoding = IoTHubMessage_GetContentEncodingSystemProperty(iothub_message_handle);
-        if (content_encoding != NULL)
+        if (topic_length >= transport_data->topic_MqttEventSize)
         {
-            if (STRING_sprintf(result, "%s%%24.%s=%s", index == 0 ? "" : PROPERTY_SEPARATOR, CONTENT_ENCODING_PROPERTY, content_encoding) != 0)
+            char* new_topic = (char*)realloc(transport_data->topic_MqttEvent, topic_length + 1);
+            if (new_topic == NULL)
             {
-                LogError("Failed setting content encoding.");
-                STRING_delete(result);
-                result = NULL;
+                LogError("Failed growing the topic buffer to %lu bytes", (unsigned long)(topic_length + 1));
+            }
+            else
+            {
+                transport_data->topic_MqttEvent = new_topic;
+                transport_data->topic_MqttEventSize = topic_length + 1;
             }
-            index++;
         }
-    }
 
-    // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_014: [ `IoTHubTransport_MQTT_Common_DoWork` shall check for the diagnostic properties including diagid and diagCreationTimeUtc and if found both add them as system property in the format of `$.diagid` and `$.diagctx` respectively]
-    if (result != NULL)
-    {
-        const IOTHUB_MESSAGE_DIAGNOSTIC_PROPERTY_DATA* diagnosticData = IoTHubMessage_GetDiagnosticPropertyData(iothub_message_handle);
-        if (diagnosticData != NULL)
+        if (topic_length >= transport_data->topic_MqttEventSize)
         {
-            const char* diag_id = diagnosticData->diagnosticId;
-            const char* creation_time_utc = diagnosticData->diagnosticCreationTimeUtc;
-            //diagid and creationtimeutc must be present/unpresent simultaneously
-            if (diag_id != NULL && creation_time_utc != NULL)
+            result = NULL;
+        }
+        else
+        {
+            char* destination = transport_data->topic_MqttEvent + transport_data->topic_MqttEventPrefixLength;
+            written_properties = 0;
+            for (index = 0; index < propertyCount; index++)
             {
-                if (STRING_sprintf(result, "%s%%24.%s=%s", index == 0 ? "" : PROPERTY_SEPARATOR, DIAGNOSTIC_ID_PROPERTY, diag_id) != 0)
+                if (written_properties++ != 0)
                 {
-                    LogError("Failed setting diagnostic id");
-                    STRING_delete(result);
-                    result = NULL;
+                    destination = write_topic_string(destination, PROPERTY_SEPARATOR);
                 }
-                index++;
-
-                if (result != NULL)
+                destination = write_topic_string(destination, propertyKeys[index]);
+                *destination++ = '=';
+                destination = write_topic_string(destination, propertyValues[index]);
+            }
+            for (index = 0; index < SYSTEM_PROPERTY_COUNT; index++)
+            {
+                if (system_property_values[index] != NULL)
                 {
-                    //construct diagnostic context, it should be urlencode(key1=value1,key2=value2)
-                    STRING_HANDLE diagContextHandle = STRING_construct_sprintf("%s=%s", DIAGNOSTIC_CONTEXT_CREATION_TIME_UTC_PROPERTY, creation_time_utc);
-                    if (diagContextHandle == NULL)
+                    if (written_properties++ != 0)
                     {
-                        LogError("Failed constructing diagnostic context");
-                        STRING_delete(result);
-                        result = NULL;
-                    }
-                    else
-                    {
-                        //Add other diagnostic context properties here if have more
-                        STRING_HANDLE encodedContextValueHandle = URL_Encode(diagContextHandle);
-                        const char* encodedContextValueString = NULL;
-                        if (encodedContextValueHandle != NULL &&
-                            (encodedContextValueString = STRING_c_str(encodedContextValueHandle)) != NULL)
-                        {
-                            if (STRING_sprintf(result, "%s%%24.%s=%s", index == 0 ? "" : PROPERTY_SEPARATOR, DIAGNOSTIC_CONTEXT_PROPERTY, encodedContextValueString) != 0)
-                            {
-                                LogError("Failed setting diagnostic context");
-                                STRING_delete(result);
-                                result = NULL;
-                            }
-                            STRING_delete(encodedContextValueHandle);
-                            encodedContextValueHandle = NULL;
-                        }
-                        else
-                        {
-                            LogError("Failed encoding diagnostic context value");
-                            STRING_delete(result);
-                            result = NULL;
-                        }
-                        STRING_delete(diagContextHandle);
-                        diagContextHandle = NULL;
-                        index++;
+                        destination = write_topic_string(destination, PROPERTY_SEPARATOR);
                     }
+                    destination = write_topic_string(destination, SYSTEM_PROPERTY_PREFIX);
+                    destination = write_topic_string(destination, system_property_names[index]);
+                    *destination++ = '=';
+                    destination = write_topic_string(destination, system_property_values[index]);
                 }
             }
-            else if (diag_id != NULL || creation_time_utc != NULL)
-            {
-                // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_015: [ `IoTHubTransport_MQTT_Common_DoWork` shall check whether diagid and diagCreationTimeUtc be present simultaneously, treat as error if not]
-                LogError("diagid and diagcreationtimeutc must be present simultaneously.");
-                STRING_delete(result);
-                result = NULL;
-            }
+            *destination = '\0';
+            result = transport_data->topic_MqttEvent;
         }
     }
 
+    if (encoded_diag_context != NULL)
+    {
+        STRING_delete(encoded_diag_context);
+    }
+    if (diag_context != NULL)
+    {
+        STRING_delete(diag_context);
+    }
+
     return result;
 }
 
-static int publish_mqtt_telemetry_msg(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry, const unsigned char* payload, size_t len)
+static int publish_telemetry_payload(PMQTTTRANSPORT_HANDLE_DATA transport_data, IOTHUB_MESSAGE_HANDLE messageHandle, uint16_t packet_id, QOS_VALUE qos, const unsigned char* payload, size_t len)
 {
     int result;
-    STRING_HANDLE msgTopic = addPropertiesTouMqttMessage(mqttMsgEntry->iotHubMessageEntry->messageHandle, STRING_c_str(transport_data->topic_MqttEvent));
+    const char* msgTopic = build_telemetry_topic(transport_data, messageHandle);
     if (msgTopic == NULL)
     {
         LogError("Failed adding properties to mqtt message");
@@ -759,7 +824,7 @@ static int publish_mqtt_telemetry_msg(PMQTTTRANSPORT_HANDLE_DATA transport_data,
     }
     else
     {
-        MQTT_MESSAGE_HANDLE mqttMsg = mqttmessage_create(mqttMsgEntry->packet_id, STRING_c_str(msgTopic), DELIVER_AT_LEAST_ONCE, payload, len);
+        MQTT_MESSAGE_HANDLE mqttMsg = mqttmessage_create(packet_id, msgTopic, qos, payload, len);
         if (mqttMsg == NULL)
         {
             LogError("Failed creating mqtt message");
@@ -767,37 +832,49 @@ static int publish_mqtt_telemetry_msg(PMQTTTRANSPORT_HANDLE_DATA transport_data,
         }
         else
         {
-            if (tickcounter_get_current_ms(transport_data->msgTickCounter, &mqttMsgEntry->msgPublishTime) != 0)
+            if (mqtt_client_publish(transport_data->mqttClient, mqttMsg) != 0)
             {
-                LogError("Failed retrieving tickcounter info");
+                LogError("Failed attempting to publish mqtt message");
                 result = __FAILURE__;
             }
             else
             {
-                if (mqtt_client_publish(transport_data->mqttClient, mqttMsg) != 0)
-                {
-                    LogError("Failed attempting to publish mqtt message");
-                    result = __FAILURE__;
-                }
-                else
-                {
-                    mqttMsgEntry->retryCount++;
-                    result = 0;
-                }
+                result = 0;
             }
             mqttmessage_destroy(mqttMsg);
         }
-        STRING_delete(msgTopic);
     }
     return result;
 }
 
-static int publish_device_method_message(MQTTTRANSPORT_HANDLE_DATA* transport_data, int status_code, STRING_HANDLE request_id, const unsigned char* response, size_t response_size)
+static int publish_mqtt_telemetry_msg(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry, const unsigned char* payload, size_t len, tickcounter_ms_t current_ms)
+{
+    int result;
+    if (publish_telemetry_payload(transport_data, mqttMsgEntry->iotHubMessageEntry->messageHandle, mqttMsgEntry->packet_id, DELIVER_AT_LEAST_ONCE, payload, len) != 0)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        mqttMsgEntry->msgPublishTime = current_ms;
+        mqttMsgEntry->retryCount++;
+        result = 0;
+    }
+    return result;
+}
+
+static bool is_delivered_at_most_once(PMQTTTRANSPORT_HANDLE_DATA transport_data, IOTHUB_MESSAGE_HANDLE messageHandle)
+{
+    IOTHUB_MESSAGE_DELIVERY delivery = IoTHubMessage_GetDelivery(messageHandle);
+    return delivery == IOTHUB_MESSAGE_DELIVERY_AT_MOST_ONCE || (delivery == IOTHUB_MESSAGE_DELIVERY_DEFAULT && transport_data->telemetry_at_most_once);
+}
+
+static int publish_device_method_message(MQTTTRANSPORT_HANDLE_DATA* transport_data, int status_code, const char* request_id, const unsigned char* response, size_t response_size)
 {
     int result;
     uint16_t packet_id = get_next_packet_id(transport_data);
 
-    STRING_HANDLE msg_topic = STRING_construct_sprintf(DEVICE_METHOD_RESPONSE_TOPIC, status_code, STRING_c_str(request_id) );
+    STRING_HANDLE msg_topic = STRING_construct_sprintf(DEVICE_METHOD_RESPONSE_TOPIC, status_code, request_id);
     if (msg_topic == NULL)
     {
         LogError("Failed constructing message topic.");
@@ -931,14 +1008,14 @@ static int publish_device_twin_message(MQTTTRANSPORT_HANDLE_DATA* transport_data
     return result;
 }
 
-static bool isSystemProperty(const char* tokenData)
+static bool isSystemProperty(const char* propName, size_t nameLen)
 {
     bool result = false;
     size_t propCount = sizeof(sysPropList)/sizeof(sysPropList[0]);
     size_t index = 0;
     for (index = 0; index < propCount; index++)
     {
-        if (memcmp(tokenData, sysPropList[index].propName, sysPropList[index].propLength) == 0)
+        if (nameLen >= sysPropList[index].propLength && memcmp(propName, sysPropList[index].propName, sysPropList[index].propLength) == 0)
         {
             result = true;
             break;
@@ -997,140 +1074,69 @@ static int setMqttMessagePropertyIfPossible(IOTHUB_MESSAGE_HANDLE IoTHubMessage,
     return result;
 }
 
-static int extractMqttProperties(IOTHUB_MESSAGE_HANDLE IoTHubMessage, const char* topic_name)
+/* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_10_018: [ The property bag of a telemetry topic shall be copied once into a scratch buffer, on the stack unless it is larger than 512 bytes, and each name and value shall be terminated in place before being handed to the message. ] */
+static int extractMqttProperties(IOTHUB_MESSAGE_HANDLE IoTHubMessage, const TOPIC_SPAN* properties)
 {
     int result;
-    STRING_HANDLE mqttTopic = STRING_construct(topic_name);
-    if (mqttTopic == NULL)
+    MAP_HANDLE propertyMap = IoTHubMessage_Properties(IoTHubMessage);
+    if (propertyMap == NULL)
     {
-        LogError("Failure constructing string topic name.");
+        LogError("Failure to retrieve IoTHubMessage_properties.");
         result = __FAILURE__;
     }
     else
     {
-        STRING_TOKENIZER_HANDLE token = STRING_TOKENIZER_create(mqttTopic);
-        if (token != NULL)
+        char stack_buffer[TOPIC_PROPERTIES_STACK_SIZE];
+        char* buffer = (properties->length < sizeof(stack_buffer)) ? stack_buffer : (char*)malloc(properties->length + 1);
+        if (buffer == NULL)
         {
-            MAP_HANDLE propertyMap = IoTHubMessage_Properties(IoTHubMessage);
-            if (propertyMap == NULL)
-            {
-                LogError("Failure to retrieve IoTHubMessage_properties.");
-                result = __FAILURE__;
-            }
-            else
+            LogError("Failure allocating the property buffer");
+            result = __FAILURE__;
+        }
+        else
+        {
+            char* property = buffer;
+            (void)memcpy(buffer, properties->start, properties->length);
+            buffer[properties->length] = '\0';
+
+            result = 0;
+            while (property != NULL && result == 0)
             {
-                STRING_HANDLE output = STRING_new();
-                if (output == NULL)
+                char* next_property = strchr(property, PROPERTY_SEPARATOR[0]);
+                char* value;
+                if (next_property != NULL)
                 {
-                    LogError("Failure to allocate STRING_new.");
-                    result = __FAILURE__;
+                    *next_property++ = '\0';
                 }
-                else
+
+                // Properties without a value, like %24.cid, are ignored
+                if ((value = strchr(property, '=')) != NULL)
                 {
-                    result = 0;
+                    size_t nameLen = value - property;
+                    *value++ = '\0';
 
-                    while (STRING_TOKENIZER_get_next_token(token, output, PROPERTY_SEPARATOR) == 0 && result == 0)
+                    if (isSystemProperty(property, nameLen))
                     {
-                        const char* tokenData = STRING_c_str(output);
-                        size_t tokenLen = strlen(tokenData);
-                        if (tokenData == NULL || tokenLen == 0)
+                        if (setMqttMessagePropertyIfPossible(IoTHubMessage, property, value, nameLen) != 0)
                         {
-                            break;
-                        }
-                        else
-                        {
-                            if (isSystemProperty(tokenData))
-                            {
-                                const char* iterator = tokenData;
-                                while (iterator != NULL && *iterator != '\0' && result == 0)
-                                {
-                                    if (*iterator == '=')
-                                    {
-                                        size_t nameLen = iterator - tokenData;
-                                        char* propName = malloc(nameLen + 1);
-
-                                        size_t valLen = tokenLen - (nameLen + 1) + 1;
-                                        char* propValue = malloc(valLen + 1);
-
-                                        if (propName == NULL || propValue == NULL)
-                                        {
-                                            LogError("Failed allocating property name (%p) and/or value (%p)", propName, propValue);
-                                            result = __FAILURE__;
-                                        }
-                                        else
-                                        {
-                                            strncpy(propName, tokenData, nameLen);
-                                            propName[nameLen] = '\0';
-
-                                            strncpy(propValue, iterator + 1, valLen);
-                                            propValue[valLen] = '\0';
-
-                                            if (setMqttMessagePropertyIfPossible(IoTHubMessage, propName, propValue, nameLen) != 0)
-                                            {
-                                                LogError("Unable to set message property");
-                                                result = __FAILURE__;
-                                            }
-                                        }
-                                        free(propName);
-                                        free(propValue);
-
-                                        break;
-                                    }
-                                    iterator++;
-                                }
-                            }
-                            else
-                            {
-                                const char* iterator = tokenData;
-                                while (iterator != NULL && *iterator != '\0' && result == 0)
-                                {
-                                    if (*iterator == '=')
-                                    {
-                                        size_t nameLen = iterator - tokenData;
-                                        char* propName = malloc(nameLen + 1);
-
-                                        size_t valLen = tokenLen - (nameLen + 1) + 1;
-                                        char* propValue = malloc(valLen + 1);
-
-                                        if (propName == NULL || propValue == NULL)
-                                        {
-                                            result = __FAILURE__;
-                                        }
-                                        else
-                                        {
-                                            strncpy(propName, tokenData, nameLen);
-                                            propName[nameLen] = '\0';
-
-                                            strncpy(propValue, iterator + 1, valLen);
-                                            propValue[valLen] = '\0';
-
-                                            if (Map_AddOrUpdate(propertyMap, propName, propValue) != MAP_OK)
-                                            {
-                                                LogError("Map_AddOrUpdate failed.");
-                                                result = __FAILURE__;
-                                            }
-                                        }
-                                        free(propName);
-                                        free(propValue);
-
-                                        break;
-                                    }
-                                    iterator++;
-                                }
-                            }
+                            LogError("Unable to set message property");
+                            result = __FAILURE__;
                         }
                     }
-                    STRING_delete(output);
+                    else if (Map_AddOrUpdate(propertyMap, property, value) != MAP_OK)
+                    {
+                        LogError("Map_AddOrUpdate failed.");
+                        result = __FAILURE__;
+                    }
                 }
+                property = next_property;
+            }
+
+            if (buffer != stack_buffer)
+            {
+                free(buffer);
             }
-            STRING_TOKENIZER_destroy(token);
-        }
-        else
-        {
-            LogError("Unable to create Tokenizer object.");
-            result = __FAILURE__;
         }
-        STRING_delete(mqttTopic);
     }
     return result;
 }
@@ -1150,13 +1156,14 @@ static void mqtt_notification_callback(MQTT_MESSAGE_HANDLE msgHandle, void* call
         {
             PMQTTTRANSPORT_HANDLE_DATA transportData = (PMQTTTRANSPORT_HANDLE_DATA)callbackCtx;
 
-            IOTHUB_IDENTITY_TYPE type = retrieve_topic_type(topic_resp);
-            if (type == IOTHUB_TYPE_DEVICE_TWIN)
+            PARSED_TOPIC parsed_topic;
+            parse_topic(topic_resp, &parsed_topic);
+            if (parsed_topic.type == IOTHUB_TYPE_DEVICE_TWIN)
             {
                 size_t request_id;
                 int status_code;
                 bool notification_msg;
-                if (parse_device_twin_topic_info(topic_resp, &notification_msg, &request_id, &status_code) != 0)
+                if (parse_device_twin_topic_info(&parsed_topic, &notification_msg, &request_id, &status_code) != 0)
                 {
                     LogError("Failure: parsing device topic info");
                 }
@@ -1196,47 +1203,23 @@ static void mqtt_notification_callback(MQTT_MESSAGE_HANDLE msgHandle, void* call
                     }
                 }
             }
-            else if (type == IOTHUB_TYPE_DEVICE_METHODS)
+            else if (parsed_topic.type == IOTHUB_TYPE_DEVICE_METHODS)
             {
-                STRING_HANDLE method_name = STRING_new();
-                if (method_name == NULL)
+                const char* method_name;
+                DEVICE_METHOD_INFO* dev_method_info = create_device_method_info(&parsed_topic, &method_name);
+                if (dev_method_info == NULL)
                 {
-                    LogError("Failure: allocating method_name string value");
+                    LogError("Failure: retrieve device topic info");
                 }
                 else
                 {
-                    DEVICE_METHOD_INFO* dev_method_info = malloc(sizeof(DEVICE_METHOD_INFO) );
-                    if (dev_method_info == NULL)
+                    /* CodesSRS_IOTHUB_MQTT_TRANSPORT_07_053: [ If type is IOTHUB_TYPE_DEVICE_METHODS, then on success mqtt_notification_callback shall call IoTHubClient_LL_DeviceMethodComplete. ] */
+                    const APP_PAYLOAD* payload = mqttmessage_getApplicationMsg(msgHandle);
+                    if (IoTHubClient_LL_DeviceMethodComplete(transportData->llClientHandle, method_name, payload->message, payload->length, (void*)dev_method_info) != 0)
                     {
-                        LogError("Failure: allocating DEVICE_METHOD_INFO object");
+                        LogError("Failure: IoTHubClient_LL_DeviceMethodComplete");
+                        free(dev_method_info);
                     }
-                    else
-                    {
-                        dev_method_info->request_id = STRING_new();
-                        if (dev_method_info->request_id == NULL)
-                        {
-                            LogError("Failure constructing request_id string");
-                            free(dev_method_info);
-                        }
-                        else if (retrieve_device_method_rid_info(topic_resp, method_name, dev_method_info->request_id) != 0)
-                        {
-                            LogError("Failure: retrieve device topic info");
-                            STRING_delete(dev_method_info->request_id);
-                            free(dev_method_info);
-                        }
-                        else
-                        {
-                            /* CodesSRS_IOTHUB_MQTT_TRANSPORT_07_053: [ If type is IOTHUB_TYPE_DEVICE_METHODS, then on success mqtt_notification_callback shall call IoTHubClient_LL_DeviceMethodComplete. ] */
-                            const APP_PAYLOAD* payload = mqttmessage_getApplicationMsg(msgHandle);
-                            if (IoTHubClient_LL_DeviceMethodComplete(transportData->llClientHandle, STRING_c_str(method_name), payload->message, payload->length, (void*)dev_method_info) != 0)
-                            {
-                                LogError("Failure: IoTHubClient_LL_DeviceMethodComplete");
-                                STRING_delete(dev_method_info->request_id);
-                                free(dev_method_info);
-                            }
-                        }
-                    }
-                    STRING_delete(method_name);
                 }
             }
             else
@@ -1250,7 +1233,7 @@ static void mqtt_notification_callback(MQTT_MESSAGE_HANDLE msgHandle, void* call
                 else
                 {
                     // Will need to update this when the service has messages that can be rejected
-                    if (extractMqttProperties(IoTHubMessage, topic_resp) != 0)
+                    if (extractMqttProperties(IoTHubMessage, &parsed_topic.properties) != 0)
                     {
                         LogError("failure extracting mqtt properties.");
                     }
@@ -1297,20 +1280,13 @@ static void mqtt_operation_complete_callback(MQTT_CLIENT_HANDLE handle, MQTT_CLI
                 const PUBLISH_ACK* puback = (const PUBLISH_ACK*)msgInfo;
                 if (puback != NULL)
                 {
-                    PDLIST_ENTRY currentListEntry = transport_data->telemetry_waitingForAck.Flink;
-                    while (currentListEntry != &transport_data->telemetry_waitingForAck)
+                    /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_10_005: [ On a PUBACK the message waiting for it shall be looked up by packet id in the PUBACK index, removed from the index and from telemetry_waitingForAck, and completed with IOTHUB_CLIENT_CONFIRMATION_OK. ] */
+                    MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = remove_from_ack_index(transport_data, puback->packetId, NULL);
+                    if (mqttMsgEntry != NULL)
                     {
-                        MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = containingRecord(currentListEntry, MQTT_MESSAGE_DETAILS_LIST, entry);
-                        DLIST_ENTRY saveListEntry;
-                        saveListEntry.Flink = currentListEntry->Flink;
-
-                        if (puback->packetId == mqttMsgEntry->packet_id)
-                        {
-                            (void)DList_RemoveEntryList(currentListEntry); //First remove the item from Waiting for Ack List.
-                            sendMsgComplete(mqttMsgEntry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_OK);
-                            free(mqttMsgEntry);
-                        }
-                        currentListEntry = saveListEntry.Flink;
+                        (void)DList_RemoveEntryList(&mqttMsgEntry->entry); //First remove the item from Waiting for Ack List.
+                        sendMsgComplete(mqttMsgEntry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_OK);
+                        free(mqttMsgEntry);
                     }
                 }
                 else
@@ -1946,7 +1922,10 @@ static PMQTTTRANSPORT_HANDLE_DATA InitializeTransportHandleData(const IOTHUB_CLI
         }
         else
         {
-            if ( (state->topic_MqttEvent = STRING_construct_sprintf(TOPIC_DEVICE_DEVICE, upperConfig->deviceId) ) == NULL)
+            // the prefix length of the event topic is the length of the format less the %s, plus the device id
+            state->topic_MqttEventPrefixLength = strlen(TOPIC_DEVICE_DEVICE) - 2 + strlen(upperConfig->deviceId);
+            state->topic_MqttEventSize = state->topic_MqttEventPrefixLength + INITIAL_TOPIC_PROPERTIES_SIZE + 1;
+            if ( (state->topic_MqttEvent = (char*)malloc(state->topic_MqttEventSize) ) == NULL)
             {
                 LogError("Could not create topic_MqttEvent for MQTT");
                 free_transport_handle_data(state);
@@ -1954,6 +1933,8 @@ static PMQTTTRANSPORT_HANDLE_DATA InitializeTransportHandleData(const IOTHUB_CLI
             }
             else
             {
+                (void)sprintf(state->topic_MqttEvent, TOPIC_DEVICE_DEVICE, upperConfig->deviceId);
+
                 state->mqttClient = mqtt_client_init(mqtt_notification_callback, mqtt_operation_complete_callback, state, mqtt_error_callback, state);
                 if (state->mqttClient == NULL)
                 {
@@ -1988,6 +1969,12 @@ static PMQTTTRANSPORT_HANDLE_DATA InitializeTransportHandleData(const IOTHUB_CLI
                     {
                         /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_010: [IoTHubTransport_MQTT_Common_Create shall allocate memory to save its internal state where all topics, hostname, device_id, device_key, sasTokenSr and client handle shall be saved.] */
                         DList_InitializeListHead(&(state->telemetry_waitingForAck));
+                        state->telemetry_ackIndex = state->telemetry_initialAckIndex;
+                        state->telemetry_ackIndexSize = INITIAL_ACK_INDEX_SIZE;
+                        state->telemetry_inFlightCount = 0;
+                        /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_10_021: [ The "mqtt_max_in_flight" option shall not be set by default, so the number of messages waiting for PUBACK is not limited until it is set. ] */
+                        state->max_in_flight = DEFAULT_MAX_IN_FLIGHT;
+                        state->resend_timeout_ms = DEFAULT_RESEND_TIMEOUT_MS;
                         DList_InitializeListHead(&(state->ack_waiting_queue));
                         state->isDestroyCalled = false;
                         state->isRegistered = false;
@@ -2330,7 +2317,6 @@ int IoTHubTransport_MQTT_Common_DeviceMethod_Response(IOTHUB_DEVICE_HANDLE handl
             {
                 result = 0;
             }
-            STRING_delete(dev_method_info->request_id);
             free(dev_method_info);
         }
     }
@@ -2465,6 +2451,129 @@ IOTHUB_PROCESS_ITEM_RESULT IoTHubTransport_MQTT_Common_ProcessItem(TRANSPORT_LL_
 }
 
 /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_054: [ IoTHubTransport_MQTT_Common_DoWork shall subscribe to the Notification and get_state Topics if they are defined. ] */
+static void process_telemetry_waiting_for_ack(PMQTTTRANSPORT_HANDLE_DATA transport_data, tickcounter_ms_t current_ms)
+{
+    /* telemetry_waitingForAck is kept in publish order (a resent message moves to its tail) and every message shares the same
+       resend timeout, so the list is also in resend deadline order: the walk stops at the first message that has not timed out. */
+    PDLIST_ENTRY currentListEntry = transport_data->telemetry_waitingForAck.Flink;
+    while (currentListEntry != &transport_data->telemetry_waitingForAck)
+    {
+        MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = containingRecord(currentListEntry, MQTT_MESSAGE_DETAILS_LIST, entry);
+        DLIST_ENTRY nextListEntry;
+        nextListEntry.Flink = currentListEntry->Flink;
+
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_033: [IoTHubTransport_MQTT_Common_DoWork shall iterate through the Waiting Acknowledge messages looking for any message that has been waiting longer than 2 min.]*/
+        /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_10_010: [ IoTHubTransport_MQTT_Common_DoWork shall stop looking at the Waiting Acknowledge messages at the first one that has not been waiting longer than the "mqtt_resend_interval_ms" option. ] */
+        if ((current_ms - mqttMsgEntry->msgPublishTime) <= transport_data->resend_timeout_ms)
+        {
+            break;
+        }
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_034: [If IoTHubTransport_MQTT_Common_DoWork has resent the message two times then it shall fail the message and reconnect to IoTHub ... ] */
+        else if (mqttMsgEntry->retryCount >= MAX_SEND_RECOUNT_LIMIT)
+        {
+            PDLIST_ENTRY current_entry;
+            (void)remove_from_ack_index(transport_data, mqttMsgEntry->packet_id, mqttMsgEntry);
+            (void)DList_RemoveEntryList(currentListEntry);
+            sendMsgComplete(mqttMsgEntry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT);
+            free(mqttMsgEntry);
+
+            transport_data->currPacketState = PACKET_TYPE_ERROR;
+            transport_data->device_twin_get_sent = false;
+            DisconnectFromClient(transport_data);
+
+            /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_07_057: [ ... then go through all the rest of the waiting messages and reset the retryCount on the message. ]*/
+            current_entry = transport_data->telemetry_waitingForAck.Flink;
+            while (current_entry != &transport_data->telemetry_waitingForAck)
+            {
+                MQTT_MESSAGE_DETAILS_LIST* msg_reset_entry;
+                msg_reset_entry = containingRecord(current_entry, MQTT_MESSAGE_DETAILS_LIST, entry);
+                msg_reset_entry->retryCount = 0;
+                current_entry = current_entry->Flink;
+            }
+        }
+        else
+        {
+            size_t messageLength;
+            const unsigned char* messagePayload = RetrieveMessagePayload(mqttMsgEntry->iotHubMessageEntry->messageHandle, &messageLength);
+            if (messageLength == 0 || messagePayload == NULL)
+            {
+                LogError("Failure from creating Message IoTHubMessage_GetData");
+            }
+            else if (publish_mqtt_telemetry_msg(transport_data, mqttMsgEntry, messagePayload, messageLength, current_ms) != 0)
+            {
+                (void)remove_from_ack_index(transport_data, mqttMsgEntry->packet_id, mqttMsgEntry);
+                (void)DList_RemoveEntryList(currentListEntry);
+                sendMsgComplete(mqttMsgEntry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_ERROR);
+                free(mqttMsgEntry);
+            }
+            /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_10_011: [ A resent message shall be moved to the end of the Waiting Acknowledge messages. ] */
+            else if (nextListEntry.Flink != &transport_data->telemetry_waitingForAck)
+            {
+                (void)DList_RemoveEntryList(currentListEntry);
+                DList_InsertTailList(&transport_data->telemetry_waitingForAck, currentListEntry);
+            }
+        }
+        currentListEntry = nextListEntry.Flink;
+    }
+}
+
+static void publish_telemetry_waiting_to_send(PMQTTTRANSPORT_HANDLE_DATA transport_data, tickcounter_ms_t current_ms)
+{
+    PDLIST_ENTRY currentListEntry = transport_data->waitingToSend->Flink;
+    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_027: [IoTHubTransport_MQTT_Common_DoWork shall inspect the "waitingToSend" DLIST passed in config structure.] */
+    /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_10_006: [ IoTHubTransport_MQTT_Common_DoWork shall stop publishing messages from waitingToSend while the number of messages waiting for PUBACK has reached the "mqtt_max_in_flight" option. ] */
+    while (currentListEntry != transport_data->waitingToSend && !is_in_flight_window_full(transport_data))
+    {
+        IOTHUB_MESSAGE_LIST* iothubMsgList = containingRecord(currentListEntry, IOTHUB_MESSAGE_LIST, entry);
+        DLIST_ENTRY savedFromCurrentListEntry;
+        savedFromCurrentListEntry.Flink = currentListEntry->Flink;
+
+        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_027: [IoTHubTransport_MQTT_Common_DoWork shall inspect the "waitingToSend" DLIST passed in config structure.] */
+        size_t messageLength;
+        const unsigned char* messagePayload = RetrieveMessagePayload(iothubMsgList->messageHandle, &messageLength);
+        if (messageLength == 0 || messagePayload == NULL)
+        {
+            LogError("Failure result from IoTHubMessage_GetData");
+        }
+        /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_10_014: [ A message delivered at most once, because of its IoTHubMessage_GetDelivery or of the "mqtt_telemetry_at_most_once" option, shall be published with DELIVER_AT_MOST_ONCE without waiting for a PUBACK, and completed with IOTHUB_CLIENT_CONFIRMATION_OK once mqtt_client_publish succeeds or IOTHUB_CLIENT_CONFIRMATION_ERROR if it fails. ] */
+        else if (is_delivered_at_most_once(transport_data, iothubMsgList->messageHandle))
+        {
+            int publish_result = publish_telemetry_payload(transport_data, iothubMsgList->messageHandle, 0, DELIVER_AT_MOST_ONCE, messagePayload, messageLength); // QoS 0 PUBLISH packets carry no packet id
+            (void)(DList_RemoveEntryList(currentListEntry));
+            sendMsgComplete(iothubMsgList, transport_data, publish_result == 0 ? IOTHUB_CLIENT_CONFIRMATION_OK : IOTHUB_CLIENT_CONFIRMATION_ERROR);
+        }
+        else
+        {
+            /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_029: [IoTHubTransport_MQTT_Common_DoWork shall create a MQTT_MESSAGE_HANDLE and pass this to a call to mqtt_client_publish.] */
+            MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = (MQTT_MESSAGE_DETAILS_LIST*)malloc(sizeof(MQTT_MESSAGE_DETAILS_LIST));
+            if (mqttMsgEntry == NULL)
+            {
+                LogError("Allocation Error: Failure allocating MQTT Message Detail List.");
+            }
+            else
+            {
+                mqttMsgEntry->retryCount = 0;
+                mqttMsgEntry->iotHubMessageEntry = iothubMsgList;
+                mqttMsgEntry->packet_id = get_next_packet_id(transport_data);
+                if (publish_mqtt_telemetry_msg(transport_data, mqttMsgEntry, messagePayload, messageLength, current_ms) != 0)
+                {
+                    (void)(DList_RemoveEntryList(currentListEntry));
+                    sendMsgComplete(iothubMsgList, transport_data, IOTHUB_CLIENT_CONFIRMATION_ERROR);
+                    free(mqttMsgEntry);
+                }
+                else
+                {
+                    (void)(DList_RemoveEntryList(currentListEntry));
+                    DList_InsertTailList(&(transport_data->telemetry_waitingForAck), &(mqttMsgEntry->entry));
+                    /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_10_007: [ Every published message shall be added to the PUBACK index under its packet id; the index shall double its buckets when it holds more messages than buckets. ] */
+                    add_to_ack_index(transport_data, mqttMsgEntry);
+                }
+            }
+        }
+        currentListEntry = savedFromCurrentListEntry.Flink;
+    }
+}
+
 void IoTHubTransport_MQTT_Common_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
 {
     /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_026: [IoTHubTransport_MQTT_Common_DoWork shall do nothing if parameter handle and/or iotHubClientHandle is NULL.] */
@@ -2508,104 +2617,16 @@ void IoTHubTransport_MQTT_Common_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIEN
             }
             else if (transport_data->currPacketState == PUBLISH_TYPE)
             {
-                PDLIST_ENTRY currentListEntry = transport_data->telemetry_waitingForAck.Flink;
-                while (currentListEntry != &transport_data->telemetry_waitingForAck)
+                tickcounter_ms_t current_ms;
+                /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_10_009: [ IoTHubTransport_MQTT_Common_DoWork shall read the tick counter once and use that time for every resend check and every publish. ] */
+                if (tickcounter_get_current_ms(transport_data->msgTickCounter, &current_ms) != 0)
                 {
-                    tickcounter_ms_t current_ms;
-                    MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = containingRecord(currentListEntry, MQTT_MESSAGE_DETAILS_LIST, entry);
-                    DLIST_ENTRY nextListEntry;
-                    nextListEntry.Flink = currentListEntry->Flink;
-
-                    (void)tickcounter_get_current_ms(transport_data->msgTickCounter, &current_ms);
-                    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_033: [IoTHubTransport_MQTT_Common_DoWork shall iterate through the Waiting Acknowledge messages looking for any message that has been waiting longer than 2 min.]*/
-                    if (((current_ms - mqttMsgEntry->msgPublishTime) / 1000) > RESEND_TIMEOUT_VALUE_MIN)
-                    {
-                        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_034: [If IoTHubTransport_MQTT_Common_DoWork has resent the message two times then it shall fail the message and reconnect to IoTHub ... ] */
-                        if (mqttMsgEntry->retryCount >= MAX_SEND_RECOUNT_LIMIT)
-                        {
-                            PDLIST_ENTRY current_entry;
-                            (void)DList_RemoveEntryList(currentListEntry);
-                            sendMsgComplete(mqttMsgEntry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT);
-                            free(mqttMsgEntry);
-
-                            transport_data->currPacketState = PACKET_TYPE_ERROR;
-                            transport_data->device_twin_get_sent = false;
-                            DisconnectFromClient(transport_data);
-
-                            /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_07_057: [ ... then go through all the rest of the waiting messages and reset the retryCount on the message. ]*/
-                            current_entry = transport_data->telemetry_waitingForAck.Flink;
-                            while (current_entry != &transport_data->telemetry_waitingForAck)
-                            {
-                                MQTT_MESSAGE_DETAILS_LIST* msg_reset_entry;
-                                msg_reset_entry = containingRecord(current_entry, MQTT_MESSAGE_DETAILS_LIST, entry);
-                                msg_reset_entry->retryCount = 0;
-                                current_entry = current_entry->Flink;
-                            }
-                        }
-                        else
-                        {
-                            size_t messageLength;
-                            const unsigned char* messagePayload = RetrieveMessagePayload(mqttMsgEntry->iotHubMessageEntry->messageHandle, &messageLength);
-                            if (messageLength == 0 || messagePayload == NULL)
-                            {
-                                LogError("Failure from creating Message IoTHubMessage_GetData");
-                            }
-                            else
-                            {
-                                if (publish_mqtt_telemetry_msg(transport_data, mqttMsgEntry, messagePayload, messageLength) != 0)
-                                {
-                                    (void)DList_RemoveEntryList(currentListEntry);
-                                    sendMsgComplete(mqttMsgEntry->iotHubMessageEntry, transport_data, IOTHUB_CLIENT_CONFIRMATION_ERROR);
-                                    free(mqttMsgEntry);
-                                }
-                            }
-                        }
-                    }
-                    currentListEntry = nextListEntry.Flink;
+                    LogError("Failed retrieving tickcounter info");
                 }
-
-                currentListEntry = transport_data->waitingToSend->Flink;
-                /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_027: [IoTHubTransport_MQTT_Common_DoWork shall inspect the "waitingToSend" DLIST passed in config structure.] */
-                while (currentListEntry != transport_data->waitingToSend)
+                else
                 {
-                    IOTHUB_MESSAGE_LIST* iothubMsgList = containingRecord(currentListEntry, IOTHUB_MESSAGE_LIST, entry);
-                    DLIST_ENTRY savedFromCurrentListEntry;
-                    savedFromCurrentListEntry.Flink = currentListEntry->Flink;
-
-                    /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_027: [IoTHubTransport_MQTT_Common_DoWork shall inspect the "waitingToSend" DLIST passed in config structure.] */
-                    size_t messageLength;
-                    const unsigned char* messagePayload = RetrieveMessagePayload(iothubMsgList->messageHandle, &messageLength);
-                    if (messageLength == 0 || messagePayload == NULL)
-                    {
-                        LogError("Failure result from IoTHubMessage_GetData");
-                    }
-                    else
-                    {
-                        /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_029: [IoTHubTransport_MQTT_Common_DoWork shall create a MQTT_MESSAGE_HANDLE and pass this to a call to mqtt_client_publish.] */
-                        MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = (MQTT_MESSAGE_DETAILS_LIST*)malloc(sizeof(MQTT_MESSAGE_DETAILS_LIST));
-                        if (mqttMsgEntry == NULL)
-                        {
-                            LogError("Allocation Error: Failure allocating MQTT Message Detail List.");
-                        }
-                        else
-                        {
-                            mqttMsgEntry->retryCount = 0;
-                            mqttMsgEntry->iotHubMessageEntry = iothubMsgList;
-                            mqttMsgEntry->packet_id = get_next_packet_id(transport_data);
-                            if (publish_mqtt_telemetry_msg(transport_data, mqttMsgEntry, messagePayload, messageLength) != 0)
-                            {
-                                (void)(DList_RemoveEntryList(currentListEntry));
-                                sendMsgComplete(iothubMsgList, transport_data, IOTHUB_CLIENT_CONFIRMATION_ERROR);
-                                free(mqttMsgEntry);
-                            }
-                            else
-                            {
-                                (void)(DList_RemoveEntryList(currentListEntry));
-                                DList_InsertTailList(&(transport_data->telemetry_waitingForAck), &(mqttMsgEntry->entry));
-                            }
-                        }
-                    }
-                    currentListEntry = savedFromCurrentListEntry.Flink;
+                    process_telemetry_waiting_for_ack(transport_data, current_ms);
+                    publish_telemetry_waiting_to_send(transport_data, current_ms);
                 }
             }
             /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_030: [IoTHubTransport_MQTT_Common_DoWork shall call mqtt_client_dowork everytime it is called if it is connected.] */
@@ -2614,6 +2635,113 @@ void IoTHubTransport_MQTT_Common_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIEN
     }
 }
 
+static uint64_t get_ms_until_elapsed(tickcounter_ms_t start_time, uint64_t timeout_ms, tickcounter_ms_t current_time)
+{
+    uint64_t elapsed_ms = (uint64_t)(current_time - start_time);
+    return (elapsed_ms >= timeout_ms) ? 0 : timeout_ms - elapsed_ms;
+}
+
+static uint64_t get_ms_to_next_work(PMQTTTRANSPORT_HANDLE_DATA transport_data, tickcounter_ms_t current_time)
+{
+    uint64_t result;
+
+    if (transport_data->isDestroyCalled)
+    {
+        result = IOTHUB_CLIENT_LL_NO_WORK_DEADLINE;
+    }
+    else if (transport_data->mqttClientStatus == MQTT_CLIENT_STATUS_PENDING_CLOSE)
+    {
+        result = 0;
+    }
+    else if (transport_data->mqttClientStatus == MQTT_CLIENT_STATUS_NOT_CONNECTED)
+    {
+        if (!transport_data->isRecoverableError)
+        {
+            result = IOTHUB_CLIENT_LL_NO_WORK_DEADLINE;
+        }
+        else if (transport_data->connectFailCount == 0 &&
+            (transport_data->currPacketState == CONNECT_TYPE || transport_data->currPacketState == UNKNOWN_TYPE))
+        {
+            // First connection or reconnection after a SAS token refresh; neither waits on the retry policy
+            result = 0;
+        }
+        else
+        {
+            result = RETRY_CHECK_INTERVAL_MS;
+        }
+    }
+    else if (transport_data->mqttClientStatus == MQTT_CLIENT_STATUS_CONNECTING)
+    {
+        // InitializeConnection times out once more than connect_timeout_in_sec whole seconds have elapsed
+        result = get_ms_until_elapsed(transport_data->mqtt_connect_time, ((uint64_t)transport_data->connect_timeout_in_sec + 1) * 1000, current_time);
+    }
+    else if (transport_data->currPacketState == CONNACK_TYPE || transport_data->currPacketState == SUBSCRIBE_TYPE || transport_data->currPacketState == SUBACK_TYPE)
+    {
+        result = 0;
+    }
+    else if (transport_data->currPacketState == PUBLISH_TYPE && !DList_IsListEmpty(transport_data->waitingToSend) && !is_in_flight_window_full(transport_data))
+    {
+        result = 0;
+    }
+    else
+    {
+        uint64_t sas_refresh_secs = (uint64_t)(transport_data->option_sas_token_lifetime_secs*SAS_REFRESH_MULTIPLIER) + 1;
+        result = get_ms_until_elapsed(transport_data->mqtt_connect_time, sas_refresh_secs * 1000, current_time);
+
+        // Wake up at half the keep-alive interval so mqtt_client_dowork gets a chance to PINGREQ in time
+        if (transport_data->keepAliveValue != 0 && (uint64_t)transport_data->keepAliveValue * 500 < result)
+        {
+            result = (uint64_t)transport_data->keepAliveValue * 500;
+        }
+
+        // The oldest message waiting for PUBACK is the first to time out
+        if (transport_data->currPacketState == PUBLISH_TYPE && !DList_IsListEmpty(&transport_data->telemetry_waitingForAck))
+        {
+            MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry = containingRecord(transport_data->telemetry_waitingForAck.Flink, MQTT_MESSAGE_DETAILS_LIST, entry);
+            uint64_t resend_ms = get_ms_until_elapsed(mqttMsgEntry->msgPublishTime, (uint64_t)transport_data->resend_timeout_ms + 1, current_time);
+            if (resend_ms < result)
+            {
+                result = resend_ms;
+            }
+        }
+    }
+
+    return result;
+}
+
+IOTHUB_CLIENT_RESULT IoTHubTransport_MQTT_Common_GetNextWorkDeadline(TRANSPORT_LL_HANDLE handle, uint64_t* msToNextWork)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_10_001: [ If handle or msToNextWork are NULL, IoTHubTransport_MQTT_Common_GetNextWorkDeadline shall return IOTHUB_CLIENT_INVALID_ARG. ] */
+    if (handle == NULL || msToNextWork == NULL)
+    {
+        LogError("invalid argument (handle=%p, msToNextWork=%p)", handle, msToNextWork);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        PMQTTTRANSPORT_HANDLE_DATA transport_data = (PMQTTTRANSPORT_HANDLE_DATA)handle;
+        tickcounter_ms_t current_time;
+
+        if (tickcounter_get_current_ms(transport_data->msgTickCounter, &current_time) != 0)
+        {
+            /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_10_002: [ If tickcounter_get_current_ms fails, IoTHubTransport_MQTT_Common_GetNextWorkDeadline shall return IOTHUB_CLIENT_ERROR. ] */
+            LogError("Failure getting the current time");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_10_003: [ IoTHubTransport_MQTT_Common_GetNextWorkDeadline shall set msToNextWork to 0 while connecting, subscribing, closing or when waitingToSend has messages that can be published. ] */
+            /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_10_004: [ Otherwise msToNextWork shall be the earliest of the CONNACK timeout, the SAS token refresh, half the keep-alive interval, the resend timeout of messages waiting for PUBACK, or the retry check interval when a reconnection is pending. ] */
+            *msToNextWork = get_ms_to_next_work(transport_data, current_time);
+            result = IOTHUB_CLIENT_OK;
+        }
+    }
+
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubTransport_MQTT_Common_GetSendStatus(IOTHUB_DEVICE_HANDLE handle, IOTHUB_CLIENT_STATUS *iotHubClientStatus)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -2681,6 +2809,33 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_MQTT_Common_SetOption(TRANSPORT_LL_HANDLE h
             transport_data->option_sas_token_lifetime_secs = *sas_lifetime;
             result = IOTHUB_CLIENT_OK;
         }
+        /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_10_008: [ If the option parameter is set to "mqtt_max_in_flight" then the value shall be a size_t_ptr and the value shall limit the number of messages waiting for PUBACK, 0 meaning no limit. ] */
+        else if (strcmp(OPTION_MQTT_MAX_IN_FLIGHT, option) == 0)
+        {
+            transport_data->max_in_flight = *(const size_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_10_012: [ If the option parameter is set to "mqtt_resend_interval_ms" then the value shall be a size_t_ptr and the value shall be the number of milliseconds a message waits for its PUBACK before being resent; 0 shall be rejected with IOTHUB_CLIENT_INVALID_ARG. ] */
+        else if (strcmp(OPTION_MQTT_RESEND_INTERVAL_MS, option) == 0)
+        {
+            size_t resend_interval = *(const size_t*)value;
+            if (resend_interval == 0)
+            {
+                LogError("invalid resend interval 0");
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                transport_data->resend_timeout_ms = (tickcounter_ms_t)resend_interval;
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
+        /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_10_015: [ If the option parameter is set to "mqtt_telemetry_at_most_once" then the value shall be a bool_ptr and the value shall determine if the messages with IOTHUB_MESSAGE_DELIVERY_DEFAULT are delivered at most once. ] */
+        else if (strcmp(OPTION_MQTT_TELEMETRY_AT_MOST_ONCE, option) == 0)
+        {
+            transport_data->telemetry_at_most_once = *(const bool*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
         else if (strcmp(OPTION_CONNECTION_TIMEOUT, option) == 0)
         {
             int* connection_time = (int*)value;
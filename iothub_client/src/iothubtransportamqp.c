@@ -114,6 +114,12 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportAMQP_GetSendStatus(IOTHUB_DEVICE_HAND
     return IoTHubTransport_AMQP_Common_GetSendStatus(handle, iotHubClientStatus);
 }
 
+static IOTHUB_CLIENT_RESULT IoTHubTransportAMQP_GetNextWorkDeadline(TRANSPORT_LL_HANDLE handle, uint64_t* msToNextWork)
+{
+    // Codes_SRS_IOTHUBTRANSPORTAMQP_10_002: [IoTHubTransportAMQP_GetNextWorkDeadline shall get the next work deadline by calling into the IoTHubTransport_AMQP_Common_GetNextWorkDeadline()]
+    return IoTHubTransport_AMQP_Common_GetNextWorkDeadline(handle, msToNextWork);
+}
+
 static IOTHUB_CLIENT_RESULT IoTHubTransportAMQP_SetOption(TRANSPORT_LL_HANDLE handle, const char* option, const void* value)
 {
     // Codes_SRS_IOTHUBTRANSPORTAMQP_09_017: [IoTHubTransportAMQP_SetOption shall set the options by calling into the IoTHubTransport_AMQP_Common_SetOption()]
@@ -175,7 +181,8 @@ static TRANSPORT_PROVIDER thisTransportProvider =
     IoTHubTransportAMQP_Unsubscribe,                /*pfIoTHubTransport_Unsubscribe IoTHubTransport_Unsubscribe;*/
     IoTHubTransportAMQP_DoWork,                     /*pfIoTHubTransport_DoWork IoTHubTransport_DoWork;*/
     IoTHubTransportAMQP_SetRetryPolicy,             /*pfIoTHubTransport_DoWork IoTHubTransport_SetRetryPolicy;*/
-    IoTHubTransportAMQP_GetSendStatus               /*pfIoTHubTransport_GetSendStatus IoTHubTransport_GetSendStatus;*/
+    IoTHubTransportAMQP_GetSendStatus,              /*pfIoTHubTransport_GetSendStatus IoTHubTransport_GetSendStatus;*/
+    IoTHubTransportAMQP_GetNextWorkDeadline         /*pfIoTHubTransport_GetNextWorkDeadline IoTHubTransport_GetNextWorkDeadline;*/
 };
 
 /* Codes_SRS_IOTHUBTRANSPORTAMQP_09_019: [This function shall return a pointer to a structure of type TRANSPORT_PROVIDER having the following values for it's fields:
@@ -192,7 +199,8 @@ IoTHubTransport_Subscribe = IoTHubTransportAMQP_Subscribe
 IoTHubTransport_Unsubscribe = IoTHubTransportAMQP_Unsubscribe
 IoTHubTransport_DoWork = IoTHubTransportAMQP_DoWork
 IoTHubTransport_SetRetryPolicy = IoTHubTransportAMQP_SetRetryPolicy
-IoTHubTransport_SetOption = IoTHubTransportAMQP_SetOption]*/
+IoTHubTransport_SetOption = IoTHubTransportAMQP_SetOption
+IoTHubTransport_GetNextWorkDeadline = IoTHubTransportAMQP_GetNextWorkDeadline]*/
 extern const TRANSPORT_PROVIDER* AMQP_Protocol(void)
 {
     return &thisTransportProvider;
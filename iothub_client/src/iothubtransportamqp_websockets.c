@@ -169,6 +169,12 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportAMQP_WS_GetSendStatus(IOTHUB_DEVICE_H
     return IoTHubTransport_AMQP_Common_GetSendStatus(handle, iotHubClientStatus);
 }
 
+static IOTHUB_CLIENT_RESULT IoTHubTransportAMQP_WS_GetNextWorkDeadline(TRANSPORT_LL_HANDLE handle, uint64_t* msToNextWork)
+{
+    // Codes_SRS_IoTHubTransportAMQP_WS_10_002: [IoTHubTransportAMQP_WS_GetNextWorkDeadline shall get the next work deadline by calling into the IoTHubTransport_AMQP_Common_GetNextWorkDeadline()]
+    return IoTHubTransport_AMQP_Common_GetNextWorkDeadline(handle, msToNextWork);
+}
+
 static IOTHUB_CLIENT_RESULT IoTHubTransportAMQP_WS_SetOption(TRANSPORT_LL_HANDLE handle, const char* option, const void* value)
 {
     // Codes_SRS_IoTHubTransportAMQP_WS_09_017: [IoTHubTransportAMQP_WS_SetOption shall set the options by calling into the IoTHubTransport_AMQP_Common_SetOption()]
@@ -229,7 +235,8 @@ static TRANSPORT_PROVIDER thisTransportProvider_WebSocketsOverTls =
     IoTHubTransportAMQP_WS_Unsubscribe,                                /*pfIoTHubTransport_Unsubscribe IoTHubTransport_Unsubscribe;*/
     IoTHubTransportAMQP_WS_DoWork,                                     /*pfIoTHubTransport_DoWork IoTHubTransport_DoWork;*/
     IoTHubTransportAMQP_WS_SetRetryPolicy,                             /*pfIoTHubTransport_SetRetryLogic IoTHubTransport_SetRetryPolicy;*/
-    IoTHubTransportAMQP_WS_GetSendStatus                               /*pfIoTHubTransport_GetSendStatus IoTHubTransport_GetSendStatus;*/
+    IoTHubTransportAMQP_WS_GetSendStatus,                              /*pfIoTHubTransport_GetSendStatus IoTHubTransport_GetSendStatus;*/
+    IoTHubTransportAMQP_WS_GetNextWorkDeadline                         /*pfIoTHubTransport_GetNextWorkDeadline IoTHubTransport_GetNextWorkDeadline;*/
 };
 
 /* Codes_SRS_IoTHubTransportAMQP_WS_09_019: [This function shall return a pointer to a structure of type TRANSPORT_PROVIDER having the following values for it's fields:
@@ -249,7 +256,8 @@ IoTHubTransport_Unsubscribe = IoTHubTransportAMQP_WS_Unsubscribe
 IoTHubTransport_DoWork = IoTHubTransportAMQP_WS_DoWork
 IoTHubTransport_SetRetryLogic = IoTHubTransportAMQP_WS_SetRetryLogic
 IoTHubTransport_SetOption = IoTHubTransportAMQP_WS_SetOption
-IoTHubTransport_GetSendStatus = IoTHubTransportAMQP_WS_GetSendStatus] */
+IoTHubTransport_GetSendStatus = IoTHubTransportAMQP_WS_GetSendStatus
+IoTHubTransport_GetNextWorkDeadline = IoTHubTransportAMQP_WS_GetNextWorkDeadline] */
 extern const TRANSPORT_PROVIDER* AMQP_Protocol_over_WebSocketsTls(void)
 {
     return &thisTransportProvider_WebSocketsOverTls;
@@ -2,6 +2,7 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <string.h>
 #include "azure_c_shared_utility/gballoc.h"
 
 #include <time.h>
@@ -10,6 +11,9 @@
 #include "iothub_client_private.h"
 #include "iothub_transport_ll.h"
 #include "iothubtransporthttp.h"
+#include "device_index.h"
+#include "event_batch.h"
+#include "http_compression.h"
 
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/httpapiexsas.h"
@@ -18,7 +22,6 @@
 #include "azure_c_shared_utility/httpapiex.h"
 #include "azure_c_shared_utility/httpapiexsas.h"
 #include "azure_c_shared_utility/strings.h"
-#include "azure_c_shared_utility/base64.h"
 #include "azure_c_shared_utility/doublylinkedlist.h"
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/httpheaders.h"
@@ -35,18 +38,19 @@ static const char* IOTHUB_CONTENT_ENCODING_C2D = "ContentEncoding";
 #define CONTENT_TYPE "Content-Type"
 #define APPLICATION_OCTET_STREAM "application/octet-stream"
 #define APPLICATION_VND_MICROSOFT_IOTHUB_JSON "application/vnd.microsoft.iothub.json"
+#define CONTENT_ENCODING "Content-Encoding"
 
 /*DEFAULT_GETMINIMUMPOLLINGTIME is the minimum time in seconds allowed between 2 consecutive GET issues to the service (GET=fetch messages)*/
 /*the default is 25 minutes*/
 #define DEFAULT_GETMINIMUMPOLLINGTIME ((unsigned int)25*60) 
 
+/*batches smaller than this are sent uncompressed, their gzip header and trailer would eat most of the gain*/
+#define DEFAULT_COMPRESSION_MINIMUM_SIZE ((size_t)1024)
+
 #define MAXIMUM_MESSAGE_SIZE (255*1024-1)
 #define MAXIMUM_PAYLOAD_OVERHEAD 384
 #define MAXIMUM_PROPERTY_OVERHEAD 16
 
-/*forward declaration*/
-static int appendMapToJSON(STRING_HANDLE existing, const char* const* keys, const char* const* values, size_t count);
-
 typedef struct HTTPTRANSPORT_HANDLE_DATA_TAG
 {
     STRING_HANDLE hostName;
@@ -54,11 +58,18 @@ typedef struct HTTPTRANSPORT_HANDLE_DATA_TAG
     bool doBatchedTransfers;
     unsigned int getMinimumPollingTime;
     VECTOR_HANDLE perDeviceList;
+    DEVICE_INDEX_HANDLE perDeviceIndex; /*finds the devices of perDeviceList by deviceId*/
+    HTTP_COMPRESSION_HANDLE compression; /*NULL when batches are sent uncompressed*/
+    size_t compressionMinimumSize;
+    BUFFER_HANDLE compressedPayload; /*the compressed body of the last batch, shared by the devices since requests are sent one at a time*/
+    IOTHUB_CLIENT_HTTP_ADAPTIVE_POLLING adaptivePolling; /*maximumIntervalInSeconds == 0 means polling every getMinimumPollingTime*/
 }HTTPTRANSPORT_HANDLE_DATA;
 
 typedef struct HTTPTRANSPORT_PERDEVICE_DATA_TAG
 {
     HTTPTRANSPORT_HANDLE_DATA* transportHandle;
+    size_t perDeviceListPosition; /*where the device is in transportHandle->perDeviceList*/
+    DEVICE_INDEX_ITEM_HANDLE perDeviceIndexItem;
 
     STRING_HANDLE deviceId;
     STRING_HANDLE deviceKey;
@@ -72,10 +83,14 @@ typedef struct HTTPTRANSPORT_PERDEVICE_DATA_TAG
     bool DoWork_PullMessage;
     time_t lastPollTime;
     bool isFirstPoll;
+    unsigned int pollingInterval; /*adaptive polling: seconds to wait after lastPollTime, 0 polls at every DoWork*/
+    IOTHUB_CLIENT_HTTP_POLLING_STATISTICS pollingStatistics; /*only the counters are used*/
 
     IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle;
     PDLIST_ENTRY waitingToSend;
     DLIST_ENTRY eventConfirmations; /*holds items for event confirmations*/
+    BUFFER_HANDLE batchPayload; /*the body of the last batch, kept to be written over by the next one*/
+    HTTP_HEADERS_HANDLE compressedEventHTTPrequestHeaders; /*eventHTTPrequestHeaders + Content-Encoding, made for the first compressed batch*/
 } HTTPTRANSPORT_PERDEVICE_DATA;
 
 typedef struct MESSAGE_DISPOSITION_CONTEXT_TAG
@@ -329,6 +344,24 @@ static void destroy_SASObject(HTTPTRANSPORT_PERDEVICE_DATA* handleData)
     handleData->sasObject = NULL;
 }
 
+static void destroy_batchPayload(HTTPTRANSPORT_PERDEVICE_DATA* handleData)
+{
+    if (handleData->batchPayload != NULL)
+    {
+        BUFFER_delete(handleData->batchPayload);
+        handleData->batchPayload = NULL;
+    }
+}
+
+static void destroy_compressedEventHTTPrequestHeaders(HTTPTRANSPORT_PERDEVICE_DATA* handleData)
+{
+    if (handleData->compressedEventHTTPrequestHeaders != NULL)
+    {
+        HTTPHeaders_Free(handleData->compressedEventHTTPrequestHeaders);
+        handleData->compressedEventHTTPrequestHeaders = NULL;
+    }
+}
+
 static bool create_deviceSASObject(HTTPTRANSPORT_PERDEVICE_DATA* handleData, STRING_HANDLE hostName, const char * deviceId, const char * deviceKey)
 {
     STRING_HANDLE keyName;
@@ -479,28 +512,51 @@ static bool create_deviceSasToken(HTTPTRANSPORT_PERDEVICE_DATA* handleData, cons
 
 /*
 * List queries  Find by handle and find by device name
+* Each device remembers its position in perDeviceList and devices are found by name through perDeviceIndex, so neither query depends on the number of devices.
 */
 
-/*Codes_SRS_TRANSPORTMULTITHTTP_17_137: [ IoTHubTransportHttp_Register shall search the devices list for any device matching name deviceId. If deviceId is found it shall return NULL. ]*/
-static bool findDeviceHandle(const void* element, const void* value)
+/*Codes_SRS_TRANSPORTMULTITHTTP_10_013: [ IoTHubTransportHttp_Register shall save the position of the device in the devices list in the device structure, then add the device to the devices list with VECTOR_push_back. ]*/
+/*Codes_SRS_TRANSPORTMULTITHTTP_10_014: [ IoTHubTransportHttp_Register shall add the device to the device index under deviceId by calling device_index_add. ]*/
+static bool add_perDeviceListItem(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* perDeviceItem, const char* deviceId)
 {
     bool result;
-    /* data stored at element is device handle */
-    const IOTHUB_DEVICE_HANDLE * guess = (const IOTHUB_DEVICE_HANDLE *)element;
-    IOTHUB_DEVICE_HANDLE match = (IOTHUB_DEVICE_HANDLE)value;
-    result = (*guess == match) ? true : false;
+    perDeviceItem->perDeviceListPosition = VECTOR_size(handleData->perDeviceList);
+    if (VECTOR_push_back(handleData->perDeviceList, &perDeviceItem, 1) != 0)
+    {
+        LogError("VECTOR_push_back failed");
+        result = false;
+    }
+    else if ((perDeviceItem->perDeviceIndexItem = device_index_add(handleData->perDeviceIndex, deviceId, perDeviceItem)) == NULL)
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_10_015: [ If device_index_add fails then IoTHubTransportHttp_Register shall remove the device from the devices list, fail and return NULL. ]*/
+        LogError("device_index_add failed");
+        VECTOR_erase(handleData->perDeviceList, VECTOR_back(handleData->perDeviceList), 1);
+        result = false;
+    }
+    else
+    {
+        result = true;
+    }
     return result;
 }
 
-static bool findDeviceById(const void* element, const void* value)
+/*Codes_SRS_TRANSPORTMULTITHTTP_10_016: [ IoTHubTransportHttp_Unregister shall remove the device from the device index by calling device_index_remove. ]*/
+/*Codes_SRS_TRANSPORTMULTITHTTP_10_017: [ IoTHubTransportHttp_Unregister shall move the last device of the devices list to the position of the removed device and call VECTOR_erase to remove the last position. ]*/
+static void remove_perDeviceListItem(HTTPTRANSPORT_HANDLE_DATA* handleData, IOTHUB_DEVICE_HANDLE* listItem)
 {
-    bool result;
-    const char* deviceId = (const char *)value;
-    const HTTPTRANSPORT_PERDEVICE_DATA * perDeviceElement = *(const HTTPTRANSPORT_PERDEVICE_DATA **)element;
+    HTTPTRANSPORT_PERDEVICE_DATA* perDeviceItem = (HTTPTRANSPORT_PERDEVICE_DATA*)(*listItem);
+    IOTHUB_DEVICE_HANDLE* lastItem;
 
-    result = (strcmp(STRING_c_str(perDeviceElement->deviceId), deviceId) == 0);
+    (void)device_index_remove(handleData->perDeviceIndex, perDeviceItem->perDeviceIndexItem);
 
-    return result;
+    lastItem = (IOTHUB_DEVICE_HANDLE*)VECTOR_back(handleData->perDeviceList);
+    if (lastItem != listItem)
+    {
+        HTTPTRANSPORT_PERDEVICE_DATA* movedItem = (HTTPTRANSPORT_PERDEVICE_DATA*)(*lastItem);
+        *listItem = *lastItem;
+        movedItem->perDeviceListPosition = perDeviceItem->perDeviceListPosition;
+    }
+    VECTOR_erase(handleData->perDeviceList, lastItem, 1);
 }
 
 static IOTHUB_DEVICE_HANDLE IoTHubTransportHttp_Register(TRANSPORT_LL_HANDLE handle, const IOTHUB_DEVICE_CONFIG* device, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, PDLIST_ENTRY waitingToSend)
@@ -525,9 +581,9 @@ static IOTHUB_DEVICE_HANDLE IoTHubTransportHttp_Register(TRANSPORT_LL_HANDLE han
     else
     {
         HTTPTRANSPORT_HANDLE_DATA* handleData = (HTTPTRANSPORT_HANDLE_DATA*)handle;
-        /*Codes_SRS_TRANSPORTMULTITHTTP_17_137: [ IoTHubTransportHttp_Register shall search the devices list for any device matching name deviceId. If deviceId is found it shall return NULL. ]*/
-        void* listItem = VECTOR_find_if(handleData->perDeviceList, findDeviceById, device->deviceId);
-        if (listItem != NULL)
+        /*Codes_SRS_TRANSPORTMULTITHTTP_17_137: [ IoTHubTransportHttp_Register shall search the device index for any device matching name deviceId by calling device_index_find. If deviceId is found it shall return NULL. ]*/
+        DEVICE_INDEX_ITEM_HANDLE indexItem = device_index_find(handleData->perDeviceIndex, device->deviceId);
+        if (indexItem != NULL)
         {
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_137: [ IoTHubTransportHttp_Register shall search the devices list for any device matching name deviceId. If deviceId is found it shall return NULL. ]*/
             LogError("Transport already has device registered by id: [%s]", device->deviceId);
@@ -599,7 +655,7 @@ static IOTHUB_DEVICE_HANDLE IoTHubTransportHttp_Register(TRANSPORT_LL_HANDLE han
             }
 
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_041: [ IoTHubTransportHttp_Register shall call VECTOR_push_back to store the new device information. ]*/
-            bool was_list_add_ok = (was_sasObject_ok || was_create_deviceSasToken_ok || was_x509_ok) && (VECTOR_push_back(handleData->perDeviceList, &result, 1) == 0);
+            bool was_list_add_ok = (was_sasObject_ok || was_create_deviceSasToken_ok || was_x509_ok) && add_perDeviceListItem(handleData, result, device->deviceId);
 
             if (was_list_add_ok)
             {
@@ -608,8 +664,12 @@ static IOTHUB_DEVICE_HANDLE IoTHubTransportHttp_Register(TRANSPORT_LL_HANDLE han
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_128: [ IoTHubTransportHttp_Register shall mark this device as unsubscribed. ]*/
                 result->DoWork_PullMessage = false;
                 result->isFirstPoll = true;
+                result->pollingInterval = 0;
+                memset(&result->pollingStatistics, 0, sizeof(result->pollingStatistics));
                 result->waitingToSend = waitingToSend;
                 DList_InitializeListHead(&(result->eventConfirmations));
+                result->batchPayload = NULL;
+                result->compressedEventHTTPrequestHeaders = NULL;
                 result->transportHandle = (HTTPTRANSPORT_HANDLE_DATA *)handle;
             }
             else
@@ -646,6 +706,8 @@ static void destroy_perDeviceData(HTTPTRANSPORT_PERDEVICE_DATA * perDeviceItem)
     destroy_messageHTTPrequestHeaders(perDeviceItem);
     destroy_abandonHTTPrelativePathBegin(perDeviceItem);
     destroy_SASObject(perDeviceItem);
+    destroy_batchPayload(perDeviceItem);
+    destroy_compressedEventHTTPrequestHeaders(perDeviceItem);
 }
 
 static IOTHUB_DEVICE_HANDLE* get_perDeviceDataItem(IOTHUB_DEVICE_HANDLE deviceHandle)
@@ -655,8 +717,10 @@ static IOTHUB_DEVICE_HANDLE* get_perDeviceDataItem(IOTHUB_DEVICE_HANDLE deviceHa
 
     HTTPTRANSPORT_HANDLE_DATA* handleData = deviceHandleData->transportHandle;
 
-    listItem = (IOTHUB_DEVICE_HANDLE *)VECTOR_find_if(handleData->perDeviceList, findDeviceHandle, deviceHandle);
-    if (listItem == NULL)
+    /*the device is looked up at the position it saved, which is only valid if the device found there is deviceHandle*/
+    if (deviceHandleData->perDeviceListPosition >= VECTOR_size(handleData->perDeviceList) ||
+        (listItem = (IOTHUB_DEVICE_HANDLE *)VECTOR_element(handleData->perDeviceList, deviceHandleData->perDeviceListPosition)) == NULL ||
+        *listItem != deviceHandle)
     {
         LogError("device handle not found in transport device list");
         listItem = NULL;
@@ -680,7 +744,7 @@ static void IoTHubTransportHttp_Unregister(IOTHUB_DEVICE_HANDLE deviceHandle)
     {
         HTTPTRANSPORT_PERDEVICE_DATA* deviceHandleData = (HTTPTRANSPORT_PERDEVICE_DATA*)deviceHandle;
         HTTPTRANSPORT_HANDLE_DATA* handleData = deviceHandleData->transportHandle;
-        /*Codes_SRS_TRANSPORTMULTITHTTP_17_045: [ IoTHubTransportHttp_Unregister shall locate deviceHandle in the transport device list by calling list_find_if. ]*/
+        /*Codes_SRS_TRANSPORTMULTITHTTP_17_045: [ IoTHubTransportHttp_Unregister shall locate deviceHandle in the transport device list at the position saved in the device structure. ]*/
         IOTHUB_DEVICE_HANDLE* listItem = get_perDeviceDataItem(deviceHandle);
         if (listItem == NULL)
         {
@@ -694,7 +758,7 @@ static void IoTHubTransportHttp_Unregister(IOTHUB_DEVICE_HANDLE deviceHandle)
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_047: [ IoTHubTransportHttp_Unregister shall free all the resources used in the device structure. ]*/
             destroy_perDeviceData(perDeviceItem);
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_048: [ IoTHubTransportHttp_Unregister shall call singlylinkedlist_remove to remove device from devices list. ]*/
-            VECTOR_erase(handleData->perDeviceList, listItem, 1);
+            remove_perDeviceListItem(handleData, listItem);
             free(deviceHandleData);
         }
     }
@@ -777,6 +841,43 @@ static void destroy_perDeviceList(HTTPTRANSPORT_HANDLE_DATA* handleData)
     handleData->perDeviceList = NULL;
 }
 
+static void destroy_perDeviceIndex(HTTPTRANSPORT_HANDLE_DATA* handleData)
+{
+    device_index_destroy(handleData->perDeviceIndex);
+    handleData->perDeviceIndex = NULL;
+}
+
+static void destroy_compression(HTTPTRANSPORT_HANDLE_DATA* handleData)
+{
+    if (handleData->compression != NULL)
+    {
+        http_compression_destroy(handleData->compression);
+        handleData->compression = NULL;
+    }
+    if (handleData->compressedPayload != NULL)
+    {
+        BUFFER_delete(handleData->compressedPayload);
+        handleData->compressedPayload = NULL;
+    }
+}
+
+/*Codes_SRS_TRANSPORTMULTITHTTP_10_018: [ IoTHubTransportHttp_Create shall call device_index_create to create an index of the registered devices by deviceId. ]*/
+static bool create_perDeviceIndex(HTTPTRANSPORT_HANDLE_DATA* handleData)
+{
+    bool result;
+    handleData->perDeviceIndex = device_index_create();
+    if (handleData->perDeviceIndex == NULL)
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_10_019: [ If creating the index fails, then IoTHubTransportHttp_Create shall fail and return NULL. ]*/
+        result = false;
+    }
+    else
+    {
+        result = true;
+    }
+    return result;
+}
+
 /*Codes_SRS_TRANSPORTMULTITHTTP_17_009: [ IoTHubTransportHttp_Create shall call singlylinkedlist_create to create a list of registered devices. ]*/
 static bool create_perDeviceList(HTTPTRANSPORT_HANDLE_DATA* handleData)
 {
@@ -842,16 +943,25 @@ static TRANSPORT_LL_HANDLE IoTHubTransportHttp_Create(const IOTHUBTRANSPORT_CONF
             bool was_hostName_ok = create_hostName(result, config);
             bool was_httpApiExHandle_ok = was_hostName_ok && create_httpApiExHandle(result, config);
             bool was_perDeviceList_ok = was_httpApiExHandle_ok && create_perDeviceList(result);
+            bool was_perDeviceIndex_ok = was_perDeviceList_ok && create_perDeviceIndex(result);
 
 
-            if (was_perDeviceList_ok)
+            if (was_perDeviceIndex_ok)
             {
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_011: [ Otherwise, IoTHubTransportHttp_Create shall succeed and return a non-NULL value. ]*/
                 result->doBatchedTransfers = false;
                 result->getMinimumPollingTime = DEFAULT_GETMINIMUMPOLLINGTIME;
+                /*Codes_SRS_TRANSPORTMULTITHTTP_10_024: [ IoTHubTransportHttp_Create shall set the transport to send batches uncompressed, with a compression threshold of 1024 bytes. ]*/
+                result->compression = NULL;
+                result->compressionMinimumSize = DEFAULT_COMPRESSION_MINIMUM_SIZE;
+                result->compressedPayload = NULL;
+                /*Codes_SRS_TRANSPORTMULTITHTTP_10_033: [ IoTHubTransportHttp_Create shall set the transport to poll for messages every MinimumPollingTime, with adaptive polling off. ]*/
+                result->adaptivePolling.minimumIntervalInSeconds = 0;
+                result->adaptivePolling.maximumIntervalInSeconds = 0;
             }
             else
             {
+                if (was_perDeviceList_ok) destroy_perDeviceList(result);
                 if (was_httpApiExHandle_ok) destroy_httpApiExHandle(result);
                 if (was_hostName_ok) destroy_hostName(result);
 
@@ -885,6 +995,8 @@ static void IoTHubTransportHttp_Destroy(TRANSPORT_LL_HANDLE handle)
         destroy_hostName((HTTPTRANSPORT_HANDLE_DATA *)handle);
         destroy_httpApiExHandle((HTTPTRANSPORT_HANDLE_DATA *)handle);
         destroy_perDeviceList((HTTPTRANSPORT_HANDLE_DATA *)handle);
+        destroy_perDeviceIndex((HTTPTRANSPORT_HANDLE_DATA *)handle);
+        destroy_compression((HTTPTRANSPORT_HANDLE_DATA *)handle);
         free(handle);
     }
 }
@@ -900,7 +1012,7 @@ static int IoTHubTransportHttp_Subscribe(IOTHUB_DEVICE_HANDLE handle)
     }
     else
     {
-        /*Codes_SRS_TRANSPORTMULTITHTTP_17_104: [ IoTHubTransportHttp_Subscribe shall locate deviceHandle in the transport device list by calling list_find_if. ]*/
+        /*Codes_SRS_TRANSPORTMULTITHTTP_17_104: [ IoTHubTransportHttp_Subscribe shall locate deviceHandle in the transport device list at the position saved in the device structure. ]*/
         IOTHUB_DEVICE_HANDLE* listItem = get_perDeviceDataItem(handle);
 
         if (listItem == NULL)
@@ -927,7 +1039,7 @@ static void IoTHubTransportHttp_Unsubscribe(IOTHUB_DEVICE_HANDLE handle)
     /*Codes_SRS_TRANSPORTMULTITHTTP_17_107: [ If parameter deviceHandle is NULL then IoTHubTransportHttp_Unsubscribe shall fail do nothing. ]*/
     if (handle != NULL)
     {
-        /*Codes_SRS_TRANSPORTMULTITHTTP_17_108: [ IoTHubTransportHttp_Unsubscribe shall locate deviceHandle in the transport device list by calling list_find_if. ]*/
+        /*Codes_SRS_TRANSPORTMULTITHTTP_17_108: [ IoTHubTransportHttp_Unsubscribe shall locate deviceHandle in the transport device list at the position saved in the device structure. ]*/
         IOTHUB_DEVICE_HANDLE* listItem = get_perDeviceDataItem(handle);
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_109: [ If the device structure is not found, then this function shall fail and do nothing. ]*/
         if (listItem != NULL)
@@ -988,365 +1100,252 @@ static int IoTHubTransportHttp_DeviceMethod_Response(IOTHUB_DEVICE_HANDLE handle
     return __FAILURE__;
 }
 
-/*produces a representation of the properties, if they exist*/
-/*if they do not exist, produces ""*/
-static int concat_Properties(STRING_HANDLE existing, MAP_HANDLE map, size_t* propertiesMessageSizeContribution)
+static size_t getSegmentsSize(const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT* segments, size_t segmentCount)
+{
+    size_t result = 0;
+    size_t index;
+    for (index = 0; index < segmentCount; index++)
+    {
+        result += segments[index].size;
+    }
+    return result;
+}
+
+/*gathers the segments straight into the buffer that is sent*/
+static int buildBufferFromSegments(BUFFER_HANDLE destination, const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT* segments, size_t segmentCount)
 {
     int result;
-    const char*const* keys;
-    const char*const* values;
-    size_t count;
-    if (Map_GetInternals(map, &keys, &values, &count) != MAP_OK)
+    if (segmentCount == 1)
     {
-        result = __FAILURE__;
-        LogError("error while Map_GetInternals");
+        result = BUFFER_build(destination, segments[0].buffer, segments[0].size);
     }
     else
     {
-
-        if (count == 0)
+        size_t size = getSegmentsSize(segments, segmentCount);
+        if ((size > 0) && (BUFFER_pre_build(destination, size) != 0))
         {
-            /*Codes_SRS_TRANSPORTMULTITHTTP_17_064: [If IoTHubMessage does not have properties, then "properties":{...} shall be missing from the payload*/
-            /*no properties - do nothing with existing*/
-            result = 0;
-            *propertiesMessageSizeContribution = 0;
+            result = __FAILURE__;
         }
         else
         {
-            /*Codes_SRS_TRANSPORTMULTITHTTP_17_058: [If IoTHubMessage has properties, then they shall be serialized at the same level as "body" using the following pattern: "properties":{"iothub-app-name1":"value1","iothub-app-name2":"value2*/
-            if (STRING_concat(existing, ",\"properties\":") != 0)
-            {
-                /*go ahead and return it*/
-                result = __FAILURE__;
-                LogError("failed STRING_concat");
-            }
-            else if (appendMapToJSON(existing, keys, values, count) != 0)
+            unsigned char* target = BUFFER_u_char(destination);
+            size_t index;
+            for (index = 0; index < segmentCount; index++)
             {
-                result = __FAILURE__;
-                LogError("unable to append the properties");
-            }
-            else
-            {
-                /*all is fine*/
-                size_t i;
-                *propertiesMessageSizeContribution = 0;
-                for (i = 0; i < count; i++)
-                {
-                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_063: [Every property name shall add to the message size the length of the property name + the length of the property value + 16 bytes.] */
-                    *propertiesMessageSizeContribution += (strlen(keys[i]) + strlen(values[i]) + MAXIMUM_PROPERTY_OVERHEAD);
-                }
-                result = 0;
+                (void)memcpy(target, segments[index].buffer, segments[index].size);
+                target += segments[index].size;
             }
+            result = 0;
         }
     }
     return result;
 }
 
-/*produces a JSON representation of the map : {"a": "value_of_a","b":"value_of_b"}*/
-static int appendMapToJSON(STRING_HANDLE existing, const char* const* keys, const char* const* values, size_t count) /*under consideration: move to MAP module when it has more than 1 user*/
+#define MAKE_PAYLOAD_RESULT_VALUES \
+    MAKE_PAYLOAD_OK, /*returned when there is a payload to be later send by HTTP*/ \
+    MAKE_PAYLOAD_NO_ITEMS, /*returned when there are no items to be send*/ \
+    MAKE_PAYLOAD_ERROR, /*returned when there were errors*/ \
+    MAKE_PAYLOAD_FIRST_ITEM_DOES_NOT_FIT /*returned when the first item doesn't fit*/
+
+DEFINE_ENUM(MAKE_PAYLOAD_RESULT, MAKE_PAYLOAD_RESULT_VALUES);
+
+/*BUFFER has no room beyond its length, so the payload of the device is only reallocated when a batch does not have the size of the previous one*/
+/*Codes_SRS_TRANSPORTMULTITHTTP_10_021: [ The payload shall be written in the batch buffer of the device, which is created by BUFFER_new for the first batch and resized with BUFFER_unbuild and BUFFER_pre_build only when the size of the payload differs from BUFFER_length. ]*/
+static int sizeBatchPayload(HTTPTRANSPORT_PERDEVICE_DATA* deviceData, size_t payloadSize)
 {
     int result;
-    if (STRING_concat(existing, "{") != 0)
+    if ((deviceData->batchPayload == NULL) && ((deviceData->batchPayload = BUFFER_new()) == NULL))
     {
-        /*go on and return it*/
-        LogError("STRING_construct failed");
+        LogError("unable to BUFFER_new");
+        result = __FAILURE__;
+    }
+    else if (BUFFER_length(deviceData->batchPayload) == payloadSize)
+    {
+        result = 0;
+    }
+    else if ((BUFFER_unbuild(deviceData->batchPayload) != 0) || (BUFFER_pre_build(deviceData->batchPayload, payloadSize) != 0))
+    {
+        LogError("unable to size the batch payload to %lu bytes", (unsigned long)payloadSize);
         result = __FAILURE__;
     }
     else
     {
-        size_t i;
-        for (i = 0; i < count; i++)
+        result = 0;
+    }
+    return result;
+}
+
+/*this function assembles several {"body":"base64 encoding of the message content"," base64Encoded": true} into 1 payload*/
+/*the items are sized first, so the payload is written in place in deviceData->batchPayload, without intermediate strings*/
+/*Codes_SRS_TRANSPORTMULTITHTTP_17_056: [IoTHubTransportHttp_DoWork shall build the following string:[{"body":"base64 encoding of the message1 content"},{"body":"base64 encoding of the message2 content"}...]]*/
+static MAKE_PAYLOAD_RESULT makePayload(HTTPTRANSPORT_PERDEVICE_DATA* deviceData)
+{
+    MAKE_PAYLOAD_RESULT result = MAKE_PAYLOAD_OK; /*optimistically initializing it*/
+    size_t allMessagesSize = 0;
+    size_t payloadSize = 1; /*the '[', then every item is followed by a ',' or, for the last one, by a ']'*/
+    size_t itemCount = 0;
+    PDLIST_ENTRY actual;
+
+    /*Codes_SRS_TRANSPORTMULTITHTTP_10_020: [ IoTHubTransportHttp_DoWork shall call event_batch_get_item_size for the oldest messages in waitingToSend, until the list ends or a message does not fit in the message size limit, to compute the size of the payload. ]*/
+    for (actual = deviceData->waitingToSend->Flink; actual != deviceData->waitingToSend; actual = actual->Flink)
+    {
+        IOTHUB_MESSAGE_LIST* message = containingRecord(actual, IOTHUB_MESSAGE_LIST, entry);
+        size_t itemSize;
+        size_t messageSize;
+        if (event_batch_get_item_size(message->messageHandle, &itemSize, &messageSize) != 0)
         {
-            if (!(
-                (STRING_concat(existing, (i == 0) ? "\"" IOTHUB_APP_PREFIX : ",\"" IOTHUB_APP_PREFIX) == 0) &&
-                (STRING_concat(existing, keys[i]) == 0) &&
-                (STRING_concat(existing, "\":\"") == 0) &&
-                (STRING_concat(existing, values[i]) == 0) &&
-                (STRING_concat(existing, "\"") == 0)
-                ))
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
+            LogError("unable to serialize a message of the batch");
+            if (itemCount == 0)
             {
-                LogError("unable to STRING_concat");
-                break;
+                result = MAKE_PAYLOAD_ERROR;
             }
+            break;
         }
-
-        if (i < count)
-        {
-            result = __FAILURE__;
-            /*error, let it go through*/
-        }
-        else if (STRING_concat(existing, "}") != 0)
+        /*Codes_SRS_TRANSPORTMULTITHTTP_17_061: [The message size shall be limited to 255KB - 1 byte.]*/
+        else if (allMessagesSize + messageSize > MAXIMUM_MESSAGE_SIZE)
         {
-            LogError("unable to STRING_concat");
-            result = __FAILURE__;
+            if (itemCount == 0)
+            {
+                /*Codes_SRS_TRANSPORTMULTITHTTP_17_065: [If the oldest message in waitingToSend causes the message size to exceed the message size limit then it shall be removed from waitingToSend, and IoTHubClient_LL_SendComplete shall be called. Parameter PDLIST_ENTRY completed shall point to a list containing only the oldest item, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_BATCHSTATE_FAILED.]*/
+                PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
+                DList_InsertTailList(&(deviceData->eventConfirmations), head);
+                result = MAKE_PAYLOAD_FIRST_ITEM_DOES_NOT_FIT;
+            }
+            /*else this item doesn't make it to the payload, but the payload is valid so far*/
+            break;
         }
         else
         {
-            /*all is fine*/
-            result = 0;
+            allMessagesSize += messageSize;
+            payloadSize += itemSize + 1;
+            itemCount++;
         }
     }
-    return result;
-}
-
-/*makes the following string:{"body":"base64 encoding of the message content"[,"properties":{"a":"valueOfA"}]}*/
-/*return NULL if there was a failure, or a non-NULL STRING_HANDLE that contains the intended data*/
-static STRING_HANDLE make1EventJSONitem(PDLIST_ENTRY item, size_t *messageSizeContribution)
-{
-    STRING_HANDLE result; /*temp wants to contain :{"body":"base64 encoding of the message content"[,"properties":{"a":"valueOfA"}]}*/
-    IOTHUB_MESSAGE_LIST* message = containingRecord(item, IOTHUB_MESSAGE_LIST, entry);
-    IOTHUBMESSAGE_CONTENT_TYPE contentType = IoTHubMessage_GetContentType(message->messageHandle);
 
-    switch (contentType)
+    if (result == MAKE_PAYLOAD_OK)
     {
-    case IOTHUBMESSAGE_BYTEARRAY:
-    {
-        result = STRING_construct("{\"body\":\"");
-        if (result == NULL)
+        if (itemCount == 0)
+        {
+            result = MAKE_PAYLOAD_NO_ITEMS;
+        }
+        else if (sizeBatchPayload(deviceData, payloadSize) != 0)
         {
-            LogError("unable to STRING_construct");
+            /*Codes_SRS_TRANSPORTMULTITHTTP_10_023: [ If the batch buffer cannot be created or sized, or an item cannot be written, IoTHubTransportHttp_DoWork shall leave the messages in waitingToSend and advance to the next activity. ]*/
+            result = MAKE_PAYLOAD_ERROR;
         }
         else
         {
-            const unsigned char* source;
-            size_t size;
+            /*Codes_SRS_TRANSPORTMULTITHTTP_10_022: [ IoTHubTransportHttp_DoWork shall write the items with event_batch_write_item straight into the batch buffer, separated by ',' between '[' and ']', then move their messages from waitingToSend to eventConfirmations. ]*/
+            unsigned char* destination = BUFFER_u_char(deviceData->batchPayload);
+            size_t written = 1;
+            size_t i;
 
-            if (IoTHubMessage_GetByteArray(message->messageHandle, &source, &size) != IOTHUB_MESSAGE_OK)
+            destination[0] = '[';
+            for (i = 0, actual = deviceData->waitingToSend->Flink; i < itemCount; i++, actual = actual->Flink)
             {
-                LogError("unable to get the data for the message.");
-                STRING_delete(result);
-                result = NULL;
-            }
-            else
-            {
-                STRING_HANDLE encoded = Base64_Encode_Bytes(source, size);
-                if (encoded == NULL)
-                {
-                    LogError("unable to Base64_Encode_Bytes.");
-                    STRING_delete(result);
-                    result = NULL;
-                }
-                else
+                IOTHUB_MESSAGE_LIST* message = containingRecord(actual, IOTHUB_MESSAGE_LIST, entry);
+                size_t itemSize;
+                if (event_batch_write_item(message->messageHandle, destination + written, payloadSize - written - 1, &itemSize) != 0)
                 {
-                    size_t propertiesSize = 0;
-                    if (!(
-                        (STRING_concat_with_STRING(result, encoded) == 0) &&
-                        (STRING_concat(result, "\"") == 0) && /*\" because closing value*/
-                        (concat_Properties(result, IoTHubMessage_Properties(message->messageHandle), &propertiesSize) == 0) &&
-                        (STRING_concat(result, "},") == 0) /*the last comma shall be replaced by a ']' by DaCr's suggestion (which is awesome enough to receive credits in the source code)*/
-                        ))
-                    {
-                        STRING_delete(result);
-                        result = NULL;
-                        LogError("unable to STRING_concat_with_STRING.");
-                    }
-                    else
-                    {
-                        /*all is fine... */
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_062: [The message size is computed from the length of the payload + 384.] */
-                        *messageSizeContribution = size + MAXIMUM_PAYLOAD_OVERHEAD + propertiesSize;
-                    }
-                    STRING_delete(encoded);
+                    LogError("unable to write a message of the batch");
+                    break;
                 }
+                written += itemSize;
+                destination[written++] = (i + 1 == itemCount) ? ']' : ',';
             }
-        }
-        break;
-    }
-    /*Codes_SRS_TRANSPORTMULTITHTTP_17_057: [If a messages to be send has type IOTHUBMESSAGE_STRING, then its serialization shall be {"body":"JSON encoding of the string", "base64Encoded":false}] */
-    case IOTHUBMESSAGE_STRING:
-    {
-        result = STRING_construct("{\"body\":");
-        if (result == NULL)
-        {
-            LogError("unable to STRING_construct");
-        }
-        else
-        {
-            const char* source = IoTHubMessage_GetString(message->messageHandle);
-            if (source == NULL)
+
+            if ((i < itemCount) || (written != payloadSize))
             {
-                LogError("unable to IoTHubMessage_GetString");
-                STRING_delete(result);
-                result = NULL;
+                /*Codes_SRS_TRANSPORTMULTITHTTP_10_023: [ If the batch buffer cannot be created or sized, or an item cannot be written, IoTHubTransportHttp_DoWork shall leave the messages in waitingToSend and advance to the next activity. ]*/
+                result = MAKE_PAYLOAD_ERROR;
             }
             else
             {
-                STRING_HANDLE asJson = STRING_new_JSON(source);
-                if (asJson == NULL)
-                {
-                    LogError("unable to STRING_new_JSON");
-                    STRING_delete(result);
-                    result = NULL;
-                }
-                else
+                for (i = 0; i < itemCount; i++)
                 {
-                    size_t propertiesSize = 0;
-                    if (!(
-                        (STRING_concat_with_STRING(result, asJson) == 0) &&
-                        (STRING_concat(result, ",\"base64Encoded\":false") == 0) &&
-                        (concat_Properties(result, IoTHubMessage_Properties(message->messageHandle), &propertiesSize) == 0) &&
-                        (STRING_concat(result, "},") == 0) /*the last comma shall be replaced by a ']' by DaCr's suggestion (which is awesome enough to receive credits in the source code)*/
-                        ))
-                    {
-                        LogError("unable to STRING_concat_with_STRING");
-                        STRING_delete(result);
-                        result = NULL;
-                    }
-                    else
-                    {
-                        /*result has the intended content*/
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_062: [The message size is computed from the length of the payload + 384.] */
-                        *messageSizeContribution = strlen(source) + MAXIMUM_PAYLOAD_OVERHEAD + propertiesSize;
-                    }
-                    STRING_delete(asJson);
+                    PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend);
+                    DList_InsertTailList(&(deviceData->eventConfirmations), head);
                 }
             }
         }
-        break;
-    }
-    default:
-    {
-        LogError("an unknown message type was encountered (%d)", contentType);
-        result = NULL; /*unknown message type*/
-        break;
-    }
     }
+
     return result;
 }
+static void reversePutListBackIn(PDLIST_ENTRY source, PDLIST_ENTRY destination)
+{
+    /*this function takes a list, and inserts it in another list. When done in the context of this file, it reverses the effects of a not-able-to-send situation*/
+    DList_AppendTailList(destination->Flink, source);
+    DList_RemoveEntryList(source);
+    DList_InitializeListHead(source);
+}
 
-#define MAKE_PAYLOAD_RESULT_VALUES \
-    MAKE_PAYLOAD_OK, /*returned when there is a payload to be later send by HTTP*/ \
-    MAKE_PAYLOAD_NO_ITEMS, /*returned when there are no items to be send*/ \
-    MAKE_PAYLOAD_ERROR, /*returned when there were errors*/ \
-    MAKE_PAYLOAD_FIRST_ITEM_DOES_NOT_FIT /*returned when the first item doesn't fit*/
-
-DEFINE_ENUM(MAKE_PAYLOAD_RESULT, MAKE_PAYLOAD_RESULT_VALUES);
-
-/*this function assembles several {"body":"base64 encoding of the message content"," base64Encoded": true} into 1 payload*/
-/*Codes_SRS_TRANSPORTMULTITHTTP_17_056: [IoTHubTransportHttp_DoWork shall build the following string:[{"body":"base64 encoding of the message1 content"},{"body":"base64 encoding of the message2 content"}...]]*/
-static MAKE_PAYLOAD_RESULT makePayload(HTTPTRANSPORT_PERDEVICE_DATA* deviceData, STRING_HANDLE* payload)
+/*when the batch cannot be compressed, or compressing it would not make it smaller, it is sent uncompressed*/
+static void selectBatchRequest(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, HTTP_HEADERS_HANDLE* requestHeaders, BUFFER_HANDLE* requestContent)
 {
-    MAKE_PAYLOAD_RESULT result;
-    size_t allMessagesSize = 0;
-    *payload = STRING_construct("[");
-    if (*payload == NULL)
-    {
-        LogError("unable to STRING_construct");
-        result = MAKE_PAYLOAD_ERROR;
-    }
-    else
+    *requestHeaders = deviceData->eventHTTPrequestHeaders;
+    *requestContent = deviceData->batchPayload;
+
+    /*Codes_SRS_TRANSPORTMULTITHTTP_10_025: [ If compression is enabled and the batch payload is at least as long as the compression threshold, IoTHubTransportHttp_DoWork shall compress it with http_compression_compress. ]*/
+    if ((handleData->compression != NULL) && (BUFFER_length(deviceData->batchPayload) >= handleData->compressionMinimumSize))
     {
-        bool isFirst = true;
-        PDLIST_ENTRY actual;
-        bool keepGoing = true; /*keepGoing gets sometimes to false from within the loop*/
-                               /*either all the items enter the list or only some*/
-        result = MAKE_PAYLOAD_OK; /*optimistically initializing it*/
-        while (keepGoing && ((actual = deviceData->waitingToSend->Flink) != deviceData->waitingToSend))
+        if ((handleData->compressedPayload == NULL) && ((handleData->compressedPayload = BUFFER_new()) == NULL))
         {
-            size_t messageSize;
-            STRING_HANDLE temp = make1EventJSONitem(actual, &messageSize);
-            if (isFirst)
-            {
-                isFirst = false;
-                /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
-                if (temp == NULL) /*first item failed to create, nothing to send*/
-                {
-                    result = MAKE_PAYLOAD_ERROR;
-                    STRING_delete(*payload);
-                    *payload = NULL;
-                    keepGoing = false;
-                }
-                else
-                {
-                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_065: [If the oldest message in waitingToSend causes the message size to exceed the message size limit then it shall be removed from waitingToSend, and IoTHubClient_LL_SendComplete shall be called. Parameter PDLIST_ENTRY completed shall point to a list containing only the oldest item, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_BATCHSTATE_FAILED.]*/
-                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_061: [The message size shall be limited to 255KB - 1 byte.]*/
-                    if (messageSize > MAXIMUM_MESSAGE_SIZE)
-                    {
-                        PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                        DList_InsertTailList(&(deviceData->eventConfirmations), head);
-                        result = MAKE_PAYLOAD_FIRST_ITEM_DOES_NOT_FIT;
-                        STRING_delete(*payload);
-                        *payload = NULL;
-                        keepGoing = false;
-                    }
-                    else
-                    {
-                        if (STRING_concat_with_STRING(*payload, temp) != 0)
-                        {
-                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
-                            result = MAKE_PAYLOAD_ERROR;
-                            STRING_delete(*payload);
-                            *payload = NULL;
-                            keepGoing = false;
-                        }
-                        else
-                        {
-                            /*first item was put nicely in the payload*/
-                            PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                            DList_InsertTailList(&(deviceData->eventConfirmations), head);
-                            allMessagesSize += messageSize;
-                        }
-                    }
-                    STRING_delete(temp);
-                }
-            }
-            else
-            {
-                /*there is at least 1 item already in the payload*/
-                if (temp == NULL)
-                {
-                    /*there are multiple payloads encoded, the last one had an internal error, just go with those - closing the payload happens "after the loop"*/
-                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
-                    result = MAKE_PAYLOAD_OK;
-                    keepGoing = false;
-                }
-                else
-                {
-                    if (allMessagesSize + messageSize > MAXIMUM_MESSAGE_SIZE)
-                    {
-                        /*this item doesn't make it to the payload, but the payload is valid so far*/
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
-                        result = MAKE_PAYLOAD_OK;
-                        keepGoing = false;
-                    }
-                    else if (STRING_concat_with_STRING(*payload, temp) != 0)
-                    {
-                        /*should still send what there is so far...*/
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
-                        result = MAKE_PAYLOAD_OK;
-                        keepGoing = false;
-                    }
-                    else
-                    {
-                        /*cool, the payload made it there, let's continue... */
-                        PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                        DList_InsertTailList(&(deviceData->eventConfirmations), head);
-                        allMessagesSize += messageSize;
-                    }
-                    STRING_delete(temp);
-                }
-            }
+            /*Codes_SRS_TRANSPORTMULTITHTTP_10_027: [ If compressing the batch payload fails or does not make it smaller, IoTHubTransportHttp_DoWork shall send it uncompressed. ]*/
+            LogError("unable to BUFFER_new, sending the batch uncompressed");
         }
-
-        /*closing the payload*/
-        if (result == MAKE_PAYLOAD_OK)
+        else if (deviceData->compressedEventHTTPrequestHeaders == NULL &&
+            (((deviceData->compressedEventHTTPrequestHeaders = HTTPHeaders_Clone(deviceData->eventHTTPrequestHeaders)) == NULL) ||
+            (HTTPHeaders_AddHeaderNameValuePair(deviceData->compressedEventHTTPrequestHeaders, CONTENT_ENCODING, HTTP_COMPRESSION_CONTENT_ENCODING) != HTTP_HEADERS_OK)))
         {
-            ((char*)STRING_c_str(*payload))[STRING_length(*payload) - 1] = ']'; /*TODO - do this in STRING_HANDLE*/
+            /*Codes_SRS_TRANSPORTMULTITHTTP_10_027: [ If compressing the batch payload fails or does not make it smaller, IoTHubTransportHttp_DoWork shall send it uncompressed. ]*/
+            LogError("unable to make the request headers of compressed batches, sending the batch uncompressed");
+            destroy_compressedEventHTTPrequestHeaders(deviceData);
+        }
+        else if (http_compression_compress(handleData->compression, deviceData->batchPayload, handleData->compressedPayload) != 0)
+        {
+            /*Codes_SRS_TRANSPORTMULTITHTTP_10_027: [ If compressing the batch payload fails or does not make it smaller, IoTHubTransportHttp_DoWork shall send it uncompressed. ]*/
         }
         else
         {
-            /*no need to close anything*/
+            /*Codes_SRS_TRANSPORTMULTITHTTP_10_026: [ A compressed batch shall be sent with the event request headers of the device plus "Content-Encoding: gzip", made once per device by HTTPHeaders_Clone and HTTPHeaders_AddHeaderNameValuePair. ]*/
+            *requestHeaders = deviceData->compressedEventHTTPrequestHeaders;
+            *requestContent = handleData->compressedPayload;
         }
     }
-    return result;
 }
 
-static void reversePutListBackIn(PDLIST_ENTRY source, PDLIST_ENTRY destination)
+static bool isAdaptivePollingOn(const HTTPTRANSPORT_HANDLE_DATA* handleData)
 {
-    /*this function takes a list, and inserts it in another list. When done in the context of this file, it reverses the effects of a not-able-to-send situation*/
-    DList_AppendTailList(destination->Flink, source);
-    DList_RemoveEntryList(source);
-    DList_InitializeListHead(source);
+    return handleData->adaptivePolling.maximumIntervalInSeconds != 0;
+}
+
+static void resetPollingInterval(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData)
+{
+    /*Codes_SRS_TRANSPORTMULTITHTTP_10_040: [ Once telemetry of a device is confirmed with IOTHUB_CLIENT_CONFIRMATION_OK, a polling wait longer than minimumIntervalInSeconds shall be brought back to minimumIntervalInSeconds. ]*/
+    if (deviceData->pollingInterval > handleData->adaptivePolling.minimumIntervalInSeconds)
+    {
+        deviceData->pollingInterval = handleData->adaptivePolling.minimumIntervalInSeconds;
+    }
+}
+
+static void backOffPollingInterval(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData)
+{
+    /*Codes_SRS_TRANSPORTMULTITHTTP_10_039: [ When a GET is answered with any status code other than 200, the polling wait shall become minimumIntervalInSeconds if it is shorter, otherwise it shall be doubled, up to maximumIntervalInSeconds. ]*/
+    if (deviceData->pollingInterval < handleData->adaptivePolling.minimumIntervalInSeconds)
+    {
+        deviceData->pollingInterval = handleData->adaptivePolling.minimumIntervalInSeconds;
+    }
+    else if (deviceData->pollingInterval > handleData->adaptivePolling.maximumIntervalInSeconds / 2)
+    {
+        deviceData->pollingInterval = handleData->adaptivePolling.maximumIntervalInSeconds;
+    }
+    else
+    {
+        deviceData->pollingInterval *= 2;
+    }
 }
 
 static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
@@ -1370,67 +1369,48 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
             else
             {
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_059: [It shall inspect the "waitingToSend" DLIST passed in config structure.] */
-                STRING_HANDLE payload;
-                switch (makePayload(deviceData, &payload))
+                switch (makePayload(deviceData))
                 {
                 case MAKE_PAYLOAD_OK:
                 {
                     /*Codes_SRS_TRANSPORTMULTITHTTP_17_068: [Once a final payload has been obtained, IoTHubTransportHttp_DoWork shall call HTTPAPIEX_SAS_ExecuteRequest passing the following parameters:] */
-                    BUFFER_HANDLE temp = BUFFER_new();
-                    if (temp == NULL)
+                    unsigned int statusCode;
+                    HTTP_HEADERS_HANDLE requestHeaders;
+                    BUFFER_HANDLE requestContent;
+                    selectBatchRequest(handleData, deviceData, &requestHeaders, &requestContent);
+                    if (HTTPAPIEX_SAS_ExecuteRequest(
+                        deviceData->sasObject,
+                        handleData->httpApiExHandle,
+                        HTTPAPI_REQUEST_POST,
+                        STRING_c_str(deviceData->eventHTTPrelativePath),
+                        requestHeaders,
+                        requestContent,
+                        &statusCode,
+                        NULL,
+                        NULL
+                    ) != HTTPAPIEX_OK)
                     {
-                        LogError("unable to BUFFER_new");
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
+                        LogError("unable to HTTPAPIEX_ExecuteRequest");
+                        //items go back to waitingToSend
+                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_069: [if HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
                         reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
                     }
                     else
                     {
-                        if (BUFFER_build(temp, (const unsigned char*)STRING_c_str(payload), STRING_length(payload)) != 0)
+                        if (statusCode < 300)
                         {
-                            LogError("unable to BUFFER_build");
-                            //items go back to waitingToSend
-                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
-                            reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
+                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_070: [If HTTPAPIEX_SAS_ExecuteRequest does not fail and http status code <300 then IoTHubTransportHttp_DoWork shall call IoTHubClient_LL_SendComplete. Parameter PDLIST_ENTRY completed shall point to a list containing all the items batched, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_OK. The batched items shall be removed from waitingToSend.] */
+                            IoTHubClient_LL_SendComplete(iotHubClientHandle, &(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_OK);
+                            resetPollingInterval(handleData, deviceData);
                         }
                         else
                         {
-                            unsigned int statusCode;
-                            if (HTTPAPIEX_SAS_ExecuteRequest(
-                                deviceData->sasObject,
-                                handleData->httpApiExHandle,
-                                HTTPAPI_REQUEST_POST,
-                                STRING_c_str(deviceData->eventHTTPrelativePath),
-                                deviceData->eventHTTPrequestHeaders,
-                                temp,
-                                &statusCode,
-                                NULL,
-                                NULL
-                            ) != HTTPAPIEX_OK)
-                            {
-                                LogError("unable to HTTPAPIEX_ExecuteRequest");
-                                //items go back to waitingToSend
-                                /*Codes_SRS_TRANSPORTMULTITHTTP_17_069: [if HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
-                                reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
-                            }
-                            else
-                            {
-                                if (statusCode < 300)
-                                {
-                                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_070: [If HTTPAPIEX_SAS_ExecuteRequest does not fail and http status code <300 then IoTHubTransportHttp_DoWork shall call IoTHubClient_LL_SendComplete. Parameter PDLIST_ENTRY completed shall point to a list containing all the items batched, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_OK. The batched items shall be removed from waitingToSend.] */
-                                    IoTHubClient_LL_SendComplete(iotHubClientHandle, &(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_OK);
-                                }
-                                else
-                                {
-                                    //items go back to waitingToSend
-                                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_069: [if HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
-                                    LogError("unexpected HTTP status code (%u)", statusCode);
-                                    reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
-                                }
-                            }
+                            //items go back to waitingToSend
+                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_069: [if HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
+                            LogError("unexpected HTTP status code (%u)", statusCode);
+                            reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
                         }
-                        BUFFER_delete(temp);
                     }
-                    STRING_delete(payload);
                     break;
                 }
                 case MAKE_PAYLOAD_FIRST_ITEM_DOES_NOT_FIT:
@@ -1461,14 +1441,17 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
             const unsigned char* messageContent = NULL;
             size_t messageSize = 0;
             size_t originalMessageSize = 0;
+            IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT stringSegment;
+            const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT* segments = &stringSegment;
+            size_t segmentCount = 1;
             IOTHUB_MESSAGE_LIST* message = containingRecord(deviceData->waitingToSend->Flink, IOTHUB_MESSAGE_LIST, entry);
             IOTHUBMESSAGE_CONTENT_TYPE contentType = IoTHubMessage_GetContentType(message->messageHandle);
 
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_073: [The message size is computed from the length of the payload + 384.]*/
             if (!(
                 (((contentType == IOTHUBMESSAGE_BYTEARRAY) &&
-                (IoTHubMessage_GetByteArray(message->messageHandle, &messageContent, &originalMessageSize) == IOTHUB_MESSAGE_OK))
-                    ? ((void)(messageSize = originalMessageSize + MAXIMUM_PAYLOAD_OVERHEAD), 1)
+                (IoTHubMessage_GetByteArraySegments(message->messageHandle, &segments, &segmentCount) == IOTHUB_MESSAGE_OK))
+                    ? ((void)(messageSize = (originalMessageSize = getSegmentsSize(segments, segmentCount)) + MAXIMUM_PAYLOAD_OVERHEAD), 1)
                     : 0)
 
                 ||
@@ -1516,7 +1499,7 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                         else
                         {
                             /*Codes_SRS_TRANSPORTMULTITHTTP_17_078: [Every message property "property":"value" shall be added to the HTTP headers as an individual header "iothub-app-property":"value".] */
-                            MAP_HANDLE map = IoTHubMessage_Properties(message->messageHandle);
+                            MAP_HANDLE map = IoTHubMessage_GetReadOnlyProperties(message->messageHandle);
                             const char*const* keys;
                             const char*const* values;
                             size_t count;
@@ -1633,7 +1616,10 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                                     }
                                     else
                                     {
-                                        if (BUFFER_build(toBeSend, messageContent, originalMessageSize) != 0)
+                                        /*Codes_SRS_TRANSPORTMULTITHTTP_10_012: [If a message of type IOTHUBMESSAGE_BYTEARRAY is made of several segments, they shall be copied one after the other straight into the body of the request.]*/
+                                        stringSegment.buffer = messageContent;
+                                        stringSegment.size = originalMessageSize;
+                                        if (buildBufferFromSegments(toBeSend, segments, segmentCount) != 0)
                                         {
                                             LogError("unable to BUFFER_build");
                                         }
@@ -1692,6 +1678,7 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                                                     PDLIST_ENTRY justSent = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
                                                     DList_InsertTailList(&(deviceData->eventConfirmations), justSent);
                                                     IoTHubClient_LL_SendComplete(iotHubClientHandle, &(deviceData->eventConfirmations), IOTHUB_CLIENT_CONFIRMATION_OK); /*takes care of emptying the list too*/
+                                                    resetPollingInterval(handleData, deviceData);
                                                 }
                                                 else
                                                 {
@@ -2006,7 +1993,21 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_124: [If time is not available then all calls shall be treated as if they are the first one.] */
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_122: [A GET request that happens earlier than GetMinimumPollingTime shall be ignored.] */
         time_t timeNow = get_time(NULL);
-        bool isPollingAllowed = deviceData->isFirstPoll || (timeNow == (time_t)(-1)) || (get_difftime(timeNow, deviceData->lastPollTime) > handleData->getMinimumPollingTime);
+        bool isPollingAllowed;
+        if (deviceData->isFirstPoll || (timeNow == (time_t)(-1)))
+        {
+            isPollingAllowed = true;
+        }
+        else if (isAdaptivePollingOn(handleData))
+        {
+            /*Codes_SRS_TRANSPORTMULTITHTTP_10_037: [ While adaptive polling is on, a GET shall be allowed once the polling wait of the device has passed since its last GET; a wait of 0 shall allow a GET at every _DoWork. ]*/
+            isPollingAllowed = (deviceData->pollingInterval == 0) || (get_difftime(timeNow, deviceData->lastPollTime) >= deviceData->pollingInterval);
+        }
+        else
+        {
+            isPollingAllowed = (get_difftime(timeNow, deviceData->lastPollTime) > handleData->getMinimumPollingTime);
+        }
+
         if (isPollingAllowed)
         {
             HTTP_HEADERS_HANDLE responseHTTPHeaders = HTTPHeaders_Alloc();
@@ -2014,6 +2015,7 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
             {
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_085: [If the call to HTTPAPIEX_SAS_ExecuteRequest did not executed successfully or building any part of the prerequisites of the call fails, then _DoWork shall advance to the next action in this description.] */
                 LogError("unable to HTTPHeaders_Alloc");
+                deviceData->pollingStatistics.failedPollCount++;
             }
             else
             {
@@ -2022,6 +2024,7 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                 {
                     /*Codes_SRS_TRANSPORTMULTITHTTP_17_085: [If the call to HTTPAPIEX_SAS_ExecuteRequest did not executed successfully or building any part of the prerequisites of the call fails, then _DoWork shall advance to the next action in this description.] */
                     LogError("unable to BUFFER_new");
+                    deviceData->pollingStatistics.failedPollCount++;
                 }
                 else
                 {
@@ -2088,20 +2091,30 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                             deviceData->isFirstPoll = false;
                             deviceData->lastPollTime = timeNow;
                         }
+                        /*Codes_SRS_TRANSPORTMULTITHTTP_10_043: [ Every GET shall be counted in the polling statistics of the device: answered ones by their status code, the others as failed. ]*/
+                        deviceData->pollingStatistics.pollCount++;
                         if (statusCode == 204)
                         {
                             /*Codes_SRS_TRANSPORTMULTITHTTP_17_086: [If the HTTPAPIEX_SAS_ExecuteRequest executed successfully then status code shall be examined. Any status code different than 200 causes _DoWork to advance to the next action.] */
                             /*this is an expected status code, means "no commands", but logging that creates panic*/
 
                             /*do nothing, advance to next action*/
+                            deviceData->pollingStatistics.emptyPollCount++;
+                            backOffPollingInterval(handleData, deviceData);
                         }
                         else if (statusCode != 200)
                         {
                             /*Codes_SRS_TRANSPORTMULTITHTTP_17_086: [If the HTTPAPIEX_SAS_ExecuteRequest executed successfully then status code shall be examined. Any status code different than 200 causes _DoWork to advance to the next action.] */
                             LogError("expected status code was 200, but actually was received %u... moving on", statusCode);
+                            deviceData->pollingStatistics.failedPollCount++;
+                            backOffPollingInterval(handleData, deviceData);
                         }
                         else
                         {
+                            /*Codes_SRS_TRANSPORTMULTITHTTP_10_038: [ When a GET is answered with 200, the polling wait of the device shall become 0 so that it polls again at the next _DoWork. ]*/
+                            deviceData->pollingStatistics.messagePollCount++;
+                            deviceData->pollingInterval = 0;
+
                             /*Codes_SRS_TRANSPORTMULTITHTTP_17_087: [If status code is 200, then _DoWork shall make a copy of the value of the "ETag" http header.]*/
                             const char* etagValue = HTTPHeaders_FindHeaderValue(responseHTTPHeaders, "ETag");
                             if (etagValue == NULL)
@@ -2285,6 +2298,10 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                             }
                         }
                     }
+                    else
+                    {
+                        deviceData->pollingStatistics.failedPollCount++;
+                    }
                     BUFFER_delete(responseContent);
                 }
                 HTTPHeaders_Free(responseHTTPHeaders);
@@ -2353,7 +2370,7 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportHttp_GetSendStatus(IOTHUB_DEVICE_HAND
     }
     else
     {
-        /*Codes_SRS_TRANSPORTMULTITHTTP_17_138: [ IoTHubTransportHttp_GetSendStatus shall locate deviceHandle in the transport device list by calling list_find_if. ]*/
+        /*Codes_SRS_TRANSPORTMULTITHTTP_17_138: [ IoTHubTransportHttp_GetSendStatus shall locate deviceHandle in the transport device list at the position saved in the device structure. ]*/
         IOTHUB_DEVICE_HANDLE* listItem = get_perDeviceDataItem(handle);
         if (listItem == NULL)
         {
@@ -2381,6 +2398,62 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportHttp_GetSendStatus(IOTHUB_DEVICE_HAND
     return result;
 }
 
+static IOTHUB_CLIENT_RESULT IoTHubTransportHttp_GetNextWorkDeadline(TRANSPORT_LL_HANDLE handle, uint64_t* msToNextWork)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    /*Codes_SRS_TRANSPORTMULTITHTTP_10_008: [ If handle or msToNextWork are NULL, IoTHubTransportHttp_GetNextWorkDeadline shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if (handle == NULL || msToNextWork == NULL)
+    {
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("Invalid argument (handle=%p, msToNextWork=%p)", handle, msToNextWork);
+    }
+    else
+    {
+        HTTPTRANSPORT_HANDLE_DATA* handleData = (HTTPTRANSPORT_HANDLE_DATA*)handle;
+        size_t deviceListSize = VECTOR_size(handleData->perDeviceList);
+        time_t timeNow = get_time(NULL);
+
+        *msToNextWork = IOTHUB_CLIENT_LL_NO_WORK_DEADLINE;
+        for (size_t i = 0; i < deviceListSize && *msToNextWork != 0; i++)
+        {
+            IOTHUB_DEVICE_HANDLE* listItem = (IOTHUB_DEVICE_HANDLE *)VECTOR_element(handleData->perDeviceList, i);
+            HTTPTRANSPORT_PERDEVICE_DATA* perDeviceItem = *(HTTPTRANSPORT_PERDEVICE_DATA**)(listItem);
+
+            /*Codes_SRS_TRANSPORTMULTITHTTP_10_009: [ If any device has events in waitingToSend, msToNextWork shall be set to 0. ]*/
+            if (!DList_IsListEmpty(perDeviceItem->waitingToSend))
+            {
+                *msToNextWork = 0;
+            }
+            /*Codes_SRS_TRANSPORTMULTITHTTP_10_010: [ For subscribed devices msToNextWork shall be no later than the moment the next GET is allowed by MinimumPollingTime. ]*/
+            /*Codes_SRS_TRANSPORTMULTITHTTP_10_041: [ While adaptive polling is on, msToNextWork shall be no later than the moment the polling wait of a subscribed device has passed. ]*/
+            else if (perDeviceItem->DoWork_PullMessage)
+            {
+                if (perDeviceItem->isFirstPoll || (timeNow == (time_t)(-1)) || (isAdaptivePollingOn(handleData) && (perDeviceItem->pollingInterval == 0)))
+                {
+                    *msToNextWork = 0;
+                }
+                else
+                {
+                    /*DoMessages polls once strictly more than getMinimumPollingTime seconds have passed, or once the adaptive polling wait has passed*/
+                    double secondsToPoll = isAdaptivePollingOn(handleData) ?
+                        (double)perDeviceItem->pollingInterval - get_difftime(timeNow, perDeviceItem->lastPollTime) :
+                        (double)handleData->getMinimumPollingTime + 1 - get_difftime(timeNow, perDeviceItem->lastPollTime);
+                    uint64_t msToPoll = (secondsToPoll <= 0) ? 0 : (uint64_t)(secondsToPoll * 1000);
+                    if (msToPoll < *msToNextWork)
+                    {
+                        *msToNextWork = msToPoll;
+                    }
+                }
+            }
+        }
+
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    return result;
+}
+
 static IOTHUB_CLIENT_RESULT IoTHubTransportHttp_SetOption(TRANSPORT_LL_HANDLE handle, const char* option, const void* value)
 {
     IOTHUB_CLIENT_RESULT result;
@@ -2412,6 +2485,75 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportHttp_SetOption(TRANSPORT_LL_HANDLE ha
             handleData->getMinimumPollingTime = *(unsigned int*)value;
             result = IOTHUB_CLIENT_OK;
         }
+        else if (strcmp(OPTION_HTTP_COMPRESSION_LEVEL, option) == 0)
+        {
+            int level = *(int*)value;
+            if (level == 0)
+            {
+                /*Codes_SRS_TRANSPORTMULTITHTTP_10_028: [ "http_compression_level" 0 shall destroy the compressor and the compressed payload so that batches are sent uncompressed. ]*/
+                destroy_compression(handleData);
+                result = IOTHUB_CLIENT_OK;
+            }
+            else if (level < 1 || level > 9)
+            {
+                /*Codes_SRS_TRANSPORTMULTITHTTP_10_029: [ If "http_compression_level" is not between 0 and 9, IoTHubTransportHttp_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+                LogError("invalid compression level %d, expected 0 (no compression) to 9", level);
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                /*Codes_SRS_TRANSPORTMULTITHTTP_10_030: [ Otherwise IoTHubTransportHttp_SetOption shall create a compressor with http_compression_create and replace the current one. ]*/
+                HTTP_COMPRESSION_HANDLE compression = http_compression_create(level);
+                if (compression == NULL)
+                {
+                    /*Codes_SRS_TRANSPORTMULTITHTTP_10_031: [ If http_compression_create fails, IoTHubTransportHttp_SetOption shall keep the current compressor and return IOTHUB_CLIENT_ERROR. ]*/
+                    LogError("unable to http_compression_create");
+                    result = IOTHUB_CLIENT_ERROR;
+                }
+                else
+                {
+                    http_compression_destroy(handleData->compression);
+                    handleData->compression = compression;
+                    result = IOTHUB_CLIENT_OK;
+                }
+            }
+        }
+        /*Codes_SRS_TRANSPORTMULTITHTTP_10_032: [ "http_compression_min_size" shall set the size, in bytes, below which batches are sent uncompressed. ]*/
+        else if (strcmp(OPTION_HTTP_COMPRESSION_MIN_SIZE, option) == 0)
+        {
+            handleData->compressionMinimumSize = *(size_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(OPTION_HTTP_ADAPTIVE_POLLING, option) == 0)
+        {
+            const IOTHUB_CLIENT_HTTP_ADAPTIVE_POLLING* adaptivePolling = (const IOTHUB_CLIENT_HTTP_ADAPTIVE_POLLING*)value;
+            if (
+                (adaptivePolling->maximumIntervalInSeconds != 0) &&
+                ((adaptivePolling->minimumIntervalInSeconds == 0) || (adaptivePolling->minimumIntervalInSeconds > adaptivePolling->maximumIntervalInSeconds))
+                )
+            {
+                /*Codes_SRS_TRANSPORTMULTITHTTP_10_035: [ If maximumIntervalInSeconds is not 0 and minimumIntervalInSeconds is 0 or greater than maximumIntervalInSeconds, IoTHubTransportHttp_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+                LogError("invalid adaptive polling intervals (minimum=%u, maximum=%u)", adaptivePolling->minimumIntervalInSeconds, adaptivePolling->maximumIntervalInSeconds);
+                result = IOTHUB_CLIENT_INVALID_ARG;
+            }
+            else
+            {
+                /*Codes_SRS_TRANSPORTMULTITHTTP_10_034: [ "http_adaptive_polling" with a maximumIntervalInSeconds of 0 shall turn adaptive polling off. ]*/
+                /*Codes_SRS_TRANSPORTMULTITHTTP_10_036: [ Otherwise "http_adaptive_polling" shall turn adaptive polling on with the given intervals and shorten the polling wait of every device to maximumIntervalInSeconds. ]*/
+                size_t deviceListSize = VECTOR_size(handleData->perDeviceList);
+                size_t i;
+                handleData->adaptivePolling = *adaptivePolling;
+                for (i = 0; i < deviceListSize; i++)
+                {
+                    HTTPTRANSPORT_PERDEVICE_DATA* perDeviceItem = *(HTTPTRANSPORT_PERDEVICE_DATA**)VECTOR_element(handleData->perDeviceList, i);
+                    if (perDeviceItem->pollingInterval > adaptivePolling->maximumIntervalInSeconds)
+                    {
+                        perDeviceItem->pollingInterval = adaptivePolling->maximumIntervalInSeconds;
+                    }
+                }
+                result = IOTHUB_CLIENT_OK;
+            }
+        }
         else
         {
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_126: [ "TrustedCerts"] */
@@ -2470,6 +2612,43 @@ static int IoTHubTransportHttp_SetRetryPolicy(TRANSPORT_LL_HANDLE handle, IOTHUB
     return result;
 }
 
+IOTHUB_CLIENT_RESULT IoTHubTransportHttp_GetPollingStatistics(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_HTTP_POLLING_STATISTICS* pollingStatistics)
+{
+    IOTHUB_CLIENT_RESULT result;
+    /*Codes_SRS_TRANSPORTMULTITHTTP_10_044: [ If handle or pollingStatistics is NULL, IoTHubTransportHttp_GetPollingStatistics shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+    if (handle == NULL || pollingStatistics == NULL)
+    {
+        LogError("invalid parameter handle=%p, pollingStatistics=%p", handle, pollingStatistics);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_10_042: [ IoTHubTransportHttp_GetPollingStatistics shall fill pollingStatistics with the sum of the counters of all the devices and the shortest polling wait among the subscribed devices. ]*/
+        HTTPTRANSPORT_HANDLE_DATA* handleData = (HTTPTRANSPORT_HANDLE_DATA*)handle;
+        size_t deviceListSize = VECTOR_size(handleData->perDeviceList);
+        size_t i;
+        bool isAnyDeviceSubscribed = false;
+        memset(pollingStatistics, 0, sizeof(*pollingStatistics));
+        for (i = 0; i < deviceListSize; i++)
+        {
+            HTTPTRANSPORT_PERDEVICE_DATA* perDeviceItem = *(HTTPTRANSPORT_PERDEVICE_DATA**)VECTOR_element(handleData->perDeviceList, i);
+            unsigned int currentInterval = isAdaptivePollingOn(handleData) ? perDeviceItem->pollingInterval : handleData->getMinimumPollingTime;
+            pollingStatistics->pollCount += perDeviceItem->pollingStatistics.pollCount;
+            pollingStatistics->emptyPollCount += perDeviceItem->pollingStatistics.emptyPollCount;
+            pollingStatistics->messagePollCount += perDeviceItem->pollingStatistics.messagePollCount;
+            pollingStatistics->failedPollCount += perDeviceItem->pollingStatistics.failedPollCount;
+            if (perDeviceItem->DoWork_PullMessage &&
+                (!isAnyDeviceSubscribed || (currentInterval < pollingStatistics->currentIntervalInSeconds)))
+            {
+                pollingStatistics->currentIntervalInSeconds = currentInterval;
+                isAnyDeviceSubscribed = true;
+            }
+        }
+        result = IOTHUB_CLIENT_OK;
+    }
+    return result;
+}
+
 /*Codes_SRS_TRANSPORTMULTITHTTP_17_125: [This function shall return a pointer to a structure of type TRANSPORT_PROVIDER having the following values for its fields:] */
 static TRANSPORT_PROVIDER thisTransportProvider =
 {
@@ -2490,7 +2669,8 @@ static TRANSPORT_PROVIDER thisTransportProvider =
     IoTHubTransportHttp_Unsubscribe,                /*pfIoTHubTransport_Unsubscribe IoTHubTransport_Unsubscribe;*/
     IoTHubTransportHttp_DoWork,                     /*pfIoTHubTransport_DoWork IoTHubTransport_DoWork;*/
     IoTHubTransportHttp_SetRetryPolicy,             /*pfIoTHubTransport_DoWork IoTHubTransport_SetRetryPolicy;*/
-    IoTHubTransportHttp_GetSendStatus               /*pfIoTHubTransport_GetSendStatus IoTHubTransport_GetSendStatus;*/
+    IoTHubTransportHttp_GetSendStatus,              /*pfIoTHubTransport_GetSendStatus IoTHubTransport_GetSendStatus;*/
+    IoTHubTransportHttp_GetNextWorkDeadline         /*pfIoTHubTransport_GetNextWorkDeadline IoTHubTransport_GetNextWorkDeadline;*/
 };
 
 const TRANSPORT_PROVIDER* HTTP_Protocol(void)
@@ -0,0 +1,1141 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/map.h"
+
+#include "message_store.h"
+#include "message_store_file.h"
+
+/*every record is a header followed by the serialized message (the payload):
+    uint32 magic, uint32 payload size, uint32 checksum of the sequence number and the payload, uint64 sequence number
+  all integers are little endian*/
+#define RECORD_MAGIC 0x52534849 /*"IHSR"*/
+#define RECORD_HEADER_SIZE 20
+#define RECORD_SEQUENCE_NUMBER_OFFSET 12
+#define MAX_RECORD_PAYLOAD_SIZE (64 * 1024 * 1024)
+
+/*the checkpoint file: uint32 magic, uint32 version, uint32 first segment, uint64 checkpoint, uint32 checksum of the previous fields*/
+#define CHECKPOINT_MAGIC 0x50434849 /*"IHCP"*/
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_SIZE 24
+#define CHECKPOINT_FILE_NAME "checkpoint"
+#define CHECKPOINT_TEMP_FILE_NAME "checkpoint.tmp"
+#define SEGMENT_FILE_NAME_FORMAT "%s/%08lx.seg"
+#define MAX_SEGMENT_FILE_NAME_SIZE 16 /*"/" + 8 hex digits + ".seg" + '\0', rounded up*/
+
+#define DEFAULT_MAX_SEGMENT_SIZE (1024 * 1024)
+
+#define PAYLOAD_CONTENT_BYTEARRAY 1
+#define PAYLOAD_CONTENT_STRING 2
+#define PAYLOAD_NULL_STRING 0xFFFFFFFF
+
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
+#define READ_RECORD_RESULT_VALUES \
+    READ_RECORD_OK,               \
+    READ_RECORD_END,              \
+    READ_RECORD_INVALID,          \
+    READ_RECORD_ERROR
+
+DEFINE_ENUM(READ_RECORD_RESULT, READ_RECORD_RESULT_VALUES);
+
+/*a record that was read and is not yet behind the checkpoint*/
+typedef struct DELIVERED_RECORD_TAG
+{
+    uint32_t segment;
+    size_t size;
+    bool acknowledged;
+} DELIVERED_RECORD;
+
+typedef struct MESSAGE_STORE_TAG
+{
+    size_t max_segment_size;
+    size_t max_store_size;
+
+    char* checkpoint_path;
+    char* checkpoint_temp_path;
+    char* directory;
+    char* segment_path; /*scratch buffer for get_segment_path*/
+
+    uint32_t first_segment; /*oldest segment still needed, as recorded in the checkpoint file*/
+    uint32_t write_segment;
+    MESSAGE_STORE_FILE_HANDLE write_file;
+    size_t write_segment_size;
+    bool is_write_segment_damaged; /*a record was only partially written, nothing else can be appended to this segment*/
+    bool has_unflushed_records;
+    unsigned char* write_buffer;
+    size_t write_buffer_size;
+
+    uint32_t read_segment;
+    MESSAGE_STORE_FILE_HANDLE read_file; /*opened on the first read*/
+    unsigned char* read_buffer;
+    size_t read_buffer_size;
+
+    uint64_t next_sequence_number; /*the sequence number of the next record appended*/
+    uint64_t read_sequence_number; /*the sequence number of the next record read*/
+    uint64_t checkpoint; /*every record before this one was acknowledged*/
+    uint64_t persisted_checkpoint;
+    size_t stored_bytes; /*size of the records not yet acknowledged*/
+
+    DELIVERED_RECORD* delivered; /*records from checkpoint to read_sequence_number - 1*/
+    size_t delivered_count;
+    size_t delivered_capacity;
+} MESSAGE_STORE;
+
+typedef struct PAYLOAD_READER_TAG
+{
+    const unsigned char* position;
+    size_t remaining;
+} PAYLOAD_READER;
+
+// ---------- Helper Functions ---------- //
+
+static unsigned char* put_uint32(unsigned char* position, uint32_t value)
+{
+    position[0] = (unsigned char)(value);
+    position[1] = (unsigned char)(value >> 8);
+    position[2] = (unsigned char)(value >> 16);
+    position[3] = (unsigned char)(value >> 24);
+    return position + 4;
+}
+
+static unsigned char* put_uint64(unsigned char* position, uint64_t value)
+{
+    (void)put_uint32(position, (uint32_t)value);
+    return put_uint32(position + 4, (uint32_t)(value >> 32));
+}
+
+static uint32_t get_uint32(const unsigned char* position)
+{
+    return (uint32_t)position[0] | ((uint32_t)position[1] << 8) | ((uint32_t)position[2] << 16) | ((uint32_t)position[3] << 24);
+}
+
+static uint64_t get_uint64(const unsigned char* position)
+{
+    return (uint64_t)get_uint32(position) | ((uint64_t)get_uint32(position + 4) << 32);
+}
+
+/*FNV-1a, enough to tell a torn or damaged record from a good one*/
+static uint32_t update_checksum(uint32_t checksum, const unsigned char* buffer, size_t size)
+{
+    size_t index;
+    for (index = 0; index < size; index++)
+    {
+        checksum = (checksum ^ buffer[index]) * FNV_PRIME;
+    }
+    return checksum;
+}
+
+static int ensure_buffer_size(unsigned char** buffer, size_t* buffer_size, size_t size)
+{
+    int result;
+
+    if (size <= *buffer_size)
+    {
+        result = 0;
+    }
+    else
+    {
+        unsigned char* new_buffer = (unsigned char*)realloc(*buffer, size);
+        if (new_buffer == NULL)
+        {
+            LogError("failed allocating %lu bytes", (unsigned long)size);
+            result = __FAILURE__;
+        }
+        else
+        {
+            *buffer = new_buffer;
+            *buffer_size = size;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static char* create_path(const char* directory, const char* file_name)
+{
+    size_t size = strlen(directory) + 1 + strlen(file_name) + 1;
+    char* result = (char*)malloc(size);
+    if (result == NULL)
+    {
+        LogError("failed allocating path for %s", file_name);
+    }
+    else
+    {
+        (void)snprintf(result, size, "%s/%s", directory, file_name);
+    }
+    return result;
+}
+
+static const char* get_segment_path(MESSAGE_STORE* message_store, uint32_t segment)
+{
+    (void)snprintf(message_store->segment_path, strlen(message_store->directory) + MAX_SEGMENT_FILE_NAME_SIZE, SEGMENT_FILE_NAME_FORMAT, message_store->directory, (unsigned long)segment);
+    return message_store->segment_path;
+}
+
+static size_t get_string_size(const char* value)
+{
+    return 4 + ((value == NULL) ? 0 : strlen(value) + 1);
+}
+
+/*strings keep their '\0', so they can be used straight from the payload when reading it back*/
+static unsigned char* put_string(unsigned char* position, const char* value)
+{
+    if (value == NULL)
+    {
+        position = put_uint32(position, PAYLOAD_NULL_STRING);
+    }
+    else
+    {
+        size_t size = strlen(value) + 1;
+        position = put_uint32(position, (uint32_t)size);
+        (void)memcpy(position, value, size);
+        position += size;
+    }
+    return position;
+}
+
+static int read_uint32(PAYLOAD_READER* reader, uint32_t* value)
+{
+    int result;
+
+    if (reader->remaining < 4)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        *value = get_uint32(reader->position);
+        reader->position += 4;
+        reader->remaining -= 4;
+        result = 0;
+    }
+
+    return result;
+}
+
+static int read_bytes(PAYLOAD_READER* reader, const unsigned char** bytes, uint32_t size)
+{
+    int result;
+
+    if (reader->remaining < size)
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        *bytes = reader->position;
+        reader->position += size;
+        reader->remaining -= size;
+        result = 0;
+    }
+
+    return result;
+}
+
+static int read_string(PAYLOAD_READER* reader, const char** value)
+{
+    int result;
+    uint32_t size;
+    const unsigned char* bytes;
+
+    if (read_uint32(reader, &size) != 0)
+    {
+        result = __FAILURE__;
+    }
+    else if (size == PAYLOAD_NULL_STRING)
+    {
+        *value = NULL;
+        result = 0;
+    }
+    else if (size == 0 || read_bytes(reader, &bytes, size) != 0 || bytes[size - 1] != '\0')
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        *value = (const char*)bytes;
+        result = 0;
+    }
+
+    return result;
+}
+
+/*serializes the message as a complete record in message_store->write_buffer*/
+static int serialize_message(MESSAGE_STORE* message_store, IOTHUB_MESSAGE_HANDLE message, size_t* record_size)
+{
+    int result;
+    IOTHUBMESSAGE_CONTENT_TYPE content_type = IoTHubMessage_GetContentType(message);
+    const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT* segments = NULL;
+    size_t segment_count = 0;
+    const char* string_body = NULL;
+    size_t body_size = 0;
+    MAP_HANDLE properties;
+    const char*const* keys;
+    const char*const* values;
+    size_t property_count;
+
+    if (content_type == IOTHUBMESSAGE_BYTEARRAY)
+    {
+        if (IoTHubMessage_GetByteArraySegments(message, &segments, &segment_count) != IOTHUB_MESSAGE_OK)
+        {
+            LogError("failed getting the message content");
+            content_type = IOTHUBMESSAGE_UNKNOWN;
+        }
+        else
+        {
+            size_t index;
+            for (index = 0; index < segment_count; index++)
+            {
+                body_size += segments[index].size;
+            }
+        }
+    }
+    else if (content_type == IOTHUBMESSAGE_STRING)
+    {
+        if ((string_body = IoTHubMessage_GetString(message)) == NULL)
+        {
+            LogError("failed getting the message content");
+            content_type = IOTHUBMESSAGE_UNKNOWN;
+        }
+        else
+        {
+            body_size = strlen(string_body) + 1;
+        }
+    }
+
+    if (content_type != IOTHUBMESSAGE_BYTEARRAY && content_type != IOTHUBMESSAGE_STRING)
+    {
+        LogError("cannot store a message without content");
+        result = __FAILURE__;
+    }
+    else if ((properties = IoTHubMessage_GetReadOnlyProperties(message)) == NULL)
+    {
+        LogError("failed getting the message properties");
+        result = __FAILURE__;
+    }
+    else if (Map_GetInternals(properties, &keys, &values, &property_count) != MAP_OK)
+    {
+        LogError("failed reading the message properties");
+        result = __FAILURE__;
+    }
+    else
+    {
+        const char* message_id = IoTHubMessage_GetMessageId(message);
+        const char* correlation_id = IoTHubMessage_GetCorrelationId(message);
+        const char* content_type_property = IoTHubMessage_GetContentTypeSystemProperty(message);
+        const char* content_encoding_property = IoTHubMessage_GetContentEncodingSystemProperty(message);
+        size_t payload_size = 1 + 4 + body_size +
+            get_string_size(message_id) + get_string_size(correlation_id) + get_string_size(content_type_property) + get_string_size(content_encoding_property) +
+            4;
+        size_t index;
+
+        for (index = 0; index < property_count; index++)
+        {
+            payload_size += get_string_size(keys[index]) + get_string_size(values[index]);
+        }
+
+        if (payload_size > MAX_RECORD_PAYLOAD_SIZE)
+        {
+            LogError("message is too large to be stored (%lu bytes)", (unsigned long)payload_size);
+            result = __FAILURE__;
+        }
+        else if (ensure_buffer_size(&message_store->write_buffer, &message_store->write_buffer_size, RECORD_HEADER_SIZE + payload_size) != 0)
+        {
+            LogError("failed allocating the record buffer");
+            result = __FAILURE__;
+        }
+        else
+        {
+            unsigned char* position = message_store->write_buffer + RECORD_HEADER_SIZE;
+
+            *position++ = (content_type == IOTHUBMESSAGE_BYTEARRAY) ? PAYLOAD_CONTENT_BYTEARRAY : PAYLOAD_CONTENT_STRING;
+            position = put_uint32(position, (uint32_t)body_size);
+            if (string_body != NULL)
+            {
+                (void)memcpy(position, string_body, body_size);
+                position += body_size;
+            }
+            else
+            {
+                for (index = 0; index < segment_count; index++)
+                {
+                    if (segments[index].size > 0)
+                    {
+                        (void)memcpy(position, segments[index].buffer, segments[index].size);
+                        position += segments[index].size;
+                    }
+                }
+            }
+            position = put_string(position, message_id);
+            position = put_string(position, correlation_id);
+            position = put_string(position, content_type_property);
+            position = put_string(position, content_encoding_property);
+            position = put_uint32(position, (uint32_t)property_count);
+            for (index = 0; index < property_count; index++)
+            {
+                position = put_string(position, keys[index]);
+                position = put_string(position, values[index]);
+            }
+
+            position = put_uint32(message_store->write_buffer, RECORD_MAGIC);
+            position = put_uint32(position, (uint32_t)payload_size);
+            (void)put_uint64(position + 4, message_store->next_sequence_number);
+            (void)put_uint32(position,
+                update_checksum(update_checksum(FNV_OFFSET_BASIS, message_store->write_buffer + RECORD_SEQUENCE_NUMBER_OFFSET, 8), message_store->write_buffer + RECORD_HEADER_SIZE, payload_size));
+
+            *record_size = RECORD_HEADER_SIZE + payload_size;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+static IOTHUB_MESSAGE_HANDLE deserialize_message(const unsigned char* payload, size_t payload_size)
+{
+    IOTHUB_MESSAGE_HANDLE result;
+    PAYLOAD_READER reader;
+    const unsigned char* content_type;
+    uint32_t body_size;
+    const unsigned char* body;
+
+    reader.position = payload;
+    reader.remaining = payload_size;
+
+    if (read_bytes(&reader, &content_type, 1) != 0 ||
+        read_uint32(&reader, &body_size) != 0 ||
+        read_bytes(&reader, &body, body_size) != 0)
+    {
+        LogError("stored message content is not valid");
+        result = NULL;
+    }
+    else if (*content_type == PAYLOAD_CONTENT_BYTEARRAY)
+    {
+        result = IoTHubMessage_CreateFromByteArray(body, body_size);
+    }
+    else if (*content_type == PAYLOAD_CONTENT_STRING && body_size > 0 && body[body_size - 1] == '\0')
+    {
+        result = IoTHubMessage_CreateFromString((const char*)body);
+    }
+    else
+    {
+        LogError("stored message content type is not valid");
+        result = NULL;
+    }
+
+    if (result != NULL)
+    {
+        const char* message_id;
+        const char* correlation_id;
+        const char* content_type_property;
+        const char* content_encoding_property;
+        uint32_t property_count;
+        MAP_HANDLE properties;
+
+        if (read_string(&reader, &message_id) != 0 ||
+            read_string(&reader, &correlation_id) != 0 ||
+            read_string(&reader, &content_type_property) != 0 ||
+            read_string(&reader, &content_encoding_property) != 0 ||
+            read_uint32(&reader, &property_count) != 0)
+        {
+            LogError("stored message system properties are not valid");
+            IoTHubMessage_Destroy(result);
+            result = NULL;
+        }
+        else if ((message_id != NULL && IoTHubMessage_SetMessageId(result, message_id) != IOTHUB_MESSAGE_OK) ||
+            (correlation_id != NULL && IoTHubMessage_SetCorrelationId(result, correlation_id) != IOTHUB_MESSAGE_OK) ||
+            (content_type_property != NULL && IoTHubMessage_SetContentTypeSystemProperty(result, content_type_property) != IOTHUB_MESSAGE_OK) ||
+            (content_encoding_property != NULL && IoTHubMessage_SetContentEncodingSystemProperty(result, content_encoding_property) != IOTHUB_MESSAGE_OK))
+        {
+            LogError("failed setting the message system properties");
+            IoTHubMessage_Destroy(result);
+            result = NULL;
+        }
+        else if ((properties = IoTHubMessage_Properties(result)) == NULL)
+        {
+            LogError("failed getting the message properties");
+            IoTHubMessage_Destroy(result);
+            result = NULL;
+        }
+        else
+        {
+            uint32_t index;
+            for (index = 0; index < property_count; index++)
+            {
+                const char* key;
+                const char* value;
+                if (read_string(&reader, &key) != 0 || key == NULL ||
+                    read_string(&reader, &value) != 0 || value == NULL ||
+                    Map_AddOrUpdate(properties, key, value) != MAP_OK)
+                {
+                    LogError("failed restoring the message properties");
+                    break;
+                }
+            }
+
+            if (index < property_count || reader.remaining != 0)
+            {
+                IoTHubMessage_Destroy(result);
+                result = NULL;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*reads one record into message_store->read_buffer*/
+static READ_RECORD_RESULT read_record(MESSAGE_STORE* message_store, MESSAGE_STORE_FILE_HANDLE file, uint64_t* sequence_number, size_t* payload_size)
+{
+    READ_RECORD_RESULT result;
+    unsigned char header[RECORD_HEADER_SIZE];
+    size_t bytes_read = message_store_file_read(file, header, RECORD_HEADER_SIZE);
+
+    if (bytes_read == 0)
+    {
+        result = READ_RECORD_END;
+    }
+    else if (bytes_read != RECORD_HEADER_SIZE ||
+        get_uint32(header) != RECORD_MAGIC ||
+        (*payload_size = get_uint32(header + 4)) > MAX_RECORD_PAYLOAD_SIZE)
+    {
+        result = READ_RECORD_INVALID;
+    }
+    else if (ensure_buffer_size(&message_store->read_buffer, &message_store->read_buffer_size, *payload_size) != 0)
+    {
+        result = READ_RECORD_ERROR;
+    }
+    else if (message_store_file_read(file, message_store->read_buffer, *payload_size) != *payload_size ||
+        update_checksum(update_checksum(FNV_OFFSET_BASIS, header + RECORD_SEQUENCE_NUMBER_OFFSET, 8), message_store->read_buffer, *payload_size) != get_uint32(header + 8))
+    {
+        result = READ_RECORD_INVALID;
+    }
+    else
+    {
+        *sequence_number = get_uint64(header + RECORD_SEQUENCE_NUMBER_OFFSET);
+        result = READ_RECORD_OK;
+    }
+
+    return result;
+}
+
+static int read_checkpoint(MESSAGE_STORE* message_store)
+{
+    int result;
+    MESSAGE_STORE_FILE_HANDLE file;
+
+    if ((file = message_store_file_open(message_store->checkpoint_path, MESSAGE_STORE_FILE_READ)) == NULL)
+    {
+        // Codes_SRS_MESSAGE_STORE_10_002: [If the directory has no checkpoint file, the store shall start empty]
+        message_store->first_segment = 0;
+        message_store->checkpoint = 0;
+        result = 0;
+    }
+    else
+    {
+        unsigned char buffer[CHECKPOINT_SIZE];
+
+        // Codes_SRS_MESSAGE_STORE_10_003: [If the checkpoint file cannot be read or is not valid, message_store_create shall fail and return NULL]
+        if (message_store_file_read(file, buffer, CHECKPOINT_SIZE) != CHECKPOINT_SIZE ||
+            get_uint32(buffer) != CHECKPOINT_MAGIC ||
+            get_uint32(buffer + 4) != CHECKPOINT_VERSION ||
+            get_uint32(buffer + 20) != update_checksum(FNV_OFFSET_BASIS, buffer, 20))
+        {
+            LogError("checkpoint file %s is not valid", message_store->checkpoint_path);
+            result = __FAILURE__;
+        }
+        else
+        {
+            message_store->first_segment = get_uint32(buffer + 8);
+            message_store->checkpoint = get_uint64(buffer + 12);
+            result = 0;
+        }
+
+        message_store_file_close(file);
+    }
+
+    return result;
+}
+
+static int write_checkpoint(MESSAGE_STORE* message_store, uint32_t first_segment)
+{
+    int result;
+    unsigned char buffer[CHECKPOINT_SIZE];
+    MESSAGE_STORE_FILE_HANDLE file;
+
+    (void)put_uint32(buffer, CHECKPOINT_MAGIC);
+    (void)put_uint32(buffer + 4, CHECKPOINT_VERSION);
+    (void)put_uint32(buffer + 8, first_segment);
+    (void)put_uint64(buffer + 12, message_store->checkpoint);
+    (void)put_uint32(buffer + 20, update_checksum(FNV_OFFSET_BASIS, buffer, 20));
+
+    // Codes_SRS_MESSAGE_STORE_10_028: [If the checkpoint moved since it was last written, it shall be written to a temporary file that then replaces the checkpoint file]
+    if ((file = message_store_file_open(message_store->checkpoint_temp_path, MESSAGE_STORE_FILE_WRITE)) == NULL)
+    {
+        LogError("failed creating %s", message_store->checkpoint_temp_path);
+        result = __FAILURE__;
+    }
+    else
+    {
+        int write_result = message_store_file_write(file, buffer, CHECKPOINT_SIZE);
+        if (write_result == 0)
+        {
+            write_result = message_store_file_flush(file);
+        }
+        message_store_file_close(file);
+
+        if (write_result != 0)
+        {
+            LogError("failed writing %s", message_store->checkpoint_temp_path);
+            result = __FAILURE__;
+        }
+        else if (message_store_file_replace(message_store->checkpoint_temp_path, message_store->checkpoint_path) != 0)
+        {
+            LogError("failed replacing %s", message_store->checkpoint_path);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+/*finds the records that were not acknowledged and where to append new ones*/
+static int recover_segments(MESSAGE_STORE* message_store)
+{
+    int result = 0;
+    uint32_t segment = message_store->first_segment;
+    bool has_segments = false;
+    bool can_append_to_last_segment = false;
+    size_t last_segment_size = 0;
+
+    message_store->next_sequence_number = message_store->checkpoint;
+    message_store->stored_bytes = 0;
+
+    // Codes_SRS_MESSAGE_STORE_10_004: [message_store_create shall read every segment starting at the first segment named in the checkpoint, counting the records at or after the checkpoint, and shall stop reading a segment at the first record that is incomplete or fails its checksum]
+    while (result == 0)
+    {
+        MESSAGE_STORE_FILE_HANDLE file = message_store_file_open(get_segment_path(message_store, segment), MESSAGE_STORE_FILE_READ);
+        if (file == NULL)
+        {
+            break;
+        }
+        else
+        {
+            READ_RECORD_RESULT read_result;
+            uint64_t sequence_number;
+            size_t payload_size;
+
+            has_segments = true;
+            last_segment_size = 0;
+            while ((read_result = read_record(message_store, file, &sequence_number, &payload_size)) == READ_RECORD_OK)
+            {
+                last_segment_size += RECORD_HEADER_SIZE + payload_size;
+                if (sequence_number >= message_store->checkpoint)
+                {
+                    message_store->stored_bytes += RECORD_HEADER_SIZE + payload_size;
+                }
+                if (sequence_number >= message_store->next_sequence_number)
+                {
+                    message_store->next_sequence_number = sequence_number + 1;
+                }
+            }
+            message_store_file_close(file);
+
+            if (read_result == READ_RECORD_ERROR)
+            {
+                result = __FAILURE__;
+            }
+            else
+            {
+                can_append_to_last_segment = (read_result == READ_RECORD_END);
+                segment++;
+            }
+        }
+    }
+
+    if (result == 0)
+    {
+        // Codes_SRS_MESSAGE_STORE_10_005: [New records shall be appended to the last segment, unless it ends with an invalid record or is full, in which case a new segment shall be started]
+        if (!has_segments)
+        {
+            message_store->write_segment = message_store->first_segment;
+            message_store->write_segment_size = 0;
+        }
+        else if (can_append_to_last_segment && last_segment_size < message_store->max_segment_size)
+        {
+            message_store->write_segment = segment - 1;
+            message_store->write_segment_size = last_segment_size;
+        }
+        else
+        {
+            message_store->write_segment = segment;
+            message_store->write_segment_size = 0;
+        }
+
+        if ((message_store->write_file = message_store_file_open(get_segment_path(message_store, message_store->write_segment), MESSAGE_STORE_FILE_APPEND)) == NULL)
+        {
+            LogError("failed opening segment %s", message_store->segment_path);
+            result = __FAILURE__;
+        }
+        else
+        {
+            message_store->read_segment = message_store->first_segment;
+            message_store->read_sequence_number = message_store->checkpoint;
+            message_store->persisted_checkpoint = message_store->checkpoint;
+        }
+    }
+
+    return result;
+}
+
+static int start_new_write_segment(MESSAGE_STORE* message_store)
+{
+    int result;
+    MESSAGE_STORE_FILE_HANDLE new_file = message_store_file_open(get_segment_path(message_store, message_store->write_segment + 1), MESSAGE_STORE_FILE_APPEND);
+
+    if (new_file == NULL)
+    {
+        LogError("failed creating segment %s", message_store->segment_path);
+        result = __FAILURE__;
+    }
+    else
+    {
+        if (message_store->has_unflushed_records && message_store_file_flush(message_store->write_file) != 0)
+        {
+            LogError("failed flushing segment %lu", (unsigned long)message_store->write_segment);
+        }
+        message_store_file_close(message_store->write_file);
+
+        message_store->write_file = new_file;
+        message_store->write_segment++;
+        message_store->write_segment_size = 0;
+        message_store->is_write_segment_damaged = false;
+        message_store->has_unflushed_records = false;
+        result = 0;
+    }
+
+    return result;
+}
+
+static int ensure_delivered_capacity(MESSAGE_STORE* message_store, size_t count)
+{
+    int result;
+
+    if (count <= message_store->delivered_capacity)
+    {
+        result = 0;
+    }
+    else
+    {
+        size_t new_capacity = (message_store->delivered_capacity == 0) ? 16 : message_store->delivered_capacity * 2;
+        DELIVERED_RECORD* new_delivered;
+
+        if (new_capacity < count)
+        {
+            new_capacity = count;
+        }
+
+        if ((new_delivered = (DELIVERED_RECORD*)realloc(message_store->delivered, new_capacity * sizeof(DELIVERED_RECORD))) == NULL)
+        {
+            LogError("failed allocating the list of delivered records");
+            result = __FAILURE__;
+        }
+        else
+        {
+            message_store->delivered = new_delivered;
+            message_store->delivered_capacity = new_capacity;
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+/*the capacity shall have been ensured before*/
+static void add_delivered_record(MESSAGE_STORE* message_store, size_t size, bool acknowledged)
+{
+    DELIVERED_RECORD* record = &message_store->delivered[message_store->delivered_count++];
+    record->segment = message_store->read_segment;
+    record->size = size;
+    record->acknowledged = acknowledged;
+    message_store->read_sequence_number++;
+}
+
+// Codes_SRS_MESSAGE_STORE_10_025: [The checkpoint shall move past a record once it and all the records before it are acknowledged]
+static void advance_checkpoint(MESSAGE_STORE* message_store)
+{
+    size_t count = 0;
+
+    while (count < message_store->delivered_count && message_store->delivered[count].acknowledged)
+    {
+        message_store->stored_bytes -= message_store->delivered[count].size;
+        count++;
+    }
+
+    if (count > 0)
+    {
+        message_store->delivered_count -= count;
+        (void)memmove(message_store->delivered, message_store->delivered + count, message_store->delivered_count * sizeof(DELIVERED_RECORD));
+        message_store->checkpoint += count;
+    }
+}
+
+static void close_files(MESSAGE_STORE* message_store)
+{
+    if (message_store->read_file != NULL)
+    {
+        message_store_file_close(message_store->read_file);
+    }
+
+    if (message_store->write_file != NULL)
+    {
+        message_store_file_close(message_store->write_file);
+    }
+}
+
+static void free_message_store(MESSAGE_STORE* message_store)
+{
+    free(message_store->checkpoint_path);
+    free(message_store->checkpoint_temp_path);
+    free(message_store->directory);
+    free(message_store->segment_path);
+    free(message_store->write_buffer);
+    free(message_store->read_buffer);
+    free(message_store->delivered);
+    free(message_store);
+}
+
+// ---------- API functions ---------- //
+
+MESSAGE_STORE_HANDLE message_store_create(const MESSAGE_STORE_CONFIG* config)
+{
+    MESSAGE_STORE* result;
+
+    // Codes_SRS_MESSAGE_STORE_10_001: [If `config` or `config->directory` are NULL, message_store_create shall fail and return NULL]
+    if (config == NULL || config->directory == NULL)
+    {
+        LogError("invalid argument (config=%p)", config);
+        result = NULL;
+    }
+    else if ((result = (MESSAGE_STORE*)malloc(sizeof(MESSAGE_STORE))) == NULL)
+    {
+        // Codes_SRS_MESSAGE_STORE_10_006: [If any failure occurs, message_store_create shall fail and return NULL]
+        LogError("failed allocating MESSAGE_STORE");
+    }
+    else
+    {
+        size_t directory_length = strlen(config->directory);
+
+        (void)memset(result, 0, sizeof(MESSAGE_STORE));
+        result->max_segment_size = (config->max_segment_size == 0) ? DEFAULT_MAX_SEGMENT_SIZE : config->max_segment_size;
+        result->max_store_size = config->max_store_size;
+
+        if ((result->directory = (char*)malloc(directory_length + 1)) == NULL ||
+            (result->segment_path = (char*)malloc(directory_length + MAX_SEGMENT_FILE_NAME_SIZE)) == NULL ||
+            (result->checkpoint_path = create_path(config->directory, CHECKPOINT_FILE_NAME)) == NULL ||
+            (result->checkpoint_temp_path = create_path(config->directory, CHECKPOINT_TEMP_FILE_NAME)) == NULL)
+        {
+            LogError("failed allocating the store paths");
+            free_message_store(result);
+            result = NULL;
+        }
+        else
+        {
+            (void)memcpy(result->directory, config->directory, directory_length + 1);
+
+            if (read_checkpoint(result) != 0 || recover_segments(result) != 0)
+            {
+                LogError("failed opening the message store in %s", config->directory);
+                close_files(result);
+                free_message_store(result);
+                result = NULL;
+            }
+        }
+    }
+
+    return result;
+}
+
+void message_store_destroy(MESSAGE_STORE_HANDLE message_store)
+{
+    // Codes_SRS_MESSAGE_STORE_10_007: [If `message_store` is NULL, message_store_destroy shall return]
+    if (message_store == NULL)
+    {
+        LogError("invalid argument (message_store=NULL)");
+    }
+    else
+    {
+        // Codes_SRS_MESSAGE_STORE_10_008: [message_store_destroy shall flush the store, close its files and release all the memory it allocated, keeping the files]
+        if (message_store_flush(message_store) != 0)
+        {
+            LogError("failed flushing the message store");
+        }
+        close_files(message_store);
+        free_message_store(message_store);
+    }
+}
+
+MESSAGE_STORE_RESULT message_store_append(MESSAGE_STORE_HANDLE message_store, IOTHUB_MESSAGE_HANDLE message, uint64_t* sequence_number)
+{
+    MESSAGE_STORE_RESULT result;
+    size_t record_size;
+
+    // Codes_SRS_MESSAGE_STORE_10_009: [If `message_store`, `message` or `sequence_number` are NULL, message_store_append shall return MESSAGE_STORE_ERROR]
+    if (message_store == NULL || message == NULL || sequence_number == NULL)
+    {
+        LogError("invalid argument (message_store=%p, message=%p, sequence_number=%p)", message_store, message, sequence_number);
+        result = MESSAGE_STORE_ERROR;
+    }
+    // Codes_SRS_MESSAGE_STORE_10_010: [message_store_append shall serialize the content, message id, correlation id, content type, content encoding and properties of `message` in a single record, and return MESSAGE_STORE_ERROR if that fails]
+    else if (serialize_message(message_store, message, &record_size) != 0)
+    {
+        result = MESSAGE_STORE_ERROR;
+    }
+    // Codes_SRS_MESSAGE_STORE_10_011: [If `max_store_size` is not zero and the records not yet acknowledged plus the new record would be larger than it, message_store_append shall return MESSAGE_STORE_FULL]
+    else if (message_store->max_store_size != 0 && message_store->stored_bytes + record_size > message_store->max_store_size)
+    {
+        LogError("message store is full (%lu bytes)", (unsigned long)message_store->stored_bytes);
+        result = MESSAGE_STORE_FULL;
+    }
+    // Codes_SRS_MESSAGE_STORE_10_012: [If the record would make a segment that is not empty larger than `max_segment_size`, or the last write to the segment failed, a new segment shall be started]
+    else if ((message_store->is_write_segment_damaged ||
+        (message_store->write_segment_size != 0 && message_store->write_segment_size + record_size > message_store->max_segment_size)) &&
+        start_new_write_segment(message_store) != 0)
+    {
+        result = MESSAGE_STORE_ERROR;
+    }
+    // Codes_SRS_MESSAGE_STORE_10_013: [The record shall be appended to the segment with a single write, and if that fails message_store_append shall return MESSAGE_STORE_ERROR]
+    else if (message_store_file_write(message_store->write_file, message_store->write_buffer, record_size) != 0)
+    {
+        LogError("failed appending the message to segment %lu", (unsigned long)message_store->write_segment);
+        message_store->is_write_segment_damaged = true;
+        result = MESSAGE_STORE_ERROR;
+    }
+    else
+    {
+        // Codes_SRS_MESSAGE_STORE_10_014: [On success `sequence_number` shall be set to the sequence number of the record, which is one more than the one of the previous record, and message_store_append shall return MESSAGE_STORE_OK]
+        *sequence_number = message_store->next_sequence_number++;
+        message_store->stored_bytes += record_size;
+        message_store->write_segment_size += record_size;
+        message_store->has_unflushed_records = true;
+        result = MESSAGE_STORE_OK;
+    }
+
+    return result;
+}
+
+MESSAGE_STORE_RESULT message_store_read_next(MESSAGE_STORE_HANDLE message_store, IOTHUB_MESSAGE_HANDLE* message, uint64_t* sequence_number)
+{
+    MESSAGE_STORE_RESULT result;
+
+    // Codes_SRS_MESSAGE_STORE_10_015: [If `message_store`, `message` or `sequence_number` are NULL, message_store_read_next shall return MESSAGE_STORE_ERROR]
+    if (message_store == NULL || message == NULL || sequence_number == NULL)
+    {
+        LogError("invalid argument (message_store=%p, message=%p, sequence_number=%p)", message_store, message, sequence_number);
+        result = MESSAGE_STORE_ERROR;
+    }
+    else
+    {
+        result = MESSAGE_STORE_EMPTY;
+
+        // Codes_SRS_MESSAGE_STORE_10_016: [If every record appended was already read, message_store_read_next shall return MESSAGE_STORE_EMPTY]
+        while (result == MESSAGE_STORE_EMPTY && message_store->read_sequence_number < message_store->next_sequence_number)
+        {
+            uint64_t record_sequence_number;
+            size_t payload_size;
+            READ_RECORD_RESULT read_result;
+
+            // Codes_SRS_MESSAGE_STORE_10_017: [Before reading from the segment records are being appended to, the records appended shall be flushed]
+            if (message_store->read_segment == message_store->write_segment &&
+                message_store->has_unflushed_records &&
+                message_store_flush(message_store) != 0)
+            {
+                read_result = READ_RECORD_ERROR;
+            }
+            else if (message_store->read_file == NULL &&
+                (message_store->read_file = message_store_file_open(get_segment_path(message_store, message_store->read_segment), MESSAGE_STORE_FILE_READ)) == NULL)
+            {
+                read_result = READ_RECORD_END;
+            }
+            else
+            {
+                read_result = read_record(message_store, message_store->read_file, &record_sequence_number, &payload_size);
+            }
+
+            if (read_result == READ_RECORD_END || read_result == READ_RECORD_INVALID)
+            {
+                // Codes_SRS_MESSAGE_STORE_10_018: [Records shall be read in the order they were appended; at the end of a segment, or at a record that is incomplete or fails its checksum, reading shall continue with the next segment]
+                if (message_store->read_segment < message_store->write_segment)
+                {
+                    if (message_store->read_file != NULL)
+                    {
+                        message_store_file_close(message_store->read_file);
+                        message_store->read_file = NULL;
+                    }
+                    message_store->read_segment++;
+                }
+                else
+                {
+                    LogError("segment %lu ends before the last record appended", (unsigned long)message_store->read_segment);
+                    result = MESSAGE_STORE_ERROR;
+                }
+            }
+            else if (read_result != READ_RECORD_OK)
+            {
+                result = MESSAGE_STORE_ERROR;
+            }
+            // Codes_SRS_MESSAGE_STORE_10_019: [Records before the checkpoint shall be skipped]
+            else if (record_sequence_number < message_store->read_sequence_number)
+            {
+                continue;
+            }
+            else if (ensure_delivered_capacity(message_store, message_store->delivered_count + (size_t)(record_sequence_number - message_store->read_sequence_number) + 1) != 0)
+            {
+                result = MESSAGE_STORE_ERROR;
+            }
+            else
+            {
+                /*records lost to a damaged segment are not coming back*/
+                while (message_store->read_sequence_number < record_sequence_number)
+                {
+                    LogError("stored message %lu is missing", (unsigned long)message_store->read_sequence_number);
+                    add_delivered_record(message_store, 0, true);
+                }
+
+                if ((*message = deserialize_message(message_store->read_buffer, payload_size)) == NULL)
+                {
+                    // Codes_SRS_MESSAGE_STORE_10_020: [A record that cannot be turned back into a message shall be dropped as if it was acknowledged]
+                    LogError("dropping stored message %lu", (unsigned long)record_sequence_number);
+                    add_delivered_record(message_store, RECORD_HEADER_SIZE + payload_size, true);
+                }
+                else
+                {
+                    // Codes_SRS_MESSAGE_STORE_10_021: [Otherwise message_store_read_next shall set `message` to a new message and `sequence_number` to its sequence number, and return MESSAGE_STORE_OK]
+                    *sequence_number = record_sequence_number;
+                    add_delivered_record(message_store, RECORD_HEADER_SIZE + payload_size, false);
+                    result = MESSAGE_STORE_OK;
+                }
+
+                advance_checkpoint(message_store);
+            }
+        }
+    }
+
+    return result;
+}
+
+int message_store_is_empty(MESSAGE_STORE_HANDLE message_store, bool* is_empty)
+{
+    int result;
+
+    // Codes_SRS_MESSAGE_STORE_10_022: [If `message_store` or `is_empty` are NULL, message_store_is_empty shall fail and return non-zero]
+    if (message_store == NULL || is_empty == NULL)
+    {
+        LogError("invalid argument (message_store=%p, is_empty=%p)", message_store, is_empty);
+        result = __FAILURE__;
+    }
+    else
+    {
+        // Codes_SRS_MESSAGE_STORE_10_023: [`is_empty` shall be set to true if every record appended was already read, false otherwise]
+        *is_empty = (message_store->read_sequence_number >= message_store->next_sequence_number);
+        result = 0;
+    }
+
+    return result;
+}
+
+int message_store_acknowledge(MESSAGE_STORE_HANDLE message_store, uint64_t sequence_number)
+{
+    int result;
+
+    // Codes_SRS_MESSAGE_STORE_10_024: [If `message_store` is NULL, or `sequence_number` was not read or was already acknowledged, message_store_acknowledge shall fail and return non-zero]
+    if (message_store == NULL)
+    {
+        LogError("invalid argument (message_store=NULL)");
+        result = __FAILURE__;
+    }
+    else if (sequence_number < message_store->checkpoint ||
+        sequence_number >= message_store->read_sequence_number ||
+        message_store->delivered[sequence_number - message_store->checkpoint].acknowledged)
+    {
+        LogError("stored message %lu is not waiting for an acknowledgement", (unsigned long)sequence_number);
+        result = __FAILURE__;
+    }
+    else
+    {
+        message_store->delivered[sequence_number - message_store->checkpoint].acknowledged = true;
+        advance_checkpoint(message_store);
+        result = 0;
+    }
+
+    return result;
+}
+
+int message_store_flush(MESSAGE_STORE_HANDLE message_store)
+{
+    int result;
+
+    // Codes_SRS_MESSAGE_STORE_10_026: [If `message_store` is NULL, message_store_flush shall fail and return non-zero]
+    if (message_store == NULL)
+    {
+        LogError("invalid argument (message_store=NULL)");
+        result = __FAILURE__;
+    }
+    // Codes_SRS_MESSAGE_STORE_10_027: [The records appended since the last flush shall be committed to the disk]
+    else if (message_store->has_unflushed_records && message_store_file_flush(message_store->write_file) != 0)
+    {
+        LogError("failed flushing segment %lu", (unsigned long)message_store->write_segment);
+        result = __FAILURE__;
+    }
+    else
+    {
+        message_store->has_unflushed_records = false;
+
+        if (message_store->checkpoint == message_store->persisted_checkpoint)
+        {
+            result = 0;
+        }
+        else
+        {
+            uint32_t oldest_segment = (message_store->delivered_count > 0) ? message_store->delivered[0].segment : message_store->read_segment;
+
+            if (write_checkpoint(message_store, oldest_segment) != 0)
+            {
+                result = __FAILURE__;
+            }
+            else
+            {
+                message_store->persisted_checkpoint = message_store->checkpoint;
+
+                // Codes_SRS_MESSAGE_STORE_10_029: [Once the checkpoint is written, the segments before the one holding the oldest record not acknowledged shall be deleted]
+                while (message_store->first_segment < oldest_segment)
+                {
+                    if (message_store_file_remove(get_segment_path(message_store, message_store->first_segment)) != 0)
+                    {
+                        LogError("failed deleting segment %s", message_store->segment_path);
+                    }
+                    message_store->first_segment++;
+                }
+
+                result = 0;
+            }
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,200 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(_POSIX_C_SOURCE)
+/*fileno and fsync*/
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/xlogging.h"
+
+#include "message_store_file.h"
+
+#if defined(_WIN32)
+#include <io.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+/*segments are written and replayed sequentially, a large buffer turns many small records into few system calls*/
+#define MESSAGE_STORE_FILE_BUFFER_SIZE (64 * 1024)
+
+typedef struct MESSAGE_STORE_FILE_TAG
+{
+    FILE* file;
+} MESSAGE_STORE_FILE;
+
+MESSAGE_STORE_FILE_HANDLE message_store_file_open(const char* path, MESSAGE_STORE_FILE_MODE mode)
+{
+    MESSAGE_STORE_FILE* result;
+
+    if (path == NULL)
+    {
+        LogError("invalid argument (path=NULL)");
+        result = NULL;
+    }
+    else if ((result = (MESSAGE_STORE_FILE*)malloc(sizeof(MESSAGE_STORE_FILE))) == NULL)
+    {
+        LogError("failed allocating MESSAGE_STORE_FILE");
+    }
+    else
+    {
+        const char* fopen_mode = (mode == MESSAGE_STORE_FILE_READ) ? "rb" : (mode == MESSAGE_STORE_FILE_APPEND) ? "ab" : "wb";
+
+        if ((result->file = fopen(path, fopen_mode)) == NULL)
+        {
+            /*not an error for MESSAGE_STORE_FILE_READ, this is how a missing file is detected*/
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            (void)setvbuf(result->file, NULL, _IOFBF, MESSAGE_STORE_FILE_BUFFER_SIZE);
+        }
+    }
+
+    return result;
+}
+
+void message_store_file_close(MESSAGE_STORE_FILE_HANDLE file)
+{
+    if (file != NULL)
+    {
+        if (fclose(file->file) != 0)
+        {
+            LogError("fclose failed");
+        }
+        free(file);
+    }
+}
+
+int message_store_file_write(MESSAGE_STORE_FILE_HANDLE file, const unsigned char* buffer, size_t size)
+{
+    int result;
+
+    if (file == NULL || buffer == NULL)
+    {
+        LogError("invalid argument (file=%p, buffer=%p)", file, buffer);
+        result = __FAILURE__;
+    }
+    else if (fwrite(buffer, 1, size, file->file) != size)
+    {
+        LogError("fwrite failed");
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+size_t message_store_file_read(MESSAGE_STORE_FILE_HANDLE file, unsigned char* buffer, size_t size)
+{
+    size_t result;
+
+    if (file == NULL || buffer == NULL)
+    {
+        LogError("invalid argument (file=%p, buffer=%p)", file, buffer);
+        result = 0;
+    }
+    else
+    {
+        /*the file may have grown since the end of it was last reached*/
+        clearerr(file->file);
+        result = fread(buffer, 1, size, file->file);
+    }
+
+    return result;
+}
+
+int message_store_file_flush(MESSAGE_STORE_FILE_HANDLE file)
+{
+    int result;
+
+    if (file == NULL)
+    {
+        LogError("invalid argument (file=NULL)");
+        result = __FAILURE__;
+    }
+    else if (fflush(file->file) != 0)
+    {
+        LogError("fflush failed");
+        result = __FAILURE__;
+    }
+#if defined(_WIN32)
+    else if (_commit(_fileno(file->file)) != 0)
+    {
+        LogError("_commit failed");
+        result = __FAILURE__;
+    }
+#elif defined(__unix__) || defined(__APPLE__)
+    else if (fsync(fileno(file->file)) != 0)
+    {
+        LogError("fsync failed");
+        result = __FAILURE__;
+    }
+#endif
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+int message_store_file_remove(const char* path)
+{
+    int result;
+
+    if (path == NULL)
+    {
+        LogError("invalid argument (path=NULL)");
+        result = __FAILURE__;
+    }
+    else if (remove(path) != 0)
+    {
+        LogError("failed removing %s", path);
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+int message_store_file_replace(const char* source, const char* destination)
+{
+    int result;
+
+    if (source == NULL || destination == NULL)
+    {
+        LogError("invalid argument (source=%p, destination=%p)", source, destination);
+        result = __FAILURE__;
+    }
+    else
+    {
+#if defined(_WIN32)
+        /*rename does not overwrite an existing file on Windows*/
+        (void)remove(destination);
+#endif
+        if (rename(source, destination) != 0)
+        {
+            LogError("failed renaming %s to %s", source, destination);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
@@ -29,6 +29,9 @@
 #define AMQP_DIAGNOSTIC_CONTEXT_KEY "Correlation-Context"
 #define AMQP_DIAGNOSTIC_CREATION_TIME_UTC_KEY "creationtimeutc"
 
+/*described type (0x00) with the smallulong descriptor (0x53) of the data section (0x75), followed by a vbin8 or a vbin32 constructor and its length*/
+#define AMQP_DATA_SECTION_HEADER_MAX_SIZE 8
+
 static int encode_callback(void* context, const unsigned char* bytes, size_t length)
 {
     BINARY_DATA* message_body_binary = (BINARY_DATA*)context;
@@ -312,7 +315,7 @@ static int create_application_properties_to_encode(MESSAGE_HANDLE message_batch_
     AMQP_VALUE uamqp_properties_map = NULL;
     int result;
 
-    if ((properties_map = IoTHubMessage_Properties(messageHandle)) == NULL)
+    if ((properties_map = IoTHubMessage_GetReadOnlyProperties(messageHandle)) == NULL)
     {
         LogError("Failed to get property map from IoTHub message.");
         result = __FAILURE__;
@@ -512,21 +515,106 @@ static int create_message_annotations_to_encode(IOTHUB_MESSAGE_HANDLE messageHan
     return result;
 }
 
+// Writes the header of an AMQP data section holding body_size bytes, returns its length or 0 if the body cannot fit in a data section.
+static size_t create_data_section_header(size_t body_size, unsigned char* header)
+{
+    size_t result;
+
+    if (body_size > UINT32_MAX)
+    {
+        LogError("body of %lu bytes is too large for an AMQP data section", (unsigned long)body_size);
+        result = 0;
+    }
+    else
+    {
+        header[0] = 0x00;
+        header[1] = 0x53;
+        header[2] = 0x75;
+        if (body_size <= 0xFF)
+        {
+            header[3] = 0xA0;
+            header[4] = (unsigned char)body_size;
+            result = 5;
+        }
+        else
+        {
+            header[3] = 0xB0;
+            header[4] = (unsigned char)((body_size >> 24) & 0xFF);
+            header[5] = (unsigned char)((body_size >> 16) & 0xFF);
+            header[6] = (unsigned char)((body_size >> 8) & 0xFF);
+            header[7] = (unsigned char)(body_size & 0xFF);
+            result = 8;
+        }
+    }
+
+    return result;
+}
+
+// Codes_SRS_UAMQP_MESSAGING_10_001: [A body made of several segments shall be written as a single AMQP data section, copying each segment straight into the encoded message.]
+static void encode_data_segments(const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT* segments, size_t segment_count, BINARY_DATA* body_binary_data)
+{
+    unsigned char header[AMQP_DATA_SECTION_HEADER_MAX_SIZE];
+    size_t body_size = 0;
+    size_t index;
+
+    for (index = 0; index < segment_count; index++)
+    {
+        body_size += segments[index].size;
+    }
+
+    (void)encode_callback(body_binary_data, header, create_data_section_header(body_size, header));
+    for (index = 0; index < segment_count; index++)
+    {
+        (void)encode_callback(body_binary_data, segments[index].buffer, segments[index].size);
+    }
+}
+
 // Codes_SRS_UAMQP_MESSAGING_31_118: [Gets data associated with IOTHUB_MESSAGE_HANDLE to encode, either from underlying byte array or string format.]
-static int create_data_to_encode(IOTHUB_MESSAGE_HANDLE messageHandle, AMQP_VALUE *data_value, size_t *data_length)
+static int create_data_to_encode(IOTHUB_MESSAGE_HANDLE messageHandle, AMQP_VALUE *data_value, const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT** data_segments, size_t* data_segment_count, size_t *data_length)
 {
     int result;
 
     IOTHUBMESSAGE_CONTENT_TYPE contentType = IoTHubMessage_GetContentType(messageHandle);
     const char* messageContent = NULL;
     size_t messageContentSize = 0;
+    const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT* segments = NULL;
+    size_t segmentCount = 0;
 
     if ((contentType == IOTHUBMESSAGE_BYTEARRAY) &&
-        IoTHubMessage_GetByteArray(messageHandle, (const unsigned char **)&messageContent, &messageContentSize) != IOTHUB_MESSAGE_OK)
+        IoTHubMessage_GetByteArraySegments(messageHandle, &segments, &segmentCount) != IOTHUB_MESSAGE_OK)
     {
         LogError("Failed getting the BYTE array representation of the IOTHUB_MESSAGE_HANDLE instance.");
         result = __FAILURE__;
     }
+    else if (segmentCount > 1)
+    {
+        // Codes_SRS_UAMQP_MESSAGING_10_002: [If the body is made of several segments, their total size shall be computed without gathering them and no AMQP_VALUE shall be created for the data section.]
+        unsigned char header[AMQP_DATA_SECTION_HEADER_MAX_SIZE];
+        size_t body_size = 0;
+        size_t index;
+
+        for (index = 0; index < segmentCount; index++)
+        {
+            if (segments[index].size > UINT32_MAX - body_size)
+            {
+                break;
+            }
+            body_size += segments[index].size;
+        }
+
+        if (index < segmentCount)
+        {
+            LogError("body of the message is too large for an AMQP data section");
+            result = __FAILURE__;
+        }
+        else
+        {
+            *data_segments = segments;
+            *data_segment_count = segmentCount;
+            *data_length = create_data_section_header(body_size, header) + body_size;
+            result = RESULT_OK;
+        }
+    }
     else if ((contentType == IOTHUBMESSAGE_STRING) &&
         ((messageContent = IoTHubMessage_GetString(messageHandle)) == NULL))
     {
@@ -544,6 +632,11 @@ static int create_data_to_encode(IOTHUB_MESSAGE_HANDLE messageHandle, AMQP_VALUE
         {
             messageContentSize = strlen(messageContent);
         }
+        else
+        {
+            messageContent = (const char*)segments[0].buffer;
+            messageContentSize = segments[0].size;
+        }
     
         data bin_data;
         bin_data.bytes = (const unsigned char *)messageContent;
@@ -578,6 +671,8 @@ int message_create_uamqp_encoding_from_iothub_message(MESSAGE_HANDLE message_bat
     AMQP_VALUE application_properties = NULL;
     AMQP_VALUE message_annotations = NULL;
     AMQP_VALUE data_value = NULL;
+    const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT* data_segments = NULL;
+    size_t data_segment_count = 0;
     size_t message_properties_length = 0;
     size_t application_properties_length = 0;
     size_t message_annotations_length = 0;
@@ -601,7 +696,7 @@ int message_create_uamqp_encoding_from_iothub_message(MESSAGE_HANDLE message_bat
         LogError("create_message_annotations_to_encode() failed");
         result = __FAILURE__;
     }
-    else if (create_data_to_encode(message_handle, &data_value, &data_length) != RESULT_OK)
+    else if (create_data_to_encode(message_handle, &data_value, &data_segments, &data_segment_count, &data_length) != RESULT_OK)
     {
         LogError("create_data_to_encode() failed");
         result = __FAILURE__;
@@ -627,13 +722,18 @@ int message_create_uamqp_encoding_from_iothub_message(MESSAGE_HANDLE message_bat
         LogError("amqpvalue_encode() for message annotations failed");
         result = __FAILURE__;
     }
-    else if (RESULT_OK != amqpvalue_encode(data_value, &encode_callback, body_binary_data))
+    else if ((data_value != NULL) && (RESULT_OK != amqpvalue_encode(data_value, &encode_callback, body_binary_data)))
     {
         LogError("amqpvalue_encode() for data value failed");
         result = __FAILURE__;
     }
     else
     {
+        if (data_value == NULL)
+        {
+            encode_data_segments(data_segments, data_segment_count, body_binary_data);
+        }
+
         body_binary_data->length = message_properties_length + application_properties_length + data_length + message_annotations_length;
         result = RESULT_OK;
     }
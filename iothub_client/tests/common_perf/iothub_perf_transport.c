@@ -0,0 +1,181 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
+#include "iothub_client_ll.h"
+#include "iothub_client_private.h"
+#include "iothub_transport_ll.h"
+#include "iothub_perf_transport.h"
+
+static int perf_transport_instance;
+static int perf_device_instance;
+static bool perf_send_enabled = false;
+static PDLIST_ENTRY perf_waiting_to_send = NULL;
+
+static TRANSPORT_LL_HANDLE PerfTransport_Create(const IOTHUBTRANSPORT_CONFIG* config)
+{
+    (void)config;
+    return (TRANSPORT_LL_HANDLE)&perf_transport_instance;
+}
+
+static void PerfTransport_Destroy(TRANSPORT_LL_HANDLE handle)
+{
+    (void)handle;
+}
+
+static IOTHUB_DEVICE_HANDLE PerfTransport_Register(TRANSPORT_LL_HANDLE handle, const IOTHUB_DEVICE_CONFIG* device, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, PDLIST_ENTRY waitingToSend)
+{
+    (void)handle;
+    (void)device;
+    (void)iotHubClientHandle;
+    perf_waiting_to_send = waitingToSend;
+    return (IOTHUB_DEVICE_HANDLE)&perf_device_instance;
+}
+
+static void PerfTransport_Unregister(IOTHUB_DEVICE_HANDLE deviceHandle)
+{
+    (void)deviceHandle;
+}
+
+static int PerfTransport_Subscribe(IOTHUB_DEVICE_HANDLE handle)
+{
+    (void)handle;
+    return 0;
+}
+
+static void PerfTransport_Unsubscribe(IOTHUB_DEVICE_HANDLE handle)
+{
+    (void)handle;
+}
+
+static void PerfTransport_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
+{
+    (void)handle;
+    if (perf_send_enabled)
+    {
+        DLIST_ENTRY completed;
+        PDLIST_ENTRY entry;
+
+        DList_InitializeListHead(&completed);
+        while ((entry = DList_RemoveHeadList(perf_waiting_to_send)) != perf_waiting_to_send)
+        {
+            DList_InsertTailList(&completed, entry);
+        }
+        IoTHubClient_LL_SendComplete(iotHubClientHandle, &completed, IOTHUB_CLIENT_CONFIRMATION_OK);
+    }
+}
+
+static int PerfTransport_SetRetryPolicy(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_RETRY_POLICY retryPolicy, size_t retryTimeoutLimitInSeconds)
+{
+    (void)handle;
+    (void)retryPolicy;
+    (void)retryTimeoutLimitInSeconds;
+    return 0;
+}
+
+static IOTHUB_CLIENT_RESULT PerfTransport_GetSendStatus(IOTHUB_DEVICE_HANDLE handle, IOTHUB_CLIENT_STATUS* iotHubClientStatus)
+{
+    (void)handle;
+    *iotHubClientStatus = IOTHUB_CLIENT_SEND_STATUS_BUSY;
+    return IOTHUB_CLIENT_OK;
+}
+
+static IOTHUB_CLIENT_RESULT PerfTransport_GetNextWorkDeadline(TRANSPORT_LL_HANDLE handle, uint64_t* msToNextWork)
+{
+    (void)handle;
+    *msToNextWork = UINT64_MAX;
+    return IOTHUB_CLIENT_OK;
+}
+
+static IOTHUB_CLIENT_RESULT PerfTransport_SetOption(TRANSPORT_LL_HANDLE handle, const char* optionName, const void* value)
+{
+    (void)handle;
+    (void)optionName;
+    (void)value;
+    return IOTHUB_CLIENT_OK;
+}
+
+static STRING_HANDLE PerfTransport_GetHostname(TRANSPORT_LL_HANDLE handle)
+{
+    (void)handle;
+    return STRING_construct("perf-hub.azure-devices.net");
+}
+
+static IOTHUB_PROCESS_ITEM_RESULT PerfTransport_ProcessItem(TRANSPORT_LL_HANDLE handle, IOTHUB_IDENTITY_TYPE item_type, IOTHUB_IDENTITY_INFO* iothub_item)
+{
+    (void)handle;
+    (void)item_type;
+    (void)iothub_item;
+    return IOTHUB_PROCESS_ERROR;
+}
+
+static IOTHUB_CLIENT_RESULT PerfTransport_SendMessageDisposition(MESSAGE_CALLBACK_INFO* messageData, IOTHUBMESSAGE_DISPOSITION_RESULT disposition)
+{
+    (void)messageData;
+    (void)disposition;
+    return IOTHUB_CLIENT_ERROR;
+}
+
+static int PerfTransport_DeviceMethod_Response(IOTHUB_DEVICE_HANDLE handle, METHOD_HANDLE methodId, const unsigned char* response, size_t response_size, int status_response)
+{
+    (void)handle;
+    (void)methodId;
+    (void)response;
+    (void)response_size;
+    (void)status_response;
+    return __FAILURE__;
+}
+
+static TRANSPORT_PROVIDER perf_transport_provider =
+{
+    PerfTransport_SendMessageDisposition,   /*pfIotHubTransport_SendMessageDisposition IoTHubTransport_SendMessageDisposition;*/
+    PerfTransport_Subscribe,                /*pfIoTHubTransport_Subscribe_DeviceMethod IoTHubTransport_Subscribe_DeviceMethod;*/
+    PerfTransport_Unsubscribe,              /*pfIoTHubTransport_Unsubscribe_DeviceMethod IoTHubTransport_Unsubscribe_DeviceMethod;*/
+    PerfTransport_DeviceMethod_Response,    /*pfIoTHubTransport_DeviceMethod_Response IoTHubTransport_DeviceMethod_Response;*/
+    PerfTransport_Subscribe,                /*pfIoTHubTransport_Subscribe_DeviceTwin IoTHubTransport_Subscribe_DeviceTwin;*/
+    PerfTransport_Unsubscribe,              /*pfIoTHubTransport_Unsubscribe_DeviceTwin IoTHubTransport_Unsubscribe_DeviceTwin;*/
+    PerfTransport_ProcessItem,              /*pfIoTHubTransport_ProcessItem IoTHubTransport_ProcessItem;*/
+    PerfTransport_GetHostname,              /*pfIoTHubTransport_GetHostname IoTHubTransport_GetHostname;*/
+    PerfTransport_SetOption,                /*pfIoTHubTransport_SetOption IoTHubTransport_SetOption;*/
+    PerfTransport_Create,                   /*pfIoTHubTransport_Create IoTHubTransport_Create;*/
+    PerfTransport_Destroy,                  /*pfIoTHubTransport_Destroy IoTHubTransport_Destroy;*/
+    PerfTransport_Register,                 /*pfIotHubTransport_Register IoTHubTransport_Register;*/
+    PerfTransport_Unregister,               /*pfIotHubTransport_Unregister IoTHubTransport_Unegister;*/
+    PerfTransport_Subscribe,                /*pfIoTHubTransport_Subscribe IoTHubTransport_Subscribe;*/
+    PerfTransport_Unsubscribe,              /*pfIoTHubTransport_Unsubscribe IoTHubTransport_Unsubscribe;*/
+    PerfTransport_DoWork,                   /*pfIoTHubTransport_DoWork IoTHubTransport_DoWork;*/
+    PerfTransport_SetRetryPolicy,           /*pfIoTHubTransport_SetRetryPolicy IoTHubTransport_SetRetryPolicy;*/
+    PerfTransport_GetSendStatus,            /*pfIoTHubTransport_GetSendStatus IoTHubTransport_GetSendStatus;*/
+    PerfTransport_GetNextWorkDeadline       /*pfIoTHubTransport_GetNextWorkDeadline IoTHubTransport_GetNextWorkDeadline;*/
+};
+
+const TRANSPORT_PROVIDER* PerfTransport_Protocol(void)
+{
+    return &perf_transport_provider;
+}
+
+void perf_transport_set_send_enabled(bool isSendEnabled)
+{
+    perf_send_enabled = isSendEnabled;
+}
+
+IOTHUB_CLIENT_LL_HANDLE perf_transport_create_client(void)
+{
+    IOTHUB_CLIENT_CONFIG config;
+
+    config.protocol = PerfTransport_Protocol;
+    config.deviceId = "perfDevice";
+    config.deviceKey = "cGVyZkRldmljZUtleQ==";
+    config.deviceSasToken = NULL;
+    config.iotHubName = "perf-hub";
+    config.iotHubSuffix = "azure-devices.net";
+    config.protocolGatewayHostName = NULL;
+
+    return IoTHubClient_LL_Create(&config);
+}
@@ -0,0 +1,28 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifndef IOTHUB_PERF_TRANSPORT_H
+#define IOTHUB_PERF_TRANSPORT_H
+
+#include <stdbool.h>
+
+#include "iothub_client_ll.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*an in-process transport for benchmarks: it never touches the network. When sending is disabled (the default)
+messages stay in waitingToSend, as during an outage. When it is enabled every DoWork completes all waiting
+messages with IOTHUB_CLIENT_CONFIRMATION_OK.*/
+extern const TRANSPORT_PROVIDER* PerfTransport_Protocol(void);
+extern void perf_transport_set_send_enabled(bool isSendEnabled);
+
+/*creates an IoTHubClient_LL instance on top of PerfTransport_Protocol*/
+extern IOTHUB_CLIENT_LL_HANDLE perf_transport_create_client(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTHUB_PERF_TRANSPORT_H */
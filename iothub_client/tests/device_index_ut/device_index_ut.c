@@ -0,0 +1,579 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+#include "umocktypes.h"
+#include "umocktypes_c.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#undef ENABLE_MOCKS
+
+#include "device_index.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+#define TEST_DEVICE_ID_1    "device1"
+#define TEST_DEVICE_ID_2    "device2"
+#define TEST_DEVICE_ID_3    "device3"
+#define TEST_MANY_DEVICES   40
+
+static int test_values[TEST_MANY_DEVICES];
+
+
+static void register_global_mock_hooks()
+{
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+}
+
+static DEVICE_INDEX_HANDLE create_test_index(void)
+{
+    DEVICE_INDEX_HANDLE result = device_index_create();
+    ASSERT_IS_NOT_NULL(result);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static DEVICE_INDEX_ITEM_HANDLE add_test_device(DEVICE_INDEX_HANDLE device_index, const char* device_id, const void* value)
+{
+    DEVICE_INDEX_ITEM_HANDLE result = device_index_add(device_index, device_id, value);
+    ASSERT_IS_NOT_NULL(result);
+    return result;
+}
+
+
+BEGIN_TEST_SUITE(device_index_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    register_global_mock_hooks();
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+// Tests_SRS_DEVICE_INDEX_10_001: [device_index_create shall allocate an empty index with 16 buckets]
+TEST_FUNCTION(device_index_create_succeeds)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(16 * sizeof(void*)));
+
+    // act
+    DEVICE_INDEX_HANDLE result = device_index_create();
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(size_t, 0, device_index_get_count(result));
+    ASSERT_IS_NULL(device_index_get_head_item(result));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    device_index_destroy(result);
+}
+
+// Tests_SRS_DEVICE_INDEX_10_002: [If any failure occurs, device_index_create shall fail and return NULL]
+TEST_FUNCTION(device_index_create_malloc_fails)
+{
+    size_t i;
+
+    for (i = 0; i < 2; i++)
+    {
+        // arrange
+        umock_c_reset_all_calls();
+        if (i == 0)
+        {
+            STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)).SetReturn(NULL);
+        }
+        else
+        {
+            STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+            STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)).SetReturn(NULL);
+            STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        }
+
+        // act
+        DEVICE_INDEX_HANDLE result = device_index_create();
+
+        // assert
+        ASSERT_IS_NULL(result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+}
+
+// Tests_SRS_DEVICE_INDEX_10_003: [If `device_index` is NULL, device_index_destroy shall return]
+TEST_FUNCTION(device_index_destroy_NULL_handle)
+{
+    // arrange
+
+    // act
+    device_index_destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_DEVICE_INDEX_10_004: [device_index_destroy shall free all the items and the index, but not the values stored in the items]
+TEST_FUNCTION(device_index_destroy_releases_the_items_and_the_index)
+{
+    // arrange
+    DEVICE_INDEX_HANDLE device_index = create_test_index();
+    DEVICE_INDEX_ITEM_HANDLE item1 = add_test_device(device_index, TEST_DEVICE_ID_1, &test_values[0]);
+    DEVICE_INDEX_ITEM_HANDLE item2 = add_test_device(device_index, TEST_DEVICE_ID_2, &test_values[1]);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(item1));
+    STRICT_EXPECTED_CALL(gballoc_free(item2));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(device_index));
+
+    // act
+    device_index_destroy(device_index);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_DEVICE_INDEX_10_005: [If `device_index` or `device_id` is NULL, device_index_add shall fail and return NULL]
+TEST_FUNCTION(device_index_add_NULL_arguments_fail)
+{
+    // arrange
+    DEVICE_INDEX_HANDLE device_index = create_test_index();
+
+    // act
+    DEVICE_INDEX_ITEM_HANDLE result1 = device_index_add(NULL, TEST_DEVICE_ID_1, &test_values[0]);
+    DEVICE_INDEX_ITEM_HANDLE result2 = device_index_add(device_index, NULL, &test_values[0]);
+
+    // assert
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+    ASSERT_ARE_EQUAL(size_t, 0, device_index_get_count(device_index));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    device_index_destroy(device_index);
+}
+
+// Tests_SRS_DEVICE_INDEX_10_007: [device_index_add shall allocate an item holding `value` and a copy of `device_id`]
+// Tests_SRS_DEVICE_INDEX_10_008: [device_index_add shall link the item in the bucket of the hash of `device_id` and at the end of the index, and return it]
+// Tests_SRS_DEVICE_INDEX_10_015: [device_index_find shall return the item whose device id is equal to `device_id`, or NULL if there is none]
+// Tests_SRS_DEVICE_INDEX_10_016: [device_index_item_get_value shall return the value stored in `item`, or NULL if `item` is NULL]
+TEST_FUNCTION(device_index_add_succeeds)
+{
+    // arrange
+    DEVICE_INDEX_HANDLE device_index = create_test_index();
+    char device_id[] = TEST_DEVICE_ID_1;
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    // act
+    DEVICE_INDEX_ITEM_HANDLE result = device_index_add(device_index, device_id, &test_values[0]);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    device_id[0] = 'X';
+    ASSERT_ARE_EQUAL(void_ptr, result, device_index_find(device_index, TEST_DEVICE_ID_1));
+    ASSERT_ARE_EQUAL(void_ptr, &test_values[0], device_index_item_get_value(result));
+    ASSERT_ARE_EQUAL(void_ptr, result, device_index_get_head_item(device_index));
+    ASSERT_ARE_EQUAL(size_t, 1, device_index_get_count(device_index));
+
+    // cleanup
+    device_index_destroy(device_index);
+}
+
+// Tests_SRS_DEVICE_INDEX_10_006: [If an item with the same `device_id` is already in the index, device_index_add shall fail and return NULL]
+TEST_FUNCTION(device_index_add_duplicate_device_id_fails)
+{
+    // arrange
+    DEVICE_INDEX_HANDLE device_index = create_test_index();
+    DEVICE_INDEX_ITEM_HANDLE item = add_test_device(device_index, TEST_DEVICE_ID_1, &test_values[0]);
+    umock_c_reset_all_calls();
+
+    // act
+    DEVICE_INDEX_ITEM_HANDLE result = device_index_add(device_index, TEST_DEVICE_ID_1, &test_values[1]);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, item, device_index_find(device_index, TEST_DEVICE_ID_1));
+    ASSERT_ARE_EQUAL(size_t, 1, device_index_get_count(device_index));
+
+    // cleanup
+    device_index_destroy(device_index);
+}
+
+// Tests_SRS_DEVICE_INDEX_10_009: [If allocating the item fails, device_index_add shall fail and return NULL]
+TEST_FUNCTION(device_index_add_malloc_fails)
+{
+    // arrange
+    DEVICE_INDEX_HANDLE device_index = create_test_index();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)).SetReturn(NULL);
+
+    // act
+    DEVICE_INDEX_ITEM_HANDLE result = device_index_add(device_index, TEST_DEVICE_ID_1, &test_values[0]);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(device_index_find(device_index, TEST_DEVICE_ID_1));
+    ASSERT_ARE_EQUAL(size_t, 0, device_index_get_count(device_index));
+
+    // cleanup
+    device_index_destroy(device_index);
+}
+
+// Tests_SRS_DEVICE_INDEX_10_010: [When the index holds more items than buckets, device_index_add shall double the number of buckets]
+TEST_FUNCTION(device_index_add_grows_the_buckets)
+{
+    // arrange
+    DEVICE_INDEX_HANDLE device_index = create_test_index();
+    char device_id[16];
+    size_t i;
+
+    for (i = 0; i < 16; i++)
+    {
+        (void)sprintf(device_id, "device%lu", (unsigned long)i);
+        (void)add_test_device(device_index, device_id, &test_values[i]);
+    }
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(32 * sizeof(void*)));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    (void)sprintf(device_id, "device%lu", (unsigned long)i);
+    DEVICE_INDEX_ITEM_HANDLE result = device_index_add(device_index, device_id, &test_values[i]);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    for (i = 0; i <= 16; i++)
+    {
+        (void)sprintf(device_id, "device%lu", (unsigned long)i);
+        ASSERT_ARE_EQUAL(void_ptr, &test_values[i], device_index_item_get_value(device_index_find(device_index, device_id)));
+    }
+
+    // cleanup
+    device_index_destroy(device_index);
+}
+
+// Tests_SRS_DEVICE_INDEX_10_010: [When the index holds more items than buckets, device_index_add shall double the number of buckets]
+TEST_FUNCTION(device_index_add_succeeds_when_growing_the_buckets_fails)
+{
+    // arrange
+    DEVICE_INDEX_HANDLE device_index = create_test_index();
+    char device_id[16];
+    size_t i;
+
+    for (i = 0; i < 16; i++)
+    {
+        (void)sprintf(device_id, "device%lu", (unsigned long)i);
+        (void)add_test_device(device_index, device_id, &test_values[i]);
+    }
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(32 * sizeof(void*))).SetReturn(NULL);
+
+    // act
+    (void)sprintf(device_id, "device%lu", (unsigned long)i);
+    DEVICE_INDEX_ITEM_HANDLE result = device_index_add(device_index, device_id, &test_values[i]);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    for (i = 0; i <= 16; i++)
+    {
+        (void)sprintf(device_id, "device%lu", (unsigned long)i);
+        ASSERT_ARE_EQUAL(void_ptr, &test_values[i], device_index_item_get_value(device_index_find(device_index, device_id)));
+    }
+
+    // cleanup
+    device_index_destroy(device_index);
+}
+
+// Tests_SRS_DEVICE_INDEX_10_011: [If `device_index` or `item` is NULL, device_index_remove shall fail and return a non-zero value]
+TEST_FUNCTION(device_index_remove_NULL_arguments_fail)
+{
+    // arrange
+    DEVICE_INDEX_HANDLE device_index = create_test_index();
+    DEVICE_INDEX_ITEM_HANDLE item = add_test_device(device_index, TEST_DEVICE_ID_1, &test_values[0]);
+    umock_c_reset_all_calls();
+
+    // act
+    int result1 = device_index_remove(NULL, item);
+    int result2 = device_index_remove(device_index, NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result1);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result2);
+    ASSERT_ARE_EQUAL(size_t, 1, device_index_get_count(device_index));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    device_index_destroy(device_index);
+}
+
+// Tests_SRS_DEVICE_INDEX_10_013: [If `item` is not in the index, device_index_remove shall fail and return a non-zero value]
+TEST_FUNCTION(device_index_remove_item_of_another_index_fails)
+{
+    // arrange
+    DEVICE_INDEX_HANDLE device_index1 = create_test_index();
+    DEVICE_INDEX_HANDLE device_index2 = create_test_index();
+    DEVICE_INDEX_ITEM_HANDLE item = add_test_device(device_index2, TEST_DEVICE_ID_1, &test_values[0]);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = device_index_remove(device_index1, item);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 1, device_index_get_count(device_index2));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    device_index_destroy(device_index1);
+    device_index_destroy(device_index2);
+}
+
+// Tests_SRS_DEVICE_INDEX_10_012: [device_index_remove shall unlink `item` from its bucket and from the index, free it and return 0]
+TEST_FUNCTION(device_index_remove_succeeds)
+{
+    // arrange
+    DEVICE_INDEX_HANDLE device_index = create_test_index();
+    DEVICE_INDEX_ITEM_HANDLE item1 = add_test_device(device_index, TEST_DEVICE_ID_1, &test_values[0]);
+    DEVICE_INDEX_ITEM_HANDLE item2 = add_test_device(device_index, TEST_DEVICE_ID_2, &test_values[1]);
+    DEVICE_INDEX_ITEM_HANDLE item3 = add_test_device(device_index, TEST_DEVICE_ID_3, &test_values[2]);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(item2));
+
+    // act
+    int result = device_index_remove(device_index, item2);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(device_index_find(device_index, TEST_DEVICE_ID_2));
+    ASSERT_ARE_EQUAL(void_ptr, item1, device_index_find(device_index, TEST_DEVICE_ID_1));
+    ASSERT_ARE_EQUAL(void_ptr, item3, device_index_find(device_index, TEST_DEVICE_ID_3));
+    ASSERT_ARE_EQUAL(void_ptr, item3, device_index_get_next_item(item1));
+    ASSERT_ARE_EQUAL(size_t, 2, device_index_get_count(device_index));
+
+    // cleanup
+    device_index_destroy(device_index);
+}
+
+// Tests_SRS_DEVICE_INDEX_10_012: [device_index_remove shall unlink `item` from its bucket and from the index, free it and return 0]
+TEST_FUNCTION(device_index_remove_first_and_last_items_succeeds)
+{
+    // arrange
+    DEVICE_INDEX_HANDLE device_index = create_test_index();
+    DEVICE_INDEX_ITEM_HANDLE item1 = add_test_device(device_index, TEST_DEVICE_ID_1, &test_values[0]);
+    DEVICE_INDEX_ITEM_HANDLE item2 = add_test_device(device_index, TEST_DEVICE_ID_2, &test_values[1]);
+    DEVICE_INDEX_ITEM_HANDLE item3 = add_test_device(device_index, TEST_DEVICE_ID_3, &test_values[2]);
+
+    // act
+    int result1 = device_index_remove(device_index, item1);
+    int result2 = device_index_remove(device_index, item3);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result1);
+    ASSERT_ARE_EQUAL(int, 0, result2);
+    ASSERT_ARE_EQUAL(void_ptr, item2, device_index_get_head_item(device_index));
+    ASSERT_IS_NULL(device_index_get_next_item(item2));
+    ASSERT_ARE_EQUAL(size_t, 1, device_index_get_count(device_index));
+
+    // cleanup
+    device_index_destroy(device_index);
+}
+
+// Tests_SRS_DEVICE_INDEX_10_014: [If `device_index` or `device_id` is NULL, device_index_find shall return NULL]
+TEST_FUNCTION(device_index_find_NULL_arguments_returns_NULL)
+{
+    // arrange
+    DEVICE_INDEX_HANDLE device_index = create_test_index();
+    (void)add_test_device(device_index, TEST_DEVICE_ID_1, &test_values[0]);
+    umock_c_reset_all_calls();
+
+    // act
+    DEVICE_INDEX_ITEM_HANDLE result1 = device_index_find(NULL, TEST_DEVICE_ID_1);
+    DEVICE_INDEX_ITEM_HANDLE result2 = device_index_find(device_index, NULL);
+
+    // assert
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    device_index_destroy(device_index);
+}
+
+// Tests_SRS_DEVICE_INDEX_10_015: [device_index_find shall return the item whose device id is equal to `device_id`, or NULL if there is none]
+TEST_FUNCTION(device_index_find_many_devices_succeeds)
+{
+    // arrange
+    DEVICE_INDEX_HANDLE device_index = create_test_index();
+    DEVICE_INDEX_ITEM_HANDLE items[TEST_MANY_DEVICES];
+    char device_id[16];
+    size_t i;
+
+    for (i = 0; i < TEST_MANY_DEVICES; i++)
+    {
+        (void)sprintf(device_id, "device%lu", (unsigned long)i);
+        items[i] = add_test_device(device_index, device_id, &test_values[i]);
+    }
+    umock_c_reset_all_calls();
+
+    // act
+    // assert
+    for (i = 0; i < TEST_MANY_DEVICES; i++)
+    {
+        (void)sprintf(device_id, "device%lu", (unsigned long)i);
+        ASSERT_ARE_EQUAL(void_ptr, items[i], device_index_find(device_index, device_id));
+    }
+    ASSERT_IS_NULL(device_index_find(device_index, "device"));
+    ASSERT_IS_NULL(device_index_find(device_index, "unknownDevice"));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    device_index_destroy(device_index);
+}
+
+// Tests_SRS_DEVICE_INDEX_10_016: [device_index_item_get_value shall return the value stored in `item`, or NULL if `item` is NULL]
+TEST_FUNCTION(device_index_item_get_value_NULL_item_returns_NULL)
+{
+    // arrange
+
+    // act
+    const void* result = device_index_item_get_value(NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+}
+
+// Tests_SRS_DEVICE_INDEX_10_017: [device_index_get_head_item shall return the item that was added first, or NULL if `device_index` is NULL or empty]
+// Tests_SRS_DEVICE_INDEX_10_018: [device_index_get_next_item shall return the item that was added after `item`, or NULL if `item` is NULL or the last item]
+TEST_FUNCTION(device_index_items_are_visited_in_add_order)
+{
+    // arrange
+    DEVICE_INDEX_HANDLE device_index = create_test_index();
+    DEVICE_INDEX_ITEM_HANDLE item;
+    size_t i;
+
+    (void)add_test_device(device_index, TEST_DEVICE_ID_3, &test_values[0]);
+    (void)add_test_device(device_index, TEST_DEVICE_ID_1, &test_values[1]);
+    (void)add_test_device(device_index, TEST_DEVICE_ID_2, &test_values[2]);
+
+    // act
+    for (i = 0, item = device_index_get_head_item(device_index); item != NULL; i++, item = device_index_get_next_item(item))
+    {
+        // assert
+        ASSERT_ARE_EQUAL(void_ptr, &test_values[i], device_index_item_get_value(item));
+    }
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 3, i);
+    ASSERT_IS_NULL(device_index_get_head_item(NULL));
+    ASSERT_IS_NULL(device_index_get_next_item(NULL));
+
+    // cleanup
+    device_index_destroy(device_index);
+}
+
+// Tests_SRS_DEVICE_INDEX_10_019: [device_index_get_count shall return the number of items in the index, or 0 if `device_index` is NULL]
+TEST_FUNCTION(device_index_get_count_succeeds)
+{
+    // arrange
+    DEVICE_INDEX_HANDLE device_index = create_test_index();
+    (void)add_test_device(device_index, TEST_DEVICE_ID_1, &test_values[0]);
+    (void)add_test_device(device_index, TEST_DEVICE_ID_2, &test_values[1]);
+
+    // act
+    size_t result1 = device_index_get_count(device_index);
+    size_t result2 = device_index_get_count(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 2, result1);
+    ASSERT_ARE_EQUAL(size_t, 0, result2);
+
+    // cleanup
+    device_index_destroy(device_index);
+}
+
+END_TEST_SUITE(device_index_ut)
@@ -0,0 +1,564 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes.h"
+#include "umocktypes_c.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/map.h"
+#include "iothub_message.h"
+#undef ENABLE_MOCKS
+
+#include "event_batch.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+#define TEST_MESSAGE_HANDLE         ((IOTHUB_MESSAGE_HANDLE)0x4241)
+#define TEST_MAP_HANDLE             ((MAP_HANDLE)0x4242)
+#define TEST_DESTINATION_SIZE       256
+#define TEST_DESTINATION_FILL       0x7F
+
+static IOTHUBMESSAGE_CONTENT_TYPE test_content_type;
+static IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT test_segments[3];
+static size_t test_segment_count;
+static const char* test_string;
+static const char* test_keys[2] = { "k1", "key2" };
+static const char* test_values[2] = { "v1", "value2" };
+static size_t test_property_count;
+
+static unsigned char test_destination[TEST_DESTINATION_SIZE];
+
+static IOTHUBMESSAGE_CONTENT_TYPE my_IoTHubMessage_GetContentType(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    (void)iotHubMessageHandle;
+    return test_content_type;
+}
+
+static IOTHUB_MESSAGE_RESULT my_IoTHubMessage_GetByteArraySegments(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT** segments, size_t* segmentCount)
+{
+    (void)iotHubMessageHandle;
+    *segments = test_segments;
+    *segmentCount = test_segment_count;
+    return IOTHUB_MESSAGE_OK;
+}
+
+static const char* my_IoTHubMessage_GetString(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    (void)iotHubMessageHandle;
+    return test_string;
+}
+
+static MAP_RESULT my_Map_GetInternals(MAP_HANDLE handle, const char*const** keys, const char*const** values, size_t* count)
+{
+    (void)handle;
+    *keys = (const char*const*)test_keys;
+    *values = (const char*const*)test_values;
+    *count = test_property_count;
+    return MAP_OK;
+}
+
+static void register_global_mock_hooks()
+{
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUBMESSAGE_CONTENT_TYPE, int);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetContentType, my_IoTHubMessage_GetContentType);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetByteArraySegments, my_IoTHubMessage_GetByteArraySegments);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_GetByteArraySegments, IOTHUB_MESSAGE_ERROR);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetString, my_IoTHubMessage_GetString);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_GetString, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_GetReadOnlyProperties, TEST_MAP_HANDLE);
+    REGISTER_GLOBAL_MOCK_HOOK(Map_GetInternals, my_Map_GetInternals);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Map_GetInternals, MAP_ERROR);
+}
+
+static void set_byte_array_message(const char* content)
+{
+    test_content_type = IOTHUBMESSAGE_BYTEARRAY;
+    test_segments[0].buffer = (const unsigned char*)content;
+    test_segments[0].size = strlen(content);
+    test_segment_count = 1;
+}
+
+static void set_expected_calls_for_item(void)
+{
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_MESSAGE_HANDLE));
+    if (test_content_type == IOTHUBMESSAGE_BYTEARRAY)
+    {
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    }
+    else
+    {
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetString(TEST_MESSAGE_HANDLE));
+    }
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+}
+
+/*writes the item of TEST_MESSAGE_HANDLE and checks it is expected_item, and that its size is the one event_batch_get_item_size computes*/
+static void assert_item_is(const char* expected_item)
+{
+    size_t itemSize;
+    size_t messageSize;
+    size_t writtenSize;
+
+    ASSERT_ARE_EQUAL(int, 0, event_batch_get_item_size(TEST_MESSAGE_HANDLE, &itemSize, &messageSize));
+    ASSERT_ARE_EQUAL(int, 0, event_batch_write_item(TEST_MESSAGE_HANDLE, test_destination, sizeof(test_destination), &writtenSize));
+
+    ASSERT_ARE_EQUAL(size_t, strlen(expected_item), itemSize);
+    ASSERT_ARE_EQUAL(size_t, itemSize, writtenSize);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(expected_item, test_destination, itemSize));
+    ASSERT_ARE_EQUAL(int, TEST_DESTINATION_FILL, test_destination[itemSize]);
+}
+
+
+BEGIN_TEST_SUITE(event_batch_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    register_global_mock_hooks();
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    set_byte_array_message("");
+    test_string = NULL;
+    test_property_count = 0;
+    (void)memset(test_destination, TEST_DESTINATION_FILL, sizeof(test_destination));
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+// Tests_SRS_EVENT_BATCH_10_001: [ If messageHandle, itemSize or messageSize is NULL, event_batch_get_item_size shall fail and return a non-zero value. ]
+TEST_FUNCTION(event_batch_get_item_size_NULL_messageHandle_fails)
+{
+    // arrange
+    size_t itemSize;
+    size_t messageSize;
+
+    // act
+    int result = event_batch_get_item_size(NULL, &itemSize, &messageSize);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_EVENT_BATCH_10_001: [ If messageHandle, itemSize or messageSize is NULL, event_batch_get_item_size shall fail and return a non-zero value. ]
+TEST_FUNCTION(event_batch_get_item_size_NULL_itemSize_fails)
+{
+    // arrange
+    size_t messageSize;
+
+    // act
+    int result = event_batch_get_item_size(TEST_MESSAGE_HANDLE, NULL, &messageSize);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_EVENT_BATCH_10_001: [ If messageHandle, itemSize or messageSize is NULL, event_batch_get_item_size shall fail and return a non-zero value. ]
+TEST_FUNCTION(event_batch_get_item_size_NULL_messageSize_fails)
+{
+    // arrange
+    size_t itemSize;
+
+    // act
+    int result = event_batch_get_item_size(TEST_MESSAGE_HANDLE, &itemSize, NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_EVENT_BATCH_10_002: [ The item of a message of type IOTHUBMESSAGE_BYTEARRAY shall be {"body":"base64 encoding of the content"}, with a base64 encoding 4 characters long for every 3 bytes of content, or fraction thereof. ]
+// Tests_SRS_EVENT_BATCH_10_006: [ The message size shall be the size of the content + 384, plus the length of the name + the length of the value + 16 for every property. ]
+TEST_FUNCTION(event_batch_get_item_size_byte_array_succeeds)
+{
+    // arrange
+    size_t itemSize;
+    size_t messageSize;
+    set_byte_array_message("foob");
+    set_expected_calls_for_item();
+
+    // act
+    int result = event_batch_get_item_size(TEST_MESSAGE_HANDLE, &itemSize, &messageSize);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, sizeof("{\"body\":\"Zm9vYg==\"}") - 1, itemSize);
+    ASSERT_ARE_EQUAL(size_t, 4 + 384, messageSize);
+}
+
+// Tests_SRS_EVENT_BATCH_10_002: [ The item of a message of type IOTHUBMESSAGE_BYTEARRAY shall be {"body":"base64 encoding of the content"}, with a base64 encoding 4 characters long for every 3 bytes of content, or fraction thereof. ]
+// Tests_SRS_EVENT_BATCH_10_009: [ event_batch_write_item shall write the item of the message at destination, set itemSize to its size and return 0. ]
+TEST_FUNCTION(event_batch_write_item_byte_array_succeeds)
+{
+    // arrange
+    size_t itemSize;
+    set_byte_array_message("foob");
+    set_expected_calls_for_item();
+
+    // act
+    int result = event_batch_write_item(TEST_MESSAGE_HANDLE, test_destination, sizeof(test_destination), &itemSize);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, sizeof("{\"body\":\"Zm9vYg==\"}") - 1, itemSize);
+    ASSERT_ARE_EQUAL(int, 0, memcmp("{\"body\":\"Zm9vYg==\"}", test_destination, itemSize));
+}
+
+// Tests_SRS_EVENT_BATCH_10_002: [ The item of a message of type IOTHUBMESSAGE_BYTEARRAY shall be {"body":"base64 encoding of the content"}, with a base64 encoding 4 characters long for every 3 bytes of content, or fraction thereof. ]
+TEST_FUNCTION(event_batch_write_item_base64_encodes_every_tail_size_succeeds)
+{
+    // arrange
+    const char* contents[] = { "", "f", "fo", "foo", "foob", "fooba", "foobar", "Many hands make light work." };
+    const char* items[] = {
+        "{\"body\":\"\"}",
+        "{\"body\":\"Zg==\"}",
+        "{\"body\":\"Zm8=\"}",
+        "{\"body\":\"Zm9v\"}",
+        "{\"body\":\"Zm9vYg==\"}",
+        "{\"body\":\"Zm9vYmE=\"}",
+        "{\"body\":\"Zm9vYmFy\"}",
+        "{\"body\":\"TWFueSBoYW5kcyBtYWtlIGxpZ2h0IHdvcmsu\"}"
+    };
+    size_t i;
+
+    for (i = 0; i < sizeof(contents) / sizeof(contents[0]); i++)
+    {
+        set_byte_array_message(contents[i]);
+        (void)memset(test_destination, TEST_DESTINATION_FILL, sizeof(test_destination));
+
+        // act
+        // assert
+        assert_item_is(items[i]);
+    }
+}
+
+// Tests_SRS_EVENT_BATCH_10_010: [ The segments of a message of type IOTHUBMESSAGE_BYTEARRAY shall be base64 encoded one after the other as if they were one byte array, without being gathered first. ]
+TEST_FUNCTION(event_batch_write_item_base64_encodes_segments_as_one_byte_array_succeeds)
+{
+    // arrange
+    test_content_type = IOTHUBMESSAGE_BYTEARRAY;
+    test_segments[0].buffer = (const unsigned char*)"Many h";
+    test_segments[0].size = 6;
+    test_segments[1].buffer = (const unsigned char*)"a";
+    test_segments[1].size = 1;
+    test_segments[2].buffer = (const unsigned char*)"nds make light work.";
+    test_segments[2].size = 20;
+    test_segment_count = 3;
+
+    // act
+    // assert
+    assert_item_is("{\"body\":\"TWFueSBoYW5kcyBtYWtlIGxpZ2h0IHdvcmsu\"}");
+}
+
+// Tests_SRS_EVENT_BATCH_10_010: [ The segments of a message of type IOTHUBMESSAGE_BYTEARRAY shall be base64 encoded one after the other as if they were one byte array, without being gathered first. ]
+TEST_FUNCTION(event_batch_write_item_base64_encodes_segments_with_a_carry_left_succeeds)
+{
+    // arrange
+    test_content_type = IOTHUBMESSAGE_BYTEARRAY;
+    test_segments[0].buffer = (const unsigned char*)"f";
+    test_segments[0].size = 1;
+    test_segments[1].buffer = (const unsigned char*)"";
+    test_segments[1].size = 0;
+    test_segments[2].buffer = (const unsigned char*)"ooba";
+    test_segments[2].size = 4;
+    test_segment_count = 3;
+
+    // act
+    // assert
+    assert_item_is("{\"body\":\"Zm9vYmE=\"}");
+}
+
+// Tests_SRS_EVENT_BATCH_10_003: [ The item of a message of type IOTHUBMESSAGE_STRING shall be {"body":"JSON encoding of the string","base64Encoded":false}, where '"', '\' and '/' are escaped with a '\' and the characters below 0x20 are written \u00xx. ]
+TEST_FUNCTION(event_batch_write_item_string_escapes_the_string_succeeds)
+{
+    // arrange
+    test_content_type = IOTHUBMESSAGE_STRING;
+    test_string = "a\"b\\c/d\x01\x1F e";
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetString(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    // act
+    // assert
+    assert_item_is("{\"body\":\"a\\\"b\\\\c\\/d\\u0001\\u001F e\",\"base64Encoded\":false}");
+}
+
+// Tests_SRS_EVENT_BATCH_10_006: [ The message size shall be the size of the content + 384, plus the length of the name + the length of the value + 16 for every property. ]
+TEST_FUNCTION(event_batch_get_item_size_string_counts_the_unescaped_string_succeeds)
+{
+    // arrange
+    size_t itemSize;
+    size_t messageSize;
+    test_content_type = IOTHUBMESSAGE_STRING;
+    test_string = "a\"b";
+
+    // act
+    int result = event_batch_get_item_size(TEST_MESSAGE_HANDLE, &itemSize, &messageSize);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, 3 + 384, messageSize);
+}
+
+// Tests_SRS_EVENT_BATCH_10_004: [ If the string of a message has a character outside [1..127], event_batch_get_item_size and event_batch_write_item shall fail and return a non-zero value. ]
+TEST_FUNCTION(event_batch_get_item_size_string_with_non_ascii_character_fails)
+{
+    // arrange
+    size_t itemSize;
+    size_t messageSize;
+    test_content_type = IOTHUBMESSAGE_STRING;
+    test_string = "caf\xC3\xA9";
+
+    // act
+    int result = event_batch_get_item_size(TEST_MESSAGE_HANDLE, &itemSize, &messageSize);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+// Tests_SRS_EVENT_BATCH_10_005: [ If the message has properties, they shall be serialized after the body as ,"properties":{"iothub-app-name1":"value1","iothub-app-name2":"value2"}, otherwise "properties" shall be missing from the item. ]
+// Tests_SRS_EVENT_BATCH_10_006: [ The message size shall be the size of the content + 384, plus the length of the name + the length of the value + 16 for every property. ]
+TEST_FUNCTION(event_batch_write_item_with_2_properties_succeeds)
+{
+    // arrange
+    size_t itemSize;
+    size_t messageSize;
+    set_byte_array_message("foo");
+    test_property_count = 2;
+
+    // act
+    // assert
+    assert_item_is("{\"body\":\"Zm9v\",\"properties\":{\"iothub-app-k1\":\"v1\",\"iothub-app-key2\":\"value2\"}}");
+    ASSERT_ARE_EQUAL(int, 0, event_batch_get_item_size(TEST_MESSAGE_HANDLE, &itemSize, &messageSize));
+    ASSERT_ARE_EQUAL(size_t, 3 + 384 + (2 + 2 + 16) + (4 + 6 + 16), messageSize);
+}
+
+// Tests_SRS_EVENT_BATCH_10_005: [ If the message has properties, they shall be serialized after the body as ,"properties":{"iothub-app-name1":"value1","iothub-app-name2":"value2"}, otherwise "properties" shall be missing from the item. ]
+TEST_FUNCTION(event_batch_write_item_string_with_1_property_succeeds)
+{
+    // arrange
+    test_content_type = IOTHUBMESSAGE_STRING;
+    test_string = "{\"temperature\":20}";
+    test_property_count = 1;
+
+    // act
+    // assert
+    assert_item_is("{\"body\":\"{\\\"temperature\\\":20}\",\"base64Encoded\":false,\"properties\":{\"iothub-app-k1\":\"v1\"}}");
+}
+
+// Tests_SRS_EVENT_BATCH_10_007: [ If the content type of the message is unknown, or its content or properties cannot be obtained, event_batch_get_item_size and event_batch_write_item shall fail and return a non-zero value. ]
+TEST_FUNCTION(event_batch_get_item_size_unknown_content_type_fails)
+{
+    // arrange
+    size_t itemSize;
+    size_t messageSize;
+    test_content_type = IOTHUBMESSAGE_UNKNOWN;
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_MESSAGE_HANDLE));
+
+    // act
+    int result = event_batch_get_item_size(TEST_MESSAGE_HANDLE, &itemSize, &messageSize);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_EVENT_BATCH_10_007: [ If the content type of the message is unknown, or its content or properties cannot be obtained, event_batch_get_item_size and event_batch_write_item shall fail and return a non-zero value. ]
+TEST_FUNCTION(event_batch_get_item_size_GetByteArraySegments_fails)
+{
+    // arrange
+    size_t itemSize;
+    size_t messageSize;
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(IOTHUB_MESSAGE_ERROR);
+
+    // act
+    int result = event_batch_get_item_size(TEST_MESSAGE_HANDLE, &itemSize, &messageSize);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_EVENT_BATCH_10_007: [ If the content type of the message is unknown, or its content or properties cannot be obtained, event_batch_get_item_size and event_batch_write_item shall fail and return a non-zero value. ]
+TEST_FUNCTION(event_batch_get_item_size_GetString_fails)
+{
+    // arrange
+    size_t itemSize;
+    size_t messageSize;
+    test_content_type = IOTHUBMESSAGE_STRING;
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetString(TEST_MESSAGE_HANDLE));
+
+    // act
+    int result = event_batch_get_item_size(TEST_MESSAGE_HANDLE, &itemSize, &messageSize);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_EVENT_BATCH_10_007: [ If the content type of the message is unknown, or its content or properties cannot be obtained, event_batch_get_item_size and event_batch_write_item shall fail and return a non-zero value. ]
+TEST_FUNCTION(event_batch_write_item_Map_GetInternals_fails)
+{
+    // arrange
+    size_t itemSize;
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(MAP_ERROR);
+
+    // act
+    int result = event_batch_write_item(TEST_MESSAGE_HANDLE, test_destination, sizeof(test_destination), &itemSize);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, TEST_DESTINATION_FILL, test_destination[0]);
+}
+
+// Tests_SRS_EVENT_BATCH_10_008: [ If messageHandle, destination or itemSize is NULL, event_batch_write_item shall fail and return a non-zero value. ]
+TEST_FUNCTION(event_batch_write_item_NULL_messageHandle_fails)
+{
+    // arrange
+    size_t itemSize;
+
+    // act
+    int result = event_batch_write_item(NULL, test_destination, sizeof(test_destination), &itemSize);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_EVENT_BATCH_10_008: [ If messageHandle, destination or itemSize is NULL, event_batch_write_item shall fail and return a non-zero value. ]
+TEST_FUNCTION(event_batch_write_item_NULL_destination_fails)
+{
+    // arrange
+    size_t itemSize;
+
+    // act
+    int result = event_batch_write_item(TEST_MESSAGE_HANDLE, NULL, sizeof(test_destination), &itemSize);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_EVENT_BATCH_10_008: [ If messageHandle, destination or itemSize is NULL, event_batch_write_item shall fail and return a non-zero value. ]
+TEST_FUNCTION(event_batch_write_item_NULL_itemSize_fails)
+{
+    // arrange
+
+    // act
+    int result = event_batch_write_item(TEST_MESSAGE_HANDLE, test_destination, sizeof(test_destination), NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_EVENT_BATCH_10_011: [ If the item of the message is longer than destinationSize, event_batch_write_item shall fail and return a non-zero value without writing anything. ]
+TEST_FUNCTION(event_batch_write_item_destination_too_small_fails)
+{
+    // arrange
+    size_t itemSize;
+    set_byte_array_message("foob");
+    set_expected_calls_for_item();
+
+    // act
+    int result = event_batch_write_item(TEST_MESSAGE_HANDLE, test_destination, sizeof("{\"body\":\"Zm9vYg==\"}") - 2, &itemSize);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, TEST_DESTINATION_FILL, test_destination[0]);
+}
+
+END_TEST_SUITE(event_batch_ut)
@@ -0,0 +1,572 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#endif
+
+#include "zlib.h"
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+#include "umocktypes.h"
+#include "umocktypes_c.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/buffer_.h"
+#undef ENABLE_MOCKS
+
+#include "http_compression.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+#define TEST_SOURCE_BUFFER          ((BUFFER_HANDLE)0x4241)
+#define TEST_DESTINATION_BUFFER     ((BUFFER_HANDLE)0x4242)
+#define TEST_LEVEL                  6
+#define TEST_SOURCE_SIZE            4096
+
+static unsigned char test_source[TEST_SOURCE_SIZE];
+static size_t test_source_size;
+static unsigned char test_destination[TEST_SOURCE_SIZE];
+static size_t test_destination_size;
+
+static size_t my_BUFFER_length(BUFFER_HANDLE handle)
+{
+    return (handle == TEST_DESTINATION_BUFFER) ? test_destination_size : test_source_size;
+}
+
+static unsigned char* my_BUFFER_u_char(BUFFER_HANDLE handle)
+{
+    return (handle == TEST_DESTINATION_BUFFER) ? test_destination : test_source;
+}
+
+static int my_BUFFER_unbuild(BUFFER_HANDLE handle)
+{
+    (void)handle;
+    test_destination_size = 0;
+    return 0;
+}
+
+static int my_BUFFER_pre_build(BUFFER_HANDLE handle, size_t size)
+{
+    (void)handle;
+    test_destination_size = size;
+    return 0;
+}
+
+static int my_BUFFER_shrink(BUFFER_HANDLE handle, size_t decreaseSize, bool fromEnd)
+{
+    (void)handle;
+    (void)fromEnd;
+    test_destination_size -= decreaseSize;
+    return 0;
+}
+
+static void register_global_mock_hooks()
+{
+    REGISTER_UMOCK_ALIAS_TYPE(BUFFER_HANDLE, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_length, my_BUFFER_length);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_u_char, my_BUFFER_u_char);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_unbuild, my_BUFFER_unbuild);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_unbuild, __LINE__);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_pre_build, my_BUFFER_pre_build);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_pre_build, __LINE__);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_shrink, my_BUFFER_shrink);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_shrink, __LINE__);
+}
+
+/*a JSON batch repeats the same keys, so it compresses well*/
+static void set_compressible_source(size_t size)
+{
+    static const char item[] = "{\"body\":\"eyJ0ZW1wZXJhdHVyZSI6MjB9\"},";
+    size_t i;
+    for (i = 0; i < size; i++)
+    {
+        test_source[i] = (unsigned char)item[i % (sizeof(item) - 1)];
+    }
+    test_source_size = size;
+}
+
+static void set_incompressible_source(size_t size)
+{
+    unsigned int state = 12345;
+    size_t i;
+    for (i = 0; i < size; i++)
+    {
+        state = state * 1103515245 + 12345;
+        test_source[i] = (unsigned char)(state >> 16);
+    }
+    test_source_size = size;
+}
+
+static void assert_destination_inflates_to_source(void)
+{
+    unsigned char inflated[TEST_SOURCE_SIZE];
+    z_stream stream;
+    int inflateResult;
+
+    (void)memset(&stream, 0, sizeof(stream));
+    ASSERT_ARE_EQUAL(int, Z_OK, inflateInit2(&stream, 15 + 16));
+    stream.next_in = test_destination;
+    stream.avail_in = (uInt)test_destination_size;
+    stream.next_out = inflated;
+    stream.avail_out = (uInt)sizeof(inflated);
+    inflateResult = inflate(&stream, Z_FINISH);
+    (void)inflateEnd(&stream);
+
+    ASSERT_ARE_EQUAL(int, Z_STREAM_END, inflateResult);
+    ASSERT_ARE_EQUAL(size_t, test_source_size, (size_t)stream.total_out);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(test_source, inflated, test_source_size));
+}
+
+BEGIN_TEST_SUITE(http_compression_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    register_global_mock_hooks();
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    set_compressible_source(TEST_SOURCE_SIZE);
+    test_destination_size = 0;
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+// Tests_SRS_HTTP_COMPRESSION_10_001: [ If level is not between 1 and 9, http_compression_create shall fail and return NULL. ]
+TEST_FUNCTION(http_compression_create_level_0_fails)
+{
+    // arrange
+
+    // act
+    HTTP_COMPRESSION_HANDLE result = http_compression_create(0);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_HTTP_COMPRESSION_10_001: [ If level is not between 1 and 9, http_compression_create shall fail and return NULL. ]
+TEST_FUNCTION(http_compression_create_level_10_fails)
+{
+    // arrange
+
+    // act
+    HTTP_COMPRESSION_HANDLE result = http_compression_create(10);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_HTTP_COMPRESSION_10_002: [ http_compression_create shall initialize a gzip deflate stream with the given level. ]
+TEST_FUNCTION(http_compression_create_succeeds)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    // act
+    HTTP_COMPRESSION_HANDLE result = http_compression_create(TEST_LEVEL);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    http_compression_destroy(result);
+}
+
+// Tests_SRS_HTTP_COMPRESSION_10_003: [ If any failure occurs, http_compression_create shall fail and return NULL. ]
+TEST_FUNCTION(http_compression_create_malloc_fails)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    // act
+    HTTP_COMPRESSION_HANDLE result = http_compression_create(TEST_LEVEL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_HTTP_COMPRESSION_10_004: [ If compression is NULL, http_compression_destroy shall return. ]
+TEST_FUNCTION(http_compression_destroy_NULL_does_nothing)
+{
+    // arrange
+
+    // act
+    http_compression_destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_HTTP_COMPRESSION_10_005: [ http_compression_destroy shall end the deflate stream and free the compressor. ]
+TEST_FUNCTION(http_compression_destroy_frees_the_compressor)
+{
+    // arrange
+    HTTP_COMPRESSION_HANDLE compression = http_compression_create(TEST_LEVEL);
+    ASSERT_ARE_EQUAL(int, 0, http_compression_compress(compression, TEST_SOURCE_BUFFER, TEST_DESTINATION_BUFFER));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(compression));
+
+    // act
+    http_compression_destroy(compression);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_HTTP_COMPRESSION_10_006: [ If compression, source or destination is NULL, http_compression_compress shall fail and return a non-zero value. ]
+TEST_FUNCTION(http_compression_compress_NULL_compression_fails)
+{
+    // arrange
+
+    // act
+    int result = http_compression_compress(NULL, TEST_SOURCE_BUFFER, TEST_DESTINATION_BUFFER);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_HTTP_COMPRESSION_10_006: [ If compression, source or destination is NULL, http_compression_compress shall fail and return a non-zero value. ]
+TEST_FUNCTION(http_compression_compress_NULL_source_fails)
+{
+    // arrange
+    HTTP_COMPRESSION_HANDLE compression = http_compression_create(TEST_LEVEL);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = http_compression_compress(compression, NULL, TEST_DESTINATION_BUFFER);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    http_compression_destroy(compression);
+}
+
+// Tests_SRS_HTTP_COMPRESSION_10_006: [ If compression, source or destination is NULL, http_compression_compress shall fail and return a non-zero value. ]
+TEST_FUNCTION(http_compression_compress_NULL_destination_fails)
+{
+    // arrange
+    HTTP_COMPRESSION_HANDLE compression = http_compression_create(TEST_LEVEL);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = http_compression_compress(compression, TEST_SOURCE_BUFFER, NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    http_compression_destroy(compression);
+}
+
+// Tests_SRS_HTTP_COMPRESSION_10_007: [ Unless destination already holds source - 1 bytes, http_compression_compress shall size it to source - 1 bytes with BUFFER_unbuild and BUFFER_pre_build. ]
+// Tests_SRS_HTTP_COMPRESSION_10_008: [ http_compression_compress shall reset the deflate stream and deflate source straight into destination with Z_FINISH. ]
+// Tests_SRS_HTTP_COMPRESSION_10_011: [ http_compression_compress shall shrink destination to the length of the compressed body with BUFFER_shrink and return 0. ]
+TEST_FUNCTION(http_compression_compress_succeeds)
+{
+    // arrange
+    HTTP_COMPRESSION_HANDLE compression = http_compression_create(TEST_LEVEL);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(BUFFER_length(TEST_SOURCE_BUFFER));
+    STRICT_EXPECTED_CALL(BUFFER_length(TEST_DESTINATION_BUFFER));
+    STRICT_EXPECTED_CALL(BUFFER_pre_build(TEST_DESTINATION_BUFFER, TEST_SOURCE_SIZE - 1));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(TEST_SOURCE_BUFFER));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(TEST_DESTINATION_BUFFER));
+    STRICT_EXPECTED_CALL(BUFFER_shrink(TEST_DESTINATION_BUFFER, IGNORED_NUM_ARG, true))
+        .IgnoreArgument_decreaseSize();
+
+    // act
+    int result = http_compression_compress(compression, TEST_SOURCE_BUFFER, TEST_DESTINATION_BUFFER);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(test_destination_size < TEST_SOURCE_SIZE);
+    assert_destination_inflates_to_source();
+
+    // cleanup
+    http_compression_destroy(compression);
+}
+
+// Tests_SRS_HTTP_COMPRESSION_10_007: [ Unless destination already holds source - 1 bytes, http_compression_compress shall size it to source - 1 bytes with BUFFER_unbuild and BUFFER_pre_build. ]
+TEST_FUNCTION(http_compression_compress_resizes_a_destination_of_another_size_succeeds)
+{
+    // arrange
+    HTTP_COMPRESSION_HANDLE compression = http_compression_create(TEST_LEVEL);
+    test_destination_size = TEST_SOURCE_SIZE / 2;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(BUFFER_length(TEST_SOURCE_BUFFER));
+    STRICT_EXPECTED_CALL(BUFFER_length(TEST_DESTINATION_BUFFER));
+    STRICT_EXPECTED_CALL(BUFFER_unbuild(TEST_DESTINATION_BUFFER));
+    STRICT_EXPECTED_CALL(BUFFER_pre_build(TEST_DESTINATION_BUFFER, TEST_SOURCE_SIZE - 1));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(TEST_SOURCE_BUFFER));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(TEST_DESTINATION_BUFFER));
+    STRICT_EXPECTED_CALL(BUFFER_shrink(TEST_DESTINATION_BUFFER, IGNORED_NUM_ARG, true))
+        .IgnoreArgument_decreaseSize();
+
+    // act
+    int result = http_compression_compress(compression, TEST_SOURCE_BUFFER, TEST_DESTINATION_BUFFER);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    assert_destination_inflates_to_source();
+
+    // cleanup
+    http_compression_destroy(compression);
+}
+
+// Tests_SRS_HTTP_COMPRESSION_10_007: [ Unless destination already holds source - 1 bytes, http_compression_compress shall size it to source - 1 bytes with BUFFER_unbuild and BUFFER_pre_build. ]
+TEST_FUNCTION(http_compression_compress_reuses_a_destination_of_the_right_size_succeeds)
+{
+    // arrange
+    HTTP_COMPRESSION_HANDLE compression = http_compression_create(TEST_LEVEL);
+    test_destination_size = TEST_SOURCE_SIZE - 1;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(BUFFER_length(TEST_SOURCE_BUFFER));
+    STRICT_EXPECTED_CALL(BUFFER_length(TEST_DESTINATION_BUFFER));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(TEST_SOURCE_BUFFER));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(TEST_DESTINATION_BUFFER));
+    STRICT_EXPECTED_CALL(BUFFER_shrink(TEST_DESTINATION_BUFFER, IGNORED_NUM_ARG, true))
+        .IgnoreArgument_decreaseSize();
+
+    // act
+    int result = http_compression_compress(compression, TEST_SOURCE_BUFFER, TEST_DESTINATION_BUFFER);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    assert_destination_inflates_to_source();
+
+    // cleanup
+    http_compression_destroy(compression);
+}
+
+// Tests_SRS_HTTP_COMPRESSION_10_009: [ If the compressed body does not fit in source - 1 bytes, http_compression_compress shall fail and return a non-zero value. ]
+TEST_FUNCTION(http_compression_compress_incompressible_source_fails)
+{
+    // arrange
+    HTTP_COMPRESSION_HANDLE compression = http_compression_create(TEST_LEVEL);
+    set_incompressible_source(TEST_SOURCE_SIZE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(BUFFER_length(TEST_SOURCE_BUFFER));
+    STRICT_EXPECTED_CALL(BUFFER_length(TEST_DESTINATION_BUFFER));
+    STRICT_EXPECTED_CALL(BUFFER_pre_build(TEST_DESTINATION_BUFFER, TEST_SOURCE_SIZE - 1));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(TEST_SOURCE_BUFFER));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(TEST_DESTINATION_BUFFER));
+
+    // act
+    int result = http_compression_compress(compression, TEST_SOURCE_BUFFER, TEST_DESTINATION_BUFFER);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    http_compression_destroy(compression);
+}
+
+// Tests_SRS_HTTP_COMPRESSION_10_008: [ http_compression_compress shall reset the deflate stream and deflate source straight into destination with Z_FINISH. ]
+TEST_FUNCTION(http_compression_compress_after_an_incompressible_source_succeeds)
+{
+    // arrange
+    HTTP_COMPRESSION_HANDLE compression = http_compression_create(TEST_LEVEL);
+    set_incompressible_source(TEST_SOURCE_SIZE);
+    ASSERT_ARE_NOT_EQUAL(int, 0, http_compression_compress(compression, TEST_SOURCE_BUFFER, TEST_DESTINATION_BUFFER));
+    set_compressible_source(TEST_SOURCE_SIZE);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = http_compression_compress(compression, TEST_SOURCE_BUFFER, TEST_DESTINATION_BUFFER);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    assert_destination_inflates_to_source();
+
+    // cleanup
+    http_compression_destroy(compression);
+}
+
+// Tests_SRS_HTTP_COMPRESSION_10_009: [ If the compressed body does not fit in source - 1 bytes, http_compression_compress shall fail and return a non-zero value. ]
+TEST_FUNCTION(http_compression_compress_empty_source_fails)
+{
+    // arrange
+    HTTP_COMPRESSION_HANDLE compression = http_compression_create(TEST_LEVEL);
+    test_source_size = 0;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(BUFFER_length(TEST_SOURCE_BUFFER));
+    STRICT_EXPECTED_CALL(BUFFER_length(TEST_DESTINATION_BUFFER));
+
+    // act
+    int result = http_compression_compress(compression, TEST_SOURCE_BUFFER, TEST_DESTINATION_BUFFER);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    http_compression_destroy(compression);
+}
+
+// Tests_SRS_HTTP_COMPRESSION_10_010: [ If any failure occurs, http_compression_compress shall fail and return a non-zero value. ]
+TEST_FUNCTION(http_compression_compress_BUFFER_unbuild_fails)
+{
+    // arrange
+    HTTP_COMPRESSION_HANDLE compression = http_compression_create(TEST_LEVEL);
+    test_destination_size = TEST_SOURCE_SIZE / 2;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(BUFFER_length(TEST_SOURCE_BUFFER));
+    STRICT_EXPECTED_CALL(BUFFER_length(TEST_DESTINATION_BUFFER));
+    STRICT_EXPECTED_CALL(BUFFER_unbuild(TEST_DESTINATION_BUFFER))
+        .SetReturn(__LINE__);
+
+    // act
+    int result = http_compression_compress(compression, TEST_SOURCE_BUFFER, TEST_DESTINATION_BUFFER);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    http_compression_destroy(compression);
+}
+
+// Tests_SRS_HTTP_COMPRESSION_10_010: [ If any failure occurs, http_compression_compress shall fail and return a non-zero value. ]
+TEST_FUNCTION(http_compression_compress_BUFFER_pre_build_fails)
+{
+    // arrange
+    HTTP_COMPRESSION_HANDLE compression = http_compression_create(TEST_LEVEL);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(BUFFER_length(TEST_SOURCE_BUFFER));
+    STRICT_EXPECTED_CALL(BUFFER_length(TEST_DESTINATION_BUFFER));
+    STRICT_EXPECTED_CALL(BUFFER_pre_build(TEST_DESTINATION_BUFFER, TEST_SOURCE_SIZE - 1))
+        .SetReturn(__LINE__);
+
+    // act
+    int result = http_compression_compress(compression, TEST_SOURCE_BUFFER, TEST_DESTINATION_BUFFER);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    http_compression_destroy(compression);
+}
+
+// Tests_SRS_HTTP_COMPRESSION_10_010: [ If any failure occurs, http_compression_compress shall fail and return a non-zero value. ]
+TEST_FUNCTION(http_compression_compress_BUFFER_shrink_fails)
+{
+    // arrange
+    HTTP_COMPRESSION_HANDLE compression = http_compression_create(TEST_LEVEL);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(BUFFER_length(TEST_SOURCE_BUFFER));
+    STRICT_EXPECTED_CALL(BUFFER_length(TEST_DESTINATION_BUFFER));
+    STRICT_EXPECTED_CALL(BUFFER_pre_build(TEST_DESTINATION_BUFFER, TEST_SOURCE_SIZE - 1));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(TEST_SOURCE_BUFFER));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(TEST_DESTINATION_BUFFER));
+    STRICT_EXPECTED_CALL(BUFFER_shrink(TEST_DESTINATION_BUFFER, IGNORED_NUM_ARG, true))
+        .IgnoreArgument_decreaseSize()
+        .SetReturn(__LINE__);
+
+    // act
+    int result = http_compression_compress(compression, TEST_SOURCE_BUFFER, TEST_DESTINATION_BUFFER);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    http_compression_destroy(compression);
+}
+
+END_TEST_SUITE(http_compression_ut)
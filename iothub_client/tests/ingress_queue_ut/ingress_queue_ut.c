@@ -0,0 +1,377 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+#include "umocktypes.h"
+#include "umocktypes_c.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#undef ENABLE_MOCKS
+
+#include "ingress_queue.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+#define TEST_CAPACITY       5
+#define TEST_RING_SIZE      8
+#define TEST_ITEM_COUNT     20
+
+static int test_items[TEST_ITEM_COUNT];
+
+
+static void register_global_mock_hooks()
+{
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+}
+
+static INGRESS_QUEUE_HANDLE create_test_queue(size_t capacity)
+{
+    INGRESS_QUEUE_HANDLE result = ingress_queue_create(capacity);
+    ASSERT_IS_NOT_NULL(result);
+    umock_c_reset_all_calls();
+    return result;
+}
+
+
+BEGIN_TEST_SUITE(ingress_queue_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    register_global_mock_hooks();
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+// Tests_SRS_INGRESS_QUEUE_10_001: [If `capacity` is 0 or larger than half of the largest size_t, ingress_queue_create shall fail and return NULL]
+TEST_FUNCTION(ingress_queue_create_invalid_capacity_fails)
+{
+    // arrange
+
+    // act
+    INGRESS_QUEUE_HANDLE result1 = ingress_queue_create(0);
+    INGRESS_QUEUE_HANDLE result2 = ingress_queue_create(SIZE_MAX);
+
+    // assert
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_INGRESS_QUEUE_10_003: [ingress_queue_create shall allocate a ring of `capacity` cells, rounded up to a power of two and to at least 2, each free for the position equal to its index]
+TEST_FUNCTION(ingress_queue_create_succeeds)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(TEST_RING_SIZE * (sizeof(size_t) + sizeof(void*))));
+
+    // act
+    INGRESS_QUEUE_HANDLE result = ingress_queue_create(TEST_CAPACITY);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    ingress_queue_destroy(result);
+}
+
+// Tests_SRS_INGRESS_QUEUE_10_004: [If any failure occurs, ingress_queue_create shall fail and return NULL]
+TEST_FUNCTION(ingress_queue_create_malloc_fails)
+{
+    size_t i;
+
+    for (i = 0; i < 2; i++)
+    {
+        // arrange
+        umock_c_reset_all_calls();
+        if (i == 0)
+        {
+            STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)).SetReturn(NULL);
+        }
+        else
+        {
+            STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+            STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG)).SetReturn(NULL);
+            STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        }
+
+        // act
+        INGRESS_QUEUE_HANDLE result = ingress_queue_create(TEST_CAPACITY);
+
+        // assert
+        ASSERT_IS_NULL(result);
+        ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    }
+}
+
+// Tests_SRS_INGRESS_QUEUE_10_005: [If `ingress_queue` is NULL, ingress_queue_destroy shall return]
+TEST_FUNCTION(ingress_queue_destroy_NULL_handle)
+{
+    // arrange
+
+    // act
+    ingress_queue_destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_INGRESS_QUEUE_10_006: [ingress_queue_destroy shall release the ring and the queue, and not the items still in it]
+TEST_FUNCTION(ingress_queue_destroy_releases_the_queue)
+{
+    // arrange
+    INGRESS_QUEUE_HANDLE ingress_queue = create_test_queue(TEST_CAPACITY);
+    ASSERT_ARE_EQUAL(int, 0, ingress_queue_push(ingress_queue, &test_items[0]));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(ingress_queue));
+
+    // act
+    ingress_queue_destroy(ingress_queue);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_INGRESS_QUEUE_10_007: [If `ingress_queue` or `item` are NULL, ingress_queue_push shall fail and return non-zero]
+TEST_FUNCTION(ingress_queue_push_NULL_arguments_fail)
+{
+    // arrange
+    INGRESS_QUEUE_HANDLE ingress_queue = create_test_queue(TEST_CAPACITY);
+
+    // act
+    int result1 = ingress_queue_push(NULL, &test_items[0]);
+    int result2 = ingress_queue_push(ingress_queue, NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result1);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result2);
+    ASSERT_IS_TRUE(ingress_queue_is_empty(ingress_queue));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    ingress_queue_destroy(ingress_queue);
+}
+
+// Tests_SRS_INGRESS_QUEUE_10_008: [ingress_queue_push shall claim the next position with a compare and swap, without taking a lock, retrying when another producer claimed it first]
+// Tests_SRS_INGRESS_QUEUE_10_009: [ingress_queue_push shall store `item` in the cell of the claimed position and then publish it to the consumer, and return 0]
+// Tests_SRS_INGRESS_QUEUE_10_013: [ingress_queue_pop shall take the item at the head of the queue, free its cell for the position one lap ahead and return the item]
+TEST_FUNCTION(ingress_queue_pop_returns_items_in_push_order)
+{
+    // arrange
+    INGRESS_QUEUE_HANDLE ingress_queue = create_test_queue(TEST_CAPACITY);
+    size_t i;
+
+    for (i = 0; i < 3; i++)
+    {
+        ASSERT_ARE_EQUAL(int, 0, ingress_queue_push(ingress_queue, &test_items[i]));
+    }
+
+    // act
+    void* result1 = ingress_queue_pop(ingress_queue);
+    void* result2 = ingress_queue_pop(ingress_queue);
+    void* result3 = ingress_queue_pop(ingress_queue);
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, &test_items[0], result1);
+    ASSERT_ARE_EQUAL(void_ptr, &test_items[1], result2);
+    ASSERT_ARE_EQUAL(void_ptr, &test_items[2], result3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    ingress_queue_destroy(ingress_queue);
+}
+
+// Tests_SRS_INGRESS_QUEUE_10_010: [If the cell of the next position still holds an item that was not popped, ingress_queue_push shall fail and return non-zero]
+TEST_FUNCTION(ingress_queue_push_full_fails)
+{
+    // arrange
+    INGRESS_QUEUE_HANDLE ingress_queue = create_test_queue(TEST_CAPACITY);
+    size_t i;
+
+    for (i = 0; i < TEST_RING_SIZE; i++)
+    {
+        ASSERT_ARE_EQUAL(int, 0, ingress_queue_push(ingress_queue, &test_items[i]));
+    }
+
+    // act
+    int result = ingress_queue_push(ingress_queue, &test_items[TEST_RING_SIZE]);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(void_ptr, &test_items[0], ingress_queue_pop(ingress_queue));
+    ASSERT_ARE_EQUAL(int, 0, ingress_queue_push(ingress_queue, &test_items[TEST_RING_SIZE]));
+
+    // cleanup
+    ingress_queue_destroy(ingress_queue);
+}
+
+// Tests_SRS_INGRESS_QUEUE_10_013: [ingress_queue_pop shall take the item at the head of the queue, free its cell for the position one lap ahead and return the item]
+TEST_FUNCTION(ingress_queue_push_and_pop_wrap_around_the_ring)
+{
+    // arrange
+    INGRESS_QUEUE_HANDLE ingress_queue = create_test_queue(TEST_CAPACITY);
+    size_t i;
+
+    // act
+    for (i = 0; i < TEST_ITEM_COUNT; i++)
+    {
+        ASSERT_ARE_EQUAL(int, 0, ingress_queue_push(ingress_queue, &test_items[i]));
+        if (i >= 2)
+        {
+            // assert
+            ASSERT_ARE_EQUAL(void_ptr, &test_items[i - 2], ingress_queue_pop(ingress_queue));
+        }
+    }
+
+    // assert
+    ASSERT_ARE_EQUAL(void_ptr, &test_items[TEST_ITEM_COUNT - 2], ingress_queue_pop(ingress_queue));
+    ASSERT_ARE_EQUAL(void_ptr, &test_items[TEST_ITEM_COUNT - 1], ingress_queue_pop(ingress_queue));
+    ASSERT_IS_NULL(ingress_queue_pop(ingress_queue));
+
+    // cleanup
+    ingress_queue_destroy(ingress_queue);
+}
+
+// Tests_SRS_INGRESS_QUEUE_10_011: [If `ingress_queue` is NULL, ingress_queue_pop shall return NULL]
+TEST_FUNCTION(ingress_queue_pop_NULL_handle_returns_NULL)
+{
+    // arrange
+
+    // act
+    void* result = ingress_queue_pop(NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_INGRESS_QUEUE_10_012: [If the item at the head of the queue was not published yet, ingress_queue_pop shall return NULL]
+TEST_FUNCTION(ingress_queue_pop_empty_returns_NULL)
+{
+    // arrange
+    INGRESS_QUEUE_HANDLE ingress_queue = create_test_queue(TEST_CAPACITY);
+    ASSERT_ARE_EQUAL(int, 0, ingress_queue_push(ingress_queue, &test_items[0]));
+    (void)ingress_queue_pop(ingress_queue);
+
+    // act
+    void* result = ingress_queue_pop(ingress_queue);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    ingress_queue_destroy(ingress_queue);
+}
+
+// Tests_SRS_INGRESS_QUEUE_10_014: [If `ingress_queue` is NULL, ingress_queue_is_empty shall return true]
+TEST_FUNCTION(ingress_queue_is_empty_NULL_handle_returns_true)
+{
+    // arrange
+
+    // act
+    bool result = ingress_queue_is_empty(NULL);
+
+    // assert
+    ASSERT_IS_TRUE(result);
+}
+
+// Tests_SRS_INGRESS_QUEUE_10_015: [ingress_queue_is_empty shall return false if the item at the head of the queue was published, true otherwise]
+TEST_FUNCTION(ingress_queue_is_empty_succeeds)
+{
+    // arrange
+    INGRESS_QUEUE_HANDLE ingress_queue = create_test_queue(TEST_CAPACITY);
+
+    // act
+    bool result1 = ingress_queue_is_empty(ingress_queue);
+    ASSERT_ARE_EQUAL(int, 0, ingress_queue_push(ingress_queue, &test_items[0]));
+    bool result2 = ingress_queue_is_empty(ingress_queue);
+    (void)ingress_queue_pop(ingress_queue);
+    bool result3 = ingress_queue_is_empty(ingress_queue);
+
+    // assert
+    ASSERT_IS_TRUE(result1);
+    ASSERT_IS_FALSE(result2);
+    ASSERT_IS_TRUE(result3);
+
+    // cleanup
+    ingress_queue_destroy(ingress_queue);
+}
+
+END_TEST_SUITE(ingress_queue_ut)
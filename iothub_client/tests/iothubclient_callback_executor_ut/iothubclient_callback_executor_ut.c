@@ -0,0 +1,521 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/singlylinkedlist.h"
+
+MOCKABLE_FUNCTION(, void, test_task, void*, context);
+#undef ENABLE_MOCKS
+
+#include "iothub_client_callback_executor.h"
+
+static TEST_MUTEX_HANDLE test_serialize_mutex;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+static LOCK_HANDLE TEST_LOCK_HANDLE = (LOCK_HANDLE)0x2101;
+static COND_HANDLE TEST_COND_HANDLE = (COND_HANDLE)0x2102;
+static SINGLYLINKEDLIST_HANDLE TEST_SLL_HANDLE = (SINGLYLINKEDLIST_HANDLE)0x2103;
+static LIST_ITEM_HANDLE TEST_LIST_ITEM_HANDLE = (LIST_ITEM_HANDLE)0x2104;
+static THREAD_HANDLE TEST_THREAD_HANDLE = (THREAD_HANDLE)0x2105;
+static void* TEST_CONTEXT = (void*)0x2106;
+
+static THREAD_START_FUNC g_thread_func;
+static void* g_thread_func_arg;
+static const void* g_first_added_item;
+
+static THREADAPI_RESULT my_ThreadAPI_Create(THREAD_HANDLE* threadHandle, THREAD_START_FUNC func, void* arg)
+{
+    *threadHandle = TEST_THREAD_HANDLE;
+    g_thread_func = func;
+    g_thread_func_arg = arg;
+    return THREADAPI_OK;
+}
+
+static LIST_ITEM_HANDLE my_singlylinkedlist_add(SINGLYLINKEDLIST_HANDLE list, const void* item)
+{
+    (void)list;
+    if (g_first_added_item == NULL)
+    {
+        g_first_added_item = item;
+    }
+    return TEST_LIST_ITEM_HANDLE;
+}
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+BEGIN_TEST_SUITE(iothubclient_callback_executor_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+
+    test_serialize_mutex = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(test_serialize_mutex);
+
+    umock_c_init(on_umock_c_error);
+
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREADAPI_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(SINGLYLINKEDLIST_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LIST_ITEM_HANDLE, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Init, TEST_COND_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Condition_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Post, COND_OK);
+
+    REGISTER_GLOBAL_MOCK_RETURN(singlylinkedlist_create, TEST_SLL_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(singlylinkedlist_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_add, my_singlylinkedlist_add);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(singlylinkedlist_add, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(singlylinkedlist_get_head_item, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(singlylinkedlist_remove, 0);
+
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(ThreadAPI_Create, THREADAPI_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(ThreadAPI_Join, THREADAPI_OK);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(test_serialize_mutex);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    TEST_MUTEX_ACQUIRE(test_serialize_mutex);
+    umock_c_reset_all_calls();
+
+    g_thread_func = NULL;
+    g_thread_func_arg = NULL;
+    g_first_added_item = NULL;
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(test_serialize_mutex);
+}
+
+static void setup_create_executor_with_one_thread(void)
+{
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(singlylinkedlist_create());
+    EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+}
+
+/* Tests_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_001: [ If threadCount is 0, IoTHubClientCallbackExecutor_Create shall return NULL. ]*/
+TEST_FUNCTION(IoTHubClientCallbackExecutor_Create_threadCount_0_fail)
+{
+    // arrange
+
+    // act
+    IOTHUB_CLIENT_CALLBACK_EXECUTOR_HANDLE result = IoTHubClientCallbackExecutor_Create(0, true);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_002: [ IoTHubClientCallbackExecutor_Create shall create a lock, two conditions, a ready client list and threadCount threads. ]*/
+TEST_FUNCTION(IoTHubClientCallbackExecutor_Create_succeed)
+{
+    // arrange
+    setup_create_executor_with_one_thread();
+
+    // act
+    IOTHUB_CLIENT_CALLBACK_EXECUTOR_HANDLE result = IoTHubClientCallbackExecutor_Create(1, true);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_IS_NOT_NULL(g_thread_func);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientCallbackExecutor_Destroy(result);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_003: [ If any resource cannot be created, IoTHubClientCallbackExecutor_Create shall free everything it created and return NULL. ]*/
+TEST_FUNCTION(IoTHubClientCallbackExecutor_Create_fail)
+{
+    // arrange
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    setup_create_executor_with_one_thread();
+
+    umock_c_negative_tests_snapshot();
+
+    // act
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubClientCallbackExecutor_Create failure in test %zu/%zu", index, count);
+        IOTHUB_CLIENT_CALLBACK_EXECUTOR_HANDLE result = IoTHubClientCallbackExecutor_Create(1, true);
+
+        // assert
+        ASSERT_IS_NULL_WITH_MSG(result, tmp_msg);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+/* Tests_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_004: [ If executorHandle is NULL, IoTHubClientCallbackExecutor_Destroy shall do nothing. ]*/
+TEST_FUNCTION(IoTHubClientCallbackExecutor_Destroy_handle_NULL_does_nothing)
+{
+    // arrange
+
+    // act
+    IoTHubClientCallbackExecutor_Destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_005: [ IoTHubClientCallbackExecutor_Destroy shall signal the threads to stop, join them and free all resources. ]*/
+TEST_FUNCTION(IoTHubClientCallbackExecutor_Destroy_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_CALLBACK_EXECUTOR_HANDLE executor = IoTHubClientCallbackExecutor_Create(1, true);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(ThreadAPI_Join(TEST_THREAD_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE));
+    STRICT_EXPECTED_CALL(singlylinkedlist_destroy(TEST_SLL_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Deinit(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Deinit(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    IoTHubClientCallbackExecutor_Destroy(executor);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_006: [ If executorHandle is NULL, IoTHubClientCallbackExecutor_AddClient shall return NULL. ]*/
+TEST_FUNCTION(IoTHubClientCallbackExecutor_AddClient_executor_handle_NULL_fail)
+{
+    // arrange
+
+    // act
+    IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT_HANDLE result = IoTHubClientCallbackExecutor_AddClient(NULL);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_007: [ IoTHubClientCallbackExecutor_AddClient shall create an empty task list for the client. ]*/
+TEST_FUNCTION(IoTHubClientCallbackExecutor_AddClient_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_CALLBACK_EXECUTOR_HANDLE executor = IoTHubClientCallbackExecutor_Create(1, true);
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_create());
+
+    // act
+    IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT_HANDLE result = IoTHubClientCallbackExecutor_AddClient(executor);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientCallbackExecutor_RemoveClient(result);
+    IoTHubClientCallbackExecutor_Destroy(executor);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_008: [ If allocating fails, IoTHubClientCallbackExecutor_AddClient shall return NULL. ]*/
+TEST_FUNCTION(IoTHubClientCallbackExecutor_AddClient_fail)
+{
+    // arrange
+    IOTHUB_CLIENT_CALLBACK_EXECUTOR_HANDLE executor = IoTHubClientCallbackExecutor_Create(1, true);
+    umock_c_reset_all_calls();
+
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_create());
+
+    umock_c_negative_tests_snapshot();
+
+    // act
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubClientCallbackExecutor_AddClient failure in test %zu/%zu", index, count);
+        IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT_HANDLE result = IoTHubClientCallbackExecutor_AddClient(executor);
+
+        // assert
+        ASSERT_IS_NULL_WITH_MSG(result, tmp_msg);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+    IoTHubClientCallbackExecutor_Destroy(executor);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_009: [ If clientHandle is NULL, IoTHubClientCallbackExecutor_RemoveClient shall do nothing. ]*/
+TEST_FUNCTION(IoTHubClientCallbackExecutor_RemoveClient_handle_NULL_does_nothing)
+{
+    // arrange
+
+    // act
+    IoTHubClientCallbackExecutor_RemoveClient(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_010: [ IoTHubClientCallbackExecutor_RemoveClient shall stop the threads from starting tasks of the client and wait for its running tasks to return. ]*/
+TEST_FUNCTION(IoTHubClientCallbackExecutor_RemoveClient_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_CALLBACK_EXECUTOR_HANDLE executor = IoTHubClientCallbackExecutor_Create(1, true);
+    IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT_HANDLE client = IoTHubClientCallbackExecutor_AddClient(executor);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE));
+    STRICT_EXPECTED_CALL(singlylinkedlist_destroy(TEST_SLL_HANDLE));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    IoTHubClientCallbackExecutor_RemoveClient(client);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientCallbackExecutor_Destroy(executor);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_010: [ IoTHubClientCallbackExecutor_RemoveClient shall stop the threads from starting tasks of the client and wait for its running tasks to return. ]*/
+/* Tests_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_011: [ IoTHubClientCallbackExecutor_RemoveClient shall run the tasks of the client that did not start yet on the calling thread, in the order they were posted, and free the client. ]*/
+TEST_FUNCTION(IoTHubClientCallbackExecutor_RemoveClient_runs_pending_tasks)
+{
+    // arrange
+    IOTHUB_CLIENT_CALLBACK_EXECUTOR_HANDLE executor = IoTHubClientCallbackExecutor_Create(1, true);
+    IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT_HANDLE client = IoTHubClientCallbackExecutor_AddClient(executor);
+    (void)IoTHubClientCallbackExecutor_Post(client, test_task, TEST_CONTEXT);
+    ASSERT_IS_NOT_NULL(g_first_added_item);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_SLL_HANDLE, TEST_LIST_ITEM_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE))
+        .SetReturn(TEST_LIST_ITEM_HANDLE);
+    STRICT_EXPECTED_CALL(singlylinkedlist_item_get_value(TEST_LIST_ITEM_HANDLE))
+        .SetReturn(g_first_added_item);
+    STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_SLL_HANDLE, TEST_LIST_ITEM_HANDLE));
+    STRICT_EXPECTED_CALL(test_task(TEST_CONTEXT));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_SLL_HANDLE));
+    STRICT_EXPECTED_CALL(singlylinkedlist_destroy(TEST_SLL_HANDLE));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    IoTHubClientCallbackExecutor_RemoveClient(client);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientCallbackExecutor_Destroy(executor);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_012: [ If clientHandle or task are NULL, IoTHubClientCallbackExecutor_Post shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(IoTHubClientCallbackExecutor_Post_client_handle_NULL_fail)
+{
+    // arrange
+
+    // act
+    int result = IoTHubClientCallbackExecutor_Post(NULL, test_task, TEST_CONTEXT);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_012: [ If clientHandle or task are NULL, IoTHubClientCallbackExecutor_Post shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(IoTHubClientCallbackExecutor_Post_task_NULL_fail)
+{
+    // arrange
+    IOTHUB_CLIENT_CALLBACK_EXECUTOR_HANDLE executor = IoTHubClientCallbackExecutor_Create(1, true);
+    IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT_HANDLE client = IoTHubClientCallbackExecutor_AddClient(executor);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = IoTHubClientCallbackExecutor_Post(client, NULL, TEST_CONTEXT);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientCallbackExecutor_RemoveClient(client);
+    IoTHubClientCallbackExecutor_Destroy(executor);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_013: [ IoTHubClientCallbackExecutor_Post shall append the task to the client's task list, mark the client as ready and signal the threads. ]*/
+TEST_FUNCTION(IoTHubClientCallbackExecutor_Post_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_CALLBACK_EXECUTOR_HANDLE executor = IoTHubClientCallbackExecutor_Create(1, true);
+    IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT_HANDLE client = IoTHubClientCallbackExecutor_AddClient(executor);
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(singlylinkedlist_add(TEST_SLL_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_add(TEST_SLL_HANDLE, client));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    int result = IoTHubClientCallbackExecutor_Post(client, test_task, TEST_CONTEXT);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientCallbackExecutor_RemoveClient(client);
+    free((void*)g_first_added_item);
+    IoTHubClientCallbackExecutor_Destroy(executor);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_CALLBACK_EXECUTOR_10_019: [ If allocating, locking or queuing fails, or the client is being removed, IoTHubClientCallbackExecutor_Post shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(IoTHubClientCallbackExecutor_Post_fail)
+{
+    // arrange
+    IOTHUB_CLIENT_CALLBACK_EXECUTOR_HANDLE executor = IoTHubClientCallbackExecutor_Create(1, true);
+    IOTHUB_CLIENT_CALLBACK_EXECUTOR_CLIENT_HANDLE client = IoTHubClientCallbackExecutor_AddClient(executor);
+    umock_c_reset_all_calls();
+
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(singlylinkedlist_add(TEST_SLL_HANDLE, IGNORED_PTR_ARG));
+
+    umock_c_negative_tests_snapshot();
+
+    // act
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubClientCallbackExecutor_Post failure in test %zu/%zu", index, count);
+        int result = IoTHubClientCallbackExecutor_Post(client, test_task, TEST_CONTEXT);
+
+        // assert
+        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, result, tmp_msg);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+    IoTHubClientCallbackExecutor_RemoveClient(client);
+    IoTHubClientCallbackExecutor_Destroy(executor);
+}
+
+TEST_FUNCTION(IoTHubClientCallbackExecutor_thread_exits_when_lock_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_CALLBACK_EXECUTOR_HANDLE executor = IoTHubClientCallbackExecutor_Create(1, true);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE))
+        .SetReturn(LOCK_ERROR);
+    STRICT_EXPECTED_CALL(ThreadAPI_Exit(0));
+
+    // act
+    ASSERT_IS_NOT_NULL(g_thread_func);
+    (void)g_thread_func(g_thread_func_arg);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientCallbackExecutor_Destroy(executor);
+}
+
+END_TEST_SUITE(iothubclient_callback_executor_ut)
@@ -0,0 +1,149 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/*this measures the throughput and the peak memory of queueing large telemetry messages, either with
+IoTHubClient_LL_SendEventAsync (the client clones the message) or with IoTHubClient_LL_SendEventAsyncTakeOwnership
+(the client keeps the message it was given). Peak RSS is per process, so run each mode in its own process:
+
+    iothubclient_ll_send_perf clone
+    iothubclient_ll_send_perf take
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#ifdef AZIOT_LINUX
+#include <sys/resource.h>
+#endif
+
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/platform.h"
+#include "iothub_client_ll.h"
+#include "iothub_message.h"
+#include "iothub_perf_transport.h"
+
+#define MESSAGE_SIZE (64 * 1024)
+#define MESSAGE_COUNT 20000
+#define MESSAGES_PER_DO_WORK 100
+
+static unsigned char message_payload[MESSAGE_SIZE];
+
+static void SendConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* userContextCallback)
+{
+    if (result == IOTHUB_CLIENT_CONFIRMATION_OK)
+    {
+        (*(size_t*)userContextCallback)++;
+    }
+}
+
+static long get_peak_rss_in_kb(void)
+{
+#ifdef AZIOT_LINUX
+    struct rusage usage;
+    return (getrusage(RUSAGE_SELF, &usage) == 0) ? usage.ru_maxrss : -1;
+#else
+    return -1;
+#endif
+}
+
+static int run_sends(bool takeOwnership)
+{
+    int result;
+    IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle;
+
+    if ((iotHubClientHandle = perf_transport_create_client()) == NULL)
+    {
+        LogError("IoTHubClient_LL_Create failed");
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t confirmed = 0;
+        size_t i;
+        clock_t start = clock();
+
+        result = 0;
+        for (i = 0; i < MESSAGE_COUNT; i++)
+        {
+            IOTHUB_MESSAGE_HANDLE messageHandle;
+            if ((messageHandle = IoTHubMessage_CreateFromByteArray(message_payload, sizeof(message_payload))) == NULL)
+            {
+                LogError("unable to create message %lu", (unsigned long)i);
+                result = __FAILURE__;
+                break;
+            }
+            else if (takeOwnership)
+            {
+                if (IoTHubClient_LL_SendEventAsyncTakeOwnership(iotHubClientHandle, messageHandle, SendConfirmationCallback, &confirmed) != IOTHUB_CLIENT_OK)
+                {
+                    LogError("unable to send message %lu", (unsigned long)i);
+                    IoTHubMessage_Destroy(messageHandle);
+                    result = __FAILURE__;
+                    break;
+                }
+            }
+            else
+            {
+                if (IoTHubClient_LL_SendEventAsync(iotHubClientHandle, messageHandle, SendConfirmationCallback, &confirmed) != IOTHUB_CLIENT_OK)
+                {
+                    LogError("unable to send message %lu", (unsigned long)i);
+                    result = __FAILURE__;
+                }
+                IoTHubMessage_Destroy(messageHandle);
+
+                if (result != 0)
+                {
+                    break;
+                }
+            }
+
+            if ((i + 1) % MESSAGES_PER_DO_WORK == 0)
+            {
+                IoTHubClient_LL_DoWork(iotHubClientHandle);
+            }
+        }
+        IoTHubClient_LL_DoWork(iotHubClientHandle);
+
+        if (result == 0)
+        {
+            double elapsedInSeconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+            (void)printf("%s: %lu messages of %d bytes confirmed, %.0f messages/s, peak RSS %ld KB\r\n",
+                takeOwnership ? "IoTHubClient_LL_SendEventAsyncTakeOwnership" : "IoTHubClient_LL_SendEventAsync",
+                (unsigned long)confirmed, MESSAGE_SIZE, (elapsedInSeconds > 0) ? confirmed / elapsedInSeconds : 0.0, get_peak_rss_in_kb());
+        }
+
+        IoTHubClient_LL_Destroy(iotHubClientHandle);
+    }
+
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    int result;
+
+    if ((argc != 2) || ((strcmp(argv[1], "clone") != 0) && (strcmp(argv[1], "take") != 0)))
+    {
+        (void)printf("usage: %s clone|take\r\n", argv[0]);
+        result = __FAILURE__;
+    }
+    else if (platform_init() != 0)
+    {
+        LogError("platform_init failed");
+        result = __FAILURE__;
+    }
+    else
+    {
+        (void)memset(message_payload, 'x', sizeof(message_payload));
+        perf_transport_set_send_enabled(true);
+
+        result = run_sends(strcmp(argv[1], "take") == 0);
+
+        platform_deinit();
+    }
+
+    return result;
+}
@@ -0,0 +1,129 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/*this measures the cost of IoTHubClient_LL_DoWork while messages pile up in waitingToSend, for example
+during a network outage. The perf transport does not send anything by default, so every DoWork call only
+pays for the client's own bookkeeping (message timeouts, deadlines).*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/platform.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "iothub_client_ll.h"
+#include "iothub_client_options.h"
+#include "iothub_message.h"
+#include "iothub_perf_transport.h"
+
+#define DO_WORK_CALLS 1000
+#define MESSAGE_TIMEOUT_IN_MS ((tickcounter_ms_t)60 * 60 * 1000)
+
+static const size_t BACKLOG_SIZES[] = { 1000, 10000, 50000 };
+static const unsigned char MESSAGE_PAYLOAD[] = "{\"temperature\":21.5}";
+
+static void SendConfirmationCallback(IOTHUB_CLIENT_CONFIRMATION_RESULT result, void* userContextCallback)
+{
+    (void)result;
+    (void)userContextCallback;
+}
+
+static int run_backlog(size_t backlogSize)
+{
+    int result;
+    IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle;
+
+    if ((iotHubClientHandle = perf_transport_create_client()) == NULL)
+    {
+        LogError("IoTHubClient_LL_Create failed");
+        result = __FAILURE__;
+    }
+    else
+    {
+        tickcounter_ms_t messageTimeout = MESSAGE_TIMEOUT_IN_MS;
+        size_t i;
+
+        if (IoTHubClient_LL_SetOption(iotHubClientHandle, OPTION_MESSAGE_TIMEOUT, &messageTimeout) != IOTHUB_CLIENT_OK)
+        {
+            LogError("unable to set messageTimeout");
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = 0;
+            for (i = 0; i < backlogSize; i++)
+            {
+                IOTHUB_MESSAGE_HANDLE messageHandle;
+                if ((messageHandle = IoTHubMessage_CreateFromByteArray(MESSAGE_PAYLOAD, sizeof(MESSAGE_PAYLOAD) - 1)) == NULL)
+                {
+                    LogError("unable to create message %lu", (unsigned long)i);
+                    result = __FAILURE__;
+                    break;
+                }
+                else
+                {
+                    if (IoTHubClient_LL_SendEventAsync(iotHubClientHandle, messageHandle, SendConfirmationCallback, NULL) != IOTHUB_CLIENT_OK)
+                    {
+                        LogError("unable to send message %lu", (unsigned long)i);
+                        result = __FAILURE__;
+                    }
+                    /*the client keeps a clone of the message*/
+                    IoTHubMessage_Destroy(messageHandle);
+
+                    if (result != 0)
+                    {
+                        break;
+                    }
+                }
+            }
+
+            if (result == 0)
+            {
+                clock_t start = clock();
+                double elapsedInUs;
+                for (i = 0; i < DO_WORK_CALLS; i++)
+                {
+                    IoTHubClient_LL_DoWork(iotHubClientHandle);
+                }
+                elapsedInUs = (double)(clock() - start) * 1000000.0 / CLOCKS_PER_SEC;
+
+                (void)printf("backlog %6lu messages: %10.3f us per IoTHubClient_LL_DoWork (%d calls)\r\n", (unsigned long)backlogSize, elapsedInUs / DO_WORK_CALLS, DO_WORK_CALLS);
+            }
+        }
+
+        /*pending messages are completed with IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY*/
+        IoTHubClient_LL_Destroy(iotHubClientHandle);
+    }
+
+    return result;
+}
+
+int main(void)
+{
+    int result;
+
+    if (platform_init() != 0)
+    {
+        LogError("platform_init failed");
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t i;
+        result = 0;
+        for (i = 0; i < sizeof(BACKLOG_SIZES) / sizeof(BACKLOG_SIZES[0]); i++)
+        {
+            if (run_backlog(BACKLOG_SIZES[i]) != 0)
+            {
+                result = __FAILURE__;
+                break;
+            }
+        }
+
+        platform_deinit();
+    }
+
+    return result;
+}
@@ -47,6 +47,7 @@ void* my_gballoc_realloc(void* ptr, size_t size)
 #include "iothub_message.h"
 #include "iothub_client_authorization.h"
 #include "iothub_client_diagnostic.h"
+#include "message_store.h"
 
 #undef ENABLE_MOCKS
 
@@ -82,6 +83,7 @@ MOCKABLE_FUNCTION(, void, FAKE_IoTHubTransport_Unsubscribe, IOTHUB_DEVICE_HANDLE
 MOCKABLE_FUNCTION(, void, FAKE_IoTHubTransport_DoWork, TRANSPORT_LL_HANDLE, handle, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle);
 MOCKABLE_FUNCTION(, int, FAKE_IoTHubTransport_SetRetryPolicy, TRANSPORT_LL_HANDLE, handle, IOTHUB_CLIENT_RETRY_POLICY, retryPolicy, size_t, retryTimeoutLimitInSeconds);
 MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, FAKE_IoTHubTransport_GetSendStatus, IOTHUB_DEVICE_HANDLE, handle, IOTHUB_CLIENT_STATUS*, iotHubClientStatus);
+MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, FAKE_IoTHubTransport_GetNextWorkDeadline, TRANSPORT_LL_HANDLE, handle, uint64_t*, msToNextWork);
 MOCKABLE_FUNCTION(, int, FAKE_IoTHubTransport_Subscribe_DeviceTwin, IOTHUB_DEVICE_HANDLE, handle);
 MOCKABLE_FUNCTION(, void, FAKE_IoTHubTransport_Unsubscribe_DeviceTwin, IOTHUB_DEVICE_HANDLE, handle);
 MOCKABLE_FUNCTION(, IOTHUB_CLIENT_RESULT, FAKE_IoTHubTransport_SendMessageDisposition, MESSAGE_CALLBACK_INFO*, messageData, IOTHUBMESSAGE_DISPOSITION_RESULT, disposition);
@@ -90,6 +92,7 @@ MOCKABLE_FUNCTION(, IOTHUB_PROCESS_ITEM_RESULT, FAKE_IoTHubTransport_ProcessItem
 MOCKABLE_FUNCTION(, int, FAKE_IoTHubTransport_Subscribe_DeviceMethod, IOTHUB_DEVICE_HANDLE, handle);
 MOCKABLE_FUNCTION(, void, FAKE_IoTHubTransport_Unsubscribe_DeviceMethod, IOTHUB_DEVICE_HANDLE, handle);
 MOCKABLE_FUNCTION(, void, connectionStatusCallback, IOTHUB_CLIENT_CONNECTION_STATUS, result3, IOTHUB_CLIENT_CONNECTION_STATUS_REASON, reason, void*, userContextCallback);
+MOCKABLE_FUNCTION(, void, sendQueueCallback, IOTHUB_CLIENT_SEND_QUEUE_STATE, state, void*, userContextCallback);
 MOCKABLE_FUNCTION(, IOTHUBMESSAGE_DISPOSITION_RESULT, messageCallback, IOTHUB_MESSAGE_HANDLE, message, void*, userContextCallback);
 MOCKABLE_FUNCTION(, bool, messageCallbackEx, MESSAGE_CALLBACK_INFO*, messageData, void*, userContextCallback);
 MOCKABLE_FUNCTION(, void, eventConfirmationCallback, IOTHUB_CLIENT_CONFIRMATION_RESULT, result2, void*, userContextCallback);
@@ -124,6 +127,9 @@ IMPLEMENT_UMOCK_C_ENUM_TYPE(IOTHUB_CLIENT_CONNECTION_STATUS_REASON, IOTHUB_CLIEN
 TEST_DEFINE_ENUM_TYPE(IOTHUB_CLIENT_RETRY_POLICY, IOTHUB_CLIENT_RETRY_POLICY_VALUES);
 IMPLEMENT_UMOCK_C_ENUM_TYPE(IOTHUB_CLIENT_RETRY_POLICY, IOTHUB_CLIENT_RETRY_POLICY_VALUES);
 
+TEST_DEFINE_ENUM_TYPE(IOTHUB_CLIENT_SEND_QUEUE_STATE, IOTHUB_CLIENT_SEND_QUEUE_STATE_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(IOTHUB_CLIENT_SEND_QUEUE_STATE, IOTHUB_CLIENT_SEND_QUEUE_STATE_VALUES);
+
 static TEST_MUTEX_HANDLE test_serialize_mutex;
 static TEST_MUTEX_HANDLE g_dllByDll;
 
@@ -171,6 +177,7 @@ static const char* TEST_STRING_VALUE = "Test string value";
 
 #define TEST_METHOD_ID                      (METHOD_HANDLE)0x61
 #define TEST_IOTHUB_AUTH_HANDLE        (IOTHUB_AUTHORIZATION_HANDLE)0x62
+#define TEST_MESSAGE_STORE_HANDLE           (MESSAGE_STORE_HANDLE)0x63
 
 static const char* TEST_PROV_URI = "global.azure-devices-provisioning.net";
 
@@ -376,12 +383,24 @@ static void my_IoTHubClient_LL_UploadToBlob_Destroy(IOTHUB_CLIENT_LL_UPLOADTOBLO
 }
 #endif
 
+static const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT TEST_MESSAGE_SEGMENTS[] = { { (const unsigned char*)"abcd", 4 }, { (const unsigned char*)"ef", 2 } };
+
+static IOTHUB_MESSAGE_RESULT my_IoTHubMessage_GetByteArraySegments(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT** segments, size_t* segmentCount)
+{
+    (void)iotHubMessageHandle;
+    *segments = TEST_MESSAGE_SEGMENTS;
+    *segmentCount = sizeof(TEST_MESSAGE_SEGMENTS) / sizeof(TEST_MESSAGE_SEGMENTS[0]);
+    return IOTHUB_MESSAGE_OK;
+}
+
+static PDLIST_ENTRY g_waitingToSend;
+
 static IOTHUB_DEVICE_HANDLE my_FAKE_IoTHubTransport_Register(TRANSPORT_LL_HANDLE handle, const IOTHUB_DEVICE_CONFIG* device, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, PDLIST_ENTRY waitingToSend)
 {
     (void)handle;
     (void)device;
     (void)iotHubClientHandle;
-    (void)waitingToSend;
+    g_waitingToSend = waitingToSend;
     return (IOTHUB_DEVICE_HANDLE)my_gballoc_malloc(1);
 }
 
@@ -397,6 +416,31 @@ static IOTHUB_CLIENT_RESULT my_FAKE_IoTHubTransport_GetSendStatus(TRANSPORT_LL_H
     return IOTHUB_CLIENT_OK;
 }
 
+static uint64_t g_message_store_next_sequence_number;
+static bool g_message_store_is_empty;
+
+static MESSAGE_STORE_RESULT my_message_store_append(MESSAGE_STORE_HANDLE message_store, IOTHUB_MESSAGE_HANDLE message, uint64_t* sequence_number)
+{
+    (void)message_store;
+    (void)message;
+    *sequence_number = g_message_store_next_sequence_number++;
+    return MESSAGE_STORE_OK;
+}
+
+static int my_message_store_is_empty(MESSAGE_STORE_HANDLE message_store, bool* is_empty)
+{
+    (void)message_store;
+    *is_empty = g_message_store_is_empty;
+    return 0;
+}
+
+static IOTHUB_CLIENT_RESULT my_FAKE_IoTHubTransport_GetNextWorkDeadline(TRANSPORT_LL_HANDLE handle, uint64_t* msToNextWork)
+{
+    (void)handle;
+    *msToNextWork = IOTHUB_CLIENT_LL_NO_WORK_DEADLINE;
+    return IOTHUB_CLIENT_OK;
+}
+
 static int my_FAKE_IoTHubTransport_SetRetryPolicy(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_RETRY_POLICY retryPolicy, size_t retryTimeoutLimitInSeconds)
 {
     (void)handle;
@@ -454,7 +498,8 @@ static TRANSPORT_PROVIDER FAKE_transport_provider =
     FAKE_IoTHubTransport_Unsubscribe,   /*pfIoTHubTransport_Unsubscribe IoTHubTransport_Unsubscribe;    */
     FAKE_IoTHubTransport_DoWork,        /*pfIoTHubTransport_DoWork IoTHubTransport_DoWork;              */
     FAKE_IoTHubTransport_SetRetryPolicy,/*pfIoTHubTransport_SetRetryPolicy IoTHubTransport_SetRetryPolicy;*/
-    FAKE_IoTHubTransport_GetSendStatus  /*pfIoTHubTransport_GetSendStatus IoTHubTransport_GetSendStatus;*/
+    FAKE_IoTHubTransport_GetSendStatus, /*pfIoTHubTransport_GetSendStatus IoTHubTransport_GetSendStatus;*/
+    FAKE_IoTHubTransport_GetNextWorkDeadline /*pfIoTHubTransport_GetNextWorkDeadline IoTHubTransport_GetNextWorkDeadline;*/
 };
 
 static const TRANSPORT_PROVIDER* provideFAKE(void)
@@ -567,6 +612,12 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_CONNECTION_STATUS, int);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_CONNECTION_STATUS_REASON, int);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_RETRY_POLICY, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_SEND_QUEUE_STATE, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUBMESSAGE_CONTENT_TYPE, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_PRIORITY, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_STORE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_STORE_RESULT, int);
 
 #ifndef DONT_USE_UPLOADTOBLOB
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_LL_UPLOADTOBLOB_HANDLE, void*);
@@ -595,6 +646,8 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(FAKE_IoTHubTransport_SetRetryPolicy, __FAILURE__);
     REGISTER_GLOBAL_MOCK_HOOK(FAKE_IoTHubTransport_GetSendStatus, my_FAKE_IoTHubTransport_GetSendStatus);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(FAKE_IoTHubTransport_GetSendStatus, IOTHUB_CLIENT_ERROR);
+    REGISTER_GLOBAL_MOCK_HOOK(FAKE_IoTHubTransport_GetNextWorkDeadline, my_FAKE_IoTHubTransport_GetNextWorkDeadline);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(FAKE_IoTHubTransport_GetNextWorkDeadline, IOTHUB_CLIENT_ERROR);
     REGISTER_GLOBAL_MOCK_RETURN(FAKE_IoTHubTransport_Subscribe_DeviceMethod, 0);
 
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(FAKE_IoTHubTransport_Subscribe_DeviceMethod, __FAILURE__);
@@ -617,10 +670,28 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_CreateFromString, (IOTHUB_MESSAGE_HANDLE)0x44);
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_Clone, (IOTHUB_MESSAGE_HANDLE)0x44);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_Clone, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_GetContentType, IOTHUBMESSAGE_BYTEARRAY);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_GetContentType, IOTHUBMESSAGE_UNKNOWN);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_GetPriority, IOTHUB_MESSAGE_PRIORITY_NORMAL);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetByteArraySegments, my_IoTHubMessage_GetByteArraySegments);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_GetByteArraySegments, IOTHUB_MESSAGE_ERROR);
 
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubClient_Diagnostic_AddIfNecessary, 0);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClient_Diagnostic_AddIfNecessary, 100);
 
+    REGISTER_GLOBAL_MOCK_RETURN(message_store_create, TEST_MESSAGE_STORE_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(message_store_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(message_store_append, my_message_store_append);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(message_store_append, MESSAGE_STORE_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(message_store_read_next, MESSAGE_STORE_EMPTY);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(message_store_read_next, MESSAGE_STORE_ERROR);
+    REGISTER_GLOBAL_MOCK_HOOK(message_store_is_empty, my_message_store_is_empty);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(message_store_is_empty, __FAILURE__);
+    REGISTER_GLOBAL_MOCK_RETURN(message_store_acknowledge, 0);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(message_store_acknowledge, __FAILURE__);
+    REGISTER_GLOBAL_MOCK_RETURN(message_store_flush, 0);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(message_store_flush, __FAILURE__);
+
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_Auth_CreateFromDeviceAuth, my_IoTHubClient_Auth_CreateFromDeviceAuth);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClient_Auth_CreateFromDeviceAuth, NULL);
 
@@ -695,6 +766,9 @@ TEST_FUNCTION_INITIALIZE(method_init)
     g_fail_string_construct_sprintf = false;
     g_fail_platform_get_platform_info = false;
     g_fail_string_concat_with_string = false;
+    g_waitingToSend = NULL;
+    g_message_store_next_sequence_number = 0;
+    g_message_store_is_empty = true;
 }
 
 TEST_FUNCTION_CLEANUP(TestMethodCleanup)
@@ -1781,6 +1855,7 @@ TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_succeeds)
     IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
     umock_c_reset_all_calls();
 
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPriority(TEST_MESSAGE_HANDLE));
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
         .IgnoreArgument(1);
 
@@ -1847,6 +1922,100 @@ TEST_FUNCTION(IoTHubClient_LL_Destroy_after_sendEvent_succeeds)
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
 }
 
+/*Tests_SRS_IOTHUBCLIENT_LL_10_045: [ IoTHubClient_LL_SendEventAsyncTakeOwnership shall add eventMessageHandle itself to waitingToSend instead of a clone. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsyncTakeOwnership_succeeds)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPriority(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(IoTHubClient_Diagnostic_AddIfNecessary(IGNORED_PTR_ARG, TEST_MESSAGE_HANDLE))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsyncTakeOwnership(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_045: [ IoTHubClient_LL_SendEventAsyncTakeOwnership shall add eventMessageHandle itself to waitingToSend instead of a clone. ]*/
+TEST_FUNCTION(IoTHubClient_LL_Destroy_after_SendEventAsyncTakeOwnership_destroys_the_message)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SendEventAsyncTakeOwnership(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Unregister(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Destroy(IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, (void*)1));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_destroy(IGNORED_PTR_ARG));
+
+#ifndef DONT_USE_UPLOADTOBLOB
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_UploadToBlob_Destroy(IGNORED_PTR_ARG));
+#endif
+
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubClient_LL_Destroy(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_046: [ If IoTHubClient_LL_SendEventAsyncTakeOwnership fails, eventMessageHandle shall still be owned by the caller. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsyncTakeOwnership_fails_does_not_destroy_the_message)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPriority(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+
+    STRICT_EXPECTED_CALL(IoTHubClient_Diagnostic_AddIfNecessary(IGNORED_PTR_ARG, TEST_MESSAGE_HANDLE))
+        .IgnoreArgument(1)
+        .SetReturn(100);
+
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsyncTakeOwnership(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
 /*Tests_SRS_IOTHUBCLIENT_LL_02_014: [If cloning and/or adding the information fails for any reason, IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_ERROR.] */
 TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_fails)
 {
@@ -1859,6 +2028,7 @@ TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_fails)
     (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &thisIsNotZero); /*this forces _SendEventAsync to query the currentTime. If that fails, _SendEvent should fail as well*/
     umock_c_reset_all_calls();
 
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPriority(TEST_MESSAGE_HANDLE));
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
         .IgnoreArgument(1);
 
@@ -1880,7 +2050,7 @@ TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_fails)
     umock_c_negative_tests_snapshot();
 
     // act
-    size_t calls_cannot_fail[] = { 4 };
+    size_t calls_cannot_fail[] = { 0, 5 };
     size_t count = umock_c_negative_tests_call_count();
     for (size_t index = 0; index < count; index++)
     {
@@ -3141,6 +3311,170 @@ TEST_FUNCTION(IoTHubClient_LL_GetSendStatus_HasEventToSend_Succeeds)
     IoTHubClient_LL_Destroy(handle);
 }
 
+/*Tests_SRS_IOTHUBCLIENT_LL_10_038: [ If iotHubClientHandle or msToNextWork are NULL, IoTHubClient_LL_GetNextWorkDeadline shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetNextWorkDeadline_with_NULL_handle_fails)
+{
+    // arrange
+    uint64_t msToNextWork;
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetNextWorkDeadline(NULL, &msToNextWork);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_038: [ If iotHubClientHandle or msToNextWork are NULL, IoTHubClient_LL_GetNextWorkDeadline shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetNextWorkDeadline_with_NULL_msToNextWork_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetNextWorkDeadline(handle, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+
+    // cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_039: [ IoTHubClient_LL_GetNextWorkDeadline shall call the underlying layer's _GetNextWorkDeadline function. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_042: [ Otherwise msToNextWork shall be set to the smaller of the transport deadline and the time until the first message in waitingToSend times out. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetNextWorkDeadline_returns_transport_deadline)
+{
+    // arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    uint64_t transport_ms = 1234;
+    uint64_t msToNextWork;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_GetNextWorkDeadline(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer_msToNextWork(&transport_ms, sizeof(transport_ms));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetNextWorkDeadline(handle, &msToNextWork);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(uint64_t, transport_ms, msToNextWork);
+
+    // cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_042: [ Otherwise msToNextWork shall be set to the smaller of the transport deadline and the time until the first message in waitingToSend times out. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetNextWorkDeadline_returns_message_timeout_when_earlier)
+{
+    // arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    tickcounter_ms_t hundred = 100;
+    tickcounter_ms_t ten = 10;
+    tickcounter_ms_t hundredFive = 105;
+    uint64_t transport_ms = 1000;
+    uint64_t msToNextWork;
+    (void)IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_TIMEOUT, &hundred);
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer_current_ms(&ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_GetNextWorkDeadline(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer_msToNextWork(&transport_ms, sizeof(transport_ms));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer_current_ms(&hundredFive, sizeof(hundredFive));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetNextWorkDeadline(handle, &msToNextWork);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    /*the message times out once the tick count goes past 10 + 100*/
+    ASSERT_ARE_EQUAL(uint64_t, 6, msToNextWork);
+
+    // cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_079: [ msToNextWork shall be no later than 10 ms while events wait for their confirmation, and no later than 100 ms while a message, method or device twin callback is set. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetNextWorkDeadline_is_bounded_while_an_event_waits_for_its_confirmation)
+{
+    // arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    uint64_t transport_ms = 1000;
+    uint64_t msToNextWork;
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_GetNextWorkDeadline(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer_msToNextWork(&transport_ms, sizeof(transport_ms));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetNextWorkDeadline(handle, &msToNextWork);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(uint64_t, 10, msToNextWork);
+
+    // cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_079: [ msToNextWork shall be no later than 10 ms while events wait for their confirmation, and no later than 100 ms while a message, method or device twin callback is set. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetNextWorkDeadline_is_bounded_while_a_message_callback_is_set)
+{
+    // arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    uint64_t transport_ms = 1000;
+    uint64_t msToNextWork;
+    (void)IoTHubClient_LL_SetMessageCallback(handle, messageCallback, (void*)1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_GetNextWorkDeadline(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer_msToNextWork(&transport_ms, sizeof(transport_ms));
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetNextWorkDeadline(handle, &msToNextWork);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(uint64_t, 100, msToNextWork);
+
+    // cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_040: [ If the underlying layer's _GetNextWorkDeadline fails, IoTHubClient_LL_GetNextWorkDeadline shall return its result. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetNextWorkDeadline_transport_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    uint64_t msToNextWork;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_GetNextWorkDeadline(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(IOTHUB_CLIENT_ERROR);
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetNextWorkDeadline(handle, &msToNextWork);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+
+    // cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
 /*Tests_SRS_IOTHUBCLIENT_LL_02_034: [If iotHubClientHandle is NULL then IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.]*/
 TEST_FUNCTION(IoTHubClient_LL_SetOption_with_NULL_handle_fails)
 {
@@ -3662,6 +3996,48 @@ TEST_FUNCTION(IoTHubClient_LL_SetOption_2_messages_with_timeouts_at_11_and_12_ca
     IoTHubClient_LL_Destroy(handle);
 }
 
+/*Tests_SRS_IOTHUBCLIENT_LL_10_044: [ If messageTimeout is decreased so that a newer message times out before an older one of the same priority, the next check shall look at every message of that priority in waitingToSend and time out each message whose timeout has passed. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_decreased_messageTimeout_times_out_the_newer_message_first)
+{
+    //arrange
+
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    tickcounter_ms_t five = 5;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &five);
+
+    /*the first message expires at 15, the second one (sent after the timeout was decreased) at 11*/
+    tickcounter_ms_t ten = 10;
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+
+    tickcounter_ms_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)(TEST_DEVICEMESSAGE_HANDLE_2));
+    umock_c_reset_all_calls();
+
+    tickcounter_ms_t twelve = 12;
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &twelve, sizeof(twelve));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)(TEST_DEVICEMESSAGE_HANDLE_2)));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    //act
+    IoTHubClient_LL_DoWork(handle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
 /*Tests_SRS_IOTHUBCLIENT_LL_02_039: [ "messageTimeout" - once IoTHubClient_LL_SendEventAsync is called the message shall timeout after value miliseconds. Value is a pointer to a tickcounter_ms_t. ]*/
 /*Tests_SRS_IOTHUBCLIENT_LL_02_041: [ If more than value miliseconds have passed since the call to IoTHubClient_LL_SendEventAsync then the message callback shall be called with a status code of IOTHUB_CLIENT_CONFIRMATION_TIMEOUT. ]*/
 /*Tests_SRS_IOTHUBCLIENT_LL_02_043: [ Calling IoTHubClient_LL_SetOption with value set to "0" shall disable the timeout mechanism for all new messages. ]*/
@@ -5014,4 +5390,1449 @@ TEST_FUNCTION(IoTHubClient_LL_SetOption_diag_sampling_percentage_fails)
 }
 
 
+static void set_send_queue_limits(IOTHUB_CLIENT_LL_HANDLE handle, size_t maxMessageCount, size_t maxBytes, unsigned int highWatermarkPercentage, unsigned int lowWatermarkPercentage, IOTHUB_CLIENT_SEND_QUEUE_POLICY policy)
+{
+    IOTHUB_CLIENT_SEND_QUEUE_LIMITS limits;
+    limits.maxMessageCount = maxMessageCount;
+    limits.maxBytes = maxBytes;
+    limits.highWatermarkPercentage = highWatermarkPercentage;
+    limits.lowWatermarkPercentage = lowWatermarkPercentage;
+    limits.policy = policy;
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubClient_LL_SetOption(handle, OPTION_SEND_QUEUE_LIMITS, &limits));
+}
+
+static void setup_clone_message_mocks(void)
+{
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubClient_Diagnostic_AddIfNecessary(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+}
+
+static void setup_send_event_async_mocks(void)
+{
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    setup_clone_message_mocks();
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_053: [ IoTHubClient_LL_SetSendQueueCallback shall return IOTHUB_CLIENT_INVALID_ARG if called with NULL parameter iotHubClientHandle. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetSendQueueCallback_with_NULL_iotHubClientHandle_fails)
+{
+    ///arrange
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetSendQueueCallback(NULL, sendQueueCallback, (void*)1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_054: [ IoTHubClient_LL_SetSendQueueCallback shall save sendQueueCallback and userContextCallback and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetSendQueueCallback_succeeds)
+{
+    ///arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetSendQueueCallback(handle, sendQueueCallback, (void*)1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_055: [ Calling IoTHubClient_LL_SetOption with "send_queue_limits" shall return IOTHUB_CLIENT_ERROR if highWatermarkPercentage is greater than 100, lowWatermarkPercentage is greater than highWatermarkPercentage or policy is not a known value. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_send_queue_limits_low_above_high_watermark_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_SEND_QUEUE_LIMITS limits;
+    limits.maxMessageCount = 10;
+    limits.maxBytes = 0;
+    limits.highWatermarkPercentage = 50;
+    limits.lowWatermarkPercentage = 60;
+    limits.policy = IOTHUB_CLIENT_SEND_QUEUE_REJECT_NEW;
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_SEND_QUEUE_LIMITS, &limits);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_055: [ Calling IoTHubClient_LL_SetOption with "send_queue_limits" shall return IOTHUB_CLIENT_ERROR if highWatermarkPercentage is greater than 100, lowWatermarkPercentage is greater than highWatermarkPercentage or policy is not a known value. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_send_queue_limits_high_watermark_above_100_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_SEND_QUEUE_LIMITS limits;
+    limits.maxMessageCount = 10;
+    limits.maxBytes = 0;
+    limits.highWatermarkPercentage = 101;
+    limits.lowWatermarkPercentage = 50;
+    limits.policy = IOTHUB_CLIENT_SEND_QUEUE_REJECT_NEW;
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_SEND_QUEUE_LIMITS, &limits);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_056: [ Otherwise, "send_queue_limits" shall replace the send queue limits and apply them to all new messages; messages already queued are kept. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_send_queue_limits_succeeds)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_SEND_QUEUE_LIMITS limits;
+    limits.maxMessageCount = 10;
+    limits.maxBytes = 1024;
+    limits.highWatermarkPercentage = 80;
+    limits.lowWatermarkPercentage = 20;
+    limits.policy = IOTHUB_CLIENT_SEND_QUEUE_DROP_OLDEST;
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_SEND_QUEUE_LIMITS, &limits);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_048: [ If the policy is IOTHUB_CLIENT_SEND_QUEUE_REJECT_NEW and adding the message would exceed maxMessageCount or maxBytes, IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_QUEUE_FULL. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_above_maxMessageCount_returns_QUEUE_FULL)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    set_send_queue_limits(handle, 1, 0, 0, 0, IOTHUB_CLIENT_SEND_QUEUE_REJECT_NEW);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)2);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_QUEUE_FULL, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_047: [ If a byte limit is set for the send queue, IoTHubClient_LL_SendEventAsync shall get the size of the body of eventMessageHandle, and fail with IOTHUB_CLIENT_ERROR if that fails. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_maxBytes_counts_all_the_segments)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    set_send_queue_limits(handle, 0, 6, 0, 0, IOTHUB_CLIENT_SEND_QUEUE_REJECT_NEW);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPriority(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    setup_send_event_async_mocks();
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_048: [ If the policy is IOTHUB_CLIENT_SEND_QUEUE_REJECT_NEW and adding the message would exceed maxMessageCount or maxBytes, IoTHubClient_LL_SendEventAsync shall fail and return IOTHUB_CLIENT_QUEUE_FULL. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_message_larger_than_maxBytes_returns_QUEUE_FULL)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    set_send_queue_limits(handle, 0, 5, 0, 0, IOTHUB_CLIENT_SEND_QUEUE_DROP_OLDEST);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPriority(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_QUEUE_FULL, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_047: [ If a byte limit is set for the send queue, IoTHubClient_LL_SendEventAsync shall get the size of the body of eventMessageHandle, and fail with IOTHUB_CLIENT_ERROR if that fails. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_maxBytes_fails_when_the_size_is_unknown)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    set_send_queue_limits(handle, 0, 100, 0, 0, IOTHUB_CLIENT_SEND_QUEUE_REJECT_NEW);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPriority(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_MESSAGE_HANDLE))
+        .SetReturn(IOTHUBMESSAGE_UNKNOWN);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_049: [ If the policy is IOTHUB_CLIENT_SEND_QUEUE_DROP_OLDEST, IoTHubClient_LL_SendEventAsync shall complete the oldest messages in waitingToSend with IOTHUB_CLIENT_CONFIRMATION_QUEUE_FULL until the new message fits, and fail with IOTHUB_CLIENT_QUEUE_FULL if it does not fit even after all of them are dropped. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_DROP_OLDEST_completes_the_oldest_message)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    set_send_queue_limits(handle, 1, 0, 0, 0, IOTHUB_CLIENT_SEND_QUEUE_DROP_OLDEST);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPriority(TEST_MESSAGE_HANDLE));
+    setup_send_event_async_mocks();
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_QUEUE_FULL, (void*)1));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)2);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_049: [ If the policy is IOTHUB_CLIENT_SEND_QUEUE_DROP_OLDEST, IoTHubClient_LL_SendEventAsync shall complete the oldest messages in waitingToSend with IOTHUB_CLIENT_CONFIRMATION_QUEUE_FULL until the new message fits, and fail with IOTHUB_CLIENT_QUEUE_FULL if it does not fit even after all of them are dropped. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_DROP_OLDEST_does_not_drop_when_the_clone_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    set_send_queue_limits(handle, 1, 0, 0, 0, IOTHUB_CLIENT_SEND_QUEUE_DROP_OLDEST);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPriority(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)2);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_051: [ When the number of messages or bytes in the send queue reaches highWatermarkPercentage of its limit, the send queue callback shall be called with IOTHUB_CLIENT_SEND_QUEUE_HIGH_WATERMARK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_reaching_the_high_watermark_calls_the_send_queue_callback)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    set_send_queue_limits(handle, 4, 0, 50, 25, IOTHUB_CLIENT_SEND_QUEUE_REJECT_NEW);
+    (void)IoTHubClient_LL_SetSendQueueCallback(handle, sendQueueCallback, (void*)3);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPriority(TEST_MESSAGE_HANDLE));
+    setup_send_event_async_mocks();
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(sendQueueCallback(IOTHUB_CLIENT_SEND_QUEUE_HIGH_WATERMARK, (void*)3));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)2);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_052: [ After the high watermark was reported, when both the number of messages and bytes in the send queue are at or below lowWatermarkPercentage of their limits, the send queue callback shall be called with IOTHUB_CLIENT_SEND_QUEUE_LOW_WATERMARK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_draining_to_the_low_watermark_calls_the_send_queue_callback)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    tickcounter_ms_t one = 1;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+    set_send_queue_limits(handle, 1, 0, 100, 0, IOTHUB_CLIENT_SEND_QUEUE_REJECT_NEW);
+    (void)IoTHubClient_LL_SetSendQueueCallback(handle, sendQueueCallback, (void*)3);
+
+    tickcounter_ms_t ten = 10;
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &ten, sizeof(ten));
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_DEVICEMESSAGE_HANDLE, test_event_confirmation_callback, (void*)TEST_DEVICEMESSAGE_HANDLE);
+    umock_c_reset_all_calls();
+
+    tickcounter_ms_t twelve = 12;
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &twelve, sizeof(twelve));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, (void*)TEST_DEVICEMESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(sendQueueCallback(IOTHUB_CLIENT_SEND_QUEUE_LOW_WATERMARK, (void*)3));
+    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    //act
+    IoTHubClient_LL_DoWork(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_050: [ The send queue shall count every message accepted by IoTHubClient_LL_SendEventAsync until its confirmation callback is called, including messages already handed to the transport. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_makes_room_in_the_send_queue)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    DLIST_ENTRY temp;
+    PDLIST_ENTRY sent;
+    set_send_queue_limits(handle, 1, 0, 0, 0, IOTHUB_CLIENT_SEND_QUEUE_REJECT_NEW);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_QUEUE_FULL, IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)2));
+
+    /*this is what the transport does: it moves the message out of waitingToSend and later completes it*/
+    DList_InitializeListHead(&temp);
+    sent = DList_RemoveHeadList(g_waitingToSend);
+    DList_InsertTailList(&temp, sent);
+    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_OK);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPriority(TEST_MESSAGE_HANDLE));
+    setup_send_event_async_mocks();
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)2);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_050: [ The send queue shall count every message accepted by IoTHubClient_LL_SendEventAsync until its confirmation callback is called, including messages already handed to the transport. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_052: [ After the high watermark was reported, when both the number of messages and bytes in the send queue are at or below lowWatermarkPercentage of their limits, the send queue callback shall be called with IOTHUB_CLIENT_SEND_QUEUE_LOW_WATERMARK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_of_one_message_at_a_time_drains_the_send_queue)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    DLIST_ENTRY temp[2];
+    size_t i;
+    set_send_queue_limits(handle, 2, 0, 100, 50, IOTHUB_CLIENT_SEND_QUEUE_REJECT_NEW);
+    (void)IoTHubClient_LL_SetSendQueueCallback(handle, sendQueueCallback, (void*)3);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)2);
+
+    /*this is what AMQP does: each message is completed on its own, in a list of one*/
+    for (i = 0; i < 2; i++)
+    {
+        DList_InitializeListHead(&temp[i]);
+        DList_InsertTailList(&temp[i], DList_RemoveHeadList(g_waitingToSend));
+    }
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(&temp[0]));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)1));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(&temp[0]));
+    STRICT_EXPECTED_CALL(sendQueueCallback(IOTHUB_CLIENT_SEND_QUEUE_LOW_WATERMARK, (void*)3));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(&temp[1]));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)2));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(&temp[1]));
+
+    //act
+    IoTHubClient_LL_SendComplete(handle, &temp[0], IOTHUB_CLIENT_CONFIRMATION_OK);
+    IoTHubClient_LL_SendComplete(handle, &temp[1], IOTHUB_CLIENT_CONFIRMATION_OK);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    /*the queue is empty again, so it takes two messages*/
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)4));
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)5));
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+static void set_message_store(IOTHUB_CLIENT_LL_HANDLE handle, size_t maxInFlightMessages)
+{
+    IOTHUB_CLIENT_MESSAGE_STORE_CONFIG config;
+    config.directory = "store";
+    config.maxSegmentSize = 0;
+    config.maxStoreSize = 0;
+    config.maxInFlightMessages = maxInFlightMessages;
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_STORE, &config));
+}
+
+static void setup_load_stored_message_mocks(IOTHUB_MESSAGE_HANDLE* message, uint64_t* sequenceNumber)
+{
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(message_store_read_next(TEST_MESSAGE_STORE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer_message(message, sizeof(*message))
+        .CopyOutArgumentBuffer_sequence_number(sequenceNumber, sizeof(*sequenceNumber))
+        .SetReturn(MESSAGE_STORE_OK);
+    STRICT_EXPECTED_CALL(IoTHubClient_Diagnostic_AddIfNecessary(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPriority(*message));
+}
+
+static void setup_load_stored_messages_end_mocks(void)
+{
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(message_store_read_next(TEST_MESSAGE_STORE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+}
+
+/*loads the first stored event in waitingToSend, with maxInFlightMessages set to 1*/
+static void load_one_stored_message(IOTHUB_CLIENT_LL_HANDLE handle)
+{
+    IOTHUB_MESSAGE_HANDLE message = TEST_DEVICEMESSAGE_HANDLE;
+    uint64_t sequenceNumber = 0;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    setup_load_stored_message_mocks(&message, &sequenceNumber);
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(message_store_flush(TEST_MESSAGE_STORE_HANDLE));
+
+    IoTHubClient_LL_DoWork(handle);
+
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    umock_c_reset_all_calls();
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_065: [ Calling IoTHubClient_LL_SetOption with "message_store" shall open the message store in directory by calling message_store_create, and return IOTHUB_CLIENT_ERROR if that fails. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_message_store_succeeds)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_MESSAGE_STORE_CONFIG config;
+    config.directory = "store";
+    config.maxSegmentSize = 4096;
+    config.maxStoreSize = 65536;
+    config.maxInFlightMessages = 0;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(message_store_create(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_STORE, &config);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_065: [ Calling IoTHubClient_LL_SetOption with "message_store" shall open the message store in directory by calling message_store_create, and return IOTHUB_CLIENT_ERROR if that fails. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_message_store_fails_when_the_store_cannot_be_opened)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_MESSAGE_STORE_CONFIG config;
+    config.directory = "store";
+    config.maxSegmentSize = 0;
+    config.maxStoreSize = 0;
+    config.maxInFlightMessages = 0;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(message_store_create(IGNORED_PTR_ARG))
+        .SetReturn(NULL);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_STORE, &config);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_066: [ Calling IoTHubClient_LL_SetOption with "message_store" when the message store is already set shall return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_message_store_twice_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_MESSAGE_STORE_CONFIG config;
+    config.directory = "store";
+    config.maxSegmentSize = 0;
+    config.maxStoreSize = 0;
+    config.maxInFlightMessages = 0;
+    set_message_store(handle, 0);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_MESSAGE_STORE, &config);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_057: [ If the message store is set, IoTHubClient_LL_SendEventAsync shall append eventMessageHandle to the store instead of adding it to waitingToSend, keep eventConfirmationCallback and userContextCallback in memory and return IOTHUB_CLIENT_OK; IoTHubClient_LL_SendEventAsyncTakeOwnership shall then destroy eventMessageHandle. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_message_store_appends_the_message_to_the_store)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    set_message_store(handle, 0);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(message_store_append(TEST_MESSAGE_STORE_HANDLE, TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_057: [ If the message store is set, IoTHubClient_LL_SendEventAsync shall append eventMessageHandle to the store instead of adding it to waitingToSend, keep eventConfirmationCallback and userContextCallback in memory and return IOTHUB_CLIENT_OK; IoTHubClient_LL_SendEventAsyncTakeOwnership shall then destroy eventMessageHandle. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsyncTakeOwnership_with_message_store_destroys_the_message)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    set_message_store(handle, 0);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(message_store_append(TEST_MESSAGE_STORE_HANDLE, TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(TEST_MESSAGE_HANDLE));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsyncTakeOwnership(handle, TEST_MESSAGE_HANDLE, NULL, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_058: [ If appending the event to the message store fails, IoTHubClient_LL_SendEventAsync shall return IOTHUB_CLIENT_QUEUE_FULL when the store is full and IOTHUB_CLIENT_ERROR otherwise. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_full_message_store_returns_QUEUE_FULL)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    set_message_store(handle, 0);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(message_store_append(TEST_MESSAGE_STORE_HANDLE, TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG))
+        .SetReturn(MESSAGE_STORE_FULL);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_QUEUE_FULL, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_058: [ If appending the event to the message store fails, IoTHubClient_LL_SendEventAsync shall return IOTHUB_CLIENT_QUEUE_FULL when the store is full and IOTHUB_CLIENT_ERROR otherwise. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_with_message_store_fails_when_append_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    set_message_store(handle, 0);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(message_store_append(TEST_MESSAGE_STORE_HANDLE, TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG))
+        .SetReturn(MESSAGE_STORE_ERROR);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsyncTakeOwnership(handle, TEST_MESSAGE_HANDLE, NULL, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_059: [ IoTHubClient_LL_DoWork shall move events from the message store to waitingToSend, in the order they were stored and with the confirmation callback they were sent with, while fewer than maxInFlightMessages events are waiting for a confirmation and the send queue limits are not reached. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_062: [ After the underlying layer's _DoWork, IoTHubClient_LL_DoWork shall flush the message store, committing the events stored and acknowledged since the previous call. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_loads_stored_messages)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_MESSAGE_HANDLE message = TEST_DEVICEMESSAGE_HANDLE;
+    uint64_t sequenceNumber = 0;
+    set_message_store(handle, 0);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    setup_load_stored_message_mocks(&message, &sequenceNumber);
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    setup_load_stored_messages_end_mocks();
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(message_store_flush(TEST_MESSAGE_STORE_HANDLE));
+
+    //act
+    IoTHubClient_LL_DoWork(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, TEST_DEVICEMESSAGE_HANDLE, containingRecord(g_waitingToSend->Flink, IOTHUB_MESSAGE_LIST, entry)->messageHandle);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)1, containingRecord(g_waitingToSend->Flink, IOTHUB_MESSAGE_LIST, entry)->context);
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_059: [ IoTHubClient_LL_DoWork shall move events from the message store to waitingToSend, in the order they were stored and with the confirmation callback they were sent with, while fewer than maxInFlightMessages events are waiting for a confirmation and the send queue limits are not reached. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_does_not_load_more_than_maxInFlightMessages)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    set_message_store(handle, 1);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, NULL, NULL);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, NULL, NULL);
+    load_one_stored_message(handle);
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(message_store_flush(TEST_MESSAGE_STORE_HANDLE));
+
+    //act
+    IoTHubClient_LL_DoWork(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_060: [ If the message store skipped events because they could not be read back, their confirmation callbacks shall be called with IOTHUB_CLIENT_CONFIRMATION_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_completes_stored_messages_that_were_skipped_with_ERROR)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_MESSAGE_HANDLE message = TEST_DEVICEMESSAGE_HANDLE;
+    uint64_t sequenceNumber = 1;
+    set_message_store(handle, 1);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)2);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    setup_load_stored_message_mocks(&message, &sequenceNumber);
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_ERROR, (void*)1));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(message_store_flush(TEST_MESSAGE_STORE_HANDLE));
+
+    //act
+    IoTHubClient_LL_DoWork(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, (void*)2, containingRecord(g_waitingToSend->Flink, IOTHUB_MESSAGE_LIST, entry)->context);
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_061: [ When an event loaded from the message store is confirmed with any result other than IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, it shall be acknowledged in the message store so that it is not sent again. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_acknowledges_stored_messages)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    DLIST_ENTRY temp;
+    set_message_store(handle, 1);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, NULL, NULL);
+    load_one_stored_message(handle);
+
+    DList_InitializeListHead(&temp);
+    DList_InsertTailList(&temp, DList_RemoveHeadList(g_waitingToSend));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(&temp));
+    STRICT_EXPECTED_CALL(message_store_acknowledge(TEST_MESSAGE_STORE_HANDLE, 0));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(TEST_DEVICEMESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(&temp));
+
+    //act
+    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_OK);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_061: [ When an event loaded from the message store is confirmed with any result other than IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, it shall be acknowledged in the message store so that it is not sent again. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_BECAUSE_DESTROY_keeps_stored_messages)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    DLIST_ENTRY temp;
+    set_message_store(handle, 1);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, NULL, NULL);
+    load_one_stored_message(handle);
+
+    DList_InitializeListHead(&temp);
+    DList_InsertTailList(&temp, DList_RemoveHeadList(g_waitingToSend));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(&temp));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(TEST_DEVICEMESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(&temp));
+
+    //act
+    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_059: [ IoTHubClient_LL_DoWork shall move events from the message store to waitingToSend, in the order they were stored and with the confirmation callback they were sent with, while fewer than maxInFlightMessages events are waiting for a confirmation and the send queue limits are not reached. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_061: [ When an event loaded from the message store is confirmed with any result other than IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, it shall be acknowledged in the message store so that it is not sent again. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_loads_more_stored_messages_after_one_is_completed_on_its_own)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_MESSAGE_HANDLE message = TEST_DEVICEMESSAGE_HANDLE;
+    uint64_t sequenceNumber = 1;
+    DLIST_ENTRY temp;
+    set_message_store(handle, 1);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, NULL, NULL);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, NULL, NULL);
+    load_one_stored_message(handle);
+
+    /*this is what AMQP does: the event is completed on its own, in a list of one*/
+    DList_InitializeListHead(&temp);
+    DList_InsertTailList(&temp, DList_RemoveHeadList(g_waitingToSend));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(&temp));
+    STRICT_EXPECTED_CALL(message_store_acknowledge(TEST_MESSAGE_STORE_HANDLE, 0));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(TEST_DEVICEMESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(&temp));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    setup_load_stored_message_mocks(&message, &sequenceNumber);
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(message_store_flush(TEST_MESSAGE_STORE_HANDLE));
+
+    //act
+    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_OK);
+    IoTHubClient_LL_DoWork(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_FALSE(DList_IsListEmpty(g_waitingToSend));
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_063: [ If the message store has events that were not loaded yet and there is room to load them, msToNextWork shall be set to 0. ]*/
+TEST_FUNCTION(IoTHubClient_LL_GetNextWorkDeadline_with_stored_messages_returns_0)
+{
+    // arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    uint64_t msToNextWork;
+    set_message_store(handle, 0);
+    g_message_store_is_empty = false;
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_GetNextWorkDeadline(handle, &msToNextWork);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(uint64_t, 0, msToNextWork);
+
+    // cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_064: [ IoTHubClient_LL_Destroy shall call the confirmation callbacks of the events still only in the message store with IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, leave the events in the store and destroy the store. ]*/
+TEST_FUNCTION(IoTHubClient_LL_Destroy_with_message_store_completes_stored_messages_with_BECAUSE_DESTROY)
+{
+    //arrange
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(TEST_HOSTNAME_VALUE);
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    set_message_store(handle, 0);
+    (void)IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Unregister(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_BECAUSE_DESTROY, (void*)1));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(message_store_destroy(TEST_MESSAGE_STORE_HANDLE));
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_destroy(IGNORED_PTR_ARG));
+
+#ifndef DONT_USE_UPLOADTOBLOB
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_UploadToBlob_Destroy(IGNORED_PTR_ARG));
+#endif
+
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubClient_LL_Destroy(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+static void send_event_with_priority(IOTHUB_CLIENT_LL_HANDLE handle, IOTHUB_MESSAGE_PRIORITY priority, void* context)
+{
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPriority(TEST_MESSAGE_HANDLE))
+        .SetReturn(priority);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, context));
+}
+
+/*returns the context of the message at position index in waitingToSend*/
+static void* get_waiting_to_send_context(size_t index)
+{
+    PDLIST_ENTRY entry = g_waitingToSend->Flink;
+    while (index > 0)
+    {
+        entry = entry->Flink;
+        index--;
+    }
+    return containingRecord(entry, IOTHUB_MESSAGE_LIST, entry)->context;
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_067: [ Events shall be inserted in waitingToSend so that transports, which send from its head, get events of a higher priority first while each priority gets a share of the events sent proportional to its weight; events of the same priority keep the order they were sent in. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_HIGH_priority_goes_before_NORMAL)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    send_event_with_priority(handle, IOTHUB_MESSAGE_PRIORITY_NORMAL, (void*)1);
+    send_event_with_priority(handle, IOTHUB_MESSAGE_PRIORITY_NORMAL, (void*)2);
+    send_event_with_priority(handle, IOTHUB_MESSAGE_PRIORITY_NORMAL, (void*)3);
+    umock_c_reset_all_calls();
+
+    //act
+    send_event_with_priority(handle, IOTHUB_MESSAGE_PRIORITY_HIGH, (void*)4);
+
+    //assert
+    /*the head is the next message the transport sends, nothing goes before it*/
+    ASSERT_ARE_EQUAL(void_ptr, (void*)1, get_waiting_to_send_context(0));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)4, get_waiting_to_send_context(1));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)2, get_waiting_to_send_context(2));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)3, get_waiting_to_send_context(3));
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_067: [ Events shall be inserted in waitingToSend so that transports, which send from its head, get events of a higher priority first while each priority gets a share of the events sent proportional to its weight; events of the same priority keep the order they were sent in. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_LOW_priority_gets_its_share)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    size_t index;
+    send_event_with_priority(handle, IOTHUB_MESSAGE_PRIORITY_LOW, (void*)1);
+    send_event_with_priority(handle, IOTHUB_MESSAGE_PRIORITY_LOW, (void*)2);
+    umock_c_reset_all_calls();
+
+    //act
+    for (index = 0; index < 20; index++)
+    {
+        send_event_with_priority(handle, IOTHUB_MESSAGE_PRIORITY_HIGH, (void*)(100 + index));
+    }
+
+    //assert
+    /*with the default weights 16 HIGH messages are sent for each LOW one*/
+    ASSERT_ARE_EQUAL(void_ptr, (void*)1, get_waiting_to_send_context(0));
+    for (index = 0; index < 15; index++)
+    {
+        ASSERT_ARE_EQUAL(void_ptr, (void*)(100 + index), get_waiting_to_send_context(1 + index));
+    }
+    ASSERT_ARE_EQUAL(void_ptr, (void*)2, get_waiting_to_send_context(16));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)115, get_waiting_to_send_context(17));
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+static void send_event_with_priority_at(IOTHUB_CLIENT_LL_HANDLE handle, IOTHUB_MESSAGE_PRIORITY priority, tickcounter_ms_t now, void* context)
+{
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &now, sizeof(now));
+    send_event_with_priority(handle, priority, context);
+}
+
+static void setup_message_timeout_mocks(void* context)
+{
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_MESSAGE_TIMEOUT, context));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_043: [ While the messages of a priority in waitingToSend that have a timeout are ordered by their timeout, checking for timed out messages of that priority shall stop at the first one that has not timed out, and checking waitingToSend shall stop once every priority is checked. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_times_out_the_messages_of_every_priority)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    tickcounter_ms_t one = 1;
+    tickcounter_ms_t five = 5;
+    tickcounter_ms_t twelve = 12;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+    send_event_with_priority_at(handle, IOTHUB_MESSAGE_PRIORITY_NORMAL, 10, (void*)1);
+    send_event_with_priority_at(handle, IOTHUB_MESSAGE_PRIORITY_NORMAL, 10, (void*)2);
+    /*the HIGH message goes ahead of an older NORMAL message that times out earlier*/
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &five);
+    send_event_with_priority_at(handle, IOTHUB_MESSAGE_PRIORITY_HIGH, 10, (void*)3);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)3, get_waiting_to_send_context(1));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &twelve, sizeof(twelve));
+    setup_message_timeout_mocks((void*)1);
+    setup_message_timeout_mocks((void*)2);
+    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    //act
+    IoTHubClient_LL_DoWork(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, (void*)3, get_waiting_to_send_context(0));
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_044: [ If messageTimeout is decreased so that a newer message times out before an older one of the same priority, the next check shall look at every message of that priority in waitingToSend and time out each message whose timeout has passed. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_decreased_messageTimeout_only_checks_every_message_of_that_priority)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    tickcounter_ms_t one = 1;
+    tickcounter_ms_t five = 5;
+    tickcounter_ms_t twelve = 12;
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &five);
+    send_event_with_priority_at(handle, IOTHUB_MESSAGE_PRIORITY_HIGH, 10, (void*)1);
+    (void)IoTHubClient_LL_SetOption(handle, "messageTimeout", &one);
+    send_event_with_priority_at(handle, IOTHUB_MESSAGE_PRIORITY_HIGH, 10, (void*)2);
+    send_event_with_priority_at(handle, IOTHUB_MESSAGE_PRIORITY_NORMAL, 10, (void*)3);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &twelve, sizeof(twelve));
+    setup_message_timeout_mocks((void*)2);
+    setup_message_timeout_mocks((void*)3);
+    EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllCalls();
+
+    //act
+    IoTHubClient_LL_DoWork(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, (void*)1, get_waiting_to_send_context(0));
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_069: [ Otherwise, "priority_weights" shall replace the weights of the message priorities for the events sent afterwards. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_priority_weights_succeeds)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_PRIORITY_WEIGHTS weights;
+    weights.high = 1;
+    weights.normal = 1;
+    weights.low = 1;
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_PRIORITY_WEIGHTS, &weights);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    /*with equal weights the priorities take turns*/
+    send_event_with_priority(handle, IOTHUB_MESSAGE_PRIORITY_NORMAL, (void*)1);
+    send_event_with_priority(handle, IOTHUB_MESSAGE_PRIORITY_NORMAL, (void*)2);
+    send_event_with_priority(handle, IOTHUB_MESSAGE_PRIORITY_HIGH, (void*)3);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)1, get_waiting_to_send_context(0));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)2, get_waiting_to_send_context(1));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)3, get_waiting_to_send_context(2));
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_068: [ Calling IoTHubClient_LL_SetOption with "priority_weights" shall return IOTHUB_CLIENT_ERROR if any weight is 0 or greater than 65536. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_priority_weights_with_invalid_weight_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_PRIORITY_WEIGHTS weights;
+    weights.high = 8;
+    weights.normal = 0;
+    weights.low = 1;
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_PRIORITY_WEIGHTS, &weights);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_068: [ Calling IoTHubClient_LL_SetOption with "priority_weights" shall return IOTHUB_CLIENT_ERROR if any weight is 0 or greater than 65536. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_priority_weights_with_too_large_weight_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_CLIENT_PRIORITY_WEIGHTS weights;
+    weights.high = 65537;
+    weights.normal = 4;
+    weights.low = 1;
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(handle, OPTION_PRIORITY_WEIGHTS, &weights);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_070: [ If the policy is IOTHUB_CLIENT_SEND_QUEUE_DROP_LOWEST_PRIORITY, IoTHubClient_LL_SendEventAsync shall complete the messages in waitingToSend with IOTHUB_CLIENT_CONFIRMATION_QUEUE_FULL, lowest priority first and oldest first within a priority, until the new message fits, never dropping a message of a higher priority than the new one, and fail with IOTHUB_CLIENT_QUEUE_FULL if it does not fit. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_DROP_LOWEST_PRIORITY_completes_the_lowest_priority_message)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    set_send_queue_limits(handle, 2, 0, 0, 0, IOTHUB_CLIENT_SEND_QUEUE_DROP_LOWEST_PRIORITY);
+    send_event_with_priority(handle, IOTHUB_MESSAGE_PRIORITY_NORMAL, (void*)1);
+    send_event_with_priority(handle, IOTHUB_MESSAGE_PRIORITY_LOW, (void*)2);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPriority(TEST_MESSAGE_HANDLE))
+        .SetReturn(IOTHUB_MESSAGE_PRIORITY_NORMAL);
+    setup_send_event_async_mocks();
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_QUEUE_FULL, (void*)2));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)3);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, (void*)1, get_waiting_to_send_context(0));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)3, get_waiting_to_send_context(1));
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_070: [ If the policy is IOTHUB_CLIENT_SEND_QUEUE_DROP_LOWEST_PRIORITY, IoTHubClient_LL_SendEventAsync shall complete the messages in waitingToSend with IOTHUB_CLIENT_CONFIRMATION_QUEUE_FULL, lowest priority first and oldest first within a priority, until the new message fits, never dropping a message of a higher priority than the new one, and fail with IOTHUB_CLIENT_QUEUE_FULL if it does not fit. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventAsync_DROP_LOWEST_PRIORITY_does_not_drop_higher_priority_messages)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    set_send_queue_limits(handle, 2, 0, 0, 0, IOTHUB_CLIENT_SEND_QUEUE_DROP_LOWEST_PRIORITY);
+    send_event_with_priority(handle, IOTHUB_MESSAGE_PRIORITY_HIGH, (void*)1);
+    send_event_with_priority(handle, IOTHUB_MESSAGE_PRIORITY_HIGH, (void*)2);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPriority(TEST_MESSAGE_HANDLE))
+        .SetReturn(IOTHUB_MESSAGE_PRIORITY_NORMAL);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventAsync(handle, TEST_MESSAGE_HANDLE, test_event_confirmation_callback, (void*)3);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_QUEUE_FULL, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_071: [ IoTHubClient_LL_SendEventBatchAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if iotHubClientHandle or eventMessageHandles is NULL, messageCount is 0, any of the messages is NULL, or eventConfirmationCallback is NULL and userContextCallback is not NULL. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventBatchAsync_with_NULL_iotHubClientHandle_fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE messages[2] = { TEST_MESSAGE_HANDLE, TEST_MESSAGE_HANDLE };
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventBatchAsync(NULL, messages, 2, test_event_confirmation_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_071: [ IoTHubClient_LL_SendEventBatchAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if iotHubClientHandle or eventMessageHandles is NULL, messageCount is 0, any of the messages is NULL, or eventConfirmationCallback is NULL and userContextCallback is not NULL. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventBatchAsync_with_0_messageCount_fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE messages[2] = { TEST_MESSAGE_HANDLE, TEST_MESSAGE_HANDLE };
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventBatchAsync(handle, messages, 0, test_event_confirmation_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_071: [ IoTHubClient_LL_SendEventBatchAsync shall fail and return IOTHUB_CLIENT_INVALID_ARG if iotHubClientHandle or eventMessageHandles is NULL, messageCount is 0, any of the messages is NULL, or eventConfirmationCallback is NULL and userContextCallback is not NULL. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventBatchAsync_with_a_NULL_message_fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE messages[2] = { TEST_MESSAGE_HANDLE, NULL };
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventBatchAsync(handle, messages, 2, test_event_confirmation_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_073: [ IoTHubClient_LL_SendEventBatchAsync shall allocate the entries of all the messages in one block, and fail with IOTHUB_CLIENT_ERROR if that fails. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_077: [ IoTHubClient_LL_SendEventBatchAsync shall clone every message and add the diagnostic information to it, and if any of that fails, destroy the clones made so far and fail with IOTHUB_CLIENT_ERROR. ]*/
+/*Tests_SRS_IOTHUBCLIENT_LL_10_078: [ IoTHubClient_LL_SendEventBatchAsync shall add the messages to waitingToSend next to each other and in the order of eventMessageHandles, as one event of the highest priority of the messages, each with eventConfirmationCallback and userContextCallback, and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventBatchAsync_succeeds)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE messages[2] = { TEST_MESSAGE_HANDLE, TEST_MESSAGE_HANDLE };
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    IOTHUB_MESSAGE_LIST* first;
+    IOTHUB_MESSAGE_LIST* second;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(2 * sizeof(IOTHUB_MESSAGE_LIST)));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPriority(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPriority(TEST_MESSAGE_HANDLE));
+    setup_clone_message_mocks();
+    setup_clone_message_mocks();
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventBatchAsync(handle, messages, 2, test_event_confirmation_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    first = containingRecord(g_waitingToSend->Flink, IOTHUB_MESSAGE_LIST, entry);
+    second = containingRecord(g_waitingToSend->Flink->Flink, IOTHUB_MESSAGE_LIST, entry);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)1, first->context);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)1, second->context);
+    ASSERT_ARE_EQUAL(void_ptr, first, second->batchBlock);
+    ASSERT_ARE_EQUAL(void_ptr, first + 1, second);
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_078: [ IoTHubClient_LL_SendEventBatchAsync shall add the messages to waitingToSend next to each other and in the order of eventMessageHandles, as one event of the highest priority of the messages, each with eventConfirmationCallback and userContextCallback, and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventBatchAsync_keeps_the_messages_together)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE messages[2] = { TEST_MESSAGE_HANDLE, TEST_MESSAGE_HANDLE };
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    send_event_with_priority(handle, IOTHUB_MESSAGE_PRIORITY_NORMAL, (void*)1);
+    send_event_with_priority(handle, IOTHUB_MESSAGE_PRIORITY_NORMAL, (void*)2);
+    send_event_with_priority(handle, IOTHUB_MESSAGE_PRIORITY_NORMAL, (void*)3);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPriority(TEST_MESSAGE_HANDLE))
+        .SetReturn(IOTHUB_MESSAGE_PRIORITY_LOW);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPriority(TEST_MESSAGE_HANDLE))
+        .SetReturn(IOTHUB_MESSAGE_PRIORITY_HIGH);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventBatchAsync(handle, messages, 2, test_event_confirmation_callback, (void*)4);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    /*the batch goes as one HIGH event, and is not split by the NORMAL ones*/
+    ASSERT_ARE_EQUAL(void_ptr, (void*)1, get_waiting_to_send_context(0));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)4, get_waiting_to_send_context(1));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)4, get_waiting_to_send_context(2));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)2, get_waiting_to_send_context(3));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)3, get_waiting_to_send_context(4));
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_073: [ IoTHubClient_LL_SendEventBatchAsync shall allocate the entries of all the messages in one block, and fail with IOTHUB_CLIENT_ERROR if that fails. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_frees_a_batch_with_its_last_message)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE messages[2] = { TEST_MESSAGE_HANDLE, TEST_MESSAGE_HANDLE };
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    DLIST_ENTRY temp;
+    (void)IoTHubClient_LL_SendEventBatchAsync(handle, messages, 2, test_event_confirmation_callback, (void*)1);
+    DList_InitializeListHead(&temp);
+    DList_InsertTailList(&temp, DList_RemoveHeadList(g_waitingToSend));
+    DList_InsertTailList(&temp, DList_RemoveHeadList(g_waitingToSend));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(&temp));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)1));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(&temp));
+    STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)1));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(&temp));
+
+    //act
+    IoTHubClient_LL_SendComplete(handle, &temp, IOTHUB_CLIENT_CONFIRMATION_OK);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_073: [ IoTHubClient_LL_SendEventBatchAsync shall allocate the entries of all the messages in one block, and fail with IOTHUB_CLIENT_ERROR if that fails. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendComplete_frees_a_batch_completed_one_message_at_a_time)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE messages[3] = { TEST_MESSAGE_HANDLE, TEST_MESSAGE_HANDLE, TEST_MESSAGE_HANDLE };
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    DLIST_ENTRY temp[3];
+    size_t i;
+    (void)IoTHubClient_LL_SendEventBatchAsync(handle, messages, 3, test_event_confirmation_callback, (void*)1);
+    for (i = 0; i < 3; i++)
+    {
+        DList_InitializeListHead(&temp[i]);
+        DList_InsertTailList(&temp[i], DList_RemoveHeadList(g_waitingToSend));
+    }
+    umock_c_reset_all_calls();
+
+    /*this is what AMQP does: each message is completed on its own, in a list of one*/
+    for (i = 0; i < 3; i++)
+    {
+        STRICT_EXPECTED_CALL(DList_RemoveHeadList(&temp[i]));
+        STRICT_EXPECTED_CALL(test_event_confirmation_callback(IOTHUB_CLIENT_CONFIRMATION_OK, (void*)1));
+        STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+        if (i == 2)
+        {
+            STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+        }
+        STRICT_EXPECTED_CALL(DList_RemoveHeadList(&temp[i]));
+    }
+
+    //act
+    for (i = 0; i < 3; i++)
+    {
+        IoTHubClient_LL_SendComplete(handle, &temp[i], IOTHUB_CLIENT_CONFIRMATION_OK);
+    }
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_075: [ IoTHubClient_LL_SendEventBatchAsync shall apply the send queue limits and policy to all the messages at once, and fail with IOTHUB_CLIENT_QUEUE_FULL if they do not all fit. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventBatchAsync_returns_QUEUE_FULL_when_the_messages_do_not_all_fit)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE messages[3] = { TEST_MESSAGE_HANDLE, TEST_MESSAGE_HANDLE, TEST_MESSAGE_HANDLE };
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    set_send_queue_limits(handle, 2, 0, 0, 0, IOTHUB_CLIENT_SEND_QUEUE_REJECT_NEW);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPriority(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPriority(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPriority(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventBatchAsync(handle, messages, 3, test_event_confirmation_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_QUEUE_FULL, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(DList_IsListEmpty(g_waitingToSend));
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_077: [ IoTHubClient_LL_SendEventBatchAsync shall clone every message and add the diagnostic information to it, and if any of that fails, destroy the clones made so far and fail with IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventBatchAsync_when_a_clone_fails_destroys_the_other_clones)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE messages[2] = { TEST_MESSAGE_HANDLE, TEST_MESSAGE_HANDLE };
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPriority(TEST_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetPriority(TEST_MESSAGE_HANDLE));
+    setup_clone_message_mocks();
+    STRICT_EXPECTED_CALL(IoTHubMessage_Clone(TEST_MESSAGE_HANDLE))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(IoTHubMessage_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventBatchAsync(handle, messages, 2, test_event_confirmation_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(DList_IsListEmpty(g_waitingToSend));
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_10_072: [ If the message store is set, IoTHubClient_LL_SendEventBatchAsync shall append the messages to the store in order, as IoTHubClient_LL_SendEventAsync does, and stop at the first one that fails and return its result; the messages before it stay queued. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendEventBatchAsync_with_message_store_appends_the_messages)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE messages[2] = { TEST_MESSAGE_HANDLE, TEST_MESSAGE_HANDLE };
+    IOTHUB_CLIENT_LL_HANDLE handle = IoTHubClient_LL_Create(&TEST_CONFIG);
+    set_message_store(handle, 0);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(message_store_append(TEST_MESSAGE_STORE_HANDLE, TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(message_store_append(TEST_MESSAGE_STORE_HANDLE, TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG))
+        .SetReturn(MESSAGE_STORE_FULL);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendEventBatchAsync(handle, messages, 2, test_event_confirmation_callback, (void*)1);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_QUEUE_FULL, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(handle);
+}
+
 END_TEST_SUITE(iothubclient_ll_ut)
@@ -0,0 +1,549 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#endif
+#include <signal.h>
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_stdint.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/threadapi.h"
+#include "azure_c_shared_utility/lock.h"
+#include "azure_c_shared_utility/condition.h"
+#include "azure_c_shared_utility/tickcounter.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
+
+MOCKABLE_FUNCTION(, uint64_t, test_do_work, void*, context);
+#undef ENABLE_MOCKS
+
+#include "iothub_client_reactor.h"
+
+static TEST_MUTEX_HANDLE test_serialize_mutex;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+#ifdef __cplusplus
+extern "C" const size_t IoTHubClientReactor_ThreadTerminationOffset;
+#else
+extern const size_t IoTHubClientReactor_ThreadTerminationOffset;
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    void real_DList_InitializeListHead(PDLIST_ENTRY listHead);
+    int real_DList_IsListEmpty(const PDLIST_ENTRY listHead);
+    void real_DList_InsertTailList(PDLIST_ENTRY listHead, PDLIST_ENTRY listEntry);
+    void real_DList_InsertHeadList(PDLIST_ENTRY listHead, PDLIST_ENTRY listEntry);
+    void real_DList_AppendTailList(PDLIST_ENTRY listHead, PDLIST_ENTRY ListToAppend);
+    int real_DList_RemoveEntryList(PDLIST_ENTRY listEntry);
+    PDLIST_ENTRY real_DList_RemoveHeadList(PDLIST_ENTRY listHead);
+
+#ifdef __cplusplus
+}
+#endif
+
+static LOCK_HANDLE TEST_LOCK_HANDLE = (LOCK_HANDLE)0x2001;
+static COND_HANDLE TEST_COND_HANDLE = (COND_HANDLE)0x2002;
+static TICK_COUNTER_HANDLE TEST_TICK_COUNTER_HANDLE = (TICK_COUNTER_HANDLE)0x2003;
+static THREAD_HANDLE TEST_THREAD_HANDLE = (THREAD_HANDLE)0x2006;
+static void* TEST_CONTEXT = (void*)0x2007;
+static void* TEST_CONTEXT_2 = (void*)0x2008;
+
+static THREAD_START_FUNC g_thread_func;
+static void* g_thread_func_arg;
+static tickcounter_ms_t g_current_ms;
+static size_t g_how_thread_loops;
+static size_t g_thread_loop_count;
+
+static int my_tickcounter_get_current_ms(TICK_COUNTER_HANDLE tick_counter, tickcounter_ms_t* current_ms)
+{
+    (void)tick_counter;
+    *current_ms = g_current_ms;
+    return 0;
+}
+
+static COND_RESULT my_Condition_Wait(COND_HANDLE handle, LOCK_HANDLE lock, int timeout_milliseconds)
+{
+    (void)handle;
+    (void)lock;
+    g_current_ms += timeout_milliseconds; /*the loop sleeps for as long as it asked*/
+    g_thread_loop_count++;
+    if ((g_how_thread_loops > 0) && (g_how_thread_loops == g_thread_loop_count))
+    {
+        *(sig_atomic_t*)(((char*)g_thread_func_arg) + IoTHubClientReactor_ThreadTerminationOffset) = 1; /*tell the thread to stop*/
+    }
+    return COND_TIMEOUT;
+}
+
+static THREADAPI_RESULT my_ThreadAPI_Create(THREAD_HANDLE* threadHandle, THREAD_START_FUNC func, void* arg)
+{
+    *threadHandle = TEST_THREAD_HANDLE;
+    g_thread_func = func;
+    g_thread_func_arg = arg;
+    return THREADAPI_OK;
+}
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+BEGIN_TEST_SUITE(iothubclient_reactor_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+
+    test_serialize_mutex = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(test_serialize_mutex);
+
+    umock_c_init(on_umock_c_error);
+
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LOCK_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(COND_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREAD_START_FUNC, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(THREADAPI_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(TICK_COUNTER_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(PDLIST_ENTRY, void*);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Lock_Init, TEST_LOCK_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Lock, LOCK_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Lock, LOCK_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(Unlock, LOCK_OK);
+
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Init, TEST_COND_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(Condition_Init, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(Condition_Post, COND_OK);
+    REGISTER_GLOBAL_MOCK_HOOK(Condition_Wait, my_Condition_Wait);
+
+    REGISTER_GLOBAL_MOCK_RETURN(tickcounter_create, TEST_TICK_COUNTER_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(tickcounter_get_current_ms, my_tickcounter_get_current_ms);
+
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InitializeListHead, real_DList_InitializeListHead);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_IsListEmpty, real_DList_IsListEmpty);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InsertTailList, real_DList_InsertTailList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InsertHeadList, real_DList_InsertHeadList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_AppendTailList, real_DList_AppendTailList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveEntryList, real_DList_RemoveEntryList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveHeadList, real_DList_RemoveHeadList);
+
+    REGISTER_GLOBAL_MOCK_HOOK(ThreadAPI_Create, my_ThreadAPI_Create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(ThreadAPI_Create, THREADAPI_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(ThreadAPI_Join, THREADAPI_OK);
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+    TEST_MUTEX_DESTROY(test_serialize_mutex);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    TEST_MUTEX_ACQUIRE(test_serialize_mutex);
+    umock_c_reset_all_calls();
+
+    g_thread_func = NULL;
+    g_thread_func_arg = NULL;
+    g_current_ms = 0;
+    g_how_thread_loops = 0;
+    g_thread_loop_count = 0;
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(test_serialize_mutex);
+}
+
+static void setup_create_reactor_with_one_loop(void)
+{
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Lock_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(Condition_Init());
+    STRICT_EXPECTED_CALL(tickcounter_create());
+    EXPECTED_CALL(ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+}
+
+/* Tests_SRS_IOTHUBCLIENT_REACTOR_10_001: [ If loopCount is 0, IoTHubClientReactor_Create shall return NULL. ]*/
+TEST_FUNCTION(IoTHubClientReactor_Create_loopCount_0_fail)
+{
+    // arrange
+
+    // act
+    IOTHUB_CLIENT_REACTOR_HANDLE result = IoTHubClientReactor_Create(0);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBCLIENT_REACTOR_10_002: [ IoTHubClientReactor_Create shall create loopCount loops, each with its own lock, condition, client list and worker thread. ]*/
+TEST_FUNCTION(IoTHubClientReactor_Create_succeed)
+{
+    // arrange
+    setup_create_reactor_with_one_loop();
+
+    // act
+    IOTHUB_CLIENT_REACTOR_HANDLE result = IoTHubClientReactor_Create(1);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_IS_NOT_NULL(g_thread_func);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientReactor_Destroy(result);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_REACTOR_10_003: [ If any resource cannot be created, IoTHubClientReactor_Create shall free everything it created and return NULL. ]*/
+TEST_FUNCTION(IoTHubClientReactor_Create_fail)
+{
+    // arrange
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    setup_create_reactor_with_one_loop();
+
+    umock_c_negative_tests_snapshot();
+
+    // act
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        if (index == 3)
+        {
+            continue; /*DList_InitializeListHead cannot fail*/
+        }
+
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubClientReactor_Create failure in test %zu/%zu", index, count);
+        IOTHUB_CLIENT_REACTOR_HANDLE result = IoTHubClientReactor_Create(1);
+
+        // assert
+        ASSERT_IS_NULL_WITH_MSG(result, tmp_msg);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+/* Tests_SRS_IOTHUBCLIENT_REACTOR_10_004: [ If reactorHandle is NULL, IoTHubClientReactor_Destroy shall do nothing. ]*/
+TEST_FUNCTION(IoTHubClientReactor_Destroy_handle_NULL_does_nothing)
+{
+    // arrange
+
+    // act
+    IoTHubClientReactor_Destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBCLIENT_REACTOR_10_005: [ IoTHubClientReactor_Destroy shall signal every loop to stop, join its thread and free all resources. ]*/
+TEST_FUNCTION(IoTHubClientReactor_Destroy_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_REACTOR_HANDLE reactor = IoTHubClientReactor_Create(1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(ThreadAPI_Join(TEST_THREAD_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_destroy(TEST_TICK_COUNTER_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Deinit(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Condition_Deinit(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Lock_Deinit(TEST_LOCK_HANDLE));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    IoTHubClientReactor_Destroy(reactor);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBCLIENT_REACTOR_10_006: [ If reactorHandle or doWork are NULL, IoTHubClientReactor_AddClient shall return NULL. ]*/
+TEST_FUNCTION(IoTHubClientReactor_AddClient_reactor_handle_NULL_fail)
+{
+    // arrange
+
+    // act
+    IOTHUB_CLIENT_REACTOR_CLIENT_HANDLE result = IoTHubClientReactor_AddClient(NULL, test_do_work, TEST_CONTEXT);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBCLIENT_REACTOR_10_006: [ If reactorHandle or doWork are NULL, IoTHubClientReactor_AddClient shall return NULL. ]*/
+TEST_FUNCTION(IoTHubClientReactor_AddClient_do_work_NULL_fail)
+{
+    // arrange
+    IOTHUB_CLIENT_REACTOR_HANDLE reactor = IoTHubClientReactor_Create(1);
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_REACTOR_CLIENT_HANDLE result = IoTHubClientReactor_AddClient(reactor, NULL, TEST_CONTEXT);
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientReactor_Destroy(reactor);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_REACTOR_10_007: [ IoTHubClientReactor_AddClient shall add the client to the loop with the fewest clients and wake that loop up so doWork runs right away. ]*/
+TEST_FUNCTION(IoTHubClientReactor_AddClient_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_REACTOR_HANDLE reactor = IoTHubClientReactor_Create(1);
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    IOTHUB_CLIENT_REACTOR_CLIENT_HANDLE result = IoTHubClientReactor_AddClient(reactor, test_do_work, TEST_CONTEXT);
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientReactor_RemoveClient(result);
+    IoTHubClientReactor_Destroy(reactor);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_REACTOR_10_008: [ If allocating or locking fails, IoTHubClientReactor_AddClient shall return NULL. ]*/
+TEST_FUNCTION(IoTHubClientReactor_AddClient_fail)
+{
+    // arrange
+    IOTHUB_CLIENT_REACTOR_HANDLE reactor = IoTHubClientReactor_Create(1);
+    umock_c_reset_all_calls();
+
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+
+    umock_c_negative_tests_snapshot();
+
+    // act
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubClientReactor_AddClient failure in test %zu/%zu", index, count);
+        IOTHUB_CLIENT_REACTOR_CLIENT_HANDLE result = IoTHubClientReactor_AddClient(reactor, test_do_work, TEST_CONTEXT);
+
+        // assert
+        ASSERT_IS_NULL_WITH_MSG(result, tmp_msg);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+    IoTHubClientReactor_Destroy(reactor);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_REACTOR_10_009: [ If clientHandle is NULL, IoTHubClientReactor_RemoveClient shall do nothing. ]*/
+TEST_FUNCTION(IoTHubClientReactor_RemoveClient_handle_NULL_does_nothing)
+{
+    // arrange
+
+    // act
+    IoTHubClientReactor_RemoveClient(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/* Tests_SRS_IOTHUBCLIENT_REACTOR_10_010: [ IoTHubClientReactor_RemoveClient shall wait for a running doWork of the client to return, remove the client from its loop and free it. ]*/
+TEST_FUNCTION(IoTHubClientReactor_RemoveClient_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_REACTOR_HANDLE reactor = IoTHubClientReactor_Create(1);
+    IOTHUB_CLIENT_REACTOR_CLIENT_HANDLE client = IoTHubClientReactor_AddClient(reactor, test_do_work, TEST_CONTEXT);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    IoTHubClientReactor_RemoveClient(client);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientReactor_Destroy(reactor);
+}
+
+/* Tests_SRS_IOTHUBCLIENT_REACTOR_10_015: [ IoTHubClientReactor_WakeClient shall mark the client as due and signal its loop. ]*/
+TEST_FUNCTION(IoTHubClientReactor_WakeClient_succeed)
+{
+    // arrange
+    IOTHUB_CLIENT_REACTOR_HANDLE reactor = IoTHubClientReactor_Create(1);
+    IOTHUB_CLIENT_REACTOR_CLIENT_HANDLE client = IoTHubClientReactor_AddClient(reactor, test_do_work, TEST_CONTEXT);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Condition_Post(TEST_COND_HANDLE));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+
+    // act
+    IoTHubClientReactor_WakeClient(client);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientReactor_RemoveClient(client);
+    IoTHubClientReactor_Destroy(reactor);
+}
+
+TEST_FUNCTION(IoTHubClientReactor_loop_exits_when_lock_fails)
+{
+    // arrange
+    IOTHUB_CLIENT_REACTOR_HANDLE reactor = IoTHubClientReactor_Create(1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE))
+        .SetReturn(LOCK_ERROR);
+    STRICT_EXPECTED_CALL(ThreadAPI_Exit(0));
+
+    // act
+    ASSERT_IS_NOT_NULL(g_thread_func);
+    (void)g_thread_func(g_thread_func_arg);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientReactor_Destroy(reactor);
+}
+
+static void setup_loop_runs_client(void* context, uint64_t msToNextWork)
+{
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(test_do_work(context))
+        .SetReturn(msToNextWork);
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+}
+
+/* Tests_SRS_IOTHUBCLIENT_REACTOR_10_011: [ A loop shall call doWork for a client when it was woken up or when the deadline returned by its previous doWork expired. ]*/
+/* Tests_SRS_IOTHUBCLIENT_REACTOR_10_014: [ When no client is due the loop shall wait on its condition until the earliest client deadline, a wake up or a stop request. ]*/
+/* Tests_SRS_IOTHUBCLIENT_REACTOR_10_016: [ A loop shall keep its clients ordered by deadline and only visit the clients that are due. ]*/
+TEST_FUNCTION(IoTHubClientReactor_loop_runs_only_due_clients_and_waits_until_the_earliest_deadline)
+{
+    // arrange
+    IOTHUB_CLIENT_REACTOR_HANDLE reactor = IoTHubClientReactor_Create(1);
+    IOTHUB_CLIENT_REACTOR_CLIENT_HANDLE client1 = IoTHubClientReactor_AddClient(reactor, test_do_work, TEST_CONTEXT);
+    IOTHUB_CLIENT_REACTOR_CLIENT_HANDLE client2 = IoTHubClientReactor_AddClient(reactor, test_do_work, TEST_CONTEXT_2);
+    umock_c_reset_all_calls();
+
+    g_current_ms = 1000;
+    g_how_thread_loops = 2;
+
+    STRICT_EXPECTED_CALL(Lock(TEST_LOCK_HANDLE));
+    /*first pass, both clients were just added*/
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    setup_loop_runs_client(TEST_CONTEXT, 500);
+    setup_loop_runs_client(TEST_CONTEXT_2, 100);
+    STRICT_EXPECTED_CALL(Condition_Wait(TEST_COND_HANDLE, TEST_LOCK_HANDLE, 100));
+    /*second pass, only the second client is due*/
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(TEST_TICK_COUNTER_HANDLE, IGNORED_PTR_ARG));
+    setup_loop_runs_client(TEST_CONTEXT_2, 100);
+    STRICT_EXPECTED_CALL(Condition_Wait(TEST_COND_HANDLE, TEST_LOCK_HANDLE, 100));
+    STRICT_EXPECTED_CALL(Unlock(TEST_LOCK_HANDLE));
+    STRICT_EXPECTED_CALL(ThreadAPI_Exit(0));
+
+    // act
+    ASSERT_IS_NOT_NULL(g_thread_func);
+    (void)g_thread_func(g_thread_func_arg);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubClientReactor_RemoveClient(client2);
+    IoTHubClientReactor_RemoveClient(client1);
+    IoTHubClientReactor_Destroy(reactor);
+}
+
+END_TEST_SUITE(iothubclient_reactor_ut)
@@ -50,6 +50,7 @@ extern "C" {
     extern size_t real_BUFFER_length(BUFFER_HANDLE handle);
     extern int real_BUFFER_build(BUFFER_HANDLE handle, const unsigned char* source, size_t size);
     extern int real_BUFFER_append_build(BUFFER_HANDLE handle, const unsigned char* source, size_t size);
+    extern int real_BUFFER_pre_build(BUFFER_HANDLE handle, size_t size);
     extern BUFFER_HANDLE real_BUFFER_clone(BUFFER_HANDLE handle);
     extern BUFFER_HANDLE real_BUFFER_create(const unsigned char* source, size_t size);
 
@@ -62,6 +63,8 @@ extern "C" {
 static MAP_FILTER_CALLBACK g_mapFilterFunc;
 
 static const unsigned char c[1] = { '3' };
+static const unsigned char c2[2] = { '4', '5' };
+static const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT TEST_SEGMENTS[2] = { { c, sizeof(c) }, { c2, sizeof(c2) } };
 static const char* TEST_MESSAGE_ID = "3820ADAE-E3CA-4065-843A-A6BDE950D8DC";
 static const char* TEST_MESSAGE_ID2 = "052BA01A-ECBF-48CF-BC7B-64B315D898B7";
 static const char* TEST_STRING_VALUE = "aaaa";
@@ -81,6 +84,9 @@ IMPLEMENT_UMOCK_C_ENUM_TYPE(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_RESULT_VALUES)
 TEST_DEFINE_ENUM_TYPE(IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_CONTENT_TYPE_VALUES);
 IMPLEMENT_UMOCK_C_ENUM_TYPE(IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_CONTENT_TYPE_VALUES);
 
+TEST_DEFINE_ENUM_TYPE(IOTHUB_MESSAGE_PRIORITY, IOTHUB_MESSAGE_PRIORITY_VALUES);
+TEST_DEFINE_ENUM_TYPE(IOTHUB_MESSAGE_DELIVERY, IOTHUB_MESSAGE_DELIVERY_VALUES);
+
 DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
 
 static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
@@ -114,6 +120,19 @@ static int my_mallocAndStrcpy_s(char** destination, const char* source)
     return 0;
 }
 
+static size_t g_releaseCallbackCount;
+static const unsigned char* g_releaseCallbackByteArray;
+static size_t g_releaseCallbackSize;
+static void* g_releaseCallbackContext;
+
+static void test_release_callback(const unsigned char* byteArray, size_t size, void* userContextCallback)
+{
+    g_releaseCallbackCount++;
+    g_releaseCallbackByteArray = byteArray;
+    g_releaseCallbackSize = size;
+    g_releaseCallbackContext = userContextCallback;
+}
+
 static TEST_MUTEX_HANDLE g_testByTest;
 static TEST_MUTEX_HANDLE g_dllByDll;
 
@@ -150,6 +169,8 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_HOOK(BUFFER_delete, real_BUFFER_delete);
     REGISTER_GLOBAL_MOCK_HOOK(BUFFER_build, real_BUFFER_build);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_build, __LINE__);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_pre_build, real_BUFFER_pre_build);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_pre_build, __LINE__);
     REGISTER_GLOBAL_MOCK_HOOK(BUFFER_u_char, real_BUFFER_u_char);
     REGISTER_GLOBAL_MOCK_HOOK(BUFFER_length, real_BUFFER_length);
     REGISTER_GLOBAL_MOCK_HOOK(BUFFER_clone, real_BUFFER_clone);
@@ -186,6 +207,10 @@ TEST_FUNCTION_INITIALIZE(method_init)
     umock_c_reset_all_calls();
 
     g_mapFilterFunc = NULL;
+    g_releaseCallbackCount = 0;
+    g_releaseCallbackByteArray = NULL;
+    g_releaseCallbackSize = 0;
+    g_releaseCallbackContext = NULL;
 }
 
 TEST_FUNCTION_CLEANUP(method_cleanup)
@@ -216,6 +241,8 @@ TEST_FUNCTION(IoTHubMessage_CreateFromByteArray_happy_path)
 {
     // arrange
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(BUFFER_create(c, 1));
     STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
 
@@ -251,6 +278,8 @@ TEST_FUNCTION(IoTHubMessage_CreateFromByteArray_succeeds_when_size_0_and_buffer_
 {
     // arrange
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
     STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
 
@@ -270,6 +299,8 @@ TEST_FUNCTION(IoTHubMessage_CreateFromByteArray_succeeds_when_size_0_and_buffer_
 {
     //arrange
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(BUFFER_create(IGNORED_PTR_ARG, 0)).IgnoreArgument(1);
     STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
 
@@ -292,6 +323,8 @@ TEST_FUNCTION(IoTHubMessage_CreateFromByteArray_fails)
 
     // arrange
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(BUFFER_create(c, 1));
     STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
 
@@ -326,6 +359,8 @@ TEST_FUNCTION(IoTHubMessage_CreateFromString_happy_path)
 {
     //arrange
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(STRING_construct("a"));
     STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
 
@@ -364,6 +399,8 @@ TEST_FUNCTION(IoTHubMessage_CreateFromString_fails)
 
     // arrange
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(STRING_construct("a"));
     STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
 
@@ -389,258 +426,258 @@ TEST_FUNCTION(IoTHubMessage_CreateFromString_fails)
     umock_c_negative_tests_deinit();
 }
 
-TEST_FUNCTION(IoTHubMessage_Map_Filter_validate_Ascii_char_SUCCEED)
+/*Tests_SRS_IOTHUBMESSAGE_10_012: [The type of the new message shall be IOTHUBMESSAGE_BYTEARRAY.]*/
+/*Tests_SRS_IOTHUBMESSAGE_10_013: [IoTHubMessage_CreateFromExternalByteArray shall call Map_Create to create the message properties and shall keep a reference to byteArray without copying it.]*/
+/*Tests_SRS_IOTHUBMESSAGE_10_015: [If the message was created from an external byte array, IoTHubMessage_GetByteArray shall return that byte array and its size.]*/
+TEST_FUNCTION(IoTHubMessage_CreateFromExternalByteArray_happy_path)
 {
     //arrange
-    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
-    umock_c_reset_all_calls();
+    const unsigned char* byteArray;
+    size_t size;
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
 
     //act
-    int result = g_mapFilterFunc(TEST_VALID_MAP_KEY, TEST_VALID_MAP_VALUE);
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromExternalByteArray(c, 1, test_release_callback, (void*)0x42);
 
     //assert
-    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_IS_NOT_NULL(h);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_BYTEARRAY, IoTHubMessage_GetContentType(h));
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, IoTHubMessage_GetByteArray(h, &byteArray, &size));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)c, (void*)byteArray);
+    ASSERT_ARE_EQUAL(size_t, 1, size);
+    ASSERT_ARE_EQUAL(size_t, 0, g_releaseCallbackCount);
 
     //cleanup
     IoTHubMessage_Destroy(h);
 }
 
-TEST_FUNCTION(IoTHubMessage_Map_Filter_invalidate_Ascii_key_fail)
+/*Tests_SRS_IOTHUBMESSAGE_10_011: [If byteArray or releaseCallback is NULL, IoTHubMessage_CreateFromExternalByteArray shall return NULL.]*/
+TEST_FUNCTION(IoTHubMessage_CreateFromExternalByteArray_with_NULL_byteArray_fails)
 {
     //arrange
-    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
-    umock_c_reset_all_calls();
 
     //act
-    int result = g_mapFilterFunc(TEST_INVALID_MAP_KEY, TEST_VALID_MAP_VALUE);
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromExternalByteArray(NULL, 1, test_release_callback, NULL);
 
     //assert
-    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_IS_NULL(h);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-    //cleanup
-    IoTHubMessage_Destroy(h);
 }
 
-TEST_FUNCTION(IoTHubMessage_Map_Filter_invalidate_Ascii_value_fail)
+/*Tests_SRS_IOTHUBMESSAGE_10_011: [If byteArray or releaseCallback is NULL, IoTHubMessage_CreateFromExternalByteArray shall return NULL.]*/
+TEST_FUNCTION(IoTHubMessage_CreateFromExternalByteArray_with_NULL_releaseCallback_fails)
 {
     //arrange
-    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
-    umock_c_reset_all_calls();
 
     //act
-    int result = g_mapFilterFunc(TEST_VALID_MAP_KEY, TEST_INVALID_MAP_VALUE);
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromExternalByteArray(c, 1, NULL, NULL);
 
     //assert
-    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_IS_NULL(h);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-    //cleanup
-    IoTHubMessage_Destroy(h);
 }
 
-/*Tests_SRS_IOTHUBMESSAGE_01_004: [If iotHubMessageHandle is NULL, IoTHubMessage_Destroy shall do nothing.] */
-TEST_FUNCTION(IoTHubMessage_Destroy_With_NULL_handle_does_nothing)
+/*Tests_SRS_IOTHUBMESSAGE_10_014: [If there are any errors then IoTHubMessage_CreateFromExternalByteArray shall return NULL and shall not call releaseCallback.]*/
+TEST_FUNCTION(IoTHubMessage_CreateFromExternalByteArray_fails)
 {
-    // arrange
-
-    ///act
-    IoTHubMessage_Destroy(NULL);
-
-    //assert
-    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-    //cleanup
-}
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
 
-/*Tests_SRS_IOTHUBMESSAGE_01_003: [IoTHubMessage_Destroy shall free all resources associated with iotHubMessageHandle.]  */
-TEST_FUNCTION(IoTHubMessage_Destroy_destroys_a_BYTEARRAY_IoTHubMEssage)
-{
     // arrange
-    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
-    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
 
-    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Map_Destroy(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(gballoc_free(h));
+    umock_c_negative_tests_snapshot();
 
     //act
-    IoTHubMessage_Destroy(h);
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
 
-    //assert
-    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubMessage_CreateFromExternalByteArray failure in test %zu/%zu", index, count);
+
+        IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromExternalByteArray(c, 1, test_release_callback, NULL);
+
+        //assert
+        ASSERT_IS_NULL_WITH_MSG(h, tmp_msg);
+    }
+    ASSERT_ARE_EQUAL(size_t, 0, g_releaseCallbackCount);
 
     //cleanup
+    umock_c_negative_tests_deinit();
 }
 
-/*Tests_SRS_IOTHUBMESSAGE_01_003: [IoTHubMessage_Destroy shall free all resources associated with iotHubMessageHandle.]  */
-TEST_FUNCTION(IoTHubMessage_Destroy_destroys_a_STRING_IoTHubMessage)
+/*Tests_SRS_IOTHUBMESSAGE_10_016: [When the last message referring to an external byte array is destroyed, releaseCallback shall be called with byteArray, size and userContextCallback.]*/
+TEST_FUNCTION(IoTHubMessage_Destroy_of_the_last_clone_calls_the_release_callback)
 {
-    // arrange
-    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromExternalByteArray(c, 1, test_release_callback, (void*)0x42);
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+    IoTHubMessage_Destroy(h);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    ASSERT_ARE_EQUAL(size_t, 0, g_releaseCallbackCount);
+
     STRICT_EXPECTED_CALL(Map_Destroy(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(gballoc_free(h));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(r));
 
     //act
-    IoTHubMessage_Destroy(h);
+    IoTHubMessage_Destroy(r);
 
     //assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-    //cleanup
+    ASSERT_ARE_EQUAL(size_t, 1, g_releaseCallbackCount);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)c, (void*)g_releaseCallbackByteArray);
+    ASSERT_ARE_EQUAL(size_t, 1, g_releaseCallbackSize);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x42, g_releaseCallbackContext);
 }
 
-/*Tests_SRS_IOTHUBMESSAGE_01_011: [The pointer shall be obtained by using BUFFER_u_char and it shall be copied in the buffer argument.]*/
-/*Tests_SRS_IOTHUBMESSAGE_01_012: [The size of the associated data shall be obtained by using BUFFER_length and it shall be copied to the size argument.]*/
-/*Tests_SRS_IOTHUBMESSAGE_02_033: [IoTHubMessage_GetByteArray shall return IOTHUBMESSAGE_OK when all oeprations complete succesfully.] */
-TEST_FUNCTION(IoTHubMessage_GetByteArray_happy_path)
+/*Tests_SRS_IOTHUBMESSAGE_10_008: [Before a message that shares its content with a clone is modified, its content shall be copied. Copying the content shall clone the properties map by a call to Map_Clone and shall keep sharing the body.]*/
+/*Tests_SRS_IOTHUBMESSAGE_10_017: [The body of a message shall be shared by all its clones for their whole life, so releaseCallback is only called once the last of them is destroyed.]*/
+TEST_FUNCTION(IoTHubMessage_Properties_of_a_clone_of_an_external_byte_array_keeps_sharing_the_byte_array)
 {
     //arrange
-    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
     const unsigned char* byteArray;
     size_t size;
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromExternalByteArray(c, 1, test_release_callback, NULL);
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
 
     //act
-    IOTHUB_MESSAGE_RESULT r = IoTHubMessage_GetByteArray(h, &byteArray, &size);
+    MAP_HANDLE cloneProperties = IoTHubMessage_Properties(r);
 
     //assert
-    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, r);
-    ASSERT_ARE_EQUAL(uint8_t, c[0], byteArray[0]);
-    ASSERT_ARE_EQUAL(size_t, 1, size);
+    ASSERT_IS_NOT_NULL(cloneProperties);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, IoTHubMessage_GetByteArray(r, &byteArray, &size));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)c, (void*)byteArray);
+    ASSERT_ARE_EQUAL(size_t, 1, size);
 
-    ///cleanup
     IoTHubMessage_Destroy(h);
+    ASSERT_ARE_EQUAL(size_t, 0, g_releaseCallbackCount);
+
+    //cleanup
+    IoTHubMessage_Destroy(r);
+    ASSERT_ARE_EQUAL(size_t, 1, g_releaseCallbackCount);
 }
 
-/*Tests_SRS_IOTHUBMESSAGE_01_014: [If any of the arguments passed to IoTHubMessage_GetByteArray  is NULL IoTHubMessage_GetByteArray shall return IOTHUBMESSAGE_INVALID_ARG.] */
-TEST_FUNCTION(IoTHubMessage_GetByteArray_with_NULL_handle_fails)
+/*Tests_SRS_IOTHUBMESSAGE_10_019: [The type of the new message shall be IOTHUBMESSAGE_BYTEARRAY.]*/
+/*Tests_SRS_IOTHUBMESSAGE_10_020: [IoTHubMessage_CreateFromByteArraySegments shall copy the array of segments, shall keep a reference to the buffers of the segments without copying them and shall call Map_Create to create the message properties.]*/
+/*Tests_SRS_IOTHUBMESSAGE_10_027: [If the body of the message is external, IoTHubMessage_GetByteArraySegments shall return its segments without copying them.]*/
+TEST_FUNCTION(IoTHubMessage_CreateFromByteArraySegments_happy_path)
 {
     //arrange
-    const unsigned char* byteArray;
-    size_t size;
+    const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT* segments;
+    size_t segmentCount;
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(TEST_SEGMENTS)));
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
 
     //act
-    IOTHUB_MESSAGE_RESULT r = IoTHubMessage_GetByteArray(NULL, &byteArray, &size);
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArraySegments(TEST_SEGMENTS, 2, test_release_callback, (void*)0x42);
 
     //assert
-    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, r);
+    ASSERT_IS_NOT_NULL(h);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUBMESSAGE_CONTENT_TYPE, IOTHUBMESSAGE_BYTEARRAY, IoTHubMessage_GetContentType(h));
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, IoTHubMessage_GetByteArraySegments(h, &segments, &segmentCount));
+    ASSERT_ARE_EQUAL(size_t, 2, segmentCount);
+    ASSERT_ARE_NOT_EQUAL(void_ptr, (void*)TEST_SEGMENTS, (void*)segments);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)c, (void*)segments[0].buffer);
+    ASSERT_ARE_EQUAL(size_t, sizeof(c), segments[0].size);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)c2, (void*)segments[1].buffer);
+    ASSERT_ARE_EQUAL(size_t, sizeof(c2), segments[1].size);
+    ASSERT_ARE_EQUAL(size_t, 0, g_releaseCallbackCount);
 
     //cleanup
+    IoTHubMessage_Destroy(h);
 }
 
-/*Tests_SRS_IOTHUBMESSAGE_01_014: [If any of the arguments passed to IoTHubMessage_GetByteArray  is NULL IoTHubMessage_GetByteArray shall return IOTHUBMESSAGE_INVALID_ARG.] */
-TEST_FUNCTION(IoTHubMessage_GetByteArray_with_NULL_byteArray_fails)
+/*Tests_SRS_IOTHUBMESSAGE_10_018: [If segments is NULL, segmentCount is 0, the buffer of any segment is NULL or releaseCallback is NULL, IoTHubMessage_CreateFromByteArraySegments shall return NULL.]*/
+TEST_FUNCTION(IoTHubMessage_CreateFromByteArraySegments_with_NULL_segments_fails)
 {
-    ///arrange
-    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
-    size_t size;
-    umock_c_reset_all_calls();
+    //arrange
 
     //act
-    IOTHUB_MESSAGE_RESULT r = IoTHubMessage_GetByteArray(h, NULL, &size);
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArraySegments(NULL, 2, test_release_callback, NULL);
 
     //assert
-    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, r);
+    ASSERT_IS_NULL(h);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-    ///cleanup
-    IoTHubMessage_Destroy(h);
 }
 
-/*Tests_SRS_IOTHUBMESSAGE_02_021: [If iotHubMessageHandle is not a iothubmessage containing BYTEARRAY data, then IoTHubMessage_GetByteArray  shall return IOTHUBMESSAGE_INVALID_ARG.]*/
-TEST_FUNCTION(IoTHubMessage_GetByteArray_with_STRING_fails)
+/*Tests_SRS_IOTHUBMESSAGE_10_018: [If segments is NULL, segmentCount is 0, the buffer of any segment is NULL or releaseCallback is NULL, IoTHubMessage_CreateFromByteArraySegments shall return NULL.]*/
+TEST_FUNCTION(IoTHubMessage_CreateFromByteArraySegments_with_0_segmentCount_fails)
 {
     //arrange
-    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
-    const unsigned char* byteArray;
-    size_t size;
-    umock_c_reset_all_calls();
 
     //act
-    IOTHUB_MESSAGE_RESULT r = IoTHubMessage_GetByteArray(h, &byteArray, &size);
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArraySegments(TEST_SEGMENTS, 0, test_release_callback, NULL);
 
     //assert
-    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, r);
+    ASSERT_IS_NULL(h);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-    ///cleanup
-    IoTHubMessage_Destroy(h);
 }
 
-/*Tests_SRS_IOTHUBMESSAGE_03_001: [IoTHubMessage_Clone shall create a new IoT hub message with data content identical to that of the iotHubMessageHandle parameter.]*/
-/*Tests_SRS_IOTHUBMESSAGE_02_006: [IoTHubMessage_Clone shall clone the content by a call to BUFFER_clone or STRING_clone] */
-/*Tests_SRS_IOTHUBMESSAGE_02_005: [IoTHubMessage_Clone shall clone the properties map by using Map_Clone.] */
-/*Tests_SRS_IOTHUBMESSAGE_03_002: [IoTHubMessage_Clone shall return upon success a non-NULL handle to the newly created IoT hub message.]*/
-TEST_FUNCTION(IoTHubMessage_Clone_with_BYTE_ARRAY_happy_path)
+/*Tests_SRS_IOTHUBMESSAGE_10_018: [If segments is NULL, segmentCount is 0, the buffer of any segment is NULL or releaseCallback is NULL, IoTHubMessage_CreateFromByteArraySegments shall return NULL.]*/
+TEST_FUNCTION(IoTHubMessage_CreateFromByteArraySegments_with_a_NULL_segment_buffer_fails)
 {
     //arrange
-    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
-    umock_c_reset_all_calls();
-
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_clone(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
+    IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT segments[2] = { { c, sizeof(c) }, { NULL, 1 } };
 
     //act
-    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArraySegments(segments, 2, test_release_callback, NULL);
 
     //assert
-    ASSERT_IS_NOT_NULL(r);
+    ASSERT_IS_NULL(h);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-    ///cleanup
-    IoTHubMessage_Destroy(r);
-    IoTHubMessage_Destroy(h);
 }
 
-TEST_FUNCTION(IoTHubMessage_Clone_handle_NULL_fail)
+/*Tests_SRS_IOTHUBMESSAGE_10_018: [If segments is NULL, segmentCount is 0, the buffer of any segment is NULL or releaseCallback is NULL, IoTHubMessage_CreateFromByteArraySegments shall return NULL.]*/
+TEST_FUNCTION(IoTHubMessage_CreateFromByteArraySegments_with_NULL_releaseCallback_fails)
 {
     //arrange
 
-
     //act
-    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(NULL);
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArraySegments(TEST_SEGMENTS, 2, NULL, NULL);
 
     //assert
-    ASSERT_IS_NULL(r);
+    ASSERT_IS_NULL(h);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-
-    //cleanup
 }
 
-/*Tests_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
-TEST_FUNCTION(IoTHubMessage_Clone_with_BYTE_ARRAY_fails)
+/*Tests_SRS_IOTHUBMESSAGE_10_021: [If there are any errors then IoTHubMessage_CreateFromByteArraySegments shall return NULL and shall not call releaseCallback.]*/
+TEST_FUNCTION(IoTHubMessage_CreateFromByteArraySegments_fails)
 {
-    //arrange
-    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
-    umock_c_reset_all_calls();
-
     int negativeTestsInitResult = umock_c_negative_tests_init();
     ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
 
+    // arrange
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(BUFFER_clone(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(sizeof(TEST_SEGMENTS)));
+    STRICT_EXPECTED_CALL(Map_Create(IGNORED_PTR_ARG));
 
     umock_c_negative_tests_snapshot();
 
@@ -652,70 +689,726 @@ TEST_FUNCTION(IoTHubMessage_Clone_with_BYTE_ARRAY_fails)
         umock_c_negative_tests_fail_call(index);
 
         char tmp_msg[64];
-        sprintf(tmp_msg, "IoTHubMessage_Clone failure in test %zu/%zu", index, count);
+        sprintf(tmp_msg, "IoTHubMessage_CreateFromByteArraySegments failure in test %zu/%zu", index, count);
 
-        IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+        IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArraySegments(TEST_SEGMENTS, 2, test_release_callback, NULL);
 
         //assert
-        ASSERT_IS_NULL_WITH_MSG(r, tmp_msg);
+        ASSERT_IS_NULL_WITH_MSG(h, tmp_msg);
     }
+    ASSERT_ARE_EQUAL(size_t, 0, g_releaseCallbackCount);
 
     //cleanup
-    IoTHubMessage_Destroy(h);
     umock_c_negative_tests_deinit();
 }
 
-/*Tests_SRS_IOTHUBMESSAGE_03_001: [IoTHubMessage_Clone shall create a new IoT hub message with data content identical to that of the iotHubMessageHandle parameter.]*/
-/*Tests_SRS_IOTHUBMESSAGE_02_006: [IoTHubMessage_Clone shall clone the content by a call to BUFFER_clone or STRING_clone] */
-/*Tests_SRS_IOTHUBMESSAGE_02_005: [IoTHubMessage_Clone shall clone the properties map by using Map_Clone.] */
-/*Tests_SRS_IOTHUBMESSAGE_03_002: [IoTHubMessage_Clone shall return upon success a non-NULL handle to the newly created IoT hub message.]*/
-TEST_FUNCTION(IoTHubMessage_Clone_with_STRING_happy_path)
+/*Tests_SRS_IOTHUBMESSAGE_10_022: [When the last message referring to external segments is destroyed, releaseCallback shall be called once for every segment with the buffer and size of the segment and userContextCallback.]*/
+TEST_FUNCTION(IoTHubMessage_Destroy_of_a_message_made_of_segments_calls_the_release_callback_for_every_segment)
 {
     //arrange
-    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArraySegments(TEST_SEGMENTS, 2, test_release_callback, (void*)0x42);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(STRING_clone(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
+    //act
+    IoTHubMessage_Destroy(h);
 
-    ///act
-    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 2, g_releaseCallbackCount);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)c2, (void*)g_releaseCallbackByteArray);
+    ASSERT_ARE_EQUAL(size_t, sizeof(c2), g_releaseCallbackSize);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)0x42, g_releaseCallbackContext);
+}
 
-    ///assert
-    ASSERT_IS_NOT_NULL(r);
+/*Tests_SRS_IOTHUBMESSAGE_10_024: [If the message was created from several external segments, IoTHubMessage_GetByteArray shall gather them once in a buffer owned by the message and shall call releaseCallback for every segment.]*/
+TEST_FUNCTION(IoTHubMessage_GetByteArray_of_a_message_made_of_segments_gathers_the_segments)
+{
+    //arrange
+    const unsigned char* byteArray;
+    size_t size;
+    const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT* segments;
+    size_t segmentCount;
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArraySegments(TEST_SEGMENTS, 2, test_release_callback, NULL);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(BUFFER_pre_build(IGNORED_PTR_ARG, sizeof(c) + sizeof(c2)));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_MESSAGE_RESULT r = IoTHubMessage_GetByteArray(h, &byteArray, &size);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, r);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, sizeof(c) + sizeof(c2), size);
+    ASSERT_ARE_EQUAL(uint8_t, c[0], byteArray[0]);
+    ASSERT_ARE_EQUAL(uint8_t, c2[0], byteArray[1]);
+    ASSERT_ARE_EQUAL(uint8_t, c2[1], byteArray[2]);
+    ASSERT_ARE_EQUAL(size_t, 2, g_releaseCallbackCount);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, IoTHubMessage_GetByteArraySegments(h, &segments, &segmentCount));
+    ASSERT_ARE_EQUAL(size_t, 1, segmentCount);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)byteArray, (void*)segments[0].buffer);
 
     ///cleanup
-    IoTHubMessage_Destroy(r);
     IoTHubMessage_Destroy(h);
+    ASSERT_ARE_EQUAL(size_t, 2, g_releaseCallbackCount);
 }
 
-/*Tests_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
-TEST_FUNCTION(IoTHubMessage_Clone_with_STRING_fails)
+/*Tests_SRS_IOTHUBMESSAGE_10_024: [If the message was created from several external segments, IoTHubMessage_GetByteArray shall gather them once in a buffer owned by the message and shall call releaseCallback for every segment.]*/
+TEST_FUNCTION(IoTHubMessage_GetByteArray_of_a_message_made_of_segments_fails_when_gathering_fails)
 {
     //arrange
-    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    const unsigned char* byteArray;
+    size_t size;
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArraySegments(TEST_SEGMENTS, 2, test_release_callback, NULL);
     umock_c_reset_all_calls();
 
-    int negativeTestsInitResult = umock_c_negative_tests_init();
-    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
-
-    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
-    STRICT_EXPECTED_CALL(STRING_clone(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
-
-    umock_c_negative_tests_snapshot();
+    STRICT_EXPECTED_CALL(BUFFER_new())
+        .SetReturn(NULL);
 
     //act
-    size_t count = umock_c_negative_tests_call_count();
-    for (size_t index = 0; index < count; index++)
-    {
-        umock_c_negative_tests_reset();
-        umock_c_negative_tests_fail_call(index);
+    IOTHUB_MESSAGE_RESULT r = IoTHubMessage_GetByteArray(h, &byteArray, &size);
 
-        char tmp_msg[64];
-        sprintf(tmp_msg, "IoTHubMessage_Clone_w_string failure in test %zu/%zu", index, count);
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_ERROR, r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 0, g_releaseCallbackCount);
+
+    ///cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_10_023: [If IoTHubMessage_GetByteArray gathers external segments shared with a clone, the message shall get a body of its own and the clone shall keep the segments.]*/
+TEST_FUNCTION(IoTHubMessage_GetByteArray_of_a_clone_of_a_message_made_of_segments_keeps_the_segments_of_the_original)
+{
+    //arrange
+    const unsigned char* byteArray;
+    size_t size;
+    const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT* segments;
+    size_t segmentCount;
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArraySegments(TEST_SEGMENTS, 2, test_release_callback, NULL);
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(BUFFER_pre_build(IGNORED_PTR_ARG, sizeof(c) + sizeof(c2)));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_GetByteArray(r, &byteArray, &size);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, sizeof(c) + sizeof(c2), size);
+    ASSERT_ARE_EQUAL(size_t, 0, g_releaseCallbackCount);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, IoTHubMessage_GetByteArraySegments(h, &segments, &segmentCount));
+    ASSERT_ARE_EQUAL(size_t, 2, segmentCount);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)c, (void*)segments[0].buffer);
+
+    IoTHubMessage_Destroy(r);
+    ASSERT_ARE_EQUAL(size_t, 0, g_releaseCallbackCount);
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+    ASSERT_ARE_EQUAL(size_t, 2, g_releaseCallbackCount);
+}
+
+TEST_FUNCTION(IoTHubMessage_Map_Filter_validate_Ascii_char_SUCCEED)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    umock_c_reset_all_calls();
+
+    //act
+    int result = g_mapFilterFunc(TEST_VALID_MAP_KEY, TEST_VALID_MAP_VALUE);
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubMessage_Map_Filter_invalidate_Ascii_key_fail)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    umock_c_reset_all_calls();
+
+    //act
+    int result = g_mapFilterFunc(TEST_INVALID_MAP_KEY, TEST_VALID_MAP_VALUE);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubMessage_Map_Filter_invalidate_Ascii_value_fail)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    umock_c_reset_all_calls();
+
+    //act
+    int result = g_mapFilterFunc(TEST_VALID_MAP_KEY, TEST_INVALID_MAP_VALUE);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_01_004: [If iotHubMessageHandle is NULL, IoTHubMessage_Destroy shall do nothing.] */
+TEST_FUNCTION(IoTHubMessage_Destroy_With_NULL_handle_does_nothing)
+{
+    // arrange
+
+    ///act
+    IoTHubMessage_Destroy(NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_01_003: [IoTHubMessage_Destroy shall free all resources associated with iotHubMessageHandle.]  */
+TEST_FUNCTION(IoTHubMessage_Destroy_destroys_a_BYTEARRAY_IoTHubMEssage)
+{
+    // arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Map_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(h));
+
+    //act
+    IoTHubMessage_Destroy(h);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_01_003: [IoTHubMessage_Destroy shall free all resources associated with iotHubMessageHandle.]  */
+TEST_FUNCTION(IoTHubMessage_Destroy_destroys_a_STRING_IoTHubMessage)
+{
+    // arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Map_Destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(h));
+
+    //act
+    IoTHubMessage_Destroy(h);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_01_011: [The pointer shall be obtained by using BUFFER_u_char and it shall be copied in the buffer argument.]*/
+/*Tests_SRS_IOTHUBMESSAGE_01_012: [The size of the associated data shall be obtained by using BUFFER_length and it shall be copied to the size argument.]*/
+/*Tests_SRS_IOTHUBMESSAGE_02_033: [IoTHubMessage_GetByteArray shall return IOTHUBMESSAGE_OK when all oeprations complete succesfully.] */
+TEST_FUNCTION(IoTHubMessage_GetByteArray_happy_path)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    const unsigned char* byteArray;
+    size_t size;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_MESSAGE_RESULT r = IoTHubMessage_GetByteArray(h, &byteArray, &size);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, r);
+    ASSERT_ARE_EQUAL(uint8_t, c[0], byteArray[0]);
+    ASSERT_ARE_EQUAL(size_t, 1, size);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_01_014: [If any of the arguments passed to IoTHubMessage_GetByteArray  is NULL IoTHubMessage_GetByteArray shall return IOTHUBMESSAGE_INVALID_ARG.] */
+TEST_FUNCTION(IoTHubMessage_GetByteArray_with_NULL_handle_fails)
+{
+    //arrange
+    const unsigned char* byteArray;
+    size_t size;
+
+    //act
+    IOTHUB_MESSAGE_RESULT r = IoTHubMessage_GetByteArray(NULL, &byteArray, &size);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_01_014: [If any of the arguments passed to IoTHubMessage_GetByteArray  is NULL IoTHubMessage_GetByteArray shall return IOTHUBMESSAGE_INVALID_ARG.] */
+TEST_FUNCTION(IoTHubMessage_GetByteArray_with_NULL_byteArray_fails)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    size_t size;
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT r = IoTHubMessage_GetByteArray(h, NULL, &size);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_02_021: [If iotHubMessageHandle is not a iothubmessage containing BYTEARRAY data, then IoTHubMessage_GetByteArray  shall return IOTHUBMESSAGE_INVALID_ARG.]*/
+TEST_FUNCTION(IoTHubMessage_GetByteArray_with_STRING_fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    const unsigned char* byteArray;
+    size_t size;
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT r = IoTHubMessage_GetByteArray(h, &byteArray, &size);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_10_028: [Otherwise IoTHubMessage_GetByteArraySegments shall return one segment made of BUFFER_u_char and BUFFER_length of the body.]*/
+TEST_FUNCTION(IoTHubMessage_GetByteArraySegments_happy_path)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT* segments;
+    size_t segmentCount;
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_MESSAGE_RESULT r = IoTHubMessage_GetByteArraySegments(h, &segments, &segmentCount);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, r);
+    ASSERT_ARE_EQUAL(size_t, 1, segmentCount);
+    ASSERT_ARE_EQUAL(uint8_t, c[0], segments[0].buffer[0]);
+    ASSERT_ARE_EQUAL(size_t, 1, segments[0].size);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_10_025: [If any of the arguments passed to IoTHubMessage_GetByteArraySegments is NULL IoTHubMessage_GetByteArraySegments shall return IOTHUB_MESSAGE_INVALID_ARG.]*/
+TEST_FUNCTION(IoTHubMessage_GetByteArraySegments_with_NULL_handle_fails)
+{
+    //arrange
+    const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT* segments;
+    size_t segmentCount;
+
+    //act
+    IOTHUB_MESSAGE_RESULT r = IoTHubMessage_GetByteArraySegments(NULL, &segments, &segmentCount);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_10_025: [If any of the arguments passed to IoTHubMessage_GetByteArraySegments is NULL IoTHubMessage_GetByteArraySegments shall return IOTHUB_MESSAGE_INVALID_ARG.]*/
+TEST_FUNCTION(IoTHubMessage_GetByteArraySegments_with_NULL_segmentCount_fails)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT* segments;
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT r = IoTHubMessage_GetByteArraySegments(h, &segments, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_10_026: [If iotHubMessageHandle is not a iothubmessage containing BYTEARRAY data, IoTHubMessage_GetByteArraySegments shall return IOTHUB_MESSAGE_INVALID_ARG.]*/
+TEST_FUNCTION(IoTHubMessage_GetByteArraySegments_with_STRING_fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT* segments;
+    size_t segmentCount;
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT r = IoTHubMessage_GetByteArraySegments(h, &segments, &segmentCount);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_03_001: [IoTHubMessage_Clone shall create a new IoT hub message with data content identical to that of the iotHubMessageHandle parameter.]*/
+/*Tests_SRS_IOTHUBMESSAGE_10_007: [Otherwise, IoTHubMessage_Clone shall share the content of iotHubMessageHandle with the new message by incrementing its reference count.]*/
+/*Tests_SRS_IOTHUBMESSAGE_03_002: [IoTHubMessage_Clone shall return upon success a non-NULL handle to the newly created IoT hub message.]*/
+TEST_FUNCTION(IoTHubMessage_Clone_with_BYTE_ARRAY_happy_path)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    //act
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+
+    //assert
+    ASSERT_IS_NOT_NULL(r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubMessage_Destroy(r);
+    IoTHubMessage_Destroy(h);
+}
+
+TEST_FUNCTION(IoTHubMessage_Clone_handle_NULL_fail)
+{
+    //arrange
+
+
+    //act
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(NULL);
+
+    //assert
+    ASSERT_IS_NULL(r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
+TEST_FUNCTION(IoTHubMessage_Clone_with_BYTE_ARRAY_fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    umock_c_reset_all_calls();
+
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    umock_c_negative_tests_snapshot();
+
+    //act
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubMessage_Clone failure in test %zu/%zu", index, count);
+
+        IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+
+        //assert
+        ASSERT_IS_NULL_WITH_MSG(r, tmp_msg);
+    }
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+    umock_c_negative_tests_deinit();
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_03_001: [IoTHubMessage_Clone shall create a new IoT hub message with data content identical to that of the iotHubMessageHandle parameter.]*/
+/*Tests_SRS_IOTHUBMESSAGE_10_007: [Otherwise, IoTHubMessage_Clone shall share the content of iotHubMessageHandle with the new message by incrementing its reference count.]*/
+/*Tests_SRS_IOTHUBMESSAGE_03_002: [IoTHubMessage_Clone shall return upon success a non-NULL handle to the newly created IoT hub message.]*/
+TEST_FUNCTION(IoTHubMessage_Clone_with_STRING_happy_path)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    ///act
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubMessage_Destroy(r);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_03_004: [IoTHubMessage_Clone shall return NULL if it fails for any reason.]*/
+TEST_FUNCTION(IoTHubMessage_Clone_with_STRING_fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    umock_c_reset_all_calls();
+
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+
+    umock_c_negative_tests_snapshot();
+
+    //act
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubMessage_Clone_w_string failure in test %zu/%zu", index, count);
+
+        IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+
+        //assert
+        ASSERT_IS_NULL_WITH_MSG(r, tmp_msg);
+    }
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+    umock_c_negative_tests_deinit();
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_02_002: [Otherwise, for any non-NULL iotHubMessageHandle it shall return a non-NULL MAP_HANDLE.] */
+TEST_FUNCTION(IoTHubMessage_Properties_happy_path)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    umock_c_reset_all_calls();
+
+    //act
+    MAP_HANDLE r = IoTHubMessage_Properties(h);
+
+    //assert
+    ASSERT_IS_NOT_NULL(r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_10_007: [Otherwise, IoTHubMessage_Clone shall share the content of iotHubMessageHandle with the new message by incrementing its reference count.]*/
+TEST_FUNCTION(IoTHubMessage_Clone_shares_the_content)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+    umock_c_reset_all_calls();
+
+    //act
+    const char* original = IoTHubMessage_GetString(h);
+    const char* clone = IoTHubMessage_GetString(r);
+
+    //assert
+    ASSERT_ARE_EQUAL(void_ptr, (void*)original, (void*)clone);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(r);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_01_003: [IoTHubMessage_Destroy shall free all resources associated with iotHubMessageHandle.]  */
+TEST_FUNCTION(IoTHubMessage_Destroy_of_a_clone_keeps_the_shared_content)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_free(r));
+
+    //act
+    IoTHubMessage_Destroy(r);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, TEST_STRING_VALUE, IoTHubMessage_GetString(h));
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_10_008: [Before a message that shares its content with a clone is modified, its content shall be copied. Copying the content shall clone the properties map by a call to Map_Clone and shall keep sharing the body.]*/
+TEST_FUNCTION(IoTHubMessage_Properties_of_a_clone_copies_only_the_properties)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
+
+    //act
+    MAP_HANDLE cloneProperties = IoTHubMessage_Properties(r);
+
+    //assert
+    ASSERT_IS_NOT_NULL(cloneProperties);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(void_ptr, (void*)cloneProperties, (void*)IoTHubMessage_Properties(h));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)IoTHubMessage_GetString(h), (void*)IoTHubMessage_GetString(r));
+
+    //cleanup
+    IoTHubMessage_Destroy(r);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_10_010: [If the content of iotHubMessageHandle is shared and copying it fails, IoTHubMessage_Properties shall return NULL.]*/
+TEST_FUNCTION(IoTHubMessage_Properties_of_a_clone_fails)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+    umock_c_reset_all_calls();
+
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
+
+    umock_c_negative_tests_snapshot();
+
+    //act
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubMessage_Properties failure in test %zu/%zu", index, count);
+
+        MAP_HANDLE cloneProperties = IoTHubMessage_Properties(r);
+
+        //assert
+        ASSERT_IS_NULL_WITH_MSG(cloneProperties, tmp_msg);
+    }
+
+    //cleanup
+    IoTHubMessage_Destroy(r);
+    IoTHubMessage_Destroy(h);
+    umock_c_negative_tests_deinit();
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_10_041: [If the properties map of iotHubMessageHandle was returned by IoTHubMessage_Properties, IoTHubMessage_Clone shall give the new message a copy of the content, and shall fail if copying it fails.]*/
+TEST_FUNCTION(IoTHubMessage_Clone_after_IoTHubMessage_Properties_copies_the_content)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    MAP_HANDLE properties = IoTHubMessage_Properties(h);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Clone(properties));
+
+    //act
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+
+    //assert
+    ASSERT_IS_NOT_NULL(r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    /*changes made later through properties do not reach the clone, which keeps sharing the body*/
+    ASSERT_ARE_NOT_EQUAL(void_ptr, (void*)properties, (void*)IoTHubMessage_GetReadOnlyProperties(r));
+    ASSERT_ARE_EQUAL(void_ptr, (void*)IoTHubMessage_GetString(h), (void*)IoTHubMessage_GetString(r));
+
+    //cleanup
+    IoTHubMessage_Destroy(r);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_10_041: [If the properties map of iotHubMessageHandle was returned by IoTHubMessage_Properties, IoTHubMessage_Clone shall give the new message a copy of the content, and shall fail if copying it fails.]*/
+TEST_FUNCTION(IoTHubMessage_Clone_after_IoTHubMessage_Properties_fails_when_copying_the_content_fails)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    (void)IoTHubMessage_Properties(h);
+    umock_c_reset_all_calls();
+
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
+
+    umock_c_negative_tests_snapshot();
+
+    //act
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubMessage_Clone failure in test %zu/%zu", index, count);
 
         IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
 
@@ -728,21 +1421,56 @@ TEST_FUNCTION(IoTHubMessage_Clone_with_STRING_fails)
     umock_c_negative_tests_deinit();
 }
 
-/*Tests_SRS_IOTHUBMESSAGE_02_002: [Otherwise, for any non-NULL iotHubMessageHandle it shall return a non-NULL MAP_HANDLE.] */
-TEST_FUNCTION(IoTHubMessage_Properties_happy_path)
+/*Tests_SRS_IOTHUBMESSAGE_10_008: [Before a message that shares its content with a clone is modified, its content shall be copied. Copying the content shall clone the properties map by a call to Map_Clone and shall keep sharing the body.]*/
+TEST_FUNCTION(IoTHubMessage_SetMessageId_of_a_clone_does_not_change_the_original)
 {
     ///arrange
-    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_SetMessageId(h, TEST_MESSAGE_ID);
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
     umock_c_reset_all_calls();
 
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_MESSAGE_ID));
+    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_MESSAGE_ID2));
+
     //act
-    MAP_HANDLE r = IoTHubMessage_Properties(h);
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetMessageId(r, TEST_MESSAGE_ID2);
 
     //assert
-    ASSERT_IS_NOT_NULL(r);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, TEST_MESSAGE_ID, IoTHubMessage_GetMessageId(h));
+    ASSERT_ARE_EQUAL(char_ptr, TEST_MESSAGE_ID2, IoTHubMessage_GetMessageId(r));
+
+    //cleanup
+    IoTHubMessage_Destroy(r);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_10_009: [If copying the content fails, the function modifying the message shall fail.]*/
+TEST_FUNCTION(IoTHubMessage_SetMessageId_of_a_clone_fails_when_copying_the_content_fails)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetMessageId(r, TEST_MESSAGE_ID2);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_ERROR, result);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(IoTHubMessage_GetMessageId(r));
 
     //cleanup
+    IoTHubMessage_Destroy(r);
     IoTHubMessage_Destroy(h);
 }
 
@@ -761,6 +1489,43 @@ TEST_FUNCTION(IoTHubMessage_Properties_with_NULL_handle_retuns_NULL)
     //cleanup
 }
 
+/*Tests_SRS_IOTHUBMESSAGE_10_039: [If iotHubMessageHandle is NULL then IoTHubMessage_GetReadOnlyProperties shall return NULL.]*/
+TEST_FUNCTION(IoTHubMessage_GetReadOnlyProperties_with_NULL_handle_returns_NULL)
+{
+    //arrange
+
+    //act
+    MAP_HANDLE r = IoTHubMessage_GetReadOnlyProperties(NULL);
+
+    //assert
+    ASSERT_IS_NULL(r);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_10_040: [Otherwise IoTHubMessage_GetReadOnlyProperties shall return the properties map of the message without copying it, even when the content of the message is shared.]*/
+TEST_FUNCTION(IoTHubMessage_GetReadOnlyProperties_of_a_clone_does_not_copy_the_properties)
+{
+    ///arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    MAP_HANDLE originalProperties = IoTHubMessage_GetReadOnlyProperties(h);
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+    umock_c_reset_all_calls();
+
+    //act
+    MAP_HANDLE cloneProperties = IoTHubMessage_GetReadOnlyProperties(r);
+
+    //assert
+    ASSERT_IS_NOT_NULL(cloneProperties);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)originalProperties, (void*)cloneProperties);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(r);
+    IoTHubMessage_Destroy(h);
+}
+
 /*Tests_SRS_IOTHUBMESSAGE_02_008: [If any parameter is NULL then IoTHubMessage_GetContentType shall return IOTHUBMESSAGE_UNKNOWN.] */
 TEST_FUNCTION(IoTHubMessage_GetContentType_with_NULL_handle_fails)
 {
@@ -1070,6 +1835,238 @@ TEST_FUNCTION(IoTHubMessage_SetCorrelationId_CorrelationId_Not_NULL_SUCCEED)
     IoTHubMessage_Destroy(h);
 }
 
+/*Tests_SRS_IOTHUBMESSAGE_10_029: [Messages shall be created with the priority IOTHUB_MESSAGE_PRIORITY_NORMAL.]*/
+TEST_FUNCTION(IoTHubMessage_GetPriority_of_a_new_message_returns_NORMAL)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_PRIORITY result = IoTHubMessage_GetPriority(h);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_PRIORITY, IOTHUB_MESSAGE_PRIORITY_NORMAL, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_10_032: [If iotHubMessageHandle is NULL, IoTHubMessage_GetPriority shall return IOTHUB_MESSAGE_PRIORITY_NORMAL.]*/
+TEST_FUNCTION(IoTHubMessage_GetPriority_with_NULL_handle_returns_NORMAL)
+{
+    //arrange
+
+    //act
+    IOTHUB_MESSAGE_PRIORITY result = IoTHubMessage_GetPriority(NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_PRIORITY, IOTHUB_MESSAGE_PRIORITY_NORMAL, result);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_10_030: [If iotHubMessageHandle is NULL or priority is not a known value, IoTHubMessage_SetPriority shall return IOTHUB_MESSAGE_INVALID_ARG.]*/
+TEST_FUNCTION(IoTHubMessage_SetPriority_with_NULL_handle_fails)
+{
+    //arrange
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetPriority(NULL, IOTHUB_MESSAGE_PRIORITY_HIGH);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, result);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_10_030: [If iotHubMessageHandle is NULL or priority is not a known value, IoTHubMessage_SetPriority shall return IOTHUB_MESSAGE_INVALID_ARG.]*/
+TEST_FUNCTION(IoTHubMessage_SetPriority_with_unknown_priority_fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetPriority(h, (IOTHUB_MESSAGE_PRIORITY)(IOTHUB_MESSAGE_PRIORITY_HIGH + 1));
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_PRIORITY, IOTHUB_MESSAGE_PRIORITY_NORMAL, IoTHubMessage_GetPriority(h));
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_10_031: [IoTHubMessage_SetPriority shall save priority and return IOTHUB_MESSAGE_OK.]*/
+/*Tests_SRS_IOTHUBMESSAGE_10_033: [IoTHubMessage_GetPriority shall return the priority of the message.]*/
+TEST_FUNCTION(IoTHubMessage_SetPriority_succeeds)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetPriority(h, IOTHUB_MESSAGE_PRIORITY_HIGH);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_PRIORITY, IOTHUB_MESSAGE_PRIORITY_HIGH, IoTHubMessage_GetPriority(h));
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_10_008: [Before a message that shares its content with a clone is modified, its content shall be copied. Copying the content shall clone the properties map by a call to Map_Clone and shall keep sharing the body.]*/
+TEST_FUNCTION(IoTHubMessage_SetPriority_of_a_clone_does_not_change_the_original)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_SetPriority(h, IOTHUB_MESSAGE_PRIORITY_LOW);
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetPriority(r, IOTHUB_MESSAGE_PRIORITY_HIGH);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_PRIORITY, IOTHUB_MESSAGE_PRIORITY_LOW, IoTHubMessage_GetPriority(h));
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_PRIORITY, IOTHUB_MESSAGE_PRIORITY_HIGH, IoTHubMessage_GetPriority(r));
+
+    //cleanup
+    IoTHubMessage_Destroy(r);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_10_007: [Otherwise, IoTHubMessage_Clone shall share the content of iotHubMessageHandle with the new message by incrementing its reference count.]*/
+TEST_FUNCTION(IoTHubMessage_SetPriority_of_a_clone_to_the_same_priority_keeps_sharing_the_content)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetPriority(r, IOTHUB_MESSAGE_PRIORITY_NORMAL);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(r);
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_10_034: [Messages shall be created with the delivery IOTHUB_MESSAGE_DELIVERY_DEFAULT.]*/
+TEST_FUNCTION(IoTHubMessage_GetDelivery_of_a_new_message_returns_DEFAULT)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_DELIVERY result = IoTHubMessage_GetDelivery(h);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_DELIVERY, IOTHUB_MESSAGE_DELIVERY_DEFAULT, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_10_037: [If iotHubMessageHandle is NULL, IoTHubMessage_GetDelivery shall return IOTHUB_MESSAGE_DELIVERY_DEFAULT.]*/
+TEST_FUNCTION(IoTHubMessage_GetDelivery_with_NULL_handle_returns_DEFAULT)
+{
+    //arrange
+
+    //act
+    IOTHUB_MESSAGE_DELIVERY result = IoTHubMessage_GetDelivery(NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_DELIVERY, IOTHUB_MESSAGE_DELIVERY_DEFAULT, result);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_10_035: [If iotHubMessageHandle is NULL or delivery is not a known value, IoTHubMessage_SetDelivery shall return IOTHUB_MESSAGE_INVALID_ARG.]*/
+TEST_FUNCTION(IoTHubMessage_SetDelivery_with_NULL_handle_fails)
+{
+    //arrange
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetDelivery(NULL, IOTHUB_MESSAGE_DELIVERY_AT_MOST_ONCE);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, result);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_10_035: [If iotHubMessageHandle is NULL or delivery is not a known value, IoTHubMessage_SetDelivery shall return IOTHUB_MESSAGE_INVALID_ARG.]*/
+TEST_FUNCTION(IoTHubMessage_SetDelivery_with_unknown_delivery_fails)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetDelivery(h, (IOTHUB_MESSAGE_DELIVERY)(IOTHUB_MESSAGE_DELIVERY_AT_MOST_ONCE + 1));
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_DELIVERY, IOTHUB_MESSAGE_DELIVERY_DEFAULT, IoTHubMessage_GetDelivery(h));
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_10_036: [IoTHubMessage_SetDelivery shall save delivery and return IOTHUB_MESSAGE_OK.]*/
+/*Tests_SRS_IOTHUBMESSAGE_10_038: [IoTHubMessage_GetDelivery shall return the delivery of the message.]*/
+TEST_FUNCTION(IoTHubMessage_SetDelivery_succeeds)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromString(TEST_STRING_VALUE);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetDelivery(h, IOTHUB_MESSAGE_DELIVERY_AT_MOST_ONCE);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_DELIVERY, IOTHUB_MESSAGE_DELIVERY_AT_MOST_ONCE, IoTHubMessage_GetDelivery(h));
+
+    //cleanup
+    IoTHubMessage_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBMESSAGE_10_008: [Before a message that shares its content with a clone is modified, its content shall be copied. Copying the content shall clone the properties map by a call to Map_Clone and shall keep sharing the body.]*/
+TEST_FUNCTION(IoTHubMessage_SetDelivery_of_a_clone_does_not_change_the_original)
+{
+    //arrange
+    IOTHUB_MESSAGE_HANDLE h = IoTHubMessage_CreateFromByteArray(c, 1);
+    (void)IoTHubMessage_SetDelivery(h, IOTHUB_MESSAGE_DELIVERY_AT_LEAST_ONCE);
+    IOTHUB_MESSAGE_HANDLE r = IoTHubMessage_Clone(h);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(Map_Clone(IGNORED_PTR_ARG));
+
+    //act
+    IOTHUB_MESSAGE_RESULT result = IoTHubMessage_SetDelivery(r, IOTHUB_MESSAGE_DELIVERY_AT_MOST_ONCE);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_RESULT, IOTHUB_MESSAGE_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_DELIVERY, IOTHUB_MESSAGE_DELIVERY_AT_LEAST_ONCE, IoTHubMessage_GetDelivery(h));
+    ASSERT_ARE_EQUAL(IOTHUB_MESSAGE_DELIVERY, IOTHUB_MESSAGE_DELIVERY_AT_MOST_ONCE, IoTHubMessage_GetDelivery(r));
+
+    //cleanup
+    IoTHubMessage_Destroy(r);
+    IoTHubMessage_Destroy(h);
+}
+
 // Tests_SRS_IOTHUBMESSAGE_09_004: [If IoTHubMessage_SetContentTypeSystemProperty finishes successfully it shall return IOTHUB_MESSAGE_OK.]
 TEST_FUNCTION(IoTHubMessage_SetContentTypeSystemProperty_SUCCEED)
 {
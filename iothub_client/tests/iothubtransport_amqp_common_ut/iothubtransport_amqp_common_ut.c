@@ -86,7 +86,7 @@ extern "C"
 
 #define ENABLE_MOCKS
 #include "azure_c_shared_utility/gballoc.h"
-#include "azure_c_shared_utility/singlylinkedlist.h"
+#include "device_index.h"
 #include "azure_c_shared_utility/doublylinkedlist.h"
 #include "azure_c_shared_utility/platform.h"
 #include "azure_c_shared_utility/strings.h"
@@ -154,21 +154,22 @@ extern "C"
     }
 
 
-    // singlylinkedlist
+    // device_index
     static int saved_registered_devices_list_count;
     static const void* saved_registered_devices_list[20];
 
-    static bool TEST_singlylinkedlist_add_fail_return = false;
-    static LIST_ITEM_HANDLE TEST_singlylinkedlist_add(SINGLYLINKEDLIST_HANDLE list, const void* item)
+    static bool TEST_device_index_add_fail_return = false;
+    static DEVICE_INDEX_ITEM_HANDLE TEST_device_index_add(DEVICE_INDEX_HANDLE list, const char* device_id, const void* item)
     {
         (void)list;
+        (void)device_id;
         saved_registered_devices_list[saved_registered_devices_list_count++] = item;
 
-        return TEST_singlylinkedlist_add_fail_return ? NULL : (LIST_ITEM_HANDLE)item;
+        return TEST_device_index_add_fail_return ? NULL : (DEVICE_INDEX_ITEM_HANDLE)item;
     }
 
-    static int TEST_singlylinkedlist_remove_return = 0;
-    static int TEST_singlylinkedlist_remove(SINGLYLINKEDLIST_HANDLE list, LIST_ITEM_HANDLE item)
+    static int TEST_device_index_remove_return = 0;
+    static int TEST_device_index_remove(DEVICE_INDEX_HANDLE list, DEVICE_INDEX_ITEM_HANDLE item)
     {
         (void)list;
         const void** TEST_list = NULL;
@@ -199,33 +200,27 @@ extern "C"
         return item_found == 1 ? 0 : 1;
     }
 
-    static LIST_ITEM_HANDLE TEST_singlylinkedlist_find(SINGLYLINKEDLIST_HANDLE list, LIST_MATCH_FUNCTION match_function, const void* match_context)
+    static DEVICE_INDEX_ITEM_HANDLE TEST_device_index_find(DEVICE_INDEX_HANDLE list, const char* device_id)
     {
         (void)list;
-        (void)match_function;
-        return (LIST_ITEM_HANDLE)match_context;
+        return (DEVICE_INDEX_ITEM_HANDLE)device_id;
     }
 
-    static SINGLYLINKEDLIST_HANDLE TEST_singlylinkedlist_foreach_list;
-    static LIST_ACTION_FUNCTION TEST_singlylinkedlist_foreach_action_function;
-    static const void* TEST_singlylinkedlist_foreach_context;
-    static int TEST_singlylinkedlist_foreach(SINGLYLINKEDLIST_HANDLE list, LIST_ACTION_FUNCTION action_function, const void* action_context)
+    static size_t TEST_device_index_get_count(DEVICE_INDEX_HANDLE list)
     {
-        TEST_singlylinkedlist_foreach_list = list;
-        TEST_singlylinkedlist_foreach_action_function = action_function;
-        TEST_singlylinkedlist_foreach_context = action_context;
-        return 0;
+        (void)list;
+        return (size_t)saved_registered_devices_list_count;
     }
 
-    static const void* TEST_singlylinkedlist_item_get_value(LIST_ITEM_HANDLE item_handle)
+    static const void* TEST_device_index_item_get_value(DEVICE_INDEX_ITEM_HANDLE item_handle)
     {
         return (const void*)item_handle;
     }
 
-    static LIST_ITEM_HANDLE TEST_singlylinkedlist_get_head_item(SINGLYLINKEDLIST_HANDLE list)
+    static DEVICE_INDEX_ITEM_HANDLE TEST_device_index_get_head_item(DEVICE_INDEX_HANDLE list)
     {
         (void)list;
-        LIST_ITEM_HANDLE list_item;
+        DEVICE_INDEX_ITEM_HANDLE list_item;
 
         if (saved_registered_devices_list_count <= 0)
         {
@@ -233,15 +228,15 @@ extern "C"
         }
         else
         {
-            list_item = (LIST_ITEM_HANDLE)saved_registered_devices_list[0];
+            list_item = (DEVICE_INDEX_ITEM_HANDLE)saved_registered_devices_list[0];
         }
 
         return list_item;
     }
 
-    static LIST_ITEM_HANDLE TEST_singlylinkedlist_get_next_item(LIST_ITEM_HANDLE item_handle)
+    static DEVICE_INDEX_ITEM_HANDLE TEST_device_index_get_next_item(DEVICE_INDEX_ITEM_HANDLE item_handle)
     {
-        LIST_ITEM_HANDLE next_item = NULL;
+        DEVICE_INDEX_ITEM_HANDLE next_item = NULL;
 
         int i;
         int item_found = 0;
@@ -249,7 +244,7 @@ extern "C"
         {
             if (item_found)
             {
-                next_item = (LIST_ITEM_HANDLE)saved_registered_devices_list[i];
+                next_item = (DEVICE_INDEX_ITEM_HANDLE)saved_registered_devices_list[i];
                 break;
             }
             else if (saved_registered_devices_list[i] == (void*)item_handle)
@@ -394,10 +389,10 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 #define TEST_IOTHUB_HOST_FQDN_STRING_HANDLE        (STRING_HANDLE)0x4264
 #define TEST_IOTHUB_HOST_FQDN_CLONE_STRING_HANDLE  (STRING_HANDLE)0x4265
 #define TEST_PROTOCOL_PROVIDER                     (IOTHUB_CLIENT_TRANSPORT_PROVIDER)0x4266
-#define TEST_REGISTERED_DEVICES_LIST               (SINGLYLINKEDLIST_HANDLE)0x4267
+#define TEST_REGISTERED_DEVICES_LIST               (DEVICE_INDEX_HANDLE)0x4267
 #define TEST_DEVICE_ID_STRING_HANDLE               (STRING_HANDLE)0x4268
 #define TEST_DEVICE_HANDLE                         (DEVICE_HANDLE)0x4269
-#define TEST_LIST_ITEM_HANDLE                      (LIST_ITEM_HANDLE)0x4270
+#define TEST_DEVICE_INDEX_ITEM_HANDLE              (DEVICE_INDEX_ITEM_HANDLE)0x4270
 #define TEST_AMQP_CONNECTION_HANDLE                (AMQP_CONNECTION_HANDLE)0x4271
 #define TEST_IOTHUB_MESSAGE_LIST_HANDLE            (IOTHUB_MESSAGE_LIST*)0x4272
 #define TEST_IOTHUB_DEVICE_HANDLE                  (IOTHUB_DEVICE_HANDLE)0x4273
@@ -440,7 +435,7 @@ static void set_expected_calls_for_Create(IOTHUBTRANSPORT_CONFIG* transport_conf
         STRING_construct_sprintf_result = TEST_IOTHUB_HOST_FQDN_STRING_HANDLE;
     }
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_create())
+    STRICT_EXPECTED_CALL(device_index_create())
         .SetReturn(TEST_REGISTERED_DEVICES_LIST);
 }
 
@@ -461,10 +456,9 @@ static void set_expected_calls_for_is_device_registered_ex(IOTHUB_DEVICE_CONFIG*
 {
     (void)device_config;
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(device_index_find(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
-        .IgnoreArgument(3)
-        .SetReturn((LIST_ITEM_HANDLE)registered_device);
+        .SetReturn((DEVICE_INDEX_ITEM_HANDLE)registered_device);
 }
 
 static MESSAGE_DISPOSITION_CONTEXT* TRANSPORT_CONTEXT_DATA_create2(IOTHUB_DEVICE_HANDLE device_handle)
@@ -553,7 +547,7 @@ static void set_expected_calls_for_Register(IOTHUB_DEVICE_CONFIG* device_config,
     STRICT_EXPECTED_CALL(STRING_c_str(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE))
         .SetReturn(TEST_IOTHUB_HOST_FQDN_CHAR_PTR);
     EXPECTED_CALL(device_create(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST))
+    STRICT_EXPECTED_CALL(device_index_get_head_item(TEST_REGISTERED_DEVICES_LIST))
         .SetReturn(NULL);
 
     STRICT_EXPECTED_CALL(STRING_c_str(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE)).SetReturn(TEST_IOTHUB_HOST_FQDN_CHAR_PTR);
@@ -573,8 +567,8 @@ static void set_expected_calls_for_Register(IOTHUB_DEVICE_CONFIG* device_config,
             .IgnoreArgument(3);
     }
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_add(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG))
-        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(device_index_add(TEST_REGISTERED_DEVICES_LIST, device_config->deviceId, IGNORED_PTR_ARG))
+        .IgnoreArgument(3);
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
 }
 
@@ -583,12 +577,11 @@ static void set_expected_calls_for_Unregister(IOTHUB_DEVICE_HANDLE iothub_device
     STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE))
         .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(device_index_find(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
-        .IgnoreArgument(3)
-        .SetReturn((LIST_ITEM_HANDLE)iothub_device_handle);
+        .SetReturn((DEVICE_INDEX_ITEM_HANDLE)iothub_device_handle);
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(device_index_remove(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG))
         .IgnoreArgument(2);
 
     STRICT_EXPECTED_CALL(iothubtransportamqp_methods_destroy(TEST_IOTHUBTRANSPORTAMQP_METHODS));
@@ -703,7 +696,7 @@ static void set_expected_calls_for_get_new_underlying_io_transport(bool feed_opt
 
 static void set_expected_calls_for_DoWork2(PDLIST_ENTRY wts, int wts_length, DEVICE_STATE current_device_state, bool is_tls_io_acquired, bool feed_options, bool is_using_cbs, bool is_connection_created, bool is_connection_open, int number_of_registered_devices, time_t current_time, bool subscribe_for_methods)
 {
-    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST));
+    STRICT_EXPECTED_CALL(device_index_get_head_item(TEST_REGISTERED_DEVICES_LIST));
 
     if (!is_tls_io_acquired)
     {
@@ -722,9 +715,9 @@ static void set_expected_calls_for_DoWork2(PDLIST_ENTRY wts, int wts_length, DEV
         int i;
         for (i = 0; i < number_of_registered_devices; i++)
         {
-            EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+            EXPECTED_CALL(device_index_item_get_value(IGNORED_PTR_ARG));
             set_expected_calls_for_Device_DoWork(wts, wts_length, current_device_state, is_using_cbs, current_time, subscribe_for_methods);
-            EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+            EXPECTED_CALL(device_index_get_next_item(IGNORED_PTR_ARG));
         }
     }
 
@@ -741,17 +734,17 @@ static void set_expected_calls_for_DoWork(PDLIST_ENTRY wts, int wts_length, DEVI
 
 static void set_expected_calls_for_Destroy(int number_of_registered_devices, IOTHUB_DEVICE_HANDLE* registered_devices)
 {
-    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST));
+    STRICT_EXPECTED_CALL(device_index_get_head_item(TEST_REGISTERED_DEVICES_LIST));
 
     int i;
     for (i = 0; i < number_of_registered_devices; i++)
     {
-        EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
-        EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+        EXPECTED_CALL(device_index_item_get_value(IGNORED_PTR_ARG));
+        EXPECTED_CALL(device_index_get_next_item(IGNORED_PTR_ARG));
         set_expected_calls_for_Unregister(registered_devices[i]);
     }
     
-    STRICT_EXPECTED_CALL(singlylinkedlist_destroy(TEST_REGISTERED_DEVICES_LIST));
+    STRICT_EXPECTED_CALL(device_index_destroy(TEST_REGISTERED_DEVICES_LIST));
     STRICT_EXPECTED_CALL(amqp_connection_destroy(TEST_AMQP_CONNECTION_HANDLE));
     STRICT_EXPECTED_CALL(xio_destroy(TEST_UNDERLYING_IO_TRANSPORT));
     STRICT_EXPECTED_CALL(retry_control_destroy(TEST_RETRY_CONTROL_HANDLE));
@@ -794,14 +787,14 @@ static void set_expected_calls_for_prepare_for_connection_retry(int number_of_re
     STRICT_EXPECTED_CALL(xio_retrieveoptions(TEST_UNDERLYING_IO_TRANSPORT))
         .SetReturn(TEST_OPTIONHANDLER_HANDLE);
 
-    EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
+    EXPECTED_CALL(device_index_get_head_item(IGNORED_PTR_ARG));
 
     int i;
     for (i = 0; i < number_of_registered_devices; i++)
     {
-        EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+        EXPECTED_CALL(device_index_item_get_value(IGNORED_PTR_ARG));
         set_expected_calls_for_prepare_device_for_connection_retry(current_device_state);
-        EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+        EXPECTED_CALL(device_index_get_next_item(IGNORED_PTR_ARG));
     }
 
     STRICT_EXPECTED_CALL(amqp_connection_destroy(TEST_AMQP_CONNECTION_HANDLE));
@@ -891,6 +884,17 @@ static DEVICE_HANDLE TEST_device_create(DEVICE_CONFIG* config)
     return TEST_device_create_return;
 }
 
+static ON_DEVICE_D2C_EVENT_SEND_COMPLETE TEST_device_send_event_async_saved_callback;
+static void* TEST_device_send_event_async_saved_context;
+static int TEST_device_send_event_async(DEVICE_HANDLE handle, IOTHUB_MESSAGE_LIST* message, ON_DEVICE_D2C_EVENT_SEND_COMPLETE on_device_d2c_event_send_complete_callback, void* context)
+{
+    (void)handle;
+    (void)message;
+    TEST_device_send_event_async_saved_callback = on_device_d2c_event_send_complete_callback;
+    TEST_device_send_event_async_saved_context = context;
+    return 0;
+}
+
 static bool g_MessageCallback_return;
 bool TEST_IoTHubClient_LL_MessageCallback(IOTHUB_CLIENT_LL_HANDLE handle, MESSAGE_CALLBACK_INFO* messageData)
 {
@@ -1062,6 +1066,7 @@ static void register_umock_alias_types()
     REGISTER_UMOCK_ALIAS_TYPE(DEVICE_MESSAGE_DISPOSITION_RESULT, int);
     REGISTER_UMOCK_ALIAS_TYPE(DEVICE_SEND_STATUS, int);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_CONFIRMATION_RESULT, int);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_CONNECTION_STATUS, int);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_CONNECTION_STATUS_REASON, int);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_STATUS, int);
@@ -1072,8 +1077,6 @@ static void register_umock_alias_types()
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUBMESSAGE_CONTENT_TYPE, int);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUBMESSAGE_DISPOSITION_RESULT, int);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUBTRANSPORT_AMQP_METHOD_HANDLE, void*);
-    REGISTER_UMOCK_ALIAS_TYPE(LIST_ACTION_FUNCTION, void*);
-    REGISTER_UMOCK_ALIAS_TYPE(LIST_MATCH_FUNCTION, void*);
     REGISTER_UMOCK_ALIAS_TYPE(MAP_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(MAP_RESULT, int);
     REGISTER_UMOCK_ALIAS_TYPE(METHOD_HANDLE, void*);
@@ -1097,8 +1100,8 @@ static void register_umock_alias_types()
     REGISTER_UMOCK_ALIAS_TYPE(PROPERTIES_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(RETRY_CONTROL_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(SESSION_HANDLE, void*);
-    REGISTER_UMOCK_ALIAS_TYPE(SINGLYLINKEDLIST_HANDLE, void*);
-    REGISTER_UMOCK_ALIAS_TYPE(LIST_ITEM_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(DEVICE_INDEX_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(DEVICE_INDEX_ITEM_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(time_t, int);
     REGISTER_UMOCK_ALIAS_TYPE(XIO_HANDLE, void*);
@@ -1117,13 +1120,13 @@ static void register_global_mock_hooks()
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
     REGISTER_GLOBAL_MOCK_HOOK(iothubtransportamqp_methods_subscribe, my_iothubtransportamqp_methods_subscribe);
 
-    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_add, TEST_singlylinkedlist_add);
-    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_remove, TEST_singlylinkedlist_remove);
-    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_get_head_item, TEST_singlylinkedlist_get_head_item);
-    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_get_next_item, TEST_singlylinkedlist_get_next_item);
-    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_find, TEST_singlylinkedlist_find);
-    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_foreach, TEST_singlylinkedlist_foreach);
-    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_item_get_value, TEST_singlylinkedlist_item_get_value);
+    REGISTER_GLOBAL_MOCK_HOOK(device_index_add, TEST_device_index_add);
+    REGISTER_GLOBAL_MOCK_HOOK(device_index_remove, TEST_device_index_remove);
+    REGISTER_GLOBAL_MOCK_HOOK(device_index_get_head_item, TEST_device_index_get_head_item);
+    REGISTER_GLOBAL_MOCK_HOOK(device_index_get_next_item, TEST_device_index_get_next_item);
+    REGISTER_GLOBAL_MOCK_HOOK(device_index_find, TEST_device_index_find);
+    REGISTER_GLOBAL_MOCK_HOOK(device_index_get_count, TEST_device_index_get_count);
+    REGISTER_GLOBAL_MOCK_HOOK(device_index_item_get_value, TEST_device_index_item_get_value);
 
     REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveEntryList, my_DList_RemoveEntryList);
     REGISTER_GLOBAL_MOCK_HOOK(DList_InsertTailList, my_DList_InsertTailList);
@@ -1137,6 +1140,7 @@ static void register_global_mock_hooks()
     REGISTER_GLOBAL_MOCK_HOOK(get_difftime, TEST_get_difftime);
 
     REGISTER_GLOBAL_MOCK_HOOK(device_create, TEST_device_create);
+    REGISTER_GLOBAL_MOCK_HOOK(device_send_event_async, TEST_device_send_event_async);
     REGISTER_GLOBAL_MOCK_HOOK(device_subscribe_message, TEST_device_subscribe_message);
 
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_LL_MessageCallback, TEST_IoTHubClient_LL_MessageCallback);
@@ -1157,7 +1161,7 @@ static void register_global_mock_returns()
     REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_create_symbol, TEST_AMQP_VALUE);
     REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_create_string, TEST_AMQP_VALUE);
 
-    REGISTER_GLOBAL_MOCK_FAIL_RETURN(singlylinkedlist_create, NULL);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(device_index_create, NULL);
 
     REGISTER_GLOBAL_MOCK_RETURN(device_start_async, 0);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(device_start_async, 1);
@@ -1210,6 +1214,9 @@ static void initialize_static_variables()
     TEST_device_create_saved_on_state_changed_context = NULL;
     TEST_device_create_return = TEST_DEVICE_HANDLE;
 
+    TEST_device_send_event_async_saved_callback = NULL;
+    TEST_device_send_event_async_saved_context = NULL;
+
     saved_registered_devices_list_count = 0;
 
     TEST_device_subscribe_message_saved_callback = NULL;
@@ -1219,9 +1226,6 @@ static void initialize_static_variables()
     TEST_MESSAGE_ID = 1234;
     TEST_mallocAndStrcpy_s_return = 0;
 
-    TEST_singlylinkedlist_foreach_list = NULL;
-    TEST_singlylinkedlist_foreach_action_function = NULL;
-    TEST_singlylinkedlist_foreach_context = NULL;
 }
 
 static void initialize_test_variables()
@@ -1710,6 +1714,55 @@ TEST_FUNCTION(IoTHubTransport_AMQP_Common_DoWork_does_not_subscribe_if_already_s
     destroy_transport(handle, device_handle, NULL);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_10_010: [`message` shall be placed alone in a list and passed to IoTHubClient_LL_SendComplete with the `iothub_send_result`, which invokes the callback, destroys the message and releases the entry]
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_on_event_send_complete_hands_batch_entries_to_SendComplete)
+{
+    // arrange
+    IOTHUB_MESSAGE_LIST batch[3];
+    size_t i;
+
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
+
+    crank_transport_ready_after_create(handle, &TEST_waitingToSend, 0, false, true, 1, TEST_current_time, false);
+
+    // The entries of a batch share one allocation, so the transport must never free them itself.
+    memset(batch, 0, sizeof(batch));
+    for (i = 0; i < 3; i++)
+    {
+        batch[i].messageHandle = TEST_IOTHUB_MESSAGE_HANDLE;
+        real_DList_InsertTailList(&TEST_waitingToSend, &(batch[i].entry));
+    }
+
+    crank_transport(handle, &TEST_waitingToSend, 3, DEVICE_STATE_STARTED, true, true, true, true, 1, TEST_current_time, false);
+    ASSERT_IS_NOT_NULL(TEST_device_send_event_async_saved_callback);
+
+    umock_c_reset_all_calls();
+    for (i = 0; i < 3; i++)
+    {
+        STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, &(batch[i].entry)))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK))
+            .IgnoreArgument(2);
+    }
+
+    // act
+    for (i = 0; i < 3; i++)
+    {
+        TEST_device_send_event_async_saved_callback(&batch[i], D2C_EVENT_SEND_COMPLETE_RESULT_OK, TEST_device_send_event_async_saved_context);
+    }
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, device_handle, NULL);
+}
+
 /* on_methods_request_received */
 
 /* Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_01_028: [ On success, `on_methods_request_received` shall return 0. ]*/
@@ -1956,7 +2009,7 @@ TEST_FUNCTION(GetHostName_success)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_003: [Memory shall be allocated for the transport's internal state structure (`instance`)]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_005: [If `config->upperConfig->protocolGatewayHostName` is NULL, `instance->iothub_target_fqdn` shall be set as `config->upperConfig->iotHubName` + "." + `config->upperConfig->iotHubSuffix`]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_006: [If `config->upperConfig->protocolGatewayHostName` is not NULL, `instance->iothub_target_fqdn` shall be set with a copy of it]
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_008: [`instance->registered_devices` shall be set using singlylinkedlist_create()]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_008: [`instance->registered_devices` shall be set using device_index_create()]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_010: [`get_io_transport` shall be saved on `instance->underlying_io_transport_provider`]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_012: [If IoTHubTransport_AMQP_Common_Create succeeds it shall return a pointer to `instance`.]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_124: [`instance->connection_retry_control` shall be set using retry_control_create(), passing defaults EXPONENTIAL_BACKOFF_WITH_JITTER and 0]
@@ -1983,7 +2036,7 @@ TEST_FUNCTION(Create_success)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_002: [IoTHubTransport_AMQP_Common_Create shall fail and return NULL if `config->upperConfig->protocol` is NULL]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_004: [If malloc() fails, IoTHubTransport_AMQP_Common_Create shall fail and return NULL]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_007: [If `instance->iothub_target_fqdn` fails to be set, IoTHubTransport_AMQP_Common_Create shall fail and return NULL]
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_009: [If singlylinkedlist_create() fails, IoTHubTransport_AMQP_Common_Create shall fail and return NULL]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_009: [If device_index_create() fails, IoTHubTransport_AMQP_Common_Create shall fail and return NULL]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_011: [If IoTHubTransport_AMQP_Common_Create fails it shall free any memory it allocated]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_125: [If retry_control_create() fails, IoTHubTransport_AMQP_Common_Create shall fail and return NULL]
 TEST_FUNCTION(Create_failure_checks)
@@ -2160,9 +2213,8 @@ TEST_FUNCTION(Register_device_already_registered)
 
     IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG, device_config->deviceId))
-        .IgnoreArgument(2)
-        .SetReturn(TEST_LIST_ITEM_HANDLE);
+    STRICT_EXPECTED_CALL(device_index_find(TEST_REGISTERED_DEVICES_LIST, device_config->deviceId))
+        .SetReturn(TEST_DEVICE_INDEX_ITEM_HANDLE);
 
     // act
     IOTHUB_DEVICE_HANDLE device_handle = IoTHubTransport_AMQP_Common_Register(handle, device_config, TEST_IOTHUB_CLIENT_LL_HANDLE, &TEST_waitingToSend);
@@ -2191,8 +2243,7 @@ TEST_FUNCTION(Register_CBS_transport_X509_credentials)
 
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG, device_config2->deviceId))
-        .IgnoreArgument(2)
+    STRICT_EXPECTED_CALL(device_index_find(TEST_REGISTERED_DEVICES_LIST, device_config2->deviceId))
         .SetReturn(NULL);
 
     // act
@@ -2223,8 +2274,7 @@ TEST_FUNCTION(Register_X509_transport_CBS_credentials)
 
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG, device_config2->deviceId))
-        .IgnoreArgument(2)
+    STRICT_EXPECTED_CALL(device_index_find(TEST_REGISTERED_DEVICES_LIST, device_config2->deviceId))
         .SetReturn(NULL);
 
     // act
@@ -2294,7 +2344,7 @@ TEST_FUNCTION(Register_failure_checks)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_071: [`amqp_device_instance->device_handle` shall be set using device_create()]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_072: [The configuration for device_create shall be set according to the authentication preferred by IOTHUB_DEVICE_CONFIG]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_01_010: [ `IoTHubTransport_AMQP_Common_Register` shall create a new iothubtransportamqp_methods instance by calling `iothubtransportamqp_methods_create` while passing to it the the fully qualified domain name and the device Id]
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_074: [IoTHubTransport_AMQP_Common_Register shall add the `amqp_device_instance` to `instance->registered_devices`]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_074: [IoTHubTransport_AMQP_Common_Register shall add the `amqp_device_instance` to `instance->registered_devices` under `device->deviceId`]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_076: [If the device is the first being registered on the transport, IoTHubTransport_AMQP_Common_Register shall save its authentication mode as the transport preferred authentication mode]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_078: [IoTHubTransport_AMQP_Common_Register shall return a handle to `amqp_device_instance` as a IOTHUB_DEVICE_HANDLE]
 TEST_FUNCTION(Register_succeeds)
@@ -2644,6 +2694,44 @@ TEST_FUNCTION(GetSendStatus_BUSY_succeeds)
     destroy_transport(handle, device_handle, NULL);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_10_005: [If `handle` or `msToNextWork` are NULL, IoTHubTransport_AMQP_Common_GetNextWorkDeadline shall return IOTHUB_CLIENT_INVALID_ARG]
+TEST_FUNCTION(GetNextWorkDeadline_NULL_handle)
+{
+    // arrange
+    initialize_test_variables();
+    umock_c_reset_all_calls();
+
+    uint64_t ms_to_next_work;
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_GetNextWorkDeadline(NULL, &ms_to_next_work);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_10_005: [If `handle` or `msToNextWork` are NULL, IoTHubTransport_AMQP_Common_GetNextWorkDeadline shall return IOTHUB_CLIENT_INVALID_ARG]
+TEST_FUNCTION(GetNextWorkDeadline_NULL_msToNextWork)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_GetNextWorkDeadline(handle, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, NULL, NULL);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_101: [If `handle`, `option` or `value` are NULL then IoTHubTransport_AMQP_Common_SetOption shall return IOTHUB_CLIENT_INVALID_ARG.]
 TEST_FUNCTION(SetOption_NULL_handle)
 {
@@ -2726,8 +2814,8 @@ TEST_FUNCTION(SetOption_device_specific_failure_check)
     size_t value = 10;
 
     umock_c_reset_all_calls();
-    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST));
-    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG)).SetReturn(device_handle);
+    STRICT_EXPECTED_CALL(device_index_get_head_item(TEST_REGISTERED_DEVICES_LIST));
+    EXPECTED_CALL(device_index_item_get_value(IGNORED_PTR_ARG)).SetReturn(device_handle);
     STRICT_EXPECTED_CALL(device_set_option(TEST_DEVICE_HANDLE, DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS, &value))
         .SetReturn(1);
     STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE))
@@ -3758,14 +3846,14 @@ TEST_FUNCTION(IoTHubTransport_AMQP_Common_Destroy_frees_proxy_options)
     (void)IoTHubTransport_AMQP_Common_SetOption(handle, "proxy_data", &http_proxy_options);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST));
+    STRICT_EXPECTED_CALL(device_index_get_head_item(TEST_REGISTERED_DEVICES_LIST));
 
-    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
-    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    EXPECTED_CALL(device_index_item_get_value(IGNORED_PTR_ARG));
+    EXPECTED_CALL(device_index_get_next_item(IGNORED_PTR_ARG));
 
     set_expected_calls_for_Unregister(device_handle);
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_destroy(TEST_REGISTERED_DEVICES_LIST));
+    STRICT_EXPECTED_CALL(device_index_destroy(TEST_REGISTERED_DEVICES_LIST));
     STRICT_EXPECTED_CALL(retry_control_destroy(TEST_RETRY_CONTROL_HANDLE));
     STRICT_EXPECTED_CALL(STRING_delete(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE));
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
@@ -4069,7 +4157,7 @@ TEST_FUNCTION(DoWork_get_underlying_io_transport_provider_fails)
     ASSERT_IS_NOT_NULL(device_handle);
 
     umock_c_reset_all_calls();
-    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST));
+    STRICT_EXPECTED_CALL(device_index_get_head_item(TEST_REGISTERED_DEVICES_LIST));
     STRICT_EXPECTED_CALL(STRING_c_str(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE))
         .SetReturn(TEST_IOTHUB_HOST_FQDN_CHAR_PTR);
     TEST_amqp_get_io_transport_result = NULL;
@@ -4375,9 +4463,10 @@ TEST_FUNCTION(ConnectionStatusCallBack_UNAUTH_retry_expired)
     STRICT_EXPECTED_CALL(retry_control_should_retry(TEST_RETRY_CONTROL_HANDLE, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer_retry_action(&retry_action, sizeof(RETRY_ACTION));
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_foreach(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    
+    STRICT_EXPECTED_CALL(device_index_get_head_item(TEST_REGISTERED_DEVICES_LIST));
+    EXPECTED_CALL(device_index_item_get_value(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(IoTHubClient_LL_ConnectionStatusCallBack(TEST_IOTHUB_CLIENT_LL_HANDLE, IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED, IOTHUB_CLIENT_CONNECTION_RETRY_EXPIRED));
+    EXPECTED_CALL(device_index_get_next_item(IGNORED_PTR_ARG));
 
     // act
     TEST_amqp_connection_create_saved_on_state_changed_callback(
@@ -4386,12 +4475,6 @@ TEST_FUNCTION(ConnectionStatusCallBack_UNAUTH_retry_expired)
     
     (void)IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
 
-    bool continue_processing;
-    TEST_singlylinkedlist_foreach_action_function(
-        saved_registered_devices_list[saved_registered_devices_list_count - 1], 
-        TEST_singlylinkedlist_foreach_context, 
-        &continue_processing);
-
     // assert
     ASSERT_ARE_EQUAL(int, 0, result_set_retry_policy);
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
@@ -268,6 +268,10 @@ public:
         *iotHubClientStatus = currentIotHubClientStatus;
         MOCK_METHOD_END(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK)
 
+        MOCK_STATIC_METHOD_2(, IOTHUB_CLIENT_RESULT, FAKE_IoTHubTransport_GetNextWorkDeadline, TRANSPORT_LL_HANDLE, handle, uint64_t*, msToNextWork)
+        *msToNextWork = IOTHUB_CLIENT_LL_NO_WORK_DEADLINE;
+        MOCK_METHOD_END(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK)
+
         MOCK_STATIC_METHOD_5(, int, FAKE_IoTHubTransport_DeviceMethod_Response, IOTHUB_DEVICE_HANDLE, handle, METHOD_HANDLE, methodId, const unsigned char*, response, size_t, resp_size, int, status_response)
         MOCK_METHOD_END(int, 0)
 
@@ -298,6 +302,11 @@ public:
         MOCK_STATIC_METHOD_0(, STRING_HANDLE, STRING_new)
         MOCK_METHOD_END(STRING_HANDLE, TEST_STRING_HANDLE);
 
+        MOCK_STATIC_METHOD_2(, int, mallocAndStrcpy_s, char**, destination, const char*, source)
+        *destination = (char*)BASEIMPLEMENTATION::gballoc_malloc(strlen(source) + 1);
+        (void)strcpy(*destination, source);
+        MOCK_METHOD_END(int, 0)
+
 
     /* Version Mocks */
     MOCK_STATIC_METHOD_0(, const char*, IoTHubClient_GetVersionString)
@@ -412,6 +421,7 @@ DECLARE_GLOBAL_MOCK_METHOD_1(CIotHubTransportMocks, , void, FAKE_IoTHubTransport
 DECLARE_GLOBAL_MOCK_METHOD_2(CIotHubTransportMocks, , void, FAKE_IoTHubTransport_DoWork, TRANSPORT_LL_HANDLE, handle, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle);
 DECLARE_GLOBAL_MOCK_METHOD_3(CIotHubTransportMocks, , int, FAKE_IoTHubTransport_SetRetryPolicy, TRANSPORT_LL_HANDLE, handle, IOTHUB_CLIENT_RETRY_POLICY, retryPolicy, size_t, retryTimeoutLimitInSeconds);
 DECLARE_GLOBAL_MOCK_METHOD_2(CIotHubTransportMocks, , IOTHUB_CLIENT_RESULT, FAKE_IoTHubTransport_GetSendStatus, TRANSPORT_LL_HANDLE, handle, IOTHUB_CLIENT_STATUS*, iotHubClientStatus);
+DECLARE_GLOBAL_MOCK_METHOD_2(CIotHubTransportMocks, , IOTHUB_CLIENT_RESULT, FAKE_IoTHubTransport_GetNextWorkDeadline, TRANSPORT_LL_HANDLE, handle, uint64_t*, msToNextWork);
 DECLARE_GLOBAL_MOCK_METHOD_5(CIotHubTransportMocks, , int, FAKE_IoTHubTransport_DeviceMethod_Response, IOTHUB_DEVICE_HANDLE, handle, METHOD_HANDLE, methodId, const unsigned char*, response, size_t, resp_size, int, status_response);
 
 DECLARE_GLOBAL_MOCK_METHOD_2(CIotHubTransportMocks, , void, eventConfirmationCallback, IOTHUB_CLIENT_CONFIRMATION_RESULT, result2, void*, userContextCallback);
@@ -425,6 +435,7 @@ DECLARE_GLOBAL_MOCK_METHOD_2(CIotHubTransportMocks, , int, STRING_concat_with_ST
 DECLARE_GLOBAL_MOCK_METHOD_1(CIotHubTransportMocks, , void, STRING_delete, STRING_HANDLE, handle);
 DECLARE_GLOBAL_MOCK_METHOD_1(CIotHubTransportMocks, , const char*, STRING_c_str, STRING_HANDLE, s);
 DECLARE_GLOBAL_MOCK_METHOD_0(CIotHubTransportMocks, , STRING_HANDLE, STRING_new);
+DECLARE_GLOBAL_MOCK_METHOD_2(CIotHubTransportMocks, , int, mallocAndStrcpy_s, char**, destination, const char*, source);
 
 DECLARE_GLOBAL_MOCK_METHOD_0(CIotHubTransportMocks, , const char*, IoTHubClient_GetVersionString);
 
@@ -473,7 +484,8 @@ static TRANSPORT_PROVIDER FAKE_transport_provider =
     FAKE_IoTHubTransport_Unsubscribe,
     FAKE_IoTHubTransport_DoWork,
     FAKE_IoTHubTransport_SetRetryPolicy,
-    FAKE_IoTHubTransport_GetSendStatus
+    FAKE_IoTHubTransport_GetSendStatus,
+    FAKE_IoTHubTransport_GetNextWorkDeadline
 };
 
 static const TRANSPORT_PROVIDER* provideFAKE(void)
@@ -1478,5 +1490,428 @@ TEST_FUNCTION(IoTHubTransport_worker_thread_runs_lock_fails)
     IoTHubTransport_Destroy(transportHandle);
 }
 
+//Tests_SRS_IOTHUBTRANSPORT_10_001: [ If shardCount is 0, IoTHubTransport_CreateSharded shall return NULL. ]
+TEST_FUNCTION(IoTHubTransport_CreateSharded_zero_shards_returns_null)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+
+    ///act
+    auto result = IoTHubTransport_CreateSharded(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 0);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_10_002: [ IoTHubTransport_CreateSharded shall create the first shard exactly like IoTHubTransport_Create and return it as the transport handle. ]
+//Tests_SRS_IOTHUBTRANSPORT_10_003: [ If shardCount is greater than 1, IoTHubTransport_CreateSharded shall allocate the shard table, create the shard lock by calling Lock_Init and create shardCount - 1 more shards, each with its own lower layer transport, lock, client list and worker thread. ]
+TEST_FUNCTION(IoTHubTransport_CreateSharded_success_creates_one_connection_per_shard)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Create(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Init()).SetReturn(TEST_CLIENTS_LOCK_HANDLE); // clients lock
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(IOTHUB_CLIENT_HANDLE)));
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(2 * sizeof(TRANSPORT_HANDLE))); // shard table
+    STRICT_EXPECTED_CALL(mocks, Lock_Init()); // shard lock
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Create(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Init()).SetReturn(TEST_CLIENTS_LOCK_HANDLE); // clients lock
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(IOTHUB_CLIENT_HANDLE)));
+
+    ///act
+    auto result = IoTHubTransport_CreateSharded(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 2);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_Destroy(result);
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_10_004: [ If any allocation or creation fails, IoTHubTransport_CreateSharded shall destroy the shards created so far and return NULL. ]
+TEST_FUNCTION(IoTHubTransport_CreateSharded_shard_create_fails_returns_null)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    whenShallmalloc_fail = 4; /* first shard, shard table, second shard, third shard */
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Create(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(2);
+    EXPECTED_CALL(mocks, Lock_Init())
+        .ExpectedTimesExactly(5);
+    EXPECTED_CALL(mocks, VECTOR_create(IGNORED_NUM_ARG))
+        .ExpectedTimesExactly(2);
+    EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(2);
+    EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(2);
+    EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(5);
+    EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Destroy(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(2);
+    EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(2);
+    EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(3);
+
+    ///act
+    auto result = IoTHubTransport_CreateSharded(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 3);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_10_006: [ IoTHubTransport_Destroy shall stop and destroy every other shard of a sharded transport, then free the shard table and the shard lock. ]
+TEST_FUNCTION(IoTHubTransport_Destroy_sharded_destroys_every_shard)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_CreateSharded(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 2);
+    mocks.ResetAllCalls();
+
+    EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(2);
+    EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(2);
+    EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(5);
+    EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Destroy(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(2);
+    EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(2);
+    EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(3);
+
+    ///act
+    IoTHubTransport_Destroy(transportHandle);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_10_007: [ If transportHandle is NULL, IoTHubTransport_AssignShard shall return NULL. ]
+TEST_FUNCTION(IoTHubTransport_AssignShard_null_transport_returns_null)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+
+    ///act
+    TRANSPORT_HANDLE shard = IoTHubTransport_AssignShard(NULL);
+
+    ///assert
+    ASSERT_IS_NULL(shard);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_10_008: [ If the transport has a single shard, IoTHubTransport_AssignShard shall return transportHandle. ]
+TEST_FUNCTION(IoTHubTransport_AssignShard_single_shard_returns_transport)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_Create(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix);
+    mocks.ResetAllCalls();
+
+    ///act
+    TRANSPORT_HANDLE shard = IoTHubTransport_AssignShard(transportHandle);
+    IoTHubTransport_ReleaseShard(shard);
+
+    ///assert
+    ASSERT_ARE_EQUAL(void_ptr, (void*)transportHandle, (void*)shard);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_10_009: [ Otherwise IoTHubTransport_AssignShard shall, under the shard lock, return the shard with the fewest assigned clients and count the new client on it. ]
+//Tests_SRS_IOTHUBTRANSPORT_10_012: [ IoTHubTransport_ReleaseShard shall, under the shard lock, remove one client from the count of the shard. ]
+TEST_FUNCTION(IoTHubTransport_AssignShard_picks_least_loaded_shard)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_CreateSharded(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 3);
+    TRANSPORT_HANDLE shard1 = IoTHubTransport_AssignShard(transportHandle);
+    TRANSPORT_HANDLE shard2 = IoTHubTransport_AssignShard(transportHandle);
+    TRANSPORT_HANDLE shard3 = IoTHubTransport_AssignShard(transportHandle);
+    IoTHubTransport_ReleaseShard(shard2);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+
+    ///act
+    TRANSPORT_HANDLE shard4 = IoTHubTransport_AssignShard(transportHandle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(void_ptr, (void*)transportHandle, (void*)shard1);
+    ASSERT_ARE_NOT_EQUAL(void_ptr, (void*)shard1, (void*)shard2);
+    ASSERT_ARE_NOT_EQUAL(void_ptr, (void*)shard1, (void*)shard3);
+    ASSERT_ARE_NOT_EQUAL(void_ptr, (void*)shard2, (void*)shard3);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)shard2, (void*)shard4);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_10_010: [ If acquiring the shard lock fails, IoTHubTransport_AssignShard shall return NULL. ]
+TEST_FUNCTION(IoTHubTransport_AssignShard_lock_fails_returns_null)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_CreateSharded(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 2);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .SetFailReturn(LOCK_ERROR);
+
+    ///act
+    TRANSPORT_HANDLE shard = IoTHubTransport_AssignShard(transportHandle);
+
+    ///assert
+    ASSERT_IS_NULL(shard);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_10_011: [ If shardHandle is NULL or belongs to a transport with a single shard, IoTHubTransport_ReleaseShard shall do nothing. ]
+TEST_FUNCTION(IoTHubTransport_ReleaseShard_null_does_nothing)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+
+    ///act
+    IoTHubTransport_ReleaseShard(NULL);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_10_003: [ If shardCount is greater than 1, IoTHubTransport_CreateSharded shall allocate the shard table, create the shard lock by calling Lock_Init and create shardCount - 1 more shards, each with its own lower layer transport, lock, client list and worker thread. ]
+TEST_FUNCTION(IoTHubTransport_StartWorkerThread_each_shard_starts_its_own_thread)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_CreateSharded(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 2);
+    TRANSPORT_HANDLE shard1 = IoTHubTransport_AssignShard(transportHandle);
+    TRANSPORT_HANDLE shard2 = IoTHubTransport_AssignShard(transportHandle);
+    mocks.ResetAllCalls();
+
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, shard1))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(mocks, ThreadAPI_Create(IGNORED_PTR_ARG, IGNORED_PTR_ARG, shard2))
+        .IgnoreArgument(1)
+        .IgnoreArgument(2);
+    EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(2);
+    EXPECTED_CALL(mocks, VECTOR_size(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(2);
+    EXPECTED_CALL(mocks, VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1))
+        .ExpectedTimesExactly(2);
+    EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(2);
+
+    ///act
+    IOTHUB_CLIENT_RESULT result1 = IoTHubTransport_StartWorkerThread(shard1, TEST_IOTHUB_CLIENT_HANDLE1, clientDoWork);
+    IOTHUB_CLIENT_RESULT result2 = IoTHubTransport_StartWorkerThread(shard2, TEST_IOTHUB_CLIENT_HANDLE2, clientDoWork);
+
+    ///assert
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_OK, (int)result1);
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_CLIENT_OK, (int)result2);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    (void)IoTHubTransport_SignalEndWorkerThread(shard1, TEST_IOTHUB_CLIENT_HANDLE1);
+    (void)IoTHubTransport_SignalEndWorkerThread(shard2, TEST_IOTHUB_CLIENT_HANDLE2);
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_10_013: [ If protocol, iotHubName or iotHubSuffix is NULL, or maxConnections or devicesPerConnection is 0, IoTHubTransport_CreatePooled shall return NULL. ]
+TEST_FUNCTION(IoTHubTransport_CreatePooled_invalid_args_returns_null)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+
+    ///act
+    auto result1 = IoTHubTransport_CreatePooled(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 0, 10);
+    auto result2 = IoTHubTransport_CreatePooled(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 4, 0);
+    auto result3 = IoTHubTransport_CreatePooled(NULL, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 4, 10);
+
+    ///assert
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+    ASSERT_IS_NULL(result3);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_10_014: [ IoTHubTransport_CreatePooled shall open the first connection like IoTHubTransport_Create and return it as the transport handle. ]
+//Tests_SRS_IOTHUBTRANSPORT_10_015: [ IoTHubTransport_CreatePooled shall keep a copy of iotHubName and iotHubSuffix, allocate a table of maxConnections shards and create the shard lock by calling Lock_Init. ]
+TEST_FUNCTION(IoTHubTransport_CreatePooled_success_opens_one_connection)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Create(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, Lock_Init());
+    STRICT_EXPECTED_CALL(mocks, Lock_Init()).SetReturn(TEST_CLIENTS_LOCK_HANDLE); // clients lock
+    STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(IOTHUB_CLIENT_HANDLE)));
+    STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_IOTHUBNAME))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_IOTHUBSUFFIX))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(4 * sizeof(TRANSPORT_HANDLE))); // connection table
+    STRICT_EXPECTED_CALL(mocks, Lock_Init()); // connection table lock
+
+    ///act
+    auto result = IoTHubTransport_CreatePooled(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 4, 10);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_Destroy(result);
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_10_016: [ If any allocation or creation fails, IoTHubTransport_CreatePooled shall free everything it created and return NULL. ]
+TEST_FUNCTION(IoTHubTransport_CreatePooled_table_alloc_fails_returns_null)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    whenShallmalloc_fail = 2; /* first connection, connection table */
+
+    ///act
+    auto result = IoTHubTransport_CreatePooled(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 4, 10);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+
+    ///cleanup
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_10_017: [ For a pooled transport, IoTHubTransport_AssignShard shall only consider the open connections that serve fewer than devicesPerConnection clients. ]
+//Tests_SRS_IOTHUBTRANSPORT_10_018: [ If all open connections are full and fewer than maxConnections are open, IoTHubTransport_AssignShard shall open a new connection and return it. ]
+//Tests_SRS_IOTHUBTRANSPORT_10_019: [ If no connection can take the client, IoTHubTransport_AssignShard shall return NULL. ]
+TEST_FUNCTION(IoTHubTransport_AssignShard_pooled_fills_connection_before_opening_next)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_CreatePooled(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 2, 2);
+    TRANSPORT_HANDLE shard1 = IoTHubTransport_AssignShard(transportHandle);
+    TRANSPORT_HANDLE shard2 = IoTHubTransport_AssignShard(transportHandle);
+    mocks.ResetAllCalls();
+
+    ///act
+    TRANSPORT_HANDLE shard3 = IoTHubTransport_AssignShard(transportHandle);
+    TRANSPORT_HANDLE shard4 = IoTHubTransport_AssignShard(transportHandle);
+    TRANSPORT_HANDLE shard5 = IoTHubTransport_AssignShard(transportHandle);
+
+    ///assert
+    ASSERT_ARE_EQUAL(void_ptr, (void*)transportHandle, (void*)shard1);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)transportHandle, (void*)shard2);
+    ASSERT_IS_NOT_NULL(shard3);
+    ASSERT_ARE_NOT_EQUAL(void_ptr, (void*)transportHandle, (void*)shard3);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)shard3, (void*)shard4);
+    ASSERT_IS_NULL(shard5);
+
+    ///cleanup
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_10_020: [ When the last client of a pooled connection other than the first one is released, IoTHubTransport_ReleaseShard shall remove the connection from the pool and destroy it outside the shard lock. ]
+TEST_FUNCTION(IoTHubTransport_ReleaseShard_pooled_closes_empty_connection)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_CreatePooled(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 2, 1);
+    TRANSPORT_HANDLE shard1 = IoTHubTransport_AssignShard(transportHandle);
+    TRANSPORT_HANDLE shard2 = IoTHubTransport_AssignShard(transportHandle);
+    mocks.ResetAllCalls();
+
+    EXPECTED_CALL(mocks, Lock(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(3);
+    EXPECTED_CALL(mocks, Unlock(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(3);
+    EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+        .ExpectedTimesExactly(2);
+    STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    IoTHubTransport_ReleaseShard(shard2);
+    IoTHubTransport_ReleaseShard(shard1);
+
+    ///assert
+    ASSERT_ARE_EQUAL(void_ptr, (void*)transportHandle, (void*)shard1);
+    ASSERT_ARE_NOT_EQUAL(void_ptr, (void*)shard1, (void*)shard2);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_Destroy(transportHandle);
+}
+
+//Tests_SRS_IOTHUBTRANSPORT_10_018: [ If all open connections are full and fewer than maxConnections are open, IoTHubTransport_AssignShard shall open a new connection and return it. ]
+TEST_FUNCTION(IoTHubTransport_AssignShard_pooled_reopens_released_slot)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto transportHandle = IoTHubTransport_CreatePooled(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 2, 1);
+    (void)IoTHubTransport_AssignShard(transportHandle);
+    IoTHubTransport_ReleaseShard(IoTHubTransport_AssignShard(transportHandle));
+    mocks.ResetAllCalls();
+
+    ///act
+    TRANSPORT_HANDLE shard = IoTHubTransport_AssignShard(transportHandle);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(shard);
+    ASSERT_ARE_NOT_EQUAL(void_ptr, (void*)transportHandle, (void*)shard);
+
+    ///cleanup
+    IoTHubTransport_Destroy(transportHandle);
+}
+
 END_TEST_SUITE(iothubtransport_ut)
 
@@ -286,6 +286,7 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 	REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_AMQP_Common_Subscribe_DeviceMethod, 0);
 	REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_AMQP_Common_ProcessItem, IOTHUB_PROCESS_OK);
 	REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_AMQP_Common_GetSendStatus, IOTHUB_CLIENT_OK);
+	REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_AMQP_Common_GetNextWorkDeadline, IOTHUB_CLIENT_OK);
 }
 
 TEST_SUITE_CLEANUP(TestClassCleanup)
@@ -326,7 +327,8 @@ IoTHubTransport_Subscribe = IoTHubTransportAMQP_Subscribe
 IoTHubTransport_Unsubscribe = IoTHubTransportAMQP_Unsubscribe
 IoTHubTransport_DoWork = IoTHubTransportAMQP_DoWork
 IoTHubTransport_SetRetryLogic = IoTHubTransportAMQP_SetRetryLogic
-IoTHubTransport_SetOption = IoTHubTransportAMQP_SetOption]*/
+IoTHubTransport_SetOption = IoTHubTransportAMQP_SetOption
+IoTHubTransport_GetNextWorkDeadline = IoTHubTransportAMQP_GetNextWorkDeadline]*/
 TEST_FUNCTION(AMQP_Create)
 {
 	// arrange
@@ -669,6 +671,27 @@ TEST_FUNCTION(AMQP_GetSendStatus)
 	// cleanup
 }
 
+// Tests_SRS_IOTHUBTRANSPORTAMQP_10_002: [IoTHubTransportAMQP_GetNextWorkDeadline shall get the next work deadline by calling into the IoTHubTransport_AMQP_Common_GetNextWorkDeadline()]
+TEST_FUNCTION(AMQP_GetNextWorkDeadline)
+{
+	// arrange
+	TRANSPORT_PROVIDER* provider = (TRANSPORT_PROVIDER*)AMQP_Protocol();
+
+	uint64_t ms_to_next_work;
+
+	umock_c_reset_all_calls();
+	STRICT_EXPECTED_CALL(IoTHubTransport_AMQP_Common_GetNextWorkDeadline(TEST_TRANSPORT_LL_HANDLE, &ms_to_next_work));
+
+	// act
+	IOTHUB_CLIENT_RESULT result = provider->IoTHubTransport_GetNextWorkDeadline(TEST_TRANSPORT_LL_HANDLE, &ms_to_next_work);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(int, result, IOTHUB_CLIENT_OK);
+
+	// cleanup
+}
+
 
 // Tests_SRS_IOTHUBTRANSPORTAMQP_09_018: [IoTHubTransportAMQP_GetHostname shall get the hostname by calling into the IoTHubTransport_AMQP_Common_GetHostname()]
 TEST_FUNCTION(AMQP_GetHostname)
@@ -589,6 +589,7 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 	REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_AMQP_Common_Subscribe_DeviceMethod, 0);
 	REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_AMQP_Common_ProcessItem, IOTHUB_PROCESS_OK);
 	REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_AMQP_Common_GetSendStatus, IOTHUB_CLIENT_OK);
+	REGISTER_GLOBAL_MOCK_RETURN(IoTHubTransport_AMQP_Common_GetNextWorkDeadline, IOTHUB_CLIENT_OK);
     REGISTER_GLOBAL_MOCK_RETURN(wsio_get_interface_description, TEST_WSIO_INTERFACE_DESCRIPTION);
     REGISTER_GLOBAL_MOCK_RETURN(platform_get_default_tlsio, TEST_TLSIO_INTERFACE_DESCRIPTION);
     REGISTER_GLOBAL_MOCK_RETURN(http_proxy_io_get_interface_description, TEST_HTTP_PROXY_IO_INTERFACE_DESCRIPTION);
@@ -631,7 +632,8 @@ IoTHubTransport_Subscribe = IoTHubTransportAMQP_WS_Subscribe
 IoTHubTransport_Unsubscribe = IoTHubTransportAMQP_WS_Unsubscribe
 IoTHubTransport_DoWork = IoTHubTransportAMQP_WS_DoWork
 IoTHubTransport_SetRetryLogic = IoTHubTransportAMQP_WS_SetRetryLogic
-IoTHubTransport_SetOption = IoTHubTransportAMQP_WS_SetOption]*/
+IoTHubTransport_SetOption = IoTHubTransportAMQP_WS_SetOption
+IoTHubTransport_GetNextWorkDeadline = IoTHubTransportAMQP_WS_GetNextWorkDeadline]*/
 TEST_FUNCTION(AMQP_Create)
 {
 	// arrange
@@ -1085,6 +1087,27 @@ TEST_FUNCTION(AMQP_GetSendStatus)
 	// cleanup
 }
 
+// Tests_SRS_IoTHubTransportAMQP_WS_10_002: [IoTHubTransportAMQP_WS_GetNextWorkDeadline shall get the next work deadline by calling into the IoTHubTransport_AMQP_Common_GetNextWorkDeadline()]
+TEST_FUNCTION(AMQP_GetNextWorkDeadline)
+{
+	// arrange
+	TRANSPORT_PROVIDER* provider = (TRANSPORT_PROVIDER*)AMQP_Protocol_over_WebSocketsTls();
+
+	uint64_t ms_to_next_work;
+
+	umock_c_reset_all_calls();
+	STRICT_EXPECTED_CALL(IoTHubTransport_AMQP_Common_GetNextWorkDeadline(TEST_TRANSPORT_LL_HANDLE, &ms_to_next_work));
+
+	// act
+	IOTHUB_CLIENT_RESULT result = provider->IoTHubTransport_GetNextWorkDeadline(TEST_TRANSPORT_LL_HANDLE, &ms_to_next_work);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(int, result, IOTHUB_CLIENT_OK);
+
+	// cleanup
+}
+
 
 // Tests_SRS_IOTHUBTRANSPORTAMQP_WS_09_018: [IoTHubTransportAMQP_WS_GetHostname shall get the hostname by calling into the IoTHubTransport_AMQP_Common_GetHostname()]
 TEST_FUNCTION(AMQP_GetHostname)
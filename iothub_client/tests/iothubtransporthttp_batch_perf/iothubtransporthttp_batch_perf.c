@@ -0,0 +1,267 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/*this measures how many HTTP event batches per second can be serialized, either the way the transport used to
+build them (one STRING per item, concatenated, then copied into a new BUFFER) or with event_batch writing every
+item in place into a BUFFER that is reused from one batch to the next:
+
+    iothubtransporthttp_batch_perf strings
+    iothubtransporthttp_batch_perf inplace
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/platform.h"
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/buffer_.h"
+#include "azure_c_shared_utility/base64.h"
+#include "azure_c_shared_utility/map.h"
+#include "iothub_message.h"
+#include "event_batch.h"
+
+#define MESSAGE_SIZE 1024
+#define MESSAGES_PER_BATCH 200
+#define BATCH_COUNT 2000
+
+static unsigned char message_payload[MESSAGE_SIZE];
+static IOTHUB_MESSAGE_HANDLE messages[MESSAGES_PER_BATCH];
+
+/*the batch as iothubtransporthttp built it before event_batch: properties are not set on the messages of this
+test, so the item is only the base64 encoded body*/
+static int build_batch_with_strings(BUFFER_HANDLE* batch)
+{
+    int result;
+    STRING_HANDLE payload;
+
+    if ((payload = STRING_construct("[")) == NULL)
+    {
+        LogError("unable to STRING_construct");
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t i;
+
+        result = 0;
+        for (i = 0; (i < MESSAGES_PER_BATCH) && (result == 0); i++)
+        {
+            const unsigned char* source;
+            size_t size;
+            STRING_HANDLE encoded;
+
+            if (IoTHubMessage_GetByteArray(messages[i], &source, &size) != IOTHUB_MESSAGE_OK)
+            {
+                LogError("unable to IoTHubMessage_GetByteArray");
+                result = __FAILURE__;
+            }
+            else if ((encoded = Base64_Encode_Bytes(source, size)) == NULL)
+            {
+                LogError("unable to Base64_Encode_Bytes");
+                result = __FAILURE__;
+            }
+            else
+            {
+                if ((STRING_concat(payload, (i == 0) ? "{\"body\":\"" : ",{\"body\":\"") != 0) ||
+                    (STRING_concat_with_STRING(payload, encoded) != 0) ||
+                    (STRING_concat(payload, "\"}") != 0))
+                {
+                    LogError("unable to STRING_concat");
+                    result = __FAILURE__;
+                }
+                STRING_delete(encoded);
+            }
+        }
+
+        if (result == 0)
+        {
+            if (STRING_concat(payload, "]") != 0)
+            {
+                LogError("unable to STRING_concat");
+                result = __FAILURE__;
+            }
+            else if ((*batch = BUFFER_create((const unsigned char*)STRING_c_str(payload), STRING_length(payload))) == NULL)
+            {
+                LogError("unable to BUFFER_create");
+                result = __FAILURE__;
+            }
+        }
+
+        STRING_delete(payload);
+    }
+
+    return result;
+}
+
+static int build_batch_in_place(BUFFER_HANDLE batch)
+{
+    int result;
+    size_t payloadSize = 1 + MESSAGES_PER_BATCH;
+    size_t i;
+
+    result = 0;
+    for (i = 0; (i < MESSAGES_PER_BATCH) && (result == 0); i++)
+    {
+        size_t itemSize;
+        size_t messageSize;
+        if (event_batch_get_item_size(messages[i], &itemSize, &messageSize) != 0)
+        {
+            LogError("unable to event_batch_get_item_size");
+            result = __FAILURE__;
+        }
+        else
+        {
+            payloadSize += itemSize;
+        }
+    }
+
+    if (result == 0)
+    {
+        /*same size every batch, so the body allocated for the first batch is reused*/
+        if ((BUFFER_length(batch) != payloadSize) &&
+            ((BUFFER_unbuild(batch) != 0) || (BUFFER_pre_build(batch, payloadSize) != 0)))
+        {
+            LogError("unable to size the batch to %lu bytes", (unsigned long)payloadSize);
+            result = __FAILURE__;
+        }
+        else
+        {
+            unsigned char* destination = BUFFER_u_char(batch);
+            size_t available = payloadSize;
+
+            *destination++ = '[';
+            available--;
+            for (i = 0; (i < MESSAGES_PER_BATCH) && (result == 0); i++)
+            {
+                size_t itemSize;
+                if (i > 0)
+                {
+                    *destination++ = ',';
+                    available--;
+                }
+
+                if (event_batch_write_item(messages[i], destination, available - 1, &itemSize) != 0)
+                {
+                    LogError("unable to event_batch_write_item");
+                    result = __FAILURE__;
+                }
+                else
+                {
+                    destination += itemSize;
+                    available -= itemSize;
+                }
+            }
+
+            if (result == 0)
+            {
+                *destination = ']';
+            }
+        }
+    }
+
+    return result;
+}
+
+static int run_batches(bool inPlace)
+{
+    int result;
+    BUFFER_HANDLE reusedBatch;
+
+    if ((reusedBatch = BUFFER_new()) == NULL)
+    {
+        LogError("unable to BUFFER_new");
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t batchSize = 0;
+        size_t i;
+        clock_t start = clock();
+
+        result = 0;
+        for (i = 0; (i < BATCH_COUNT) && (result == 0); i++)
+        {
+            if (inPlace)
+            {
+                result = build_batch_in_place(reusedBatch);
+                batchSize = BUFFER_length(reusedBatch);
+            }
+            else
+            {
+                BUFFER_HANDLE batch;
+                if ((result = build_batch_with_strings(&batch)) == 0)
+                {
+                    batchSize = BUFFER_length(batch);
+                    BUFFER_delete(batch);
+                }
+            }
+        }
+
+        if (result == 0)
+        {
+            double elapsedInSeconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+            (void)printf("%s: %d batches of %d messages of %d bytes (%lu bytes per batch), %.0f batches/s\r\n",
+                inPlace ? "event_batch in place" : "STRING concatenation",
+                BATCH_COUNT, MESSAGES_PER_BATCH, MESSAGE_SIZE, (unsigned long)batchSize,
+                (elapsedInSeconds > 0) ? BATCH_COUNT / elapsedInSeconds : 0.0);
+        }
+
+        BUFFER_delete(reusedBatch);
+    }
+
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    int result;
+
+    if ((argc != 2) || ((strcmp(argv[1], "strings") != 0) && (strcmp(argv[1], "inplace") != 0)))
+    {
+        (void)printf("usage: %s strings|inplace\r\n", argv[0]);
+        result = __FAILURE__;
+    }
+    else if (platform_init() != 0)
+    {
+        LogError("platform_init failed");
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t i;
+
+        for (i = 0; i < sizeof(message_payload); i++)
+        {
+            message_payload[i] = (unsigned char)i;
+        }
+
+        result = 0;
+        for (i = 0; i < MESSAGES_PER_BATCH; i++)
+        {
+            if ((messages[i] = IoTHubMessage_CreateFromByteArray(message_payload, sizeof(message_payload))) == NULL)
+            {
+                LogError("unable to create message %lu", (unsigned long)i);
+                result = __FAILURE__;
+                break;
+            }
+        }
+
+        if (result == 0)
+        {
+            result = run_batches(strcmp(argv[1], "inplace") == 0);
+        }
+
+        while (i > 0)
+        {
+            IoTHubMessage_Destroy(messages[--i]);
+        }
+
+        platform_deinit();
+    }
+
+    return result;
+}
@@ -48,6 +48,9 @@ static void my_gballoc_free(void* ptr)
 #include "iothub_client_options.h"
 #include "iothub_client_version.h"
 #include "iothub_client_private.h"
+#include "device_index.h"
+#include "event_batch.h"
+#include "http_compression.h"
 #undef ENABLE_MOCKS
 
 #include "iothubtransporthttp.h"
@@ -66,6 +69,8 @@ extern "C" {
     extern int real_BUFFER_append_build(BUFFER_HANDLE handle, const unsigned char* source, size_t size);
     extern BUFFER_HANDLE real_BUFFER_clone(BUFFER_HANDLE handle);
     extern BUFFER_HANDLE real_BUFFER_create(const unsigned char* source, size_t size);
+    extern int real_BUFFER_pre_build(BUFFER_HANDLE handle, size_t size);
+    extern int real_BUFFER_unbuild(BUFFER_HANDLE handle);
 
     extern int real_mallocAndStrcpy_s(char** destination, const char* source);
     extern int real_size_tToString(char* destination, size_t destinationSize, size_t value);
@@ -90,6 +95,12 @@ extern "C" {
     extern int real_DList_RemoveEntryList(PDLIST_ENTRY listEntry);
     extern PDLIST_ENTRY real_DList_RemoveHeadList(PDLIST_ENTRY listHead);
 
+    extern DEVICE_INDEX_HANDLE real_device_index_create(void);
+    extern void real_device_index_destroy(DEVICE_INDEX_HANDLE device_index);
+    extern DEVICE_INDEX_ITEM_HANDLE real_device_index_add(DEVICE_INDEX_HANDLE device_index, const char* device_id, const void* value);
+    extern int real_device_index_remove(DEVICE_INDEX_HANDLE device_index, DEVICE_INDEX_ITEM_HANDLE item);
+    extern DEVICE_INDEX_ITEM_HANDLE real_device_index_find(DEVICE_INDEX_HANDLE device_index, const char* device_id);
+
 #ifdef __cplusplus
 }
 #endif
@@ -491,6 +502,7 @@ static pfIoTHubTransport_Subscribe                      IoTHubTransportHttp_Subs
 static pfIoTHubTransport_Unsubscribe                    IoTHubTransportHttp_Unsubscribe;
 static pfIoTHubTransport_DoWork                         IoTHubTransportHttp_DoWork;
 static pfIoTHubTransport_GetSendStatus                  IoTHubTransportHttp_GetSendStatus;
+static pfIoTHubTransport_GetNextWorkDeadline           IoTHubTransportHttp_GetNextWorkDeadline;
 
 static TEST_MUTEX_HANDLE g_testByTest;
 static TEST_MUTEX_HANDLE g_dllByDll;
@@ -734,6 +746,48 @@ static IOTHUB_MESSAGE_RESULT my_IoTHubMessage_GetByteArray(IOTHUB_MESSAGE_HANDLE
     return IOTHUB_MESSAGE_OK;
 }
 
+static IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT my_IoTHubMessage_GetByteArraySegments_segment;
+
+static IOTHUB_MESSAGE_RESULT my_IoTHubMessage_GetByteArraySegments(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT** segments, size_t* segmentCount)
+{
+    (void)my_IoTHubMessage_GetByteArray(iotHubMessageHandle, &my_IoTHubMessage_GetByteArraySegments_segment.buffer, &my_IoTHubMessage_GetByteArraySegments_segment.size);
+    *segments = &my_IoTHubMessage_GetByteArraySegments_segment;
+    *segmentCount = 1;
+    return IOTHUB_MESSAGE_OK;
+}
+
+/*every message is serialized as TEST_EVENT_BATCH_ITEM, the batch payload is checked to be made of such items*/
+#define TEST_EVENT_BATCH_ITEM "{\"body\":\"MTIz\"}"
+
+static int my_event_batch_get_item_size(IOTHUB_MESSAGE_HANDLE messageHandle, size_t* itemSize, size_t* messageSize)
+{
+    const unsigned char* buffer;
+    size_t size;
+    (void)my_IoTHubMessage_GetByteArray(messageHandle, &buffer, &size);
+    *itemSize = sizeof(TEST_EVENT_BATCH_ITEM) - 1;
+    *messageSize = size + PAYLOAD_OVERHEAD;
+    return 0;
+}
+
+static int my_event_batch_write_item(IOTHUB_MESSAGE_HANDLE messageHandle, unsigned char* destination, size_t destinationSize, size_t* itemSize)
+{
+    (void)messageHandle;
+    ASSERT_IS_TRUE(destinationSize >= sizeof(TEST_EVENT_BATCH_ITEM) - 1);
+    (void)memcpy(destination, TEST_EVENT_BATCH_ITEM, sizeof(TEST_EVENT_BATCH_ITEM) - 1);
+    *itemSize = sizeof(TEST_EVENT_BATCH_ITEM) - 1;
+    return 0;
+}
+
+#define TEST_HTTP_COMPRESSION_HANDLE ((HTTP_COMPRESSION_HANDLE)0x4443)
+#define TEST_COMPRESSED_BATCH "gzip of the batch"
+
+static int my_http_compression_compress(HTTP_COMPRESSION_HANDLE compression, BUFFER_HANDLE source, BUFFER_HANDLE destination)
+{
+    (void)compression;
+    (void)source;
+    return real_BUFFER_build(destination, (const unsigned char*)TEST_COMPRESSED_BATCH, sizeof(TEST_COMPRESSED_BATCH) - 1);
+}
+
 static MAP_HANDLE my_IoTHubMessage_Properties(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
 {
     MAP_HANDLE result2;
@@ -887,12 +941,22 @@ static void setupCreateHappyPathPerDeviceList(bool deallocateCreated)
     }
 }
 
+static void setupCreateHappyPathPerDeviceIndex(bool deallocateCreated)
+{
+    STRICT_EXPECTED_CALL(device_index_create());
+    if (deallocateCreated == true)
+    {
+        STRICT_EXPECTED_CALL(device_index_destroy(IGNORED_PTR_ARG));
+    }
+}
+
 static void setupCreateHappyPath(bool deallocateCreated)
 {
     setupCreateHappyPathAlloc(deallocateCreated);
     setupCreateHappyPathHostname(deallocateCreated);
     setupCreateHappyPathApiExHandle(deallocateCreated);
     setupCreateHappyPathPerDeviceList(deallocateCreated);
+    setupCreateHappyPathPerDeviceIndex(deallocateCreated);
 }
 
 static void setupUnregisterOneDevice()
@@ -1057,12 +1121,14 @@ static void setupRegisterHappyPatheventConfirmations()
 
 static void setupRegisterHappyPathDeviceListAdd()
 {
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1));
+    STRICT_EXPECTED_CALL(device_index_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 }
 
 static void setupRegisterHappyPathWithSasToken(bool deallocateCreated)
 {
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(device_index_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     setupRegisterHappyPathAllocHandle(deallocateCreated);
     setupRegisterHappyPathcreate_deviceId(deallocateCreated);
     setupRegisterHappyPathcreate_deviceSasToken(deallocateCreated);
@@ -1077,7 +1143,7 @@ static void setupRegisterHappyPathWithSasToken(bool deallocateCreated)
 
 static void setupRegisterHappyPath(bool deallocateCreated, bool is_x509_used)
 {
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(device_index_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     setupRegisterHappyPathAllocHandle(deallocateCreated);
     setupRegisterHappyPathcreate_deviceId(deallocateCreated);
     setupRegisterHappyPathcreate_deviceKey(deallocateCreated, is_x509_used);
@@ -1127,6 +1193,9 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(MAP_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(VECTOR_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(DEVICE_INDEX_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(DEVICE_INDEX_ITEM_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTP_COMPRESSION_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(PREDICATE_FUNCTION, void*);
     REGISTER_UMOCK_ALIAS_TYPE(HTTP_HEADERS_HANDLE, void*);
@@ -1158,6 +1227,10 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_HOOK(BUFFER_length, real_BUFFER_length);
     REGISTER_GLOBAL_MOCK_HOOK(BUFFER_clone, real_BUFFER_clone);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_clone, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_pre_build, real_BUFFER_pre_build);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_pre_build, __LINE__);
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_unbuild, real_BUFFER_unbuild);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(BUFFER_unbuild, __LINE__);
 
     REGISTER_STRING_GLOBAL_MOCK_HOOK;
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_new, NULL);
@@ -1192,6 +1265,24 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(VECTOR_find_if, NULL);
     REGISTER_GLOBAL_MOCK_HOOK(VECTOR_size, real_VECTOR_size);
 
+    REGISTER_GLOBAL_MOCK_HOOK(device_index_create, real_device_index_create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(device_index_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(device_index_destroy, real_device_index_destroy);
+    REGISTER_GLOBAL_MOCK_HOOK(device_index_add, real_device_index_add);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(device_index_add, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(device_index_remove, real_device_index_remove);
+    REGISTER_GLOBAL_MOCK_HOOK(device_index_find, real_device_index_find);
+
+    REGISTER_GLOBAL_MOCK_HOOK(event_batch_get_item_size, my_event_batch_get_item_size);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(event_batch_get_item_size, __LINE__);
+    REGISTER_GLOBAL_MOCK_HOOK(event_batch_write_item, my_event_batch_write_item);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(event_batch_write_item, __LINE__);
+
+    REGISTER_GLOBAL_MOCK_RETURN(http_compression_create, TEST_HTTP_COMPRESSION_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(http_compression_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(http_compression_compress, my_http_compression_compress);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(http_compression_compress, __LINE__);
+
     REGISTER_GLOBAL_MOCK_HOOK(URL_EncodeString, my_URL_EncodeString);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(URL_EncodeString, NULL);
 
@@ -1199,6 +1290,8 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_CreateFromByteArray, NULL);
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetByteArray, my_IoTHubMessage_GetByteArray);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_GetByteArray, IOTHUB_MESSAGE_ERROR);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetByteArraySegments, my_IoTHubMessage_GetByteArraySegments);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_GetByteArraySegments, IOTHUB_MESSAGE_ERROR);
     
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_SetContentTypeSystemProperty, IOTHUB_MESSAGE_OK);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_SetContentTypeSystemProperty, IOTHUB_MESSAGE_ERROR);
@@ -1212,6 +1305,8 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_Destroy, my_IoTHubMessage_Destroy);
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_Properties, my_IoTHubMessage_Properties);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_Properties, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetReadOnlyProperties, my_IoTHubMessage_Properties);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_GetReadOnlyProperties, NULL);
 
     REGISTER_GLOBAL_MOCK_HOOK(HTTPHeaders_Alloc, my_HTTPHeaders_Alloc);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPHeaders_Alloc, NULL);
@@ -1281,6 +1376,7 @@ TEST_SUITE_INITIALIZE(suite_init)
     IoTHubTransportHttp_Unsubscribe = ((TRANSPORT_PROVIDER*)HTTP_Protocol())->IoTHubTransport_Unsubscribe;
     IoTHubTransportHttp_DoWork = ((TRANSPORT_PROVIDER*)HTTP_Protocol())->IoTHubTransport_DoWork;
     IoTHubTransportHttp_GetSendStatus = ((TRANSPORT_PROVIDER*)HTTP_Protocol())->IoTHubTransport_GetSendStatus;
+    IoTHubTransportHttp_GetNextWorkDeadline = ((TRANSPORT_PROVIDER*)HTTP_Protocol())->IoTHubTransport_GetNextWorkDeadline;
 
     TEST_STRING_HANDLE = real_STRING_construct(TEST_STRING_DATA);
 }
@@ -1433,6 +1529,7 @@ TEST_FUNCTION(IoTHubTransportHttp_Create_with_NULL_iothub_suffix_fails)
 //Tests_SRS_TRANSPORTMULTITHTTP_17_005: [If config->upperConfig->protocolGatewayHostName is NULL, `IoTHubTransportHttp_Create` shall create an immutable string (further called hostname) containing `config->transportConfig->iotHubName + config->transportConfig->iotHubSuffix`.] 
 //Tests_SRS_TRANSPORTMULTITHTTP_17_007: [ IoTHubTransportHttp_Create shall create a HTTPAPIEX_HANDLE by a call to HTTPAPIEX_Create passing for hostName the hostname so far constructed by IoTHubTransportHttp_Create. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_009: [ IoTHubTransportHttp_Create shall call VECTOR_create to create a list of registered devices. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_10_018: [ IoTHubTransportHttp_Create shall call device_index_create to create an index of the registered devices by deviceId. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_130: [ IoTHubTransportHttp_Create shall allocate memory for the handle. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_011: [ Otherwise, IoTHubTransportHttp_Create shall succeed and return a non-NULL value. ]
 TEST_FUNCTION(IoTHubTransportHttp_Create_happy_path)
@@ -1454,6 +1551,7 @@ TEST_FUNCTION(IoTHubTransportHttp_Create_happy_path)
 //Tests_SRS_TRANSPORTMULTITHTTP_20_001: [If config->upperConfig->protocolGatewayHostName is not NULL, IoTHubTransportHttp_Create shall use it as hostname] 
 //Tests_SRS_TRANSPORTMULTITHTTP_17_007: [ IoTHubTransportHttp_Create shall create a HTTPAPIEX_HANDLE by a call to HTTPAPIEX_Create passing for hostName the hostname so far constructed by IoTHubTransportHttp_Create. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_009: [ IoTHubTransportHttp_Create shall call VECTOR_create to create a list of registered devices. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_10_018: [ IoTHubTransportHttp_Create shall call device_index_create to create an index of the registered devices by deviceId. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_130: [ IoTHubTransportHttp_Create shall allocate memory for the handle. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_011: [ Otherwise, IoTHubTransportHttp_Create shall succeed and return a non-NULL value. ]
 TEST_FUNCTION(IoTHubTransportHttp_Create_happy_path_with_gwhostname)
@@ -1463,6 +1561,7 @@ TEST_FUNCTION(IoTHubTransportHttp_Create_happy_path_with_gwhostname)
     setupCreateHappyPathGWHostname(false);
     setupCreateHappyPathApiExHandle(false);
     setupCreateHappyPathPerDeviceList(false);
+    setupCreateHappyPathPerDeviceIndex(false);
 
     //act
     TRANSPORT_LL_HANDLE result = IoTHubTransportHttp_Create(&TEST_GW_CONFIG);
@@ -1476,6 +1575,7 @@ TEST_FUNCTION(IoTHubTransportHttp_Create_happy_path_with_gwhostname)
 }
 
 //Tests_SRS_TRANSPORTMULTITHTTP_17_010: [ If creating the list fails, then IoTHubTransportHttp_Create shall fail and return NULL. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_10_019: [ If creating the index fails, then IoTHubTransportHttp_Create shall fail and return NULL. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_008: [ If creating the HTTPAPIEX_HANDLE fails then IoTHubTransportHttp_Create shall fail and return NULL. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_006: [ If creating the hostname fails then IoTHubTransportHttp_Create shall fail and return NULL. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_006: [ If creating the hostname fails then IoTHubTransportHttp_Create shall fail and return NULL. ]
@@ -1490,6 +1590,7 @@ TEST_FUNCTION(IoTHubTransportHttp_Create_fails)
     setupCreateHappyPathHostname(false);
     setupCreateHappyPathApiExHandle(false);
     setupCreateHappyPathPerDeviceList(false);
+    setupCreateHappyPathPerDeviceIndex(false);
 
     umock_c_negative_tests_snapshot();
 
@@ -1542,6 +1643,7 @@ TEST_FUNCTION(IoTHubTransportHttp_Destroy_succeeds_NoRegistered_devices)
     STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));                                             //HTTPAPIEX_HANDLE httpApiExHandle;
     STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(VECTOR_destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(device_index_destroy(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(handle));
 
     //act
@@ -1566,6 +1668,7 @@ TEST_FUNCTION(IoTHubTransportHttp_Destroy_succeeds_One_Registered_device)
     STRICT_EXPECTED_CALL(gballoc_free(devHandle));
 
     STRICT_EXPECTED_CALL(VECTOR_destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(device_index_destroy(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(handle));
     STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
 
@@ -1666,9 +1769,8 @@ TEST_FUNCTION(IoTHubTransportHttp_Register_2nd_device_HappyPath_success_fun_time
     IOTHUB_DEVICE_HANDLE devHandle2 = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_2, TEST_IOTHUB_CLIENT_LL_HANDLE2, TEST_CONFIG2.waitingToSend);
     umock_c_reset_all_calls();
 
-    // find in vector..
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    // find in index..
+    STRICT_EXPECTED_CALL(device_index_find(IGNORED_PTR_ARG, TEST_DEVICE_ID));
     setupRegisterHappyPathAllocHandle(false);
     setupRegisterHappyPathcreate_deviceId(false);
     setupRegisterHappyPathcreate_deviceKey(false, false);
@@ -1697,7 +1799,7 @@ TEST_FUNCTION(IoTHubTransportHttp_Register_2nd_device_HappyPath_success_fun_time
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_137: [ IoTHubTransportHttp_Register shall search the devices list for any device matching name deviceId. If deviceId is found it shall return NULL. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_137: [ IoTHubTransportHttp_Register shall search the device index for any device matching name deviceId by calling device_index_find. If deviceId is found it shall return NULL. ]
 TEST_FUNCTION(IoTHubTransportHttp_Register_sameDevice_twice_returns_null)
 {
     //arrange
@@ -1706,10 +1808,8 @@ TEST_FUNCTION(IoTHubTransportHttp_Register_sameDevice_twice_returns_null)
     (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
     umock_c_reset_all_calls();
 
-    // find in vector.. 2 and 1a
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    // find in index.. 1a
+    STRICT_EXPECTED_CALL(device_index_find(IGNORED_PTR_ARG, TEST_DEVICE_ID));
 
     //act 
     IOTHUB_DEVICE_HANDLE devHandle1b = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
@@ -1742,7 +1842,7 @@ TEST_FUNCTION(IoTHubTransportHttp_Register_HappyPath_with_deviceKey_fail)
 
     umock_c_negative_tests_snapshot();
 
-    size_t calls_cannot_fail[] = { 0, 8, 13, 19, 24, 25, 27, 28, 30, 31, 38, 46, 47, 48, 50, 51 };
+    size_t calls_cannot_fail[] = { 0, 8, 13, 19, 24, 25, 27, 28, 30, 31, 38, 46, 47, 48, 49, 52 };
 
     //act
     size_t count = umock_c_negative_tests_call_count();
@@ -2830,14 +2930,14 @@ TEST_FUNCTION(IoTHubTransportHttp_Register_create_deviceId_fails)
 }
 #endif
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_137: [ IoTHubTransportHttp_Register shall search the devices list for any device matching name deviceId. If deviceId is found it shall return NULL. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_137: [ IoTHubTransportHttp_Register shall search the device index for any device matching name deviceId by calling device_index_find. If deviceId is found it shall return NULL. ]
 TEST_FUNCTION(IoTHubTransportHttp_Register_deviceFoundInList_fails)
 {
     //arrange
     TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)).SetReturn((void_ptr)0x1);
+    STRICT_EXPECTED_CALL(device_index_find(IGNORED_PTR_ARG, TEST_DEVICE_ID)).SetReturn((DEVICE_INDEX_ITEM_HANDLE)0x1);
 
     //act
     IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
@@ -2966,9 +3066,11 @@ TEST_FUNCTION(IoTHubTransportHttp_Unregister_null_does_nothing)
     IoTHubTransportHttp_Unregister(NULL);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_045: [IoTHubTransportHttp_Unregister shall locate deviceHandle in the transport device list by calling VECTOR_find_if.]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_045: [IoTHubTransportHttp_Unregister shall locate deviceHandle in the transport device list at the position saved in the device structure.]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_047 : [IoTHubTransportHttp_Unregister shall free all the resources used in the device structure.]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_048 : [IoTHubTransportHttp_Unregister shall call VECTOR_erase to remove device from devices list.]
+//Tests_SRS_TRANSPORTMULTITHTTP_10_016: [ IoTHubTransportHttp_Unregister shall remove the device from the device index by calling device_index_remove. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_10_017: [ IoTHubTransportHttp_Unregister shall move the last device of the devices list to the position of the removed device and call VECTOR_erase to remove the last position. ]
 TEST_FUNCTION(IoTHubTransportHttp_Unregister_superHappyFunPath)
 {
     //arrange
@@ -2976,9 +3078,12 @@ TEST_FUNCTION(IoTHubTransportHttp_Unregister_superHappyFunPath)
     IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle));
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
     setupUnregisterOneDevice();
+    STRICT_EXPECTED_CALL(device_index_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_back(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1));
     STRICT_EXPECTED_CALL(gballoc_free(devHandle));
 
@@ -2992,9 +3097,11 @@ TEST_FUNCTION(IoTHubTransportHttp_Unregister_superHappyFunPath)
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_045: [IoTHubTransportHttp_Unregister shall locate deviceHandle in the transport device list by calling VECTOR_find_if.]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_045: [IoTHubTransportHttp_Unregister shall locate deviceHandle in the transport device list at the position saved in the device structure.]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_047 : [IoTHubTransportHttp_Unregister shall free all the resources used in the device structure.]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_048 : [IoTHubTransportHttp_Unregister shall call VECTOR_erase to remove device from devices list.]
+//Tests_SRS_TRANSPORTMULTITHTTP_10_016: [ IoTHubTransportHttp_Unregister shall remove the device from the device index by calling device_index_remove. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_10_017: [ IoTHubTransportHttp_Unregister shall move the last device of the devices list to the position of the removed device and call VECTOR_erase to remove the last position. ]
 TEST_FUNCTION(IoTHubTransportHttp_Unregister_2nd_device_superHappyFunPath)
 {
     //arrange
@@ -3003,9 +3110,12 @@ TEST_FUNCTION(IoTHubTransportHttp_Unregister_2nd_device_superHappyFunPath)
     IOTHUB_DEVICE_HANDLE devHandle1 = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle1));
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
     setupUnregisterOneDevice();
+    STRICT_EXPECTED_CALL(device_index_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_back(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1));
     STRICT_EXPECTED_CALL(gballoc_free(devHandle1));
 
@@ -3027,7 +3137,7 @@ TEST_FUNCTION(IoTHubTransportHttp_Unregister_DeviceNotFound_fails)
     IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle)).SetReturn((void_ptr)NULL);
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG)).SetReturn(0);
 
     //act
     IoTHubTransportHttp_Unregister(devHandle);
@@ -3051,7 +3161,7 @@ TEST_FUNCTION(IoTHubTransportHttp_Subscribe_with_NULL_parameter_fails)
     ASSERT_ARE_NOT_EQUAL(int, 0, result);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_104: [ IoTHubTransportHttp_Subscribe shall locate deviceHandle in the transport device list by calling VECTOR_find_if. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_104: [ IoTHubTransportHttp_Subscribe shall locate deviceHandle in the transport device list at the position saved in the device structure. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_106: [ Otherwise, IoTHubTransportHttp_Subscribe shall set the device so that subsequent calls to DoWork should execute HTTP requests. 
 TEST_FUNCTION(IoTHubTransportHttp_Subscribe_with_non_NULL_parameter_succeeds)
 {
@@ -3061,7 +3171,8 @@ TEST_FUNCTION(IoTHubTransportHttp_Subscribe_with_non_NULL_parameter_succeeds)
 
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle));
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
 
     //act
     int result = IoTHubTransportHttp_Subscribe(devHandle);
@@ -3074,7 +3185,7 @@ TEST_FUNCTION(IoTHubTransportHttp_Subscribe_with_non_NULL_parameter_succeeds)
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_104: [ IoTHubTransportHttp_Subscribe shall locate deviceHandle in the transport device list by calling VECTOR_find_if. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_104: [ IoTHubTransportHttp_Subscribe shall locate deviceHandle in the transport device list at the position saved in the device structure. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_106: [ Otherwise, IoTHubTransportHttp_Subscribe shall set the device so that subsequent calls to DoWork should execute HTTP requests. 
 TEST_FUNCTION(IoTHubTransportHttp_Subscribe_2devices_succeeds)
 {
@@ -3084,8 +3195,10 @@ TEST_FUNCTION(IoTHubTransportHttp_Subscribe_2devices_succeeds)
     IOTHUB_DEVICE_HANDLE devHandle2 = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_2, TEST_IOTHUB_CLIENT_LL_HANDLE2, TEST_CONFIG2.waitingToSend);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle1));
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle2));
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
 
     //act
     int result1 = IoTHubTransportHttp_Subscribe(devHandle1);
@@ -3108,8 +3221,8 @@ TEST_FUNCTION(IoTHubTransportHttp_Subscribe_with_list_find_fails)
     IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle))
-        .SetReturn((void_ptr)NULL);
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG))
+        .SetReturn(0);
 
     //act
     int result = IoTHubTransportHttp_Subscribe(devHandle);
@@ -3135,7 +3248,7 @@ TEST_FUNCTION(IoTHubTransportHttp_Unsubscribe_with_NULL_parameter_succeeds) /*do
 
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_108: [IoTHubTransportHttp_Unsubscribe shall locate deviceHandle in the transport device list by calling VECTOR_find_if.]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_108: [IoTHubTransportHttp_Unsubscribe shall locate deviceHandle in the transport device list at the position saved in the device structure.]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_110 : [Otherwise, IoTHubTransportHttp_Subscribe shall set the device so that subsequent calls to DoWork shall not execute HTTP requests.]
 TEST_FUNCTION(IoTHubTransportHttp_Unsubscribe_with_non_NULL_parameter_succeeds)
 {
@@ -3144,7 +3257,8 @@ TEST_FUNCTION(IoTHubTransportHttp_Unsubscribe_with_non_NULL_parameter_succeeds)
     IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle));
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
 
     //act
     IoTHubTransportHttp_Unsubscribe(devHandle);
@@ -3156,7 +3270,7 @@ TEST_FUNCTION(IoTHubTransportHttp_Unsubscribe_with_non_NULL_parameter_succeeds)
     IoTHubTransportHttp_Destroy(handle);
 }
 
-//Tests_SRS_TRANSPORTMULTITHTTP_17_108: [IoTHubTransportHttp_Unsubscribe shall locate deviceHandle in the transport device list by calling VECTOR_find_if.]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_108: [IoTHubTransportHttp_Unsubscribe shall locate deviceHandle in the transport device list at the position saved in the device structure.]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_110 : [Otherwise, IoTHubTransportHttp_Subscribe shall set the device so that subsequent calls to DoWork should not execute HTTP requests.]
 TEST_FUNCTION(IoTHubTransportHttp_Unsubscribe_with_2devices_succeeds)
 {
@@ -3166,8 +3280,10 @@ TEST_FUNCTION(IoTHubTransportHttp_Unsubscribe_with_2devices_succeeds)
     IOTHUB_DEVICE_HANDLE devHandle2 = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_2, TEST_IOTHUB_CLIENT_LL_HANDLE2, TEST_CONFIG2.waitingToSend);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle));
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle2));
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
 
     //act
     IoTHubTransportHttp_Unsubscribe(devHandle);
@@ -3189,8 +3305,8 @@ TEST_FUNCTION(IoTHubTransportHttp_Unsubscribe_with_device_not_found_does_nothing
 
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle))
-        .SetFailReturn((void_ptr)NULL);
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG))
+        .SetReturn(0);
 
     //act
     IoTHubTransportHttp_Unsubscribe(devHandle);
@@ -4129,7 +4245,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_2devices_2nd_has_1_event_item_as_string
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, ",\"base64Encoded\":false")) /*closing the value of the body*/
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_Properties(message10.messageHandle));
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(message10.messageHandle));
         STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3)
@@ -7880,6 +7996,7 @@ TEST_FUNCTION(HTTP_Protocol_succeeds)
     ASSERT_ARE_EQUAL(void_ptr, (void*)((TRANSPORT_PROVIDER*)result)->IoTHubTransport_Unsubscribe, (void*)IoTHubTransportHttp_Unsubscribe);
     ASSERT_ARE_EQUAL(void_ptr, (void*)((TRANSPORT_PROVIDER*)result)->IoTHubTransport_DoWork, (void*)IoTHubTransportHttp_DoWork);
     ASSERT_ARE_EQUAL(void_ptr, (void*)((TRANSPORT_PROVIDER*)result)->IoTHubTransport_GetSendStatus, (void*)IoTHubTransportHttp_GetSendStatus);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)((TRANSPORT_PROVIDER*)result)->IoTHubTransport_GetNextWorkDeadline, (void*)IoTHubTransportHttp_GetNextWorkDeadline);
     ASSERT_ARE_EQUAL(void_ptr, (void*)((TRANSPORT_PROVIDER*)result)->IoTHubTransport_SetOption, (void*)IoTHubTransportHttp_SetOption);
 
     //cleanup
@@ -7923,7 +8040,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_happy_path_succeeds)
         STRICT_EXPECTED_CALL(STRING_construct("{\"body\":\""));
         STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3);
 
@@ -7937,7 +8054,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_happy_path_succeeds)
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_Properties(message1.messageHandle));
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(message1.messageHandle));
         STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3)
@@ -8047,7 +8164,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items_puts_it_back_when_ht
         STRICT_EXPECTED_CALL(STRING_construct("{\"body\":\""));
         STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3);
 
@@ -8061,7 +8178,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items_puts_it_back_when_ht
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_Properties(message1.messageHandle));
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(message1.messageHandle));
         STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3)
@@ -8170,7 +8287,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items_puts_it_back_when_HT
         STRICT_EXPECTED_CALL(STRING_construct("{\"body\":\""));
         STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3);
 
@@ -8184,7 +8301,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items_puts_it_back_when_HT
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_Properties(message1.messageHandle));
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(message1.messageHandle));
         STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3)
@@ -8294,7 +8411,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items_puts_it_back_when_BU
         STRICT_EXPECTED_CALL(STRING_construct("{\"body\":\""));
         STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3);
 
@@ -8308,7 +8425,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items_puts_it_back_when_BU
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_Properties(message1.messageHandle));
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(message1.messageHandle));
         STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3)
@@ -8402,7 +8519,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items_puts_it_back_when_BU
         STRICT_EXPECTED_CALL(STRING_construct("{\"body\":\""));
         STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3);
 
@@ -8416,7 +8533,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items_puts_it_back_when_BU
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_Properties(message1.messageHandle));
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(message1.messageHandle));
         STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3)
@@ -8498,7 +8615,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_STRING_concat_wi
         STRICT_EXPECTED_CALL(STRING_construct("{\"body\":\""));
         STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3);
 
@@ -8512,7 +8629,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_STRING_concat_wi
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_Properties(message1.messageHandle));
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(message1.messageHandle));
         STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3)
@@ -8573,7 +8690,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_STRING_concat_it
         STRICT_EXPECTED_CALL(STRING_construct("{\"body\":\""));
         STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3);
 
@@ -8588,7 +8705,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_STRING_concat_it
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_Properties(message1.messageHandle));
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(message1.messageHandle));
         STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3)
@@ -8642,7 +8759,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_STRING_concat_it
         STRICT_EXPECTED_CALL(STRING_construct("{\"body\":\""));
         STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3);
 
@@ -8704,7 +8821,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_STRING_concat_wi
         STRICT_EXPECTED_CALL(STRING_construct("{\"body\":\""));
         STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3);
 
@@ -8760,7 +8877,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_Base64_Encode_By
         STRICT_EXPECTED_CALL(STRING_construct("{\"body\":\""));
         STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3);
 
@@ -8782,7 +8899,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_Base64_Encode_By
 }
 
 //Tests_SRS_TRANSPORTMULTITHTTP_17_067: [ If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_IoTHubMessage_GetByteArray_it_fails)
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_IoTHubMessage_GetByteArraySegments_it_fails)
 {
     //arrange
      
@@ -8810,7 +8927,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_when_IoTHubMessage_Ge
         STRICT_EXPECTED_CALL(STRING_construct("{\"body\":\""));
         STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3)
             .SetReturn(IOTHUB_MESSAGE_ERROR);
@@ -8971,7 +9088,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_bigger_than_256K_path
         STRICT_EXPECTED_CALL(STRING_construct("{\"body\":\""));
         STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(message4.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(message4.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3);
 
@@ -8985,7 +9102,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_bigger_than_256K_path
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_Properties(message4.messageHandle));
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(message4.messageHandle));
         STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3)
@@ -9049,7 +9166,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_almost255_happy_path_
         STRICT_EXPECTED_CALL(STRING_construct("{\"body\":\""));
         STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(message5.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(message5.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3);
 
@@ -9066,7 +9183,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_almost255_happy_path_
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
             .IgnoreArgument(1);
 
-        STRICT_EXPECTED_CALL(IoTHubMessage_Properties(message5.messageHandle));
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(message5.messageHandle));
         STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3)
@@ -9178,7 +9295,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_makes_1_batch_succee
         STRICT_EXPECTED_CALL(STRING_construct("{\"body\":\""));
         STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3);
 
@@ -9192,7 +9309,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_makes_1_batch_succee
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_Properties(message1.messageHandle));
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(message1.messageHandle));
         STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3)
@@ -9215,7 +9332,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_makes_1_batch_succee
         STRICT_EXPECTED_CALL(STRING_construct("{\"body\":\""));
         STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(message2.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(message2.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3);
 
@@ -9229,7 +9346,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_makes_1_batch_succee
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_Properties(message2.messageHandle));
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(message2.messageHandle));
         STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3)
@@ -9345,7 +9462,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_when_the_second_item
         STRICT_EXPECTED_CALL(STRING_construct("{\"body\":\""));
         STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3);
 
@@ -9359,7 +9476,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_when_the_second_item
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_Properties(message1.messageHandle));
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(message1.messageHandle));
         STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3)
@@ -9382,7 +9499,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_when_the_second_item
         STRICT_EXPECTED_CALL(STRING_construct("{\"body\":\""));
         STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(message2.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(message2.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3);
 
@@ -9396,7 +9513,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_when_the_second_item
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_Properties(message2.messageHandle));
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(message2.messageHandle));
         STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3)
@@ -9503,7 +9620,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_when_the_second_item
         STRICT_EXPECTED_CALL(STRING_construct("{\"body\":\""));
         STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3);
 
@@ -9517,7 +9634,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_when_the_second_item
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_Properties(message1.messageHandle));
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(message1.messageHandle));
         STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3)
@@ -9540,7 +9657,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_when_the_second_item
         STRICT_EXPECTED_CALL(STRING_construct("{\"body\":\""));
         STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(message2.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(message2.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3);
 
@@ -9553,7 +9670,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_when_the_second_item
             .IgnoreArgument(2);
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_Properties(message2.messageHandle));
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(message2.messageHandle));
         STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3)
@@ -9667,7 +9784,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_the_second_one_does_
         STRICT_EXPECTED_CALL(STRING_construct("{\"body\":\""));
         STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(message1.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3);
 
@@ -9681,7 +9798,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_the_second_one_does_
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_Properties(message1.messageHandle));
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(message1.messageHandle));
         STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3)
@@ -9704,7 +9821,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_the_second_one_does_
         STRICT_EXPECTED_CALL(STRING_construct("{\"body\":\""));
         STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(message5.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(message5.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3);
 
@@ -9718,7 +9835,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_the_second_one_does_
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "\"")) /*closing the value of the body*/
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_Properties(message5.messageHandle));
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(message5.messageHandle));
         STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3)
@@ -9844,7 +9961,7 @@ TEST_FUNCTION(IoTHubTransportHttp_GetSendStatus_InvalidStatusArgument_fail)
 }
 
 //Tests_SRS_TRANSPORTMULTITHTTP_17_112: [ IoTHubTransportHttp_GetSendStatus shall return IOTHUB_CLIENT_OK and status IOTHUB_CLIENT_SEND_STATUS_IDLE if there are currently no event items to be sent or being sent. ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_138: [ IoTHubTransportHttp_GetSendStatus shall locate deviceHandle in the transport device list by calling VECTOR_find_if. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_138: [ IoTHubTransportHttp_GetSendStatus shall locate deviceHandle in the transport device list at the position saved in the device structure. ]
 TEST_FUNCTION(IoTHubTransportHttp_GetSendStatus_empty_waitingToSend_and_empty_eventConfirmations_success)
 {
     // arrange
@@ -9854,9 +9971,8 @@ TEST_FUNCTION(IoTHubTransportHttp_GetSendStatus_empty_waitingToSend_and_empty_ev
 
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
 
     STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
 
@@ -9876,7 +9992,7 @@ TEST_FUNCTION(IoTHubTransportHttp_GetSendStatus_empty_waitingToSend_and_empty_ev
 }
 
 //Tests_SRS_TRANSPORTMULTITHTTP_17_113: [ IoTHubTransportHttp_GetSendStatus shall return IOTHUB_CLIENT_OK and status IOTHUB_CLIENT_SEND_STATUS_BUSY if there are currently event items to be sent or being sent. ]
-//Tests_SRS_TRANSPORTMULTITHTTP_17_138: [ IoTHubTransportHttp_GetSendStatus shall locate deviceHandle in the transport device list by calling VECTOR_find_if. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_138: [ IoTHubTransportHttp_GetSendStatus shall locate deviceHandle in the transport device list at the position saved in the device structure. ]
 TEST_FUNCTION(IoTHubTransportHttp_GetSendStatus_waitingToSend_not_empty_success)
 {
     // arrange
@@ -9891,9 +10007,8 @@ TEST_FUNCTION(IoTHubTransportHttp_GetSendStatus_waitingToSend_not_empty_success)
 
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
 
     IOTHUB_CLIENT_STATUS status;
@@ -9927,10 +10042,8 @@ TEST_FUNCTION(IoTHubTransportHttp_GetSendStatus_deviceData_is_not_found_fails)
 
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle))
-        .IgnoreArgument(1)
-        .IgnoreArgument(2)
-        .SetFailReturn((void_ptr)NULL);
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG))
+        .SetReturn(0);
 
     IOTHUB_CLIENT_STATUS status;
 
@@ -9947,6 +10060,45 @@ TEST_FUNCTION(IoTHubTransportHttp_GetSendStatus_deviceData_is_not_found_fails)
     IoTHubMessage_Destroy(eventMessageHandle);
 }
 
+/*** IoTHubTransportHttp_GetNextWorkDeadline ***/
+
+//Tests_SRS_TRANSPORTMULTITHTTP_10_008: [ If handle or msToNextWork are NULL, IoTHubTransportHttp_GetNextWorkDeadline shall return IOTHUB_CLIENT_INVALID_ARG. ]
+TEST_FUNCTION(IoTHubTransportHttp_GetNextWorkDeadline_InvalidHandleArgument_fail)
+{
+    // arrange
+    uint64_t msToNextWork;
+
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_GetNextWorkDeadline(NULL, &msToNextWork);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_INVALID_ARG);
+
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_10_008: [ If handle or msToNextWork are NULL, IoTHubTransportHttp_GetNextWorkDeadline shall return IOTHUB_CLIENT_INVALID_ARG. ]
+TEST_FUNCTION(IoTHubTransportHttp_GetNextWorkDeadline_InvalidMsToNextWorkArgument_fail)
+{
+    // arrange
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+
+    umock_c_reset_all_calls();
+
+    // act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_GetNextWorkDeadline(handle, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, result, IOTHUB_CLIENT_INVALID_ARG);
+
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
 void setupIrrelevantMocksForProperties(CIoTHubTransportHttpMocks *IOTHUB_MESSAGE_HANDLE messageHandle) /*these are copy pasted from TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items))*/
 {
     (void)(*mocks);
@@ -9966,7 +10118,7 @@ void setupIrrelevantMocksForProperties(CIoTHubTransportHttpMocks *IOTHUB_MESSAGE
         STRICT_EXPECTED_CALL((*mocks), STRING_construct("{\"body\":\""));
         STRICT_EXPECTED_CALL((*mocks), STRING_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL((*mocks), IoTHubMessage_GetByteArray(messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL((*mocks), IoTHubMessage_GetByteArraySegments(messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3);
 
@@ -10079,7 +10231,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items_with_properties_succ
 
     setupIrrelevantMocksForProperties(&message6.messageHandle);
 
-    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(message6.messageHandle));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(message6.messageHandle));
     STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3)
@@ -10134,7 +10286,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_items_with_1_properties_at
 
     setupIrrelevantMocksForProperties(&message11.messageHandle);
 
-    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(message11.messageHandle));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(message11.messageHandle));
     STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_1_PROPERTY_A_B, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3)
@@ -10255,7 +10407,7 @@ void setupIrrelevantMocksForProperties2(CIoTHubTransportHttpMocks *IOTHUB_MESSAG
         STRICT_EXPECTED_CALL((*mocks), STRING_construct("{\"body\":\""));
         STRICT_EXPECTED_CALL((*mocks), STRING_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL((*mocks), IoTHubMessage_GetByteArray(message6.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL((*mocks), IoTHubMessage_GetByteArraySegments(message6.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3);
 
@@ -10288,7 +10440,7 @@ void setupIrrelevantMocksForProperties2(CIoTHubTransportHttpMocks *IOTHUB_MESSAG
         STRICT_EXPECTED_CALL((*mocks), STRING_construct("{\"body\":\""));
         STRICT_EXPECTED_CALL((*mocks), STRING_delete(IGNORED_PTR_ARG))
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL((*mocks), IoTHubMessage_GetByteArray(message7.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        STRICT_EXPECTED_CALL((*mocks), IoTHubMessage_GetByteArraySegments(message7.messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3);
 
@@ -10387,7 +10539,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_with_properties_succ
 
     setupIrrelevantMocksForProperties2(&message6.messageHandle, message7.messageHandle);
 
-    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(message6.messageHandle));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(message6.messageHandle));
     STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3)
@@ -10415,7 +10567,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_with_properties_succ
     STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "}"))/*closing of the properties*/
         .IgnoreArgument(1);
 
-    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(message7.messageHandle));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(message7.messageHandle));
     STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_2_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3)
@@ -11921,7 +12073,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_no_properties_unbatch
     STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
 
     STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_1));
-    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_1, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(TEST_IOTHUB_MESSAGE_HANDLE_1, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3);
 
@@ -11934,7 +12086,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_no_properties_unbatch
         .IgnoreArgument(1);
 
     /*no properties, so no more headers*/
-    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_1));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(TEST_IOTHUB_MESSAGE_HANDLE_1));
     STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3)
@@ -12025,7 +12177,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_no_properties_string_
         .IgnoreArgument(1);
 
     /*no properties, so no more headers*/
-    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_10));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(TEST_IOTHUB_MESSAGE_HANDLE_10));
     STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3)
@@ -12098,7 +12250,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_unbatched_happy_path_at_th
     STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
 
     STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_11));
-    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_11, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(TEST_IOTHUB_MESSAGE_HANDLE_11, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3);
 
@@ -12111,7 +12263,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_unbatched_happy_path_at_th
         .IgnoreArgument(1);
 
     /*1 property*/
-    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_11));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(TEST_IOTHUB_MESSAGE_HANDLE_11));
     STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_1_PROPERTY_A_B, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3)
@@ -12271,7 +12423,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
     STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
 
     STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_6));
-    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3);
 
@@ -12284,7 +12436,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
         .IgnoreArgument(1);
 
     /*no properties, so no more headers*/
-    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_6));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(TEST_IOTHUB_MESSAGE_HANDLE_6));
     STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3)
@@ -12369,7 +12521,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
     STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
 
     STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_6));
-    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3);
 
@@ -12382,7 +12534,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
         .IgnoreArgument(1);
 
     /*no properties, so no more headers*/
-    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_6));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(TEST_IOTHUB_MESSAGE_HANDLE_6));
     STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3)
@@ -12456,7 +12608,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
     STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
 
     STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_6));
-    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3);
 
@@ -12469,7 +12621,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
         .IgnoreArgument(1);
 
     /*no properties, so no more headers*/
-    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_6));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(TEST_IOTHUB_MESSAGE_HANDLE_6));
     STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3)
@@ -12543,7 +12695,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
     STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
 
     STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_6));
-    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3);
 
@@ -12556,7 +12708,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
         .IgnoreArgument(1);
 
     /*no properties, so no more headers*/
-    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_6));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(TEST_IOTHUB_MESSAGE_HANDLE_6));
     STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3)
@@ -12614,7 +12766,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
     STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
 
     STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_6));
-    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3);
 
@@ -12627,7 +12779,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
         .IgnoreArgument(1);
 
     /*no properties, so no more headers*/
-    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_6));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(TEST_IOTHUB_MESSAGE_HANDLE_6));
     STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3)
@@ -12678,7 +12830,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
     STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
 
     STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_6));
-    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3);
 
@@ -12691,7 +12843,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
         .IgnoreArgument(1);
 
     /*no properties, so no more headers*/
-    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_6));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(TEST_IOTHUB_MESSAGE_HANDLE_6));
     STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3)
@@ -12740,7 +12892,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
     STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
 
     STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_6));
-    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3);
 
@@ -12753,7 +12905,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
         .IgnoreArgument(1);
 
     /*no properties, so no more headers*/
-    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_6));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(TEST_IOTHUB_MESSAGE_HANDLE_6));
     STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3)
@@ -12798,7 +12950,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
     STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
 
     STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_6));
-    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3);
 
@@ -12811,7 +12963,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
         .IgnoreArgument(1);
 
     /*no properties, so no more headers*/
-    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_6));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(TEST_IOTHUB_MESSAGE_HANDLE_6));
     STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3)
@@ -12852,7 +13004,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
     STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
 
     STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_6));
-    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3);
 
@@ -12865,7 +13017,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
         .IgnoreArgument(1);
 
     /*no properties, so no more headers*/
-    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_6));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(TEST_IOTHUB_MESSAGE_HANDLE_6));
     STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3)
@@ -12900,7 +13052,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
     STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
 
     STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_6));
-    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3);
 
@@ -12941,7 +13093,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
     STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
 
     STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_6));
-    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3);
 
@@ -12962,7 +13114,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
 }
 
 //Tests_SRS_TRANSPORTMULTITHTTP_17_079: [ If any HTTP header operation fails, _DoWork shall advance to the next action. ]
-TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_does_nothing_when_IoTHubMessage_GetByteArray_fails)
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_does_nothing_when_IoTHubMessage_GetByteArraySegments_fails)
 {
     //arrange
      
@@ -12977,7 +13129,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
     STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
 
     STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_6));
-    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3)
         .SetReturn(IOTHUB_MESSAGE_ERROR);
@@ -13011,7 +13163,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_1_property_unbatched_
     STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
 
     STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_9));
-    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_9, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(TEST_IOTHUB_MESSAGE_HANDLE_9, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3);
 
@@ -13078,7 +13230,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_as_string_happy_path_
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, ",\"base64Encoded\":false")) /*closing the value of the body*/
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_Properties(message10.messageHandle));
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(message10.messageHandle));
         STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3)
@@ -13198,7 +13350,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_as_string_when_string
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, ",\"base64Encoded\":false")) /*closing the value of the body*/
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_Properties(message10.messageHandle));
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(message10.messageHandle));
         STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3)
@@ -13262,7 +13414,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_event_item_as_string_when_Map_Ge
 
         STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, ",\"base64Encoded\":false")) /*closing the value of the body*/
             .IgnoreArgument(1);
-        STRICT_EXPECTED_CALL(IoTHubMessage_Properties(message10.messageHandle));
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(message10.messageHandle));
         STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .IgnoreArgument(2)
             .IgnoreArgument(3)
@@ -13598,7 +13750,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_SetMessageId_SUCCEED)
             .IgnoreArgument(1)
             .CopyOutArgumentBuffer(2, &nHeaders, sizeof(nHeaders));
 
-        STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_8));
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(TEST_IOTHUB_MESSAGE_HANDLE_8));
 
         STRICT_EXPECTED_CALL(HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 0, IGNORED_PTR_ARG))
             .IgnoreArgument(1)
@@ -13748,7 +13900,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_SetMessageId_FAILED)
     STRICT_EXPECTED_CALL(HTTPHeaders_GetHeaderCount(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(2, &nHeaders, sizeof(nHeaders));
 
-    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(IGNORED_PTR_ARG)).SetReturn(TEST_MAP_3_PROPERTY);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(IGNORED_PTR_ARG)).SetReturn(TEST_MAP_3_PROPERTY);
         //STRICT_EXPECTED_CALL(HTTPHeaders_GetHeaderCount(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         //    .CopyOutArgumentBuffer(2, &nHeaders, sizeof(nHeaders));
 
@@ -13924,7 +14076,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_SetCustomContentType_SetContentEncoding
         STRICT_EXPECTED_CALL(HTTPHeaders_GetHeaderCount(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
             .CopyOutArgumentBuffer(2, &nHeaders, sizeof(nHeaders));
 
-        STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_8));
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(TEST_IOTHUB_MESSAGE_HANDLE_8));
 
         STRICT_EXPECTED_CALL(HTTPHeaders_GetHeader(IGNORED_PTR_ARG, 0, IGNORED_PTR_ARG));
         STRICT_EXPECTED_CALL(Map_AddOrUpdate(TEST_MAP_3_PROPERTY, "NAME1", "VALUE1"));
@@ -13989,7 +14141,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_GetMessageId_succeeds)
     STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
 
     STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_6));
-    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .IgnoreArgument(3);
 
@@ -13999,7 +14151,7 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_GetMessageId_succeeds)
         .IgnoreArgument(1);
 
     /*no properties, so no more headers*/
-    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_6));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(TEST_IOTHUB_MESSAGE_HANDLE_6));
     STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     /*this is making http headers*/
     STRICT_EXPECTED_CALL(STRING_construct("iothub-app-"));
@@ -14061,13 +14213,13 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_GetCorrelationId_succeeds)
 
     STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
     STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_6));
-    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
     STRICT_EXPECTED_CALL(HTTPHeaders_Clone(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/octet-stream"));
 
     /*no properties, so no more headers*/
-    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_6));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(TEST_IOTHUB_MESSAGE_HANDLE_6));
     STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
     /*this is making http headers*/
@@ -14138,13 +14290,13 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_GetCustomContentType_succeeds)
 
     STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
     STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_6));
-    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
     STRICT_EXPECTED_CALL(HTTPHeaders_Clone(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/octet-stream"));
 
     /*no properties, so no more headers*/
-    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_6));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(TEST_IOTHUB_MESSAGE_HANDLE_6));
     STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
     /*this is making http headers*/
@@ -14215,13 +14367,13 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_GetContentEncoding_succeeds)
 
     STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
     STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_6));
-    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
     STRICT_EXPECTED_CALL(HTTPHeaders_Clone(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/octet-stream"));
 
     /*no properties, so no more headers*/
-    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_6));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(TEST_IOTHUB_MESSAGE_HANDLE_6));
     STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
     /*this is making http headers*/
@@ -14279,6 +14431,798 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_GetContentEncoding_succeeds)
     IoTHubTransportHttp_Destroy(handle);
 }
 
+static void setupDoWorkBatchedEventBegin(IOTHUB_MESSAGE_LIST* message)
+{
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+    STRICT_EXPECTED_CALL(HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"));
+    STRICT_EXPECTED_CALL(event_batch_get_item_size(message->messageHandle, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+}
+
+static void setupDoWorkBatchedEventSend(void)
+{
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)); /*because relativePath*/
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(
+        IGNORED_PTR_ARG,                                                                /*sasObject handle                                   */
+        IGNORED_PTR_ARG,
+        HTTPAPI_REQUEST_POST,                                                           /*HTTPAPI_REQUEST_TYPE requestType,                  */
+        "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION,                          /*const char* relativePath,                          */
+        IGNORED_PTR_ARG,                                                                /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,      */
+        IGNORED_PTR_ARG,                                                                /*BUFFER_HANDLE requestContent,                      */
+        IGNORED_PTR_ARG,                                                                /*unsigned int* statusCode,                          */
+        NULL,                                                                           /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,     */
+        NULL                                                                            /*BUFFER_HANDLE responseContent)                     */
+    ))
+        .IgnoreArgument_requestType()
+        .CopyOutArgumentBuffer(7, &httpStatus200, sizeof(httpStatus200));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK));
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_10_020: [ IoTHubTransportHttp_DoWork shall call event_batch_get_item_size for the oldest messages in waitingToSend, until the list ends or a message does not fit in the message size limit, to compute the size of the payload. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_10_021: [ The payload shall be written in the batch buffer of the device, which is created by BUFFER_new for the first batch and resized with BUFFER_unbuild and BUFFER_pre_build only when the size of the payload differs from BUFFER_length. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_10_022: [ IoTHubTransportHttp_DoWork shall write the items with event_batch_write_item straight into the batch buffer, separated by ',' between '[' and ']', then move their messages from waitingToSend to eventConfirmations. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_056: [ IoTHubTransportHttp_DoWork shall build the following string:[{"body":"base64 encoding of the message1 content"},{"body":"base64 encoding of the message2 content"}...] ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_event_items_batched_writes_them_in_the_batch_payload_succeeds)
+{
+    //arrange
+    bool batching = true;
+    DList_InsertTailList(&(waitingToSend), &(message6.entry));
+    DList_InsertTailList(&(waitingToSend), &(message7.entry));
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_BATCHING, &batching);
+
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+    setupDoWorkBatchedEventBegin(&message6);
+    STRICT_EXPECTED_CALL(event_batch_get_item_size(TEST_IOTHUB_MESSAGE_HANDLE_7, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_unbuild(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_pre_build(IGNORED_PTR_ARG, sizeof("[" TEST_EVENT_BATCH_ITEM "," TEST_EVENT_BATCH_ITEM "]") - 1));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(event_batch_write_item(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(event_batch_write_item(TEST_IOTHUB_MESSAGE_HANDLE_7, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG));
+
+    /*building the list of messages to be notified if HTTP is fine*/
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, &(message6.entry)));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, &(message7.entry)));
+
+    setupDoWorkBatchedEventSend();
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, sizeof("[" TEST_EVENT_BATCH_ITEM "," TEST_EVENT_BATCH_ITEM "]") - 1, real_BUFFER_length(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest));
+    ASSERT_ARE_EQUAL(int, 0, memcmp(real_BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), "[" TEST_EVENT_BATCH_ITEM "," TEST_EVENT_BATCH_ITEM "]", sizeof("[" TEST_EVENT_BATCH_ITEM "," TEST_EVENT_BATCH_ITEM "]") - 1));
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_10_021: [ The payload shall be written in the batch buffer of the device, which is created by BUFFER_new for the first batch and resized with BUFFER_unbuild and BUFFER_pre_build only when the size of the payload differs from BUFFER_length. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_batched_reuses_the_batch_payload_when_the_size_does_not_change_succeeds)
+{
+    //arrange
+    bool batching = true;
+    DList_InsertTailList(&(waitingToSend), &(message6.entry));
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_BATCHING, &batching);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    DList_InsertTailList(&(waitingToSend), &(message7.entry));
+
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+    setupDoWorkBatchedEventBegin(&message7);
+
+    /*no allocation, the payload of the previous batch is written over*/
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(event_batch_write_item(TEST_IOTHUB_MESSAGE_HANDLE_7, IGNORED_PTR_ARG, sizeof(TEST_EVENT_BATCH_ITEM) - 1, IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, &(message7.entry)));
+
+    setupDoWorkBatchedEventSend();
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, memcmp(real_BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), "[" TEST_EVENT_BATCH_ITEM "]", sizeof("[" TEST_EVENT_BATCH_ITEM "]") - 1));
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_10_023: [ If the batch buffer cannot be created or sized, or an item cannot be written, IoTHubTransportHttp_DoWork shall leave the messages in waitingToSend and advance to the next activity. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_batched_leaves_the_messages_in_waitingToSend_when_BUFFER_pre_build_fails)
+{
+    //arrange
+    bool batching = true;
+    DList_InsertTailList(&(waitingToSend), &(message6.entry));
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_BATCHING, &batching);
+
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+    setupDoWorkBatchedEventBegin(&message6);
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_unbuild(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_pre_build(IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .SetReturn(__LINE__);
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, &(message6.entry), waitingToSend.Flink);
+    ASSERT_IS_NULL(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest);
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_10_023: [ If the batch buffer cannot be created or sized, or an item cannot be written, IoTHubTransportHttp_DoWork shall leave the messages in waitingToSend and advance to the next activity. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_batched_leaves_the_messages_in_waitingToSend_when_event_batch_write_item_fails)
+{
+    //arrange
+    bool batching = true;
+    DList_InsertTailList(&(waitingToSend), &(message6.entry));
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_BATCHING, &batching);
+
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+    setupDoWorkBatchedEventBegin(&message6);
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_unbuild(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_pre_build(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(event_batch_write_item(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+        .SetReturn(__LINE__);
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, &(message6.entry), waitingToSend.Flink);
+    ASSERT_IS_NULL(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest);
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_10_030: [ Otherwise IoTHubTransportHttp_SetOption shall create a compressor with http_compression_create and replace the current one. ]
+TEST_FUNCTION(IoTHubTransportHttp_SetOption_http_compression_level_creates_a_compressor_succeeds)
+{
+    //arrange
+    int level = 6;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(http_compression_create(6));
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_SetOption(handle, OPTION_HTTP_COMPRESSION_LEVEL, &level);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_10_030: [ Otherwise IoTHubTransportHttp_SetOption shall create a compressor with http_compression_create and replace the current one. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_10_028: [ "http_compression_level" 0 shall destroy the compressor and the compressed payload so that batches are sent uncompressed. ]
+TEST_FUNCTION(IoTHubTransportHttp_SetOption_http_compression_level_replaces_then_destroys_the_compressor_succeeds)
+{
+    //arrange
+    int level = 6;
+    int newLevel = 9;
+    int noCompression = 0;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_HTTP_COMPRESSION_LEVEL, &level);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(http_compression_create(9));
+    STRICT_EXPECTED_CALL(http_compression_destroy(TEST_HTTP_COMPRESSION_HANDLE));
+    STRICT_EXPECTED_CALL(http_compression_destroy(TEST_HTTP_COMPRESSION_HANDLE));
+
+    //act
+    IOTHUB_CLIENT_RESULT result1 = IoTHubTransportHttp_SetOption(handle, OPTION_HTTP_COMPRESSION_LEVEL, &newLevel);
+    IOTHUB_CLIENT_RESULT result2 = IoTHubTransportHttp_SetOption(handle, OPTION_HTTP_COMPRESSION_LEVEL, &noCompression);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result1);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_10_029: [ If "http_compression_level" is not between 0 and 9, IoTHubTransportHttp_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]
+TEST_FUNCTION(IoTHubTransportHttp_SetOption_http_compression_level_10_fails)
+{
+    //arrange
+    int level = 10;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_SetOption(handle, OPTION_HTTP_COMPRESSION_LEVEL, &level);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_10_031: [ If http_compression_create fails, IoTHubTransportHttp_SetOption shall keep the current compressor and return IOTHUB_CLIENT_ERROR. ]
+TEST_FUNCTION(IoTHubTransportHttp_SetOption_http_compression_level_fails_when_http_compression_create_fails)
+{
+    //arrange
+    int level = 6;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(http_compression_create(6))
+        .SetReturn(NULL);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_SetOption(handle, OPTION_HTTP_COMPRESSION_LEVEL, &level);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+static TRANSPORT_LL_HANDLE createBatchingTransportWithCompression(size_t compressionMinimumSize)
+{
+    bool batching = true;
+    int level = 6;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_BATCHING, &batching);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_HTTP_COMPRESSION_LEVEL, &level);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_HTTP_COMPRESSION_MIN_SIZE, &compressionMinimumSize);
+    return handle;
+}
+
+static void setupDoWorkBatchedEventWriteOneItem(void)
+{
+    setupDoWorkLoopOnceForOneDevice();
+    setupDoWorkBatchedEventBegin(&message6);
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_unbuild(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_pre_build(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(event_batch_write_item(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, &(message6.entry)));
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_10_025: [ If compression is enabled and the batch payload is at least as long as the compression threshold, IoTHubTransportHttp_DoWork shall compress it with http_compression_compress. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_10_026: [ A compressed batch shall be sent with the event request headers of the device plus "Content-Encoding: gzip", made once per device by HTTPHeaders_Clone and HTTPHeaders_AddHeaderNameValuePair. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_batched_with_compression_sends_the_compressed_batch_succeeds)
+{
+    //arrange
+    DList_InsertTailList(&(waitingToSend), &(message6.entry));
+    TRANSPORT_LL_HANDLE handle = createBatchingTransportWithCompression(1);
+    umock_c_reset_all_calls();
+
+    setupDoWorkBatchedEventWriteOneItem();
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(HTTPHeaders_Clone(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Encoding", "gzip"));
+    STRICT_EXPECTED_CALL(http_compression_compress(TEST_HTTP_COMPRESSION_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    setupDoWorkBatchedEventSend();
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, sizeof(TEST_COMPRESSED_BATCH) - 1, real_BUFFER_length(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest));
+    ASSERT_ARE_EQUAL(int, 0, memcmp(real_BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), TEST_COMPRESSED_BATCH, sizeof(TEST_COMPRESSED_BATCH) - 1));
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_10_026: [ A compressed batch shall be sent with the event request headers of the device plus "Content-Encoding: gzip", made once per device by HTTPHeaders_Clone and HTTPHeaders_AddHeaderNameValuePair. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_batched_with_compression_reuses_the_compressed_request_succeeds)
+{
+    //arrange
+    DList_InsertTailList(&(waitingToSend), &(message6.entry));
+    TRANSPORT_LL_HANDLE handle = createBatchingTransportWithCompression(1);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    DList_InsertTailList(&(waitingToSend), &(message7.entry));
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+    setupDoWorkBatchedEventBegin(&message7);
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_u_char(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(event_batch_write_item(TEST_IOTHUB_MESSAGE_HANDLE_7, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, &(message7.entry)));
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(http_compression_compress(TEST_HTTP_COMPRESSION_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    setupDoWorkBatchedEventSend();
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, memcmp(real_BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), TEST_COMPRESSED_BATCH, sizeof(TEST_COMPRESSED_BATCH) - 1));
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_10_032: [ "http_compression_min_size" shall set the size, in bytes, below which batches are sent uncompressed. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_batched_with_compression_sends_a_batch_below_the_threshold_uncompressed_succeeds)
+{
+    //arrange
+    DList_InsertTailList(&(waitingToSend), &(message6.entry));
+    TRANSPORT_LL_HANDLE handle = createBatchingTransportWithCompression(sizeof("[" TEST_EVENT_BATCH_ITEM "]"));
+    umock_c_reset_all_calls();
+
+    setupDoWorkBatchedEventWriteOneItem();
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+    setupDoWorkBatchedEventSend();
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, memcmp(real_BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), "[" TEST_EVENT_BATCH_ITEM "]", sizeof("[" TEST_EVENT_BATCH_ITEM "]") - 1));
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_10_027: [ If compressing the batch payload fails or does not make it smaller, IoTHubTransportHttp_DoWork shall send it uncompressed. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_batched_with_compression_sends_the_batch_uncompressed_when_http_compression_compress_fails)
+{
+    //arrange
+    DList_InsertTailList(&(waitingToSend), &(message6.entry));
+    TRANSPORT_LL_HANDLE handle = createBatchingTransportWithCompression(1);
+    umock_c_reset_all_calls();
+
+    setupDoWorkBatchedEventWriteOneItem();
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(HTTPHeaders_Clone(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Encoding", "gzip"));
+    STRICT_EXPECTED_CALL(http_compression_compress(TEST_HTTP_COMPRESSION_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(__LINE__);
+    setupDoWorkBatchedEventSend();
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, memcmp(real_BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), "[" TEST_EVENT_BATCH_ITEM "]", sizeof("[" TEST_EVENT_BATCH_ITEM "]") - 1));
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_10_027: [ If compressing the batch payload fails or does not make it smaller, IoTHubTransportHttp_DoWork shall send it uncompressed. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_batched_with_compression_sends_the_batch_uncompressed_when_HTTPHeaders_Clone_fails)
+{
+    //arrange
+    DList_InsertTailList(&(waitingToSend), &(message6.entry));
+    TRANSPORT_LL_HANDLE handle = createBatchingTransportWithCompression(1);
+    umock_c_reset_all_calls();
+
+    setupDoWorkBatchedEventWriteOneItem();
+    STRICT_EXPECTED_CALL(BUFFER_length(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(HTTPHeaders_Clone(IGNORED_PTR_ARG))
+        .SetReturn(NULL);
+    setupDoWorkBatchedEventSend();
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, memcmp(real_BUFFER_u_char(last_BUFFER_HANDLE_to_HTTPAPIEX_ExecuteRequest), "[" TEST_EVENT_BATCH_ITEM "]", sizeof("[" TEST_EVENT_BATCH_ITEM "]") - 1));
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+static TRANSPORT_LL_HANDLE createSubscribedTransportWithAdaptivePolling(unsigned int minimumIntervalInSeconds, unsigned int maximumIntervalInSeconds)
+{
+    IOTHUB_CLIENT_HTTP_ADAPTIVE_POLLING adaptivePolling;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    adaptivePolling.minimumIntervalInSeconds = minimumIntervalInSeconds;
+    adaptivePolling.maximumIntervalInSeconds = maximumIntervalInSeconds;
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_HTTP_ADAPTIVE_POLLING, &adaptivePolling);
+    return handle;
+}
+
+/*runs one DoWork at timeNow, answering a GET, if there is one, with statusCode*/
+static void doWorkPollingAt(TRANSPORT_LL_HANDLE handle, time_t timeNow, double secondsSinceLastPoll, unsigned int statusCode)
+{
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(get_time(NULL))
+        .SetReturn(timeNow);
+    STRICT_EXPECTED_CALL(get_difftime(timeNow, IGNORED_NUM_ARG))
+        .SetReturn(secondsSinceLastPoll);
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .CopyOutArgumentBuffer(7, &statusCode, sizeof(statusCode));
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    umock_c_reset_all_calls();
+}
+
+static IOTHUB_CLIENT_HTTP_POLLING_STATISTICS getPollingStatistics(TRANSPORT_LL_HANDLE handle)
+{
+    IOTHUB_CLIENT_HTTP_POLLING_STATISTICS pollingStatistics;
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_GetPollingStatistics(handle, &pollingStatistics);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    return pollingStatistics;
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_10_035: [ If maximumIntervalInSeconds is not 0 and minimumIntervalInSeconds is 0 or greater than maximumIntervalInSeconds, IoTHubTransportHttp_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]
+TEST_FUNCTION(IoTHubTransportHttp_SetOption_adaptive_polling_with_minimum_0_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_HTTP_ADAPTIVE_POLLING adaptivePolling = { 0, 60 };
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_SetOption(handle, OPTION_HTTP_ADAPTIVE_POLLING, &adaptivePolling);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_10_035: [ If maximumIntervalInSeconds is not 0 and minimumIntervalInSeconds is 0 or greater than maximumIntervalInSeconds, IoTHubTransportHttp_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]
+TEST_FUNCTION(IoTHubTransportHttp_SetOption_adaptive_polling_with_minimum_greater_than_maximum_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_HTTP_ADAPTIVE_POLLING adaptivePolling = { 61, 60 };
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_SetOption(handle, OPTION_HTTP_ADAPTIVE_POLLING, &adaptivePolling);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_10_033: [ IoTHubTransportHttp_Create shall set the transport to poll for messages every MinimumPollingTime, with adaptive polling off. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_10_034: [ "http_adaptive_polling" with a maximumIntervalInSeconds of 0 shall turn adaptive polling off. ]
+TEST_FUNCTION(IoTHubTransportHttp_SetOption_adaptive_polling_with_maximum_0_brings_back_MinimumPollingTime_succeeds)
+{
+    //arrange
+    IOTHUB_CLIENT_HTTP_ADAPTIVE_POLLING adaptivePollingOff = { 0, 0 };
+    TRANSPORT_LL_HANDLE handle = createSubscribedTransportWithAdaptivePolling(2, 60);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_SetOption(handle, OPTION_HTTP_ADAPTIVE_POLLING, &adaptivePollingOff);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(int, TEST_DEFAULT_GETMINIMUMPOLLINGTIME, getPollingStatistics(handle).currentIntervalInSeconds);
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_10_037: [ While adaptive polling is on, a GET shall be allowed once the polling wait of the device has passed since its last GET; a wait of 0 shall allow a GET at every _DoWork. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_10_039: [ When a GET is answered with any status code other than 200, the polling wait shall become minimumIntervalInSeconds if it is shorter, otherwise it shall be doubled, up to maximumIntervalInSeconds. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_adaptive_polling_does_not_poll_before_the_minimum_interval_after_an_empty_answer)
+{
+    //arrange
+    TRANSPORT_LL_HANDLE handle = createSubscribedTransportWithAdaptivePolling(2, 60);
+    doWorkPollingAt(handle, TEST_GET_TIME_VALUE, 0, 204);
+
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend)); /*because DoWork for event*/
+    STRICT_EXPECTED_CALL(get_time(NULL))
+        .SetReturn(TEST_GET_TIME_VALUE + 1);
+    STRICT_EXPECTED_CALL(get_difftime(TEST_GET_TIME_VALUE + 1, TEST_GET_TIME_VALUE))
+        .SetReturn(1.0);
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, getPollingStatistics(handle).pollCount);
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_10_037: [ While adaptive polling is on, a GET shall be allowed once the polling wait of the device has passed since its last GET; a wait of 0 shall allow a GET at every _DoWork. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_adaptive_polling_polls_once_the_minimum_interval_passed_succeeds)
+{
+    //arrange
+    TRANSPORT_LL_HANDLE handle = createSubscribedTransportWithAdaptivePolling(2, 60);
+    doWorkPollingAt(handle, TEST_GET_TIME_VALUE, 0, 204);
+
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend)); /*because DoWork for event*/
+    STRICT_EXPECTED_CALL(get_time(NULL))
+        .SetReturn(TEST_GET_TIME_VALUE + 2);
+    STRICT_EXPECTED_CALL(get_difftime(TEST_GET_TIME_VALUE + 2, TEST_GET_TIME_VALUE))
+        .SetReturn(2.0);
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)); /*because relativePath is a STRING_HANDLE*/
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(
+        IGNORED_PTR_ARG,                                    /*sasObject handle                                             */
+        IGNORED_PTR_ARG,                                    /*HTTPAPIEX_HANDLE handle,                                     */
+        HTTPAPI_REQUEST_GET,                                /*HTTPAPI_REQUEST_TYPE requestType,                            */
+        "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION,    /*const char* relativePath,                                    */
+        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE requestHttpHeadersHandle,                */
+        NULL,                                               /*BUFFER_HANDLE requestContent,                                */
+        IGNORED_PTR_ARG,                                    /*unsigned int* statusCode,                                    */
+        IGNORED_PTR_ARG,                                    /*HTTP_HEADERS_HANDLE responseHttpHeadersHandle,               */
+        IGNORED_PTR_ARG                                     /*BUFFER_HANDLE responseContent))                              */
+        ))
+        .IgnoreArgument_requestType();
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 2, getPollingStatistics(handle).pollCount);
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_10_039: [ When a GET is answered with any status code other than 200, the polling wait shall become minimumIntervalInSeconds if it is shorter, otherwise it shall be doubled, up to maximumIntervalInSeconds. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_adaptive_polling_doubles_the_interval_up_to_the_maximum_on_empty_answers)
+{
+    //arrange
+    TRANSPORT_LL_HANDLE handle = createSubscribedTransportWithAdaptivePolling(2, 5);
+
+    //act
+    doWorkPollingAt(handle, TEST_GET_TIME_VALUE, 0, 204);
+    unsigned int afterFirstEmptyAnswer = getPollingStatistics(handle).currentIntervalInSeconds;
+    doWorkPollingAt(handle, TEST_GET_TIME_VALUE + 2, 2.0, 204);
+    unsigned int afterSecondEmptyAnswer = getPollingStatistics(handle).currentIntervalInSeconds;
+    doWorkPollingAt(handle, TEST_GET_TIME_VALUE + 6, 4.0, 500);
+    unsigned int afterThirdEmptyAnswer = getPollingStatistics(handle).currentIntervalInSeconds;
+
+    //assert
+    ASSERT_ARE_EQUAL(int, 2, afterFirstEmptyAnswer);
+    ASSERT_ARE_EQUAL(int, 4, afterSecondEmptyAnswer);
+    ASSERT_ARE_EQUAL(int, 5, afterThirdEmptyAnswer);
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_10_037: [ While adaptive polling is on, a GET shall be allowed once the polling wait of the device has passed since its last GET; a wait of 0 shall allow a GET at every _DoWork. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_10_038: [ When a GET is answered with 200, the polling wait of the device shall become 0 so that it polls again at the next _DoWork. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_adaptive_polling_polls_again_at_the_next_DoWork_after_a_message)
+{
+    //arrange
+    TRANSPORT_LL_HANDLE handle = createSubscribedTransportWithAdaptivePolling(2, 60);
+    doWorkPollingAt(handle, TEST_GET_TIME_VALUE, 0, 204);
+    doWorkPollingAt(handle, TEST_GET_TIME_VALUE + 2, 2.0, 200);
+
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend)); /*because DoWork for event*/
+    STRICT_EXPECTED_CALL(get_time(NULL))
+        .SetReturn(TEST_GET_TIME_VALUE + 2);
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)); /*because relativePath is a STRING_HANDLE*/
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_10_040: [ Once telemetry of a device is confirmed with IOTHUB_CLIENT_CONFIRMATION_OK, a polling wait longer than minimumIntervalInSeconds shall be brought back to minimumIntervalInSeconds. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_adaptive_polling_brings_the_interval_back_to_the_minimum_after_sending_telemetry)
+{
+    //arrange
+    bool batching = true;
+    TRANSPORT_LL_HANDLE handle = createSubscribedTransportWithAdaptivePolling(2, 60);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_BATCHING, &batching);
+    doWorkPollingAt(handle, TEST_GET_TIME_VALUE, 0, 204);
+    doWorkPollingAt(handle, TEST_GET_TIME_VALUE + 2, 2.0, 204);
+    doWorkPollingAt(handle, TEST_GET_TIME_VALUE + 6, 4.0, 204);
+    ASSERT_ARE_EQUAL(int, 8, getPollingStatistics(handle).currentIntervalInSeconds);
+    DList_InsertTailList(&(waitingToSend), &(message6.entry));
+    umock_c_reset_all_calls();
+
+    setupDoWorkBatchedEventWriteOneItem();
+    setupDoWorkBatchedEventSend();
+    STRICT_EXPECTED_CALL(get_time(NULL))
+        .SetReturn(TEST_GET_TIME_VALUE + 7);
+    STRICT_EXPECTED_CALL(get_difftime(TEST_GET_TIME_VALUE + 7, TEST_GET_TIME_VALUE + 6))
+        .SetReturn(1.0);
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 2, getPollingStatistics(handle).currentIntervalInSeconds);
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_10_041: [ While adaptive polling is on, msToNextWork shall be no later than the moment the polling wait of a subscribed device has passed. ]
+TEST_FUNCTION(IoTHubTransportHttp_GetNextWorkDeadline_with_adaptive_polling_returns_the_rest_of_the_interval)
+{
+    //arrange
+    uint64_t msToNextWork;
+    TRANSPORT_LL_HANDLE handle = createSubscribedTransportWithAdaptivePolling(2, 60);
+    doWorkPollingAt(handle, TEST_GET_TIME_VALUE, 0, 204);
+
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(get_time(NULL))
+        .SetReturn(TEST_GET_TIME_VALUE + 1);
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, 0));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+    STRICT_EXPECTED_CALL(get_difftime(TEST_GET_TIME_VALUE + 1, TEST_GET_TIME_VALUE))
+        .SetReturn(1.0);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_GetNextWorkDeadline(handle, &msToNextWork);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(uint64_t, 1000, msToNextWork);
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_10_041: [ While adaptive polling is on, msToNextWork shall be no later than the moment the polling wait of a subscribed device has passed. ]
+TEST_FUNCTION(IoTHubTransportHttp_GetNextWorkDeadline_with_adaptive_polling_after_a_message_returns_0)
+{
+    //arrange
+    uint64_t msToNextWork;
+    TRANSPORT_LL_HANDLE handle = createSubscribedTransportWithAdaptivePolling(2, 60);
+    doWorkPollingAt(handle, TEST_GET_TIME_VALUE, 0, 200);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_GetNextWorkDeadline(handle, &msToNextWork);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(uint64_t, 0, msToNextWork);
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_10_042: [ IoTHubTransportHttp_GetPollingStatistics shall fill pollingStatistics with the sum of the counters of all the devices and the shortest polling wait among the subscribed devices. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_10_043: [ Every GET shall be counted in the polling statistics of the device: answered ones by their status code, the others as failed. ]
+TEST_FUNCTION(IoTHubTransportHttp_GetPollingStatistics_counts_the_polls_by_outcome_succeeds)
+{
+    //arrange
+    TRANSPORT_LL_HANDLE handle = createSubscribedTransportWithAdaptivePolling(2, 60);
+    doWorkPollingAt(handle, TEST_GET_TIME_VALUE, 0, 200);
+    doWorkPollingAt(handle, TEST_GET_TIME_VALUE, 0, 204);
+    doWorkPollingAt(handle, TEST_GET_TIME_VALUE + 2, 2.0, 404);
+
+    STRICT_EXPECTED_CALL(get_time(NULL))
+        .SetReturn(TEST_GET_TIME_VALUE + 6);
+    STRICT_EXPECTED_CALL(get_difftime(TEST_GET_TIME_VALUE + 6, TEST_GET_TIME_VALUE + 2))
+        .SetReturn(4.0);
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments()
+        .SetReturn(HTTPAPIEX_ERROR);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //act
+    IOTHUB_CLIENT_HTTP_POLLING_STATISTICS pollingStatistics = getPollingStatistics(handle);
+
+    //assert
+    ASSERT_ARE_EQUAL(size_t, 3, pollingStatistics.pollCount);
+    ASSERT_ARE_EQUAL(size_t, 1, pollingStatistics.messagePollCount);
+    ASSERT_ARE_EQUAL(size_t, 1, pollingStatistics.emptyPollCount);
+    ASSERT_ARE_EQUAL(size_t, 2, pollingStatistics.failedPollCount);
+    ASSERT_ARE_EQUAL(int, 4, pollingStatistics.currentIntervalInSeconds);
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_10_044: [ If handle or pollingStatistics is NULL, IoTHubTransportHttp_GetPollingStatistics shall return IOTHUB_CLIENT_INVALID_ARG. ]
+TEST_FUNCTION(IoTHubTransportHttp_GetPollingStatistics_with_NULL_handle_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_HTTP_POLLING_STATISTICS pollingStatistics;
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_GetPollingStatistics(NULL, &pollingStatistics);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_10_044: [ If handle or pollingStatistics is NULL, IoTHubTransportHttp_GetPollingStatistics shall return IOTHUB_CLIENT_INVALID_ARG. ]
+TEST_FUNCTION(IoTHubTransportHttp_GetPollingStatistics_with_NULL_pollingStatistics_fails)
+{
+    //arrange
+    TRANSPORT_LL_HANDLE handle = createSubscribedTransportWithAdaptivePolling(2, 60);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttp_GetPollingStatistics(handle, NULL);
+
+    //assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
 /*Tests_SRS_TRANSPORTMULTITHTTP_02_001: [ If handle is NULL then IoTHubTransportHttp_GetHostname shall fail and return NULL. ]*/
 TEST_FUNCTION(IoTHubTransportHttp_GetHostname_with_NULL_handle_fails)
 {
@@ -0,0 +1,16 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#define device_index_create real_device_index_create
+#define device_index_destroy real_device_index_destroy
+#define device_index_add real_device_index_add
+#define device_index_remove real_device_index_remove
+#define device_index_find real_device_index_find
+#define device_index_item_get_value real_device_index_item_get_value
+#define device_index_get_head_item real_device_index_get_head_item
+#define device_index_get_next_item real_device_index_get_next_item
+#define device_index_get_count real_device_index_get_count
+
+#define GBALLOC_H
+
+#include "../../src/device_index.c"
@@ -0,0 +1,1200 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#endif
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+#include "umocktypes.h"
+#include "umocktypes_c.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/map.h"
+#include "iothub_message.h"
+#include "message_store_file.h"
+#undef ENABLE_MOCKS
+
+#include "message_store.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+#define TEST_DIRECTORY                      "store"
+#define TEST_CHECKPOINT_PATH                "store/checkpoint"
+#define TEST_CHECKPOINT_TEMP_PATH           "store/checkpoint.tmp"
+#define TEST_SEGMENT_0_PATH                 "store/00000000.seg"
+#define TEST_SEGMENT_1_PATH                 "store/00000001.seg"
+#define TEST_SEGMENT_2_PATH                 "store/00000002.seg"
+#define TEST_MAX_FILES                      8
+#define TEST_MAX_FILE_SIZE                  4096
+#define TEST_MAX_PROPERTIES                 4
+#define TEST_MAX_STRING_SIZE                32
+
+
+// Fake file system
+
+typedef struct TEST_FILE_TAG
+{
+    char path[TEST_MAX_STRING_SIZE];
+    unsigned char data[TEST_MAX_FILE_SIZE];
+    size_t size;
+    bool exists;
+} TEST_FILE;
+
+typedef struct TEST_OPEN_FILE_TAG
+{
+    TEST_FILE* file;
+    size_t position;
+} TEST_OPEN_FILE;
+
+static TEST_FILE test_files[TEST_MAX_FILES];
+static bool test_file_write_fails;
+
+static TEST_FILE* find_test_file(const char* path)
+{
+    TEST_FILE* result = NULL;
+    size_t i;
+
+    for (i = 0; i < TEST_MAX_FILES; i++)
+    {
+        if (test_files[i].exists && strcmp(test_files[i].path, path) == 0)
+        {
+            result = &test_files[i];
+            break;
+        }
+    }
+
+    return result;
+}
+
+static TEST_FILE* create_test_file(const char* path)
+{
+    TEST_FILE* result = find_test_file(path);
+
+    if (result == NULL)
+    {
+        size_t i;
+        for (i = 0; i < TEST_MAX_FILES; i++)
+        {
+            if (!test_files[i].exists)
+            {
+                result = &test_files[i];
+                (void)strcpy(result->path, path);
+                result->exists = true;
+                break;
+            }
+        }
+    }
+
+    ASSERT_IS_NOT_NULL_WITH_MSG(result, "too many test files");
+    result->size = 0;
+    return result;
+}
+
+static MESSAGE_STORE_FILE_HANDLE my_message_store_file_open(const char* path, MESSAGE_STORE_FILE_MODE mode)
+{
+    TEST_OPEN_FILE* result;
+    TEST_FILE* file = find_test_file(path);
+
+    if (mode == MESSAGE_STORE_FILE_WRITE || (mode == MESSAGE_STORE_FILE_APPEND && file == NULL))
+    {
+        file = create_test_file(path);
+    }
+
+    if (file == NULL)
+    {
+        result = NULL;
+    }
+    else
+    {
+        result = (TEST_OPEN_FILE*)my_gballoc_malloc(sizeof(TEST_OPEN_FILE));
+        result->file = file;
+        result->position = 0;
+    }
+
+    return (MESSAGE_STORE_FILE_HANDLE)result;
+}
+
+static void my_message_store_file_close(MESSAGE_STORE_FILE_HANDLE file)
+{
+    my_gballoc_free(file);
+}
+
+static int my_message_store_file_write(MESSAGE_STORE_FILE_HANDLE file, const unsigned char* buffer, size_t size)
+{
+    int result;
+    TEST_FILE* test_file = ((TEST_OPEN_FILE*)file)->file;
+
+    if (test_file_write_fails)
+    {
+        /*a torn write*/
+        (void)memcpy(test_file->data + test_file->size, buffer, size / 2);
+        test_file->size += size / 2;
+        result = __LINE__;
+    }
+    else
+    {
+        ASSERT_IS_TRUE_WITH_MSG(test_file->size + size <= TEST_MAX_FILE_SIZE, "test file is too large");
+        (void)memcpy(test_file->data + test_file->size, buffer, size);
+        test_file->size += size;
+        result = 0;
+    }
+
+    return result;
+}
+
+static size_t my_message_store_file_read(MESSAGE_STORE_FILE_HANDLE file, unsigned char* buffer, size_t size)
+{
+    TEST_OPEN_FILE* open_file = (TEST_OPEN_FILE*)file;
+    size_t available = open_file->file->size - open_file->position;
+    size_t result = (size < available) ? size : available;
+
+    (void)memcpy(buffer, open_file->file->data + open_file->position, result);
+    open_file->position += result;
+    return result;
+}
+
+static int my_message_store_file_remove(const char* path)
+{
+    TEST_FILE* file = find_test_file(path);
+    if (file != NULL)
+    {
+        file->exists = false;
+    }
+    return (file == NULL) ? __LINE__ : 0;
+}
+
+static int my_message_store_file_replace(const char* source, const char* destination)
+{
+    TEST_FILE* source_file = find_test_file(source);
+    TEST_FILE* destination_file = create_test_file(destination);
+
+    (void)memcpy(destination_file->data, source_file->data, source_file->size);
+    destination_file->size = source_file->size;
+    source_file->exists = false;
+    return 0;
+}
+
+
+// Fake messages, the properties map of a message is the message itself
+
+typedef struct TEST_MESSAGE_TAG
+{
+    IOTHUBMESSAGE_CONTENT_TYPE content_type;
+    unsigned char body[TEST_MAX_FILE_SIZE];
+    IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT segment;
+    char message_id[TEST_MAX_STRING_SIZE];
+    char correlation_id[TEST_MAX_STRING_SIZE];
+    char keys[TEST_MAX_PROPERTIES][TEST_MAX_STRING_SIZE];
+    char values[TEST_MAX_PROPERTIES][TEST_MAX_STRING_SIZE];
+    const char* key_pointers[TEST_MAX_PROPERTIES];
+    const char* value_pointers[TEST_MAX_PROPERTIES];
+    size_t property_count;
+} TEST_MESSAGE;
+
+static bool test_create_message_fails;
+
+static TEST_MESSAGE* create_test_message(IOTHUBMESSAGE_CONTENT_TYPE content_type, const unsigned char* body, size_t size)
+{
+    TEST_MESSAGE* result = (TEST_MESSAGE*)my_gballoc_malloc(sizeof(TEST_MESSAGE));
+    (void)memset(result, 0, sizeof(TEST_MESSAGE));
+    result->content_type = content_type;
+    (void)memcpy(result->body, body, size);
+    result->segment.buffer = result->body;
+    result->segment.size = size;
+    return result;
+}
+
+static IOTHUB_MESSAGE_HANDLE my_IoTHubMessage_CreateFromByteArray(const unsigned char* byteArray, size_t size)
+{
+    return test_create_message_fails ? NULL : (IOTHUB_MESSAGE_HANDLE)create_test_message(IOTHUBMESSAGE_BYTEARRAY, byteArray, size);
+}
+
+static IOTHUB_MESSAGE_HANDLE my_IoTHubMessage_CreateFromString(const char* source)
+{
+    return test_create_message_fails ? NULL : (IOTHUB_MESSAGE_HANDLE)create_test_message(IOTHUBMESSAGE_STRING, (const unsigned char*)source, strlen(source) + 1);
+}
+
+static void my_IoTHubMessage_Destroy(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    my_gballoc_free(iotHubMessageHandle);
+}
+
+static IOTHUBMESSAGE_CONTENT_TYPE my_IoTHubMessage_GetContentType(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    return ((TEST_MESSAGE*)iotHubMessageHandle)->content_type;
+}
+
+static IOTHUB_MESSAGE_RESULT my_IoTHubMessage_GetByteArraySegments(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT** segments, size_t* segmentCount)
+{
+    *segments = &((TEST_MESSAGE*)iotHubMessageHandle)->segment;
+    *segmentCount = 1;
+    return IOTHUB_MESSAGE_OK;
+}
+
+static const char* my_IoTHubMessage_GetString(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    return (const char*)((TEST_MESSAGE*)iotHubMessageHandle)->body;
+}
+
+static MAP_HANDLE my_IoTHubMessage_Properties(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    return (MAP_HANDLE)iotHubMessageHandle;
+}
+
+static const char* my_IoTHubMessage_GetMessageId(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    TEST_MESSAGE* message = (TEST_MESSAGE*)iotHubMessageHandle;
+    return (message->message_id[0] == '\0') ? NULL : message->message_id;
+}
+
+static IOTHUB_MESSAGE_RESULT my_IoTHubMessage_SetMessageId(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const char* messageId)
+{
+    (void)strcpy(((TEST_MESSAGE*)iotHubMessageHandle)->message_id, messageId);
+    return IOTHUB_MESSAGE_OK;
+}
+
+static const char* my_IoTHubMessage_GetCorrelationId(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle)
+{
+    TEST_MESSAGE* message = (TEST_MESSAGE*)iotHubMessageHandle;
+    return (message->correlation_id[0] == '\0') ? NULL : message->correlation_id;
+}
+
+static IOTHUB_MESSAGE_RESULT my_IoTHubMessage_SetCorrelationId(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const char* correlationId)
+{
+    (void)strcpy(((TEST_MESSAGE*)iotHubMessageHandle)->correlation_id, correlationId);
+    return IOTHUB_MESSAGE_OK;
+}
+
+static MAP_RESULT my_Map_GetInternals(MAP_HANDLE handle, const char*const** keys, const char*const** values, size_t* count)
+{
+    TEST_MESSAGE* message = (TEST_MESSAGE*)handle;
+    *keys = message->key_pointers;
+    *values = message->value_pointers;
+    *count = message->property_count;
+    return MAP_OK;
+}
+
+static MAP_RESULT my_Map_AddOrUpdate(MAP_HANDLE handle, const char* key, const char* value)
+{
+    TEST_MESSAGE* message = (TEST_MESSAGE*)handle;
+    size_t index = message->property_count++;
+    (void)strcpy(message->keys[index], key);
+    (void)strcpy(message->values[index], value);
+    message->key_pointers[index] = message->keys[index];
+    message->value_pointers[index] = message->values[index];
+    return MAP_OK;
+}
+
+
+// Helpers
+
+static MESSAGE_STORE_CONFIG test_config;
+
+static MESSAGE_STORE_CONFIG* get_config(size_t max_segment_size, size_t max_store_size)
+{
+    test_config.directory = TEST_DIRECTORY;
+    test_config.max_segment_size = max_segment_size;
+    test_config.max_store_size = max_store_size;
+    return &test_config;
+}
+
+static MESSAGE_STORE_HANDLE create_message_store(size_t max_segment_size, size_t max_store_size)
+{
+    MESSAGE_STORE_HANDLE result = message_store_create(get_config(max_segment_size, max_store_size));
+    ASSERT_IS_NOT_NULL_WITH_MSG(result, "failed creating the message store");
+    umock_c_reset_all_calls();
+    return result;
+}
+
+static IOTHUB_MESSAGE_HANDLE create_bytearray_message(const char* body)
+{
+    return (IOTHUB_MESSAGE_HANDLE)create_test_message(IOTHUBMESSAGE_BYTEARRAY, (const unsigned char*)body, strlen(body));
+}
+
+static uint64_t append_message(MESSAGE_STORE_HANDLE message_store, const char* body)
+{
+    uint64_t sequence_number = UINT64_MAX;
+    IOTHUB_MESSAGE_HANDLE message = create_bytearray_message(body);
+    MESSAGE_STORE_RESULT result = message_store_append(message_store, message, &sequence_number);
+    ASSERT_ARE_EQUAL_WITH_MSG(int, (int)MESSAGE_STORE_OK, (int)result, "failed appending a message");
+    my_IoTHubMessage_Destroy(message);
+    return sequence_number;
+}
+
+static uint64_t read_message(MESSAGE_STORE_HANDLE message_store, const char* expected_body)
+{
+    uint64_t sequence_number = UINT64_MAX;
+    IOTHUB_MESSAGE_HANDLE message = NULL;
+    MESSAGE_STORE_RESULT result = message_store_read_next(message_store, &message, &sequence_number);
+    ASSERT_ARE_EQUAL_WITH_MSG(int, (int)MESSAGE_STORE_OK, (int)result, "failed reading a message");
+    ASSERT_ARE_EQUAL(size_t, strlen(expected_body), ((TEST_MESSAGE*)message)->segment.size);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(expected_body, ((TEST_MESSAGE*)message)->body, strlen(expected_body)));
+    my_IoTHubMessage_Destroy(message);
+    return sequence_number;
+}
+
+static void reset_test_files()
+{
+    (void)memset(test_files, 0, sizeof(test_files));
+    test_file_write_fails = false;
+    test_create_message_fails = false;
+}
+
+static void register_umock_alias_types()
+{
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUBMESSAGE_CONTENT_TYPE, int);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_STORE_FILE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(MESSAGE_STORE_FILE_MODE, int);
+    REGISTER_UMOCK_ALIAS_TYPE(const unsigned char*, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(unsigned char*, void*);
+}
+
+static void register_global_mock_hooks()
+{
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_realloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(message_store_file_open, my_message_store_file_open);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(message_store_file_open, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(message_store_file_close, my_message_store_file_close);
+    REGISTER_GLOBAL_MOCK_HOOK(message_store_file_write, my_message_store_file_write);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(message_store_file_write, __LINE__);
+    REGISTER_GLOBAL_MOCK_HOOK(message_store_file_read, my_message_store_file_read);
+    REGISTER_GLOBAL_MOCK_RETURN(message_store_file_flush, 0);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(message_store_file_flush, __LINE__);
+    REGISTER_GLOBAL_MOCK_HOOK(message_store_file_remove, my_message_store_file_remove);
+    REGISTER_GLOBAL_MOCK_HOOK(message_store_file_replace, my_message_store_file_replace);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(message_store_file_replace, __LINE__);
+
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_CreateFromByteArray, my_IoTHubMessage_CreateFromByteArray);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_CreateFromString, my_IoTHubMessage_CreateFromString);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_Destroy, my_IoTHubMessage_Destroy);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetContentType, my_IoTHubMessage_GetContentType);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetByteArraySegments, my_IoTHubMessage_GetByteArraySegments);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetString, my_IoTHubMessage_GetString);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_Properties, my_IoTHubMessage_Properties);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetReadOnlyProperties, my_IoTHubMessage_Properties);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetMessageId, my_IoTHubMessage_GetMessageId);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_SetMessageId, my_IoTHubMessage_SetMessageId);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetCorrelationId, my_IoTHubMessage_GetCorrelationId);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_SetCorrelationId, my_IoTHubMessage_SetCorrelationId);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_GetContentTypeSystemProperty, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_GetContentEncodingSystemProperty, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(Map_GetInternals, my_Map_GetInternals);
+    REGISTER_GLOBAL_MOCK_HOOK(Map_AddOrUpdate, my_Map_AddOrUpdate);
+}
+
+
+BEGIN_TEST_SUITE(message_store_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    register_umock_alias_types();
+    register_global_mock_hooks();
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+    reset_test_files();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+// Tests_SRS_MESSAGE_STORE_10_001: [If `config` or `config->directory` are NULL, message_store_create shall fail and return NULL]
+TEST_FUNCTION(message_store_create_NULL_config_fails)
+{
+    // arrange
+    MESSAGE_STORE_CONFIG config;
+    config.directory = NULL;
+    config.max_segment_size = 0;
+    config.max_store_size = 0;
+
+    // act
+    MESSAGE_STORE_HANDLE result1 = message_store_create(NULL);
+    MESSAGE_STORE_HANDLE result2 = message_store_create(&config);
+
+    // assert
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_MESSAGE_STORE_10_002: [If the directory has no checkpoint file, the store shall start empty]
+// Tests_SRS_MESSAGE_STORE_10_005: [New records shall be appended to the last segment, unless it ends with an invalid record or is full, in which case a new segment shall be started]
+TEST_FUNCTION(message_store_create_empty_directory_succeeds)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(message_store_file_open(TEST_CHECKPOINT_PATH, MESSAGE_STORE_FILE_READ));
+    STRICT_EXPECTED_CALL(message_store_file_open(TEST_SEGMENT_0_PATH, MESSAGE_STORE_FILE_READ));
+    STRICT_EXPECTED_CALL(message_store_file_open(TEST_SEGMENT_0_PATH, MESSAGE_STORE_FILE_APPEND));
+
+    // act
+    MESSAGE_STORE_HANDLE result = message_store_create(get_config(0, 0));
+
+    // assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    bool is_empty = false;
+    ASSERT_ARE_EQUAL(int, 0, message_store_is_empty(result, &is_empty));
+    ASSERT_IS_TRUE(is_empty);
+
+    // cleanup
+    message_store_destroy(result);
+}
+
+// Tests_SRS_MESSAGE_STORE_10_006: [If any failure occurs, message_store_create shall fail and return NULL]
+TEST_FUNCTION(message_store_create_malloc_fails)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    // act
+    MESSAGE_STORE_HANDLE result = message_store_create(get_config(0, 0));
+
+    // assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_MESSAGE_STORE_10_003: [If the checkpoint file cannot be read or is not valid, message_store_create shall fail and return NULL]
+TEST_FUNCTION(message_store_create_invalid_checkpoint_fails)
+{
+    // arrange
+    TEST_FILE* checkpoint = create_test_file(TEST_CHECKPOINT_PATH);
+    (void)memset(checkpoint->data, 0xAB, 24);
+    checkpoint->size = 24;
+
+    // act
+    MESSAGE_STORE_HANDLE result = message_store_create(get_config(0, 0));
+
+    // assert
+    ASSERT_IS_NULL(result);
+}
+
+// Tests_SRS_MESSAGE_STORE_10_004: [message_store_create shall read every segment starting at the first segment named in the checkpoint, counting the records at or after the checkpoint, and shall stop reading a segment at the first record that is incomplete or fails its checksum]
+TEST_FUNCTION(message_store_create_replays_records_not_acknowledged)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE message_store = create_message_store(0, 0);
+    (void)append_message(message_store, "one");
+    (void)append_message(message_store, "two");
+    (void)append_message(message_store, "three");
+    ASSERT_ARE_EQUAL(int, 0, (int)read_message(message_store, "one"));
+    ASSERT_ARE_EQUAL(int, 0, message_store_acknowledge(message_store, 0));
+    message_store_destroy(message_store);
+
+    // act
+    message_store = create_message_store(0, 0);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 1, (int)read_message(message_store, "two"));
+    ASSERT_ARE_EQUAL(int, 2, (int)read_message(message_store, "three"));
+    ASSERT_ARE_EQUAL(int, 3, (int)append_message(message_store, "four"));
+
+    // cleanup
+    message_store_destroy(message_store);
+}
+
+// Tests_SRS_MESSAGE_STORE_10_004: [message_store_create shall read every segment starting at the first segment named in the checkpoint, counting the records at or after the checkpoint, and shall stop reading a segment at the first record that is incomplete or fails its checksum]
+// Tests_SRS_MESSAGE_STORE_10_005: [New records shall be appended to the last segment, unless it ends with an invalid record or is full, in which case a new segment shall be started]
+TEST_FUNCTION(message_store_create_ignores_torn_record)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE message_store = create_message_store(0, 0);
+    (void)append_message(message_store, "one");
+    (void)append_message(message_store, "two");
+    message_store_destroy(message_store);
+    find_test_file(TEST_SEGMENT_0_PATH)->size -= 2;
+
+    // act
+    message_store = create_message_store(0, 0);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 1, (int)append_message(message_store, "three"));
+    ASSERT_IS_NOT_NULL(find_test_file(TEST_SEGMENT_1_PATH));
+    ASSERT_ARE_EQUAL(int, 0, (int)read_message(message_store, "one"));
+    ASSERT_ARE_EQUAL(int, 1, (int)read_message(message_store, "three"));
+
+    // cleanup
+    message_store_destroy(message_store);
+}
+
+// Tests_SRS_MESSAGE_STORE_10_007: [If `message_store` is NULL, message_store_destroy shall return]
+TEST_FUNCTION(message_store_destroy_NULL_handle)
+{
+    // arrange
+
+    // act
+    message_store_destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_MESSAGE_STORE_10_008: [message_store_destroy shall flush the store, close its files and release all the memory it allocated, keeping the files]
+TEST_FUNCTION(message_store_destroy_flushes_and_keeps_files)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE message_store = create_message_store(0, 0);
+    (void)append_message(message_store, "one");
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(message_store_file_flush(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(message_store_file_close(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    message_store_destroy(message_store);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(find_test_file(TEST_SEGMENT_0_PATH));
+}
+
+// Tests_SRS_MESSAGE_STORE_10_009: [If `message_store`, `message` or `sequence_number` are NULL, message_store_append shall return MESSAGE_STORE_ERROR]
+TEST_FUNCTION(message_store_append_NULL_arguments_fail)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE message_store = create_message_store(0, 0);
+    IOTHUB_MESSAGE_HANDLE message = create_bytearray_message("one");
+    uint64_t sequence_number;
+
+    // act
+    MESSAGE_STORE_RESULT result1 = message_store_append(NULL, message, &sequence_number);
+    MESSAGE_STORE_RESULT result2 = message_store_append(message_store, NULL, &sequence_number);
+    MESSAGE_STORE_RESULT result3 = message_store_append(message_store, message, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_STORE_ERROR, (int)result1);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_STORE_ERROR, (int)result2);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_STORE_ERROR, (int)result3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    my_IoTHubMessage_Destroy(message);
+    message_store_destroy(message_store);
+}
+
+// Tests_SRS_MESSAGE_STORE_10_010: [message_store_append shall serialize the content, message id, correlation id, content type, content encoding and properties of `message` in a single record, and return MESSAGE_STORE_ERROR if that fails]
+TEST_FUNCTION(message_store_append_message_without_content_fails)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE message_store = create_message_store(0, 0);
+    IOTHUB_MESSAGE_HANDLE message = (IOTHUB_MESSAGE_HANDLE)create_test_message(IOTHUBMESSAGE_UNKNOWN, (const unsigned char*)"", 0);
+    uint64_t sequence_number;
+
+    // act
+    MESSAGE_STORE_RESULT result = message_store_append(message_store, message, &sequence_number);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_STORE_ERROR, (int)result);
+    ASSERT_ARE_EQUAL(size_t, 0, find_test_file(TEST_SEGMENT_0_PATH)->size);
+
+    // cleanup
+    my_IoTHubMessage_Destroy(message);
+    message_store_destroy(message_store);
+}
+
+// Tests_SRS_MESSAGE_STORE_10_013: [The record shall be appended to the segment with a single write, and if that fails message_store_append shall return MESSAGE_STORE_ERROR]
+// Tests_SRS_MESSAGE_STORE_10_014: [On success `sequence_number` shall be set to the sequence number of the record, which is one more than the one of the previous record, and message_store_append shall return MESSAGE_STORE_OK]
+TEST_FUNCTION(message_store_append_succeeds)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE message_store = create_message_store(0, 0);
+    IOTHUB_MESSAGE_HANDLE message = create_bytearray_message("one");
+    uint64_t sequence_number1 = UINT64_MAX;
+    uint64_t sequence_number2 = UINT64_MAX;
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(message));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(message, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(message));
+    STRICT_EXPECTED_CALL(Map_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetMessageId(message));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetCorrelationId(message));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentTypeSystemProperty(message));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentEncodingSystemProperty(message));
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(message_store_file_write(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+
+    // act
+    MESSAGE_STORE_RESULT result1 = message_store_append(message_store, message, &sequence_number1);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    MESSAGE_STORE_RESULT result2 = message_store_append(message_store, message, &sequence_number2);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_STORE_OK, (int)result1);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_STORE_OK, (int)result2);
+    ASSERT_ARE_EQUAL(int, 0, (int)sequence_number1);
+    ASSERT_ARE_EQUAL(int, 1, (int)sequence_number2);
+
+    // cleanup
+    my_IoTHubMessage_Destroy(message);
+    message_store_destroy(message_store);
+}
+
+// Tests_SRS_MESSAGE_STORE_10_011: [If `max_store_size` is not zero and the records not yet acknowledged plus the new record would be larger than it, message_store_append shall return MESSAGE_STORE_FULL]
+TEST_FUNCTION(message_store_append_returns_FULL_until_acknowledged)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE message_store = create_message_store(0, 100);
+    IOTHUB_MESSAGE_HANDLE message = create_bytearray_message("twelve bytes");
+    uint64_t sequence_number;
+    (void)append_message(message_store, "twelve bytes");
+
+    // act
+    MESSAGE_STORE_RESULT result1 = message_store_append(message_store, message, &sequence_number);
+    (void)read_message(message_store, "twelve bytes");
+    ASSERT_ARE_EQUAL(int, 0, message_store_acknowledge(message_store, 0));
+    MESSAGE_STORE_RESULT result2 = message_store_append(message_store, message, &sequence_number);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_STORE_FULL, (int)result1);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_STORE_OK, (int)result2);
+    ASSERT_ARE_EQUAL(int, 1, (int)sequence_number);
+
+    // cleanup
+    my_IoTHubMessage_Destroy(message);
+    message_store_destroy(message_store);
+}
+
+// Tests_SRS_MESSAGE_STORE_10_012: [If the record would make a segment that is not empty larger than `max_segment_size`, or the last write to the segment failed, a new segment shall be started]
+TEST_FUNCTION(message_store_append_starts_new_segment_when_segment_is_full)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE message_store = create_message_store(64, 0);
+
+    // act
+    (void)append_message(message_store, "one");
+    (void)append_message(message_store, "two");
+
+    // assert
+    ASSERT_IS_NOT_NULL(find_test_file(TEST_SEGMENT_1_PATH));
+    ASSERT_IS_NULL(find_test_file(TEST_SEGMENT_2_PATH));
+
+    // cleanup
+    message_store_destroy(message_store);
+}
+
+// Tests_SRS_MESSAGE_STORE_10_012: [If the record would make a segment that is not empty larger than `max_segment_size`, or the last write to the segment failed, a new segment shall be started]
+// Tests_SRS_MESSAGE_STORE_10_013: [The record shall be appended to the segment with a single write, and if that fails message_store_append shall return MESSAGE_STORE_ERROR]
+TEST_FUNCTION(message_store_append_after_failed_write_starts_new_segment)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE message_store = create_message_store(0, 0);
+    IOTHUB_MESSAGE_HANDLE message = create_bytearray_message("one");
+    uint64_t sequence_number;
+    test_file_write_fails = true;
+
+    // act
+    MESSAGE_STORE_RESULT result = message_store_append(message_store, message, &sequence_number);
+    test_file_write_fails = false;
+
+    // assert
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_STORE_ERROR, (int)result);
+    ASSERT_ARE_EQUAL(int, 0, (int)append_message(message_store, "two"));
+    ASSERT_IS_NOT_NULL(find_test_file(TEST_SEGMENT_1_PATH));
+    ASSERT_ARE_EQUAL(int, 0, (int)read_message(message_store, "two"));
+
+    // cleanup
+    my_IoTHubMessage_Destroy(message);
+    message_store_destroy(message_store);
+}
+
+// Tests_SRS_MESSAGE_STORE_10_015: [If `message_store`, `message` or `sequence_number` are NULL, message_store_read_next shall return MESSAGE_STORE_ERROR]
+TEST_FUNCTION(message_store_read_next_NULL_arguments_fail)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE message_store = create_message_store(0, 0);
+    IOTHUB_MESSAGE_HANDLE message;
+    uint64_t sequence_number;
+
+    // act
+    MESSAGE_STORE_RESULT result1 = message_store_read_next(NULL, &message, &sequence_number);
+    MESSAGE_STORE_RESULT result2 = message_store_read_next(message_store, NULL, &sequence_number);
+    MESSAGE_STORE_RESULT result3 = message_store_read_next(message_store, &message, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_STORE_ERROR, (int)result1);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_STORE_ERROR, (int)result2);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_STORE_ERROR, (int)result3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    message_store_destroy(message_store);
+}
+
+// Tests_SRS_MESSAGE_STORE_10_016: [If every record appended was already read, message_store_read_next shall return MESSAGE_STORE_EMPTY]
+TEST_FUNCTION(message_store_read_next_returns_EMPTY)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE message_store = create_message_store(0, 0);
+    IOTHUB_MESSAGE_HANDLE message;
+    uint64_t sequence_number;
+
+    // act
+    MESSAGE_STORE_RESULT result1 = message_store_read_next(message_store, &message, &sequence_number);
+    (void)append_message(message_store, "one");
+    (void)read_message(message_store, "one");
+    MESSAGE_STORE_RESULT result2 = message_store_read_next(message_store, &message, &sequence_number);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_STORE_EMPTY, (int)result1);
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_STORE_EMPTY, (int)result2);
+
+    // cleanup
+    message_store_destroy(message_store);
+}
+
+// Tests_SRS_MESSAGE_STORE_10_017: [Before reading from the segment records are being appended to, the records appended shall be flushed]
+// Tests_SRS_MESSAGE_STORE_10_021: [Otherwise message_store_read_next shall set `message` to a new message and `sequence_number` to its sequence number, and return MESSAGE_STORE_OK]
+TEST_FUNCTION(message_store_read_next_restores_the_message)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE message_store = create_message_store(0, 0);
+    TEST_MESSAGE* original = create_test_message(IOTHUBMESSAGE_STRING, (const unsigned char*)"body", 5);
+    IOTHUB_MESSAGE_HANDLE message = NULL;
+    uint64_t sequence_number = UINT64_MAX;
+    (void)strcpy(original->message_id, "id");
+    (void)my_Map_AddOrUpdate((MAP_HANDLE)original, "key", "value");
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_STORE_OK, (int)message_store_append(message_store, (IOTHUB_MESSAGE_HANDLE)original, &sequence_number));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(message_store_file_flush(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(message_store_file_open(TEST_SEGMENT_0_PATH, MESSAGE_STORE_FILE_READ));
+    STRICT_EXPECTED_CALL(message_store_file_read(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 20));
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(message_store_file_read(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_CreateFromString("body"));
+    STRICT_EXPECTED_CALL(IoTHubMessage_SetMessageId(IGNORED_PTR_ARG, "id"));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(IGNORED_PTR_ARG, "key", "value"));
+
+    // act
+    MESSAGE_STORE_RESULT result = message_store_read_next(message_store, &message, &sequence_number);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_STORE_OK, (int)result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, (int)sequence_number);
+    ASSERT_ARE_EQUAL(char_ptr, "body", (const char*)((TEST_MESSAGE*)message)->body);
+    ASSERT_ARE_EQUAL(char_ptr, "id", ((TEST_MESSAGE*)message)->message_id);
+    ASSERT_ARE_EQUAL(char_ptr, "", ((TEST_MESSAGE*)message)->correlation_id);
+    ASSERT_ARE_EQUAL(size_t, 1, ((TEST_MESSAGE*)message)->property_count);
+    ASSERT_ARE_EQUAL(char_ptr, "value", ((TEST_MESSAGE*)message)->values[0]);
+
+    // cleanup
+    my_IoTHubMessage_Destroy(message);
+    my_IoTHubMessage_Destroy((IOTHUB_MESSAGE_HANDLE)original);
+    message_store_destroy(message_store);
+}
+
+// Tests_SRS_MESSAGE_STORE_10_018: [Records shall be read in the order they were appended; at the end of a segment, or at a record that is incomplete or fails its checksum, reading shall continue with the next segment]
+TEST_FUNCTION(message_store_read_next_reads_across_segments)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE message_store = create_message_store(64, 0);
+    (void)append_message(message_store, "one");
+    (void)append_message(message_store, "two");
+    (void)append_message(message_store, "three");
+
+    // act
+    uint64_t sequence_number1 = read_message(message_store, "one");
+    (void)append_message(message_store, "four");
+    uint64_t sequence_number2 = read_message(message_store, "two");
+    uint64_t sequence_number3 = read_message(message_store, "three");
+    uint64_t sequence_number4 = read_message(message_store, "four");
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, (int)sequence_number1);
+    ASSERT_ARE_EQUAL(int, 1, (int)sequence_number2);
+    ASSERT_ARE_EQUAL(int, 2, (int)sequence_number3);
+    ASSERT_ARE_EQUAL(int, 3, (int)sequence_number4);
+
+    // cleanup
+    message_store_destroy(message_store);
+}
+
+// Tests_SRS_MESSAGE_STORE_10_019: [Records before the checkpoint shall be skipped]
+TEST_FUNCTION(message_store_read_next_skips_records_before_checkpoint)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE message_store = create_message_store(0, 0);
+    (void)append_message(message_store, "one");
+    (void)append_message(message_store, "two");
+    (void)read_message(message_store, "one");
+    ASSERT_ARE_EQUAL(int, 0, message_store_acknowledge(message_store, 0));
+    message_store_destroy(message_store);
+    message_store = create_message_store(0, 0);
+
+    // act
+    uint64_t sequence_number = read_message(message_store, "two");
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 1, (int)sequence_number);
+
+    // cleanup
+    message_store_destroy(message_store);
+}
+
+// Tests_SRS_MESSAGE_STORE_10_020: [A record that cannot be turned back into a message shall be dropped as if it was acknowledged]
+TEST_FUNCTION(message_store_read_next_drops_record_that_cannot_be_restored)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE message_store = create_message_store(0, 0);
+    (void)append_message(message_store, "one");
+    (void)append_message(message_store, "two");
+    test_create_message_fails = true;
+    IOTHUB_MESSAGE_HANDLE message;
+    uint64_t sequence_number;
+
+    // act
+    MESSAGE_STORE_RESULT result = message_store_read_next(message_store, &message, &sequence_number);
+    test_create_message_fails = false;
+
+    // assert
+    ASSERT_ARE_EQUAL(int, (int)MESSAGE_STORE_EMPTY, (int)result);
+    ASSERT_ARE_EQUAL(int, 0, message_store_flush(message_store));
+    message_store_destroy(message_store);
+    message_store = create_message_store(0, 0);
+    bool is_empty = false;
+    ASSERT_ARE_EQUAL(int, 0, message_store_is_empty(message_store, &is_empty));
+    ASSERT_IS_TRUE(is_empty);
+
+    // cleanup
+    message_store_destroy(message_store);
+}
+
+// Tests_SRS_MESSAGE_STORE_10_022: [If `message_store` or `is_empty` are NULL, message_store_is_empty shall fail and return non-zero]
+TEST_FUNCTION(message_store_is_empty_NULL_arguments_fail)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE message_store = create_message_store(0, 0);
+    bool is_empty;
+
+    // act
+    int result1 = message_store_is_empty(NULL, &is_empty);
+    int result2 = message_store_is_empty(message_store, NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result1);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result2);
+
+    // cleanup
+    message_store_destroy(message_store);
+}
+
+// Tests_SRS_MESSAGE_STORE_10_023: [`is_empty` shall be set to true if every record appended was already read, false otherwise]
+TEST_FUNCTION(message_store_is_empty_follows_reads)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE message_store = create_message_store(0, 0);
+    bool is_empty1 = false;
+    bool is_empty2 = true;
+    bool is_empty3 = false;
+
+    // act
+    (void)message_store_is_empty(message_store, &is_empty1);
+    (void)append_message(message_store, "one");
+    (void)message_store_is_empty(message_store, &is_empty2);
+    (void)read_message(message_store, "one");
+    (void)message_store_is_empty(message_store, &is_empty3);
+
+    // assert
+    ASSERT_IS_TRUE(is_empty1);
+    ASSERT_IS_FALSE(is_empty2);
+    ASSERT_IS_TRUE(is_empty3);
+
+    // cleanup
+    message_store_destroy(message_store);
+}
+
+// Tests_SRS_MESSAGE_STORE_10_024: [If `message_store` is NULL, or `sequence_number` was not read or was already acknowledged, message_store_acknowledge shall fail and return non-zero]
+TEST_FUNCTION(message_store_acknowledge_fails_for_records_not_waiting)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE message_store = create_message_store(0, 0);
+    (void)append_message(message_store, "one");
+    (void)append_message(message_store, "two");
+    (void)read_message(message_store, "one");
+
+    // act
+    int result1 = message_store_acknowledge(NULL, 0);
+    int result2 = message_store_acknowledge(message_store, 1);
+    int result3 = message_store_acknowledge(message_store, 0);
+    int result4 = message_store_acknowledge(message_store, 0);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result1);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result2);
+    ASSERT_ARE_EQUAL(int, 0, result3);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result4);
+
+    // cleanup
+    message_store_destroy(message_store);
+}
+
+// Tests_SRS_MESSAGE_STORE_10_025: [The checkpoint shall move past a record once it and all the records before it are acknowledged]
+TEST_FUNCTION(message_store_acknowledge_out_of_order)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE message_store = create_message_store(0, 0);
+    (void)append_message(message_store, "one");
+    (void)append_message(message_store, "two");
+    (void)append_message(message_store, "three");
+    (void)read_message(message_store, "one");
+    (void)read_message(message_store, "two");
+    (void)read_message(message_store, "three");
+
+    // act
+    ASSERT_ARE_EQUAL(int, 0, message_store_acknowledge(message_store, 1));
+    ASSERT_ARE_EQUAL(int, 0, message_store_acknowledge(message_store, 2));
+    message_store_destroy(message_store);
+    message_store = create_message_store(0, 0);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, (int)read_message(message_store, "one"));
+    ASSERT_ARE_EQUAL(int, 1, (int)read_message(message_store, "two"));
+
+    // cleanup
+    message_store_destroy(message_store);
+}
+
+// Tests_SRS_MESSAGE_STORE_10_026: [If `message_store` is NULL, message_store_flush shall fail and return non-zero]
+TEST_FUNCTION(message_store_flush_NULL_handle_fails)
+{
+    // arrange
+
+    // act
+    int result = message_store_flush(NULL);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_MESSAGE_STORE_10_027: [The records appended since the last flush shall be committed to the disk]
+TEST_FUNCTION(message_store_flush_commits_appended_records_once)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE message_store = create_message_store(0, 0);
+    (void)append_message(message_store, "one");
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(message_store_file_flush(IGNORED_PTR_ARG));
+
+    // act
+    int result1 = message_store_flush(message_store);
+    int result2 = message_store_flush(message_store);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result1);
+    ASSERT_ARE_EQUAL(int, 0, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    message_store_destroy(message_store);
+}
+
+// Tests_SRS_MESSAGE_STORE_10_027: [The records appended since the last flush shall be committed to the disk]
+TEST_FUNCTION(message_store_flush_fails_when_segment_flush_fails)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE message_store = create_message_store(0, 0);
+    (void)append_message(message_store, "one");
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(message_store_file_flush(IGNORED_PTR_ARG))
+        .SetReturn(__LINE__);
+
+    // act
+    int result = message_store_flush(message_store);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    message_store_destroy(message_store);
+}
+
+// Tests_SRS_MESSAGE_STORE_10_028: [If the checkpoint moved since it was last written, it shall be written to a temporary file that then replaces the checkpoint file]
+TEST_FUNCTION(message_store_flush_writes_checkpoint)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE message_store = create_message_store(0, 0);
+    (void)append_message(message_store, "one");
+    (void)read_message(message_store, "one");
+    ASSERT_ARE_EQUAL(int, 0, message_store_acknowledge(message_store, 0));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(message_store_file_open(TEST_CHECKPOINT_TEMP_PATH, MESSAGE_STORE_FILE_WRITE));
+    STRICT_EXPECTED_CALL(message_store_file_write(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 24));
+    STRICT_EXPECTED_CALL(message_store_file_flush(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(message_store_file_close(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(message_store_file_replace(TEST_CHECKPOINT_TEMP_PATH, TEST_CHECKPOINT_PATH));
+
+    // act
+    int result = message_store_flush(message_store);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(find_test_file(TEST_CHECKPOINT_PATH));
+    ASSERT_IS_NULL(find_test_file(TEST_CHECKPOINT_TEMP_PATH));
+
+    // cleanup
+    message_store_destroy(message_store);
+}
+
+// Tests_SRS_MESSAGE_STORE_10_028: [If the checkpoint moved since it was last written, it shall be written to a temporary file that then replaces the checkpoint file]
+TEST_FUNCTION(message_store_flush_fails_when_checkpoint_cannot_be_replaced)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE message_store = create_message_store(0, 0);
+    (void)append_message(message_store, "one");
+    (void)read_message(message_store, "one");
+    ASSERT_ARE_EQUAL(int, 0, message_store_acknowledge(message_store, 0));
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(message_store_file_open(TEST_CHECKPOINT_TEMP_PATH, MESSAGE_STORE_FILE_WRITE));
+    STRICT_EXPECTED_CALL(message_store_file_write(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 24));
+    STRICT_EXPECTED_CALL(message_store_file_flush(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(message_store_file_close(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(message_store_file_replace(TEST_CHECKPOINT_TEMP_PATH, TEST_CHECKPOINT_PATH))
+        .SetReturn(__LINE__);
+
+    // act
+    int result = message_store_flush(message_store);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    message_store_destroy(message_store);
+}
+
+// Tests_SRS_MESSAGE_STORE_10_029: [Once the checkpoint is written, the segments before the one holding the oldest record not acknowledged shall be deleted]
+TEST_FUNCTION(message_store_flush_deletes_acknowledged_segments)
+{
+    // arrange
+    MESSAGE_STORE_HANDLE message_store = create_message_store(64, 0);
+    (void)append_message(message_store, "one");
+    (void)append_message(message_store, "two");
+    (void)append_message(message_store, "three");
+    (void)read_message(message_store, "one");
+    (void)read_message(message_store, "two");
+    ASSERT_ARE_EQUAL(int, 0, message_store_acknowledge(message_store, 0));
+
+    // act
+    int result = message_store_flush(message_store);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_IS_NULL(find_test_file(TEST_SEGMENT_0_PATH));
+    ASSERT_IS_NOT_NULL(find_test_file(TEST_SEGMENT_1_PATH));
+    ASSERT_IS_NOT_NULL(find_test_file(TEST_SEGMENT_2_PATH));
+
+    // cleanup
+    message_store_destroy(message_store);
+}
+
+END_TEST_SUITE(message_store_ut)
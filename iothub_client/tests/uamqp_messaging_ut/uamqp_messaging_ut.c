@@ -145,6 +145,19 @@ static int test_amqpvalue_get_string(AMQP_VALUE value, const char** string_value
     return saved_amqpvalue_get_string_return;
 }
 
+static const unsigned char TEST_SEGMENT_1[] = { 'a', 'b', 'c' };
+static const unsigned char TEST_SEGMENT_2[] = { 'd', 'e' };
+static const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT TEST_SEGMENTS[] = { { TEST_SEGMENT_1, sizeof(TEST_SEGMENT_1) }, { TEST_SEGMENT_2, sizeof(TEST_SEGMENT_2) } };
+static size_t test_IoTHubMessage_GetByteArraySegments_count = 1;
+
+static IOTHUB_MESSAGE_RESULT test_IoTHubMessage_GetByteArraySegments(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const IOTHUB_MESSAGE_BYTE_ARRAY_SEGMENT** segments, size_t* segmentCount)
+{
+    (void)iotHubMessageHandle;
+    *segments = TEST_SEGMENTS;
+    *segmentCount = test_IoTHubMessage_GetByteArraySegments_count;
+    return IOTHUB_MESSAGE_OK;
+}
+
 static AMQP_VALUE saved_amqpvalue_get_ulong_value = NULL;
 static uint64_t test_amqpvalue_get_ulong_ulong_value = 10;
 static int test_amqpvalue_get_ulong_return = 0;
@@ -258,7 +271,7 @@ static void set_exp_calls_for_create_encoded_application_properties(size_t numbe
 {
     size_t encoding_size = TEST_AMQP_ENCODING_SIZE;
 
-    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE)); //16
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetReadOnlyProperties(TEST_IOTHUB_MESSAGE_HANDLE)); //16
     STRICT_EXPECTED_CALL(Map_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(2, &TEST_MAP_KEYS, sizeof(TEST_MAP_KEYS))
         .CopyOutArgumentBuffer(3, &TEST_MAP_VALUES, sizeof(TEST_MAP_VALUES))
@@ -292,7 +305,7 @@ static void set_exp_calls_for_create_encoded_data(IOTHUBMESSAGE_CONTENT_TYPE msg
 
     if (msg_content_type == IOTHUBMESSAGE_BYTEARRAY)
     {
-        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+        STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(TEST_IOTHUB_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     }
     else if (msg_content_type == IOTHUBMESSAGE_STRING)
     {
@@ -498,6 +511,8 @@ static void initialize_variables()
     saved_amqpvalue_get_uuid_value = NULL;
     test_amqpvalue_get_uuid_uuid_value = &TEST_UUID_BYTES;
     test_amqpvalue_get_uuid_return = 0;
+
+    test_IoTHubMessage_GetByteArraySegments_count = 1;
 }
 
 
@@ -562,6 +577,8 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_Properties, TEST_MAP_HANDLE);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_Properties, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_GetReadOnlyProperties, TEST_MAP_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_GetReadOnlyProperties, NULL);
 
     REGISTER_GLOBAL_MOCK_RETURN(amqpvalue_create_map, TEST_AMQP_VALUE);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(amqpvalue_create_map, NULL);
@@ -580,6 +597,9 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
 
     REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_GetByteArray, IOTHUB_MESSAGE_OK);
 
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetByteArraySegments, test_IoTHubMessage_GetByteArraySegments);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_GetByteArraySegments, IOTHUB_MESSAGE_ERROR);
+
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(message_create, NULL);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(message_add_body_amqp_data, 1);
 
@@ -878,6 +898,42 @@ TEST_FUNCTION(message_create_from_iothub_message_no_content_encoding_success)
     // cleanup
 }
 
+// Tests_SRS_UAMQP_MESSAGING_10_001: [A body made of several segments shall be written as a single AMQP data section, copying each segment straight into the encoded message.]
+// Tests_SRS_UAMQP_MESSAGING_10_002: [If the body is made of several segments, their total size shall be computed without gathering them and no AMQP_VALUE shall be created for the data section.]
+TEST_FUNCTION(message_create_uamqp_encoding_from_iothub_message_segments_success)
+{
+    // arrange
+    static const unsigned char expected_data_section[] = { 0x00, 0x53, 0x75, 0xA0, 0x05, 'a', 'b', 'c', 'd', 'e' };
+    test_IoTHubMessage_GetByteArraySegments_count = 2;
+    memset(g_encoding_buffer, 0, sizeof(g_encoding_buffer));
+
+    umock_c_reset_all_calls();
+    set_exp_calls_for_create_encoded_message_properties(true, true, TEST_CONTENT_TYPE, TEST_CONTENT_ENCODING);
+    set_exp_calls_for_create_encoded_application_properties(0);
+    set_exp_calls_for_create_encoded_annotations_properties(false);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE)).SetReturn(IOTHUBMESSAGE_BYTEARRAY);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArraySegments(TEST_IOTHUB_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_malloc(TEST_AMQP_ENCODING_SIZE + sizeof(expected_data_section)))
+        .SetReturn(g_encoding_buffer);
+    STRICT_EXPECTED_CALL(amqpvalue_encode(TEST_AMQP_VALUE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
+
+    BINARY_DATA binary_data;
+    memset(&binary_data, 0, sizeof(binary_data));
+
+    // act
+    int result = message_create_uamqp_encoding_from_iothub_message(NULL, TEST_IOTHUB_MESSAGE_HANDLE, &binary_data);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, result, 0);
+    ASSERT_ARE_EQUAL(size_t, TEST_AMQP_ENCODING_SIZE + sizeof(expected_data_section), binary_data.length);
+    // amqpvalue_encode is mocked and writes nothing, so the data section starts at the beginning of the buffer
+    ASSERT_ARE_EQUAL(int, 0, memcmp(g_encoding_buffer, expected_data_section, sizeof(expected_data_section)));
+
+    // cleanup
+}
+
 // Tests_SRS_UAMQP_MESSAGING_31_120: [Create a blob that contains AMQP encoding of IOTHUB_MESSAGE_HANDLE.  Errors stop processing on this message.]
 // Tests_SRS_UAMQP_MESSAGING_31_121: [Any errors during `message_create_uamqp_encoding_from_iothub_message` stop processing on this message.]
 TEST_FUNCTION(message_create_from_iothub_message_BYTEARRAY_return_errors_fails)